@@ -0,0 +1,52 @@
+#include "alloc_counter.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> processAllocations(0);
+static std::atomic<uint64_t> processBytes(0);
+// Plain thread-locals, needing no construction, as the first allocation
+// of a thread may come before any of its own code runs
+static thread_local uint64_t threadAllocations = 0;
+static thread_local uint64_t threadBytes = 0;
+static thread_local bool threadTrapped = false;
+
+static void* countedAllocate(size_t bytes) {
+    if (threadTrapped) {
+        threadTrapped = false;
+        fprintf(stderr, "Allocation of %llu bytes on a trapped thread (alloc_counter.h)\n",
+                (unsigned long long)bytes);
+        abort();
+    }
+    processAllocations.fetch_add(1, std::memory_order_relaxed);
+    processBytes.fetch_add(bytes, std::memory_order_relaxed);
+    threadAllocations++;
+    threadBytes += bytes;
+    void* memory = malloc(bytes ? bytes : 1);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t bytes) { return countedAllocate(bytes); }
+void* operator new[](size_t bytes) { return countedAllocate(bytes); }
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+
+AllocationCounts AllocationCounter::getProcessCounts() {
+    AllocationCounts counts;
+    counts.allocations = processAllocations.load(std::memory_order_relaxed);
+    counts.bytes = processBytes.load(std::memory_order_relaxed);
+    return counts;
+}
+
+AllocationCounts AllocationCounter::getThreadCounts() {
+    AllocationCounts counts;
+    counts.allocations = threadAllocations;
+    counts.bytes = threadBytes;
+    return counts;
+}
+
+void AllocationCounter::setThreadTrap(bool trap) {
+    threadTrapped = trap;
+}
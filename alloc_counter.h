@@ -0,0 +1,31 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+// Every operator new of the process counted, by replacing the global
+// operator new and delete: linking alloc_counter.o is what turns it on. A
+// count is one relaxed atomic add for the process and a thread-local one
+// for the calling thread, so a frame's own allocations can be told from
+// the workers'. Blocks from malloc (lodepng's C API, the GL driver) are
+// not seen.
+//
+//   AllocationCounts start = AllocationCounter::getThreadCounts();
+//   ...
+//   uint64_t made = AllocationCounter::getThreadCounts().allocations - start.allocations;
+struct AllocationCounts {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+class AllocationCounter {
+public:
+    static AllocationCounts getProcessCounts();
+    static AllocationCounts getThreadCounts(); // The calling thread's
+    
+    // While trapped, an allocation on the calling thread prints its size
+    // and aborts, leaving a debugger at the allocating call
+    static void setThreadTrap(bool trap);
+};
+
+#endif // ALLOC_COUNTER_H
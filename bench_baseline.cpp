@@ -0,0 +1,259 @@
+#include "bench_baseline.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const double BenchBaseline::ALPHA = 0.01;
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    const size_t n = values.size();
+    return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+void BenchBaseline::add(const std::string& metric, double milliseconds) {
+    std::string name = metric;
+    std::replace(name.begin(), name.end(), ' ', '_');
+    for (Metric& existing : metrics) {
+        if (existing.name == name) {
+            existing.samples.push_back(milliseconds);
+            return;
+        }
+    }
+    Metric added;
+    added.name = name;
+    added.samples.push_back(milliseconds);
+    metrics.push_back(added);
+}
+
+// === FILES ===
+
+bool BenchBaseline::save(const std::string& path, const std::string& comment, std::string& error) const {
+    std::ofstream file(path.c_str());
+    if (!file) {
+        error = "cannot create " + path;
+        return false;
+    }
+    file << "# " << comment << "\n";
+    char text[32];
+    for (const Metric& metric : metrics) {
+        file << metric.name;
+        for (double sample : metric.samples) {
+            snprintf(text, sizeof(text), " %.6g", sample);
+            file << text;
+        }
+        file << "\n";
+    }
+    file.close();
+    if (!file) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool BenchBaseline::load(const std::string& path, std::string& error) {
+    metrics.clear();
+    std::ifstream file(path.c_str());
+    if (!file) {
+        error = "no baseline at " + path;
+        return false;
+    }
+    std::string line;
+    int number = 0;
+    while (std::getline(file, line)) {
+        number++;
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream words(line);
+        Metric metric;
+        words >> metric.name;
+        double sample;
+        while (words >> sample) {
+            metric.samples.push_back(sample);
+        }
+        if (!words.eof() || metric.samples.empty()) {
+            error = path + ": line " + std::to_string(number) + " is not a metric and its samples";
+            metrics.clear();
+            return false;
+        }
+        metrics.push_back(metric);
+    }
+    return true;
+}
+
+// === COMPARISON ===
+
+double BenchBaseline::mannWhitney(const std::vector<double>& earlier, const std::vector<double>& later) {
+    const size_t n1 = earlier.size();
+    const size_t n2 = later.size();
+    if (n1 == 0 || n2 == 0) return 1.0;
+    // Both samples ranked together, ties at their mean rank
+    std::vector<std::pair<double, bool>> pooled;
+    pooled.reserve(n1 + n2);
+    for (double value : earlier) pooled.push_back(std::make_pair(value, false));
+    for (double value : later) pooled.push_back(std::make_pair(value, true));
+    std::sort(pooled.begin(), pooled.end());
+    const double n = (double)pooled.size();
+    double later_ranks = 0.0;
+    double ties = 0.0; // Sum of t^3 - t over the runs of t equal values
+    for (size_t i = 0; i < pooled.size();) {
+        size_t end = i + 1;
+        while (end < pooled.size() && pooled[end].first == pooled[i].first) end++;
+        const double rank = 0.5 * (i + 1 + end);
+        for (size_t k = i; k < end; k++) {
+            if (pooled[k].second) later_ranks += rank;
+        }
+        const double t = (double)(end - i);
+        ties += t * t * t - t;
+        i = end;
+    }
+    const double u = later_ranks - 0.5 * n2 * (n2 + 1.0);
+    const double mean = 0.5 * n1 * n2;
+    const double variance = n1 * n2 / 12.0 * ((n + 1.0) - ties / (n * (n - 1.0)));
+    if (variance <= 0.0) return 0.5;
+    // With the continuity correction
+    const double z = (u - mean - 0.5) / std::sqrt(variance);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+std::vector<BenchBaseline::Comparison> BenchBaseline::compare(const BenchBaseline& run, double threshold) const {
+    std::vector<Comparison> comparisons;
+    for (const Metric& metric : run.metrics) {
+        const Metric* stored = nullptr;
+        for (const Metric& candidate : metrics) {
+            if (candidate.name == metric.name) stored = &candidate;
+        }
+        if (!stored || (int)stored->samples.size() < MIN_SAMPLES || (int)metric.samples.size() < MIN_SAMPLES) continue;
+        Comparison comparison;
+        comparison.name = metric.name;
+        comparison.baseline_median = median(stored->samples);
+        comparison.median = median(metric.samples);
+        comparison.change = comparison.baseline_median > 0.0 ? comparison.median / comparison.baseline_median - 1.0 : 0.0;
+        comparison.p_value = mannWhitney(stored->samples, metric.samples);
+        comparison.regressed = comparison.p_value < ALPHA && comparison.change > threshold;
+        comparison.improved = mannWhitney(metric.samples, stored->samples) < ALPHA && comparison.change < -threshold;
+        comparisons.push_back(comparison);
+    }
+    return comparisons;
+}
+
+// === MACHINE PROFILES ===
+
+std::string BenchBaseline::machineProfile() {
+    std::string host;
+#if defined(_WIN32)
+    const char* name = getenv("COMPUTERNAME");
+    if (name) host = name;
+#else
+    char name[256];
+    if (gethostname(name, sizeof(name)) == 0) {
+        name[sizeof(name) - 1] = '\0';
+        host = name;
+    }
+#endif
+    if (host.empty()) host = "unknown";
+    for (char& c : host) {
+        if (!isalnum((unsigned char)c) && c != '-' && c != '.') c = '_';
+    }
+    return host + "-" + std::to_string(std::thread::hardware_concurrency()) + "t";
+}
+
+std::string BenchBaseline::path(const std::string& directory, const std::string& profile,
+                                const std::string& benchmark) {
+    return directory + "/" + profile + "/" + benchmark + ".baseline";
+}
+
+// A directory unless it exists already
+static bool makeDirectory(const std::string& path) {
+#if defined(_WIN32)
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+// === OPTIONS ===
+
+BenchBaselineOptions::BenchBaselineOptions()
+    : directory("bench_baselines"), save(false), compare(false), threshold(0.05) {}
+
+bool BenchBaselineOptions::parse(int argc, char** argv, int& i) {
+    const std::string arg = argv[i];
+    if (arg == "--baseline-dir" && i + 1 < argc) directory = argv[++i];
+    else if (arg == "--machine" && i + 1 < argc) machine = argv[++i];
+    else if (arg == "--save-baseline") save = true;
+    else if (arg == "--compare") compare = true;
+    else if (arg == "--threshold" && i + 1 < argc) threshold = std::max(0.0, atof(argv[++i]) / 100.0);
+    else return false;
+    return true;
+}
+
+const char* BenchBaselineOptions::usage() {
+    return "[--baseline-dir DIR] [--machine NAME] [--save-baseline] [--compare] [--threshold PCT]";
+}
+
+int BenchBaselineOptions::finish(const std::string& benchmark, const BenchBaseline& run, std::ostream& out) const {
+    if (!save && !compare) return 0;
+    const std::string profile = machine.empty() ? BenchBaseline::machineProfile() : machine;
+    const std::string file = BenchBaseline::path(directory, profile, benchmark);
+    int status = 0;
+    
+    if (compare) {
+        BenchBaseline baseline;
+        std::string error;
+        if (!baseline.load(file, error)) {
+            out << "Cannot compare: " << error << std::endl;
+            return 1;
+        }
+        const std::vector<BenchBaseline::Comparison> comparisons = baseline.compare(run, threshold);
+        int regressions = 0;
+        char text[256];
+        out << "Against " << file << " (p < " << BenchBaseline::ALPHA << ", slower by more than "
+            << threshold * 100.0 << "%):" << std::endl;
+        for (const BenchBaseline::Comparison& comparison : comparisons) {
+            snprintf(text, sizeof(text), "  %-36s %10.4f -> %10.4f ms %+7.1f%%  p %.4f%s", comparison.name.c_str(),
+                     comparison.baseline_median, comparison.median, comparison.change * 100.0, comparison.p_value,
+                     comparison.regressed ? "  REGRESSED" : comparison.improved ? "  faster" : "");
+            out << text << std::endl;
+            if (comparison.regressed) regressions++;
+        }
+        if (comparisons.size() < run.getMetrics().size()) {
+            out << "  " << run.getMetrics().size() - comparisons.size() << " metrics not in the baseline or with fewer than "
+                << BenchBaseline::MIN_SAMPLES << " samples a side, not tested" << std::endl;
+        }
+        if (regressions > 0) {
+            out << regressions << " of " << comparisons.size() << " metrics regressed" << std::endl;
+            status = BENCH_REGRESSED;
+        }
+    }
+    
+    // A regressed run doesn't replace the baseline it failed against
+    if (save && status == 0) {
+        std::string error;
+        if (!makeDirectory(directory) || !makeDirectory(directory + "/" + profile)) {
+            out << "Cannot create " << directory << "/" << profile << ": " << strerror(errno) << std::endl;
+            return 1;
+        }
+        if (!run.save(file, benchmark + " baseline, machine " + profile, error)) {
+            out << "Cannot save the baseline: " << error << std::endl;
+            return 1;
+        }
+        out << "Saved the baseline to " << file << std::endl;
+    }
+    return status;
+}
@@ -0,0 +1,95 @@
+#ifndef BENCH_BASELINE_H
+#define BENCH_BASELINE_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Stored benchmark baselines and the regression check against them, for
+// tree_bench, png_bench and tree_demo --bench. A run keeps every raw sample
+// of each metric (milliseconds, lower is better) and can be saved as the
+// baseline of its machine profile, a directory per machine under the
+// baseline directory, so numbers from different machines are never
+// compared. A later run is checked metric by metric against the stored
+// samples with a one-sided Mann-Whitney U test (the normal approximation,
+// tie-corrected): a metric regresses when it is significantly slower and
+// its median also slowed by more than the threshold, so neither a noisy
+// few percent nor a small but consistent shift fails a run alone.
+//
+// A baseline file is text: a comment line, then a metric per line, its
+// name (no spaces) followed by its samples
+class BenchBaseline {
+public:
+    struct Metric {
+        std::string name;
+        std::vector<double> samples;
+    };
+    
+    // One metric's comparison
+    struct Comparison {
+        std::string name;
+        double baseline_median;
+        double median;
+        double change;  // median / baseline_median - 1
+        double p_value; // That a sample this slow is chance
+        bool regressed;
+        bool improved;  // As significantly faster
+    };
+    
+    // Significance the test must reach either way
+    static const double ALPHA;
+    // Fewer samples than this on either side and a metric isn't tested:
+    // with fewer, no outcome reaches ALPHA
+    static const int MIN_SAMPLES = 5;
+    
+    // A sample of metric (spaces in the name become _), added in order
+    void add(const std::string& metric, double milliseconds);
+    const std::vector<Metric>& getMetrics() const { return metrics; }
+    bool isEmpty() const { return metrics.empty(); }
+    
+    bool save(const std::string& path, const std::string& comment, std::string& error) const;
+    bool load(const std::string& path, std::string& error);
+    
+    // Every metric of run also in this baseline with enough samples
+    std::vector<Comparison> compare(const BenchBaseline& run, double threshold) const;
+    
+    // The one-sided Mann-Whitney p-value that later is stochastically
+    // greater than earlier: small when later is slower
+    static double mannWhitney(const std::vector<double>& earlier, const std::vector<double>& later);
+    // This machine: its host name and hardware thread count, as a
+    // directory name
+    static std::string machineProfile();
+    // directory/profile/benchmark.baseline
+    static std::string path(const std::string& directory, const std::string& profile, const std::string& benchmark);
+
+private:
+    std::vector<Metric> metrics;
+};
+
+// The baseline options every benchmark takes:
+//   --baseline-dir DIR   where the machine profiles are (bench_baselines)
+//   --machine NAME       the profile (BenchBaseline::machineProfile())
+//   --save-baseline      store this run as the profile's baseline
+//   --compare            check this run against it
+//   --threshold PCT      the median slowdown a regression needs (5)
+struct BenchBaselineOptions {
+    std::string directory;
+    std::string machine;
+    bool save;
+    bool compare;
+    double threshold; // As a share
+    
+    BenchBaselineOptions();
+    // Take argv[i] and its value if it is one of the options
+    bool parse(int argc, char** argv, int& i);
+    static const char* usage();
+    
+    // Compare, then save unless that found a regression, as asked,
+    // reporting to out. 0, 1 when a baseline can't be read or written,
+    // BENCH_REGRESSED when a metric regressed
+    int finish(const std::string& benchmark, const BenchBaseline& run, std::ostream& out) const;
+};
+
+static const int BENCH_REGRESSED = 2; // The exit status of a regressed run
+
+#endif // BENCH_BASELINE_H
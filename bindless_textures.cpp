@@ -0,0 +1,100 @@
+#include "bindless_textures.h"
+#include "logging.h"
+#include "memory_stats.h"
+#include "profiler.h"
+#include "texture_array.h"
+#include <algorithm>
+
+bool BindlessTextures::isSupported() {
+    return glewIsSupported("GL_ARB_bindless_texture") != 0;
+}
+
+bool BindlessTextures::create(const std::vector<std::string>& files, float anisotropy, int max_size) {
+    if (!create(files.size())) return false;
+    PROFILE_SCOPE("BindlessTextures::create");
+    GLint limit = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+    max_size = std::min(max_size, (int)limit);
+    
+    for (size_t k = 0; k < files.size(); k++) {
+        // addPng reports an unreadable file
+        int width = 1, height = 1;
+        TextureArrayBuilder::readPngSize(files[k].c_str(), width, height);
+        TextureArrayBuilder builder(std::min(width, max_size), std::min(height, max_size));
+        builder.addPng(files[k].c_str());
+        setTexture(k, builder.upload(anisotropy));
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return true;
+}
+
+bool BindlessTextures::create(int count) {
+    if (!isSupported() || count < 1 || count > MAX_TEXTURES) return false;
+    release();
+    textures.assign(count, 0);
+    handles.assign(count, 0);
+    std::vector<Handle> staging(MAX_TEXTURES);
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, staging.size() * sizeof(Handle), staging.data(), GL_DYNAMIC_DRAW);
+    MemoryStats::trackBuffer(ubo, staging.size() * sizeof(Handle), "materials");
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+    return true;
+}
+
+void BindlessTextures::setTexture(int slot, GLuint texture) {
+    // The sampling state is frozen once a handle exists
+    Handle entry;
+    entry.handle = glGetTextureHandleARB(texture);
+    entry.pad = 0;
+    glMakeTextureHandleResidentARB(entry.handle);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, slot * sizeof(Handle), sizeof(Handle), &entry);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    if (textures[slot] != 0) {
+        // Draws already issued may still sample it
+        Retired old = { textures[slot], handles[slot], glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) };
+        retired.push_back(old);
+    }
+    textures[slot] = texture;
+    handles[slot] = entry.handle;
+}
+
+void BindlessTextures::collectRetired() {
+    size_t kept = 0;
+    for (size_t r = 0; r < retired.size(); r++) {
+        if (glClientWaitSync(retired[r].fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            retired[kept++] = retired[r];
+            continue;
+        }
+        glDeleteSync(retired[r].fence);
+        releaseTexture(retired[r].texture, retired[r].handle);
+    }
+    retired.resize(kept);
+}
+
+void BindlessTextures::releaseTexture(GLuint texture, GLuint64 handle) {
+    glMakeTextureHandleNonResidentARB(handle);
+    MemoryStats::forgetTextures(1, &texture);
+    glDeleteTextures(1, &texture);
+}
+
+// At shutdown, or before a new create(): nothing draws from them any more
+void BindlessTextures::release() {
+    for (const Retired& old : retired) {
+        glDeleteSync(old.fence);
+        releaseTexture(old.texture, old.handle);
+    }
+    retired.clear();
+    for (size_t k = 0; k < textures.size(); k++) {
+        if (textures[k] != 0) releaseTexture(textures[k], handles[k]);
+    }
+    textures.clear();
+    handles.clear();
+    if (ubo != 0) {
+        MemoryStats::forgetBuffers(1, &ubo);
+        glDeleteBuffers(1, &ubo);
+        ubo = 0;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef BINDLESS_TEXTURES_H
+#define BINDLESS_TEXTURES_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+// The material textures sampled by handle (GL_ARB_bindless_texture)
+// instead of as layers of one array: every image becomes its own
+// single-layer array texture at its own size, made resident once, and the
+// handles go to a uniform buffer that f_simplest.glsl's BINDLESS variants
+// index by the material's layer. Nothing is bound per draw or per frame,
+// and images of different sizes need no resampling to a common one.
+// Without the extension the texture array (texture_array.h) is used.
+//
+// A slot's texture may be replaced while the program runs (texture
+// streaming, texture_streaming.h): the handle in the buffer changes and
+// the old texture is released once a fence says the GPU is done with the
+// frames that may still sample it
+class BindlessTextures {
+private:
+    // One std140 uvec4 of the MaterialTextureData block
+    struct Handle {
+        GLuint64 handle;
+        GLuint64 pad;
+    };
+    struct Retired {
+        GLuint texture;
+        GLuint64 handle;
+        GLsync fence;
+    };
+    
+    GLuint ubo;
+    std::vector<GLuint> textures;
+    std::vector<GLuint64> handles;
+    std::vector<Retired> retired;
+    
+    void releaseTexture(GLuint texture, GLuint64 handle);
+    
+    BindlessTextures(const BindlessTextures&);
+    BindlessTextures& operator=(const BindlessTextures&);
+
+public:
+    static const GLuint BINDING = 3;
+    static const int MAX_TEXTURES = 64; // The block's array length
+    static const char* blockName() { return "MaterialTextureData"; }
+    
+    BindlessTextures() : ubo(0) {}
+    
+    static bool isSupported();
+    // Decode the PNGs, in layer order, each at its own size up to max_size
+    // on either side, and make them resident. A file that can't be read
+    // still takes its slot, as a transparent black texel. False (nothing
+    // created) without the extension or with more than MAX_TEXTURES files
+    bool create(const std::vector<std::string>& files, float anisotropy, int max_size = 4096);
+    // count empty slots, each to be filled by setTexture() before a draw
+    // samples it
+    bool create(int count);
+    void release();
+    bool isCreated() const { return ubo != 0; }
+    
+    // Make texture, a single-layer array texture with its sampling state
+    // set, slot's, retiring the one before
+    void setTexture(int slot, GLuint texture);
+    // Release the retired textures the GPU is done with; once a frame
+    void collectRetired();
+    
+    int getCount() const { return textures.size(); }
+    const std::vector<GLuint>& getTextures() const { return textures; }
+};
+
+#endif // BINDLESS_TEXTURES_H
@@ -0,0 +1,132 @@
+#include "branch_grid.h"
+#include <algorithm>
+#include <cmath>
+
+static const size_t INITIAL_BUCKETS = 1024;
+
+static uint32_t hashCell(int x, int y, int z) {
+    return (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ (uint32_t)z * 83492791u;
+}
+
+// Squared distance between the segments [p0, p1] and [q0, q1] (closest
+// points by clamped parameters, Ericson 5.1.9)
+static float segmentDistance2(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& q0, const glm::vec3& q1) {
+    const float epsilon = 1e-12f;
+    glm::vec3 d1 = p1 - p0;
+    glm::vec3 d2 = q1 - q0;
+    glm::vec3 r = p0 - q0;
+    float a = glm::dot(d1, d1);
+    float e = glm::dot(d2, d2);
+    float f = glm::dot(d2, r);
+    float s = 0.0f, t = 0.0f;
+    if (a <= epsilon && e <= epsilon) {
+        return glm::dot(r, r);
+    }
+    if (a <= epsilon) {
+        t = glm::clamp(f / e, 0.0f, 1.0f);
+    } else {
+        float c = glm::dot(d1, r);
+        if (e <= epsilon) {
+            s = glm::clamp(-c / a, 0.0f, 1.0f);
+        } else {
+            float b = glm::dot(d1, d2);
+            float denominator = a * e - b * b;
+            s = denominator > epsilon ? glm::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            } else if (t > 1.0f) {
+                t = 1.0f;
+                s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+    glm::vec3 gap = (p0 + d1 * s) - (q0 + d2 * t);
+    return glm::dot(gap, gap);
+}
+
+BranchGrid::BranchGrid() : query(0), cell_size(1.0f) {}
+
+void BranchGrid::reset(float size) {
+    cell_size = std::max(size, 1e-3f);
+    capsules.clear();
+    entry_capsule.clear();
+    entry_hash.clear();
+    entry_next.clear();
+    visited.clear();
+    bucket_head.assign(INITIAL_BUCKETS, -1);
+    query = 0;
+}
+
+void BranchGrid::cellRange(const glm::vec3& start, const glm::vec3& end, float radius, glm::ivec3& lo,
+                           glm::ivec3& hi) const {
+    glm::vec3 low = glm::min(start, end) - glm::vec3(radius);
+    glm::vec3 high = glm::max(start, end) + glm::vec3(radius);
+    lo = glm::ivec3(glm::floor(low / cell_size));
+    hi = glm::ivec3(glm::floor(high / cell_size));
+}
+
+void BranchGrid::link(int entry) {
+    uint32_t bucket = entry_hash[entry] & (bucket_head.size() - 1);
+    entry_next[entry] = bucket_head[bucket];
+    bucket_head[bucket] = entry;
+}
+
+void BranchGrid::rehash(size_t bucket_count) {
+    bucket_head.assign(bucket_count, -1);
+    for (size_t e = 0; e < entry_hash.size(); e++) {
+        link(e);
+    }
+}
+
+int BranchGrid::add(const glm::vec3& start, const glm::vec3& end, float radius) {
+    if (bucket_head.empty()) bucket_head.assign(INITIAL_BUCKETS, -1);
+    int id = capsules.size();
+    Capsule capsule = {start, radius, end};
+    capsules.push_back(capsule);
+    visited.push_back(0);
+    glm::ivec3 lo, hi;
+    cellRange(start, end, radius, lo, hi);
+    for (int z = lo.z; z <= hi.z; z++) {
+        for (int y = lo.y; y <= hi.y; y++) {
+            for (int x = lo.x; x <= hi.x; x++) {
+                entry_capsule.push_back(id);
+                entry_hash.push_back(hashCell(x, y, z));
+                entry_next.push_back(-1);
+                link(entry_hash.size() - 1);
+            }
+        }
+    }
+    // Keep the load factor at or below one half
+    if (entry_hash.size() * 2 > bucket_head.size()) rehash(bucket_head.size() * 2);
+    return id;
+}
+
+bool BranchGrid::overlaps(const glm::vec3& start, const glm::vec3& end, float radius, int ignore) {
+    if (capsules.empty()) return false;
+    // A fresh stamp per query; on wrap-around the old stamps are cleared
+    if (++query == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        query = 1;
+    }
+    glm::ivec3 lo, hi;
+    cellRange(start, end, radius, lo, hi);
+    for (int z = lo.z; z <= hi.z; z++) {
+        for (int y = lo.y; y <= hi.y; y++) {
+            for (int x = lo.x; x <= hi.x; x++) {
+                // Colliding buckets only add distance checks
+                uint32_t hash = hashCell(x, y, z);
+                for (int e = bucket_head[hash & (bucket_head.size() - 1)]; e >= 0; e = entry_next[e]) {
+                    int c = entry_capsule[e];
+                    if (entry_hash[e] != hash || visited[c] == query || c == ignore) continue;
+                    visited[c] = query;
+                    const Capsule& other = capsules[c];
+                    float reach = radius + other.radius;
+                    if (segmentDistance2(start, end, other.start, other.end) < reach * reach) return true;
+                }
+            }
+        }
+    }
+    return false;
+}
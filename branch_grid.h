@@ -0,0 +1,52 @@
+#ifndef BRANCH_GRID_H
+#define BRANCH_GRID_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Uniform grid of branch capsules (a segment swept by a radius) for the
+// generator's overlap test (Tree::setBranchAvoidance). A capsule goes into
+// every cell its bounds touch; the cells are hashed into a power-of-two
+// bucket table with per-bucket lists, like SpaceColonization's node hash,
+// so a query visits the few cells around the candidate whatever the tree's
+// size. Cells about one branch of the deepest generation wide keep those
+// lists short
+class BranchGrid {
+public:
+    BranchGrid();
+    
+    // Empty the grid for a new tree, keeping the storage
+    void reset(float cell_size);
+    // Add a capsule; returns its id, for overlaps()'s ignore
+    int add(const glm::vec3& start, const glm::vec3& end, float radius);
+    // True when the capsule comes closer than the sum of the radii to one
+    // already added, other than the capsule ignore (-1 = none)
+    bool overlaps(const glm::vec3& start, const glm::vec3& end, float radius, int ignore);
+    
+    int getCount() const { return capsules.size(); }
+
+private:
+    struct Capsule {
+        glm::vec3 start;
+        float radius;
+        glm::vec3 end;
+    };
+    std::vector<Capsule> capsules;
+    // Cell entries: the capsule, its cell's hash (to rehash) and the next
+    // entry of its bucket
+    std::vector<int> entry_capsule;
+    std::vector<uint32_t> entry_hash;
+    std::vector<int> entry_next;
+    std::vector<int> bucket_head;
+    // A query's visit stamp per capsule, so one spanning cells is tested once
+    std::vector<uint32_t> visited;
+    uint32_t query;
+    float cell_size;
+    
+    void cellRange(const glm::vec3& start, const glm::vec3& end, float radius, glm::ivec3& lo, glm::ivec3& hi) const;
+    void link(int entry);
+    void rehash(size_t bucket_count);
+};
+
+#endif // BRANCH_GRID_H
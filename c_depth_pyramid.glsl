@@ -0,0 +1,40 @@
+#version 430
+
+/*
+ * DEPTH PYRAMID COMPUTE SHADER
+ *
+ * One level of DepthPyramid per dispatch: level 0 copies the frame's depth,
+ * every later texel takes the farthest of the 2 x 2 texels below it. Where
+ * the level below has an odd size its last row or column has no partner,
+ * so the last texel of this level covers it as well and stays conservative.
+ */
+
+layout(local_size_x = 8, local_size_y = 8) in; // DepthPyramid::GROUP_SIZE
+
+uniform sampler2D depthSource; // The frame's depth, read for level 0
+uniform int sourceLevel;       // The level read, -1 = depthSource
+layout(binding = 0, r32f) readonly uniform image2D source;
+layout(binding = 1, r32f) writeonly uniform image2D target;
+
+void main(void) {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(target);
+    if (texel.x >= size.x || texel.y >= size.y) return;
+    
+    float farthest;
+    if (sourceLevel < 0) {
+        farthest = texelFetch(depthSource, texel, 0).r;
+    } else {
+        ivec2 sourceSize = imageSize(source);
+        ivec2 last = ivec2(texel.x == size.x - 1 && (sourceSize.x & 1) != 0 ? 2 : 1,
+                           texel.y == size.y - 1 && (sourceSize.y & 1) != 0 ? 2 : 1);
+        farthest = 0.0;
+        for (int y = 0; y <= last.y; y++) {
+            for (int x = 0; x <= last.x; x++) {
+                ivec2 below = min(texel * 2 + ivec2(x, y), sourceSize - 1);
+                farthest = max(farthest, imageLoad(source, below).r);
+            }
+        }
+    }
+    imageStore(target, texel, vec4(farthest));
+}
@@ -0,0 +1,141 @@
+#version 430
+
+/*
+ * FOREST CULLING COMPUTE SHADER
+ *
+ * ForestScene::select on the GPU: one invocation per forest instance culls
+ * its bounding sphere against the frustum, picks its level of detail from
+ * its size on screen and appends it to the run of its archetype and level
+ * in the visible buffer. The runs' instance counts are the instanceCount of
+ * the indirect draw commands, so the frame draws with a fixed number of
+ * glMultiDrawElementsIndirect calls whatever the forest's size.
+ *
+ * With occlusion culling an instance the frustum keeps is also tested
+ * against the last frame's DepthPyramid: its box, projected as that frame
+ * saw it, is hidden when its nearest depth lies behind the farthest depth
+ * of the pyramid texels covering it. A box reaching off that frame's
+ * screen or behind its eye is kept.
+ *
+ * ForestScene defines LEVELS (TreeLod::LEVELS) and VIEWS
+ * (ViewFrustum::MAX_VIEWS) and resets every command's instanceCount to 0
+ * before the dispatch. An instance is kept when inside any of the views.
+ */
+
+layout(local_size_x = 64) in;
+
+// ForestInstance (forest_scene.h), 32 bytes
+struct Instance {
+    vec4 placement; // (position, scale)
+    vec3 params;    // (yaw, hue shift, growth offset)
+    int archetype;
+};
+
+// DrawElementsIndirectCommand
+struct Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance; // Start of the command's run in the visible buffer
+};
+
+layout(std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout(std430, binding = 1) readonly buffer Bounds { vec4 bounds[]; }; // Per archetype: (center, radius)
+layout(std430, binding = 2) writeonly buffer Visible { Instance visible[]; };
+// The wood commands, LEVELS per archetype, then the leaves' in the same order
+layout(std430, binding = 3) buffer Commands { Command commands[]; };
+
+uniform int instanceCount;
+uniform int archetypeCount;
+uniform int cullFrustum; // 0 = keep every instance
+uniform vec4 frustumPlanes[6 * VIEWS]; // ViewFrustum::planes, VIEWS = ViewFrustum::MAX_VIEWS
+uniform int frustumViews; // ViewFrustum::view_count: kept when inside any
+uniform vec3 eye;
+uniform float tanHalfFov;
+uniform float lodBias;
+uniform vec4 fog; // DistanceFog::getParameters; view distance 0 = no fog
+uniform float levelSizes[LEVELS - 1]; // TreeLod::setLevelSizes
+uniform int occlusionCulling; // 0 = no pyramid to test against
+uniform sampler2D depthPyramid;
+uniform int pyramidLevels;
+uniform mat4 pyramidViewProjection; // The frame the pyramid was built from
+
+// DistanceFog::visibility: the share of a tree the fog leaves at distance
+float fogVisibility(float distance) {
+    if (fog.x <= 0.0) return 1.0;
+    float fogged = 1.0 - exp(-fog.z * max(distance - fog.y, 0.0));
+    return 1.0 - max(fogged, smoothstep(0.9 * fog.x, fog.x, distance));
+}
+
+// Whether the box (center, half size radius) is hidden in the pyramid
+bool occluded(vec3 center, float radius) {
+    vec2 low = vec2(1.0);
+    vec2 high = vec2(0.0);
+    float nearest = 1.0;
+    for (int k = 0; k < 8; k++) {
+        vec3 corner = center + radius * vec3((k & 1) != 0 ? 1.0 : -1.0, (k & 2) != 0 ? 1.0 : -1.0,
+                                             (k & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = pyramidViewProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0) return false;
+        vec3 ndc = clip.xyz / clip.w;
+        low = min(low, ndc.xy * 0.5 + 0.5);
+        high = max(high, ndc.xy * 0.5 + 0.5);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    if (nearest < 0.0 || any(lessThan(low, vec2(0.0))) || any(greaterThan(high, vec2(1.0)))) return false;
+    
+    // The level where the box spans at most 2 x 2 texels
+    vec2 extent = (high - low) * vec2(textureSize(depthPyramid, 0));
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, pyramidLevels - 1);
+    ivec2 size = textureSize(depthPyramid, level);
+    ivec2 first = min(ivec2(low * vec2(size)), size - 1);
+    ivec2 last = min(ivec2(high * vec2(size)), size - 1);
+    float farthest = max(max(texelFetch(depthPyramid, first, level).r, texelFetch(depthPyramid, ivec2(last.x, first.y), level).r),
+                         max(texelFetch(depthPyramid, ivec2(first.x, last.y), level).r, texelFetch(depthPyramid, last, level).r));
+    return nearest > farthest;
+}
+
+void main(void) {
+    int i = int(gl_GlobalInvocationID.x);
+    if (i >= instanceCount) return;
+    Instance instance = instances[i];
+    if (instance.archetype < 0 || instance.archetype >= archetypeCount) return;
+    
+    // The bounding sphere turned as the FOREST variant turns the tree
+    vec4 sphere = bounds[instance.archetype];
+    float c = cos(instance.params.x);
+    float s = sin(instance.params.x);
+    vec3 offset = sphere.xyz * instance.placement.w;
+    vec3 center = instance.placement.xyz + vec3(c * offset.x + s * offset.z, offset.y, c * offset.z - s * offset.x);
+    float radius = sphere.w * instance.placement.w;
+    
+    // The sphere's box against each view's planes, as ViewFrustum::classify
+    if (cullFrustum != 0) {
+        bool inside = false;
+        for (int view = 0; view < frustumViews && !inside; view++) {
+            inside = true;
+            for (int p = view * 6; p < view * 6 + 6; p++) {
+                vec4 plane = frustumPlanes[p];
+                if (dot(plane.xyz, center) + dot(abs(plane.xyz), vec3(radius)) + plane.w < 0.0) inside = false;
+            }
+        }
+        if (!inside) return;
+    }
+    if (occlusionCulling != 0 && occluded(center, radius)) return;
+    
+    // TreeLod::projectedSize, as much as the fog leaves, and selectLevel; inside the bounds is level 0
+    int level = 0;
+    float distance = length(eye - center);
+    if (distance > radius) {
+        float size = radius / (distance * tanHalfFov) / lodBias * fogVisibility(distance);
+        level = LEVELS - 1;
+        for (int k = LEVELS - 2; k >= 0; k--) {
+            if (size >= levelSizes[k]) level = k;
+        }
+    }
+    
+    int command = instance.archetype * LEVELS + level;
+    uint slot = atomicAdd(commands[command].instanceCount, 1u);
+    atomicAdd(commands[archetypeCount * LEVELS + command].instanceCount, 1u);
+    visible[commands[command].baseInstance + slot] = instance;
+}
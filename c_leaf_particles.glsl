@@ -0,0 +1,192 @@
+#version 430
+
+/*
+ * FALLING LEAF COMPUTE SHADER
+ *
+ * Leaves that leave a tree, carried down as particles. EMIT takes them
+ * from LeafInstance records, the instanced leaves' own buffers: with
+ * seasonal set only the leaves whose drop time (v_simplest.glsl's
+ * seasonalLeaf, from the same key) the season passed this frame, otherwise
+ * every record, such as the leaves of a pruned branch. Each takes the next
+ * slot of a ring, taking over the oldest particle when the ring is full.
+ *
+ * SIMULATE steps every particle: gravity, and drag against the wind that
+ * is strong across the leaf's face and weak along it, so a tilted leaf
+ * glides and swerves, while it tumbles about its spin axis. A leaf that
+ * reaches the ground lies flat, then shrinks away. The live ones are
+ * appended as LeafInstance records to the buffer the leaf quad is
+ * instanced from, counted into its indirect draw command.
+ *
+ * LeafParticles (leaf_particles.h) owns the buffers and issues the passes.
+ */
+
+const int PASS_EMIT = 0;     // One invocation per source record
+const int PASS_SIMULATE = 1; // One per particle slot
+
+const float GRAVITY = 9.81;
+const float FACE_DRAG = 6.0;  // Per metre: about 1.3 m/s falling flat
+const float EDGE_DRAG = 0.6;  // About 4 m/s edge on
+const float AIR_SPEED = 2.5;  // Wind speed at strength 1
+const float MAX_STEP = 1.0 / 60.0;
+const int MAX_STEPS = 4;
+const float REST_SECONDS = 4.0; // On the ground before it shrinks away
+const float FADE_SECONDS = 1.5;
+const float MAX_AGE = 45.0;     // Blown out of the scene or caught: freed anyway
+
+layout(local_size_x = 64) in;
+
+// One falling leaf, 64 bytes
+struct Particle {
+    vec4 position; // (position, age in seconds; < 0 = free slot)
+    vec4 velocity; // (velocity, size)
+    vec4 facing;   // (unit normal, its autumn turn in 64ths + its shade of it)
+    vec4 spin;     // (angular velocity, seconds on the ground; 0 = aloft)
+};
+
+// LeafInstance (tree_simple.h) as six words, as c_tree_generate.glsl
+// writes them
+layout(std430, binding = 0) readonly buffer Sources { uint sources[]; };
+layout(std430, binding = 1) buffer Particles { Particle particles[]; };
+layout(std430, binding = 2) writeonly buffer Leaves { uint leaves[]; };
+layout(std430, binding = 3) buffer Counters {
+    uint count;         // DrawArraysIndirectCommand of the leaf quad
+    uint instanceCount; // Live particles, cleared before SIMULATE
+    uint first;
+    uint baseInstance;
+    uint emitted;       // Ever emitted: the ring's next slot
+};
+
+uniform int pass;
+uniform int capacity;    // Particle slots
+uniform int sourceCount;
+uniform mat4 sourceModel; // The source records' space -> world
+uniform int seasonal;
+uniform vec2 seasonRange; // (last frame's season, this one's)
+uniform float deltaTime;
+uniform float time;       // Scene clock, for the gusts
+uniform vec4 wind;        // FrameData's wind and windGusts
+uniform vec4 windGusts;
+// The terrain's height map (Terrain::bindHeights)
+uniform sampler2D heightMap;
+uniform vec4 terrainBounds;
+
+// v_simplest.glsl's hashRandom
+vec4 hashRandom(uint seed) {
+    vec4 result;
+    for (int i = 0; i < 4; i++) {
+        seed = seed * 747796405u + 2891336453u;
+        uint word = ((seed >> ((seed >> 28u) + 4u)) ^ seed) * 277803737u;
+        result[i] = float(((word >> 22u) ^ word) & 0xffffffu) / 16777216.0;
+    }
+    return result;
+}
+
+// v_simplest.glsl's terrainHeight, at the top level: a compute shader has
+// no derivatives to choose one by
+float groundHeight(vec2 p) {
+    vec2 uv = (p - terrainBounds.xy) / terrainBounds.z;
+    return textureLod(heightMap, (uv * terrainBounds.w + 0.5) / (terrainBounds.w + 1.0), 0.0).r;
+}
+
+// GL_INT_2_10_10_10_REV, to and from a unit normal
+uint packNormal(vec3 normal) {
+    ivec3 q = ivec3(round(clamp(normal, -1.0, 1.0) * 511.0)) & 0x3ff;
+    return uint(q.x) | (uint(q.y) << 10) | (uint(q.z) << 20);
+}
+
+vec3 unpackNormal(uint word) {
+    int w = int(word);
+    ivec3 q = ivec3(bitfieldExtract(w, 0, 10), bitfieldExtract(w, 10, 10), bitfieldExtract(w, 20, 10));
+    return max(vec3(q) / 511.0, vec3(-1.0));
+}
+
+// The season passed from range.x to range.y, wrapping through the new year
+bool passed(float at, vec2 range) {
+    if (range.y >= range.x) return at > range.x && at <= range.y;
+    return at > range.x || at <= range.y;
+}
+
+void emitLeaf(uint index) {
+    uint word = 6u * index;
+    vec3 position = vec3(uintBitsToFloat(sources[word]), uintBitsToFloat(sources[word + 1u]),
+                         uintBitsToFloat(sources[word + 2u]));
+    float size = uintBitsToFloat(sources[word + 4u]) * uintBitsToFloat(sources[word + 5u]);
+    if (size <= 0.0) return; // Not yet budded
+    // The key v_simplest.glsl's instanced leaves are scheduled by
+    uint key = floatBitsToUint(position.x) * 2654435761u ^ floatBitsToUint(position.y) * 40503u
+               ^ floatBitsToUint(position.z);
+    vec4 random = hashRandom(key);
+    float turnStart = 0.55 + 0.12 * random.y;
+    if (seasonal != 0 && !passed(turnStart + 0.08 + 0.1 * random.z, seasonRange)) return;
+    // It keeps the colour it had on the tree
+    float turn = floor(smoothstep(turnStart, turnStart + 0.08, seasonRange.y) * 64.0);
+    
+    uint slot = atomicAdd(emitted, 1u) % uint(capacity);
+    vec4 motion = hashRandom(key ^ 0x85ebca6bu) * 2.0 - 1.0;
+    vec3 axis = normalize(motion.xyz + vec3(0.0, 0.0, 1e-3));
+    float scale = length(sourceModel[0].xyz);
+    particles[slot].position = vec4((sourceModel * vec4(position, 1.0)).xyz, 0.0);
+    particles[slot].velocity = vec4(motion.xyz * vec3(0.3, 0.1, 0.3), size * scale);
+    particles[slot].facing = vec4(normalize(mat3(sourceModel) * unpackNormal(sources[word + 3u])),
+                                  turn + min(random.w, 0.999));
+    particles[slot].spin = vec4(axis * (2.0 + 3.0 * abs(motion.w)), 0.0);
+}
+
+void simulateLeaf(uint index) {
+    Particle p = particles[index];
+    if (p.position.w < 0.0) return;
+    p.position.w += deltaTime;
+    float fade = 1.0;
+    if (p.spin.w > 0.0) {
+        // Lying on the ground
+        p.spin.w += deltaTime;
+        fade = 1.0 - smoothstep(REST_SECONDS, REST_SECONDS + FADE_SECONDS, p.spin.w);
+    } else {
+        int steps = clamp(int(ceil(deltaTime / MAX_STEP)), 1, MAX_STEPS);
+        float dt = deltaTime / float(steps);
+        vec3 windDirection = vec3(wind.x, 0.0, wind.y);
+        for (int s = 0; s < steps; s++) {
+            // FrameData's gusts, as windGust in v_simplest.glsl
+            float phase = time * windGusts.x - dot(p.position.xz, wind.xy) * windGusts.y;
+            float gust = 1.0 + wind.w * (0.6 * sin(phase) + 0.4 * sin(phase * 2.3 + 1.7));
+            vec3 relative = p.velocity.xyz - windDirection * (wind.z * gust * AIR_SPEED);
+            vec3 n = p.facing.xyz;
+            vec3 across = n * dot(relative, n);
+            vec3 drag = (across * FACE_DRAG + (relative - across) * EDGE_DRAG) * length(relative);
+            p.velocity.xyz += (vec3(0.0, -GRAVITY, 0.0) - drag) * dt;
+            p.position.xyz += p.velocity.xyz * dt;
+            // Tumble, the faster the faster it moves through the air
+            vec3 turn = p.spin.xyz * (dt * (0.5 + length(relative)));
+            p.facing.xyz = normalize(n + cross(turn, n));
+        }
+        float ground = groundHeight(p.position.xz);
+        if (p.position.y <= ground) {
+            p.position.y = ground + 0.01;
+            p.velocity.xyz = vec3(0.0);
+            p.facing.xyz = vec3(0.0, 1.0, 0.0);
+            p.spin.w = max(deltaTime, 1e-3);
+        }
+    }
+    if (fade <= 0.0 || (p.spin.w == 0.0 && p.position.w > MAX_AGE)) {
+        particles[index].position.w = -1.0;
+        return;
+    }
+    particles[index] = p;
+    
+    uint word = 6u * atomicAdd(instanceCount, 1u);
+    leaves[word] = floatBitsToUint(p.position.x);
+    leaves[word + 1u] = floatBitsToUint(p.position.y);
+    leaves[word + 2u] = floatBitsToUint(p.position.z);
+    leaves[word + 3u] = packNormal(p.facing.xyz);
+    leaves[word + 4u] = floatBitsToUint(p.velocity.w * fade);
+    leaves[word + 5u] = floatBitsToUint(p.facing.w);
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (pass == PASS_EMIT) {
+        if (index < uint(sourceCount)) emitLeaf(index);
+    } else if (index < uint(capacity)) {
+        simulateLeaf(index);
+    }
+}
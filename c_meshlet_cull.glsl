@@ -0,0 +1,74 @@
+#version 430
+
+/*
+ * MESHLET CULLING COMPUTE SHADER
+ *
+ * TreeMeshlets::cull on the GPU: one invocation per meshlet of the tree's
+ * meshes writes the meshlet's indirect draw command, with the indices of
+ * its started pieces, or none when the meshlet cannot be seen: its
+ * bounding sphere lies outside the frustum, or every normal of its cone
+ * looks away from the eye (the wood only; leaves are drawn from both
+ * sides). A wood meshlet facing away is the far side of its tubes, behind
+ * their near side.
+ *
+ * The meshlets of the branch mesh come first, then the leaf mesh's, and
+ * the commands are in the same order.
+ */
+
+layout(local_size_x = 64) in;
+
+// TreeMeshlet (tree_meshlets.h), 48 bytes
+struct Meshlet {
+    vec4 sphere; // (center, radius) in the tree's space, radius 0 = nothing started
+    vec4 cone;   // (axis, sine of the half angle), 1 = never facing away
+    uvec4 range; // (first index, first piece, piece count, leaves)
+};
+
+// DrawElementsIndirectCommand
+struct Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+// Per piece in meshlet order: (its slot, end of its indices in the meshlet);
+// a meshlet's pieces are in slot order
+layout(std430, binding = 1) readonly buffer Pieces { uvec2 pieces[]; };
+layout(std430, binding = 2) writeonly buffer Commands { Command commands[]; };
+
+uniform int meshletCount;
+uniform int startedBranchSlots; // Tree::drawnBranchSlots
+uniform int startedLeafSlots;
+uniform vec4 frustumPlanes[6]; // ViewFrustum::planes
+uniform vec3 eye;
+
+void main(void) {
+    int i = int(gl_GlobalInvocationID.x);
+    if (i >= meshletCount) return;
+    Meshlet meshlet = meshlets[i];
+    
+    // The started pieces are a prefix
+    uint started = uint(meshlet.range.w != 0u ? startedLeafSlots : startedBranchSlots);
+    uint count = 0u;
+    for (uint p = 0u; p < meshlet.range.z; p++) {
+        uvec2 piece = pieces[meshlet.range.y + p];
+        if (piece.x >= started) break;
+        count = piece.y;
+    }
+    
+    // The sphere's box against each plane, as ViewFrustum::classify
+    vec3 center = meshlet.sphere.xyz;
+    float radius = meshlet.sphere.w;
+    for (int p = 0; p < 6 && count > 0u; p++) {
+        vec4 plane = frustumPlanes[p];
+        if (dot(plane.xyz, center) + dot(abs(plane.xyz), vec3(radius)) + plane.w < 0.0) count = 0u;
+    }
+    // Every face of the cone turned away from every point of the sphere
+    vec3 view = center - eye;
+    if (dot(view, meshlet.cone.xyz) >= meshlet.cone.w * length(view) + radius) count = 0u;
+    
+    commands[i] = Command(count, 1u, meshlet.range.x, 0, 0u);
+}
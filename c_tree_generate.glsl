@@ -0,0 +1,209 @@
+#version 430
+
+/*
+ * TREE GENERATION COMPUTE SHADER
+ *
+ * Tree::emitBranch and Tree::emitLeaves for many trees at once, written
+ * straight into the instance records the branch cylinders and leaf quads
+ * draw from. The branches double as the work list: generation g's are one
+ * contiguous range of the branch buffer, and one EXPAND pass gives every
+ * branch of the range its children (appended behind it) and its leaves.
+ * An ADVANCE pass then moves the range on to the children and writes the
+ * next pass's dispatch size and the draw commands, so the CPU only issues
+ * a fixed sequence of dispatches and never reads anything back.
+ *
+ * Draws come from a counter-based generator: draw k of a branch hashes
+ * (its path, k), and a child's path hashes its parent's with its index as
+ * the CPU's mixSeed does, so a tree's shape depends on its seed alone and
+ * not on the order the invocations run in. Trees come out fully grown.
+ *
+ * GpuTreeGenerator (gpu_trees.h) sizes the buffers from the trees' expected
+ * sizes; what does not fit is dropped and counted.
+ */
+
+const int PASS_SEED = 0;    // One invocation per tree: its trunk
+const int PASS_EXPAND = 1;  // One per branch of the range: children and leaves
+const int PASS_ADVANCE = 2; // One invocation: the next range and the commands
+
+// tree_simple.cpp's branching rules
+const int MIN_CHILDREN = 2;
+const int MAX_CHILDREN = 4;
+const int MIN_LEAVES = 6;
+const int MAX_LEAVES = 14;
+const float TRUNK_LENGTH = 3.0;
+const float TRUNK_RADIUS = 0.2;
+const float PI = 3.14159265;
+
+layout(local_size_x = 64) in;
+
+// GpuTreeInput (gpu_trees.h), 48 bytes
+struct TreeInput {
+    vec4 placement; // (position, scale)
+    vec4 shape;     // (yaw, angle variance in degrees, length reduction, radius reduction)
+    uvec4 growth;   // (seed, max generations, -, -)
+};
+
+// What EXPAND needs of a branch beyond its record, at the record's index
+struct Work {
+    vec4 direction; // (unit direction in tree space, unscaled length)
+    uvec4 key;      // (tree, generation, path, -)
+};
+
+// DrawElementsIndirectCommand
+struct ElementsCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+// DrawArraysIndirectCommand
+struct ArraysCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Trees { TreeInput trees[]; };
+layout(std430, binding = 1) buffer Works { Work works[]; };
+// BranchInstance (tree_simple.h): (start, radius), (end, growth)
+layout(std430, binding = 2) buffer Branches { vec4 branches[]; };
+// LeafInstance (tree_simple.h) as six words: a vec3 member would pad a
+// std430 struct to 32 bytes
+layout(std430, binding = 3) writeonly buffer Leaves { uint leaves[]; };
+layout(std430, binding = 4) buffer Counters {
+    uint branchCount;   // Allocated, capacity exceeded included
+    uint leafCount;
+    uint rangeFirst;    // The generation EXPAND works on
+    uint rangeEnd;
+    uvec3 dispatchSize; // EXPAND's glDispatchComputeIndirect
+    uint dropped;       // Branches and leaves that did not fit
+    ElementsCommand woodCommand;
+    ArraysCommand leafCommand;
+};
+
+uniform int pass;
+uniform int treeCount;
+uniform int branchCapacity; // Records the branch and work buffers hold
+uniform int leafCapacity;
+uniform int cylinderIndices; // Tree::BRANCH_SLOT_INDICES
+
+// PCG hash
+uint mixKey(uint v) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Draw k of a branch, uniform in [-1, 1)
+float draw(uint path, uint k) {
+    return float(mixKey(path ^ mixKey(k)) >> 8) / 8388608.0 - 1.0;
+}
+
+// (x, z) turned by yaw about +y, as ForestInstance's yaw turns a tree
+vec3 turn(vec3 v, float yaw) {
+    float c = cos(yaw);
+    float s = sin(yaw);
+    return vec3(c * v.x + s * v.z, v.y, c * v.z - s * v.x);
+}
+
+// GL_INT_2_10_10_10_REV of a unit normal, w = 0
+uint packNormal(vec3 normal) {
+    ivec3 q = ivec3(round(clamp(normal, -1.0, 1.0) * 511.0)) & 0x3ff;
+    return uint(q.x) | (uint(q.y) << 10) | (uint(q.z) << 20);
+}
+
+void writeBranch(uint index, vec3 start, vec3 direction, float len, float radius, uint tree, uint generation,
+                 uint path) {
+    float scale = trees[tree].placement.w;
+    branches[2u * index] = vec4(start, radius);
+    branches[2u * index + 1u] = vec4(start + direction * len * scale, 1.0);
+    works[index].direction = vec4(direction, len);
+    works[index].key = uvec4(tree, generation, path, 0u);
+}
+
+void seedTree(uint tree) {
+    vec4 placement = trees[tree].placement;
+    writeBranch(tree, placement.xyz, vec3(0.0, 1.0, 0.0), TRUNK_LENGTH, TRUNK_RADIUS * placement.w, tree, 0u,
+                mixKey(trees[tree].growth.x));
+}
+
+void expandBranch(uint index) {
+    Work work = works[index];
+    uint tree = work.key.x;
+    uint generation = work.key.y;
+    uint path = work.key.z;
+    TreeInput source = trees[tree];
+    vec3 end = branches[2u * index + 1u].xyz;
+    float radius = branches[2u * index].w;
+    
+    // Children: spread evenly round the branch, then jittered, 30 +- 20
+    // degrees above the horizontal
+    if (generation < source.growth.y) {
+        uint children = uint(MIN_CHILDREN) + mixKey(path) % uint(MAX_CHILDREN - MIN_CHILDREN + 1);
+        uint first = atomicAdd(branchCount, children);
+        if (first + children > uint(branchCapacity)) {
+            atomicAdd(dropped, children);
+        } else {
+            for (uint i = 0u; i < children; i++) {
+                float angle = float(i) / float(children) * 2.0 * PI
+                              + draw(path, 1u + 2u * i) * source.shape.y * PI / 180.0;
+                float elevation = (30.0 + draw(path, 2u + 2u * i) * 20.0) * PI / 180.0;
+                vec3 direction = vec3(sin(angle) * cos(elevation), sin(elevation), cos(angle) * cos(elevation));
+                writeBranch(first + i, end, turn(direction, source.shape.x), work.direction.w * source.shape.z,
+                            radius * source.shape.w, tree, generation + 1u, mixKey(path ^ mixKey(i + 1u)));
+            }
+        }
+    }
+    
+    // Leaves: clustered round the end from the secondary branches on
+    if (generation >= 2u) {
+        uint leafPath = mixKey(path ^ 0x9e3779b9u);
+        uint count = uint(MIN_LEAVES) + mixKey(leafPath) % uint(MAX_LEAVES - MIN_LEAVES + 1);
+        uint first = atomicAdd(leafCount, count);
+        if (first + count > uint(leafCapacity)) {
+            atomicAdd(dropped, count);
+            return;
+        }
+        float scale = source.placement.w;
+        for (uint j = 0u; j < count; j++) {
+            uint k = 1u + 7u * j;
+            vec3 offset = vec3(draw(leafPath, k) * 0.4, draw(leafPath, k + 1u) * 0.3, draw(leafPath, k + 2u) * 0.4);
+            vec3 normal = normalize(vec3(draw(leafPath, k + 3u) * 0.5, 0.8 + abs(draw(leafPath, k + 4u)) * 0.2,
+                                         draw(leafPath, k + 5u) * 0.5));
+            float size = mix(0.28, 0.45, draw(leafPath, k + 6u) * 0.5 + 0.5);
+            vec3 position = end + turn(offset, source.shape.x) * scale;
+            uint word = 6u * (first + j);
+            leaves[word] = floatBitsToUint(position.x);
+            leaves[word + 1u] = floatBitsToUint(position.y);
+            leaves[word + 2u] = floatBitsToUint(position.z);
+            leaves[word + 3u] = packNormal(turn(normal, source.shape.x));
+            leaves[word + 4u] = floatBitsToUint(size * scale);
+            leaves[word + 5u] = floatBitsToUint(1.0);
+        }
+    }
+}
+
+// Counts past the capacities are what was dropped, so the range and the
+// commands stop at them
+void advance() {
+    uint branchEnd = min(branchCount, uint(branchCapacity));
+    rangeFirst = rangeEnd;
+    rangeEnd = branchEnd;
+    dispatchSize = uvec3((rangeEnd - rangeFirst + 63u) / 64u, 1u, 1u);
+    woodCommand = ElementsCommand(uint(cylinderIndices), branchEnd, 0u, 0, 0u);
+    leafCommand = ArraysCommand(6u, min(leafCount, uint(leafCapacity)), 0u, 0u);
+}
+
+void main() {
+    uint id = gl_GlobalInvocationID.x;
+    if (pass == PASS_SEED) {
+        if (id < uint(treeCount)) seedTree(id);
+    } else if (pass == PASS_EXPAND) {
+        if (rangeFirst + id < rangeEnd) expandBranch(rangeFirst + id);
+    } else if (id == 0u) {
+        advance();
+    }
+}
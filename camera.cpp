@@ -3,27 +3,107 @@
 #include <algorithm>
 #include <cmath>
 
+// Weight of the newest sample in the smoothed drag velocity
+const float LATCH_VELOCITY_SMOOTHING = 0.5f;
+// About how many seconds the motion velocity averages over
+const float MOTION_SMOOTHING_SECONDS = 0.2f;
+
 Camera::Camera() : target(0.0f, 1.0f, 0.0f), up(0.0f, 1.0f, 0.0f),
                    radius(8.0f), theta(0.0f), phi(PI/4.0f),
                    min_radius(2.0f), max_radius(20.0f),
                    min_phi(PI/8.0f), max_phi(PI*3.0f/4.0f),
-                   mouse_pressed(false), last_mouse_x(0.0), last_mouse_y(0.0) {
-    // Calculate initial position
-    position.x = target.x + radius * sin(phi) * cos(theta);
-    position.y = target.y + radius * cos(phi);
-    position.z = target.z + radius * sin(phi) * sin(theta);
+                   mouse_pressed(false), last_mouse_x(0.0), last_mouse_y(0.0),
+                   latch_time(0.0), latch_theta(0.0f), latch_phi(0.0f), velocity_theta(0.0f), velocity_phi(0.0f),
+                   lead_theta(0.0f), lead_phi(0.0f),
+                   motion_time(0.0), motion_theta(0.0f), motion_phi(0.0f), motion_radius(0.0f),
+                   orbit_velocity_theta(0.0f), orbit_velocity_phi(0.0f), orbit_velocity_radius(0.0f),
+                   fov_y(PI * 50.0f / 180.0f), aspect_ratio(1.0f), near_plane(1.0f), far_plane(50.0f),
+                   dirty(true), changed(false) {
+    refresh();
 }
 
 Camera::~Camera() {
 }
 
 void Camera::update(GLFWwindow* window) {
-    processKeyInput(window);
+    if (window) processKeyInput(window);
+    changed = dirty;
+    if (dirty) refresh();
+    trackMotion();
+}
+
+// The orbit's velocity since the last update(), whatever moved it (keys,
+// drags, setOrbit from a camera path), blended in by the time it spans
+void Camera::trackMotion() {
+    const double now = glfwGetTime();
+    if (motion_time > 0.0 && now > motion_time) {
+        const float dt = (float)(now - motion_time);
+        const float weight = std::min(dt / MOTION_SMOOTHING_SECONDS, 1.0f);
+        orbit_velocity_theta += ((theta - motion_theta) / dt - orbit_velocity_theta) * weight;
+        orbit_velocity_phi += ((phi - motion_phi) / dt - orbit_velocity_phi) * weight;
+        orbit_velocity_radius += ((radius - motion_radius) / dt - orbit_velocity_radius) * weight;
+    }
+    motion_time = now;
+    motion_theta = theta;
+    motion_phi = phi;
+    motion_radius = radius;
+}
+
+glm::vec3 Camera::predictPosition(float seconds) const {
+    const float ahead_theta = theta + orbit_velocity_theta * seconds;
+    const float ahead_phi = std::max(min_phi, std::min(max_phi, phi + orbit_velocity_phi * seconds));
+    const float ahead_radius = std::max(min_radius, std::min(max_radius, radius + orbit_velocity_radius * seconds));
+    return target + ahead_radius * glm::vec3(sin(ahead_phi) * cos(ahead_theta), cos(ahead_phi),
+                                             sin(ahead_phi) * sin(ahead_theta));
+}
+
+void Camera::latch(GLFWwindow* window, float predict_seconds) {
+    if (mouse_pressed) {
+        double x, y;
+        glfwGetCursorPos(window, &x, &y);
+        processMouseInput(window, x, y);
+    }
+    
+    // Velocity over everything that moved the orbit since the last latch,
+    // the callbacks' drags included
+    const double now = glfwGetTime();
+    float new_lead_theta = 0.0f, new_lead_phi = 0.0f;
+    if (mouse_pressed && predict_seconds > 0.0f && latch_time > 0.0 && now > latch_time) {
+        const float dt = (float)(now - latch_time);
+        velocity_theta += ((theta - latch_theta) / dt - velocity_theta) * LATCH_VELOCITY_SMOOTHING;
+        velocity_phi += ((phi - latch_phi) / dt - velocity_phi) * LATCH_VELOCITY_SMOOTHING;
+        new_lead_theta = velocity_theta * predict_seconds;
+        new_lead_phi = velocity_phi * predict_seconds;
+    } else {
+        velocity_theta = 0.0f;
+        velocity_phi = 0.0f;
+    }
+    latch_time = now;
+    latch_theta = theta;
+    latch_phi = phi;
+    if (new_lead_theta != lead_theta || new_lead_phi != lead_phi) dirty = true;
+    lead_theta = new_lead_theta;
+    lead_phi = new_lead_phi;
     
-    // Update position based on spherical coordinates
-    position.x = target.x + radius * sin(phi) * cos(theta);
-    position.y = target.y + radius * cos(phi);
-    position.z = target.z + radius * sin(phi) * sin(theta);
+    if (dirty) {
+        changed = true;
+        refresh();
+    }
+}
+
+void Camera::refresh() {
+    // Update position based on spherical coordinates, led by the prediction
+    const float view_theta = theta + lead_theta;
+    const float view_phi = std::max(min_phi, std::min(max_phi, phi + lead_phi));
+    position.x = target.x + radius * sin(view_phi) * cos(view_theta);
+    position.y = target.y + radius * cos(view_phi);
+    position.z = target.z + radius * sin(view_phi) * sin(view_theta);
+    
+    view = glm::lookAt(position, target, up);
+    projection = glm::perspective(fov_y, aspect_ratio, near_plane, far_plane);
+    view_projection = projection * view;
+    frustum = ViewFrustum::fromMatrix(view_projection);
+    dirty = false;
 }
 
 void Camera::processMouseInput(GLFWwindow* window, double xpos, double ypos) {
@@ -41,6 +121,7 @@ void Camera::processMouseInput(GLFWwindow* window, double xpos, double ypos) {
             
             // Clamp phi to prevent flipping
             phi = std::max(min_phi, std::min(max_phi, phi));
+            if (dx != 0.0 || dy != 0.0) dirty = true;
             
             last_mouse_x = xpos;
             last_mouse_y = ypos;
@@ -51,12 +132,12 @@ void Camera::processMouseInput(GLFWwindow* window, double xpos, double ypos) {
 }
 
 void Camera::processScrollInput(GLFWwindow* window, double xoffset, double yoffset) {
-    radius -= yoffset * 0.5f;
-    radius = std::max(min_radius, std::min(max_radius, radius));
+    setRadius(radius - yoffset * 0.5f);
 }
 
 void Camera::processKeyInput(GLFWwindow* window) {
     float speed = 0.05f;
+    float old_radius = radius, old_theta = theta, old_phi = phi;
     
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
         radius -= speed;
@@ -80,12 +161,36 @@ void Camera::processKeyInput(GLFWwindow* window) {
     // Clamp values
     radius = std::max(min_radius, std::min(max_radius, radius));
     phi = std::max(min_phi, std::min(max_phi, phi));
+    if (radius != old_radius || theta != old_theta || phi != old_phi) dirty = true;
 }
 
-glm::mat4 Camera::getViewMatrix() const {
-    return glm::lookAt(position, target, up);
+void Camera::setTarget(glm::vec3 new_target) {
+    if (new_target != target) dirty = true;
+    target = new_target;
 }
 
 void Camera::setRadius(float new_radius) {
-    radius = std::max(min_radius, std::min(max_radius, new_radius));
+    new_radius = std::max(min_radius, std::min(max_radius, new_radius));
+    if (new_radius != radius) dirty = true;
+    radius = new_radius;
+}
+
+void Camera::setOrbit(float new_theta, float new_phi, float new_radius) {
+    new_phi = std::max(min_phi, std::min(max_phi, new_phi));
+    if (new_theta != theta || new_phi != phi) dirty = true;
+    theta = new_theta;
+    phi = new_phi;
+    setRadius(new_radius);
+}
+
+void Camera::setProjection(float new_fov_y, float new_near_plane, float new_far_plane) {
+    if (new_fov_y != fov_y || new_near_plane != near_plane || new_far_plane != far_plane) dirty = true;
+    fov_y = new_fov_y;
+    near_plane = new_near_plane;
+    far_plane = new_far_plane;
+}
+
+void Camera::setAspectRatio(float new_aspect_ratio) {
+    if (new_aspect_ratio != aspect_ratio) dirty = true;
+    aspect_ratio = new_aspect_ratio;
 }
@@ -4,7 +4,16 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <GLFW/glfw3.h>
+#include "frustum.h"
 
+// Orbit camera around a target, with its perspective projection. Input
+// and setters only mark the camera dirty; update() recomputes the position,
+// the view, projection and view-projection matrices and the world-space
+// frustum once, and the getters return those cached values. hasChanged()
+// tells whether the last update() moved anything, so per-view work
+// (culling, LOD selection) can be skipped on frames that look the same.
+// latch() samples the cursor once more later in the frame, so the view
+// drawn is as fresh as the input allows
 class Camera {
 private:
     glm::vec3 position;
@@ -24,21 +33,93 @@ private:
     double last_mouse_x;
     double last_mouse_y;
     
+    // Prediction: the orbit's angular velocity between latches, and how far
+    // the view leads the orbit by it
+    double latch_time; // 0 = no latch yet
+    float latch_theta;
+    float latch_phi;
+    float velocity_theta;
+    float velocity_phi;
+    float lead_theta;
+    float lead_phi;
+    
+    // Motion: the orbit's smoothed velocity from update() to update(), per
+    // second, for predictPosition
+    double motion_time; // 0 = no update yet
+    float motion_theta;
+    float motion_phi;
+    float motion_radius;
+    float orbit_velocity_theta;
+    float orbit_velocity_phi;
+    float orbit_velocity_radius;
+    
+    // Projection
+    float fov_y; // Vertical field of view, radians
+    float aspect_ratio;
+    float near_plane;
+    float far_plane;
+    
+    // Cached at the last update()
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 view_projection;
+    ViewFrustum frustum;
+    bool dirty;   // Something changed since the last update()
+    bool changed; // The last update() changed something
+    
+    void refresh();
+    void trackMotion();
+    
 public:
     Camera();
     ~Camera();
     
+    // Apply held keys (none without a window) and recompute what changed
+    // since the last call; once per frame
     void update(GLFWwindow* window);
     void processMouseInput(GLFWwindow* window, double xpos, double ypos);
     void processScrollInput(GLFWwindow* window, double xoffset, double yoffset);
     void processKeyInput(GLFWwindow* window);
+    // Read the cursor again and recompute the view if a drag moved it,
+    // before the view is used; no events are processed. With
+    // predict_seconds > 0 the view leads a drag by its recent velocity that
+    // far ahead, the time left until the frame is displayed. The cursor is
+    // as new as the platform's query gives it (on X11 and Windows, now)
+    void latch(GLFWwindow* window, float predict_seconds);
+    
+    const glm::mat4& getViewMatrix() const { return view; }
+    const glm::mat4& getProjectionMatrix() const { return projection; }
+    const glm::mat4& getViewProjectionMatrix() const { return view_projection; }
+    // The view volume in world space, planes facing inward
+    const ViewFrustum& getFrustum() const { return frustum; }
+    // Whether the last update() moved the camera or changed its projection
+    bool hasChanged() const { return changed; }
     
-    glm::mat4 getViewMatrix() const;
     glm::vec3 getPosition() const { return position; }
+    // Where the eye will be seconds from now if the orbit keeps its recent
+    // velocity: along the arc it sweeps rather than its tangent, within the
+    // limits the input keeps to. The streaming's look-ahead
+    glm::vec3 predictPosition(float seconds) const;
     glm::vec3 getTarget() const { return target; }
     
-    void setTarget(glm::vec3 new_target) { target = new_target; }
+    void setTarget(glm::vec3 new_target);
     void setRadius(float new_radius);
+    
+    // The orbit: horizontal and vertical angle in radians and the distance
+    // from the target, clamped as the input clamps them
+    float getTheta() const { return theta; }
+    float getPhi() const { return phi; }
+    float getRadius() const { return radius; }
+    void setOrbit(float new_theta, float new_phi, float new_radius);
+    
+    // Perspective projection: vertical field of view in radians and clip
+    // plane distances; the aspect ratio follows the framebuffer
+    void setProjection(float new_fov_y, float new_near_plane, float new_far_plane);
+    void setAspectRatio(float new_aspect_ratio);
+    float getFieldOfView() const { return fov_y; }
+    float getAspectRatio() const { return aspect_ratio; }
+    float getNearPlane() const { return near_plane; }
+    float getFarPlane() const { return far_plane; }
 };
 
 #endif
@@ -0,0 +1,96 @@
+#include "camera_path.h"
+#include "constants.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+CameraPath CameraPath::orbit() {
+    CameraPath path;
+    const int steps = 8;
+    for (int k = 0; k <= steps; k++) {
+        float s = (float)k / steps;
+        CameraKeyframe keyframe;
+        keyframe.theta = 2.0f * PI * s;
+        // Low and close at the middle of the turn, high and far at its ends
+        keyframe.phi = PI / 4.0f + PI / 6.0f * std::sin(PI * s);
+        keyframe.radius = 12.0f - 7.0f * std::sin(PI * s);
+        path.add(keyframe);
+    }
+    return path;
+}
+
+bool CameraPath::load(const std::string& path, std::string& error) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        error = strerror(errno);
+        return false;
+    }
+    std::vector<CameraKeyframe> loaded;
+    std::string line;
+    int number = 0;
+    while (std::getline(file, line)) {
+        number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        std::istringstream fields(line);
+        CameraKeyframe keyframe;
+        std::string rest;
+        if (!(fields >> keyframe.theta >> keyframe.phi >> keyframe.radius) || (fields >> rest)) {
+            error = "line " + std::to_string(number) + ": expected theta phi radius";
+            return false;
+        }
+        loaded.push_back(keyframe);
+    }
+    if (loaded.empty()) {
+        error = "no keyframes";
+        return false;
+    }
+    keyframes.swap(loaded);
+    return true;
+}
+
+bool CameraPath::save(const std::string& path, std::string& error) const {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        error = strerror(errno);
+        return false;
+    }
+    bool written = fprintf(file, "# theta phi radius\n") > 0;
+    for (const CameraKeyframe& keyframe : keyframes) {
+        if (fprintf(file, "%.6f %.6f %.6f\n", keyframe.theta, keyframe.phi, keyframe.radius) < 0) written = false;
+    }
+    if (fclose(file) != 0) written = false;
+    if (!written) error = "write failed";
+    return written;
+}
+
+// Catmull-Rom through p1 and p2 at s in [0, 1]
+static float catmullRom(float p0, float p1, float p2, float p3, float s) {
+    float s2 = s * s;
+    float s3 = s2 * s;
+    return 0.5f * (2.0f * p1 + (p2 - p0) * s + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * s2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * s3);
+}
+
+CameraKeyframe CameraPath::evaluate(float t) const {
+    const int count = (int)keyframes.size();
+    if (count == 1) return keyframes[0];
+    float position = std::max(0.0f, std::min(1.0f, t)) * (count - 1);
+    int segment = std::min((int)position, count - 2);
+    float s = position - segment;
+    // The ends repeat their keyframe as the missing neighbour
+    const CameraKeyframe& k0 = keyframes[std::max(segment - 1, 0)];
+    const CameraKeyframe& k1 = keyframes[segment];
+    const CameraKeyframe& k2 = keyframes[segment + 1];
+    const CameraKeyframe& k3 = keyframes[std::min(segment + 2, count - 1)];
+    CameraKeyframe pose;
+    pose.theta = catmullRom(k0.theta, k1.theta, k2.theta, k3.theta, s);
+    pose.phi = catmullRom(k0.phi, k1.phi, k2.phi, k3.phi, s);
+    pose.radius = catmullRom(k0.radius, k1.radius, k2.radius, k3.radius, s);
+    return pose;
+}
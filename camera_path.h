@@ -0,0 +1,38 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <string>
+#include <vector>
+
+// One pose of the orbit camera (Camera::setOrbit)
+struct CameraKeyframe {
+    float theta;
+    float phi;
+    float radius;
+};
+
+// A scripted camera flight for repeatable benchmarks: keyframes evenly
+// spaced over t in [0, 1], passed through by a Catmull-Rom spline. Stored
+// as text, one "theta phi radius" line per keyframe, # starting a comment
+class CameraPath {
+public:
+    // A full turn around the tree, in close and out again, for when no
+    // path is given
+    static CameraPath orbit();
+    
+    bool load(const std::string& path, std::string& error);
+    bool save(const std::string& path, std::string& error) const;
+    
+    void add(const CameraKeyframe& keyframe) { keyframes.push_back(keyframe); }
+    bool empty() const { return keyframes.empty(); }
+    size_t size() const { return keyframes.size(); }
+    
+    // The pose at t, clamped to [0, 1]; the first keyframe at 0, the last
+    // at 1. Needs at least one keyframe
+    CameraKeyframe evaluate(float t) const;
+
+private:
+    std::vector<CameraKeyframe> keyframes;
+};
+
+#endif // CAMERA_PATH_H
@@ -0,0 +1,97 @@
+#include "depth_pyramid.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include "shaderprogram.h"
+#include <algorithm>
+
+DepthPyramid::DepthPyramid()
+    : width(0), height(0), levels(0), framebuffer(0), depth_texture(0), pyramid_texture(0),
+      view_projection(1.0f), built(false) {}
+
+DepthPyramid::~DepthPyramid() {
+    release();
+}
+
+bool DepthPyramid::create(int new_width, int new_height) {
+    if (isCreated() && new_width == width && new_height == height) return true;
+    release();
+    width = std::max(new_width, 1);
+    height = std::max(new_height, 1);
+    levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+        levels++;
+    }
+    
+    // The blit needs the default framebuffer's format exactly
+    glGenTextures(1, &depth_texture);
+    glBindTexture(GL_TEXTURE_2D, depth_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    MemoryStats::trackTexture(depth_texture, MemoryStats::textureBytes(GL_DEPTH24_STENCIL8, width, height),
+                              "depth pyramid");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    
+    // Immutable storage, so every level can be bound as an image
+    glGenTextures(1, &pyramid_texture);
+    glBindTexture(GL_TEXTURE_2D, pyramid_texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+    MemoryStats::trackTexture(pyramid_texture, MemoryStats::textureBytes(GL_R32F, width, height, 1, levels),
+                              "depth pyramid");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+void DepthPyramid::release() {
+    MemoryStats::forgetTextures(1, &depth_texture);
+    MemoryStats::forgetTextures(1, &pyramid_texture);
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    if (depth_texture) glDeleteTextures(1, &depth_texture);
+    if (pyramid_texture) glDeleteTextures(1, &pyramid_texture);
+    framebuffer = depth_texture = pyramid_texture = 0;
+    width = height = levels = 0;
+    built = false;
+}
+
+// Level 0 copies the depth texture; each later level reads the one before
+// as an image, the barrier between them ordering the reads after the writes
+void DepthPyramid::build(GlStateCache& state, ShaderProgram* program, const glm::mat4& frame_view_projection,
+                         GLuint scene_framebuffer) {
+    if (!isCreated()) return;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, scene_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer);
+    
+    state.useProgram(program);
+    state.bindTexture(UNIT, GL_TEXTURE_2D, depth_texture);
+    state.uniform1i("depthSource", UNIT);
+    for (int level = 0; level < levels; level++) {
+        state.uniform1i("sourceLevel", level - 1);
+        glBindImageTexture(0, pyramid_texture, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, pyramid_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        int level_width = std::max(width >> level, 1);
+        int level_height = std::max(height >> level, 1);
+        glDispatchCompute((level_width + GROUP_SIZE - 1) / GROUP_SIZE, (level_height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    view_projection = frame_view_projection;
+    built = true;
+}
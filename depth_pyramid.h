@@ -0,0 +1,63 @@
+#ifndef DEPTH_PYRAMID_H
+#define DEPTH_PYRAMID_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class GlStateCache;
+class ShaderProgram;
+
+// A hierarchical depth buffer (Hi-Z) of a finished frame for occlusion
+// culling the next one: level 0 is the frame's depth as R32F, and every
+// texel of a coarser level holds the farthest depth of the texels it
+// covers, so one fetch at a level where a box spans at most two texels
+// tells whether anything nearer than the box's nearest point could hide
+// it. The frame's view-projection is kept with it, so a test projects the
+// box where that frame saw it.
+//
+// build() copies the scene framebuffer's depth, which must be 24-bit depth
+// with 8-bit stencil for the blit (GLFW's default, or an OffscreenTarget), and reduces it
+// with c_depth_pyramid.glsl (GL 4.3). create() binds textures directly,
+// behind a GlStateCache's back (GlStateCache::invalidateTextures)
+class DepthPyramid {
+public:
+    static const int UNIT = 12;       // The depth source and the pyramid, for the programs reading them
+    static const int GROUP_SIZE = 8;  // c_depth_pyramid.glsl's work groups are GROUP_SIZE x GROUP_SIZE
+    
+    DepthPyramid();
+    ~DepthPyramid();
+    
+    // Allocate for a width x height framebuffer, keeping a pyramid of that
+    // size; false when the depth copy's framebuffer is incomplete
+    bool create(int width, int height);
+    void release();
+    bool isCreated() const { return framebuffer != 0; }
+    
+    // Copy the depth of scene_framebuffer (0 = the default one) and reduce
+    // it level by level with program; view_projection is the frame's.
+    // scene_framebuffer is bound again after
+    void build(GlStateCache& state, ShaderProgram* program, const glm::mat4& view_projection,
+               GLuint scene_framebuffer = 0);
+    bool isBuilt() const { return built; }
+    
+    GLuint getTexture() const { return pyramid_texture; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getLevels() const { return levels; }
+    const glm::mat4& getViewProjection() const { return view_projection; }
+
+private:
+    int width;
+    int height;
+    int levels;
+    GLuint framebuffer;     // Holds depth_texture, the blit's target
+    GLuint depth_texture;
+    GLuint pyramid_texture; // R32F, levels mipmaps
+    glm::mat4 view_projection;
+    bool built;
+    
+    DepthPyramid(const DepthPyramid&);
+    DepthPyramid& operator=(const DepthPyramid&);
+};
+
+#endif // DEPTH_PYRAMID_H
@@ -0,0 +1,51 @@
+#include "dynamic_resolution.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int SETTLE_SAMPLES = 8;      // Frames averaged before a decision
+const float SMOOTHING = 0.25f;     // Weight of the newest frame time
+const float HEADROOM = 0.8f;       // Below this share of the budget the scale climbs
+const float MAX_GROWTH = 1.1f;     // Per step
+const float MARGIN = 0.95f;        // Aim under the budget, not at it
+const float STEPS = 64.0f;         // Scales are multiples of 1 / STEPS
+
+}
+
+DynamicResolution::DynamicResolution()
+    : min_scale(0.5f), max_scale(1.0f), budget(15.0f), scale(1.0f), average(0.0f), samples(0), changed_frame(0) {}
+
+void DynamicResolution::configure(float minimum, float maximum, float budget_milliseconds) {
+    max_scale = std::min(std::max(maximum, 1.0f / STEPS), 1.0f);
+    min_scale = std::min(std::max(minimum, 1.0f / STEPS), max_scale);
+    budget = std::max(budget_milliseconds, 0.1f);
+    scale = max_scale;
+    samples = 0;
+}
+
+bool DynamicResolution::addFrameTime(float gpu_milliseconds, long long measured_frame, long long current_frame) {
+    if (measured_frame < changed_frame || gpu_milliseconds <= 0.0f) return false;
+    average = samples == 0 ? gpu_milliseconds : average + SMOOTHING * (gpu_milliseconds - average);
+    if (++samples < SETTLE_SAMPLES) return false;
+    
+    // GPU time taken as proportional to the pixels, the square of the scale
+    float next = scale;
+    if (average > budget) {
+        next = scale * std::sqrt(budget * MARGIN / average);
+    } else if (average < budget * HEADROOM) {
+        next = std::min(scale * std::sqrt(budget * MARGIN / average), scale * MAX_GROWTH);
+    }
+    next = std::floor(std::min(std::max(next, min_scale), max_scale) * STEPS + 0.5f) / STEPS;
+    next = std::min(std::max(next, min_scale), max_scale);
+    if (next == scale) return false;
+    scale = next;
+    changed_frame = current_frame;
+    samples = 0;
+    return true;
+}
+
+void DynamicResolution::getSize(int window_width, int window_height, int& width, int& height) const {
+    width = std::max(2, (int)(window_width * scale) & ~1);
+    height = std::max(2, (int)(window_height * scale) & ~1);
+}
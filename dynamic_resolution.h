@@ -0,0 +1,42 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// Picks the share of the window's resolution the scene is drawn at from
+// the GPU time of recent frames, to keep them within a budget (the refresh
+// interval, say, so vsync never halves the rate). Over budget the scale
+// drops at once to about what fits, pixel count taken as the cost; with
+// headroom it climbs back at most a tenth per step. A change waits for
+// frames drawn at the new scale - GPU timings arrive frames late - so one
+// slow frame from before it can't trigger another
+class DynamicResolution {
+public:
+    DynamicResolution();
+    
+    // Scale of each axis, min_scale to max_scale (both in (0, 1] and
+    // clamped there), starting at max_scale, and the GPU milliseconds a
+    // frame may take
+    void configure(float min_scale, float max_scale, float budget_milliseconds);
+    
+    // The GPU time of measured_frame, numbered as the frames drawn, while
+    // current_frame is being drawn; true when the scale changed, for the
+    // frames from current_frame on
+    bool addFrameTime(float gpu_milliseconds, long long measured_frame, long long current_frame);
+    
+    float getScale() const { return scale; }
+    float getBudget() const { return budget; }
+    float getAverage() const { return average; } // Smoothed GPU milliseconds
+    // The scene's size for a window_width x window_height window: the
+    // scale of each, rounded down to even, at least 2
+    void getSize(int window_width, int window_height, int& width, int& height) const;
+
+private:
+    float min_scale;
+    float max_scale;
+    float budget;
+    float scale;
+    float average;
+    int samples;              // Frame times averaged since the last change
+    long long changed_frame;  // The first frame drawn at the current scale
+};
+
+#endif // DYNAMIC_RESOLUTION_H
@@ -0,0 +1,19 @@
+#version 330
+
+/*
+ * PERFORMANCE HUD FRAGMENT SHADER
+ *
+ * The vertex color, covered by the font atlas texel: glyph pixels for text,
+ * the atlas' solid cell for panels and graph lines
+ */
+
+uniform sampler2D hudFont; // Unit PerfHud::FONT_UNIT
+
+in vec2 atlasCoord;
+in vec4 vertexColor;
+
+out vec4 pixelColor;
+
+void main(void) {
+    pixelColor = vec4(vertexColor.rgb, vertexColor.a * texture(hudFont, atlasCoord).r);
+}
@@ -0,0 +1,162 @@
+#version 330
+
+/*
+ * OCTAHEDRAL IMPOSTOR FRAGMENT SHADER
+ *
+ * Each of the three frames the vertex shader picked is sampled where the
+ * view ray crosses the frame's image plane, and the three are blended by
+ * weight. Colors and normals are stored weighted by coverage (TreeImpostor
+ * clears the atlas to zero), so the blend divides coverage back out.
+ * The baked depth moves the fragment off the quad to the tree's surface,
+ * then it is lit like the scene's far geometry: ambient and the diffuse
+ * light of the unbounded lights (the sun)
+ */
+
+out vec4 pixelColor;
+
+// The baked impostor (TreeImpostor::apply)
+uniform sampler2D impostorAlbedo;
+uniform sampler2D impostorNormal;
+uniform sampler2D impostorDepth;
+uniform int impostorFrames;
+uniform vec3 impostorCenter;
+uniform float impostorRadius;
+uniform float alphaCutoff;     // Blended coverage below this is discarded
+uniform float materialAmbient; // Ambient fraction of the albedo
+
+// FrameUniforms (frame_uniforms.h) whole, for the fog
+layout(std140) uniform FrameData {
+	mat4 P;
+	mat4 V;
+	float time;
+	float season;
+	vec4 wind;
+	vec4 windGusts;
+	mat4 eyeProjection[2];
+	vec4 eyeOffset[2];
+	vec4 camera;
+	vec4 leafThinning;
+	vec4 fog;      // (view distance, clear out to, density, height falloff); view distance 0 = off
+	vec4 fogColor; // (colour, base height)
+};
+
+// f_simplest.glsl's fogAmount: the share of the colour the fog takes
+// between the eye and a point in eye space
+float fogAmount(vec3 p) {
+	if (fog.x <= 0.0) return 0.0;
+	float dist = length(p);
+	float rise = dot(V[1].xyz, p);
+	float k = fog.w * rise;
+	float along = abs(k) > 1e-3 ? (1.0 - exp(-k)) / k : 1.0;
+	float share = exp(min(-fog.w * (camera.y - fogColor.w), 20.0)) * along;
+	float fogged = 1.0 - exp(-fog.z * max(dist - fog.y, 0.0) * share);
+	return max(fogged, smoothstep(0.9 * fog.x, fog.x, dist));
+}
+
+// f_simplest.glsl's sky fog and ambient (Sky, --sky)
+uniform int skyLighting;
+uniform sampler2D skyView; // Unit Sky::VIEW_UNIT
+uniform vec3 sunDirection;
+const float SKY_AMBIENT = 0.15;
+
+vec3 skyDisplay(vec3 light) {
+	return pow(1.0 - exp(-light * 40.0), vec3(1.0 / 2.2));
+}
+
+vec3 skyColor(vec3 dir) {
+	float u = 0.0;
+	if (dot(dir.xz, dir.xz) > 1e-8 && dot(sunDirection.xz, sunDirection.xz) > 1e-8) {
+		u = acos(clamp(dot(normalize(dir.xz), normalize(sunDirection.xz)), -1.0, 1.0)) / 3.14159265;
+	}
+	float v = sqrt(asin(clamp(dir.y, 0.0, 1.0)) / 1.57079633);
+	return skyDisplay(textureLod(skyView, vec2(u, v), 0.0).rgb);
+}
+
+vec3 fogTint(vec3 p) {
+	return skyLighting != 0 ? skyColor(normalize(transpose(mat3(V)) * p)) : fogColor.rgb;
+}
+
+vec3 skyAmbient() {
+	return skyLighting != 0 ? SKY_AMBIENT * skyDisplay(textureLod(skyView, vec2(0.5), 16.0).rgb) : vec3(0.0);
+}
+
+// Lights in eye space, as in f_simplest.glsl (lights.h)
+#define MAX_LIGHTS 256
+struct Light {
+	vec3 position;
+	float radius;
+	vec3 color;
+	float intensity;
+	float specular;
+};
+layout(std140) uniform LightData {
+	ivec4 clusterDims; // w = unbounded lights, listed first
+	vec4 clusterScale;
+	Light lights[MAX_LIGHTS];
+};
+
+in vec3 rayDirection;
+flat in vec3 rayOrigin;
+flat in vec3 viewAxis;
+flat in vec3 frameAxis[3];
+flat in vec3 frameRight[3];
+flat in vec3 frameUp[3];
+flat in vec2 frameCell[3];
+flat in vec3 frameWeights;
+flat in mat4 treeToEye;
+
+void main(void) {
+	/*
+	 * STEP 1: BLEND THE FRAMES
+	 * Reproject the ray into each frame's orthographic view; depth is
+	 * turned into an offset toward the frame's camera from the center
+	 */
+	vec4 albedo = vec4(0.0);
+	vec4 normal = vec4(0.0);
+	float offset = 0.0;
+	float offsetWeight = 0.0;
+	for (int k = 0; k < 3; k++) {
+		float t = dot(impostorCenter - rayOrigin, frameAxis[k]) / dot(rayDirection, frameAxis[k]);
+		vec3 onPlane = rayOrigin + rayDirection * t - impostorCenter;
+		vec2 uv = vec2(dot(onPlane, frameRight[k]), dot(onPlane, frameUp[k])) / (2.0 * impostorRadius) + 0.5;
+		if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) {
+			continue;
+		}
+		vec2 atlas = (frameCell[k] + uv) / float(impostorFrames);
+		vec4 color = texture(impostorAlbedo, atlas);
+		albedo += frameWeights[k] * color;
+		normal += frameWeights[k] * texture(impostorNormal, atlas);
+		float depth = texture(impostorDepth, atlas).r;
+		offset += frameWeights[k] * color.a * (1.0 - 2.0 * depth) * impostorRadius;
+		offsetWeight += frameWeights[k] * color.a;
+	}
+	if (albedo.a < alphaCutoff) {
+		discard;
+	}
+	vec3 kd = albedo.rgb / albedo.a;
+	vec3 treeNormal = normalize(normal.rgb / max(normal.a, 1e-4) * 2.0 - 1.0);
+
+	/*
+	 * STEP 2: DEPTH OF THE SURFACE
+	 * The ray's crossing of the plane through the center facing the camera,
+	 * moved toward the camera by the blended offset
+	 */
+	float toPlane = dot(impostorCenter - rayOrigin, viewAxis) / dot(rayDirection, viewAxis);
+	float along = toPlane + (offset / max(offsetWeight, 1e-4)) / dot(rayDirection, viewAxis);
+	vec4 eyePosition = treeToEye * vec4(rayOrigin + rayDirection * along, 1.0);
+	vec4 clip = P * eyePosition;
+	gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+	/*
+	 * STEP 3: LIGHTING
+	 * Ambient and diffuse from the unbounded lights; the bounded ones
+	 * light the scene around the origin, not the distant trees
+	 */
+	vec3 mn = normalize(mat3(treeToEye) * treeNormal);
+	vec3 finalColor = (materialAmbient + skyAmbient()) * kd;
+	for (int i = 0; i < clusterDims.w; i++) {
+		vec3 ml = normalize(lights[i].position - eyePosition.xyz);
+		finalColor += kd * clamp(dot(mn, ml), 0.0, 1.0) * lights[i].intensity * lights[i].color;
+	}
+	pixelColor = vec4(mix(finalColor, fogTint(eyePosition.xyz), fogAmount(eyePosition.xyz)), 1.0);
+}
@@ -4,152 +4,464 @@
  * EYE-SPACE LIGHTING FRAGMENT SHADER WITH TEXTURE MIXING
  * 
  * This shader implements:
- * 1. Eye-space Phong lighting model (ambient + diffuse + specular)
- * 2. Multi-texture support with material flags
+ * 1. Eye-space Blinn-Phong lighting model (ambient + diffuse + normalized
+ *    half-vector specular) over a list of point lights: the unbounded ones,
+ *    then the lights of the fragment's cluster, skipping those whose radius
+ *    ends short of it
+ * 2. Per-draw materials (Material in material.h)
  * 3. Advanced texture mixing using dual coordinate systems
  * 4. Special handling for emissive materials (sun)
+ * 5. Shadows of the sun from cascaded shadow maps and of one torch from a
+ *    cube map (ShadowMaps), for the lights that name them
+ * 
+ * Compiled per material with #defines (ShaderVariants):
+ * - EMISSIVE: texture color only, no lighting (sun)
+ * - LEAF: single-sided leaves lit from behind with the flipped normal, and
+ *   alpha tested so cut-out texels are discarded before any lighting;
+ *   GPU-grown and instanced leaves turn with the season (FrameData)
+ * - DEPTH_ONLY: no lighting, for the depth prepass; with LEAF the alpha
+ *   test still decides which texels write depth
+ * - LOD_FADE: screen-door transparency for the elements a level-of-detail
+ *   change fades in or out (TreeLod); combines with the others
+ * - IMPOSTOR_BAKE: no lighting; the material color and the normal (in the
+ *   space the draw's view leaves it, the tree's for TreeImpostor) go to
+ *   the impostor atlas' two color targets
+ * - FOREST: forest instances (ForestScene); with LEAF their leaves' hue is
+ *   turned by the instance's shift
+ * - PROPS: the static props of a StaticBatch, their material read per
+ *   vertex instead of from the uniforms, emissive ones unlit
+ * - TERRAIN: the heightfield chunks of a Terrain, placed and morphed by
+ *   the vertex shader; shaded as any other surface
+ * - GRASS: the blades of a GrassField, generated, thinned and swayed by the
+ *   vertex shader; shaded as any other surface
+ * - BINDLESS: the material's texture is sampled by handle from
+ *   MaterialTextureData (BindlessTextures) instead of as a layer of
+ *   materialTexture; combines with the others
  * 
  * Key features:
- * - Same texture sampled twice with different coordinates for natural variation
- * - Material-specific mixing ratios for optimal visual results
+ * - Same texture sampled twice with different coordinates for natural
+ *   variation, once for materials that mix in none of the second
+ * - Material-specific mixing ratios, ambient levels and shininess
  * - Efficient single-pass lighting calculation
  */
 
-out vec4 pixelColor; //Output variable. Final pixel color sent to framebuffer.
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+layout(location = 0) out vec4 pixelColor; //Output variable. Final pixel color sent to framebuffer.
+#ifdef IMPOSTOR_BAKE
+layout(location = 1) out vec4 bakedNormal; // The normal at 0.5 + 0.5 n, alpha = coverage
+#endif
+
+// Variants without lighting declare none of its inputs
+#if defined(EMISSIVE) || defined(DEPTH_ONLY) || defined(IMPOSTOR_BAKE)
+#define UNLIT
+#endif
 
-// Texture samplers - each bound to a different texture unit
-uniform sampler2D textureMap0; // Bark texture (tree branches/trunk)
-uniform sampler2D textureMap1; // Leaf texture (tree foliage)
-uniform sampler2D textureMap2; // Grass texture (ground surface)
-uniform sampler2D textureMap3; // Sun texture (bright yellow emissive)
-uniform sampler2D textureMap4; // Torch texture (wood/metal torch)
+// Material of the draw, set by MaterialLibrary::apply
+#ifdef BINDLESS
+// Every material's texture as a handle to a single-layer array of its own
+// size, indexed by the material's layer; one uniform buffer on binding
+// point BindlessTextures::BINDING. The index is uniform across a draw but
+// for PROPS, whose layer comes per vertex: that relies on the driver
+// taking handles that differ within a draw, as the ones exposing the
+// extension do
+layout(std140) uniform MaterialTextureData {
+	uvec4 materialHandles[64]; // xy = the handle
+};
+#else
+uniform sampler2DArray materialTexture; // Every material's texture, one layer each (bark, leaf, grass, sun, torch)
+#endif
+#ifdef PROPS
+// Each prop's own material (layer, mix, ambient, emissive), copied into
+// the usual names at the start of main
+flat in vec4 materialParams;
+float materialLayer;
+float materialMix;
+float materialAmbient;
+#else
+uniform float materialLayer;            // Layer of this material
+uniform float materialMix;     // Share of the normal-based lookup: bark 0.25, leaf 0.3, ground 0.2, torch 0
+uniform float materialAmbient; // Ambient fraction of the diffuse color: 0.4 for the torch, 0.02 otherwise
+#endif
+uniform float materialShininess; // Blinn-Phong exponent, 0 = no highlight (leaves)
+
+// The material's texture at uv
+vec4 sampleMaterial(vec2 uv) {
+#ifdef BINDLESS
+	return texture(sampler2DArray(materialHandles[int(materialLayer)].xy), vec3(uv, 0.0));
+#else
+	return texture(materialTexture, vec3(uv, materialLayer));
+#endif
+}
+#ifdef LEAF
+uniform int twoSidedLeaves; // 1 = leaves are single quads, light the back face with the flipped normal
+uniform float alphaCutoff;  // Texels below this alpha are discarded: 0.5, lower under alpha-to-coverage
+#endif
+#ifdef LOD_FADE
+uniform float lodFade; // Opacity of the fading elements, 0 to 1
+#endif
 
-// Material selection flags - only one should be 1 per fragment
-uniform int useBarkTex;   // 1 = use bark texture, 0 = don't use
-uniform int useLeafTex;   // 1 = use leaf texture, 0 = don't use
-uniform int useGroundTex; // 1 = use ground texture, 0 = don't use
-uniform int useSunTex;    // 1 = use sun texture (emissive, no lighting), 0 = don't use
-uniform int useTorchTex;  // 1 = use torch texture, 0 = don't use
+#ifndef UNLIT
+// Point lights shared by every program: one uniform buffer on binding point
+// LightBuffer::BINDING, laid out as LightUniforms (lights.h). Positions are
+// in eye space
+#define MAX_LIGHTS 256
+struct Light {
+	vec3 position;
+	float radius;    // Light fades to zero here; 0 = never fades (the sun)
+	vec3 color;
+	float intensity; // Diffuse scale
+	float specular;  // Highlight scale
+	float shadow;    // 1 = darkened by the sun's cascades, 2 = by the torch's cube, 0 = unshadowed
+};
+layout(std140) uniform LightData {
+	ivec4 clusterDims;  // Tiles x, tiles y, depth slices, unbounded lights (listed first)
+	vec4 clusterScale;  // P[0][0], P[1][1], log-depth scale and bias of the slice
+	Light lights[MAX_LIGHTS];
+};
+
+// Lights per cluster (LightClusters): (first index, count), then the indices
+uniform usamplerBuffer clusterGrid;   // Unit LightBuffer::GRID_UNIT
+uniform usamplerBuffer clusterLights; // Unit LightBuffer::INDEX_UNIT
+
+// Shadow maps (ShadowMaps), uniform buffer on binding point
+// ShadowMaps::BINDING laid out as ShadowUniforms (shadow_maps.h)
+layout(std140) uniform ShadowData {
+	mat4 sunShadowMatrices[3]; // Eye space -> (u, v, depth) in each cascade
+	vec4 cascadeFar;           // Eye depth each cascade reaches, w = 1 when the sun has shadows
+	vec4 cascadeTexel;         // World size of a cascade's texel
+	mat4 torchShadowMatrix;    // Eye space -> world offset from the torch
+	vec4 torchShadowDepth;     // (near, far) of the cube's faces, w = 1 when the torch has shadows
+};
+uniform sampler2DArrayShadow sunShadow; // Unit ShadowMaps::CASCADE_UNIT
+uniform samplerCubeShadow torchShadow;  // Unit ShadowMaps::CUBE_UNIT
+#endif
 
 // Varying variables from vertex shader (interpolated across triangle surface)
-in vec4 n; // Normal in eye space (surface orientation)
-in vec4 l; // Light vector in eye space (vertex -> sun direction)
-in vec4 l2; // Light vector in eye space (vertex -> torch direction)
-in vec4 v; // View vector in eye space (vertex -> camera direction)
+in mediump vec3 n; // Normal in eye space (surface orientation), not normalized
+in vec3 eyePosition; // Fragment position in eye space
+#ifdef STEREO
+flat in vec3 viewOrigin; // This eye's position in eye space
+#endif
 in vec2 iTexCoord0; // Primary texture coordinates (standard UV mapping)
-in vec2 iTexCoord1; // Secondary texture coordinates (normal-based, for mixing)
+in float occlusion; // Baked ambient occlusion, 1 = open (untouched surfaces)
+#ifdef FOREST
+flat in float hueShift; // Radians around the hue circle
+#endif
+#ifdef LEAF
+flat in vec2 leafSeason; // (autumn turn in [0, 1], the leaf's own shade of it)
+#endif
 
-void main(void) {	/*
-	 * STEP 1: NORMALIZE INTERPOLATED VECTORS
-	 * Vectors from vertex shader are interpolated across triangle surface,
-	 * so they need to be re-normalized for accurate lighting calculations
-	 */
-	vec4 ml = normalize(l); // Sun light vector (vertex -> sun)
-	vec4 ml2 = normalize(l2); // Torch light vector (vertex -> torch)
-	vec4 mn = normalize(n); // Normal vector (surface orientation)
-	vec4 mv = normalize(v); // View vector (vertex -> camera)
-		/*
-	 * STEP 2: CALCULATE REFLECTION VECTORS
-	 * Used for specular highlights (shiny reflections)
-	 * reflect(-ml, mn) = direction of perfect reflection of light off surface
-	 */
-	vec4 mr = reflect(-ml, mn); // Reflection vector for sun light
-	vec4 mr2 = reflect(-ml2, mn); // Reflection vector for torch light
+#ifndef UNLIT
+// Share of the sun reaching the fragment: four compared taps of the
+// cascade holding it, each filtered 2x2 by the sampler, from a point moved
+// out along the normal by about a texel so the surface does not shadow
+// itself. Unshadowed past the last cascade
+float sunVisibility(vec3 mn) {
+	float depth = -eyePosition.z;
+	if (cascadeFar.w == 0.0 || depth >= cascadeFar.z) return 1.0;
+	int cascade = depth < cascadeFar.x ? 0 : (depth < cascadeFar.y ? 1 : 2);
+	vec3 position = eyePosition + mn * (1.5 * cascadeTexel[cascade]);
+	vec3 coord = (sunShadowMatrices[cascade] * vec4(position, 1.0)).xyz;
+	vec2 texel = 1.0 / vec2(textureSize(sunShadow, 0).xy);
+	float lit = 0.0;
+	for (int i = 0; i < 4; i++) {
+		vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texel;
+		lit += texture(sunShadow, vec4(coord.xy + offset, float(cascade), coord.z));
+	}
+	return 0.25 * lit;
+}
+
+// Share of the torch reaching the fragment: its cube face's depth is the
+// projected depth of the offset's major axis
+float torchVisibility(vec3 mn) {
+	if (torchShadowDepth.w == 0.0) return 1.0;
+	vec3 offset = (torchShadowMatrix * vec4(eyePosition + mn * 0.03, 1.0)).xyz;
+	float axis = max(max(abs(offset.x), abs(offset.y)), abs(offset.z));
+	float nearPlane = torchShadowDepth.x;
+	float farPlane = torchShadowDepth.y;
+	float ndc = (farPlane + nearPlane) / (farPlane - nearPlane) - 2.0 * farPlane * nearPlane / ((farPlane - nearPlane) * axis);
+	return texture(torchShadow, vec4(offset, 0.5 * ndc + 0.5 - 0.0005));
+}
+
+// Diffuse and specular light from one light; none when its radius does not
+// reach the fragment, less where its shadow map hides it. ks is the
+// highlight's normalized scale, 0 for a material without one
+vec3 shadeLight(Light light, vec3 mn, vec3 mv, vec3 kd, float ks) {
+	vec3 toLight = light.position - eyePosition;
+	float distance2 = dot(toLight, toLight);
+	// Early out: the light's radius does not reach this fragment
+	if (light.radius > 0.0 && distance2 >= light.radius * light.radius) {
+		return vec3(0.0);
+	}
+	// Smooth window falling from 1 at the light to 0 at its radius
+	float attenuation = 1.0;
+	if (light.radius > 0.0) {
+		float falloff = 1.0 - distance2 / (light.radius * light.radius);
+		attenuation = falloff * falloff;
+	}
+
+	vec3 ml = toLight * inversesqrt(max(distance2, 1e-8)); // Light vector (fragment -> light)
+	// Diffuse lighting: surface brightness based on angle to the light
+	float nl = clamp(dot(mn, ml), 0.0, 1.0);
+	vec3 lit = kd * (nl * light.intensity);
+	// Specular lighting: the half vector's angle to the normal, only for
+	// shiny materials and surfaces facing the light
+	if (ks > 0.0 && nl > 0.0) {
+		float nh = clamp(dot(mn, normalize(ml + mv)), 0.0, 1.0);
+		lit += vec3(ks * pow(nh, materialShininess) * light.specular);
+	}
+
+	vec3 color = light.color * attenuation;
+	if (light.shadow > 1.5) {
+		color *= torchVisibility(mn);
+	} else if (light.shadow > 0.5) {
+		color *= sunVisibility(mn);
+	}
+	return lit * color;
+}
+
+// The cluster holding the fragment: its screen tile from the projected eye
+// position, its depth slice from the log of the depth
+int clusterIndex() {
+	float depth = -eyePosition.z;
+	vec2 ndc = clusterScale.xy * eyePosition.xy / depth;
+	ivec2 tile = clamp(ivec2((ndc * 0.5 + 0.5) * vec2(clusterDims.xy)), ivec2(0), clusterDims.xy - 1);
+	int slice = clamp(int(floor(log(depth) * clusterScale.z + clusterScale.w)), 0, clusterDims.z - 1);
+	return (slice * clusterDims.y + tile.y) * clusterDims.x + tile.x;
+}
+#endif
+
+#ifndef UNLIT
+// Per-frame values (FrameUniforms in frame_uniforms.h), declared as in
+// v_simplest.glsl; the lit variants read the fog from them
+layout(std140) uniform FrameData {
+	mat4 P;
+	mat4 V;
+	float time;
+	float season;
+	vec4 wind;
+	vec4 windGusts;
+	mat4 eyeProjection[2];
+	vec4 eyeOffset[2];
+	vec4 camera;
+	vec4 leafThinning;
+	vec4 fog;      // (view distance, clear out to, density, height falloff); view distance 0 = off
+	vec4 fogColor; // (colour, base height)
+};
+
+// Share of the colour the fog takes between the eye and a point in eye
+// space, as DistanceFog::amount: the density integrated from the eye's
+// height to the point's, and whole over the last tenth of the distance
+float fogAmount(vec3 p) {
+	if (fog.x <= 0.0) return 0.0;
+	float dist = length(p);
+	float rise = dot(V[1].xyz, p); // The point's height above the camera: V's turn undone
+	float k = fog.w * rise;
+	float along = abs(k) > 1e-3 ? (1.0 - exp(-k)) / k : 1.0;
+	float share = exp(min(-fog.w * (camera.y - fogColor.w), 20.0)) * along;
+	float fogged = 1.0 - exp(-fog.z * max(dist - fog.y, 0.0) * share);
+	return max(fogged, smoothstep(0.9 * fog.x, fog.x, dist));
+}
+
+// With --sky (Sky) the fog takes the sky's colour behind the fragment and
+// the ambient the sky's mean, from its view table
+uniform int skyLighting;      // 1 = the sky's, 0 = fogColor and no sky ambient
+uniform sampler2D skyView;    // Unit Sky::VIEW_UNIT
+uniform vec3 sunDirection;    // Toward the sun, world space
+const float SKY_AMBIENT = 0.15; // Of the diffuse color in the lit sky's mean colour
+
+// f_sky.glsl's display colour of the view table toward world direction dir
+vec3 skyDisplay(vec3 light) {
+	return pow(1.0 - exp(-light * 40.0), vec3(1.0 / 2.2));
+}
+
+vec3 skyColor(vec3 dir) {
+	float u = 0.0;
+	if (dot(dir.xz, dir.xz) > 1e-8 && dot(sunDirection.xz, sunDirection.xz) > 1e-8) {
+		u = acos(clamp(dot(normalize(dir.xz), normalize(sunDirection.xz)), -1.0, 1.0)) / 3.14159265;
+	}
+	float v = sqrt(asin(clamp(dir.y, 0.0, 1.0)) / 1.57079633);
+	return skyDisplay(textureLod(skyView, vec2(u, v), 0.0).rgb);
+}
 
+// The colour the fog fades a point in eye space to
+vec3 fogTint(vec3 p) {
+	return skyLighting != 0 ? skyColor(normalize(transpose(mat3(V)) * p)) : fogColor.rgb;
+}
+
+// The coarsest level, one texel, is the whole table's mean
+vec3 skyAmbient() {
+	return skyLighting != 0 ? SKY_AMBIENT * skyDisplay(textureLod(skyView, vec2(0.5), 16.0).rgb) : vec3(0.0);
+}
+#endif
+
+#if defined(FOREST) && defined(LEAF) && !defined(UNLIT)
+// Turn a color's hue by angle radians: a rotation about the gray axis of
+// YIQ space, which keeps its luma
+vec3 shiftHue(vec3 color, float angle) {
+	const mat3 toYiq = mat3(0.299, 0.596, 0.211, 0.587, -0.274, -0.523, 0.114, -0.322, 0.312);
+	const mat3 fromYiq = mat3(1.0, 1.0, 1.0, 0.956, -0.272, -1.106, 0.621, -0.647, 1.703);
+	vec3 yiq = toYiq * color;
+	float c = cos(angle);
+	float s = sin(angle);
+	yiq.yz = vec2(c * yiq.y - s * yiq.z, s * yiq.y + c * yiq.z);
+	return clamp(fromYiq * yiq, 0.0, 1.0);
+}
+#endif
+
+// The material's texture at the mesh UVs, blended with it at the
+// normal-based coordinates by the mix ratio; the second fetch only for
+// materials that mix it in (the branch is uniform across the draw). The
+// second coordinates map the interpolated normal's xy from [-1, 1] to
+// [0, 1], the same as interpolating them from the vertices
+vec4 materialColor() {
+	vec4 color = sampleMaterial(iTexCoord0);
+	if (materialMix > 0.0) {
+		vec2 normalCoord = n.xy * 0.5 + 0.5;
+		color = mix(color, sampleMaterial(normalCoord), materialMix);
+	}
+	return color;
+}
+
+#ifdef LEAF
+// A leaf's color through the autumn: toward its own shade between gold
+// and rust, keeping the texture's light and dark
+vec3 autumnColor(vec3 color) {
+	float luma = dot(color, vec3(0.299, 0.587, 0.114));
+	vec3 shade = mix(vec3(1.0, 0.78, 0.2), vec3(0.85, 0.3, 0.1), leafSeason.y) * (luma * 2.2);
+	return mix(color, clamp(shade, 0.0, 1.0), leafSeason.x);
+}
+#endif
+
+void main(void) {
+#ifdef PROPS
+	materialLayer = materialParams.x;
+	materialMix = materialParams.y;
+	materialAmbient = materialParams.z;
+#endif
+#ifdef LOD_FADE
 	/*
-	 * STEP 3: MATERIAL/TEXTURE SELECTION WITH ADVANCED MIXING
-	 * Choose appropriate texture and apply mixing for surface detail variation
+	 * DITHERED FADE: a 4x4 ordered-dither threshold per pixel keeps
+	 * lodFade of the fragments, opaque and depth-written, so no sorting
+	 * or blending is needed. The pattern is fixed to the screen, so the
+	 * prepass and the lit pass keep the same fragments
 	 */
-	vec4 kd; // Diffuse color (main surface color from texture)
-		if (useSunTex == 1) {
-		/*
-		 * SUN MATERIAL: Pure emissive (no lighting calculations)
-		 * Sun should appear bright regardless of lighting conditions
-		 */
-		pixelColor = texture(textureMap3, iTexCoord0);
-		return; // Early exit - no lighting needed for emissive materials
-		} else if (useTorchTex == 1) {		/*
-		 * TORCH MATERIAL: Use primary texture coordinates only, no mixing
-		 * This ensures the texture displays clearly without interference
-		 */
-		kd = texture(textureMap4, iTexCoord0);
-		
-	} else if (useGroundTex == 1) {
-		/*
-		 * GROUND MATERIAL: Grass texture with subtle variation
-		 * Mix ratio 0.2 = 20% normal-based, 80% UV-based
-		 * Lower mixing for more uniform ground appearance
-		 */
-		kd = mix(texture(textureMap2, iTexCoord0), texture(textureMap2, iTexCoord1), 0.2);
-		
-	} else if (useLeafTex == 1) {
-		/*
-		 * LEAF MATERIAL: Higher mixing for organic variation
-		 * Mix ratio 0.3 = 30% normal-based, 70% UV-based
-		 * More variation makes leaves look natural and less repetitive
-		 */
-		kd = mix(texture(textureMap1, iTexCoord0), texture(textureMap1, iTexCoord1), 0.3);
-		
-	} else if (useBarkTex == 1) {
-		/*
-		 * BARK MATERIAL: Moderate mixing for surface detail
-		 * Mix ratio 0.25 = 25% normal-based, 75% UV-based
-		 * Adds bark surface texture while preserving main pattern
-		 */
-		kd = mix(texture(textureMap0, iTexCoord0), texture(textureMap0, iTexCoord1), 0.25);
-		
-	} else {
-		/*
-		 * FALLBACK MATERIAL: Neutral gray when no texture is specified
-		 */
-		kd = vec4(0.5, 0.5, 0.5, 1.0);
+	const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+	                                  3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+	ivec2 cell = ivec2(gl_FragCoord.xy) & 3;
+	if (lodFade * 16.0 <= bayer[cell.y * 4 + cell.x]) {
+		discard;
 	}
-	
+#endif
+#ifdef LEAF
 	/*
-	 * STEP 4: LIGHTING MATERIAL PROPERTIES
+	 * ALPHA TEST: cut-out texels of the leaf texture end here, before any
+	 * lighting, and write no depth. Under MSAA alpha-to-coverage softens
+	 * the edges from the alpha written with the color
 	 */
-	vec4 ks = vec4(0.3, 0.3, 0.3, 1.0); // Specular color (reflection intensity)
+	float leafAlpha = sampleMaterial(iTexCoord0).a;
+	if (leafAlpha < alphaCutoff) {
+		discard;
+	}
+#endif
+#if defined(DEPTH_ONLY)
+	// Depth prepass: only the depth written counts
+#ifdef LEAF
+	pixelColor = vec4(0.0, 0.0, 0.0, leafAlpha);
+#else
+	pixelColor = vec4(0.0);
+#endif
+#elif defined(IMPOSTOR_BAKE)
+	// The color the lit variants start from, and the surface normal they
+	// would light it with
+	vec3 mn = normalize(n);
+#ifdef LEAF
+	if (twoSidedLeaves == 1 && !gl_FrontFacing) {
+		mn = -mn;
+	}
+#endif
+	vec4 kd = materialColor();
+#ifdef LEAF
+	kd.rgb = autumnColor(kd.rgb);
+#endif
+	pixelColor = vec4(kd.rgb, 1.0);
+	bakedNormal = vec4(mn * 0.5 + 0.5, 1.0);
+#elif defined(EMISSIVE)
 	/*
-	 * STEP 5: PHONG LIGHTING MODEL CALCULATIONS FOR BOTH LIGHTS
+	 * EMISSIVE MATERIAL (SUN): no lighting calculations
+	 * Should appear bright regardless of lighting conditions
 	 */
-	
-	// Sun light calculations
-	// Diffuse lighting: surface brightness based on angle to sun
-	float nl = clamp(dot(mn, ml), 0.0, 1.0);
-	// Specular lighting: shiny highlights based on sun reflection angle
-	float rv = pow(clamp(dot(mr, mv), 0.0, 1.0), 25.0);
-	
-	// Torch light calculations  
-	// Diffuse lighting: surface brightness based on angle to torch
-	float nl2 = clamp(dot(mn, ml2), 0.0, 1.0);
-	// Specular lighting: shiny highlights based on torch reflection angle
-	float rv2 = pow(clamp(dot(mr2, mv), 0.0, 1.0), 25.0);
-	
+	pixelColor = sampleMaterial(iTexCoord0);
+#else
+#ifdef PROPS
+	// An emissive prop (the sun) as the EMISSIVE variant draws it
+	if (materialParams.w > 0.5) {
+		pixelColor = sampleMaterial(iTexCoord0);
+		return;
+	}
+#endif
 	/*
-	 * STEP 6: COMBINE LIGHTING COMPONENTS FROM BOTH SOURCES
-	 * Final color = ambient + (sun_diffuse + sun_specular) + (torch_diffuse + torch_specular)
+	 * STEP 1: NORMALIZE INTERPOLATED VECTORS
+	 * Vectors from vertex shader are interpolated across triangle surface,
+	 * so they need to be re-normalized for accurate lighting calculations
 	 */
-	// Ambient: base illumination (simulates indirect/scattered light) - higher for torch
-	vec3 ambient;
-	if (useTorchTex == 1) {
-		ambient = 0.4 * kd.rgb; // 40% ambient for torch to ensure visibility
-	} else {
-		ambient = 0.02 * kd.rgb; // 2% for other materials
+	vec3 mn = normalize(n); // Normal vector (surface orientation)
+#ifdef STEREO
+	vec3 mv = normalize(viewOrigin - eyePosition); // View vector (fragment -> this eye, off the origin)
+#else
+	vec3 mv = normalize(-eyePosition); // View vector (fragment -> camera at the eye-space origin)
+#endif
+#ifdef LEAF
+	// Single-sided leaf seen from behind: light it as its own front face
+	if (twoSidedLeaves == 1 && !gl_FrontFacing) {
+		mn = -mn;
 	}
-	
-	// Sun contribution (main light source)
-	vec3 sunDiffuse = kd.rgb * nl * 0.7; // 70% intensity for sun (slightly reduced)
-	vec3 sunSpecular = ks.rgb * rv * 0.7;	// Torch contribution (secondary light source - warmer, orange tint) - minimal intensity for better texture visibility
-	vec3 torchColor = vec3(1.0, 0.6, 0.2); // Orange torch light
-	vec3 torchDiffuse = kd.rgb * nl2 * 1.2 * torchColor; // 40% intensity for torch (further reduced)
-	vec3 torchSpecular = ks.rgb * rv2 * 0.3 * torchColor; // Minimal torch specular
-	// Combine all lighting components
-	vec3 finalColor = ambient + sunDiffuse + sunSpecular + torchDiffuse + torchSpecular;
-		// Add self-illumination for torch - so it remains visible even when sun is far away
-	if (useTorchTex == 1) {
+#endif
 
-	}
+	/*
+	 * STEP 2: MATERIAL TEXTURE WITH MIXING
+	 * The same texture at the mesh UVs and at normal-based coordinates,
+	 * blended by the material's mix ratio for surface detail variation
+	 */
+	vec4 kd = materialColor(); // Diffuse color
+#if defined(FOREST) && defined(LEAF)
+	kd.rgb = shiftHue(kd.rgb, hueShift);
+#endif
+#ifdef LEAF
+	kd.rgb = autumnColor(kd.rgb);
+#endif
+	/*
+	 * Specular scale, normalized by (n + 8) / (8 pi) so a tighter highlight
+	 * is brighter rather than only smaller; 0.07 peaks at 0.3 at the
+	 * default exponent of 100
+	 */
+	float ks = materialShininess > 0.0 ? 0.07 * (materialShininess + 8.0) * 0.0397887 : 0.0;
 
+	/*
+	 * STEP 3: BLINN-PHONG LIGHTING OVER THE LIGHT LIST
+	 * Ambient: base illumination (simulates indirect/scattered light),
+	 * then the unbounded lights and those listed for the fragment's cluster.
+	 * Baked occlusion takes the ambient away inside a canopy, and some of
+	 * the direct light, which the shadow maps miss at the scale of leaves
+	 */
+	vec3 direct = vec3(0.0);
+	for (int i = 0; i < clusterDims.w; i++) {
+		direct += shadeLight(lights[i], mn, mv, kd.rgb, ks);
+	}
+	uvec2 range = texelFetch(clusterGrid, clusterIndex()).xy;
+	for (uint k = 0u; k < range.y; k++) {
+		int i = int(texelFetch(clusterLights, int(range.x + k)).x);
+		direct += shadeLight(lights[i], mn, mv, kd.rgb, ks);
+	}
+	vec3 finalColor = occlusion * (materialAmbient + skyAmbient()) * kd.rgb + (0.6 + 0.4 * occlusion) * direct;
+	finalColor = mix(finalColor, fogTint(eyePosition), fogAmount(eyePosition));
 	
 	pixelColor = vec4(finalColor, kd.a);
+#ifdef LEAF
+	pixelColor.a = leafAlpha; // Alpha-to-coverage follows the tested alpha
+#endif
+#endif
 }
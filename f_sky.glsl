@@ -0,0 +1,183 @@
+#version 330
+
+/*
+ * SKY FRAGMENT SHADER
+ *
+ * The atmosphere of Sky, in three variants over v_sky.glsl's triangle:
+ *
+ * - TRANSMITTANCE_LUT: the transmittance from a height toward the top of
+ *   the atmosphere at a zenith angle, marched once at startup
+ * - VIEW_LUT: the light the sky scatters toward the eye, by azimuth from
+ *   the sun and elevation, single scattering marched through the
+ *   transmittance table with a constant share for the multiple scattering;
+ *   redone only when the sun's elevation changes
+ * - neither: the sky pass, a fetch of the view table per pixel behind the
+ *   scene, with the sun's disk
+ *
+ * Distances in km; an Earth-like planet with Rayleigh, Mie and ozone
+ * (Bruneton 2017 and Hillaire 2020's parameters)
+ */
+
+in vec2 lutCoord;
+in vec3 ray;
+
+out vec4 pixelColor;
+
+uniform sampler2D transmittanceLut; // Unit Sky::TRANSMITTANCE_UNIT
+uniform sampler2D skyView;          // Unit Sky::VIEW_UNIT
+uniform vec3 sunDirection;          // Toward the sun, world space
+
+const float PI = 3.14159265;
+const float GROUND_RADIUS = 6360.0;
+const float TOP_RADIUS = 6460.0;
+const float EYE_RADIUS = GROUND_RADIUS + 0.2;
+const vec3 RAYLEIGH_SCATTERING = vec3(5.802e-3, 13.558e-3, 33.1e-3);
+const float RAYLEIGH_HEIGHT = 8.0;
+const float MIE_SCATTERING = 3.996e-3;
+const float MIE_EXTINCTION = 4.44e-3;
+const float MIE_HEIGHT = 1.2;
+const float MIE_G = 0.8;
+const vec3 OZONE_ABSORPTION = vec3(0.650e-3, 1.881e-3, 0.085e-3);
+const float SKY_EXPOSURE = 40.0;     // The tables' light, the sun's being 1, to the display's
+const float MULTIPLE_SHARE = 0.1;    // Of the sunlight reaching a point, scattered more than once
+const float SUN_COS = 0.99996;       // Cosine of the sun disk's angular radius, 0.5 degrees
+const int STEPS = 30;
+
+// Rayleigh, Mie and ozone densities at height h above the ground
+vec3 densities(float h) {
+	return vec3(exp(-h / RAYLEIGH_HEIGHT), exp(-h / MIE_HEIGHT), max(0.0, 1.0 - abs(h - 25.0) / 15.0));
+}
+
+vec3 extinction(float h) {
+	vec3 d = densities(h);
+	return RAYLEIGH_SCATTERING * d.x + vec3(MIE_EXTINCTION * d.y) + OZONE_ABSORPTION * d.z;
+}
+
+// Distance from radius r along zenith cosine mu to the top of the atmosphere
+float distanceToTop(float r, float mu) {
+	return max(-r * mu + sqrt(max(r * r * (mu * mu - 1.0) + TOP_RADIUS * TOP_RADIUS, 0.0)), 0.0);
+}
+
+bool hitsGround(float r, float mu) {
+	return mu < 0.0 && r * r * (mu * mu - 1.0) + GROUND_RADIUS * GROUND_RADIUS >= 0.0;
+}
+
+float distanceToGround(float r, float mu) {
+	return max(-r * mu - sqrt(max(r * r * (mu * mu - 1.0) + GROUND_RADIUS * GROUND_RADIUS, 0.0)), 0.0);
+}
+
+// Distance from the top of the atmosphere to the ground's horizon
+float horizon() {
+	return sqrt(TOP_RADIUS * TOP_RADIUS - GROUND_RADIUS * GROUND_RADIUS);
+}
+
+#ifdef TRANSMITTANCE_LUT
+// The texel's (r, mu): v the distance to the horizon as a share of the
+// longest, u the distance to the top between its least and most there
+void main(void) {
+	float H = horizon();
+	float rho = H * lutCoord.y;
+	float r = sqrt(rho * rho + GROUND_RADIUS * GROUND_RADIUS);
+	float dMin = TOP_RADIUS - r;
+	float dMax = rho + H;
+	float d = dMin + lutCoord.x * (dMax - dMin);
+	float mu = d == 0.0 ? 1.0 : clamp((H * H - rho * rho - d * d) / (2.0 * r * d), -1.0, 1.0);
+
+	float dt = d / float(STEPS);
+	vec3 depth = vec3(0.0);
+	for (int i = 0; i < STEPS; i++) {
+		float t = (float(i) + 0.5) * dt;
+		float h = sqrt(r * r + t * t + 2.0 * r * mu * t) - GROUND_RADIUS;
+		depth += extinction(h) * dt;
+	}
+	pixelColor = vec4(exp(-depth), 1.0);
+}
+#else
+
+// The transmittance table at (r, mu), the inverse of its texel mapping;
+// 0 toward the ground
+vec3 transmittance(float r, float mu) {
+	if (hitsGround(r, mu)) return vec3(0.0);
+	float H = horizon();
+	float rho = sqrt(max(r * r - GROUND_RADIUS * GROUND_RADIUS, 0.0));
+	float d = distanceToTop(r, mu);
+	float dMin = TOP_RADIUS - r;
+	float dMax = rho + H;
+	return textureLod(transmittanceLut, vec2((d - dMin) / (dMax - dMin), rho / H), 0.0).rgb;
+}
+
+#ifdef VIEW_LUT
+float rayleighPhase(float c) {
+	return 3.0 / (16.0 * PI) * (1.0 + c * c);
+}
+
+// Cornette-Shanks
+float miePhase(float c) {
+	float g2 = MIE_G * MIE_G;
+	return 3.0 / (8.0 * PI) * (1.0 - g2) * (1.0 + c * c) / ((2.0 + g2) * pow(1.0 + g2 - 2.0 * MIE_G * c, 1.5));
+}
+
+// The texel's direction in the sun's frame, the sun at azimuth 0: u the
+// azimuth / pi, v the square root of the elevation's share of a right
+// angle, the rows dense toward the horizon where the sky changes fastest
+void main(void) {
+	float azimuth = lutCoord.x * PI;
+	float elevation = lutCoord.y * lutCoord.y * 0.5 * PI;
+	vec3 dir = vec3(cos(elevation) * cos(azimuth), sin(elevation), cos(elevation) * sin(azimuth));
+	float sunY = clamp(sunDirection.y, -1.0, 1.0);
+	vec3 sun = vec3(sqrt(1.0 - sunY * sunY), sunY, 0.0);
+	float c = dot(dir, sun);
+	float phaseR = rayleighPhase(c);
+	float phaseM = miePhase(c);
+
+	vec3 origin = vec3(0.0, EYE_RADIUS, 0.0);
+	float mu = dir.y;
+	float span = hitsGround(EYE_RADIUS, mu) ? distanceToGround(EYE_RADIUS, mu) : distanceToTop(EYE_RADIUS, mu);
+	float dt = span / float(STEPS);
+	vec3 light = vec3(0.0);
+	vec3 seen = vec3(1.0); // Transmittance from the eye to the sample
+	for (int i = 0; i < STEPS; i++) {
+		vec3 p = origin + dir * ((float(i) + 0.5) * dt);
+		float r = length(p);
+		vec3 d = densities(r - GROUND_RADIUS);
+		vec3 sunlight = transmittance(r, dot(p, sun) / r);
+		vec3 rayleigh = RAYLEIGH_SCATTERING * d.x;
+		vec3 mie = vec3(MIE_SCATTERING * d.y);
+		vec3 scattered = sunlight * (rayleigh * phaseR + mie * phaseM + (rayleigh + mie) * MULTIPLE_SHARE / (4.0 * PI));
+		// The light scattered over the step and dimmed within it, integrated
+		vec3 ext = max(extinction(r - GROUND_RADIUS), vec3(1e-7));
+		vec3 through = exp(-ext * dt);
+		light += seen * scattered * (1.0 - through) / ext;
+		seen *= through;
+	}
+	pixelColor = vec4(light, 1.0);
+}
+#else
+
+// A view table value as a display colour
+vec3 skyDisplay(vec3 light) {
+	return pow(1.0 - exp(-light * SKY_EXPOSURE), vec3(1.0 / 2.2));
+}
+
+// The view table toward world direction dir
+vec3 skyLight(vec3 dir) {
+	vec2 across = dir.xz;
+	vec2 toSun = sunDirection.xz;
+	float u = 0.0;
+	if (dot(across, across) > 1e-8 && dot(toSun, toSun) > 1e-8) {
+		u = acos(clamp(dot(normalize(across), normalize(toSun)), -1.0, 1.0)) / PI;
+	}
+	float v = sqrt(asin(clamp(dir.y, 0.0, 1.0)) / (0.5 * PI));
+	return textureLod(skyView, vec2(u, v), 0.0).rgb;
+}
+
+void main(void) {
+	vec3 dir = normalize(ray);
+	vec3 light = skyLight(dir);
+	if (dot(dir, sunDirection) > SUN_COS && dir.y > 0.0) {
+		light += transmittance(EYE_RADIUS, sunDirection.y);
+	}
+	pixelColor = vec4(skyDisplay(light), 1.0);
+}
+#endif
+#endif
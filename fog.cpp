@@ -0,0 +1,64 @@
+#include "fog.h"
+#include <algorithm>
+#include <cmath>
+
+// Clear out to this share of the view distance
+static const float CLEAR_SHARE = 0.3f;
+// The fog's share at the view distance before the last stretch closes it
+static const float FAR_AMOUNT = 0.98f;
+// The last stretch, as a share of the view distance, over which the fog
+// ramps to whole whatever the height
+static const float CLOSING_SHARE = 0.1f;
+// Cap on the height term's exponent, for eyes far below the base height
+static const float MAX_HEIGHT_EXPONENT = 20.0f;
+
+DistanceFog::DistanceFog()
+    : view_distance(0.0f), start(0.0f), density(0.0f), height_falloff(0.0f), base_height(0.0f), color(1.0f) {}
+
+void DistanceFog::configure(float distance, float falloff, float base, const glm::vec3& fog_color) {
+    view_distance = std::max(distance, 0.0f);
+    start = CLEAR_SHARE * view_distance;
+    density = view_distance > 0.0f ? -logf(1.0f - FAR_AMOUNT) / (view_distance - start) : 0.0f;
+    height_falloff = std::max(falloff, 0.0f);
+    base_height = base;
+    color = fog_color;
+}
+
+// Fog along distance units of air whose density averages height_share of
+// the base height's
+float DistanceFog::opticalDepth(float distance, float height_share) const {
+    return density * std::max(distance - start, 0.0f) * height_share;
+}
+
+static float smoothstep(float edge0, float edge1, float x) {
+    float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+float DistanceFog::amount(const glm::vec3& eye, const glm::vec3& point) const {
+    if (!isEnabled()) return 0.0f;
+    float distance = glm::length(point - eye);
+    // The density's mean along the ray: exp(-falloff (h - base)) integrated
+    // from the eye's height to the point's
+    float k = height_falloff * (point.y - eye.y);
+    float along = fabsf(k) > 1e-3f ? (1.0f - expf(-k)) / k : 1.0f;
+    float share = expf(std::min(-height_falloff * (eye.y - base_height), MAX_HEIGHT_EXPONENT)) * along;
+    float fogged = 1.0f - expf(-opticalDepth(distance, share));
+    return std::max(fogged, smoothstep((1.0f - CLOSING_SHARE) * view_distance, view_distance, distance));
+}
+
+float DistanceFog::visibility(float distance) const {
+    if (!isEnabled()) return 1.0f;
+    float fogged = 1.0f - expf(-opticalDepth(distance, 1.0f));
+    return 1.0f - std::max(fogged, smoothstep((1.0f - CLOSING_SHARE) * view_distance, view_distance, distance));
+}
+
+glm::vec4 DistanceFog::getParameters() const {
+    if (!isEnabled()) return glm::vec4(0.0f);
+    return glm::vec4(view_distance, start, density, height_falloff);
+}
+
+glm::vec4 DistanceFog::getColorParameters() const {
+    if (!isEnabled()) return glm::vec4(0.0f);
+    return glm::vec4(color, base_height);
+}
@@ -0,0 +1,51 @@
+#ifndef FOG_H
+#define FOG_H
+
+#include <glm/glm.hpp>
+
+// Distance and height fog toward a visibility distance (--view-distance),
+// the one distance the far plane, and with it the frustum culling, also
+// stop at: nothing is drawn past it, and what comes near it has already
+// faded into the fog colour, the sky's, so the far plane never shows as an
+// edge. The fog is clear out to a share of the distance, thickens
+// exponentially from there, denser near the base height and thinning above
+// it, and takes the last stretch to the distance whole.
+//
+// f_simplest.glsl and f_impostor.glsl evaluate amount() per fragment from
+// the FrameData fog vectors; visibility() gives the LOD choices what of a
+// distant object still shows, so a tree mostly hidden by fog is drawn at a
+// coarse level as if it were smaller
+class DistanceFog {
+public:
+    DistanceFog();
+    
+    // Fog out to view_distance (0 = none), densest at base_height and
+    // thinning by e every 1 / height_falloff above it (0 = even)
+    void configure(float view_distance, float height_falloff, float base_height, const glm::vec3& color);
+    bool isEnabled() const { return view_distance > 0.0f; }
+    float getViewDistance() const { return view_distance; }
+    const glm::vec3& getColor() const { return color; }
+    
+    // Share of a surface's colour the fog takes between eye and point
+    float amount(const glm::vec3& eye, const glm::vec3& point) const;
+    // 1 - the fog at distance through air of the base height's density:
+    // the share of an object's contrast left there, 1 without fog
+    float visibility(float distance) const;
+    
+    // FrameData's fog (view distance, clear out to, density, height
+    // falloff) and fogColor (colour, base height); all zero without fog
+    glm::vec4 getParameters() const;
+    glm::vec4 getColorParameters() const;
+
+private:
+    float view_distance;
+    float start;   // Clear out to here
+    float density; // Per unit at the base height
+    float height_falloff;
+    float base_height;
+    glm::vec3 color;
+    
+    float opticalDepth(float distance, float height_share) const;
+};
+
+#endif // FOG_H
@@ -0,0 +1,105 @@
+#include "forest_proxy.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+static const char FOREST_PROXY_MAGIC[8] = {'T', 'R', 'E', 'E', 'P', 'R', 'X', '1'};
+
+struct ForestProxyHeader {
+    char magic[8];
+    uint64_t key;
+    uint32_t wood_vertices; // Counts of floats and indices
+    uint32_t wood_indices;
+    uint32_t leaf_vertices;
+    uint32_t leaf_indices;
+    float low[3];
+    float high[3];
+    float grown_at;
+    uint32_t reserved;
+};
+
+size_t ForestProxy::getBytes() const {
+    return (wood_vertices.capacity() + leaf_vertices.capacity()) * sizeof(float) +
+           (wood_indices.capacity() + leaf_indices.capacity()) * sizeof(uint32_t);
+}
+
+void ForestProxy::clear() {
+    wood_vertices.clear();
+    wood_indices.clear();
+    leaf_vertices.clear();
+    leaf_indices.clear();
+    low = high = glm::vec3(0.0f);
+    grown_at = 0.0f;
+}
+
+// === FILES ===
+
+template <typename T>
+static bool readArray(std::ifstream& in, std::vector<T>& values, uint32_t count) {
+    values.resize(count);
+    return count == 0 || (bool)in.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+}
+
+bool loadForestProxy(const std::string& path, uint64_t key, ForestProxy& proxy) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    ForestProxyHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (memcmp(header.magic, FOREST_PROXY_MAGIC, sizeof(header.magic)) != 0 || header.key != key ||
+        header.wood_vertices % ForestProxy::VERTEX_FLOATS != 0 || header.leaf_vertices % ForestProxy::VERTEX_FLOATS != 0) {
+        return false;
+    }
+    ForestProxy loaded;
+    if (!readArray(in, loaded.wood_vertices, header.wood_vertices) ||
+        !readArray(in, loaded.wood_indices, header.wood_indices) ||
+        !readArray(in, loaded.leaf_vertices, header.leaf_vertices) ||
+        !readArray(in, loaded.leaf_indices, header.leaf_indices)) {
+        return false;
+    }
+    // Indices past the vertices would read out of the buffers
+    const uint32_t wood_count = header.wood_vertices / ForestProxy::VERTEX_FLOATS;
+    const uint32_t leaf_count = header.leaf_vertices / ForestProxy::VERTEX_FLOATS;
+    for (uint32_t index : loaded.wood_indices) {
+        if (index >= wood_count) return false;
+    }
+    for (uint32_t index : loaded.leaf_indices) {
+        if (index >= leaf_count) return false;
+    }
+    loaded.low = glm::vec3(header.low[0], header.low[1], header.low[2]);
+    loaded.high = glm::vec3(header.high[0], header.high[1], header.high[2]);
+    loaded.grown_at = header.grown_at;
+    std::swap(proxy, loaded);
+    return true;
+}
+
+bool saveForestProxy(const std::string& path, uint64_t key, const ForestProxy& proxy) {
+    ForestProxyHeader header;
+    memcpy(header.magic, FOREST_PROXY_MAGIC, sizeof(header.magic));
+    header.key = key;
+    header.wood_vertices = proxy.wood_vertices.size();
+    header.wood_indices = proxy.wood_indices.size();
+    header.leaf_vertices = proxy.leaf_vertices.size();
+    header.leaf_indices = proxy.leaf_indices.size();
+    for (int k = 0; k < 3; k++) {
+        header.low[k] = proxy.low[k];
+        header.high[k] = proxy.high[k];
+    }
+    header.grown_at = proxy.grown_at;
+    header.reserved = 0;
+    
+    // Write next to the target, then rename over it, so another start
+    // never reads half a proxy
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(proxy.wood_vertices.data()), proxy.wood_vertices.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(proxy.wood_indices.data()), proxy.wood_indices.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(proxy.leaf_vertices.data()), proxy.leaf_vertices.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(proxy.leaf_indices.data()), proxy.leaf_indices.size() * sizeof(uint32_t));
+    out.close();
+    if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
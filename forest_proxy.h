@@ -0,0 +1,53 @@
+#ifndef FOREST_PROXY_H
+#define FOREST_PROXY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Many far trees as one mesh: every tree of a world chunk at its coarsest
+// level of detail, fully grown, placed and merged into static wood and
+// leaf meshes (ForestScene::bakeProxy), so a chunk at the horizon is two
+// draws however many trees it holds. Vertices are world-space
+// (position, normal, texcoord, 0, hue shift): the FOREST variant draws them
+// with growth off and placement left at the identity, the last pair
+// standing in for the instance's (yaw, hue shift).
+//
+// A proxy file caches one under a key of everything it was baked from
+// (the archetypes and the chunk's instances), repeated inside the file so
+// a stale or colliding file reads as a miss
+struct ForestProxy {
+    static const int VERTEX_FLOATS = 10;
+    
+    std::vector<float> wood_vertices;
+    std::vector<uint32_t> wood_indices;
+    std::vector<float> leaf_vertices;
+    std::vector<uint32_t> leaf_indices;
+    glm::vec3 low, high; // World-space bounds
+    float grown_at;      // Scene time from which every tree in it is fully grown
+    
+    ForestProxy() : low(0.0f), high(0.0f), grown_at(0.0f) {}
+    
+    bool isEmpty() const { return wood_indices.empty() && leaf_indices.empty(); }
+    size_t getBytes() const;
+    void clear();
+};
+
+// FNV-1a over bytes, continuing from hash
+inline uint64_t hashProxyBytes(const void* data, size_t bytes, uint64_t hash = 14695981039346656037ULL) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < bytes; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// False, proxy untouched, unless path holds one saved under key
+bool loadForestProxy(const std::string& path, uint64_t key, ForestProxy& proxy);
+// Written next to path, then renamed over it; false if it couldn't be
+bool saveForestProxy(const std::string& path, uint64_t key, const ForestProxy& proxy);
+
+#endif // FOREST_PROXY_H
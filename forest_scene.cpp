@@ -0,0 +1,750 @@
+#include "forest_scene.h"
+#include "depth_pyramid.h"
+#include "fog.h"
+#include "frustum.h"
+#include "gl_dsa.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "memory_stats.h"
+#include "profiler.h"
+#include "render_stats.h"
+#include "shaderprogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+ForestScene::Archetype::Archetype()
+    : center(0.0f), radius(0.0f), growth_buffer(0), growth_texture(0) {
+    for (int level = 0; level < TreeLod::LEVELS; level++) {
+        branch_level_first[level] = branch_level_count[level] = 0;
+        leaf_level_first[level] = leaf_level_count[level] = 0;
+    }
+}
+
+ForestScene::ForestScene()
+    : lod_bias(1.0f), fog(nullptr), archetype_hash(14695981039346656037ULL), proxy_count(0), residency(nullptr), select_threads(1), instance_buffer(0), instance_buffer_size(0), cull_program(nullptr), occlusion_pyramid(nullptr),
+      instance_storage(0), storage_instances(0), bounds_storage(0), command_buffer(0) {}
+
+ForestScene::~ForestScene() {
+    release();
+}
+
+// === ARCHETYPES ===
+
+bool ForestScene::addArchetype(std::unique_ptr<Tree> tree) {
+    if (!tree || tree->getStaticBranchVertices().empty() || tree->getLeafIndices().empty()) {
+        return false;
+    }
+    std::unique_ptr<Archetype> archetype(new Archetype);
+    archetype->tree = std::move(tree);
+    const Tree& grown = *archetype->tree;
+    
+    // The grown tree's bounds, branch radii and leaf sizes included
+    glm::vec3 low(0.0f), high(0.0f);
+    bool first = true;
+    for (const TreeBranch& branch : grown.getBranches()) {
+        glm::vec3 reach(branch.radius);
+        glm::vec3 min = glm::min(branch.start, branch.end) - reach;
+        glm::vec3 max = glm::max(branch.start, branch.end) + reach;
+        low = first ? min : glm::min(low, min);
+        high = first ? max : glm::max(high, max);
+        first = false;
+    }
+    for (const TreeLeaf& leaf : grown.getLeaves()) {
+        glm::vec3 reach(leaf.size);
+        low = glm::min(low, leaf.position - reach);
+        high = glm::max(high, leaf.position + reach);
+    }
+    archetype->center = 0.5f * (low + high);
+    archetype->radius = 0.5f * glm::length(high - low);
+    
+    buildLevels(*archetype);
+    optimizeMeshes(*archetype);
+    
+    // The grown ends as animatedEnd() sums them in v_simplest.glsl: the
+    // trunk's start plus every direction on the path to it
+    const std::vector<float>& growth = grown.getBranchGrowthData();
+    const int floats = Tree::GPU_BRANCH_TEXELS * 4;
+    const int branch_count = growth.size() / floats;
+    archetype->grown_ends.resize(branch_count);
+    for (int i = 0; i < branch_count; i++) {
+        glm::vec3 end(0.0f), base(0.0f);
+        for (int b = i, depth = 0; depth < 32 && b >= 0 && b < branch_count; depth++) {
+            const float* texel = &growth[b * floats];
+            end += glm::vec3(texel[0], texel[1], texel[2]);
+            base = glm::vec3(texel[4], texel[5], texel[6]);
+            b = (int)texel[8];
+        }
+        archetype->grown_ends[i] = base + end;
+    }
+    
+    uint64_t& hash = archetype_hash;
+    hash = hashProxyBytes(archetype->branch_vertices.data(), archetype->branch_vertices.size() * sizeof(float), hash);
+    hash = hashProxyBytes(archetype->leaf_vertices.data(), archetype->leaf_vertices.size() * sizeof(float), hash);
+    hash = hashProxyBytes(archetype->branch_levels.data(), archetype->branch_levels.size() * sizeof(GLuint), hash);
+    hash = hashProxyBytes(archetype->leaf_levels.data(), archetype->leaf_levels.size() * sizeof(GLuint), hash);
+    hash = hashProxyBytes(growth.data(), growth.size() * sizeof(float), hash);
+    const float schedule_end = grown.getScheduleEnd();
+    hash = hashProxyBytes(&schedule_end, sizeof(schedule_end), hash);
+    archetypes.push_back(std::move(archetype));
+    return true;
+}
+
+// Each level's indices: the slots of every element TreeLod still draws at
+// it, in slot order, so a level is a subset of the finer ones
+void ForestScene::buildLevels(Archetype& archetype) {
+    const Tree& tree = *archetype.tree;
+    TreeLod lod;
+    lod.build(tree);
+    
+    const std::vector<GLuint>& branch_indices = tree.getBranchIndices();
+    const std::vector<int>& branch_offsets = tree.getBranchIndexOffsets();
+    const int branch_count = tree.getBranchCount();
+    std::vector<int> slot_branch(branch_offsets.size() - 1, -1);
+    for (int i = 0; i < branch_count; i++) {
+        slot_branch[tree.getBranchSlot(i)] = i;
+    }
+    
+    const std::vector<GLuint>& leaf_indices = tree.getLeafIndices();
+    const int leaf_slots = leaf_indices.size() / Tree::LEAF_SINGLE_SLOT_INDICES;
+    std::vector<int> slot_leaf(leaf_slots, -1);
+    for (int j = 0; j < tree.getLeafCount(); j++) {
+        slot_leaf[tree.getLeafSlot(j)] = j;
+    }
+    
+    archetype.branch_levels.clear();
+    archetype.leaf_levels.clear();
+    for (int level = 0; level < TreeLod::LEVELS; level++) {
+        archetype.branch_level_first[level] = archetype.branch_levels.size();
+        for (size_t s = 0; s < slot_branch.size(); s++) {
+            if (slot_branch[s] >= 0 && lod.getElementLevel(slot_branch[s]) >= level) {
+                archetype.branch_levels.insert(archetype.branch_levels.end(), branch_indices.begin() + branch_offsets[s],
+                                               branch_indices.begin() + branch_offsets[s + 1]);
+            }
+        }
+        archetype.branch_level_count[level] = archetype.branch_levels.size() - archetype.branch_level_first[level];
+        
+        archetype.leaf_level_first[level] = archetype.leaf_levels.size();
+        for (int s = 0; s < leaf_slots; s++) {
+            if (slot_leaf[s] >= 0 && lod.getElementLevel(branch_count + slot_leaf[s]) >= level) {
+                std::vector<GLuint>::const_iterator slot = leaf_indices.begin() + s * Tree::LEAF_SINGLE_SLOT_INDICES;
+                archetype.leaf_levels.insert(archetype.leaf_levels.end(), slot, slot + Tree::LEAF_SINGLE_SLOT_INDICES);
+            }
+        }
+        archetype.leaf_level_count[level] = archetype.leaf_levels.size() - archetype.leaf_level_first[level];
+    }
+}
+
+// Everything a level draws is drawn at once and grows in the vertex
+// shader, so the order of its triangles is free
+void ForestScene::optimizeMeshes(Archetype& archetype) {
+    const Tree& tree = *archetype.tree;
+    archetype.branch_vertices = tree.getStaticBranchVertices();
+    archetype.leaf_vertices = tree.getStaticLeafVertices();
+    optimizeMesh(archetype.branch_vertices, archetype.branch_levels, archetype.branch_level_first,
+                 archetype.branch_level_count);
+    optimizeMesh(archetype.leaf_vertices, archetype.leaf_levels, archetype.leaf_level_first,
+                 archetype.leaf_level_count);
+}
+
+// Each level's triangles for the cache, then the vertices in first use by
+// the finest level, which every coarser one is a subset of
+void ForestScene::optimizeMesh(std::vector<float>& vertices, std::vector<GLuint>& levels, const GLint first[],
+                               const GLsizei count[]) {
+    generated_cache.add(analyzeVertexCache(levels.data() + first[0], count[0]));
+    for (int level = 0; level < TreeLod::LEVELS; level++) {
+        optimizeVertexCache(levels.data() + first[level], count[level]);
+    }
+    optimizeVertexFetch(vertices, Tree::GPU_VERTEX_FLOATS, levels);
+    optimized_cache.add(analyzeVertexCache(levels.data() + first[0], count[0]));
+}
+
+void ForestScene::clearArchetypes() {
+    release();
+    archetypes.clear();
+    archetype_hash = 14695981039346656037ULL;
+    generated_cache = VertexCacheStats();
+    optimized_cache = VertexCacheStats();
+}
+
+// === INSTANCES ===
+
+void ForestScene::scatter(int count, float half_extent, float keep_out, float min_scale, float max_scale,
+                          float max_growth_offset, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const int archetype_count = std::max(1, (int)archetypes.size());
+    for (int i = 0; i < count; i++) {
+        ForestInstance instance;
+        // Rejection sampling around the keep-out circle; a few tries, then
+        // wherever the last one landed
+        for (int attempt = 0; attempt < 16; attempt++) {
+            instance.position = glm::vec3((2.0f * unit(random) - 1.0f) * half_extent, 0.0f,
+                                          (2.0f * unit(random) - 1.0f) * half_extent);
+            if (glm::length(instance.position) >= keep_out) break;
+        }
+        instance.scale = min_scale + (max_scale - min_scale) * unit(random);
+        instance.yaw = 2.0f * 3.14159265f * unit(random);
+        instance.hue_shift = 0.7f * (unit(random) - 0.5f);
+        instance.growth_offset = max_growth_offset * unit(random);
+        instance.archetype = random() % archetype_count;
+        instances.push_back(instance);
+    }
+}
+
+std::vector<float> ForestScene::getCrownRadii() const {
+    std::vector<float> radii;
+    for (const std::unique_ptr<Archetype>& archetype : archetypes) {
+        radii.push_back(TreePlacement::crownRadius(*archetype->tree));
+    }
+    return radii;
+}
+
+void ForestScene::place(const TreePlacement& placement, const glm::vec2& low, const glm::vec2& high,
+                        int max_count, float max_growth_offset, uint32_t seed, std::vector<ForestInstance>& instances) {
+    std::vector<TreeSite> sites;
+    placement.place(low, high, seed, sites);
+    std::mt19937 random(seed ^ 0x9e3779b9u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const int count = std::min((int)sites.size(), std::max(0, max_count));
+    for (int i = 0; i < count; i++) {
+        // The first count of a partial shuffle
+        std::swap(sites[i], sites[i + random() % (sites.size() - i)]);
+        ForestInstance instance;
+        instance.position = glm::vec3(sites[i].position.x, 0.0f, sites[i].position.y);
+        instance.scale = sites[i].scale;
+        instance.yaw = 2.0f * 3.14159265f * unit(random);
+        instance.hue_shift = 0.7f * (unit(random) - 0.5f);
+        instance.growth_offset = max_growth_offset * unit(random);
+        instance.archetype = sites[i].kind;
+        instances.push_back(instance);
+    }
+}
+
+bool ForestScene::isGrownAt(float time) const {
+    for (const ForestInstance& instance : instances) {
+        if (instance.archetype < (int)archetypes.size() &&
+            time < instance.growth_offset + archetypes[instance.archetype]->tree->getScheduleEnd()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// === PROXIES ===
+
+namespace {
+
+// One proxy leaf in PROXY_LEAF_STRIDE, that many times the area, keeps
+// the canopy's coverage at a fraction of its triangles
+const int PROXY_LEAF_STRIDE = 8;
+
+// Branches past this generation are too thin to see where proxies are drawn
+const int PROXY_MAX_GENERATION = 1;
+
+// Whether a leaf triangle's leaf is one the proxy keeps: all its corners
+// share the leaf's growth record, which keys it
+bool keepsProxyLeaf(const float* v) {
+    uint32_t key[3];
+    memcpy(&key[0], &v[9], sizeof(float));
+    memcpy(&key[1], &v[10], sizeof(float));
+    memcpy(&key[2], &v[12], sizeof(float));
+    uint32_t hash = key[0] * 2654435761u ^ key[1] * 40503u ^ key[2];
+    hash ^= hash >> 15;
+    hash *= 2246822519u;
+    hash ^= hash >> 13;
+    return hash % PROXY_LEAF_STRIDE == 0;
+}
+
+// One instance's level of an archetype mesh onto a proxy's, grown, placed
+// and with the instance's hue, leaves thinned. remap, as long as the
+// mesh's vertices and all -1, maps the ones already appended to their
+// proxy index and is left all -1 again
+void appendProxyTrees(const std::vector<float>& mesh, const GLuint* indices, int count, bool leaves,
+                      const std::vector<glm::vec3>& grown_ends, const std::vector<float>& growth,
+                      const ForestInstance& instance, std::vector<int>& remap, std::vector<float>& vertices,
+                      std::vector<uint32_t>& proxy_indices, glm::vec3& low, glm::vec3& high, bool& first) {
+    const int floats = Tree::GPU_VERTEX_FLOATS;
+    const int branch_floats = Tree::GPU_BRANCH_TEXELS * 4;
+    const float leaf_scale = sqrtf((float)PROXY_LEAF_STRIDE);
+    const float c = cosf(instance.yaw);
+    const float s = sinf(instance.yaw);
+    for (int triangle = 0; triangle + 3 <= count; triangle += 3) {
+        const float* first_corner = &mesh[indices[triangle] * floats];
+        if (leaves && !keepsProxyLeaf(first_corner)) continue;
+        if (!leaves && (size_t)first_corner[9] < grown_ends.size() &&
+            growth[(size_t)first_corner[9] * branch_floats + 9] > PROXY_MAX_GENERATION) {
+            continue;
+        }
+        for (int corner = triangle; corner < triangle + 3; corner++) {
+            const GLuint source = indices[corner];
+            if (remap[source] < 0) {
+                const float* v = &mesh[source * floats];
+                const int b = std::max(0, std::min((int)v[9], (int)grown_ends.size() - 1));
+                glm::vec3 position(v[0], v[1], v[2]);
+                if (leaves) {
+                    // At full growth a leaf's size is its record's size
+                    position += grown_ends[b] + glm::vec3(v[13], v[14], v[15]) * (v[12] * leaf_scale);
+                } else {
+                    // A ring's share along the branch and a curved one's sag
+                    glm::vec3 center = grown_ends[b] + glm::vec3(v[13], v[14], v[15]);
+                    center -= glm::vec3(growth[b * branch_floats], growth[b * branch_floats + 1],
+                                        growth[b * branch_floats + 2]) * (1.0f - v[10]);
+                    position += center;
+                }
+                position *= instance.scale;
+                position = instance.position + glm::vec3(c * position.x + s * position.z, position.y,
+                                                         c * position.z - s * position.x);
+                const glm::vec3 normal(c * v[6] + s * v[8], v[7], c * v[8] - s * v[6]);
+                remap[source] = vertices.size() / ForestProxy::VERTEX_FLOATS;
+                const float record[ForestProxy::VERTEX_FLOATS] = { position.x, position.y, position.z,
+                                                                   normal.x, normal.y, normal.z, v[4], v[5],
+                                                                   0.0f, instance.hue_shift };
+                vertices.insert(vertices.end(), record, record + ForestProxy::VERTEX_FLOATS);
+                low = first ? position : glm::min(low, position);
+                high = first ? position : glm::max(high, position);
+                first = false;
+            }
+            proxy_indices.push_back(remap[source]);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        remap[indices[i]] = -1;
+    }
+}
+
+}
+
+void ForestScene::bakeProxy(const std::vector<ForestInstance>& placed, ForestProxy& proxy) const {
+    PROFILE_SCOPE("ForestScene::bakeProxy");
+    proxy.clear();
+    const int level = TreeLod::LEVELS - 1;
+    std::vector<int> remap;
+    bool first = true;
+    for (const ForestInstance& instance : placed) {
+        if (instance.archetype < 0 || instance.archetype >= (int)archetypes.size()) continue;
+        const Archetype& archetype = *archetypes[instance.archetype];
+        const Tree& tree = *archetype.tree;
+        proxy.grown_at = std::max(proxy.grown_at, instance.growth_offset + tree.getScheduleEnd());
+        const size_t mesh_vertices = std::max(archetype.branch_vertices.size(), archetype.leaf_vertices.size()) /
+                                     Tree::GPU_VERTEX_FLOATS;
+        if (remap.size() < mesh_vertices) remap.resize(mesh_vertices, -1);
+        appendProxyTrees(archetype.branch_vertices, archetype.branch_levels.data() + archetype.branch_level_first[level],
+                         archetype.branch_level_count[level], false, archetype.grown_ends,
+                         tree.getBranchGrowthData(), instance, remap, proxy.wood_vertices, proxy.wood_indices,
+                         proxy.low, proxy.high, first);
+        appendProxyTrees(archetype.leaf_vertices, archetype.leaf_levels.data() + archetype.leaf_level_first[level],
+                         archetype.leaf_level_count[level], true, archetype.grown_ends, tree.getBranchGrowthData(),
+                         instance, remap, proxy.leaf_vertices, proxy.leaf_indices, proxy.low, proxy.high, first);
+    }
+    // Merged in instance order, so each tree's triangles stay together as
+    // the archetype's cache order left them
+    proxy.wood_vertices.shrink_to_fit();
+    proxy.wood_indices.shrink_to_fit();
+    proxy.leaf_vertices.shrink_to_fit();
+    proxy.leaf_indices.shrink_to_fit();
+}
+
+int ForestScene::addProxy(const std::shared_ptr<const ForestProxy>& proxy) {
+    std::unique_ptr<Proxy> uploaded(new Proxy);
+    uploaded->source = proxy;
+    uploaded->wood_indices = proxy->wood_indices.size();
+    uploaded->leaf_indices = proxy->leaf_indices.size();
+    uploaded->low = proxy->low;
+    uploaded->high = proxy->high;
+    uploaded->residency_handle = -1;
+    uploadProxy(*uploaded);
+    size_t handle = 0;
+    while (handle < proxies.size() && proxies[handle]) {
+        handle++;
+    }
+    if (handle == proxies.size()) proxies.emplace_back();
+    if (residency) {
+        Proxy* target = uploaded.get();
+        uploaded->residency_handle = residency->add("forest proxies", proxy->getBytes(),
+                                                    [this, target]() { releaseProxy(*target); });
+    }
+    proxies[handle] = std::move(uploaded);
+    proxy_count++;
+    return handle;
+}
+
+void ForestScene::uploadProxy(Proxy& proxy) {
+    createProxyMesh(proxy.wood_mesh, proxy.source->wood_vertices, proxy.source->wood_indices);
+    createProxyMesh(proxy.leaf_mesh, proxy.source->leaf_vertices, proxy.source->leaf_indices);
+}
+
+void ForestScene::releaseProxy(Proxy& proxy) {
+    proxy.wood_mesh.release();
+    proxy.leaf_mesh.release();
+}
+
+void ForestScene::removeProxy(int handle) {
+    if (handle < 0 || handle >= (int)proxies.size() || !proxies[handle]) return;
+    releaseProxy(*proxies[handle]);
+    if (residency) residency->remove(proxies[handle]->residency_handle);
+    proxies[handle].reset();
+    proxy_count--;
+    visible_proxies.erase(std::remove(visible_proxies.begin(), visible_proxies.end(), handle), visible_proxies.end());
+}
+
+// === GPU ===
+
+// World-space proxy vertices at the same fixed locations, the last pair
+// as the FOREST variant's (yaw, hue shift)
+void ForestScene::createProxyMesh(GpuMesh& mesh, const std::vector<float>& vertices,
+                                  const std::vector<GLuint>& indices) {
+    const int stride = ForestProxy::VERTEX_FLOATS * sizeof(GLfloat);
+    mesh.create(true, false, "forest proxies");
+    mesh.uploadVertices(vertices.data(), vertices.size() * sizeof(float), GL_STATIC_DRAW);
+    mesh.uploadIndices(indices);
+    mesh.attribute(mesh.vbo, 0, 3, GL_FLOAT, false, stride, 0);                   // vertex
+    mesh.attribute(mesh.vbo, 1, 3, GL_FLOAT, false, stride, 3 * sizeof(GLfloat)); // normal
+    mesh.attribute(mesh.vbo, 2, 2, GL_FLOAT, false, stride, 6 * sizeof(GLfloat)); // texcoord
+    mesh.attribute(mesh.vbo, PARAMETERS_LOCATION, 2, GL_FLOAT, false, stride, 8 * sizeof(GLfloat));
+}
+
+// A static GPU-growth mesh, its attributes at v_simplest.glsl's fixed
+// locations (createTreeMesh's layout with growthRef and cornerDir)
+void ForestScene::createMesh(GpuMesh& mesh, const std::vector<float>& vertices, const std::vector<GLuint>& indices) {
+    const int stride = Tree::GPU_VERTEX_FLOATS * sizeof(GLfloat);
+    mesh.create(true, false, "forest");
+    mesh.uploadVertices(vertices.data(), vertices.size() * sizeof(float), GL_STATIC_DRAW);
+    mesh.uploadIndices(indices);
+    mesh.attribute(mesh.vbo, 0, 4, GL_FLOAT, false, stride, 0);                   // vertex
+    mesh.attribute(mesh.vbo, 2, 2, GL_FLOAT, false, stride, 4 * sizeof(GLfloat)); // texcoord
+    mesh.attribute(mesh.vbo, 1, 3, GL_FLOAT, false, stride, 6 * sizeof(GLfloat)); // normal
+    mesh.attribute(mesh.vbo, 3, 4, GL_FLOAT, false, stride, 9 * sizeof(GLfloat)); // growthRef
+    mesh.attribute(mesh.vbo, 4, 3, GL_FLOAT, false, stride, 13 * sizeof(GLfloat)); // cornerDir
+}
+
+// Binds the growth tables directly, behind a GlStateCache's back
+// (GlStateCache::invalidateTextures)
+void ForestScene::upload() {
+    for (const std::unique_ptr<Archetype>& archetype : archetypes) {
+        const Tree& tree = *archetype->tree;
+        createMesh(archetype->branch_mesh, archetype->branch_vertices, archetype->branch_levels);
+        createMesh(archetype->leaf_mesh, archetype->leaf_vertices, archetype->leaf_levels);
+        
+        const std::vector<float>& growth = tree.getBranchGrowthData();
+        if (archetype->growth_buffer == 0) glGenBuffers(1, &archetype->growth_buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, archetype->growth_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, growth.size() * sizeof(float), growth.data(), GL_STATIC_DRAW);
+        MemoryStats::trackBuffer(archetype->growth_buffer, growth.size() * sizeof(float), "forest");
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        if (archetype->growth_texture == 0) glGenTextures(1, &archetype->growth_texture);
+        glBindTexture(GL_TEXTURE_BUFFER, archetype->growth_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, archetype->growth_buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    // Created through GlDsa, as the meshes read it as an attribute buffer
+    if (instance_buffer == 0) instance_buffer = GlDsa::createBuffer();
+    instance_buffer_size = 0;
+    if (cull_program) uploadCulling();
+}
+
+void ForestScene::uploadInstances() {
+    if (cull_program && instance_buffer) uploadCulling();
+}
+
+// The cull program's inputs, and the draw commands: archetype a's command
+// for level L draws from run a * LEVELS + L, each of its runs as long as
+// its instance count
+void ForestScene::uploadCulling() {
+    const int archetype_count = archetypes.size();
+    std::vector<int> archetype_instances(archetype_count, 0);
+    for (const ForestInstance& instance : instances) {
+        if (instance.archetype >= 0 && instance.archetype < archetype_count) archetype_instances[instance.archetype]++;
+    }
+    std::vector<glm::vec4> bounds(archetype_count);
+    commands.assign(2 * archetype_count * TreeLod::LEVELS, DrawCommand());
+    GLuint run = 0;
+    for (int a = 0; a < archetype_count; a++) {
+        const Archetype& archetype = *archetypes[a];
+        bounds[a] = glm::vec4(archetype.center, archetype.radius);
+        for (int level = 0; level < TreeLod::LEVELS; level++) {
+            DrawCommand wood = { (GLuint)archetype.branch_level_count[level], 0,
+                                 (GLuint)archetype.branch_level_first[level], 0, run };
+            DrawCommand leaves = { (GLuint)archetype.leaf_level_count[level], 0,
+                                   (GLuint)archetype.leaf_level_first[level], 0, run };
+            commands[a * TreeLod::LEVELS + level] = wood;
+            commands[(archetype_count + a) * TreeLod::LEVELS + level] = leaves;
+            run += archetype_instances[a];
+        }
+    }
+    
+    if (instance_storage == 0) glGenBuffers(1, &instance_storage);
+    if (bounds_storage == 0) glGenBuffers(1, &bounds_storage);
+    if (command_buffer == 0) glGenBuffers(1, &command_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance_storage);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(ForestInstance), instances.data(), GL_STATIC_DRAW);
+    MemoryStats::trackBuffer(instance_storage, instances.size() * sizeof(ForestInstance), "forest");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bounds_storage);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(glm::vec4), bounds.data(), GL_STATIC_DRAW);
+    MemoryStats::trackBuffer(bounds_storage, bounds.size() * sizeof(glm::vec4), "forest");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_DYNAMIC_DRAW);
+    MemoryStats::trackBuffer(command_buffer, commands.size() * sizeof(DrawCommand), "forest");
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    storage_instances = instances.size();
+    
+    // The runs, written by the cull program and read per instance from
+    // the commands' base instances
+    instance_buffer_size = std::max<size_t>(run, 1) * sizeof(ForestInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, instance_buffer_size, nullptr, GL_DYNAMIC_COPY);
+    MemoryStats::trackBuffer(instance_buffer, instance_buffer_size, "forest");
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    const int stride = sizeof(ForestInstance);
+    for (const std::unique_ptr<Archetype>& archetype : archetypes) {
+        GpuMesh* meshes[2] = { &archetype->branch_mesh, &archetype->leaf_mesh };
+        for (GpuMesh* mesh : meshes) {
+            mesh->attribute(instance_buffer, PLACEMENT_LOCATION, 4, GL_FLOAT, false, stride, 0, 1);
+            mesh->attribute(instance_buffer, PARAMETERS_LOCATION, 3, GL_FLOAT, false, stride, 4 * sizeof(GLfloat), 1);
+        }
+    }
+}
+
+void ForestScene::release() {
+    for (const std::unique_ptr<Archetype>& archetype : archetypes) {
+        archetype->branch_mesh.release();
+        archetype->leaf_mesh.release();
+        MemoryStats::forgetBuffers(1, &archetype->growth_buffer);
+        if (archetype->growth_buffer) glDeleteBuffers(1, &archetype->growth_buffer);
+        if (archetype->growth_texture) glDeleteTextures(1, &archetype->growth_texture);
+        archetype->growth_buffer = archetype->growth_texture = 0;
+    }
+    const GLuint buffers[4] = { instance_buffer, instance_storage, bounds_storage, command_buffer };
+    MemoryStats::forgetBuffers(4, buffers);
+    if (instance_buffer) glDeleteBuffers(1, &instance_buffer);
+    if (instance_storage) glDeleteBuffers(1, &instance_storage);
+    if (bounds_storage) glDeleteBuffers(1, &bounds_storage);
+    if (command_buffer) glDeleteBuffers(1, &command_buffer);
+    instance_buffer = instance_storage = bounds_storage = command_buffer = 0;
+    instance_buffer_size = 0;
+    storage_instances = 0;
+    commands.clear();
+    for (const std::unique_ptr<Proxy>& proxy : proxies) {
+        if (!proxy) continue;
+        releaseProxy(*proxy);
+        if (residency) residency->remove(proxy->residency_handle);
+    }
+    proxies.clear();
+    proxy_count = 0;
+    visible_proxies.clear();
+}
+
+// === PER FRAME ===
+
+// Instances a select job records; the chunks' batch counts are merged in
+// chunk order, so results don't depend on the threads
+static const int SELECT_CHUNK = 2048;
+
+void ForestScene::select(GlStateCache& state, const ViewFrustum* frustum, const glm::vec3& eye, float fov_y) {
+    visible_proxies.clear();
+    for (size_t p = 0; p < proxies.size(); p++) {
+        if (proxies[p] && (!frustum || frustum->classify(proxies[p]->low, proxies[p]->high) >= 0)) {
+            visible_proxies.push_back(p);
+            // Back in view after an eviction: uploaded again from its source
+            Proxy& proxy = *proxies[p];
+            if (residency && !residency->touch(proxy.residency_handle)) {
+                residency->makeResident(proxy.residency_handle);
+                uploadProxy(proxy);
+            }
+        }
+    }
+    if (isGpuCulling()) {
+        selectOnGpu(state, frustum, eye, fov_y);
+        return;
+    }
+    const int archetype_count = archetypes.size();
+    const int batch_slots = archetype_count * TreeLod::LEVELS;
+    const int instance_count = instances.size();
+    const int chunks = JobSystem::chunkCount(instance_count, SELECT_CHUNK);
+    chunk_counts.assign((size_t)chunks * batch_slots, 0);
+    kept.assign(instance_count, 0xff);
+    
+    // === VISIBLE INSTANCES AND LEVELS, PER CHUNK ===
+    // Each chunk counts its own batches, so the workers share nothing
+    JobSystem::shared().parallelFor(instance_count, SELECT_CHUNK, [&](int chunk, int begin, int end) {
+        int* counts = &chunk_counts[(size_t)chunk * batch_slots];
+        for (int i = begin; i < end; i++) {
+            const ForestInstance& instance = instances[i];
+            if (instance.archetype < 0 || instance.archetype >= archetype_count) continue;
+            const Archetype& archetype = *archetypes[instance.archetype];
+            // The bounding sphere turned as the FOREST variant turns the tree
+            float c = cosf(instance.yaw);
+            float s = sinf(instance.yaw);
+            glm::vec3 offset = archetype.center * instance.scale;
+            glm::vec3 center = instance.position + glm::vec3(c * offset.x + s * offset.z, offset.y, c * offset.z - s * offset.x);
+            float radius = archetype.radius * instance.scale;
+            if (frustum && frustum->classify(center - glm::vec3(radius), center + glm::vec3(radius)) < 0) continue;
+            float size = TreeLod::projectedSize(center, radius, eye, fov_y) / lod_bias;
+            if (fog) size *= fog->visibility(glm::length(center - eye));
+            int level = level_selector.selectLevel(size);
+            kept[i] = (unsigned char)level;
+            counts[instance.archetype * TreeLod::LEVELS + level]++;
+        }
+    }, select_threads);
+    
+    // One batch per non-empty archetype and level, the records grouped
+    // in batch order and, within a batch, in chunk order: each chunk's
+    // count becomes its write cursor
+    batches.clear();
+    int total = 0;
+    for (int slot = 0; slot < batch_slots; slot++) {
+        const int first = total;
+        for (int chunk = 0; chunk < chunks; chunk++) {
+            int& count = chunk_counts[(size_t)chunk * batch_slots + slot];
+            const int cursor = total;
+            total += count;
+            count = cursor;
+        }
+        if (total == first) continue;
+        ForestBatch batch = { slot / TreeLod::LEVELS, slot % TreeLod::LEVELS, first, total - first };
+        batches.push_back(batch);
+    }
+    visible.resize(total);
+    JobSystem::shared().parallelFor(instance_count, SELECT_CHUNK, [&](int chunk, int begin, int end) {
+        int* cursors = &chunk_counts[(size_t)chunk * batch_slots];
+        for (int i = begin; i < end; i++) {
+            if (kept[i] == 0xff) continue;
+            visible[cursors[instances[i].archetype * TreeLod::LEVELS + kept[i]]++] = instances[i];
+        }
+    }, select_threads);
+    
+    if (instance_buffer == 0 || visible.empty()) return;
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    size_t bytes = visible.size() * sizeof(ForestInstance);
+    if (bytes > instance_buffer_size) {
+        glBufferData(GL_ARRAY_BUFFER, bytes, visible.data(), GL_STREAM_DRAW);
+        instance_buffer_size = bytes;
+        MemoryStats::trackBuffer(instance_buffer, bytes, "forest");
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, visible.data());
+    }
+    RenderStats::countUpload(bytes);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Reset the commands' instance counts and let the cull program fill them
+// and the runs; the barrier orders its writes before the draws read them
+void ForestScene::selectOnGpu(GlStateCache& state, const ViewFrustum* frustum, const glm::vec3& eye, float fov_y) {
+    batches.clear();
+    visible.clear();
+    if (storage_instances == 0) return;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawCommand), commands.data());
+    RenderStats::countUpload(commands.size() * sizeof(DrawCommand));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    
+    state.useProgram(cull_program);
+    state.uniform1i("instanceCount", storage_instances);
+    state.uniform1i("archetypeCount", archetypes.size());
+    state.uniform1i("cullFrustum", frustum ? 1 : 0);
+    if (frustum) {
+        glUniform4fv(cull_program->u("frustumPlanes"), 6 * frustum->view_count, &frustum->planes[0].x);
+        state.uniform1i("frustumViews", frustum->view_count);
+    }
+    state.uniform3fv("eye", &eye.x);
+    state.uniform1f("tanHalfFov", tanf(0.5f * fov_y));
+    state.uniform1f("lodBias", lod_bias);
+    glm::vec4 fogParameters = fog ? fog->getParameters() : glm::vec4(0.0f);
+    glUniform4fv(cull_program->u("fog"), 1, &fogParameters.x);
+    float sizes[TreeLod::LEVELS - 1];
+    for (int i = 0; i < TreeLod::LEVELS - 1; i++) {
+        sizes[i] = level_selector.getLevelSize(i);
+    }
+    glUniform1fv(cull_program->u("levelSizes"), TreeLod::LEVELS - 1, sizes);
+    bool occlusion = occlusion_pyramid && occlusion_pyramid->isBuilt();
+    state.uniform1i("occlusionCulling", occlusion ? 1 : 0);
+    if (occlusion) {
+        state.bindTexture(DepthPyramid::UNIT, GL_TEXTURE_2D, occlusion_pyramid->getTexture());
+        state.uniform1i("depthPyramid", DepthPyramid::UNIT);
+        state.uniform1i("pyramidLevels", occlusion_pyramid->getLevels());
+        state.uniformMatrix4fv("pyramidViewProjection", &occlusion_pyramid->getViewProjection()[0][0]);
+    }
+    
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instance_storage);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, bounds_storage);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, instance_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, command_buffer);
+    glDispatchCompute((storage_instances + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+int ForestScene::getDrawnInstances() const {
+    if (!isGpuCulling()) return visible.size();
+    std::vector<DrawCommand> wood(archetypes.size() * TreeLod::LEVELS);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, wood.size() * sizeof(DrawCommand), wood.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    int drawn = 0;
+    for (const DrawCommand& command : wood) {
+        drawn += command.instance_count;
+    }
+    return drawn;
+}
+
+// GL 3.3 has no base instance, so each batch points the instance
+// attributes at its first record
+void ForestScene::drawMeshes(GlStateCache& state, bool leaves) const {
+    const int stride = sizeof(ForestInstance);
+    state.uniform1i("branchData", BRANCH_DATA_UNIT);
+    state.uniform1i("growthMode", leaves ? 2 : 1);
+    if (isGpuCulling()) {
+        // Every level of an archetype in one call, empty ones included
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        for (size_t a = 0; a < archetypes.size(); a++) {
+            Archetype& archetype = *archetypes[a];
+            GpuMesh& mesh = leaves ? archetype.leaf_mesh : archetype.branch_mesh;
+            size_t command = ((leaves ? archetypes.size() : 0) + a) * TreeLod::LEVELS;
+            state.bindTexture(BRANCH_DATA_UNIT, GL_TEXTURE_BUFFER, archetype.growth_texture);
+            mesh.bind();
+            mesh.drawIndirect(command * sizeof(DrawCommand), TreeLod::LEVELS);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    for (const ForestBatch& batch : batches) {
+        Archetype& archetype = *archetypes[batch.archetype];
+        GpuMesh& mesh = leaves ? archetype.leaf_mesh : archetype.branch_mesh;
+        GLsizei count = leaves ? archetype.leaf_level_count[batch.level] : archetype.branch_level_count[batch.level];
+        GLint first = leaves ? archetype.leaf_level_first[batch.level] : archetype.branch_level_first[batch.level];
+        state.bindTexture(BRANCH_DATA_UNIT, GL_TEXTURE_BUFFER, archetype.growth_texture);
+        size_t offset = (size_t)batch.first_instance * stride;
+        mesh.attribute(instance_buffer, PLACEMENT_LOCATION, 4, GL_FLOAT, false, stride, offset, 1);
+        mesh.attribute(instance_buffer, PARAMETERS_LOCATION, 3, GL_FLOAT, false, stride, offset + 4 * sizeof(GLfloat), 1);
+        mesh.bind();
+        mesh.drawInstanced(count, batch.instance_count, first);
+    }
+    drawProxies(state, leaves);
+    GpuMesh::unbind();
+    state.uniform1i("growthMode", 0);
+}
+
+// Grown already and placed, so the placement attribute, off in their
+// meshes, holds the identity
+void ForestScene::drawProxies(GlStateCache& state, bool leaves) const {
+    if (visible_proxies.empty()) return;
+    state.uniform1i("growthMode", 0);
+    glVertexAttrib4f(PLACEMENT_LOCATION, 0.0f, 0.0f, 0.0f, 1.0f);
+    for (int p : visible_proxies) {
+        const Proxy& proxy = *proxies[p];
+        const GpuMesh& mesh = leaves ? proxy.leaf_mesh : proxy.wood_mesh;
+        const GLsizei count = leaves ? proxy.leaf_indices : proxy.wood_indices;
+        if (count == 0) continue;
+        mesh.bind();
+        mesh.draw(count);
+    }
+}
+
+void ForestScene::drawWood(GlStateCache& state) const {
+    drawMeshes(state, false);
+}
+
+void ForestScene::drawLeaves(GlStateCache& state) const {
+    state.uniform1i("twoSidedLeaves", 1); // Single-sided, lit from behind with the flipped normal
+    drawMeshes(state, true);
+}
@@ -0,0 +1,276 @@
+#ifndef FOREST_SCENE_H
+#define FOREST_SCENE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "forest_proxy.h"
+#include "gpu_mesh.h"
+#include "gpu_residency.h"
+#include "tree_lod.h"
+#include "tree_placement.h"
+#include "tree_simple.h"
+#include "vertex_cache.h"
+
+class DepthPyramid;
+class DistanceFog;
+class GlStateCache;
+class ShaderProgram;
+struct ViewFrustum;
+
+// One placed copy of a forest archetype. The first 28 bytes are the
+// FOREST shader variant's per-instance attributes
+struct ForestInstance {
+    glm::vec3 position;  // Where the archetype's origin goes
+    float scale;
+    float yaw;           // Rotation about +y, radians
+    float hue_shift;     // Turn of the leaves' hue, radians
+    float growth_offset; // Seconds the instance's growth lags the scene clock
+    int archetype;
+};
+
+static_assert(sizeof(ForestInstance) == 32, "ForestInstance must stay tightly packed");
+
+// One instanced draw of a frame: instance_count visible copies of an
+// archetype at one level of detail, from first_instance of the frame's
+// instance records
+struct ForestBatch {
+    int archetype;
+    int level;
+    int first_instance;
+    int instance_count;
+};
+
+// Many trees for the draw cost of a few: a small set of archetype trees,
+// each generated once with GPU growth (MeshAnimation::Gpu) and uploaded as
+// static meshes, and many instances placing, scaling, turning, tinting and
+// delaying them. The FOREST variant of v_simplest.glsl applies an
+// instance's transform on top of the growth animation, evaluated at the
+// scene clock minus its offset; every frame select() culls the instances
+// by their bounding spheres, picks each one's level of detail (TreeLod)
+// by its size on screen, and uploads the visible ones grouped by archetype
+// and level so each group is one glDrawElementsInstanced call.
+//
+// An archetype's levels are index lists into its static meshes: level L
+// holds every element TreeLod draws at L, all levels in one index buffer.
+// Each level is drawn whole, so its triangles are reordered for the
+// post-transform vertex cache, and the vertices then for the order the
+// finest level fetches them in. Archetypes need single-sided leaves, which
+// are indexed.
+//
+// With a cull program (GL 4.3) the selection runs on the GPU instead:
+// c_forest_cull.glsl culls and picks levels for every instance and appends
+// the visible ones to fixed runs of the instance buffer, one run per
+// archetype and level with room for all of the archetype's instances,
+// counting them into indirect draw commands. Each archetype then draws its
+// wood and its leaves with one glMultiDrawElementsIndirect call each, the
+// command's base instance selecting its run, so the CPU's work per frame
+// no longer grows with the forest
+class ForestScene {
+public:
+    static const int BRANCH_DATA_UNIT = 11; // The archetypes' growth tables
+    static const int PLACEMENT_LOCATION = 14; // v_simplest.glsl's FOREST inputs
+    static const int PARAMETERS_LOCATION = 15;
+    
+    ForestScene();
+    ~ForestScene();
+    
+    // === ARCHETYPES ===
+    // Take a generated tree as the next archetype; false (the tree is
+    // dropped) unless it has GPU growth meshes and single-sided leaves
+    bool addArchetype(std::unique_ptr<Tree> tree);
+    int getArchetypeCount() const { return archetypes.size(); }
+    const Tree& getArchetype(int index) const { return *archetypes[index]->tree; }
+    // TreePlacement::crownRadius() of each archetype, the placement's kinds
+    std::vector<float> getCrownRadii() const;
+    void clearArchetypes();
+    // The vertex cache over every archetype's finest level, wood and
+    // leaves: in the tree's slot order, and as drawn
+    const VertexCacheStats& getGeneratedCacheStats() const { return generated_cache; }
+    const VertexCacheStats& getOptimizedCacheStats() const { return optimized_cache; }
+    
+    // === INSTANCES ===
+    void addInstance(const ForestInstance& instance) { instances.push_back(instance); }
+    // Scatter count instances uniformly over the square of half_extent
+    // around the origin, outside keep_out of it, scaled in [min_scale,
+    // max_scale] and growing up to max_growth_offset seconds late
+    void scatter(int count, float half_extent, float keep_out, float min_scale, float max_scale,
+                 float max_growth_offset, uint32_t seed);
+    // Append instances at placement's sites over [low, high), its kinds the
+    // archetypes, each turned, tinted and growing up to max_growth_offset
+    // seconds late; at most max_count of them, a random choice of the sites
+    // when more fit, which keeps their spacing. Reads no scene, so world
+    // chunks place theirs on the workers
+    static void place(const TreePlacement& placement, const glm::vec2& low, const glm::vec2& high,
+                      int max_count, float max_growth_offset, uint32_t seed, std::vector<ForestInstance>& instances);
+    void clearInstances() { instances.clear(); }
+    const std::vector<ForestInstance>& getInstances() const { return instances; }
+    
+    // Whether every instance is fully grown at scene time t
+    bool isGrownAt(float time) const;
+    
+    // === LEVELS OF DETAIL ===
+    // Projected sizes choosing each level (TreeLod::setLevelSizes); bias > 1
+    // picks coarser levels sooner
+    void setLevelSizes(const float sizes[TreeLod::LEVELS - 1]) { level_selector.setLevelSizes(sizes); }
+    void setLodBias(float bias) { lod_bias = bias; }
+    // Fog the levels see through (nullptr = none): a tree's projected size
+    // is scaled by the share of it the fog leaves (DistanceFog::visibility)
+    void setFog(const DistanceFog* distance_fog) { fog = distance_fog; }
+    
+    // === PROXIES ===
+    // Merge the trees of instances, fully grown at the coarsest level, into
+    // proxy's world-space meshes. Reads the archetypes alone, so it may run
+    // on any thread while they stay put
+    void bakeProxy(const std::vector<ForestInstance>& instances, ForestProxy& proxy) const;
+    // Of every archetype's meshes, levels and growth table: what a cached
+    // proxy was baked from besides its instances
+    uint64_t getArchetypeHash() const { return archetype_hash; }
+    // Upload proxy to be culled as a whole and drawn after the instances,
+    // returning its handle; release() drops every proxy. The proxy is kept
+    // (shared with its chunk) to be uploaded again after an eviction
+    int addProxy(const std::shared_ptr<const ForestProxy>& proxy);
+    // Register the proxies with residency (nullptr = off, the default), so
+    // those least recently drawn are evicted over its budget and uploaded
+    // again when select() finds them in view. Before the first addProxy()
+    void setResidency(GpuResidency* manager) { residency = manager; }
+    void removeProxy(int handle);
+    int getProxyCount() const { return proxy_count; }
+    int getDrawnProxies() const { return visible_proxies.size(); }
+    
+    // === GPU ===
+    // Upload every archetype's meshes, level indices and growth table, and
+    // create the instance buffer
+    void upload();
+    void release();
+    // Send the instances again after they changed: the cull program's
+    // inputs and runs (the CPU path uploads its visible ones every frame)
+    void uploadInstances();
+    
+    // === GPU CULLING ===
+    // Select with program, c_forest_cull.glsl built with LEVELS defined as
+    // TreeLod::LEVELS and VIEWS as ViewFrustum::MAX_VIEWS; nullptr = on
+    // the CPU. Takes effect on the next upload(), which also sends the
+    // instances the program reads
+    void setCullProgram(ShaderProgram* program) { cull_program = program; }
+    bool isGpuCulling() const { return cull_program != nullptr && command_buffer != 0; }
+    // Also hide the instances behind what pyramid holds, once it is built;
+    // nullptr = frustum culling only. The pyramid is the last frame's, so a
+    // tree the camera uncovers can be missing for a frame
+    void setOcclusion(const DepthPyramid* pyramid) { occlusion_pyramid = pyramid; }
+    
+    // === PER FRAME ===
+    // Cull the instances against the frustum (nullptr = keep all), choose
+    // their levels from the eye and the vertical field of view, and upload
+    // the visible ones; the batches then draw them. With GPU culling this
+    // dispatches the cull program through state and leaves no batches
+    void select(GlStateCache& state, const ViewFrustum* frustum, const glm::vec3& eye, float fov_y);
+    // Threads of the shared job system the CPU select records on (0 = all,
+    // 1 = the calling thread alone, the default). Each chunk of instances
+    // is culled and its batch records written by one of them, in the order
+    // the serial pass writes them; the upload and the draws stay on the
+    // render thread
+    void setSelectThreads(int threads) { select_threads = threads; }
+    const std::vector<ForestBatch>& getBatches() const { return batches; }
+    // Draw calls per pass: a batch each, or an archetype each on the GPU,
+    // and a proxy each
+    int getDrawCalls() const {
+        return (isGpuCulling() ? archetypes.size() : batches.size()) + visible_proxies.size();
+    }
+    // Instances drawn this frame. GPU culling reads its counts back, which
+    // waits for the GPU: for statistics, not every frame
+    int getDrawnInstances() const;
+    
+    // The batches' wood and leaves with a FOREST program in use; the caller
+    // sets the leaves' alpha test
+    void drawWood(GlStateCache& state) const;
+    void drawLeaves(GlStateCache& state) const;
+
+private:
+    struct Archetype {
+        std::unique_ptr<Tree> tree;
+        glm::vec3 center;  // Bounding sphere of the grown tree, in its space
+        float radius;
+        GLint branch_level_first[TreeLod::LEVELS]; // Each level's run of the index buffers
+        GLsizei branch_level_count[TreeLod::LEVELS];
+        GLint leaf_level_first[TreeLod::LEVELS];
+        GLsizei leaf_level_count[TreeLod::LEVELS];
+        std::vector<GLuint> branch_levels; // Every level's indices, level after level
+        std::vector<GLuint> leaf_levels;
+        std::vector<float> branch_vertices; // The tree's static meshes, in fetch order
+        std::vector<float> leaf_vertices;
+        std::vector<glm::vec3> grown_ends; // Each branch's end once grown, as the GPU growth puts it
+        GpuMesh branch_mesh;
+        GpuMesh leaf_mesh;
+        GLuint growth_buffer;
+        GLuint growth_texture;
+        
+        Archetype();
+    };
+    std::vector<std::unique_ptr<Archetype>> archetypes;
+    std::vector<ForestInstance> instances;
+    VertexCacheStats generated_cache;
+    VertexCacheStats optimized_cache;
+    TreeLod level_selector; // Only its level sizes
+    float lod_bias;
+    const DistanceFog* fog;
+    uint64_t archetype_hash;
+    
+    struct Proxy {
+        std::shared_ptr<const ForestProxy> source;
+        GpuMesh wood_mesh;
+        GpuMesh leaf_mesh;
+        GLsizei wood_indices;
+        GLsizei leaf_indices;
+        glm::vec3 low, high;
+        int residency_handle; // -1 = not registered
+    };
+    std::vector<std::unique_ptr<Proxy>> proxies; // Null where a handle is free
+    int proxy_count;
+    GpuResidency* residency;
+    void uploadProxy(Proxy& proxy);
+    void releaseProxy(Proxy& proxy);
+    std::vector<int> visible_proxies;           // This frame's, after culling
+    
+    std::vector<ForestInstance> visible; // This frame's records, grouped by batch
+    std::vector<ForestBatch> batches;
+    std::vector<int> chunk_counts;       // Scratch: instances per archetype and level in each chunk, then its cursors
+    std::vector<unsigned char> kept;     // Scratch: each instance's level, 0xff = culled
+    int select_threads;
+    GLuint instance_buffer;
+    size_t instance_buffer_size;
+    
+    // DrawElementsIndirectCommand
+    struct DrawCommand {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+    ShaderProgram* cull_program;
+    const DepthPyramid* occlusion_pyramid;
+    std::vector<DrawCommand> commands; // Wood then leaf commands, instance counts 0
+    GLuint instance_storage;           // Every instance, the cull program's input
+    int storage_instances;             // How many it holds
+    GLuint bounds_storage;             // Every archetype's bounding sphere
+    GLuint command_buffer;
+    
+    void uploadCulling();
+    void selectOnGpu(GlStateCache& state, const ViewFrustum* frustum, const glm::vec3& eye, float fov_y);
+    void buildLevels(Archetype& archetype);
+    void optimizeMeshes(Archetype& archetype);
+    void optimizeMesh(std::vector<float>& vertices, std::vector<GLuint>& levels, const GLint first[],
+                      const GLsizei count[]);
+    void createMesh(GpuMesh& mesh, const std::vector<float>& vertices, const std::vector<GLuint>& indices);
+    void createProxyMesh(GpuMesh& mesh, const std::vector<float>& vertices, const std::vector<GLuint>& indices);
+    void drawProxies(GlStateCache& state, bool leaves) const;
+    void drawMeshes(GlStateCache& state, bool leaves) const;
+    
+    ForestScene(const ForestScene&);
+    ForestScene& operator=(const ForestScene&);
+};
+
+#endif // FOREST_SCENE_H
@@ -0,0 +1,207 @@
+#include "frame_capture.h"
+#include "lodepng.h"
+#include "logging.h"
+#include "memory_stats.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+FrameCapture::FrameCapture(int ring_size, int encoder_threads)
+    : next_slot(0), record_frame(0), recording(false), unwritten(0) {
+    Readback empty = { 0, nullptr, 0, 0, 0, std::string() };
+    ring.assign(std::max(1, ring_size), empty);
+    if (encoder_threads <= 0) encoder_threads = std::max(1, JobSystem::shared().getThreads() - 1);
+    max_unwritten = 3 * encoder_threads;
+}
+
+FrameCapture::~FrameCapture() {
+    reap(true);
+    reportErrors();
+}
+
+void FrameCapture::screenshot(const std::string& path) {
+    screenshot_path = path;
+}
+
+void FrameCapture::startRecording(const std::string& prefix) {
+    if (prefix != record_prefix) {
+        record_prefix = prefix;
+        record_frame = 0;
+    }
+    recording = true;
+}
+
+bool FrameCapture::hasPendingFrames() const {
+    if (!screenshot_path.empty()) return true;
+    for (const Readback& slot : ring) {
+        if (slot.fence) return true;
+    }
+    return false;
+}
+
+void FrameCapture::encode(EncodeJob& job) {
+    // Speed over size, and RGB: the framebuffer's alpha is no part of the image
+    lodepng::State state;
+    lodepng_encoder_settings_fast(&state.encoder);
+    state.encoder.auto_convert = 0;
+    state.info_png.color.colortype = LCT_RGB;
+    
+    unsigned error;
+    {
+        PROFILE_SCOPE("FrameCapture::encode");
+        std::vector<unsigned char> png;
+        error = lodepng::encode(png, job.rgba, job.width, job.height, state);
+        ScratchMemory encoded(png.capacity());
+        if (!error) error = lodepng::save_file(png, job.path);
+    }
+    MemoryStats::removeScratch(job.rgba.size()); // Counted since its readback
+    std::vector<unsigned char>().swap(job.rgba);
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    unwritten--;
+    if (error) errors.push_back(job.path + ": " + lodepng_error_text(error));
+    drained.notify_all();
+}
+
+void FrameCapture::reap(bool wait) {
+    if (wait) {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [&]() { return unwritten == 0; });
+    }
+    // A job is done a moment after its frame is written
+    for (std::list<EncodeJob>::iterator it = jobs.begin(); it != jobs.end();) {
+        if (wait) JobSystem::shared().wait(it->work);
+        if (it->work.isDone()) {
+            it = jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void FrameCapture::endFrame(int width, int height) {
+    // Oldest first, so frames reach the encoders in order
+    for (size_t i = 0; i < ring.size(); i++) {
+        collect(ring[(next_slot + i) % ring.size()], false);
+    }
+    reportErrors();
+    
+    if (!screenshot_path.empty()) {
+        readFrame(width, height, screenshot_path);
+        screenshot_path.clear();
+    }
+    if (recording) {
+        char number[16];
+        snprintf(number, sizeof(number), "%06d.png", record_frame++);
+        readFrame(width, height, record_prefix + number);
+    }
+}
+
+void FrameCapture::readFrame(int width, int height, const std::string& path) {
+    if (width <= 0 || height <= 0) return;
+    
+    // The slot's previous readback is the oldest in flight, long finished
+    // unless the ring is shorter than the GPU runs behind
+    Readback& slot = ring[next_slot];
+    next_slot = (next_slot + 1) % ring.size();
+    collect(slot, true);
+    
+    size_t bytes = (size_t)width * height * 4;
+    if (slot.buffer == 0) glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (bytes > slot.capacity) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        slot.capacity = bytes;
+        MemoryStats::trackBuffer(slot.buffer, bytes, "frame capture");
+    }
+    // Rows of 4-byte texels meet the default pack alignment
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.path = path;
+}
+
+void FrameCapture::collect(Readback& slot, bool wait) {
+    if (!slot.fence) return;
+    GLenum status;
+    do {
+        status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+    } while (wait && status == GL_TIMEOUT_EXPIRED);
+    if (status == GL_TIMEOUT_EXPIRED) return;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    
+    std::vector<unsigned char> rgba;
+    size_t row = (size_t)slot.width * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const unsigned char* pixels = static_cast<const unsigned char*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, row * slot.height, GL_MAP_READ_BIT));
+    if (pixels && status != GL_WAIT_FAILED) {
+        // GL returns the bottom row first, PNG starts at the top
+        rgba.resize(row * slot.height);
+        for (int y = 0; y < slot.height; y++) {
+            memcpy(&rgba[y * row], pixels + (slot.height - 1 - y) * row, row);
+        }
+    }
+    if (pixels) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    if (rgba.empty()) {
+        LOG_ERROR(Capture) << "Cannot read back " << slot.path;
+        return;
+    }
+    MemoryStats::addScratch(rgba.size());
+    queue(rgba, slot.width, slot.height, slot.path);
+}
+
+void FrameCapture::queue(std::vector<unsigned char>& rgba, int width, int height, const std::string& path) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [&]() { return unwritten < max_unwritten; });
+        unwritten++;
+    }
+    reap(false);
+    jobs.emplace_back();
+    EncodeJob& job = jobs.back();
+    job.rgba.swap(rgba);
+    job.width = width;
+    job.height = height;
+    job.path = path;
+    // Encoding takes longer than a frame: the render thread never runs one
+    // while it waits on shorter jobs
+    job.work.setBackground(true);
+    job.work.setTask([this, &job]() { encode(job); });
+    JobSystem::shared().submit(job.work);
+}
+
+void FrameCapture::finish() {
+    for (size_t i = 0; i < ring.size(); i++) {
+        collect(ring[(next_slot + i) % ring.size()], true);
+    }
+    reap(true);
+    reportErrors();
+}
+
+void FrameCapture::release() {
+    finish();
+    for (Readback& slot : ring) {
+        MemoryStats::forgetBuffers(1, &slot.buffer);
+        glDeleteBuffers(1, &slot.buffer);
+        slot.buffer = 0;
+        slot.capacity = 0;
+    }
+}
+
+void FrameCapture::reportErrors() {
+    std::vector<std::string> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed.swap(errors);
+    }
+    for (const std::string& error : failed) {
+        LOG_ERROR(Capture) << "Cannot save frame " << error;
+    }
+}
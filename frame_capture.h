@@ -0,0 +1,105 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <GL/glew.h>
+#include "job_system.h"
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Saves rendered frames as PNGs without stalling the render loop on them.
+// endFrame() starts an asynchronous glReadPixels of the back buffer into
+// the next of a ring of GL_PIXEL_PACK_BUFFERs, fenced; a readback is only
+// mapped once its fence has signaled, usually a frame or two later, or
+// when its buffer comes round again. The pixels are copied out flipped to
+// top-down rows and encoded by background jobs of the job system
+// (job_system.h) with lodepng's fast settings (lodepng_encoder_settings_fast),
+// so the frame only pays for that copy.
+//
+// At most three frames per encoder thread are copied out and not yet
+// written; past that endFrame() blocks rather than dropping frames of a
+// recording or buffering without bound
+class FrameCapture {
+private:
+    struct Readback {
+        GLuint buffer;
+        GLsync fence;     // Null when the slot holds no readback
+        int width;
+        int height;
+        size_t capacity;  // Bytes allocated for buffer
+        std::string path;
+    };
+    
+    struct EncodeJob {
+        std::vector<unsigned char> rgba; // Top-down RGBA8 rows, freed once written
+        int width;
+        int height;
+        std::string path;
+        Job work; // Encodes and writes it
+    };
+    
+    std::vector<Readback> ring;
+    size_t next_slot;
+    
+    std::string screenshot_path; // Taken at the next endFrame, "" = none
+    std::string record_prefix;
+    int record_frame;            // Number of the next recorded frame
+    bool recording;
+    
+    size_t max_unwritten;
+    // Frames submitted, oldest first; only the render thread adds and
+    // erases them, each job touching just its own
+    std::list<EncodeJob> jobs;
+    std::mutex mutex;
+    std::condition_variable drained; // Render thread: a frame was written
+    size_t unwritten;                // Jobs whose frame isn't written yet
+    std::vector<std::string> errors; // Failed writes, reported by endFrame
+    
+    void encode(EncodeJob& job);
+    // Erase the jobs that are done; with wait, once every job is
+    void reap(bool wait);
+    // Start a readback of the frame into the next ring slot, to be saved to path
+    void readFrame(int width, int height, const std::string& path);
+    // Map a readback's buffer, queue its pixels and empty the slot; with
+    // wait false only if its fence has already signaled
+    void collect(Readback& slot, bool wait);
+    void queue(std::vector<unsigned char>& rgba, int width, int height, const std::string& path);
+    void reportErrors();
+    
+    FrameCapture(const FrameCapture&);
+    FrameCapture& operator=(const FrameCapture&);
+
+public:
+    // ring_size readbacks in flight at once, and up to three frames per
+    // encoder thread (0 = one per core but the render thread's) waiting
+    // to be written
+    explicit FrameCapture(int ring_size = 3, int encoder_threads = 0);
+    // Waits for the queued frames to be written; release() must have been
+    // called while the context was current
+    ~FrameCapture();
+    
+    // Save the next frame to path
+    void screenshot(const std::string& path);
+    // Save every frame from the next one on to prefix followed by its
+    // six-digit number and ".png", counting from 0, or on from the last
+    // recording to the same prefix
+    void startRecording(const std::string& prefix);
+    void stopRecording() { recording = false; }
+    bool isRecording() const { return recording; }
+    // Whether a screenshot is requested or a readback still waits to be
+    // collected by a later endFrame()
+    bool hasPendingFrames() const;
+    
+    // Call once per frame after drawing and before the swap, with the
+    // framebuffer size: reads this frame back if it is to be saved and
+    // hands finished readbacks to the encoder
+    void endFrame(int width, int height);
+    // Block until every frame read back so far is written
+    void finish();
+    // finish() and delete the pack buffers, with the context current
+    void release();
+};
+
+#endif // FRAME_CAPTURE_H
@@ -0,0 +1,47 @@
+#include "frame_limiter.h"
+#include <algorithm>
+
+FrameLimiter::FrameLimiter()
+    : focused_rate(0.0f), background_rate(0.0f), pause_minimized(false), focused(true), minimized(false),
+      next_frame(-1.0) {}
+
+void FrameLimiter::configure(float focused_cap, float background_cap, bool pause) {
+    focused_rate = std::max(0.0f, focused_cap);
+    background_rate = std::max(0.0f, background_cap);
+    pause_minimized = pause;
+    next_frame = -1.0;
+}
+
+// === WINDOW STATE ===
+
+void FrameLimiter::setFocused(bool state) {
+    focused = state;
+    next_frame = -1.0;
+}
+
+void FrameLimiter::setMinimized(bool state) {
+    minimized = state;
+    next_frame = -1.0;
+}
+
+// === PER FRAME ===
+
+float FrameLimiter::getRate() const {
+    return focused && !minimized ? focused_rate : background_rate;
+}
+
+double FrameLimiter::getWait(double now) const {
+    if (getRate() <= 0.0f || next_frame < 0.0) return 0.0;
+    return std::max(0.0, next_frame - now);
+}
+
+void FrameLimiter::frameStarted(double now) {
+    const float rate = getRate();
+    if (rate <= 0.0f) {
+        next_frame = -1.0;
+        return;
+    }
+    const double interval = 1.0 / rate;
+    // On the grid, unless this frame started a whole interval late
+    next_frame = next_frame >= 0.0 && now < next_frame + interval ? next_frame + interval : now + interval;
+}
@@ -0,0 +1,45 @@
+#ifndef FRAME_LIMITER_H
+#define FRAME_LIMITER_H
+
+// When the next frame may start, from whether the window has the focus
+// or is minimized: one cap while focused, a lower one in the background,
+// and none at all while minimized when paused there. The frames keep to a
+// grid of the interval from the first one, so a cap of 30 draws 30 a
+// second rather than 30 plus whatever each wait overshoots; a frame that
+// runs late starts the grid again instead of bunching the next ones up.
+// Times are seconds on any one clock (glfwGetTime())
+class FrameLimiter {
+public:
+    FrameLimiter();
+    
+    // Frames a second while focused and in the background (0 = no cap),
+    // and whether a minimized window draws nothing
+    void configure(float focused_rate, float background_rate, bool pause_minimized);
+    float getFocusedRate() const { return focused_rate; }
+    float getBackgroundRate() const { return background_rate; }
+    
+    // === WINDOW STATE ===
+    // From the focus and iconify callbacks; both start the grid again
+    void setFocused(bool focused);
+    void setMinimized(bool minimized);
+    bool isFocused() const { return focused; }
+    // Minimized with the pause on: draw nothing until restored
+    bool isPaused() const { return minimized && pause_minimized; }
+    
+    // === PER FRAME ===
+    // Seconds until the next frame may start, at now; 0 = start it now
+    double getWait(double now) const;
+    // A frame started at now
+    void frameStarted(double now);
+    float getRate() const; // The cap in force (0 = none)
+
+private:
+    float focused_rate;
+    float background_rate;
+    bool pause_minimized;
+    bool focused;
+    bool minimized;
+    double next_frame; // When the next frame is due; < 0 = none yet
+};
+
+#endif // FRAME_LIMITER_H
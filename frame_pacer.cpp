@@ -0,0 +1,57 @@
+#include "frame_pacer.h"
+#include "profiler.h"
+#include <algorithm>
+
+FramePacer::FramePacer() : frames(0), frame(0), wait_milliseconds(0.0f), stalls(0) {
+    for (int f = 0; f < MAX_FRAMES; f++) {
+        fences[f] = 0;
+    }
+}
+
+bool FramePacer::isSupported() {
+    return GLEW_VERSION_3_2 || GLEW_ARB_sync;
+}
+
+void FramePacer::create(int frames_in_flight) {
+    release();
+    frames = std::max(1, std::min(MAX_FRAMES, frames_in_flight));
+}
+
+void FramePacer::release() {
+    for (int f = 0; f < MAX_FRAMES; f++) {
+        if (fences[f]) glDeleteSync(fences[f]);
+        fences[f] = 0;
+    }
+    frames = 0;
+    frame = 0;
+    wait_milliseconds = 0.0f;
+}
+
+// === PER FRAME ===
+
+void FramePacer::wait() {
+    wait_milliseconds = 0.0f;
+    if (!isCreated()) return;
+    GLsync& fence = fences[frame % frames];
+    if (fence == 0) return;
+    PROFILE_SCOPE("FramePacer::wait");
+    const uint64_t begin = Profiler::now();
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        stalls++;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = 0;
+    wait_milliseconds = (Profiler::now() - begin) * 1e-6f;
+}
+
+void FramePacer::endFrame() {
+    if (!isCreated()) return;
+    GLsync& fence = fences[frame % frames];
+    if (fence) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame++;
+}
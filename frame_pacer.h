@@ -0,0 +1,48 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GL/glew.h>
+
+// Caps how many frames the CPU runs ahead of the GPU. A fence follows
+// each frame's swap, and wait() at the start of a frame blocks until the
+// frame frames_in_flight back has finished on the GPU. Input is then
+// sampled, and the simulation stepped, at most that many frames before
+// the frame on screen; without it only the driver's queue limits the lead.
+// The wait is a "FramePacer::wait" scope in the traces, next to the GPU's
+// passes (gpu_profiler.h). Needs GL 3.2 or ARB_sync
+class FramePacer {
+public:
+    static const int MAX_FRAMES = 3;
+    
+    FramePacer();
+    
+    static bool isSupported();
+    // frames_in_flight is clamped to 1 to MAX_FRAMES
+    void create(int frames_in_flight);
+    void release();
+    bool isCreated() const { return frames > 0; }
+    int getFramesInFlight() const { return frames; }
+    
+    // === PER FRAME ===
+    // Before the frame's input: wait for the GPU to finish the frame
+    // frames_in_flight back
+    void wait();
+    // After the swap: fence the frame
+    void endFrame();
+    
+    float getWaitMilliseconds() const { return wait_milliseconds; } // The last wait()
+    // Frames whose wait() had to block
+    int getStalls() const { return stalls; }
+
+private:
+    int frames;
+    long long frame;
+    GLsync fences[MAX_FRAMES];
+    float wait_milliseconds;
+    int stalls;
+    
+    FramePacer(const FramePacer&);
+    FramePacer& operator=(const FramePacer&);
+};
+
+#endif // FRAME_PACER_H
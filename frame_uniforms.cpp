@@ -0,0 +1,25 @@
+#include "frame_uniforms.h"
+#include "memory_stats.h"
+#include "render_stats.h"
+
+void FrameUniformBuffer::create() {
+    if (ubo == 0) glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    MemoryStats::trackBuffer(ubo, sizeof(FrameUniforms), "uniforms");
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+}
+
+void FrameUniformBuffer::release() {
+    MemoryStats::forgetBuffers(1, &ubo);
+    glDeleteBuffers(1, &ubo);
+    ubo = 0;
+}
+
+void FrameUniformBuffer::update(const FrameUniforms& frame) {
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    RenderStats::countUpload(sizeof(FrameUniforms));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,53 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// The FrameData uniform block of v_simplest.glsl in std140 layout: values
+// shared by every program and draw of a frame. The lights have their own
+// block (lights.h)
+struct FrameUniforms {
+    glm::mat4 P;          // Projection
+    glm::mat4 V;          // View
+    float time;           // Scene clock in seconds
+    float season;         // Time of year in [0, 1), 0 = early spring
+    float pad[2];
+    glm::vec4 wind;       // (direction x, direction z, strength, gust share of it); strength 0 = still
+    glm::vec4 wind_gusts; // (gust angular frequency, gust phase per unit downwind, leaf flutter angular frequency, -)
+    // Instanced stereo (--stereo): per eye, left then right, the projection
+    // from V's eye space, which sits between the eyes, and the eye's
+    // position in that space (xyz, -)
+    glm::mat4 eye_projection[2];
+    glm::vec4 eye_offset[2];
+    glm::vec4 camera;        // The camera's world position (xyz, -)
+    // Leaf thinning (--leaf-thinning): (every leaf drawn out to, thinned
+    // fully from, share of the leaves kept from there, -); share 1 = off
+    glm::vec4 leaf_thinning;
+    // Distance fog (--view-distance, DistanceFog in fog.h): (view
+    // distance, clear out to, density, height falloff) and (colour, base
+    // height); view distance 0 = off
+    glm::vec4 fog;
+    glm::vec4 fog_color;
+};
+
+static_assert(sizeof(FrameUniforms) == 400, "FrameUniforms must match the std140 FrameData block");
+
+// One uniform buffer holding FrameUniforms, bound once to BINDING; every
+// program that declares FrameData reads it after bindUniformBlock. update()
+// rewrites it in a single glBufferSubData per frame
+class FrameUniformBuffer {
+private:
+    GLuint ubo;
+
+public:
+    static const GLuint BINDING = 0;
+    static const char* blockName() { return "FrameData"; }
+    
+    FrameUniformBuffer() : ubo(0) {}
+    void create();
+    void release();
+    void update(const FrameUniforms& frame);
+};
+
+#endif // FRAME_UNIFORMS_H
@@ -0,0 +1,49 @@
+#include "frustum.h"
+
+ViewFrustum ViewFrustum::fromMatrix(const glm::mat4& clip) {
+    // A point is inside where -w <= x, y, z <= w in clip space: each plane
+    // is the last row of the matrix plus or minus one of the others
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++) {
+        rows[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+    }
+    ViewFrustum frustum;
+    for (int axis = 0; axis < 3; axis++) {
+        frustum.planes[axis * 2] = rows[3] + rows[axis];
+        frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+    }
+    return frustum;
+}
+
+bool ViewFrustum::addView(const ViewFrustum& other) {
+    if (view_count >= MAX_VIEWS) return false;
+    for (int p = 0; p < 6; p++) {
+        planes[view_count * 6 + p] = other.planes[p];
+    }
+    view_count++;
+    return true;
+}
+
+int ViewFrustum::classify(const glm::vec3& min, const glm::vec3& max) const {
+    if (min.x > max.x) return -1; // Empty: no element has geometry yet
+    int result = -1;
+    for (int view = 0; view < view_count; view++) {
+        int side = 1;
+        for (int p = view * 6; p < view * 6 + 6; p++) {
+            const glm::vec4& plane = planes[p];
+            // The corners farthest along and against the plane normal
+            glm::vec3 ahead(plane.x > 0.0f ? max.x : min.x, plane.y > 0.0f ? max.y : min.y,
+                            plane.z > 0.0f ? max.z : min.z);
+            glm::vec3 behind(plane.x > 0.0f ? min.x : max.x, plane.y > 0.0f ? min.y : max.y,
+                             plane.z > 0.0f ? min.z : max.z);
+            if (glm::dot(glm::vec3(plane), ahead) + plane.w < 0.0f) {
+                side = -1;
+                break;
+            }
+            if (glm::dot(glm::vec3(plane), behind) + plane.w < 0.0f) side = 0;
+        }
+        if (side == 1) return 1;
+        if (side == 0) result = 0;
+    }
+    return result;
+}
@@ -0,0 +1,27 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// The six clip planes of a projection * view (* model) matrix, normals
+// pointing inward, in the space that matrix maps from. addView() makes it
+// the union of up to MAX_VIEWS such frusta, so one culling pass keeps what
+// any of several views sees (ViewSet): a box is outside when it is outside
+// every view's planes
+struct ViewFrustum {
+    static const int MAX_VIEWS = 4;
+    
+    // Left, right, bottom, top, near, far of each view, the first view's first
+    glm::vec4 planes[6 * MAX_VIEWS];
+    int view_count;
+    
+    ViewFrustum() : view_count(1) {}
+    static ViewFrustum fromMatrix(const glm::mat4& clip);
+    // Hold the first view of other too; false when MAX_VIEWS are held
+    bool addView(const ViewFrustum& other);
+    // -1 = the box is entirely outside every view, 1 = entirely inside one,
+    // 0 = crosses a plane
+    int classify(const glm::vec3& min, const glm::vec3& max) const;
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,79 @@
+#version 330
+
+/*
+ * BRANCH LINE GEOMETRY SHADER (the BRANCH_LINES variants)
+ *
+ * Each branch arrives as one GL_LINES segment read from its BranchInstance
+ * record (tree_simple.h): the first end is (animated start, base radius),
+ * the second (animated end, growth progress). It leaves as the tapered tube
+ * addBranchSegment builds on the CPU: a ring at either end on the frame the
+ * instanced cylinder uses, the tip at 70% of the base radius, wrapped in one
+ * triangle strip. The rings have more sides the larger the branch is on
+ * screen (SIDES_PER_PIXEL of its radius), and the CPU mesh's 8 without a
+ * pixel scale (the shadow and impostor passes). The outputs are v_simplest.glsl's, for
+ * f_simplest.glsl
+ */
+
+const float SIDES_PER_PIXEL = 1.5;
+const int MIN_SIDES = 3;
+const int MAX_SIDES = 12;
+
+layout(lines) in;
+layout(triangle_strip, max_vertices = 26) out; // 2 * (MAX_SIDES + 1)
+
+uniform mat4 MV; // Model-view matrix (object space -> eye space)
+uniform mat4 MVP; // Model-view-projection matrix (object space -> clip space)
+uniform mat3 normalMatrix; // Inverse transpose of MV's upper 3x3 (object normals -> eye space)
+uniform float branchPixelScale; // Pixels a unit spans at unit eye distance, 0 = fixed detail
+
+in vec4 branchPoint[]; // v_simplest.glsl passes the record's halves on as they are
+
+//Bit-identical to the depth prepass, like the vertex shader's positions
+invariant gl_Position;
+
+out mediump vec3 n; // Normal vector in eye space (surface orientation), as v_simplest.glsl's
+out vec3 eyePosition; // Vertex position in eye space; the light and view vectors start here
+out vec2 iTexCoord0; // (around the ring, ring) like the unit cylinder's texcoords
+out float occlusion; // Always open: the records carry no bake
+
+// One ring vertex: radial is the unit offset from the axis at center
+void emitRingVertex(vec3 center, vec3 radial, float radius, vec2 texcoord) {
+    vec4 modelVertex = vec4(center + radial * radius, 1.0);
+    eyePosition = (MV * modelVertex).xyz;
+    n = normalize(normalMatrix * radial);
+    iTexCoord0 = texcoord;
+    occlusion = 1.0;
+    gl_Position = MVP * modelVertex;
+    EmitVertex();
+}
+
+void main(void) {
+    vec3 start = branchPoint[0].xyz;
+    vec3 end = branchPoint[1].xyz;
+    float radius = branchPoint[0].w;
+    vec3 axis = end - start;
+    // Not started yet, or not out of its parent: nothing to draw
+    if (branchPoint[1].w <= 0.0 || dot(axis, axis) < 1e-12) return;
+    
+    vec3 direction = normalize(axis);
+    vec3 up = (abs(direction.y) > 0.9) ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(direction, up));
+    up = normalize(cross(right, direction));
+    
+    int sides = 8;
+    if (branchPixelScale > 0.0) {
+        float eyeDistance = max(-(MV * vec4(0.5 * (start + end), 1.0)).z, 0.01);
+        float radiusPixels = radius * branchPixelScale / eyeDistance;
+        sides = clamp(int(ceil(SIDES_PER_PIXEL * radiusPixels)), MIN_SIDES, MAX_SIDES);
+    }
+    
+    // The last pair closes the strip on the first with u = 1
+    for (int i = 0; i <= sides; i++) {
+        float u = float(i) / float(sides);
+        float angle = 6.2831853 * float(i % sides) / float(sides);
+        vec3 radial = right * cos(angle) + up * sin(angle);
+        emitRingVertex(start, radial, radius, vec2(u, 0.0));
+        emitRingVertex(end, radial, radius * 0.7, vec2(u, 1.0)); // 70% radius at tip
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,196 @@
+#include "gl_dsa.h"
+#include "gl_state.h"
+
+bool GlDsa::enabled = false;
+GlStateCache* GlDsa::state_cache = nullptr;
+
+void GlDsa::init(bool allowed) {
+    enabled = allowed && (GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access);
+}
+
+void GlDsa::bindForEdit(GLenum target, GLuint texture) {
+    if (state_cache) {
+        state_cache->bindTexture(EDIT_UNIT, target, texture);
+    } else {
+        glActiveTexture(GL_TEXTURE0 + EDIT_UNIT);
+        glBindTexture(target, texture);
+    }
+}
+
+// === BUFFERS ===
+
+GLuint GlDsa::createBuffer() {
+    GLuint buffer;
+    if (enabled) {
+        glCreateBuffers(1, &buffer);
+    } else {
+        glGenBuffers(1, &buffer);
+    }
+    return buffer;
+}
+
+void GlDsa::bufferData(GLuint buffer, size_t bytes, const void* data, GLenum usage) {
+    if (enabled) {
+        glNamedBufferData(buffer, bytes, data, usage);
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, data, usage);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GlDsa::bufferSubData(GLuint buffer, size_t offset, size_t bytes, const void* data) {
+    if (enabled) {
+        glNamedBufferSubData(buffer, offset, bytes, data);
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// === TEXTURES ===
+
+GLuint GlDsa::createTexture(GLenum target) {
+    GLuint texture;
+    if (enabled) {
+        glCreateTextures(target, 1, &texture);
+    } else {
+        glGenTextures(1, &texture);
+    }
+    return texture;
+}
+
+void GlDsa::textureStorage3D(GLuint texture, GLenum target, int levels, GLenum internal_format,
+                             int width, int height, int depth) {
+    if (enabled) {
+        glTextureStorage3D(texture, levels, internal_format, width, height, depth);
+        return;
+    }
+    bindForEdit(target, texture);
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+        glTexStorage3D(target, levels, internal_format, width, height, depth);
+        return;
+    }
+    for (int level = 0; level < levels; level++) {
+        glTexImage3D(target, level, internal_format, width, height, depth, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+void GlDsa::textureSubImage3D(GLuint texture, GLenum target, int level, int width, int height, int depth,
+                              GLenum format, GLenum type, const void* pixels) {
+    if (enabled) {
+        glTextureSubImage3D(texture, level, 0, 0, 0, width, height, depth, format, type, pixels);
+        return;
+    }
+    bindForEdit(target, texture);
+    glTexSubImage3D(target, level, 0, 0, 0, width, height, depth, format, type, pixels);
+}
+
+void GlDsa::compressedTextureSubImage3D(GLuint texture, GLenum target, int level, int width, int height,
+                                        int depth, GLenum format, size_t bytes, const void* data) {
+    if (enabled) {
+        glCompressedTextureSubImage3D(texture, level, 0, 0, 0, width, height, depth, format, bytes, data);
+        return;
+    }
+    bindForEdit(target, texture);
+    glCompressedTexSubImage3D(target, level, 0, 0, 0, width, height, depth, format, bytes, data);
+}
+
+void GlDsa::textureParameteri(GLuint texture, GLenum target, GLenum name, GLint value) {
+    if (enabled) {
+        glTextureParameteri(texture, name, value);
+        return;
+    }
+    bindForEdit(target, texture);
+    glTexParameteri(target, name, value);
+}
+
+void GlDsa::textureParameterf(GLuint texture, GLenum target, GLenum name, GLfloat value) {
+    if (enabled) {
+        glTextureParameterf(texture, name, value);
+        return;
+    }
+    bindForEdit(target, texture);
+    glTexParameterf(target, name, value);
+}
+
+void GlDsa::generateMipmap(GLuint texture, GLenum target) {
+    if (enabled) {
+        glGenerateTextureMipmap(texture);
+        return;
+    }
+    bindForEdit(target, texture);
+    glGenerateMipmap(target);
+}
+
+// === VERTEX ARRAYS ===
+
+namespace {
+
+// Bytes of one attribute of size components of type, for a packed stride
+int attributeBytes(int size, GLenum type) {
+    switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return size;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return 2 * size;
+    case GL_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+        return 4;
+    case GL_DOUBLE:
+        return 8 * size;
+    default:
+        return 4 * size;
+    }
+}
+
+}
+
+GLuint GlDsa::createVertexArray() {
+    GLuint vao;
+    if (enabled) {
+        glCreateVertexArrays(1, &vao);
+    } else {
+        glGenVertexArrays(1, &vao);
+    }
+    return vao;
+}
+
+void GlDsa::vertexArrayElementBuffer(GLuint vao, GLuint buffer) {
+    if (enabled) {
+        glVertexArrayElementBuffer(vao, buffer);
+        return;
+    }
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    glBindVertexArray(0);
+}
+
+void GlDsa::vertexArrayAttribute(GLuint vao, GLuint buffer, int location, int size, GLenum type,
+                                 bool normalized, int stride, size_t offset, int divisor) {
+    if (enabled) {
+        // The binding's stride means what it says, where glVertexAttribPointer
+        // takes 0 for packed
+        if (stride == 0) stride = attributeBytes(size, type);
+        glVertexArrayVertexBuffer(vao, location, buffer, offset, stride);
+        glVertexArrayAttribFormat(vao, location, size, type, normalized, 0);
+        glVertexArrayAttribBinding(vao, location, location);
+        glVertexArrayBindingDivisor(vao, location, divisor);
+        glEnableVertexArrayAttrib(vao, location);
+        return;
+    }
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, size, type, normalized, stride, (void*)offset);
+    glVertexAttribDivisor(location, divisor);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,74 @@
+#ifndef GL_DSA_H
+#define GL_DSA_H
+
+#include <GL/glew.h>
+#include <cstddef>
+
+class GlStateCache;
+
+// Edits of buffers, textures and vertex arrays by name, through
+// ARB_direct_state_access (core in GL 4.5) where the context has it: no
+// bind to edit, so nothing a draw relies on changes underneath it and the
+// state cache stays right.
+//
+// Without it the same calls bind, but out of the way: buffers on
+// GL_COPY_WRITE_BUFFER, which nothing draws from, textures on EDIT_UNIT
+// through the state cache when one is set (so it knows), and vertex
+// arrays unbound again after. Objects edited here must be created here
+// too, as a DSA-only object exists from its creation rather than its
+// first bind. Render thread only
+class GlDsa {
+public:
+    // Above every sampler's unit, so a fallback edit never replaces a
+    // bound texture
+    static const int EDIT_UNIT = 16;
+    
+    // After glewInit(): direct state access where supported, unless not
+    // allowed (--no-dsa)
+    static void init(bool allowed);
+    static bool isEnabled() { return enabled; }
+    // The cache the fallback's texture binds go through (nullptr = none)
+    static void setStateCache(GlStateCache* cache) { state_cache = cache; }
+    
+    // === BUFFERS ===
+    static GLuint createBuffer();
+    // Replace the whole store
+    static void bufferData(GLuint buffer, size_t bytes, const void* data, GLenum usage);
+    static void bufferSubData(GLuint buffer, size_t offset, size_t bytes, const void* data);
+    
+    // === TEXTURES ===
+    // target is the texture's own, which the fallback binds it to
+    static GLuint createTexture(GLenum target);
+    // Immutable storage for levels mip levels of width x height x depth
+    // (layers); the fallback specifies each level empty where glTexStorage
+    // is missing too
+    static void textureStorage3D(GLuint texture, GLenum target, int levels, GLenum internal_format,
+                                 int width, int height, int depth);
+    // A whole level; pixels may be an offset into the bound
+    // GL_PIXEL_UNPACK_BUFFER
+    static void textureSubImage3D(GLuint texture, GLenum target, int level, int width, int height, int depth,
+                                  GLenum format, GLenum type, const void* pixels);
+    static void compressedTextureSubImage3D(GLuint texture, GLenum target, int level, int width, int height,
+                                            int depth, GLenum format, size_t bytes, const void* data);
+    static void textureParameteri(GLuint texture, GLenum target, GLenum name, GLint value);
+    static void textureParameterf(GLuint texture, GLenum target, GLenum name, GLfloat value);
+    static void generateMipmap(GLuint texture, GLenum target);
+    
+    // === VERTEX ARRAYS ===
+    static GLuint createVertexArray();
+    static void vertexArrayElementBuffer(GLuint vao, GLuint buffer);
+    // glVertexAttribPointer's attribute of location, read from buffer at
+    // offset, stride 0 for tightly packed; divisor 1 advances it once per
+    // instance. Each location is its own buffer binding
+    static void vertexArrayAttribute(GLuint vao, GLuint buffer, int location, int size, GLenum type,
+                                     bool normalized, int stride, size_t offset, int divisor);
+
+private:
+    static bool enabled;
+    static GlStateCache* state_cache;
+    
+    // Bind texture for a fallback edit
+    static void bindForEdit(GLenum target, GLuint texture);
+};
+
+#endif // GL_DSA_H
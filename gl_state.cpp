@@ -0,0 +1,71 @@
+#include "gl_state.h"
+#include "shaderprogram.h"
+
+GlStateCache::GlStateCache() : program(nullptr), active_unit(-1) {
+    frame.issued = frame.skipped = 0;
+    last_frame = frame;
+}
+
+void GlStateCache::useProgram(ShaderProgram* next) {
+    bool issued = next != program;
+    if (issued) {
+        next->use();
+        program = next;
+    }
+    count(issued);
+}
+
+void GlStateCache::bindTexture(int unit, GLenum target, GLuint texture) {
+    TextureBinding* binding = nullptr;
+    for (TextureBinding& known : textures) {
+        if (known.unit == unit && known.target == target) binding = &known;
+    }
+    if (binding != nullptr && binding->texture == texture) {
+        count(false);
+        return;
+    }
+    
+    if (unit != active_unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        active_unit = unit;
+        count(true);
+    }
+    glBindTexture(target, texture);
+    if (binding != nullptr) {
+        binding->texture = texture;
+    } else {
+        TextureBinding added = {unit, target, texture};
+        textures.push_back(added);
+    }
+    count(true);
+}
+
+void GlStateCache::invalidateTextures() {
+    active_unit = -1;
+    textures.clear();
+}
+
+void GlStateCache::uniform1i(const char* name, GLint value) {
+    count(program->uniform1i(name, value));
+}
+
+void GlStateCache::uniform1f(const char* name, GLfloat value) {
+    count(program->uniform1f(name, value));
+}
+
+void GlStateCache::uniform3fv(const char* name, const GLfloat* value) {
+    count(program->uniform3fv(name, value));
+}
+
+void GlStateCache::uniformMatrix3fv(const char* name, const GLfloat* value) {
+    count(program->uniformMatrix3fv(name, value));
+}
+
+void GlStateCache::uniformMatrix4fv(const char* name, const GLfloat* value) {
+    count(program->uniformMatrix4fv(name, value));
+}
+
+void GlStateCache::endFrame() {
+    last_frame = frame;
+    frame.issued = frame.skipped = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <GL/glew.h>
+#include <vector>
+
+class ShaderProgram;
+
+// Remembers the GL state set through it - program in use, texture bound per
+// unit and target, and (through ShaderProgram) each uniform's last value -
+// and drops calls that would set what is already there. Counts the calls
+// issued and skipped per frame. State changed behind its back (an upload
+// binding a texture) must be followed by invalidateTextures()
+class GlStateCache {
+public:
+    struct Counters {
+        int issued;
+        int skipped;
+    };
+
+private:
+    struct TextureBinding {
+        int unit;
+        GLenum target;
+        GLuint texture;
+    };
+    ShaderProgram* program;             // nullptr = unknown
+    int active_unit;                    // -1 = unknown
+    std::vector<TextureBinding> textures; // Known bindings only
+    Counters frame;
+    Counters last_frame;
+    
+    void count(bool issued) { (issued ? frame.issued : frame.skipped)++; }
+
+public:
+    GlStateCache();
+    
+    void useProgram(ShaderProgram* next);
+    ShaderProgram* getProgram() const { return program; }
+    void bindTexture(int unit, GLenum target, GLuint texture);
+    void invalidateTextures();
+    // After a program's GL object changed under it (a shader reload)
+    void invalidateProgram() { program = nullptr; }
+    
+    // Uniforms of the program in use
+    void uniform1i(const char* name, GLint value);
+    void uniform1f(const char* name, GLfloat value);
+    void uniform3fv(const char* name, const GLfloat* value);
+    void uniformMatrix3fv(const char* name, const GLfloat* value);
+    void uniformMatrix4fv(const char* name, const GLfloat* value);
+    
+    // Close the frame's counters; getLastFrame reports them until the next one
+    void endFrame();
+    const Counters& getLastFrame() const { return last_frame; }
+};
+
+#endif // GL_STATE_H
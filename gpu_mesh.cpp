@@ -0,0 +1,149 @@
+#include "gpu_mesh.h"
+#include "gl_dsa.h"
+#include "memory_stats.h"
+#include "render_stats.h"
+
+int GpuMesh::view_count = 1;
+
+GpuMesh::GpuMesh() : vao(0), vbo(0), ebo(0), instance_vbo(0), owner("meshes"), divisor_views(1) {}
+
+void GpuMesh::create(bool indexed, bool instanced, const char* mesh_owner) {
+    owner = mesh_owner;
+    if (vao == 0) vao = GlDsa::createVertexArray();
+    if (vbo == 0) vbo = GlDsa::createBuffer();
+    if (indexed && ebo == 0) {
+        ebo = GlDsa::createBuffer();
+        // Attach the element buffer once; it stays with the VAO
+        GlDsa::vertexArrayElementBuffer(vao, ebo);
+    }
+    if (instanced && instance_vbo == 0) instance_vbo = GlDsa::createBuffer();
+}
+
+void GpuMesh::release() {
+    const GLuint buffers[3] = { vbo, ebo, instance_vbo };
+    MemoryStats::forgetBuffers(3, buffers);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    glDeleteBuffers(1, &instance_vbo);
+    vao = vbo = ebo = instance_vbo = 0;
+    instanced.clear();
+    divisor_views = 1;
+}
+
+void GpuMesh::attribute(GLuint buffer, int location, int size, GLenum type, bool normalized,
+                        int stride, size_t offset, int divisor) {
+    if (location < 0) return;
+    GlDsa::vertexArrayAttribute(vao, buffer, location, size, type, normalized, stride, offset,
+                                divisor * divisor_views);
+    for (size_t i = 0; i < instanced.size(); i++) {
+        if (instanced[i].location != location) continue;
+        instanced[i] = instanced.back();
+        instanced.pop_back();
+        break;
+    }
+    if (divisor > 0) {
+        InstancedAttribute attribute = { location, divisor };
+        instanced.push_back(attribute);
+    }
+}
+
+void GpuMesh::applyViews(int views) const {
+    if (divisor_views == views) return;
+    // The VAO is bound; in the direct state access layout each location
+    // is its own binding, which this sets too
+    for (const InstancedAttribute& attribute : instanced) {
+        glVertexAttribDivisor(attribute.location, attribute.divisor * views);
+    }
+    divisor_views = views;
+}
+
+void GpuMesh::uploadVertices(const void* data, size_t bytes, GLenum usage) {
+    GlDsa::bufferData(vbo, bytes, data, usage);
+    MemoryStats::trackBuffer(vbo, bytes, owner);
+    if (data) RenderStats::countUpload(bytes);
+}
+
+void GpuMesh::uploadIndices(const std::vector<GLuint>& indices, GLenum usage) {
+    GlDsa::bufferData(ebo, indices.size() * sizeof(GLuint), indices.data(), usage);
+    MemoryStats::trackBuffer(ebo, indices.size() * sizeof(GLuint), owner);
+    RenderStats::countUpload(indices.size() * sizeof(GLuint));
+}
+
+void GpuMesh::draw(int count, int first) const {
+    if (count <= 0) return;
+    if (view_count > 1) {
+        drawInstanced(count, 1, first);
+        return;
+    }
+    applyViews(1);
+    RenderStats::countDraw(count, count / 3);
+    if (ebo != 0) {
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(first * sizeof(GLuint)));
+    } else {
+        glDrawArrays(GL_TRIANGLES, first, count);
+    }
+}
+
+void GpuMesh::drawInstanced(int count, int instances, int first) const {
+    if (count <= 0 || instances <= 0) return;
+    applyViews(view_count);
+    instances *= view_count;
+    RenderStats::countDraw((uint64_t)count * instances, (uint64_t)(count / 3) * instances);
+    if (ebo != 0) {
+        glDrawElementsInstanced(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(first * sizeof(GLuint)), instances);
+    } else {
+        glDrawArraysInstanced(GL_TRIANGLES, first, count, instances);
+    }
+}
+
+void GpuMesh::drawLines(int count, int first) const {
+    if (count <= 0) return;
+    applyViews(1);
+    RenderStats::countDraw(count, 0);
+    glDrawArrays(GL_LINES, first, count);
+}
+
+void GpuMesh::drawPatches(int count, int first) const {
+    if (count <= 0) return;
+    applyViews(1);
+    RenderStats::countDraw(count, 0);
+    glDrawArrays(GL_PATCHES, first, count);
+}
+
+void GpuMesh::drawRanges(const GLint* first, const GLsizei* count, int ranges) const {
+    if (ranges <= 0) return;
+    if (view_count > 1) {
+        // No instanced multi-draw without indirect commands
+        for (int i = 0; i < ranges; i++) {
+            drawInstanced(count[i], 1, first[i]);
+        }
+        return;
+    }
+    applyViews(1);
+    uint64_t vertices = 0;
+    for (int i = 0; i < ranges; i++) {
+        vertices += count[i];
+    }
+    RenderStats::countDraw(vertices, vertices / 3);
+    if (ebo != 0) {
+        range_offsets.resize(ranges);
+        for (int i = 0; i < ranges; i++) {
+            range_offsets[i] = (const void*)(first[i] * sizeof(GLuint));
+        }
+        glMultiDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, range_offsets.data(), ranges);
+    } else {
+        glMultiDrawArrays(GL_TRIANGLES, first, count, ranges);
+    }
+}
+
+void GpuMesh::drawIndirect(size_t offset, int commands) const {
+    if (commands <= 0) return;
+    applyViews(1);
+    RenderStats::countDraw(0, 0);
+    if (ebo != 0) {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)offset, commands, 0);
+    } else {
+        glMultiDrawArraysIndirect(GL_TRIANGLES, (const void*)offset, commands, 0);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef GPU_MESH_H
+#define GPU_MESH_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// A vertex array object with the buffers it draws from: vertices, optional
+// indices and optional per-instance records. The attribute layout is
+// recorded once, after create(); later uploads replace buffer contents under
+// the same names, so a draw binds the VAO and nothing else. Created and
+// edited through GlDsa, by name where direct state access allows, so
+// neither leaves a buffer or VAO bound
+class GpuMesh {
+public:
+    GLuint vao;
+    GLuint vbo;
+    GLuint ebo;          // 0 = drawn with glDrawArrays
+    GLuint instance_vbo; // 0 = not instanced
+    const char* owner;   // Its buffers' owner in the memory report (memory_stats.h)
+    
+    GpuMesh();
+    
+    // Generate the VAO and its buffers; a mesh already created keeps its names
+    void create(bool indexed, bool instanced = false, const char* mesh_owner = "meshes");
+    void release();
+    bool isCreated() const { return vao != 0; }
+    
+    // Record one attribute of the layout, read from buffer (vbo or
+    // instance_vbo, or another created by GlDsa) at offset. Inactive locations (-1) are skipped;
+    // divisor 1 advances the attribute once per instance
+    void attribute(GLuint buffer, int location, int size, GLenum type, bool normalized,
+                   int stride, size_t offset, int divisor = 0);
+    
+    // Replace the whole vertex or index store
+    void uploadVertices(const void* data, size_t bytes, GLenum usage);
+    void uploadIndices(const std::vector<GLuint>& indices, GLenum usage = GL_STATIC_DRAW);
+    
+    void bind() const { glBindVertexArray(vao); }
+    static void unbind() { glBindVertexArray(0); }
+    
+    // Triangles from the bound mesh: count indices from index first when it
+    // is indexed, count vertices from vertex first otherwise
+    void draw(int count, int first = 0) const;
+    void drawInstanced(int count, int instances, int first = 0) const;
+    // Line segments from the bound mesh's vertices, two each, for a
+    // geometry shader to expand
+    void drawLines(int count, int first = 0) const;
+    // Patches of GL_PATCH_VERTICES vertices each, for tessellation shaders
+    void drawPatches(int count, int first = 0) const;
+    // draw() of several ranges in one call: count[i] indices or vertices
+    // from first[i], for each of ranges
+    void drawRanges(const GLint* first, const GLsizei* count, int ranges) const;
+    // Draws commands (DrawElementsIndirectCommand or DrawArraysIndirectCommand)
+    // read from the bound GL_DRAW_INDIRECT_BUFFER at offset; GL 4.3
+    void drawIndirect(size_t offset, int commands) const;
+    
+    // === VIEWS ===
+    // Every triangle draw from here on covers views views (1, the default,
+    // or 2 for both eyes of instanced stereo): each instance is drawn views
+    // times and the per-instance attributes advance once per views
+    // instances, so the vertex shader's view is gl_InstanceID % views and
+    // its instance gl_InstanceID / views. A mesh's divisors follow at its
+    // next draw. drawLines, drawPatches and drawIndirect draw one view
+    static void setViewCount(int views) { view_count = views; }
+    static int getViewCount() { return view_count; }
+    
+private:
+    struct InstancedAttribute {
+        int location;
+        int divisor; // As recorded, for one view
+    };
+    std::vector<InstancedAttribute> instanced;
+    mutable int divisor_views; // The view count its divisors are set for
+    mutable std::vector<const void*> range_offsets; // drawRanges' index byte offsets
+    static int view_count;
+    
+    // Set the bound VAO's divisors for views
+    void applyViews(int views) const;
+};
+
+#endif // GPU_MESH_H
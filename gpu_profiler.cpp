@@ -0,0 +1,142 @@
+#include "gpu_profiler.h"
+#include "profiler.h"
+
+GpuProfiler::GpuProfiler() : frame(0), open_count(0), skipped(0), frames_begun(0), timings_frame(-1),
+                             track(nullptr), dropped_frames(0) {
+    for (int f = 0; f < FRAMES; f++) {
+        for (int q = 0; q < 2 * MAX_PASSES; q++) {
+            queries[f][q] = 0;
+        }
+        sets[f].count = 0;
+        sets[f].frame = 0;
+        sets[f].clock_offset = 0;
+        sets[f].pending = false;
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    release();
+}
+
+bool GpuProfiler::isSupported() {
+    return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+}
+
+void GpuProfiler::create() {
+    if (isCreated() || !isSupported()) return;
+    glGenQueries(FRAMES * 2 * MAX_PASSES, &queries[0][0]);
+    // One track however often the queries are made again
+    if (!track) track = Profiler::createTrack("GPU");
+}
+
+void GpuProfiler::release() {
+    if (!isCreated()) return;
+    glDeleteQueries(FRAMES * 2 * MAX_PASSES, &queries[0][0]);
+    for (int f = 0; f < FRAMES; f++) {
+        for (int q = 0; q < 2 * MAX_PASSES; q++) {
+            queries[f][q] = 0;
+        }
+        sets[f].count = 0;
+        sets[f].pending = false;
+    }
+    open_count = 0;
+    skipped = 0;
+    timings.clear();
+    timings_frame = -1;
+}
+
+// === PER FRAME ===
+
+void GpuProfiler::beginFrame() {
+    if (!isCreated()) return;
+    // The set after the last one written is the oldest
+    frame = (frame + 1) % FRAMES;
+    FrameSet& set = sets[frame];
+    if (set.pending) readBack(frame);
+    set.count = 0;
+    set.frame = frames_begun++;
+    set.pending = false;
+    open_count = 0;
+    skipped = 0;
+    
+    // The GL's current time, not that of the commands queued before it
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    set.clock_offset = (int64_t)Profiler::now() - gpu_now;
+}
+
+void GpuProfiler::begin(const char* name) {
+    if (!isCreated()) return;
+    FrameSet& set = sets[frame];
+    if (set.count == MAX_PASSES) {
+        skipped++;
+        return;
+    }
+    int k = set.count++;
+    set.passes[k].name = name;
+    set.passes[k].depth = open_count;
+    set.passes[k].ended = false;
+    glQueryCounter(queries[frame][2 * k], GL_TIMESTAMP);
+    open[open_count++] = k;
+}
+
+void GpuProfiler::end() {
+    if (!isCreated()) return;
+    // Once the set is full every begin is skipped, so the innermost open
+    // passes are the skipped ones
+    if (skipped > 0) {
+        skipped--;
+        return;
+    }
+    if (open_count == 0) return;
+    int k = open[--open_count];
+    glQueryCounter(queries[frame][2 * k + 1], GL_TIMESTAMP);
+    sets[frame].passes[k].ended = true;
+}
+
+void GpuProfiler::endFrame() {
+    if (!isCreated()) return;
+    while (open_count > 0) {
+        end();
+    }
+    skipped = 0;
+    sets[frame].pending = sets[frame].count > 0;
+}
+
+void GpuProfiler::readBack(int s) {
+    const FrameSet& set = sets[s];
+    // Asking for a result that isn't there would wait for it
+    for (int k = 0; k < set.count; k++) {
+        if (!set.passes[k].ended) continue;
+        for (int q = 0; q < 2; q++) {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[s][2 * k + q], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                dropped_frames++;
+                return;
+            }
+        }
+    }
+    
+    timings.clear();
+    timings_frame = set.frame;
+    const bool tracing = Profiler::isEnabled();
+    for (int k = 0; k < set.count; k++) {
+        const Pass& pass = set.passes[k];
+        if (!pass.ended) continue;
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(queries[s][2 * k], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[s][2 * k + 1], GL_QUERY_RESULT, &end);
+        if (end < begin) end = begin;
+        Timing timing;
+        timing.name = pass.name;
+        timing.depth = pass.depth;
+        timing.milliseconds = (end - begin) * 1e-6f;
+        timings.push_back(timing);
+        
+        int64_t trace_begin = (int64_t)begin + set.clock_offset;
+        if (tracing && trace_begin >= 0) {
+            Profiler::record(track, pass.name, trace_begin, trace_begin + (end - begin));
+        }
+    }
+}
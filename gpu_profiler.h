@@ -0,0 +1,110 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+
+struct ProfileTrack;
+
+// GPU time of the render passes from GL_TIMESTAMP queries (GL 3.3 or
+// ARB_timer_query), merged into the CPU profiler's traces (profiler.h) on
+// a "GPU" track of their own. A timed pass is bracketed by two timestamp
+// queries, so passes nest freely, unlike GL_TIME_ELAPSED ones. Each frame
+// writes the next of FRAMES query sets and reads back the set written
+// FRAMES frames before, by when the GPU is long done: a set whose results
+// still aren't there is dropped rather than waited for, so timing never
+// stalls the pipeline.
+//
+// GPU times become profiler times through a GL_TIMESTAMP read taken next
+// to Profiler::now() at each beginFrame().
+//
+//   gpuProfiler.beginFrame();
+//   { GpuProfileScope pass(gpuProfiler, "shadow maps"); ... }
+//   gpuProfiler.endFrame();
+//
+// Names are kept as pointers, as the CPU profiler's are
+class GpuProfiler {
+public:
+    static const int FRAMES = 4;         // Query sets in flight
+    static const int MAX_PASSES = 64;    // Timed per frame; more go untimed
+    
+    // A pass of the last frame read back, in milliseconds
+    struct Timing {
+        const char* name;
+        int depth; // Nesting level, 0 = outermost
+        float milliseconds;
+    };
+    
+    GpuProfiler();
+    ~GpuProfiler();
+    
+    static bool isSupported();
+    // Make the queries; without support the profiler stays off and every
+    // call is a no-op
+    void create();
+    void release();
+    bool isCreated() const { return queries[0][0] != 0; }
+    
+    // === PER FRAME ===
+    // Read back the set FRAMES frames old into the trace and getTimings(),
+    // then start writing it again
+    void beginFrame();
+    void begin(const char* name);
+    void end();
+    void endFrame();
+    
+    const std::vector<Timing>& getTimings() const { return timings; }
+    // Which frame getTimings() belongs to, counting beginFrame() calls
+    // from 0; -1 before the first read back
+    long long getTimingsFrame() const { return timings_frame; }
+    long long getFrame() const { return frames_begun; } // beginFrame() calls so far
+    // Sets whose results weren't ready in time and were dropped
+    int getDroppedFrames() const { return dropped_frames; }
+
+private:
+    struct Pass {
+        const char* name;
+        int depth;
+        bool ended;
+    };
+    struct FrameSet {
+        Pass passes[MAX_PASSES];
+        int count;
+        long long frame;      // Its frame's number
+        int64_t clock_offset; // Profiler time minus GPU time at its beginFrame()
+        bool pending;         // Written and not read back yet
+    };
+    
+    GLuint queries[FRAMES][2 * MAX_PASSES]; // Begin and end timestamp of each pass
+    FrameSet sets[FRAMES];
+    int frame;                // The set being written
+    int open[MAX_PASSES];     // The passes begun and not ended, innermost last
+    int open_count;
+    int skipped;              // Begins past MAX_PASSES, whose ends are ignored too
+    std::vector<Timing> timings;
+    long long frames_begun;
+    long long timings_frame;
+    ProfileTrack* track;
+    int dropped_frames;
+    
+    void readBack(int set);
+    
+    GpuProfiler(const GpuProfiler&);
+    GpuProfiler& operator=(const GpuProfiler&);
+};
+
+// Times its own lifetime on the GPU as one pass
+class GpuProfileScope {
+public:
+    GpuProfileScope(GpuProfiler& gpu_profiler, const char* name) : profiler(gpu_profiler) { profiler.begin(name); }
+    ~GpuProfileScope() { profiler.end(); }
+
+private:
+    GpuProfiler& profiler;
+    
+    GpuProfileScope(const GpuProfileScope&);
+    GpuProfileScope& operator=(const GpuProfileScope&);
+};
+
+#endif // GPU_PROFILER_H
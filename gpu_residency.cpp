@@ -0,0 +1,118 @@
+#include "gpu_residency.h"
+#include "memory_stats.h"
+#include <GL/glew.h>
+
+// All but the first of ATI_meminfo's four values are about the largest
+// free block and the auxiliary memory
+static const int ATI_MEMINFO_VALUES = 4;
+
+GpuResidency::GpuResidency() : budget(0), frame(1), evictions(0), restores(0) {}
+
+// === BUDGET ===
+
+bool GpuResidency::queryDeviceMemory(size_t& total, size_t& available) {
+    total = available = 0;
+    // Both report in KB
+    if (glewIsSupported("GL_NVX_gpu_memory_info")) {
+        GLint dedicated = 0, free_memory = 0;
+        glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicated);
+        glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &free_memory);
+        total = (size_t)dedicated * 1024;
+        available = (size_t)free_memory * 1024;
+        return true;
+    }
+    if (glewIsSupported("GL_ATI_meminfo")) {
+        GLint info[ATI_MEMINFO_VALUES] = { 0, 0, 0, 0 };
+        glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, info);
+        available = (size_t)info[0] * 1024;
+        return true;
+    }
+    return false;
+}
+
+bool GpuResidency::setBudgetFromDevice(float share) {
+    size_t total, available;
+    if (!queryDeviceMemory(total, available)) return false;
+    // Without a total, what is free now plus what this process holds
+    if (total == 0) total = available + getUsedBytes();
+    budget = (size_t)(total * share);
+    return true;
+}
+
+size_t GpuResidency::getUsedBytes() {
+    return MemoryStats::getUsage(MemoryStats::TEXTURES).bytes + MemoryStats::getUsage(MemoryStats::GL_BUFFERS).bytes;
+}
+
+// === RESOURCES ===
+
+int GpuResidency::add(const char* owner, size_t bytes, const Evictor& evict) {
+    size_t handle = 0;
+    while (handle < resources.size() && resources[handle].owner) {
+        handle++;
+    }
+    if (handle == resources.size()) resources.emplace_back();
+    Resource& resource = resources[handle];
+    resource.owner = owner;
+    resource.bytes = bytes;
+    resource.evict = evict;
+    resource.last_drawn = frame;
+    resource.resident = true;
+    return handle;
+}
+
+void GpuResidency::remove(int handle) {
+    if (handle < 0 || handle >= (int)resources.size()) return;
+    resources[handle].owner = nullptr;
+    resources[handle].evict = Evictor();
+    resources[handle].resident = false;
+}
+
+bool GpuResidency::touch(int handle) {
+    Resource& resource = resources[handle];
+    if (!resource.resident) return false;
+    resource.last_drawn = frame;
+    return true;
+}
+
+void GpuResidency::makeResident(int handle) {
+    Resource& resource = resources[handle];
+    if (resource.resident) return;
+    while (budget > 0 && getUsedBytes() + resource.bytes > budget) {
+        if (!evictOne()) break;
+    }
+    resource.resident = true;
+    resource.last_drawn = frame;
+    restores++;
+}
+
+bool GpuResidency::evictOne() {
+    Resource* oldest = nullptr;
+    for (Resource& resource : resources) {
+        if (resource.owner && resource.resident && resource.last_drawn < frame &&
+            (!oldest || resource.last_drawn < oldest->last_drawn)) {
+            oldest = &resource;
+        }
+    }
+    if (!oldest) return false;
+    oldest->resident = false;
+    oldest->evict();
+    evictions++;
+    return true;
+}
+
+// === PER FRAME ===
+
+void GpuResidency::endFrame() {
+    while (budget > 0 && getUsedBytes() > budget) {
+        if (!evictOne()) break;
+    }
+    frame++;
+}
+
+size_t GpuResidency::getEvictableBytes() const {
+    size_t bytes = 0;
+    for (const Resource& resource : resources) {
+        if (resource.owner && resource.resident) bytes += resource.bytes;
+    }
+    return bytes;
+}
@@ -0,0 +1,86 @@
+#ifndef GPU_RESIDENCY_H
+#define GPU_RESIDENCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Keeps the GL memory in use under a budget by evicting what can be made
+// again. Every GL buffer and texture is already counted by MemoryStats;
+// resources registered here (world chunk proxies, the impostor atlas) can
+// also be dropped, each by its evictor, and are remembered by the frame
+// they were last drawn in. While the counted total is over the budget
+// they go least recently drawn first, never one drawn in the current
+// frame, so the scene degrades from what is out of sight rather than
+// thrashing or running the driver out of memory.
+//
+// An evicted resource stays registered. Its owner finds out from touch()
+// when it is next needed, calls makeResident(), which evicts others to
+// make room for it, and uploads it again: the budget is soft for what is
+// drawn this frame. Render thread only
+class GpuResidency {
+public:
+    typedef std::function<void()> Evictor;
+    
+    GpuResidency();
+    
+    // Bytes of GL memory to stay under (0 = no budget: nothing is evicted)
+    void setBudget(size_t bytes) { budget = bytes; }
+    size_t getBudget() const { return budget; }
+    // share of the device's memory: GL_NVX_gpu_memory_info's dedicated
+    // video memory, or ATI_meminfo's free texture memory with what
+    // MemoryStats counts already in use. False (the budget unchanged) with
+    // neither extension
+    bool setBudgetFromDevice(float share);
+    // The driver's view in bytes, 0 where it doesn't tell: total dedicated
+    // memory (NVX only) and what is currently free
+    static bool queryDeviceMemory(size_t& total, size_t& available);
+    
+    // === RESOURCES ===
+    // Register a resident resource of bytes under owner (kept as a
+    // pointer); evict must release its GL objects, and nothing else here
+    int add(const char* owner, size_t bytes, const Evictor& evict);
+    void remove(int handle);
+    // Mark it drawn this frame; false when it is evicted
+    bool touch(int handle);
+    // Count an evicted resource resident again, drawn this frame, after
+    // evicting others to fit it while they can be; the caller uploads it
+    void makeResident(int handle);
+    bool isResident(int handle) const { return resources[handle].resident; }
+    
+    // === PER FRAME ===
+    // Evict while over the budget, then start the next frame
+    void endFrame();
+    
+    // === STATISTICS ===
+    // GL textures and buffers as MemoryStats counts them
+    static size_t getUsedBytes();
+    size_t getEvictableBytes() const; // Of the resident registered resources
+    uint64_t getEvictions() const { return evictions; }
+    uint64_t getRestores() const { return restores; }
+
+private:
+    struct Resource {
+        const char* owner; // nullptr = a free handle
+        size_t bytes;
+        Evictor evict;
+        uint64_t last_drawn;
+        bool resident;
+    };
+    
+    std::vector<Resource> resources;
+    size_t budget;
+    uint64_t frame;
+    uint64_t evictions;
+    uint64_t restores;
+    
+    // Evict the least recently drawn resident resource not drawn this
+    // frame; false when there is none
+    bool evictOne();
+    
+    GpuResidency(const GpuResidency&);
+    GpuResidency& operator=(const GpuResidency&);
+};
+
+#endif // GPU_RESIDENCY_H
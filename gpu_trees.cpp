@@ -0,0 +1,276 @@
+#include "gpu_trees.h"
+#include "gl_dsa.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include "shaderprogram.h"
+#include <algorithm>
+
+// c_tree_generate.glsl's passes
+static const int PASS_SEED = 0;
+static const int PASS_EXPAND = 1;
+static const int PASS_ADVANCE = 2;
+
+// Words of the shader's Counters block
+static const int BRANCH_COUNT_WORD = 0;
+static const int LEAF_COUNT_WORD = 1;
+static const int RANGE_END_WORD = 3;
+static const int DISPATCH_WORD = 4;
+static const int DROPPED_WORD = 7;
+static const int WOOD_COMMAND_WORD = 8;  // DrawElementsIndirectCommand, 5 words
+static const int LEAF_COMMAND_WORD = 13; // DrawArraysIndirectCommand, 4 words
+static const int COUNTER_WORDS = 17;
+
+static const int WORK_BYTES = 32;        // The shader's Work record
+// Tree::emitBranch's mean branching: 2-4 children, 6-14 leaves from the
+// secondary branches on; the buffers hold SLACK times the mean tree
+static const double MEAN_CHILDREN = 3.0;
+static const double MEAN_LEAVES = 10.0;
+static const double SLACK = 1.5;
+static const int LEAF_QUAD_VERTICES = 6;
+
+GpuTreeGenerator::GpuTreeGenerator()
+    : tree_count(0), branch_capacity(0), leaf_capacity(0), generated(false), tree_buffer(0), work_buffer(0),
+      branch_buffer(0), leaf_buffer(0), counter_buffer(0), timer_query(0), counters_read(false), generation_ms(0.0) {}
+
+GpuTreeGenerator::~GpuTreeGenerator() {
+    release();
+}
+
+bool GpuTreeGenerator::isSupported() {
+    return GLEW_VERSION_4_3;
+}
+
+// === TREES ===
+
+void GpuTreeGenerator::addTree(const glm::vec3& position, float scale, float yaw, uint32_t seed,
+                               const TreeParameters& parameters) {
+    GpuTreeInput tree;
+    tree.position = position;
+    tree.scale = scale;
+    tree.yaw = yaw;
+    tree.angle_variance = parameters.branch_angle_variance;
+    tree.length_reduction = parameters.length_reduction_factor;
+    tree.radius_reduction = parameters.radius_reduction_factor;
+    tree.seed = seed;
+    tree.max_generations = std::max(parameters.max_generations, 0);
+    tree.unused[0] = tree.unused[1] = 0;
+    trees.push_back(tree);
+}
+
+// === GENERATION ===
+
+// The unit cylinder and leaf quad createBranchCylinderMesh and
+// createLeafQuadMesh build, instanced from the generated records
+void GpuTreeGenerator::createMeshes() {
+    const int ringVertices = Tree::BRANCH_RING_VERTICES;
+    const glm::vec2* circle = Tree::ringUnitCircle(ringVertices - 1);
+    std::vector<float> cylinder;
+    for (int ring = 0; ring < 2; ring++) {
+        for (int i = 0; i < ringVertices; i++) {
+            float u = (float)i / (ringVertices - 1);
+            cylinder.insert(cylinder.end(), {circle[i].x, circle[i].y, (float)ring, 1.0f, u, (float)ring});
+        }
+    }
+    // The triangles of a branch slot: quad i joins vertices i, i+1 of both rings
+    std::vector<GLuint> indices;
+    for (int i = 0; i < ringVertices - 1; i++) {
+        GLuint p1 = i, p2 = i + 1, p3 = ringVertices + i, p4 = ringVertices + i + 1;
+        indices.insert(indices.end(), {p1, p2, p3, p2, p4, p3});
+    }
+    const int cylinderStride = 6 * sizeof(GLfloat);
+    const int branchStride = sizeof(BranchInstance);
+    branch_mesh.create(true, false, "gpu trees");
+    branch_mesh.uploadVertices(cylinder.data(), cylinder.size() * sizeof(float), GL_STATIC_DRAW);
+    branch_mesh.uploadIndices(indices);
+    branch_mesh.attribute(branch_mesh.vbo, VERTEX_LOCATION, 4, GL_FLOAT, false, cylinderStride, 0);
+    branch_mesh.attribute(branch_mesh.vbo, TEXCOORD_LOCATION, 2, GL_FLOAT, false, cylinderStride,
+                          4 * sizeof(GLfloat));
+    branch_mesh.attribute(branch_buffer, BRANCH_START_LOCATION, 4, GL_FLOAT, false, branchStride, 0, 1);
+    branch_mesh.attribute(branch_buffer, BRANCH_END_LOCATION, 4, GL_FLOAT, false, branchStride,
+                          4 * sizeof(GLfloat), 1);
+    
+    static const float quad[] = {
+        -0.5f, -0.5f, 0.0f, 1.0f,  0.0f, 0.0f,
+         0.5f,  0.5f, 0.0f, 1.0f,  1.0f, 1.0f,
+         0.5f, -0.5f, 0.0f, 1.0f,  1.0f, 0.0f,
+        -0.5f, -0.5f, 0.0f, 1.0f,  0.0f, 0.0f,
+        -0.5f,  0.5f, 0.0f, 1.0f,  0.0f, 1.0f,
+         0.5f,  0.5f, 0.0f, 1.0f,  1.0f, 1.0f,
+    };
+    const int quadStride = 6 * sizeof(GLfloat);
+    const int leafStride = sizeof(LeafInstance);
+    leaf_mesh.create(false, false, "gpu trees");
+    leaf_mesh.uploadVertices(quad, sizeof(quad), GL_STATIC_DRAW);
+    leaf_mesh.attribute(leaf_mesh.vbo, VERTEX_LOCATION, 4, GL_FLOAT, false, quadStride, 0);
+    leaf_mesh.attribute(leaf_mesh.vbo, TEXCOORD_LOCATION, 2, GL_FLOAT, false, quadStride, 4 * sizeof(GLfloat));
+    leaf_mesh.attribute(leaf_buffer, LEAF_POSITION_LOCATION, 3, GL_FLOAT, false, leafStride, 0, 1);
+    leaf_mesh.attribute(leaf_buffer, LEAF_NORMAL_LOCATION, 4, GL_INT_2_10_10_10_REV, true, leafStride,
+                        3 * sizeof(GLfloat), 1);
+    leaf_mesh.attribute(leaf_buffer, LEAF_SCALE_LOCATION, 2, GL_FLOAT, false, leafStride, 4 * sizeof(GLfloat), 1);
+}
+
+// Every generation is one indirect EXPAND dispatch over the last one's
+// branches and a one-invocation ADVANCE moving the range on, as many
+// rounds as the deepest tree has generations
+void GpuTreeGenerator::generate(GlStateCache& state, ShaderProgram* program) {
+    generated = false;
+    counters_read = false;
+    tree_count = trees.size();
+    if (tree_count == 0 || program == nullptr) return;
+    
+    // Room for the mean tree of each input, with slack
+    double branches = 0.0, leaves = 0.0;
+    int generations = 0;
+    for (const GpuTreeInput& tree : trees) {
+        double level = 1.0;
+        for (int g = 0; g <= tree.max_generations; g++) {
+            branches += level;
+            if (g >= 2) leaves += level * MEAN_LEAVES;
+            level *= MEAN_CHILDREN;
+        }
+        generations = std::max(generations, tree.max_generations);
+    }
+    branch_capacity = std::max((int)(branches * SLACK), tree_count);
+    leaf_capacity = std::max((int)(leaves * SLACK), 1);
+    
+    if (tree_buffer == 0) {
+        glGenBuffers(1, &tree_buffer);
+        glGenBuffers(1, &work_buffer);
+        // The instance buffers of the meshes' attributes, so GlDsa's
+        branch_buffer = GlDsa::createBuffer();
+        leaf_buffer = GlDsa::createBuffer();
+        glGenBuffers(1, &counter_buffer);
+        glGenQueries(1, &timer_query);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tree_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, trees.size() * sizeof(GpuTreeInput), trees.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, work_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)branch_capacity * WORK_BYTES, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, branch_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)branch_capacity * sizeof(BranchInstance), nullptr, GL_STATIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, leaf_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)leaf_capacity * sizeof(LeafInstance), nullptr, GL_STATIC_COPY);
+    MemoryStats::trackBuffer(tree_buffer, trees.size() * sizeof(GpuTreeInput), "gpu trees");
+    MemoryStats::trackBuffer(work_buffer, (size_t)branch_capacity * WORK_BYTES, "gpu trees");
+    MemoryStats::trackBuffer(branch_buffer, (size_t)branch_capacity * sizeof(BranchInstance), "gpu trees");
+    MemoryStats::trackBuffer(leaf_buffer, (size_t)leaf_capacity * sizeof(LeafInstance), "gpu trees");
+    
+    // The trunks are the first range; the commands draw nothing until
+    // the first ADVANCE
+    std::vector<GLuint> start(COUNTER_WORDS, 0);
+    start[BRANCH_COUNT_WORD] = tree_count;
+    start[RANGE_END_WORD] = tree_count;
+    start[DISPATCH_WORD] = (tree_count + 63) / 64;
+    start[DISPATCH_WORD + 1] = start[DISPATCH_WORD + 2] = 1;
+    start[WOOD_COMMAND_WORD] = Tree::BRANCH_SLOT_INDICES;
+    start[LEAF_COMMAND_WORD] = LEAF_QUAD_VERTICES;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counter_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, start.size() * sizeof(GLuint), start.data(), GL_DYNAMIC_COPY);
+    MemoryStats::trackBuffer(counter_buffer, start.size() * sizeof(GLuint), "gpu trees");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    if (!branch_mesh.isCreated()) createMeshes();
+    
+    glBeginQuery(GL_TIME_ELAPSED, timer_query);
+    state.useProgram(program);
+    state.uniform1i("treeCount", tree_count);
+    state.uniform1i("branchCapacity", branch_capacity);
+    state.uniform1i("leafCapacity", leaf_capacity);
+    state.uniform1i("cylinderIndices", Tree::BRANCH_SLOT_INDICES);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, tree_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, work_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, branch_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, leaf_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, counter_buffer);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counter_buffer);
+    
+    state.uniform1i("pass", PASS_SEED);
+    glDispatchCompute((tree_count + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    for (int g = 0; g <= generations; g++) {
+        state.uniform1i("pass", PASS_EXPAND);
+        glDispatchComputeIndirect(DISPATCH_WORD * sizeof(GLuint));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        state.uniform1i("pass", PASS_ADVANCE);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    glEndQuery(GL_TIME_ELAPSED);
+    generated = true;
+}
+
+void GpuTreeGenerator::release() {
+    branch_mesh.release();
+    leaf_mesh.release();
+    if (tree_buffer) {
+        GLuint buffers[5] = { tree_buffer, work_buffer, branch_buffer, leaf_buffer, counter_buffer };
+        MemoryStats::forgetBuffers(5, buffers);
+        glDeleteBuffers(5, buffers);
+        glDeleteQueries(1, &timer_query);
+    }
+    tree_buffer = work_buffer = branch_buffer = leaf_buffer = counter_buffer = timer_query = 0;
+    generated = false;
+    counters_read = false;
+}
+
+// === DRAWING ===
+
+void GpuTreeGenerator::drawWood(GlStateCache& state) const {
+    if (!generated) return;
+    state.uniform1i("growthMode", 4);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, counter_buffer);
+    branch_mesh.bind();
+    branch_mesh.drawIndirect(WOOD_COMMAND_WORD * sizeof(GLuint), 1);
+    GpuMesh::unbind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    state.uniform1i("growthMode", 0);
+}
+
+void GpuTreeGenerator::drawLeaves(GlStateCache& state) const {
+    if (!generated) return;
+    state.uniform1i("growthMode", 3);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, counter_buffer);
+    leaf_mesh.bind();
+    leaf_mesh.drawIndirect(LEAF_COMMAND_WORD * sizeof(GLuint), 1);
+    GpuMesh::unbind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    state.uniform1i("growthMode", 0);
+}
+
+// === STATISTICS ===
+
+void GpuTreeGenerator::readCounters() const {
+    if (counters_read) return;
+    counters.assign(COUNTER_WORDS, 0);
+    generation_ms = 0.0;
+    if (generated) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, counter_buffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, COUNTER_WORDS * sizeof(GLuint), counters.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(timer_query, GL_QUERY_RESULT, &nanoseconds);
+        generation_ms = nanoseconds * 1e-6;
+    }
+    counters_read = true;
+}
+
+int GpuTreeGenerator::getBranchCount() const {
+    readCounters();
+    return counters[WOOD_COMMAND_WORD + 1];
+}
+
+int GpuTreeGenerator::getLeafCount() const {
+    readCounters();
+    return counters[LEAF_COMMAND_WORD + 1];
+}
+
+int GpuTreeGenerator::getDropped() const {
+    readCounters();
+    return counters[DROPPED_WORD];
+}
+
+double GpuTreeGenerator::getGenerationMs() const {
+    readCounters();
+    return generation_ms;
+}
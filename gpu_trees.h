@@ -0,0 +1,109 @@
+#ifndef GPU_TREES_H
+#define GPU_TREES_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "gpu_mesh.h"
+#include "tree_simple.h"
+
+class GlStateCache;
+class ShaderProgram;
+
+// One tree for the GPU to generate: c_tree_generate.glsl's TreeInput
+struct GpuTreeInput {
+    glm::vec3 position; // Base of the trunk
+    float scale;
+    float yaw;              // Rotation about +y, radians
+    float angle_variance;   // TreeParameters' branch shape
+    float length_reduction;
+    float radius_reduction;
+    uint32_t seed;
+    int max_generations;
+    int unused[2];
+};
+
+static_assert(sizeof(GpuTreeInput) == 48, "GpuTreeInput must match the shader's std430 layout");
+
+// Many grown trees made on the GPU from nothing but a seed and parameters
+// each: c_tree_generate.glsl runs the branching rules of Tree::emitBranch
+// one generation per pass for all of them together, appending the
+// branches and leaves as BranchInstance and LeafInstance records straight
+// into the buffers the unit cylinder and leaf quad are instanced from, and
+// writing the indirect draw commands that draw them. Nothing is built or
+// uploaded on the CPU but the inputs and two unit meshes, and nothing is
+// read back; the trees are drawn with the instanced branch and leaf modes of
+// v_simplest.glsl (growthMode 4 and 3) in world space.
+//
+// The buffers hold the trees' expected sizes with some slack, so a run of
+// bushy trees can fill them; what does not fit is dropped and counted. A
+// tree's shape depends only on its input, the order of the records on how
+// the GPU schedules the passes. Needs OpenGL 4.3
+class GpuTreeGenerator {
+public:
+    static const int VERTEX_LOCATION = 0; // v_simplest.glsl's inputs
+    static const int TEXCOORD_LOCATION = 2;
+    static const int LEAF_POSITION_LOCATION = 5;
+    static const int LEAF_NORMAL_LOCATION = 6;
+    static const int LEAF_SCALE_LOCATION = 7;
+    static const int BRANCH_START_LOCATION = 8;
+    static const int BRANCH_END_LOCATION = 9;
+    
+    GpuTreeGenerator();
+    ~GpuTreeGenerator();
+    
+    static bool isSupported();
+    
+    // === TREES ===
+    void addTree(const glm::vec3& position, float scale, float yaw, uint32_t seed, const TreeParameters& parameters);
+    int getTreeCount() const { return trees.size(); }
+    void clearTrees() { trees.clear(); }
+    
+    // === GENERATION ===
+    // Size the buffers for the trees added and generate them all with
+    // program (c_tree_generate.glsl); replaces what an earlier call made
+    void generate(GlStateCache& state, ShaderProgram* program);
+    bool isGenerated() const { return generated; }
+    void release();
+    
+    // === DRAWING ===
+    // One indirect draw each, with the bark and leaf materials applied
+    void drawWood(GlStateCache& state) const;
+    void drawLeaves(GlStateCache& state) const;
+    // The LeafInstance records, getLeafCount() of them, for LeafParticles
+    GLuint getLeafBuffer() const { return leaf_buffer; }
+    
+    // === STATISTICS ===
+    // Read back once from the last generate(); they wait for it to finish
+    int getBranchCount() const;
+    int getLeafCount() const;
+    int getDropped() const;
+    double getGenerationMs() const;
+
+private:
+    std::vector<GpuTreeInput> trees;
+    int tree_count;       // Generated
+    int branch_capacity;
+    int leaf_capacity;
+    bool generated;
+    GLuint tree_buffer;
+    GLuint work_buffer;
+    GLuint branch_buffer; // BranchInstance records, the cylinder's instances
+    GLuint leaf_buffer;   // LeafInstance records, the quad's instances
+    GLuint counter_buffer; // Counters, with the dispatch and draw commands
+    GLuint timer_query;
+    GpuMesh branch_mesh;
+    GpuMesh leaf_mesh;
+    mutable bool counters_read;
+    mutable std::vector<GLuint> counters;
+    mutable double generation_ms;
+    
+    void createMeshes();
+    void readCounters() const;
+    
+    GpuTreeGenerator(const GpuTreeGenerator&);
+    GpuTreeGenerator& operator=(const GpuTreeGenerator&);
+};
+
+#endif // GPU_TREES_H
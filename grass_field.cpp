@@ -0,0 +1,179 @@
+#include "grass_field.h"
+#include "frustum.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include "render_stats.h"
+#include "shaderprogram.h"
+#include "terrain.h"
+#include <algorithm>
+#include <cmath>
+
+static const int BLADE_SEGMENTS = 3;
+static const int HEIGHT_SAMPLES = 8; // Per chunk side, for its height bounds
+
+GrassField::GrassField()
+    : radius(0.0f), chunk_size(1.0f), blades_per_chunk(0), blade_width(0.04f), blade_height(0.3f),
+      full_density_distance(6.0f), eye(0.0f), blade_index_count(0), chunk_buffer(0), chunk_texture(0) {
+    std::fill(band_first, band_first + BANDS, 0);
+    std::fill(band_count, band_count + BANDS, 0);
+}
+
+GrassField::~GrassField() {
+    release();
+}
+
+// === BLADES ===
+
+void GrassField::generate(const Terrain& terrain, float new_radius, float new_chunk_size, int new_blades_per_chunk) {
+    radius = std::max(new_radius, 0.0f);
+    chunk_size = std::max(new_chunk_size, 0.1f);
+    blades_per_chunk = std::max(new_blades_per_chunk, 0);
+    chunks.clear();
+    selected.clear();
+    int per_side = (int)std::ceil(radius / chunk_size);
+    for (int z = -per_side; z < per_side; z++) {
+        for (int x = -per_side; x < per_side; x++) {
+            Chunk chunk;
+            chunk.corner = glm::vec2(x, z) * chunk_size;
+            // Only chunks reaching into the disc
+            glm::vec2 nearest = glm::clamp(glm::vec2(0.0f), chunk.corner, chunk.corner + chunk_size);
+            if (glm::length(nearest) >= radius) continue;
+            chunk.min_height = 1e30f;
+            chunk.max_height = -1e30f;
+            for (int j = 0; j <= HEIGHT_SAMPLES; j++) {
+                for (int i = 0; i <= HEIGHT_SAMPLES; i++) {
+                    glm::vec2 p = chunk.corner + glm::vec2(i, j) * (chunk_size / HEIGHT_SAMPLES);
+                    float height = terrain.heightAt(p.x, p.y);
+                    chunk.min_height = std::min(chunk.min_height, height);
+                    chunk.max_height = std::max(chunk.max_height, height);
+                }
+            }
+            chunks.push_back(chunk);
+        }
+    }
+}
+
+void GrassField::setBladeSize(float width, float height) {
+    blade_width = width;
+    blade_height = height;
+}
+
+float GrassField::densityAt(float distance) const {
+    if (radius <= full_density_distance) return distance < radius ? 1.0f : 0.0f;
+    return glm::clamp((radius - distance) / (radius - full_density_distance), 0.0f, 1.0f);
+}
+
+// === GPU ===
+
+void GrassField::upload() {
+    // One blade: BLADE_SEGMENTS rows of two vertices, x in [-0.5, 0.5] and
+    // y in [0, 1), and the tip
+    std::vector<float> blade;
+    std::vector<GLuint> indices;
+    for (int row = 0; row < BLADE_SEGMENTS; row++) {
+        float y = (float)row / BLADE_SEGMENTS;
+        blade.push_back(-0.5f);
+        blade.push_back(y);
+        blade.push_back(0.5f);
+        blade.push_back(y);
+        GLuint a = row * 2;
+        if (row + 1 < BLADE_SEGMENTS) {
+            GLuint quad[] = { a, a + 1, a + 2, a + 1, a + 3, a + 2 };
+            indices.insert(indices.end(), quad, quad + 6);
+        } else {
+            GLuint tip[] = { a, a + 1, a + 2 };
+            indices.insert(indices.end(), tip, tip + 3);
+        }
+    }
+    blade.push_back(0.0f);
+    blade.push_back(1.0f);
+    mesh.create(true, false, "grass");
+    mesh.uploadVertices(blade.data(), blade.size() * sizeof(float), GL_STATIC_DRAW);
+    mesh.uploadIndices(indices);
+    mesh.attribute(mesh.vbo, 0, 2, GL_FLOAT, false, 2 * sizeof(GLfloat), 0); // vertex
+    blade_index_count = indices.size();
+    
+    if (chunk_buffer == 0) glGenBuffers(1, &chunk_buffer);
+    if (chunk_texture == 0) glGenTextures(1, &chunk_texture);
+    glBindBuffer(GL_TEXTURE_BUFFER, chunk_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(chunks.size(), 1) * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    MemoryStats::trackBuffer(chunk_buffer, std::max<size_t>(chunks.size(), 1) * sizeof(glm::vec4), "grass");
+    glBindTexture(GL_TEXTURE_BUFFER, chunk_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, chunk_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void GrassField::release() {
+    mesh.release();
+    if (chunk_texture) glDeleteTextures(1, &chunk_texture);
+    MemoryStats::forgetBuffers(1, &chunk_buffer);
+    if (chunk_buffer) glDeleteBuffers(1, &chunk_buffer);
+    chunk_texture = chunk_buffer = 0;
+    blade_index_count = 0;
+}
+
+// === PER FRAME ===
+
+// A chunk's density is the one at its nearest point, the most any of its
+// blades gets; band b takes densities down to 2^-(b + 1), the last band
+// everything below
+void GrassField::select(const ViewFrustum* frustum, const glm::vec3& new_eye) {
+    eye = new_eye;
+    selected.clear();
+    std::vector<glm::vec4> bands[BANDS];
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const Chunk& chunk = chunks[i];
+        glm::vec3 min(chunk.corner.x, chunk.min_height, chunk.corner.y);
+        glm::vec3 max(chunk.corner.x + chunk_size, chunk.max_height + blade_height * 1.2f, chunk.corner.y + chunk_size);
+        float density = densityAt(glm::length(glm::clamp(eye, min, max) - eye));
+        if (density <= 0.0f) continue;
+        if (frustum && frustum->classify(min, max) < 0) continue;
+        int band = 0;
+        while (band < BANDS - 1 && density <= 1.0f / (2 << band)) {
+            band++;
+        }
+        bands[band].push_back(glm::vec4(chunk.corner, density, (float)i));
+    }
+    for (int band = 0; band < BANDS; band++) {
+        band_first[band] = selected.size();
+        band_count[band] = bands[band].size();
+        selected.insert(selected.end(), bands[band].begin(), bands[band].end());
+    }
+    
+    if (chunk_buffer == 0 || selected.empty()) return;
+    glBindBuffer(GL_TEXTURE_BUFFER, chunk_buffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, selected.size() * sizeof(glm::vec4), selected.data());
+    RenderStats::countUpload(selected.size() * sizeof(glm::vec4));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+int GrassField::getIssuedBlades() const {
+    int blades = 0;
+    for (int band = 0; band < BANDS; band++) {
+        blades += band_count[band] * std::max(blades_per_chunk >> band, 1);
+    }
+    return blades;
+}
+
+void GrassField::draw(GlStateCache& state, const Terrain& terrain) const {
+    if (!mesh.isCreated() || selected.empty() || blades_per_chunk == 0) return;
+    terrain.bindHeights(state);
+    state.bindTexture(CHUNK_UNIT, GL_TEXTURE_BUFFER, chunk_texture);
+    state.uniform1i("grassChunks", CHUNK_UNIT);
+    state.uniform1f("grassChunkSize", chunk_size);
+    state.uniform1i("grassBlades", blades_per_chunk);
+    state.uniform3fv("grassEye", &eye[0]);
+    ShaderProgram* program = state.getProgram();
+    glUniform2f(program->u("grassDensity"), full_density_distance, radius);
+    glUniform2f(program->u("grassBladeSize"), blade_width, blade_height);
+    mesh.bind();
+    for (int band = 0; band < BANDS; band++) {
+        if (band_count[band] == 0) continue;
+        int band_blades = std::max(blades_per_chunk >> band, 1);
+        state.uniform1i("grassFirstChunk", band_first[band]);
+        state.uniform1i("grassBandBlades", band_blades);
+        mesh.drawInstanced(blade_index_count, band_count[band] * band_blades, 0);
+    }
+    GpuMesh::unbind();
+}
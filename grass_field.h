@@ -0,0 +1,90 @@
+#ifndef GRASS_FIELD_H
+#define GRASS_FIELD_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "gpu_mesh.h"
+
+class GlStateCache;
+class Terrain;
+struct ViewFrustum;
+
+// Grass blades over a Terrain, in square chunks around the origin. A
+// blade has no record of its own: the GRASS variant of v_simplest.glsl
+// derives its place in the chunk, height, turn and wind phase from a hash
+// of its chunk and index, stands it on the terrain's height map and sways
+// it on the scene clock, so the field costs a few floats per chunk.
+//
+// Density falls off with distance: blade i of a chunk of n has rank
+// (i + 0.5) / n and is drawn only where the density at its distance
+// exceeds that rank, shrinking away just before it. select() culls the
+// chunks against the frustum and sorts the rest into BANDS by their
+// nearest density, band b drawing the first n >> b blades of each of its
+// chunks; every band is one instanced draw, the shader collapsing the
+// blades its chunk's density leaves out. upload() binds the chunk
+// texture buffer directly, behind a GlStateCache's back
+// (GlStateCache::invalidateTextures)
+class GrassField {
+public:
+    static const int BANDS = 4;
+    static const int CHUNK_UNIT = 14; // The grassChunks sampler's unit
+    
+    GrassField();
+    ~GrassField();
+    
+    // === BLADES ===
+    // Chunks of chunk_size over the disc of radius around the origin, each
+    // with blades_per_chunk blades at full density, bounded by terrain's
+    // heights
+    void generate(const Terrain& terrain, float radius, float chunk_size, int blades_per_chunk);
+    // Blade width at the base and mean height
+    void setBladeSize(float width, float height);
+    // Full density out to near, none from the radius on
+    void setFalloff(float near) { full_density_distance = near; }
+    int getChunkCount() const { return chunks.size(); }
+    
+    // === GPU ===
+    void upload();
+    void release();
+    
+    // === PER FRAME ===
+    // Choose and band the chunks seen from eye, culled against the frustum
+    // (nullptr = keep all), and upload them
+    void select(const ViewFrustum* frustum, const glm::vec3& eye);
+    int getDrawnChunks() const { return selected.size(); }
+    // Blades issued by the draws, before the shader's density test
+    int getIssuedBlades() const;
+    // The blades with a GRASS program in use, on terrain's height map
+    void draw(GlStateCache& state, const Terrain& terrain) const;
+
+private:
+    struct Chunk {
+        glm::vec2 corner; // Smallest x and z
+        float min_height;
+        float max_height;
+    };
+    std::vector<Chunk> chunks;
+    float radius;
+    float chunk_size;
+    int blades_per_chunk;
+    float blade_width;
+    float blade_height;
+    float full_density_distance;
+    
+    glm::vec3 eye;
+    std::vector<glm::vec4> selected; // This frame's (corner x, corner z, density, chunk), by band
+    int band_first[BANDS];
+    int band_count[BANDS];
+    GpuMesh mesh;                    // One blade
+    int blade_index_count;
+    GLuint chunk_buffer;
+    GLuint chunk_texture;
+    
+    float densityAt(float distance) const;
+    
+    GrassField(const GrassField&);
+    GrassField& operator=(const GrassField&);
+};
+
+#endif // GRASS_FIELD_H
@@ -0,0 +1,233 @@
+#include "job_system.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+const int JobSystem::MAX_THREADS;
+const int JobSystem::QUEUE_JOBS;
+
+// The pool a thread works for and its deque there; null and -1 on threads
+// that aren't workers
+static thread_local JobSystem* current_system = nullptr;
+static thread_local int current_queue = -1;
+
+// A ring of job pointers: the owner pushes and pops at the back, thieves
+// take from the front. A lock per deque, held for a few stores
+struct JobSystem::Queue {
+    std::mutex mutex;
+    Job* jobs[QUEUE_JOBS];
+    size_t front; // Oldest job
+    size_t back;  // One past the newest; back - front jobs in all
+    
+    Queue() : front(0), back(0) {}
+};
+
+JobSystem::JobSystem(int threads)
+    : queue_count(std::max(1, std::min(threads, MAX_THREADS))), queued(0), sleepers(0), stopping(false) {
+    queues.reset(new Queue[queue_count]);
+    for (int w = 1; w < queue_count; w++) {
+        workers.emplace_back(&JobSystem::workerLoop, this, w);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping.store(true);
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+JobSystem& JobSystem::shared() {
+    // Never destroyed, so threads still running at exit find it
+    static JobSystem* instance = new JobSystem(std::max(2, (int)std::thread::hardware_concurrency()));
+    return *instance;
+}
+
+// === QUEUES ===
+
+void JobSystem::push(Job* job) {
+    Queue& queue = queues[current_system == this ? current_queue : 0];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.back - queue.front < (size_t)QUEUE_JOBS) {
+            queue.jobs[queue.back++ % QUEUE_JOBS] = job;
+            job = nullptr;
+        }
+    }
+    if (job) {
+        execute(job);
+        return;
+    }
+    queued.fetch_add(1);
+    // A worker counts itself a sleeper before it checks queued, so either
+    // it sees this job or it is told of it
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wake.notify_one();
+    }
+}
+
+Job* JobSystem::take(int own, bool background) {
+    Job* job = nullptr;
+    {
+        Queue& queue = queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.back != queue.front) {
+            Job* newest = queue.jobs[(queue.back - 1) % QUEUE_JOBS];
+            if (background || !newest->background) {
+                job = newest;
+                queue.back--;
+            }
+        }
+    }
+    for (int k = 1; k < queue_count && !job; k++) {
+        Queue& queue = queues[(own + k) % queue_count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.back == queue.front) continue;
+        Job* oldest = queue.jobs[queue.front % QUEUE_JOBS];
+        if (background || !oldest->background) {
+            job = oldest;
+            queue.front++;
+        }
+    }
+    if (job) queued.fetch_sub(1);
+    return job;
+}
+
+bool JobSystem::runOne() {
+    const bool worker = current_system == this;
+    Job* job = take(worker ? current_queue : 0, worker);
+    if (!job) return false;
+    execute(job);
+    return true;
+}
+
+void JobSystem::workerLoop(int index) {
+    current_system = this;
+    current_queue = index;
+    Profiler::setThreadName("jobs " + std::to_string(index));
+    for (;;) {
+        if (runOne()) continue;
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleepers.fetch_add(1);
+        wake.wait(lock, [&]() { return stopping.load() || queued.load() > 0; });
+        sleepers.fetch_sub(1);
+        if (stopping.load() && queued.load() == 0) return;
+    }
+}
+
+// === JOBS ===
+
+void JobSystem::submit(Job& job, Job* parent) {
+    job.parent = parent;
+    job.unfinished.store(1, std::memory_order_relaxed);
+    job.done.store(false, std::memory_order_relaxed);
+    if (parent) parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    unblock(&job);
+}
+
+void JobSystem::addContinuation(Job& before, Job& after) {
+    after.dependencies.fetch_add(1, std::memory_order_relaxed);
+    before.continuations.push_back(&after);
+}
+
+void JobSystem::unblock(Job* job) {
+    if (job->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) push(job);
+}
+
+void JobSystem::execute(Job* job) {
+    if (job->task) job->task();
+    release(job);
+}
+
+void JobSystem::release(Job* job) {
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) finish(job);
+}
+
+void JobSystem::finish(Job* job) {
+    // Once done the job may be destroyed or submitted again, so everything
+    // it points to is read first
+    Job* parent = job->parent;
+    std::vector<Job*> next;
+    next.swap(job->continuations);
+    job->dependencies.store(1, std::memory_order_relaxed);
+    job->done.store(true, std::memory_order_release);
+    for (Job* continuation : next) {
+        unblock(continuation);
+    }
+    if (parent) release(parent);
+}
+
+void JobSystem::wait(const Job& job) {
+    // Short waits spin through the deques; a long one (a background tree)
+    // backs off to naps so the waiting thread doesn't hold a core
+    int idle = 0;
+    while (!job.isDone()) {
+        if (runOne()) {
+            idle = 0;
+        } else if (++idle < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+}
+
+// === LOOPS ===
+
+namespace {
+
+struct Loop {
+    const std::function<void(int, int, int)>* body;
+    int count;
+    int chunk;
+    int chunks;
+    std::atomic<int> next_chunk;
+};
+
+void runChunks(Loop& loop) {
+    for (int c = loop.next_chunk++; c < loop.chunks; c = loop.next_chunk++) {
+        int begin = c * loop.chunk;
+        PROFILE_SCOPE("JobSystem::chunk");
+        (*loop.body)(c, begin, std::min(loop.count, begin + loop.chunk));
+    }
+}
+
+}
+
+void JobSystem::parallelFor(int count, int chunk, const std::function<void(int, int, int)>& fn, int max_threads) {
+    chunk = std::max(1, chunk);
+    const int chunks = chunkCount(count, chunk);
+    if (chunks == 0) return;
+    int threads = std::min(chunks, getThreads());
+    if (max_threads > 0) threads = std::min(threads, max_threads);
+    if (threads <= 1) {
+        for (int c = 0; c < chunks; c++) {
+            fn(c, c * chunk, std::min(count, (c + 1) * chunk));
+        }
+        return;
+    }
+    
+    // Helpers that find every chunk taken return at once; each is awaited
+    // all the same, as it holds the loop
+    Loop loop;
+    loop.body = &fn;
+    loop.count = count;
+    loop.chunk = chunk;
+    loop.chunks = chunks;
+    loop.next_chunk.store(0);
+    Job helpers[MAX_THREADS - 1];
+    for (int h = 0; h < threads - 1; h++) {
+        helpers[h].setTask([&loop]() { runChunks(loop); });
+        submit(helpers[h]);
+    }
+    runChunks(loop);
+    for (int h = 0; h < threads - 1; h++) {
+        wait(helpers[h]);
+    }
+}
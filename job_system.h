@@ -0,0 +1,125 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One pool of worker threads for all the CPU-parallel work: subtree
+// generation, the per-frame growth update, whole trees in the background,
+// PNG decodes and frame capture encodes. Each worker has a deque of its own
+// it pushes to and pops from at the back, newest first, while idle workers
+// steal the oldest job from the front of another's; threads that aren't
+// workers share one more deque. A thread waiting for a job runs other jobs
+// meanwhile rather than sleeping, so nested loops never deadlock for want
+// of threads.
+//
+//   JobSystem::shared().parallelFor(count, 256, [&](int chunk, int begin, int end) { ... });
+//
+// Jobs are owned by the caller and nothing is allocated per job but its
+// continuations: the std::function of a task capturing a pointer or two
+// is stored in place.
+// A job is done once its task and every child job submitted under it have
+// run, and then starts its continuations.
+class JobSystem;
+
+class Job {
+public:
+    Job() : parent(nullptr), unfinished(0), dependencies(1), done(true), background(false) {}
+    explicit Job(const std::function<void()>& job_task)
+        : task(job_task), parent(nullptr), unfinished(0), dependencies(1), done(true), background(false) {}
+    
+    // Not while submitted
+    void setTask(const std::function<void()>& job_task) { task = job_task; }
+    // Background jobs (a whole tree, a PNG encode) run on the workers and
+    // on other waiting workers only, never on a thread of the program's
+    // own waiting for something shorter, as the render thread does
+    void setBackground(bool on) { background = on; }
+    bool isBackground() const { return background; }
+    
+    // True before it is first submitted and again once done; a done job
+    // may be submitted again
+    bool isDone() const { return done.load(std::memory_order_acquire); }
+
+private:
+    friend class JobSystem;
+    
+    std::function<void()> task;
+    Job* parent;
+    std::atomic<int> unfinished;   // Its task and children not yet done
+    std::atomic<int> dependencies; // Jobs to finish before it starts, plus one until submitted
+    std::vector<Job*> continuations;
+    std::atomic<bool> done;
+    bool background;
+    
+    Job(const Job&);
+    Job& operator=(const Job&);
+};
+
+class JobSystem {
+public:
+    static const int MAX_THREADS = 64;  // parallelFor shares a loop among at most this many
+    static const int QUEUE_JOBS = 4096; // Per deque; a job submitted to a full one runs in place
+    
+    // threads counts the caller: threads - 1 workers are started. Every
+    // job submitted must be done before it is destroyed
+    explicit JobSystem(int threads);
+    ~JobSystem();
+    
+    // The process's pool, started at the first call with a worker for all
+    // but one of the cores (and at least one)
+    static JobSystem& shared();
+    int getThreads() const { return workers.size() + 1; }
+    
+    // === JOBS ===
+    // Queue job, as a child of parent if given: parent is not done until
+    // job is. A child is submitted before its parent is done, usually from
+    // its parent's task
+    void submit(Job& job, Job* parent = nullptr);
+    // Start after once before is done; both not submitted yet
+    static void addContinuation(Job& before, Job& after);
+    // Run queued jobs until job is done
+    void wait(const Job& job);
+    
+    // fn(chunk_index, begin, end) for every chunk of [0, count), on at most
+    // max_threads threads (0 = all) of which the caller is one. Chunk c
+    // covers [c * chunk, min(count, (c + 1) * chunk)) however many threads
+    // take part, so per-chunk results merge in a fixed order. A loop of
+    // one chunk runs inline without waking anyone
+    void parallelFor(int count, int chunk, const std::function<void(int, int, int)>& fn, int max_threads = 0);
+    static int chunkCount(int count, int chunk) { return count <= 0 ? 0 : (count + chunk - 1) / chunk; }
+
+private:
+    struct Queue;
+    
+    std::vector<std::thread> workers;
+    std::unique_ptr<Queue[]> queues; // queues[0] is shared by the threads that aren't workers
+    int queue_count;
+    std::atomic<int> queued;   // Jobs in all the deques
+    std::atomic<int> sleepers; // Workers waiting on wake
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping;
+    
+    void workerLoop(int index);
+    void push(Job* job);
+    // A job off the caller's own deque, or stolen from another's
+    Job* take(int own, bool background);
+    bool runOne();
+    // Drop one hold on job's start, queueing it once none is left
+    void unblock(Job* job);
+    void execute(Job* job);
+    // One less of job's task and children unfinished
+    void release(Job* job);
+    // Mark job done, then start its continuations and release its parent
+    void finish(Job* job);
+    
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+};
+
+#endif // JOB_SYSTEM_H
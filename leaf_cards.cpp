@@ -0,0 +1,306 @@
+#include "leaf_cards.h"
+#include <algorithm>
+#include <cmath>
+
+// Cards never get thinner than this fraction of their longer side, so a
+// cluster strung along a twig still shows the arrangement, not a sliver
+static const float CARD_MIN_ASPECT = 0.5f;
+
+LeafCards::LeafCards() {}
+
+// Integer finalizer: neighbouring clusters get unrelated variants
+static unsigned int mixBits(unsigned int x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// === CLUSTERING ===
+
+// Fit one card over the leaves members[0, count) of one branch
+static LeafCard fitCard(const std::vector<TreeBranch>& branches, const std::vector<TreeLeaf>& leaves,
+                        const int* members, int count) {
+    LeafCard card;
+    const int parent = leaves[members[0]].parent_branch_index;
+    card.parent_branch_index = parent;
+    
+    glm::vec3 center(0.0f);
+    glm::vec3 normal(0.0f);
+    for (int k = 0; k < count; k++) {
+        center += leaves[members[k]].position;
+        normal += leaves[members[k]].normal;
+    }
+    center /= (float)count;
+    // Leaves facing every way around a twig average out to a short normal;
+    // then the card faces away from the branch, as such leaves mostly do
+    if (glm::length(normal) < 0.3f * count) {
+        glm::vec3 axis = branches[parent].end - branches[parent].start;
+        glm::vec3 away = center - branches[parent].end;
+        away -= axis * (glm::dot(away, axis) / std::max(glm::dot(axis, axis), 1e-8f));
+        normal = glm::length(away) > 1e-4f ? away : leaves[members[0]].normal;
+    }
+    normal = glm::normalize(normal);
+    
+    // The u axis along the leaves' widest spread in the card's plane: a few
+    // power iterations on their covariance, from the leaf quads' right axis
+    glm::mat3 covariance(0.0f);
+    for (int k = 0; k < count; k++) {
+        glm::vec3 d = leaves[members[k]].position - center;
+        d -= normal * glm::dot(d, normal);
+        covariance += glm::outerProduct(d, d);
+    }
+    glm::vec3 u = glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f));
+    if (glm::length(u) < 0.01f) {
+        u = glm::vec3(1.0f, 0.0f, 0.0f);
+    }
+    u = glm::normalize(u);
+    for (int iteration = 0; iteration < 8; iteration++) {
+        glm::vec3 next = covariance * u;
+        if (glm::length(next) < 1e-8f) {
+            break;
+        }
+        u = glm::normalize(next);
+    }
+    u = glm::normalize(u - normal * glm::dot(u, normal));
+    glm::vec3 v = glm::cross(normal, u);
+    
+    // Half extents covering every leaf's quad (half a side, any way turned)
+    float extent_u = 0.0f;
+    float extent_v = 0.0f;
+    for (int k = 0; k < count; k++) {
+        const TreeLeaf& leaf = leaves[members[k]];
+        glm::vec3 d = leaf.position - center;
+        float reach = leaf.size * 0.5f;
+        extent_u = std::max(extent_u, fabsf(glm::dot(d, u)) + reach);
+        extent_v = std::max(extent_v, fabsf(glm::dot(d, v)) + reach);
+    }
+    extent_u = std::max(extent_u, extent_v * CARD_MIN_ASPECT);
+    extent_v = std::max(extent_v, extent_u * CARD_MIN_ASPECT);
+    
+    card.offset = center - branches[parent].end;
+    card.axis_u = u * extent_u;
+    card.axis_v = v * extent_v;
+    card.normal = normal;
+    return card;
+}
+
+void LeafCards::build(const Tree& tree) {
+    const std::vector<TreeBranch>& branches = tree.getBranches();
+    const std::vector<TreeLeaf>& leaves = tree.getLeaves();
+    const int branch_count = branches.size();
+    const int leaf_count = leaves.size();
+    cards.clear();
+    cluster_leaves.clear();
+    cluster_leaves.reserve(leaf_count);
+    
+    // Leaves by parent branch (a counting sort, keeping leaf order)
+    std::vector<int> first(branch_count + 1, 0);
+    for (const TreeLeaf& leaf : leaves) {
+        if (leaf.parent_branch_index >= 0 && leaf.parent_branch_index < branch_count) {
+            first[leaf.parent_branch_index + 1]++;
+        }
+    }
+    for (int i = 0; i < branch_count; i++) {
+        first[i + 1] += first[i];
+    }
+    std::vector<int> by_branch(first[branch_count]);
+    std::vector<int> cursor(first.begin(), first.end() - 1);
+    for (int j = 0; j < leaf_count; j++) {
+        int parent = leaves[j].parent_branch_index;
+        if (parent >= 0 && parent < branch_count) {
+            by_branch[cursor[parent]++] = j;
+        }
+    }
+    
+    // Each branch's leaves, ordered along it, in runs of at most
+    // MAX_CLUSTER_LEAVES of about equal size
+    for (int i = 0; i < branch_count; i++) {
+        const int count = first[i + 1] - first[i];
+        if (count == 0) {
+            continue;
+        }
+        int* members = &by_branch[first[i]];
+        const glm::vec3 axis = branches[i].end - branches[i].start;
+        std::sort(members, members + count, [&](int a, int b) {
+            return glm::dot(leaves[a].position, axis) < glm::dot(leaves[b].position, axis);
+        });
+        const int clusters = (count + MAX_CLUSTER_LEAVES - 1) / MAX_CLUSTER_LEAVES;
+        for (int c = 0; c < clusters; c++) {
+            const int begin = c * count / clusters;
+            const int end = (c + 1) * count / clusters;
+            LeafCard card = fitCard(branches, leaves, members + begin, end - begin);
+            card.variant = mixBits((unsigned int)cards.size()) % VARIANTS;
+            card.first_leaf = cluster_leaves.size();
+            card.leaf_count = end - begin;
+            cluster_leaves.insert(cluster_leaves.end(), members + begin, members + end);
+            cards.push_back(card);
+        }
+    }
+    vertices.assign(cards.size() * CARD_VERTICES * Tree::VERTEX_FLOATS, 0.0f);
+}
+
+// === CARD MESH ===
+
+// Write one vertex as Tree's meshes lay it out
+static inline float* writeVertex(float* out, const glm::vec3& p, float u, float v, const glm::vec3& n) {
+    out[0] = p.x; out[1] = p.y; out[2] = p.z; out[3] = 1.0f;
+    out[4] = u; out[5] = v;
+    out[6] = n.x; out[7] = n.y; out[8] = n.z;
+    return out + Tree::VERTEX_FLOATS;
+}
+
+void LeafCards::update(const Tree& tree) {
+    const std::vector<TreeBranch>& branches = tree.getBranches();
+    const int branch_count = branches.size();
+    
+    // Animated branch ends, parents before children
+    branch_end.resize(branch_count);
+    for (int i = 0; i < branch_count; i++) {
+        const TreeBranch& branch = branches[i];
+        glm::vec3 start = branch.parent_index >= 0 ? branch_end[branch.parent_index] : branch.start;
+        branch_end[i] = start + (branch.end - branch.start) * tree.branchProgress(i);
+    }
+    
+    vertices.resize(cards.size() * CARD_VERTICES * Tree::VERTEX_FLOATS);
+    float* out = vertices.data();
+    for (const LeafCard& card : cards) {
+        // Grown as far as its leaves are on average; an ungrown cluster is
+        // a degenerate card
+        float growth = 0.0f;
+        for (int k = 0; k < card.leaf_count; k++) {
+            growth += tree.leafProgress(cluster_leaves[card.first_leaf + k]);
+        }
+        growth /= (float)card.leaf_count;
+        
+        const glm::vec3 center = branch_end[card.parent_branch_index] + card.offset;
+        const glm::vec3 u = card.axis_u * growth;
+        const glm::vec3 v = card.axis_v * growth;
+        const glm::vec3 v1 = center - u - v;
+        const glm::vec3 v2 = center + u - v;
+        const glm::vec3 v3 = center + u + v;
+        const glm::vec3 v4 = center - u + v;
+        
+        // The variant's cell of the cluster texture's 2 x 2 grid
+        const float s0 = (card.variant % 2) * 0.5f;
+        const float t0 = (card.variant / 2) * 0.5f;
+        const float s1 = s0 + 0.5f;
+        const float t1 = t0 + 0.5f;
+        
+        const glm::vec3 n = card.normal;
+        out = writeVertex(out, v1, s0, t0, n);
+        out = writeVertex(out, v2, s1, t0, n);
+        out = writeVertex(out, v3, s1, t1, n);
+        out = writeVertex(out, v1, s0, t0, n);
+        out = writeVertex(out, v3, s1, t1, n);
+        out = writeVertex(out, v4, s0, t1, n);
+        
+        // The back face, reversed
+        out = writeVertex(out, v1, s0, t0, -n);
+        out = writeVertex(out, v3, s1, t1, -n);
+        out = writeVertex(out, v2, s1, t0, -n);
+        out = writeVertex(out, v1, s0, t0, -n);
+        out = writeVertex(out, v4, s0, t1, -n);
+        out = writeVertex(out, v3, s1, t1, -n);
+    }
+}
+
+// === CLUSTER TEXTURE ===
+
+// Bilinear RGBA sample of the leaf at (x, y) in [0, 1]^2, transparent outside
+static void sampleLeaf(const unsigned char* leaf, int width, int height, float x, float y, float rgba[4]) {
+    rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0.0f;
+    if (x < 0.0f || x > 1.0f || y < 0.0f || y > 1.0f) {
+        return;
+    }
+    float fx = x * (width - 1);
+    float fy = y * (height - 1);
+    int x0 = std::min((int)fx, width - 2 < 0 ? 0 : width - 2);
+    int y0 = std::min((int)fy, height - 2 < 0 ? 0 : height - 2);
+    int x1 = std::min(x0 + 1, width - 1);
+    int y1 = std::min(y0 + 1, height - 1);
+    float ax = fx - x0;
+    float ay = fy - y0;
+    const int corners[4][2] = { { x0, y0 }, { x1, y0 }, { x0, y1 }, { x1, y1 } };
+    const float weights[4] = { (1 - ax) * (1 - ay), ax * (1 - ay), (1 - ax) * ay, ax * ay };
+    for (int c = 0; c < 4; c++) {
+        const unsigned char* texel = leaf + ((size_t)corners[c][1] * width + corners[c][0]) * 4;
+        for (int k = 0; k < 4; k++) {
+            rgba[k] += weights[c] * texel[k] / 255.0f;
+        }
+    }
+}
+
+void bakeLeafClusterTexture(const unsigned char* leaf, int leaf_width, int leaf_height, int size,
+                            std::vector<unsigned char>& out) {
+    const int cell = size / 2;
+    // Premultiplied color and coverage, composited back to front
+    std::vector<float> accum((size_t)size * size * 4, 0.0f);
+    const float golden_angle = 2.39996323f;
+    
+    for (int variant = 0; variant < LeafCards::VARIANTS; variant++) {
+        const int count = 6 + 2 * variant;
+        const float origin_x = (variant % 2) * cell;
+        const float origin_y = (variant / 2) * cell;
+        unsigned int seed = 0x9e3779b9U * (variant + 1);
+        
+        // Leaves on a jittered sunflower spiral around the cell's center,
+        // stems inward, the first (innermost) ones behind the rest
+        for (int k = 0; k < count; k++) {
+            seed = mixBits(seed + k);
+            float jitter = (seed & 0xffff) / 65535.0f - 0.5f;
+            float radius = 0.27f * sqrtf((k + 0.5f) / count);
+            float angle = k * golden_angle + variant + jitter * 0.6f;
+            float leaf_size = 0.42f * (0.85f + 0.3f * ((seed >> 16) / 65535.0f));
+            float shade = 0.7f + 0.3f * (k + 1) / count;
+            
+            // Leaf axes in the cell, its +y pointing away from the center
+            glm::vec2 center(0.5f + radius * cosf(angle), 0.5f + radius * sinf(angle));
+            glm::vec2 up(cosf(angle + jitter), sinf(angle + jitter));
+            glm::vec2 right(up.y, -up.x);
+            glm::vec2 base = center - (up + right) * (leaf_size * 0.5f);
+            
+            const int min_x = std::max(0, (int)((center.x - leaf_size) * cell));
+            const int max_x = std::min(cell - 1, (int)((center.x + leaf_size) * cell) + 1);
+            const int min_y = std::max(0, (int)((center.y - leaf_size) * cell));
+            const int max_y = std::min(cell - 1, (int)((center.y + leaf_size) * cell) + 1);
+            for (int y = min_y; y <= max_y; y++) {
+                for (int x = min_x; x <= max_x; x++) {
+                    glm::vec2 p = glm::vec2((x + 0.5f) / cell, (y + 0.5f) / cell) - base;
+                    float rgba[4];
+                    sampleLeaf(leaf, leaf_width, leaf_height, glm::dot(p, right) / leaf_size,
+                               glm::dot(p, up) / leaf_size, rgba);
+                    if (rgba[3] <= 0.0f) {
+                        continue;
+                    }
+                    float* dst = &accum[(((size_t)(origin_y + y)) * size + (size_t)(origin_x + x)) * 4];
+                    for (int c = 0; c < 3; c++) {
+                        dst[c] = rgba[c] * shade * rgba[3] + dst[c] * (1.0f - rgba[3]);
+                    }
+                    dst[3] = rgba[3] + dst[3] * (1.0f - rgba[3]);
+                }
+            }
+        }
+    }
+    
+    // The mean leaf color, for the texels the leaves don't cover
+    double mean[3] = { 0.0, 0.0, 0.0 };
+    double coverage = 0.0;
+    for (size_t i = 0; i < accum.size(); i += 4) {
+        for (int c = 0; c < 3; c++) {
+            mean[c] += accum[i + c];
+        }
+        coverage += accum[i + 3];
+    }
+    out.resize(accum.size());
+    for (size_t i = 0; i < accum.size(); i += 4) {
+        float alpha = accum[i + 3];
+        for (int c = 0; c < 3; c++) {
+            float color = alpha > 1e-3f ? accum[i + c] / alpha : (coverage > 0.0 ? (float)(mean[c] / coverage) : 0.0f);
+            out[i + c] = (unsigned char)std::min(255.0f, color * 255.0f + 0.5f);
+        }
+        out[i + 3] = (unsigned char)std::min(255.0f, alpha * 255.0f + 0.5f);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef LEAF_CARDS_H
+#define LEAF_CARDS_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "tree_simple.h"
+
+// One card standing in for a cluster of leaves on one branch
+struct LeafCard {
+    int parent_branch_index;
+    glm::vec3 offset;   // Center relative to the parent's end, fully grown
+    glm::vec3 axis_u;   // Half extents in the card's plane
+    glm::vec3 axis_v;
+    glm::vec3 normal;
+    int variant;        // Arrangement of the cluster texture it shows
+    int first_leaf;     // The leaves it replaces: getClusterLeaves()[first_leaf, first_leaf + leaf_count)
+    int leaf_count;
+};
+
+// Leaf cards for mid-distance detail: the leaves of every branch grouped
+// into clusters of at most MAX_CLUSTER_LEAVES, split along the branch, and
+// each cluster replaced by one oriented, double-sided quad textured with a
+// leaf arrangement from the cluster texture (bakeLeafClusterTexture, baked
+// offline into leaf_cluster.png next to leaf.png). A branch tip's 6 to 14
+// leaves become one or two cards, about a tenth of the leaf geometry.
+//
+// A card lies in the plane of its leaves' mean normal, its u axis along
+// their widest spread, and covers every leaf's quad. Cards follow the
+// tree's growth the way leaves do: they keep their offset from the parent's
+// animated end and grow with the mean progress of their leaves
+class LeafCards {
+public:
+    static const int MAX_CLUSTER_LEAVES = 8;
+    static const int VARIANTS = 4;        // Arrangements, a 2 x 2 grid of the texture
+    static const int CARD_VERTICES = 12;  // Both faces of a quad, as double-sided leaves
+    
+    LeafCards();
+    
+    // Cluster a tree's leaves and fit the cards; needed whenever its layout
+    // changes
+    void build(const Tree& tree);
+    // Card vertices at the tree's current growth, Tree::VERTEX_FLOATS each
+    void update(const Tree& tree);
+    
+    const std::vector<LeafCard>& getCards() const { return cards; }
+    const std::vector<int>& getClusterLeaves() const { return cluster_leaves; }
+    const std::vector<float>& getVertices() const { return vertices; }
+    int getVertexCount() const { return cards.size() * CARD_VERTICES; }
+    int getCardCount() const { return cards.size(); }
+
+private:
+    std::vector<LeafCard> cards;
+    std::vector<int> cluster_leaves;  // Leaf indices, cluster after cluster
+    std::vector<float> vertices;
+    std::vector<glm::vec3> branch_end; // Scratch: animated branch ends
+};
+
+// Composite size x size RGBA8 pixels of VARIANTS leaf arrangements, one per
+// cell of a 2 x 2 grid, from one leaf image: 6, 8, 10 and 12 leaves turned
+// and scattered around the cell's center, the ones behind slightly darker.
+// Uncovered texels take the leaves' mean color, so mipmaps don't darken the
+// cut-out edges
+void bakeLeafClusterTexture(const unsigned char* leaf, int leaf_width, int leaf_height, int size,
+                            std::vector<unsigned char>& out);
+
+#endif // LEAF_CARDS_H
@@ -0,0 +1,175 @@
+#include "leaf_particles.h"
+#include "gl_dsa.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include "shaderprogram.h"
+#include "terrain.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+
+// c_leaf_particles.glsl's passes
+static const int PASS_EMIT = 0;
+static const int PASS_SIMULATE = 1;
+
+static const int PARTICLE_BYTES = 64; // The shader's Particle record
+static const int LEAF_QUAD_VERTICES = 6;
+// Words of the shader's Counters block: the DrawArraysIndirectCommand,
+// then the emit count
+static const int INSTANCE_COUNT_WORD = 1;
+static const int COUNTER_WORDS = 5;
+
+LeafParticles::LeafParticles()
+    : capacity(0), program(nullptr), season(0.0f), last_season(-1.0f), particle_buffer(0), leaf_buffer(0),
+      counter_buffer(0), emit_buffer(0), emit_capacity(0) {}
+
+LeafParticles::~LeafParticles() {
+    release();
+}
+
+bool LeafParticles::isSupported() {
+    return GLEW_VERSION_4_3;
+}
+
+void LeafParticles::create(int slots, ShaderProgram* particle_program) {
+    release();
+    if (slots <= 0 || particle_program == nullptr) return;
+    capacity = slots;
+    program = particle_program;
+    
+    // Every slot starts free: age -1
+    std::vector<float> particles((size_t)capacity * PARTICLE_BYTES / sizeof(float), 0.0f);
+    for (int i = 0; i < capacity; i++) {
+        particles[(size_t)i * PARTICLE_BYTES / sizeof(float) + 3] = -1.0f;
+    }
+    glGenBuffers(1, &particle_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, particle_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, particles.size() * sizeof(float), particles.data(), GL_DYNAMIC_COPY);
+    // The quad's instance buffer, so GlDsa's
+    leaf_buffer = GlDsa::createBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, leaf_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)capacity * sizeof(LeafInstance), nullptr, GL_DYNAMIC_COPY);
+    GLuint counters[COUNTER_WORDS] = { LEAF_QUAD_VERTICES, 0, 0, 0, 0 };
+    glGenBuffers(1, &counter_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counter_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(counters), counters, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    MemoryStats::trackBuffer(particle_buffer, particles.size() * sizeof(float), "falling leaves");
+    MemoryStats::trackBuffer(leaf_buffer, (size_t)capacity * sizeof(LeafInstance), "falling leaves");
+    MemoryStats::trackBuffer(counter_buffer, sizeof(counters), "falling leaves");
+    
+    // The leaf quad GpuTreeGenerator draws, instanced from the live records
+    static const float quad[] = {
+        -0.5f, -0.5f, 0.0f, 1.0f,  0.0f, 0.0f,
+         0.5f,  0.5f, 0.0f, 1.0f,  1.0f, 1.0f,
+         0.5f, -0.5f, 0.0f, 1.0f,  1.0f, 0.0f,
+        -0.5f, -0.5f, 0.0f, 1.0f,  0.0f, 0.0f,
+        -0.5f,  0.5f, 0.0f, 1.0f,  0.0f, 1.0f,
+         0.5f,  0.5f, 0.0f, 1.0f,  1.0f, 1.0f,
+    };
+    const int quadStride = 6 * sizeof(GLfloat);
+    const int leafStride = sizeof(LeafInstance);
+    leaf_mesh.create(false, false, "falling leaves");
+    leaf_mesh.uploadVertices(quad, sizeof(quad), GL_STATIC_DRAW);
+    leaf_mesh.attribute(leaf_mesh.vbo, VERTEX_LOCATION, 4, GL_FLOAT, false, quadStride, 0);
+    leaf_mesh.attribute(leaf_mesh.vbo, TEXCOORD_LOCATION, 2, GL_FLOAT, false, quadStride, 4 * sizeof(GLfloat));
+    leaf_mesh.attribute(leaf_buffer, LEAF_POSITION_LOCATION, 3, GL_FLOAT, false, leafStride, 0, 1);
+    leaf_mesh.attribute(leaf_buffer, LEAF_NORMAL_LOCATION, 4, GL_INT_2_10_10_10_REV, true, leafStride,
+                        3 * sizeof(GLfloat), 1);
+    leaf_mesh.attribute(leaf_buffer, LEAF_SCALE_LOCATION, 2, GL_FLOAT, false, leafStride, 4 * sizeof(GLfloat), 1);
+}
+
+void LeafParticles::release() {
+    leaf_mesh.release();
+    if (particle_buffer) {
+        GLuint buffers[4] = { particle_buffer, leaf_buffer, counter_buffer, emit_buffer };
+        int count = emit_buffer ? 4 : 3;
+        MemoryStats::forgetBuffers(count, buffers);
+        glDeleteBuffers(count, buffers);
+    }
+    particle_buffer = leaf_buffer = counter_buffer = emit_buffer = 0;
+    emit_capacity = 0;
+    capacity = 0;
+    program = nullptr;
+    last_season = -1.0f;
+}
+
+// === EMITTING ===
+
+void LeafParticles::advanceSeason(float now) {
+    last_season = last_season < 0.0f ? now : season;
+    season = now;
+}
+
+void LeafParticles::dispatchEmit(GlStateCache& state, GLuint source, int count, const glm::mat4& model,
+                                 bool seasonal) {
+    state.useProgram(program);
+    state.uniform1i("pass", PASS_EMIT);
+    state.uniform1i("capacity", capacity);
+    state.uniform1i("sourceCount", count);
+    state.uniformMatrix4fv("sourceModel", glm::value_ptr(model));
+    state.uniform1i("seasonal", seasonal ? 1 : 0);
+    glUniform2f(program->u("seasonRange"), last_season, season);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, source);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, particle_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, counter_buffer);
+    glDispatchCompute((count + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void LeafParticles::emitSeasonal(GlStateCache& state, GLuint source, int count, const glm::mat4& model) {
+    if (!isCreated() || source == 0 || count <= 0 || last_season < 0.0f || last_season == season) return;
+    dispatchEmit(state, source, count, model, true);
+}
+
+void LeafParticles::emit(GlStateCache& state, const std::vector<LeafInstance>& records, const glm::mat4& model) {
+    if (!isCreated() || records.empty()) return;
+    size_t bytes = records.size() * sizeof(LeafInstance);
+    if (bytes > emit_capacity) {
+        if (emit_buffer == 0) glGenBuffers(1, &emit_buffer);
+        emit_capacity = std::max(bytes, emit_capacity * 2);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, emit_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, emit_capacity, nullptr, GL_STREAM_DRAW);
+        MemoryStats::trackBuffer(emit_buffer, emit_capacity, "falling leaves");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, emit_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, records.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    dispatchEmit(state, emit_buffer, records.size(), model, false);
+}
+
+// === PER FRAME ===
+
+void LeafParticles::simulate(GlStateCache& state, float delta_time, float time, const glm::vec4& wind,
+                             const glm::vec4& wind_gusts, const Terrain& terrain) {
+    if (!isCreated()) return;
+    // The draw counts this frame's live leaves from zero
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counter_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, INSTANCE_COUNT_WORD * sizeof(GLuint), sizeof(GLuint), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    
+    state.useProgram(program);
+    state.uniform1i("pass", PASS_SIMULATE);
+    state.uniform1i("capacity", capacity);
+    state.uniform1f("deltaTime", delta_time);
+    state.uniform1f("time", time);
+    glUniform4fv(program->u("wind"), 1, glm::value_ptr(wind));
+    glUniform4fv(program->u("windGusts"), 1, glm::value_ptr(wind_gusts));
+    terrain.bindHeights(state);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, particle_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, leaf_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, counter_buffer);
+    glDispatchCompute((capacity + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void LeafParticles::draw(GlStateCache& state) const {
+    if (!isCreated()) return;
+    state.uniform1i("growthMode", 6);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, counter_buffer);
+    leaf_mesh.bind();
+    leaf_mesh.drawIndirect(0, 1);
+    GpuMesh::unbind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    state.uniform1i("growthMode", 0);
+}
@@ -0,0 +1,80 @@
+#ifndef LEAF_PARTICLES_H
+#define LEAF_PARTICLES_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "gpu_mesh.h"
+#include "tree_simple.h"
+
+class GlStateCache;
+class ShaderProgram;
+class Terrain;
+
+// Leaves that leave their trees, falling and tumbling to the ground, on the
+// GPU: c_leaf_particles.glsl emits them from LeafInstance records and steps
+// them every frame, writing the live ones as LeafInstance records the leaf
+// quad is instanced from, with an indirect draw of as many. Nothing is read
+// back. The on-tree instanced leaves (v_simplest.glsl's growthMode 3) leave
+// the tree whole at their drop time while fallingLeaves is set, and the
+// season emit drops the same ones into the ring the same frame.
+//
+// A fixed ring of particles: an emit past its capacity takes over the
+// oldest. Needs OpenGL 4.3
+class LeafParticles {
+public:
+    static const int VERTEX_LOCATION = 0; // v_simplest.glsl's inputs
+    static const int TEXCOORD_LOCATION = 2;
+    static const int LEAF_POSITION_LOCATION = 5;
+    static const int LEAF_NORMAL_LOCATION = 6;
+    static const int LEAF_SCALE_LOCATION = 7;
+    
+    LeafParticles();
+    ~LeafParticles();
+    
+    static bool isSupported();
+    
+    // Room for capacity falling leaves, stepped by program (c_leaf_particles.glsl)
+    void create(int capacity, ShaderProgram* program);
+    bool isCreated() const { return particle_buffer != 0; }
+    void release();
+    
+    // === EMITTING ===
+    // This frame's season: the season emits drop what it passed since the
+    // last call (nothing on the first)
+    void advanceSeason(float season);
+    // The leaves among count LeafInstance records of source, in model's
+    // space, whose drop time the season just passed
+    void emitSeasonal(GlStateCache& state, GLuint source, int count, const glm::mat4& model);
+    // Every leaf of records, such as the ones of a pruned branch
+    void emit(GlStateCache& state, const std::vector<LeafInstance>& records, const glm::mat4& model);
+    
+    // === PER FRAME ===
+    // Step the leaves by delta_time seconds in the wind (FrameData's wind
+    // and windGusts at the scene clock time), down onto the terrain
+    void simulate(GlStateCache& state, float delta_time, float time, const glm::vec4& wind,
+                  const glm::vec4& wind_gusts, const Terrain& terrain);
+    // The live leaves, one indirect draw of the leaf quad (growthMode 6)
+    void draw(GlStateCache& state) const;
+    
+    int getCapacity() const { return capacity; }
+
+private:
+    int capacity;
+    ShaderProgram* program;
+    float season;
+    float last_season; // < 0 before the first advanceSeason
+    GLuint particle_buffer;
+    GLuint leaf_buffer;    // LeafInstance records, the quad's instances
+    GLuint counter_buffer; // The draw command and the emit count
+    GLuint emit_buffer;    // emit()'s records
+    size_t emit_capacity;  // Bytes
+    GpuMesh leaf_mesh;
+    
+    void dispatchEmit(GlStateCache& state, GLuint source, int count, const glm::mat4& model, bool seasonal);
+    
+    LeafParticles(const LeafParticles&);
+    LeafParticles& operator=(const LeafParticles&);
+};
+
+#endif // LEAF_PARTICLES_H
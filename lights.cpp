@@ -0,0 +1,164 @@
+#include "lights.h"
+#include "memory_stats.h"
+#include "render_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// === CLUSTER ASSIGNMENT ===
+
+LightClusters::LightClusters()
+    : scale_x(1.0f), scale_y(1.0f), near_plane(1.0f), far_plane(50.0f),
+      grid(CLUSTER_COUNT * 2, 0) {}
+
+void LightClusters::setProjection(const glm::mat4& P, float near_distance, float far_distance) {
+    scale_x = P[0][0];
+    scale_y = P[1][1];
+    near_plane = near_distance;
+    far_plane = far_distance;
+}
+
+// Depth slices grow geometrically from the near to the far plane
+int LightClusters::sliceOf(float depth) const {
+    int slice = (int)std::floor(std::log(depth / near_plane) / std::log(far_plane / near_plane) * SLICES);
+    return std::max(0, std::min(SLICES - 1, slice));
+}
+
+float LightClusters::sliceStart(int slice) const {
+    return near_plane * std::pow(far_plane / near_plane, (float)slice / SLICES);
+}
+
+void LightClusters::fillHeader(LightUniforms& uniforms, int global_count) const {
+    float log_range = std::log(far_plane / near_plane);
+    uniforms.cluster_dims[0] = TILES_X;
+    uniforms.cluster_dims[1] = TILES_Y;
+    uniforms.cluster_dims[2] = SLICES;
+    uniforms.cluster_dims[3] = global_count;
+    uniforms.cluster_scale[0] = scale_x;
+    uniforms.cluster_scale[1] = scale_y;
+    uniforms.cluster_scale[2] = SLICES / log_range;
+    uniforms.cluster_scale[3] = -SLICES * std::log(near_plane) / log_range;
+}
+
+// Tile range covered by the interval [low, high] of eye x (or y) at depths
+// between d0 and d1. x / depth is monotonic in depth for a fixed x, so the
+// extremes are reached at the ends of both intervals
+static bool tileRange(float low, float high, float d0, float d1, float scale, int tiles,
+                      int& first, int& last) {
+    float a = low * scale / d0, b = low * scale / d1;
+    float c = high * scale / d0, d = high * scale / d1;
+    float ndc_min = std::min(std::min(a, b), std::min(c, d));
+    float ndc_max = std::max(std::max(a, b), std::max(c, d));
+    if (ndc_max < -1.0f || ndc_min > 1.0f) return false;
+    first = std::max(0, (int)std::floor((ndc_min * 0.5f + 0.5f) * tiles));
+    last = std::min(tiles - 1, (int)std::floor((ndc_max * 0.5f + 0.5f) * tiles));
+    return first <= last;
+}
+
+void LightClusters::assign(const PointLight* lights, int first, int count) {
+    // Every (cluster, light) overlap, then grouped by cluster
+    pairs.clear();
+    for (int i = first; i < count; i++) {
+        const PointLight& light = lights[i];
+        float depth = -light.position.z;
+        float z0 = std::max(depth - light.radius, near_plane);
+        float z1 = std::min(depth + light.radius, far_plane);
+        if (light.radius <= 0.0f || z0 > z1) continue;
+        
+        for (int slice = sliceOf(z0); slice <= sliceOf(z1); slice++) {
+            float d0 = std::max(z0, sliceStart(slice));
+            float d1 = std::min(z1, sliceStart(slice + 1));
+            int x0, x1, y0, y1;
+            if (!tileRange(light.position.x - light.radius, light.position.x + light.radius,
+                           d0, d1, scale_x, TILES_X, x0, x1)) continue;
+            if (!tileRange(light.position.y - light.radius, light.position.y + light.radius,
+                           d0, d1, scale_y, TILES_Y, y0, y1)) continue;
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    pairs.push_back(std::make_pair((slice * TILES_Y + y) * TILES_X + x, i));
+                }
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    
+    std::fill(grid.begin(), grid.end(), 0);
+    indices.resize(pairs.size());
+    for (size_t k = 0; k < pairs.size(); k++) {
+        int cluster = pairs[k].first;
+        if (grid[cluster * 2 + 1] == 0) grid[cluster * 2] = k;
+        grid[cluster * 2 + 1]++;
+        indices[k] = pairs[k].second;
+    }
+}
+
+// === GPU BUFFERS ===
+
+static void createTextureBuffer(GLuint& buffer, GLuint& texture, GLenum format) {
+    glGenBuffers(1, &buffer);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+template<typename T>
+static void uploadTextureBuffer(GLuint buffer, const std::vector<T>& data) {
+    // An empty buffer is still a valid texture; keep one element
+    static const T zero = T();
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(data.size(), 1) * sizeof(T),
+                 data.empty() ? &zero : data.data(), GL_STREAM_DRAW);
+    MemoryStats::trackBuffer(buffer, std::max<size_t>(data.size(), 1) * sizeof(T), "lights");
+    RenderStats::countUpload(std::max<size_t>(data.size(), 1) * sizeof(T));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightBuffer::create() {
+    if (ubo == 0) glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightUniforms), nullptr, GL_DYNAMIC_DRAW);
+    MemoryStats::trackBuffer(ubo, sizeof(LightUniforms), "lights");
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+    if (grid_buffer == 0) createTextureBuffer(grid_buffer, grid_texture, GL_RG32UI);
+    if (index_buffer == 0) createTextureBuffer(index_buffer, index_texture, GL_R16UI);
+}
+
+void LightBuffer::release() {
+    const GLuint buffers[3] = { ubo, grid_buffer, index_buffer };
+    MemoryStats::forgetBuffers(3, buffers);
+    glDeleteBuffers(1, &ubo);
+    glDeleteBuffers(1, &grid_buffer);
+    glDeleteBuffers(1, &index_buffer);
+    glDeleteTextures(1, &grid_texture);
+    glDeleteTextures(1, &index_texture);
+    ubo = grid_buffer = index_buffer = grid_texture = index_texture = 0;
+}
+
+void LightBuffer::update(const std::vector<PointLight>& lights, const glm::mat4& V, const glm::mat4& P,
+                         float near_distance, float far_distance) {
+    // Unbounded lights first: every fragment shades them, outside the clusters
+    int count = 0;
+    int global_count = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (const PointLight& light : lights) {
+            if ((light.radius <= 0.0f) != (pass == 0) || count == LightUniforms::MAX_LIGHTS) continue;
+            staging.lights[count] = light;
+            staging.lights[count].position = glm::vec3(V * glm::vec4(light.position, 1.0f));
+            count++;
+        }
+        if (pass == 0) global_count = count;
+    }
+    
+    clusters.setProjection(P, near_distance, far_distance);
+    clusters.assign(staging.lights, global_count, count);
+    clusters.fillHeader(staging, global_count);
+    
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, offsetof(LightUniforms, lights) + count * sizeof(PointLight), &staging);
+    RenderStats::countUpload(offsetof(LightUniforms, lights) + count * sizeof(PointLight));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    uploadTextureBuffer(grid_buffer, clusters.getGrid());
+    uploadTextureBuffer(index_buffer, clusters.getIndices());
+}
@@ -0,0 +1,108 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// A point light of the LightData uniform block in f_simplest.glsl, std140
+// layout. Light falls off smoothly to zero at radius; radius 0 never fades
+// (the sun). Diffuse light is color * intensity, the highlight
+// color * specular
+struct PointLight {
+    glm::vec3 position;   // World space here, eye space once uploaded
+    float radius;
+    glm::vec3 color;
+    float intensity;
+    float specular;
+    float shadow;         // The shadow map darkening it (ShadowMaps::SUN_SHADOW, TORCH_SHADOW), 0 = none
+    float pad[2];
+};
+
+static_assert(sizeof(PointLight) == 48, "PointLight must match the std140 Light struct");
+
+// The LightData block: the cluster grid's size and the global light count,
+// the constants that map an eye-space position to its cluster, then the
+// lights, unbounded ones first. MAX_LIGHTS must match the array size in
+// f_simplest.glsl; 256 lights stay inside the 16 KB every GL 3.3 driver
+// allows a uniform block
+struct LightUniforms {
+    static const int MAX_LIGHTS = 256;
+    GLint cluster_dims[4];    // Tiles x, tiles y, depth slices, lights with radius 0
+    GLfloat cluster_scale[4]; // P[0][0], P[1][1], slice = log(depth) * [2] + [3]
+    PointLight lights[MAX_LIGHTS];
+};
+
+// Clustered light assignment: the view frustum is cut into TILES_X x TILES_Y
+// screen tiles and SLICES depth slices, spaced exponentially so near
+// clusters stay small, and each cluster lists the lights whose sphere may
+// reach it. The fragment shader finds its cluster and shades only those, so
+// the cost of a pixel follows the lights around it, not the scene's total.
+// The bounds are conservative: a listed light can still miss the fragment
+// and is then skipped by the radius test
+class LightClusters {
+public:
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+private:
+    float scale_x; // P[0][0]: eye x / depth -> NDC x
+    float scale_y; // P[1][1]
+    float near_plane;
+    float far_plane;
+    std::vector<GLuint> grid;      // Per cluster: first entry in indices, count
+    std::vector<GLushort> indices; // Light indices, grouped by cluster
+    std::vector<std::pair<int, int> > pairs; // (cluster, light) scratch
+    
+    int sliceOf(float depth) const;
+    float sliceStart(int slice) const;
+
+public:
+    LightClusters();
+    
+    void setProjection(const glm::mat4& P, float near_distance, float far_distance);
+    // Assign lights [first, count) of an eye-space list to the clusters
+    void assign(const PointLight* lights, int first, int count);
+    
+    const std::vector<GLuint>& getGrid() const { return grid; }
+    const std::vector<GLushort>& getIndices() const { return indices; }
+    // Header of LightUniforms for this projection
+    void fillHeader(LightUniforms& uniforms, int global_count) const;
+};
+
+// The light list in one uniform buffer bound to BINDING like
+// FrameUniformBuffer, with the cluster grid and light indices in texture
+// buffers for the units GRID_UNIT and INDEX_UNIT. update() moves the lights
+// to eye space, clusters them and uploads only the lights in use
+class LightBuffer {
+private:
+    GLuint ubo;
+    GLuint grid_buffer;
+    GLuint grid_texture;  // GL_RG32UI over grid_buffer
+    GLuint index_buffer;
+    GLuint index_texture; // GL_R16UI over index_buffer
+    LightUniforms staging;
+    LightClusters clusters;
+
+public:
+    static const GLuint BINDING = 1;
+    static const int GRID_UNIT = 6;
+    static const int INDEX_UNIT = 7;
+    static const char* blockName() { return "LightData"; }
+    
+    LightBuffer() : ubo(0), grid_buffer(0), grid_texture(0), index_buffer(0), index_texture(0) {}
+    // Leaves the texture units bound behind GlStateCache's back
+    void create();
+    void release();
+    // Lights past LightUniforms::MAX_LIGHTS are dropped; near_distance and
+    // far_distance are the clip planes of P
+    void update(const std::vector<PointLight>& lights, const glm::mat4& V, const glm::mat4& P,
+                float near_distance, float far_distance);
+    
+    GLuint getGridTexture() const { return grid_texture; }
+    GLuint getIndexTexture() const { return index_texture; }
+};
+
+#endif // LIGHTS_H
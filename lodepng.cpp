@@ -35,8 +35,19 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 
 #ifdef LODEPNG_COMPILE_CPP
 #include <fstream>
+#ifdef LODEPNG_COMPILE_ENCODER
+#include <atomic>
+#include <thread>
+#endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_CPP*/
 
+/*SSE2 is part of every x86-64 CPU, so the vector unfilter needs no runtime check there*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LODEPNG_SSE2
+#include <emmintrin.h>
+#include <string.h>
+#endif
+
 #if defined(_MSC_VER) && (_MSC_VER >= 1310) /*Visual Studio: A few warning types are not desired here.*/
 #pragma warning( disable : 4244 ) /*implicit conversions: not warned by gcc -Wall -Wextra and requires too much casts*/
 #pragma warning( disable : 4996 ) /*VS does not like fopen, but fopen_s is not standard C so unusable here*/
@@ -423,25 +434,81 @@ static void addBitsToStreamReversed(size_t* bitpointer, ucvector* bitstream, uns
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-#define READBIT(bitpointer, bitstream) ((bitstream[bitpointer >> 3] >> (bitpointer & 0x7)) & (unsigned char)1)
+/*
+buffered bit reader of the inflator: the next bits of the stream, lsb first, in
+a 64-bit accumulator refilled by one load of up to 8 bytes, so the bounds are
+checked per refill instead of per bit. Past the end of the data it reads zeros;
+callers compare bp with bitsize to detect that
+*/
+typedef struct LodePNGBitReader
+{
+  const unsigned char* data;
+  size_t size; /*size of data in bytes*/
+  size_t bitsize; /*size of data in bits, end of valid bp values*/
+  size_t bp; /*position of the next bit to read*/
+  unsigned long long buffer; /*the bits from bp on, lsb first*/
+  unsigned bufferbits; /*how many of them are loaded*/
+} LodePNGBitReader;
 
-static unsigned char readBitFromStream(size_t* bitpointer, const unsigned char* bitstream)
+static void LodePNGBitReader_init(LodePNGBitReader* reader, const unsigned char* data, size_t size)
 {
-  unsigned char result = (unsigned char)(READBIT(*bitpointer, bitstream));
-  ++(*bitpointer);
-  return result;
+  reader->data = data;
+  reader->size = size;
+  reader->bitsize = size * 8;
+  reader->bp = 0;
+  reader->buffer = 0;
+  reader->bufferbits = 0;
 }
 
-static unsigned readBitsFromStream(size_t* bitpointer, const unsigned char* bitstream, size_t nbits)
+/*make sure at least nbits bits are loaded, nbits at most 57*/
+static void ensureBits(LodePNGBitReader* reader, unsigned nbits)
 {
-  unsigned result = 0, i;
-  for(i = 0; i != nbits; ++i)
+  size_t p;
+  unsigned i;
+  if(reader->bufferbits >= nbits) return;
+  p = reader->bp >> 3;
+  reader->buffer = 0;
+  if(p + 8 <= reader->size)
   {
-    result += ((unsigned)READBIT(*bitpointer, bitstream)) << i;
-    ++(*bitpointer);
+    for(i = 0; i != 8; ++i) reader->buffer |= (unsigned long long)reader->data[p + i] << (8 * i);
   }
+  else
+  {
+    for(i = 0; p + i < reader->size && i != 8; ++i) reader->buffer |= (unsigned long long)reader->data[p + i] << (8 * i);
+  }
+  reader->buffer >>= (reader->bp & 0x7);
+  reader->bufferbits = 64u - (unsigned)(reader->bp & 0x7);
+}
+
+/*the next nbits bits (at most 32) without consuming them; ensureBits must have loaded them*/
+static unsigned peekBits(const LodePNGBitReader* reader, unsigned nbits)
+{
+  return (unsigned)(reader->buffer & (((unsigned long long)1 << nbits) - 1u));
+}
+
+/*consume nbits loaded bits*/
+static void advanceBits(LodePNGBitReader* reader, unsigned nbits)
+{
+  reader->buffer >>= nbits;
+  reader->bufferbits -= nbits;
+  reader->bp += nbits;
+}
+
+static unsigned readBits(LodePNGBitReader* reader, unsigned nbits)
+{
+  unsigned result;
+  ensureBits(reader, nbits);
+  result = peekBits(reader, nbits);
+  advanceBits(reader, nbits);
   return result;
 }
+
+/*move to the next byte boundary, for data stored byte-aligned*/
+static void alignToByte(LodePNGBitReader* reader)
+{
+  reader->bp = (reader->bp + 7u) & ~(size_t)7u;
+  reader->bufferbits = 0;
+}
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -484,12 +551,27 @@ static const unsigned CLCL_ORDER[NUM_CODE_LENGTH_CODES]
 
 /* ////////////////////////////////////////////////////////////////////////// */
 
+/*
+the decoder looks up the first FIRSTBITS bits of a code in one table; longer
+codes continue in a subtable of the entry for their first FIRSTBITS bits
+*/
+#define FIRSTBITS 9u
+/*table value of bit patterns that aren't a code of an incomplete tree*/
+#define INVALIDSYMBOL 65535u
+
 /*
 Huffman tree struct, containing multiple representations of the tree
 */
 typedef struct HuffmanTree
 {
-  unsigned* tree2d;
+  /*
+  decoding table, indexed by the next FIRSTBITS input bits (lsb first). An entry
+  of length <= FIRSTBITS is a symbol of that many bits; a longer one is a
+  subtable of 2^(length - FIRSTBITS) entries at table_value, indexed by the bits
+  after the first FIRSTBITS
+  */
+  unsigned char* table_len;
+  unsigned short* table_value;
   unsigned* tree1d;
   unsigned* lengths; /*the lengths of the codes of the 1d-tree*/
   unsigned maxbitlen; /*maximum number of bits a single code can get*/
@@ -511,74 +593,133 @@ static void HuffmanTree_draw(HuffmanTree* tree)
 
 static void HuffmanTree_init(HuffmanTree* tree)
 {
-  tree->tree2d = 0;
+  tree->table_len = 0;
+  tree->table_value = 0;
   tree->tree1d = 0;
   tree->lengths = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
 {
-  lodepng_free(tree->tree2d);
+  lodepng_free(tree->table_len);
+  lodepng_free(tree->table_value);
   lodepng_free(tree->tree1d);
   lodepng_free(tree->lengths);
 }
 
-/*the tree representation used by the decoder. return value is error*/
-static unsigned HuffmanTree_make2DTree(HuffmanTree* tree)
+static unsigned reverseBits(unsigned bits, unsigned num)
 {
-  unsigned nodefilled = 0; /*up to which node it is filled*/
-  unsigned treepos = 0; /*position in the tree (1 of the numcodes columns)*/
-  unsigned n, i;
+  unsigned i, result = 0;
+  for(i = 0; i < num; ++i) result |= ((bits >> (num - i - 1u)) & 1u) << i;
+  return result;
+}
 
-  tree->tree2d = (unsigned*)lodepng_malloc(tree->numcodes * 2 * sizeof(unsigned));
-  if(!tree->tree2d) return 83; /*alloc fail*/
+/*the table representation used by the decoder. return value is error*/
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree)
+{
+  static const unsigned headsize = 1u << FIRSTBITS;
+  static const unsigned mask = (1u << FIRSTBITS) - 1u;
+  size_t i, j, pointer, size; /*total table size*/
+  unsigned* maxlens = (unsigned*)lodepng_malloc(headsize * sizeof(unsigned));
+  if(!maxlens) return 83; /*alloc fail*/
 
-  /*
-  convert tree1d[] to tree2d[][]. In the 2D array, a value of 32767 means
-  uninited, a value >= numcodes is an address to another bit, a value < numcodes
-  is a code. The 2 rows are the 2 possible bit values (0 or 1), there are as
-  many columns as codes - 1.
-  A good huffman tree has N * 2 - 1 nodes, of which N - 1 are internal nodes.
-  Here, the internal nodes are stored (what their 0 and 1 option point to).
-  There is only memory for such good tree currently, if there are more nodes
-  (due to too long length codes), error 55 will happen
-  */
-  for(n = 0; n < tree->numcodes * 2; ++n)
+  /*compute maxlens: max total bit length of symbols sharing prefix in the first table*/
+  for(i = 0; i != headsize; ++i) maxlens[i] = 0;
+  for(i = 0; i < tree->numcodes; i++)
+  {
+    unsigned symbol = tree->tree1d[i];
+    unsigned l = tree->lengths[i];
+    unsigned index;
+    if(l <= FIRSTBITS) continue; /*symbols that fit in first table don't increase secondary table size*/
+    /*get the FIRSTBITS MSBs, the MSBs of the symbol are encoded first. See later comment about the reversing*/
+    index = reverseBits(symbol >> (l - FIRSTBITS), FIRSTBITS);
+    if(l > maxlens[index]) maxlens[index] = l;
+  }
+  /*compute total table size: size of first table plus all secondary tables for symbols longer than FIRSTBITS*/
+  size = headsize;
+  for(i = 0; i < headsize; ++i)
+  {
+    unsigned l = maxlens[i];
+    if(l > FIRSTBITS) size += (1u << (l - FIRSTBITS));
+  }
+  tree->table_len = (unsigned char*)lodepng_malloc(size * sizeof(*tree->table_len));
+  tree->table_value = (unsigned short*)lodepng_malloc(size * sizeof(*tree->table_value));
+  if(!tree->table_len || !tree->table_value)
   {
-    tree->tree2d[n] = 32767; /*32767 here means the tree2d isn't filled there yet*/
+    lodepng_free(maxlens);
+    /*freeing tree->table values is done at a higher scope*/
+    return 83; /*alloc fail*/
+  }
+  /*initialize with an invalid length to indicate unused entries*/
+  for(i = 0; i < size; ++i) tree->table_len[i] = 16;
+
+  /*fill in the first table for long symbols: max prefix size and pointer to secondary tables*/
+  pointer = headsize;
+  for(i = 0; i < headsize; ++i)
+  {
+    unsigned l = maxlens[i];
+    if(l <= FIRSTBITS) continue;
+    tree->table_len[i] = l;
+    tree->table_value[i] = (unsigned short)pointer;
+    pointer += (1u << (l - FIRSTBITS));
   }
+  lodepng_free(maxlens);
 
-  for(n = 0; n < tree->numcodes; ++n) /*the codes*/
+  /*fill in the first table for short symbols, or secondary table for long symbols*/
+  for(i = 0; i < tree->numcodes; ++i)
   {
-    for(i = 0; i != tree->lengths[n]; ++i) /*the bits for this code*/
+    unsigned l = tree->lengths[i];
+    unsigned symbol = tree->tree1d[i]; /*the huffman bit pattern. i itself is the value.*/
+    /*reverse bits, because the huffman bits are given in MSB first order but the bit reader reads LSB first*/
+    unsigned reverse = reverseBits(symbol, l);
+    if(l == 0) continue;
+
+    if(l <= FIRSTBITS)
     {
-      unsigned char bit = (unsigned char)((tree->tree1d[n] >> (tree->lengths[n] - i - 1)) & 1);
-      /*oversubscribed, see comment in lodepng_error_text*/
-      if(treepos > 2147483647 || treepos + 2 > tree->numcodes) return 55;
-      if(tree->tree2d[2 * treepos + bit] == 32767) /*not yet filled in*/
+      /*short symbol, fully in first table, replicated num times if l < FIRSTBITS*/
+      unsigned num = 1u << (FIRSTBITS - l);
+      for(j = 0; j < num; ++j)
       {
-        if(i + 1 == tree->lengths[n]) /*last bit*/
-        {
-          tree->tree2d[2 * treepos + bit] = n; /*put the current code in it*/
-          treepos = 0;
-        }
-        else
-        {
-          /*put address of the next step in here, first that address has to be found of course
-          (it's just nodefilled + 1)...*/
-          ++nodefilled;
-          /*addresses encoded with numcodes added to it*/
-          tree->tree2d[2 * treepos + bit] = nodefilled + tree->numcodes;
-          treepos = nodefilled;
-        }
+        /*bit reader will read the l bits of symbol first, the remaining FIRSTBITS - l bits go to the MSB's*/
+        unsigned index = reverse | (unsigned)(j << l);
+        if(tree->table_len[index] != 16) return 55; /*invalid tree: long symbol shares prefix with short symbol*/
+        tree->table_len[index] = l;
+        tree->table_value[index] = (unsigned short)i;
+      }
+    }
+    else
+    {
+      /*long symbol, shares prefix with other long symbols in first lookup table, needs second lookup*/
+      /*the FIRSTBITS MSBs of the symbol are the first table index*/
+      unsigned index = reverse & mask;
+      unsigned maxlen = tree->table_len[index];
+      /*log2 of secondary table length, should be >= l - FIRSTBITS*/
+      unsigned tablelen = maxlen - FIRSTBITS;
+      unsigned start = tree->table_value[index]; /*starting index in secondary table*/
+      unsigned num = 1u << (tablelen - (l - FIRSTBITS)); /*amount of entries of this symbol in secondary table*/
+      if(maxlen < l) return 55; /*invalid tree: long symbol shares prefix with short symbol*/
+      for(j = 0; j < num; ++j)
+      {
+        unsigned reverse2 = reverse >> FIRSTBITS; /* l - FIRSTBITS bits */
+        unsigned index2 = start + (reverse2 | (unsigned)(j << (l - FIRSTBITS)));
+        if(tree->table_len[index2] != 16) return 55; /*oversubscribed, see comment in lodepng_error_text*/
+        tree->table_len[index2] = l;
+        tree->table_value[index2] = (unsigned short)i;
       }
-      else treepos = tree->tree2d[2 * treepos + bit] - tree->numcodes;
     }
   }
 
-  for(n = 0; n < tree->numcodes * 2; ++n)
+  /*
+  bit patterns no code reaches (an incomplete tree, such as a distance tree of
+  a single code) decode to INVALIDSYMBOL, an error only if the data uses them
+  */
+  for(i = 0; i < size; ++i)
   {
-    if(tree->tree2d[n] == 32767) tree->tree2d[n] = 0; /*remove possible remaining 32767's*/
+    if(tree->table_len[i] == 16)
+    {
+      tree->table_len[i] = (i < headsize) ? 1 : (FIRSTBITS + 1);
+      tree->table_value[i] = INVALIDSYMBOL;
+    }
   }
 
   return 0;
@@ -625,7 +766,7 @@ static unsigned HuffmanTree_makeFromLengths2(HuffmanTree* tree)
   uivector_cleanup(&blcount);
   uivector_cleanup(&nextcode);
 
-  if(!error) return HuffmanTree_make2DTree(tree);
+  if(!error) return HuffmanTree_makeTable(tree);
   else return error;
 }
 
@@ -906,26 +1047,30 @@ static unsigned generateFixedDistanceTree(HuffmanTree* tree)
 
 /*
 returns the code, or (unsigned)(-1) if error happened
-inbitlength is the length of the complete buffer, in bits (so its byte length times 8)
 */
-static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
-                                    const HuffmanTree* codetree, size_t inbitlength)
+static unsigned huffmanDecodeSymbol(LodePNGBitReader* reader, const HuffmanTree* codetree)
 {
-  unsigned treepos = 0, ct;
-  for(;;)
+  unsigned index, l, value;
+  if(reader->bp >= reader->bitsize) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
+  /*
+  decode the symbol from the table: one lookup by the next FIRSTBITS bits, a
+  second one by the bits after them for longer codes. This is the biggest
+  bottleneck while decoding
+  */
+  ensureBits(reader, 15);
+  index = peekBits(reader, FIRSTBITS);
+  l = codetree->table_len[index];
+  value = codetree->table_value[index];
+  if(l > FIRSTBITS)
   {
-    if(*bp >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
-    /*
-    decode the symbol from the tree. The "readBitFromStream" code is inlined in
-    the expression below because this is the biggest bottleneck while decoding
-    */
-    ct = codetree->tree2d[(treepos << 1) + READBIT(*bp, in)];
-    ++(*bp);
-    if(ct < codetree->numcodes) return ct; /*the symbol is decoded, return it*/
-    else treepos = ct - codetree->numcodes; /*symbol not yet decoded, instead move tree position*/
-
-    if(treepos >= codetree->numcodes) return (unsigned)(-1); /*error: it appeared outside the codetree*/
+    index = value + ((unsigned)(reader->buffer >> FIRSTBITS) & ((1u << (l - FIRSTBITS)) - 1u));
+    l = codetree->table_len[index];
+    value = codetree->table_value[index];
   }
+  advanceBits(reader, l);
+  if(reader->bp > reader->bitsize) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
+  if(value == INVALIDSYMBOL) return (unsigned)(-1); /*error: it appeared outside the codetree*/
+  return value;
 }
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -945,12 +1090,11 @@ static void getTreeInflateFixed(HuffmanTree* tree_ll, HuffmanTree* tree_d)
 
 /*get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
 static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
-                                      const unsigned char* in, size_t* bp, size_t inlength)
+                                      LodePNGBitReader* reader)
 {
   /*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated*/
   unsigned error = 0;
   unsigned n, HLIT, HDIST, HCLEN, i;
-  size_t inbitlength = inlength * 8;
 
   /*see comments in deflateDynamic for explanation of the context and these variables, it is analogous*/
   unsigned* bitlen_ll = 0; /*lit,len code lengths*/
@@ -959,16 +1103,16 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   unsigned* bitlen_cl = 0;
   HuffmanTree tree_cl; /*the code tree for code length codes (the huffman tree for compressed huffman trees)*/
 
-  if((*bp) + 14 > (inlength << 3)) return 49; /*error: the bit pointer is or will go past the memory*/
+  if(reader->bp + 14 > reader->bitsize) return 49; /*error: the bit pointer is or will go past the memory*/
 
   /*number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already*/
-  HLIT =  readBitsFromStream(bp, in, 5) + 257;
+  HLIT =  readBits(reader, 5) + 257;
   /*number of distance codes. Unlike the spec, the value 1 is added to it here already*/
-  HDIST = readBitsFromStream(bp, in, 5) + 1;
+  HDIST = readBits(reader, 5) + 1;
   /*number of code length codes. Unlike the spec, the value 4 is added to it here already*/
-  HCLEN = readBitsFromStream(bp, in, 4) + 4;
+  HCLEN = readBits(reader, 4) + 4;
 
-  if((*bp) + HCLEN * 3 > (inlength << 3)) return 50; /*error: the bit pointer is or will go past the memory*/
+  if(reader->bp + HCLEN * 3 > reader->bitsize) return 50; /*error: the bit pointer is or will go past the memory*/
 
   HuffmanTree_init(&tree_cl);
 
@@ -981,7 +1125,7 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 
     for(i = 0; i != NUM_CODE_LENGTH_CODES; ++i)
     {
-      if(i < HCLEN) bitlen_cl[CLCL_ORDER[i]] = readBitsFromStream(bp, in, 3);
+      if(i < HCLEN) bitlen_cl[CLCL_ORDER[i]] = readBits(reader, 3);
       else bitlen_cl[CLCL_ORDER[i]] = 0; /*if not, it must stay 0*/
     }
 
@@ -999,7 +1143,7 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
     i = 0;
     while(i < HLIT + HDIST)
     {
-      unsigned code = huffmanDecodeSymbol(in, bp, &tree_cl, inbitlength);
+      unsigned code = huffmanDecodeSymbol(reader, &tree_cl);
       if(code <= 15) /*a length code*/
       {
         if(i < HLIT) bitlen_ll[i] = code;
@@ -1013,8 +1157,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 
         if(i == 0) ERROR_BREAK(54); /*can't repeat previous if i is 0*/
 
-        if((*bp + 2) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
-        replength += readBitsFromStream(bp, in, 2);
+        if((reader->bp + 2) > reader->bitsize) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
+        replength += readBits(reader, 2);
 
         if(i < HLIT + 1) value = bitlen_ll[i - 1];
         else value = bitlen_d[i - HLIT - 1];
@@ -1030,8 +1174,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
       else if(code == 17) /*repeat "0" 3-10 times*/
       {
         unsigned replength = 3; /*read in the bits that indicate repeat length*/
-        if((*bp + 3) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
-        replength += readBitsFromStream(bp, in, 3);
+        if((reader->bp + 3) > reader->bitsize) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
+        replength += readBits(reader, 3);
 
         /*repeat this value in the next lengths*/
         for(n = 0; n < replength; ++n)
@@ -1046,8 +1190,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
       else if(code == 18) /*repeat "0" 11-138 times*/
       {
         unsigned replength = 11; /*read in the bits that indicate repeat length*/
-        if((*bp + 7) > inbitlength) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
-        replength += readBitsFromStream(bp, in, 7);
+        if((reader->bp + 7) > reader->bitsize) ERROR_BREAK(50); /*error, bit pointer jumps past memory*/
+        replength += readBits(reader, 7);
 
         /*repeat this value in the next lengths*/
         for(n = 0; n < replength; ++n)
@@ -1065,7 +1209,7 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
         {
           /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
           (10=no endcode, 11=wrong jump outside of tree)*/
-          error = (*bp) > inbitlength ? 10 : 11;
+          error = reader->bp > reader->bitsize ? 10 : 11;
         }
         else error = 16; /*unexisting code, this can never happen*/
         break;
@@ -1091,29 +1235,73 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   return error;
 }
 
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len);
+
+/*
+Optional consumer of the output while it is inflated. Whenever the output reaches threshold
+bytes, consume gets what it hasn't had yet and uses a leading part of it. Only the unused rest
+and the 32768 bytes before it (the window that back references reach into) stay in the
+buffer, moved to its start, so the output buffer stays at about window + band bytes however
+long the stream is
+*/
+typedef struct InflateSink
+{
+  /*use the first *used of the size bytes at data; returns error code*/
+  unsigned (*consume)(void* context, const unsigned char* data, size_t size, size_t* used);
+  void* context;
+  size_t band; /*output bytes between calls to consume*/
+  size_t threshold; /*output position of the next call*/
+  size_t done; /*bytes at the start of the buffer consume has used, kept as window*/
+  unsigned adler; /*Adler-32 of all bytes consume has used*/
+} InflateSink;
+
+static unsigned inflateSinkFlush(ucvector* out, size_t* pos, InflateSink* sink)
+{
+  size_t used = 0, keep;
+  unsigned error = sink->consume(sink->context, &out->data[sink->done], *pos - sink->done, &used);
+  if(error) return error;
+  sink->adler = update_adler32(sink->adler, &out->data[sink->done], (unsigned)used);
+  sink->done += used;
+  keep = sink->done > 32768 ? sink->done - 32768 : 0; /*the first byte still needed*/
+  if(keep)
+  {
+    memmove(out->data, &out->data[keep], *pos - keep);
+    *pos -= keep;
+    sink->done -= keep;
+  }
+  out->size = *pos;
+  sink->threshold = *pos + sink->band;
+  return 0;
+}
+
 /*inflate a block with dynamic of fixed Huffman tree*/
-static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp,
-                                    size_t* pos, size_t inlength, unsigned btype)
+static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
+                                    size_t* pos, unsigned btype, InflateSink* sink)
 {
   unsigned error = 0;
   HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
   HuffmanTree tree_d; /*the huffman tree for distance codes*/
-  size_t inbitlength = inlength * 8;
 
   HuffmanTree_init(&tree_ll);
   HuffmanTree_init(&tree_d);
 
   if(btype == 1) getTreeInflateFixed(&tree_ll, &tree_d);
-  else if(btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, in, bp, inlength);
+  else if(btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, reader);
 
   while(!error) /*decode all symbols until end reached, breaks at end code*/
   {
     /*code_ll is literal, length or end code*/
-    unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
+    unsigned code_ll;
+    if(sink && *pos >= sink->threshold)
+    {
+      error = inflateSinkFlush(out, pos, sink);
+      if(error) break;
+    }
+    code_ll = huffmanDecodeSymbol(reader, &tree_ll);
     if(code_ll <= 255) /*literal symbol*/
     {
-      /*ucvector_push_back would do the same, but for some reason the two lines below run 10% faster*/
-      if(!ucvector_resize(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
+      /*out->size is only brought up to date at the end of the block*/
+      if((*pos) >= out->allocsize && !ucvector_reserve(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
       out->data[*pos] = (unsigned char)code_ll;
       ++(*pos);
     }
@@ -1121,25 +1309,26 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
     {
       unsigned code_d, distance;
       unsigned numextrabits_l, numextrabits_d; /*extra bits for length and distance*/
-      size_t start, forward, backward, length;
+      size_t start, copied, length;
+      unsigned char* dest;
 
       /*part 1: get length base*/
       length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX];
 
       /*part 2: get extra bits and add the value of that to length*/
       numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
-      if((*bp + numextrabits_l) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-      length += readBitsFromStream(bp, in, numextrabits_l);
+      if((reader->bp + numextrabits_l) > reader->bitsize) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
+      length += readBits(reader, numextrabits_l);
 
       /*part 3: get distance code*/
-      code_d = huffmanDecodeSymbol(in, bp, &tree_d, inbitlength);
+      code_d = huffmanDecodeSymbol(reader, &tree_d);
       if(code_d > 29)
       {
         if(code_ll == (unsigned)(-1)) /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
         {
           /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
           (10=no endcode, 11=wrong jump outside of tree)*/
-          error = (*bp) > inlength * 8 ? 10 : 11;
+          error = reader->bp > reader->bitsize ? 10 : 11;
         }
         else error = 18; /*error: invalid distance code (30-31 are never used)*/
         break;
@@ -1148,24 +1337,40 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 
       /*part 4: get extra bits from distance*/
       numextrabits_d = DISTANCEEXTRA[code_d];
-      if((*bp + numextrabits_d) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-      distance += readBitsFromStream(bp, in, numextrabits_d);
+      if((reader->bp + numextrabits_d) > reader->bitsize) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
+      distance += readBits(reader, numextrabits_d);
 
       /*part 5: fill in all the out[n] values based on the length and dist*/
       start = (*pos);
       if(distance > start) ERROR_BREAK(52); /*too long backward distance*/
-      backward = start - distance;
 
-      if(!ucvector_resize(out, (*pos) + length)) ERROR_BREAK(83 /*alloc fail*/);
-      if (distance < length) {
-        for(forward = 0; forward < length; ++forward)
+      if(start + length > out->allocsize && !ucvector_reserve(out, start + length)) ERROR_BREAK(83 /*alloc fail*/);
+      dest = out->data + start;
+      if(distance >= length)
+      {
+        memcpy(dest, dest - distance, length);
+      }
+      else if(distance == 1)
+      {
+        memset(dest, dest[-1], length);
+      }
+      else
+      {
+        /*
+        overlapping copy: the match repeats the last distance bytes. Copy them
+        once, then keep doubling the copied part, which stays a whole number of
+        repetitions, so every copy is a non-overlapping memcpy
+        */
+        memcpy(dest, dest - distance, distance);
+        copied = distance;
+        while(copied < length)
         {
-          out->data[(*pos)++] = out->data[backward++];
+          size_t chunk = copied < length - copied ? copied : length - copied;
+          memcpy(dest + copied, dest, chunk);
+          copied += chunk;
         }
-      } else {
-        memcpy(out->data + *pos, out->data + backward, length);
-        *pos += length;
       }
+      *pos += length;
     }
     else if(code_ll == 256)
     {
@@ -1175,25 +1380,29 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
     {
       /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
       (10=no endcode, 11=wrong jump outside of tree)*/
-      error = ((*bp) > inlength * 8) ? 10 : 11;
+      error = (reader->bp > reader->bitsize) ? 10 : 11;
       break;
     }
   }
 
+  out->size = *pos;
+
   HuffmanTree_cleanup(&tree_ll);
   HuffmanTree_cleanup(&tree_d);
 
   return error;
 }
 
-static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength)
+static unsigned inflateNoCompression(ucvector* out, LodePNGBitReader* reader, size_t* pos)
 {
+  const unsigned char* in = reader->data;
+  size_t inlength = reader->size;
   size_t p;
   unsigned LEN, NLEN, n, error = 0;
 
   /*go to first boundary of byte*/
-  while(((*bp) & 0x7) != 0) ++(*bp);
-  p = (*bp) / 8; /*byte position*/
+  alignToByte(reader);
+  p = reader->bp / 8; /*byte position*/
 
   /*read LEN (2 bytes) and NLEN (2 bytes)*/
   if(p + 4 >= inlength) return 52; /*error, bit pointer will jump past memory*/
@@ -1209,41 +1418,57 @@ static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, siz
   if(p + LEN > inlength) return 23; /*error: reading outside of in buffer*/
   for(n = 0; n < LEN; ++n) out->data[(*pos)++] = in[p++];
 
-  (*bp) = p * 8;
+  reader->bp = p * 8;
+  reader->bufferbits = 0;
 
   return error;
 }
 
-static unsigned lodepng_inflatev(ucvector* out,
-                                 const unsigned char* in, size_t insize,
-                                 const LodePNGDecompressSettings* settings)
+/*inflate into out, handing the output to sink as it goes if sink isn't null*/
+static unsigned inflateStream(ucvector* out,
+                              const unsigned char* in, size_t insize,
+                              const LodePNGDecompressSettings* settings, InflateSink* sink)
 {
-  /*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)*/
-  size_t bp = 0;
+  LodePNGBitReader reader;
   unsigned BFINAL = 0;
   size_t pos = 0; /*byte position in the out buffer*/
   unsigned error = 0;
 
-  (void)settings;
+  LodePNGBitReader_init(&reader, in, insize);
+  /*allocate the whole output once when its size is known*/
+  if(settings->expected_output_size && !ucvector_reserve(out, out->size + settings->expected_output_size))
+  {
+    return 83; /*alloc fail*/
+  }
 
   while(!BFINAL)
   {
     unsigned BTYPE;
-    if(bp + 2 >= insize * 8) return 52; /*error, bit pointer will jump past memory*/
-    BFINAL = readBitFromStream(&bp, in);
-    BTYPE = 1u * readBitFromStream(&bp, in);
-    BTYPE += 2u * readBitFromStream(&bp, in);
+    if(reader.bp + 2 >= reader.bitsize) return 52; /*error, bit pointer will jump past memory*/
+    BFINAL = readBits(&reader, 1);
+    BTYPE = readBits(&reader, 2);
 
     if(BTYPE == 3) return 20; /*error: invalid BTYPE*/
-    else if(BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize); /*no compression*/
-    else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE); /*compression, BTYPE 01 or 10*/
+    else if(BTYPE == 0) error = inflateNoCompression(out, &reader, &pos); /*no compression*/
+    else error = inflateHuffmanBlock(out, &reader, &pos, BTYPE, sink); /*compression, BTYPE 01 or 10*/
 
+    if(!error && sink && pos >= sink->threshold) error = inflateSinkFlush(out, &pos, sink);
     if(error) return error;
   }
 
+  /*the rest of the output*/
+  if(sink) error = inflateSinkFlush(out, &pos, sink);
+
   return error;
 }
 
+static unsigned lodepng_inflatev(ucvector* out,
+                                 const unsigned char* in, size_t insize,
+                                 const LodePNGDecompressSettings* settings)
+{
+  return inflateStream(out, in, insize, settings, 0);
+}
+
 unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGDecompressSettings* settings)
@@ -1437,12 +1662,10 @@ this hash technique is one out of several ways to speed this up.
 */
 static unsigned encodeLZ77(uivector* out, Hash* hash,
                            const unsigned char* in, size_t inpos, size_t insize, unsigned windowsize,
-                           unsigned minmatch, unsigned nicematch, unsigned lazymatching)
+                           unsigned minmatch, unsigned nicematch, unsigned lazymatching, unsigned maxchainlength)
 {
   size_t pos;
   unsigned i, error = 0;
-  /*for large window lengths, assume the user wants no compression loss. Otherwise, max hash chain length speedup.*/
-  unsigned maxchainlength = windowsize >= 8192 ? windowsize : windowsize / 8;
   unsigned maxlazymatch = windowsize >= 8192 ? MAX_SUPPORTED_DEFLATE_LENGTH : 64;
 
   unsigned usezeros = 1; /*not sure if setting it to false for windowsize < 8192 is better or worse*/
@@ -1462,6 +1685,9 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
   if((windowsize & (windowsize - 1)) != 0) return 90; /*error: must be power of two*/
 
   if(nicematch > MAX_SUPPORTED_DEFLATE_LENGTH) nicematch = MAX_SUPPORTED_DEFLATE_LENGTH;
+  /*unless given, for large window lengths, assume the user wants no compression loss. Otherwise,
+  max hash chain length speedup.*/
+  if(maxchainlength == 0) maxchainlength = windowsize >= 8192 ? windowsize : windowsize / 8;
 
   for(pos = inpos; pos < insize; ++pos)
   {
@@ -1614,7 +1840,7 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
 
 /* /////////////////////////////////////////////////////////////////////////// */
 
-static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize)
+static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize, unsigned final)
 {
   /*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
   2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
@@ -1626,7 +1852,7 @@ static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, s
     unsigned BFINAL, BTYPE, LEN, NLEN;
     unsigned char firstbyte;
 
-    BFINAL = (i == numdeflateblocks - 1);
+    BFINAL = final && (i == numdeflateblocks - 1);
     BTYPE = 0;
 
     firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1) << 1) + ((BTYPE & 2) << 1));
@@ -1747,7 +1973,7 @@ static unsigned deflateDynamic(ucvector* out, size_t* bp, Hash* hash,
     if(settings->use_lz77)
     {
       error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-                         settings->minmatch, settings->nicematch, settings->lazymatching);
+                         settings->minmatch, settings->nicematch, settings->lazymatching, settings->maxchainlength);
       if(error) break;
     }
     else
@@ -1957,7 +2183,7 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
     uivector lz77_encoded;
     uivector_init(&lz77_encoded);
     error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-                       settings->minmatch, settings->nicematch, settings->lazymatching);
+                       settings->minmatch, settings->nicematch, settings->lazymatching, settings->maxchainlength);
     if(!error) writeLZ77data(bp, out, &lz77_encoded, &tree_ll, &tree_d);
     uivector_cleanup(&lz77_encoded);
   }
@@ -1978,8 +2204,13 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
   return error;
 }
 
-static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-                                 const LodePNGCompressSettings* settings)
+/*
+deflate in as blocks appended to out. Unless final, the last block isn't marked as such and
+the data ends on a byte boundary with an empty stored block, as zlib's Z_SYNC_FLUSH does,
+so that out can be continued with the deflate data of what follows in.
+*/
+static unsigned deflateRange(ucvector* out, const unsigned char* in, size_t insize,
+                             const LodePNGCompressSettings* settings, unsigned final)
 {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
@@ -1987,7 +2218,7 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
   Hash hash;
 
   if(settings->btype > 2) return 61;
-  else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
+  else if(settings->btype == 0) return deflateNoCompression(out, in, insize, final);
   else if(settings->btype == 1) blocksize = insize;
   else /*if(settings->btype == 2)*/
   {
@@ -2005,13 +2236,23 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 
   for(i = 0; i != numdeflateblocks && !error; ++i)
   {
-    unsigned final = (i == numdeflateblocks - 1);
+    unsigned last = final && (i == numdeflateblocks - 1);
     size_t start = i * blocksize;
     size_t end = start + blocksize;
     if(end > insize) end = insize;
 
-    if(settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, final);
-    else if(settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final);
+    if(settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, last);
+    else if(settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, last);
+  }
+
+  if(!error && !final)
+  {
+    /*BFINAL 0 and BTYPE 00, padding to the byte, LEN 0 and NLEN 65535*/
+    addBitsToStream(&bp, out, 0, 3);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 255);
+    ucvector_push_back(out, 255);
   }
 
   hash_cleanup(&hash);
@@ -2019,6 +2260,12 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
   return error;
 }
 
+static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
+                                 const LodePNGCompressSettings* settings)
+{
+  return deflateRange(out, in, insize, settings, 1);
+}
+
 unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings)
@@ -2052,16 +2299,57 @@ static unsigned deflate(unsigned char** out, size_t* outsize,
 /* / Adler32                                                                  */
 /* ////////////////////////////////////////////////////////////////////////// */
 
+#ifdef LODEPNG_SSE2
+/*
+Adds the len / 16 whole 16-byte blocks of data to the sums, which must not
+overflow over them, and returns how many bytes that was. Per block, s2 gains
+16 times s1 from before it plus the block's bytes weighted 16 down to 1
+*/
+static unsigned adler32BlocksSSE2(unsigned* s1, unsigned* s2, const unsigned char* data, unsigned len)
+{
+  unsigned blocks = len / 16, i;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i weights_lo = _mm_set_epi16(9, 10, 11, 12, 13, 14, 15, 16);
+  const __m128i weights_hi = _mm_set_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+  __m128i sum = zero; /*the blocks' bytes*/
+  __m128i prefix = zero; /*sum as it was before each block, summed*/
+  __m128i weighted = zero;
+  unsigned lanes[4];
+  for(i = 0; i != blocks; ++i)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)&data[i * 16]);
+    prefix = _mm_add_epi32(prefix, sum);
+    sum = _mm_add_epi32(sum, _mm_sad_epu8(v, zero));
+    weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights_lo));
+    weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights_hi));
+  }
+  weighted = _mm_add_epi32(weighted, _mm_slli_epi32(prefix, 4));
+  *s2 += *s1 * (blocks * 16);
+  _mm_storeu_si128((__m128i*)lanes, weighted);
+  *s2 += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm_storeu_si128((__m128i*)lanes, sum);
+  *s1 += lanes[0] + lanes[2]; /*_mm_sad_epu8 leaves its sums in the low half of each 64 bits*/
+  return blocks * 16;
+}
+#endif /*LODEPNG_SSE2*/
+
 static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len)
 {
-   unsigned s1 = adler & 0xffff;
-   unsigned s2 = (adler >> 16) & 0xffff;
+  unsigned s1 = adler & 0xffff;
+  unsigned s2 = (adler >> 16) & 0xffff;
 
   while(len > 0)
   {
-    /*at least 5550 sums can be done before the sums overflow, saving a lot of module divisions*/
-    unsigned amount = len > 5550 ? 5550 : len;
+    /*at most 5552 bytes can be summed before s2 could overflow, saving a lot of module divisions*/
+    unsigned amount = len > 5552 ? 5552 : len;
     len -= amount;
+#ifdef LODEPNG_SSE2
+    {
+      unsigned done = adler32BlocksSSE2(&s1, &s2, data, amount);
+      data += done;
+      amount -= done;
+    }
+#endif /*LODEPNG_SSE2*/
     while(amount > 0)
     {
       s1 += (*data++);
@@ -2087,10 +2375,9 @@ static unsigned adler32(const unsigned char* data, unsigned len)
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-                                 size_t insize, const LodePNGDecompressSettings* settings)
+/*check the 2-byte zlib header, returns error code*/
+static unsigned zlib_check_header(const unsigned char* in, size_t insize)
 {
-  unsigned error = 0;
   unsigned CM, CINFO, FDICT;
 
   if(insize < 2) return 53; /*error, size of zlib data too small*/
@@ -2119,6 +2406,15 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
     return 26;
   }
 
+  return 0;
+}
+
+unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                 size_t insize, const LodePNGDecompressSettings* settings)
+{
+  unsigned error = zlib_check_header(in, insize);
+  if(error) return error;
+
   error = inflate(out, outsize, in + 2, insize - 2, settings);
   if(error) return error;
 
@@ -2145,10 +2441,52 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsi
   }
 }
 
+/*decompress a zlib stream with the built in inflator into sink, which gets all the output.
+The custom functions of settings are not used*/
+static unsigned zlib_decompress_stream(const unsigned char* in, size_t insize,
+                                       const LodePNGDecompressSettings* settings, InflateSink* sink)
+{
+  ucvector out;
+  unsigned error = zlib_check_header(in, insize);
+  if(error) return error;
+
+  ucvector_init(&out);
+  sink->threshold = sink->band;
+  sink->done = 0;
+  sink->adler = 1;
+  error = inflateStream(&out, in + 2, insize - 2, settings, sink);
+  ucvector_cleanup(&out);
+  if(error) return error;
+
+  if(!settings->ignore_adler32)
+  {
+    unsigned ADLER32 = lodepng_read32bitInt(&in[insize - 4]);
+    if(sink->adler != ADLER32) return 58; /*error, adler checksum not correct, data must be corrupted*/
+  }
+
+  return 0; /*no error*/
+}
+
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
 
+/*Return the adler32 of two byte ranges one after the other, given the adler32 of each and the
+length of the second*/
+static unsigned adler32_combine(unsigned adler1, unsigned adler2, size_t len2)
+{
+  unsigned rem = (unsigned)(len2 % 65521);
+  unsigned s1 = adler1 & 0xffff;
+  unsigned s2 = (rem * s1) % 65521; /*the first sum of the first range, counted len2 more times*/
+  s1 += (adler2 & 0xffff) + 65521 - 1;
+  s2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + 65521 - rem;
+  if(s1 >= 65521) s1 -= 65521;
+  if(s1 >= 65521) s1 -= 65521;
+  if(s2 >= 65521 * 2) s2 -= 65521 * 2;
+  if(s2 >= 65521) s2 -= 65521;
+  return (s2 << 16) | s1;
+}
+
 unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
                                size_t insize, const LodePNGCompressSettings* settings)
 {
@@ -2243,13 +2581,14 @@ void lodepng_compress_settings_init(LodePNGCompressSettings* settings)
   settings->minmatch = 3;
   settings->nicematch = 128;
   settings->lazymatching = 1;
+  settings->maxchainlength = 0;
 
   settings->custom_zlib = 0;
   settings->custom_deflate = 0;
   settings->custom_context = 0;
 }
 
-const LodePNGCompressSettings lodepng_default_compress_settings = {2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0};
+const LodePNGCompressSettings lodepng_default_compress_settings = {2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0, 0};
 
 
 #endif /*LODEPNG_COMPILE_ENCODER*/
@@ -2259,13 +2598,14 @@ const LodePNGCompressSettings lodepng_default_compress_settings = {2, 1, DEFAULT
 void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings)
 {
   settings->ignore_adler32 = 0;
+  settings->expected_output_size = 0;
 
   settings->custom_zlib = 0;
   settings->custom_inflate = 0;
   settings->custom_context = 0;
 }
 
-const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0};
+const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0, 0};
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -2284,49 +2624,303 @@ const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0,
 
 #ifndef LODEPNG_NO_COMPILE_CRC
 /* CRC polynomial: 0xedb88320 */
-static unsigned lodepng_crc32_table[256] = {
-           0u, 1996959894u, 3993919788u, 2567524794u,  124634137u, 1886057615u, 3915621685u, 2657392035u,
-   249268274u, 2044508324u, 3772115230u, 2547177864u,  162941995u, 2125561021u, 3887607047u, 2428444049u,
-   498536548u, 1789927666u, 4089016648u, 2227061214u,  450548861u, 1843258603u, 4107580753u, 2211677639u,
-   325883990u, 1684777152u, 4251122042u, 2321926636u,  335633487u, 1661365465u, 4195302755u, 2366115317u,
-   997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
-   901097722u, 1119000684u, 3686517206u, 2898065728u,  853044451u, 1172266101u, 3705015759u, 2882616665u,
-   651767980u, 1373503546u, 3369554304u, 3218104598u,  565507253u, 1454621731u, 3485111705u, 3099436303u,
-   671266974u, 1594198024u, 3322730930u, 2970347812u,  795835527u, 1483230225u, 3244367275u, 3060149565u,
-  1994146192u,   31158534u, 2563907772u, 4023717930u, 1907459465u,  112637215u, 2680153253u, 3904427059u,
-  2013776290u,  251722036u, 2517215374u, 3775830040u, 2137656763u,  141376813u, 2439277719u, 3865271297u,
-  1802195444u,  476864866u, 2238001368u, 4066508878u, 1812370925u,  453092731u, 2181625025u, 4111451223u,
-  1706088902u,  314042704u, 2344532202u, 4240017532u, 1658658271u,  366619977u, 2362670323u, 4224994405u,
-  1303535960u,  984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
-  1131014506u,  879679996u, 2909243462u, 3663771856u, 1141124467u,  855842277u, 2852801631u, 3708648649u,
-  1342533948u,  654459306u, 3188396048u, 3373015174u, 1466479909u,  544179635u, 3110523913u, 3462522015u,
-  1591671054u,  702138776u, 2966460450u, 3352799412u, 1504918807u,  783551873u, 3082640443u, 3233442989u,
-  3988292384u, 2596254646u,   62317068u, 1957810842u, 3939845945u, 2647816111u,   81470997u, 1943803523u,
-  3814918930u, 2489596804u,  225274430u, 2053790376u, 3826175755u, 2466906013u,  167816743u, 2097651377u,
-  4027552580u, 2265490386u,  503444072u, 1762050814u, 4150417245u, 2154129355u,  426522225u, 1852507879u,
-  4275313526u, 2312317920u,  282753626u, 1742555852u, 4189708143u, 2394877945u,  397917763u, 1622183637u,
-  3604390888u, 2714866558u,  953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
-  3624741850u, 2936675148u,  906185462u, 1090812512u, 3747672003u, 2825379669u,  829329135u, 1181335161u,
-  3412177804u, 3160834842u,  628085408u, 1382605366u, 3423369109u, 3138078467u,  570562233u, 1426400815u,
-  3317316542u, 2998733608u,  733239954u, 1555261956u, 3268935591u, 3050360625u,  752459403u, 1541320221u,
-  2607071920u, 3965973030u, 1969922972u,   40735498u, 2617837225u, 3943577151u, 1913087877u,   83908371u,
-  2512341634u, 3803740692u, 2075208622u,  213261112u, 2463272603u, 3855990285u, 2094854071u,  198958881u,
-  2262029012u, 4057260610u, 1759359992u,  534414190u, 2176718541u, 4139329115u, 1873836001u,  414664567u,
-  2282248934u, 4279200368u, 1711684554u,  285281116u, 2405801727u, 4167216745u, 1634467795u,  376229701u,
-  2685067896u, 3608007406u, 1308918612u,  956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
-  2932959818u, 3654703836u, 1088359270u,  936918000u, 2847714899u, 3736837829u, 1202900863u,  817233897u,
-  3183342108u, 3401237130u, 1404277552u,  615818150u, 3134207493u, 3453421203u, 1423857449u,  601450431u,
-  3009837614u, 3294710456u, 1567103746u,  711928724u, 3020668471u, 3272380065u, 1510334235u,  755167117u
+/*table[0] is the byte-at-a-time table. table[k][n] is the CRC of byte n followed by
+k zero bytes, which lets slicing-by-8 fold eight bytes per step with eight lookups*/
+static unsigned lodepng_crc32_table[8][256] = {
+  {
+             0u, 1996959894u, 3993919788u, 2567524794u,  124634137u, 1886057615u, 3915621685u, 2657392035u,
+     249268274u, 2044508324u, 3772115230u, 2547177864u,  162941995u, 2125561021u, 3887607047u, 2428444049u,
+     498536548u, 1789927666u, 4089016648u, 2227061214u,  450548861u, 1843258603u, 4107580753u, 2211677639u,
+     325883990u, 1684777152u, 4251122042u, 2321926636u,  335633487u, 1661365465u, 4195302755u, 2366115317u,
+     997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
+     901097722u, 1119000684u, 3686517206u, 2898065728u,  853044451u, 1172266101u, 3705015759u, 2882616665u,
+     651767980u, 1373503546u, 3369554304u, 3218104598u,  565507253u, 1454621731u, 3485111705u, 3099436303u,
+     671266974u, 1594198024u, 3322730930u, 2970347812u,  795835527u, 1483230225u, 3244367275u, 3060149565u,
+    1994146192u,   31158534u, 2563907772u, 4023717930u, 1907459465u,  112637215u, 2680153253u, 3904427059u,
+    2013776290u,  251722036u, 2517215374u, 3775830040u, 2137656763u,  141376813u, 2439277719u, 3865271297u,
+    1802195444u,  476864866u, 2238001368u, 4066508878u, 1812370925u,  453092731u, 2181625025u, 4111451223u,
+    1706088902u,  314042704u, 2344532202u, 4240017532u, 1658658271u,  366619977u, 2362670323u, 4224994405u,
+    1303535960u,  984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
+    1131014506u,  879679996u, 2909243462u, 3663771856u, 1141124467u,  855842277u, 2852801631u, 3708648649u,
+    1342533948u,  654459306u, 3188396048u, 3373015174u, 1466479909u,  544179635u, 3110523913u, 3462522015u,
+    1591671054u,  702138776u, 2966460450u, 3352799412u, 1504918807u,  783551873u, 3082640443u, 3233442989u,
+    3988292384u, 2596254646u,   62317068u, 1957810842u, 3939845945u, 2647816111u,   81470997u, 1943803523u,
+    3814918930u, 2489596804u,  225274430u, 2053790376u, 3826175755u, 2466906013u,  167816743u, 2097651377u,
+    4027552580u, 2265490386u,  503444072u, 1762050814u, 4150417245u, 2154129355u,  426522225u, 1852507879u,
+    4275313526u, 2312317920u,  282753626u, 1742555852u, 4189708143u, 2394877945u,  397917763u, 1622183637u,
+    3604390888u, 2714866558u,  953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
+    3624741850u, 2936675148u,  906185462u, 1090812512u, 3747672003u, 2825379669u,  829329135u, 1181335161u,
+    3412177804u, 3160834842u,  628085408u, 1382605366u, 3423369109u, 3138078467u,  570562233u, 1426400815u,
+    3317316542u, 2998733608u,  733239954u, 1555261956u, 3268935591u, 3050360625u,  752459403u, 1541320221u,
+    2607071920u, 3965973030u, 1969922972u,   40735498u, 2617837225u, 3943577151u, 1913087877u,   83908371u,
+    2512341634u, 3803740692u, 2075208622u,  213261112u, 2463272603u, 3855990285u, 2094854071u,  198958881u,
+    2262029012u, 4057260610u, 1759359992u,  534414190u, 2176718541u, 4139329115u, 1873836001u,  414664567u,
+    2282248934u, 4279200368u, 1711684554u,  285281116u, 2405801727u, 4167216745u, 1634467795u,  376229701u,
+    2685067896u, 3608007406u, 1308918612u,  956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
+    2932959818u, 3654703836u, 1088359270u,  936918000u, 2847714899u, 3736837829u, 1202900863u,  817233897u,
+    3183342108u, 3401237130u, 1404277552u,  615818150u, 3134207493u, 3453421203u, 1423857449u,  601450431u,
+    3009837614u, 3294710456u, 1567103746u,  711928724u, 3020668471u, 3272380065u, 1510334235u,  755167117u
+  },
+  {
+             0u,  421212481u,  842424962u,  724390851u, 1684849924u, 2105013317u, 1448781702u, 1329698503u,
+    3369699848u, 3519200073u, 4210026634u, 3824474571u, 2897563404u, 3048111693u, 2659397006u, 2274893007u,
+    1254232657u, 1406739216u, 2029285587u, 1643069842u,  783210325u,  934667796u,  479770071u,   92505238u,
+    2182846553u, 2600511768u, 2955803355u, 2838940570u, 3866582365u, 4285295644u, 3561045983u, 3445231262u,
+    2508465314u, 2359236067u, 2813478432u, 3198777185u, 4058571174u, 3908292839u, 3286139684u, 3670389349u,
+    1566420650u, 1145479147u, 1869335592u, 1987116393u,  959540142u,  539646703u,  185010476u,  303839341u,
+    3745920755u, 3327985586u, 3983561841u, 4100678960u, 3140154359u, 2721170102u, 2300350837u, 2416418868u,
+     396344571u,  243568058u,  631889529u, 1018359608u, 1945336319u, 1793607870u, 1103436669u, 1490954812u,
+    4034481925u, 3915546180u, 3259968903u, 3679722694u, 2484439553u, 2366552896u, 2787371139u, 3208174018u,
+     950060301u,  565965900u,  177645455u,  328046286u, 1556873225u, 1171730760u, 1861902987u, 2011255754u,
+    3132841300u, 2745199637u, 2290958294u, 2442530455u, 3738671184u, 3352078609u, 3974232786u, 4126854035u,
+    1919080284u, 1803150877u, 1079293406u, 1498383519u,  370020952u,  253043481u,  607678682u, 1025720731u,
+    1711106983u, 2095471334u, 1472923941u, 1322268772u,   26324643u,  411738082u,  866634785u,  717028704u,
+    2904875439u, 3024081134u, 2668790573u, 2248782444u, 3376948395u, 3495106026u, 4219356713u, 3798300520u,
+     792689142u,  908347575u,  487136116u,   68299317u, 1263779058u, 1380486579u, 2036719216u, 1618931505u,
+    3890672638u, 4278043327u, 3587215740u, 3435896893u, 2206873338u, 2593195963u, 2981909624u, 2829542713u,
+     998479947u,  580430090u,  162921161u,  279890824u, 1609522511u, 1190423566u, 1842954189u, 1958874764u,
+    4082766403u, 3930137346u, 3245109441u, 3631694208u, 2536953671u, 2385372678u, 2768287173u, 3155920004u,
+    1900120602u, 1750776667u, 1131931800u, 1517083097u,  355290910u,  204897887u,  656092572u, 1040194781u,
+    3113746450u, 2692952403u, 2343461520u, 2461357009u, 3723805974u, 3304059991u, 4022511508u, 4141455061u,
+    2919742697u, 3072101800u, 2620513899u, 2234183466u, 3396041197u, 3547351212u, 4166851439u, 3779471918u,
+    1725839073u, 2143618976u, 1424512099u, 1307796770u,   45282277u,  464110244u,  813994343u,  698327078u,
+    3838160568u, 4259225593u, 3606301754u, 3488152955u, 2158586812u, 2578602749u, 2996767038u, 2877569151u,
+     740041904u,  889656817u,  506086962u,  120682355u, 1215357364u, 1366020341u, 2051441462u, 1667084919u,
+    3422213966u, 3538019855u, 4190942668u, 3772220557u, 2945847882u, 3062702859u, 2644537544u, 2226864521u,
+      52649286u,  439905287u,  823476164u,  672009861u, 1733269570u, 2119477507u, 1434057408u, 1281543041u,
+    2167981343u, 2552493150u, 3004082077u, 2853541596u, 3847487515u, 4233048410u, 3613549209u, 3464057816u,
+    1239502615u, 1358593622u, 2077699477u, 1657543892u,  764250643u,  882293586u,  532408465u,  111204816u,
+    1585378284u, 1197851309u, 1816695150u, 1968414767u,  974272232u,  587794345u,  136598634u,  289367339u,
+    2527558116u, 2411481253u, 2760973158u, 3179948583u, 4073438432u, 3956313505u, 3237863010u, 3655790371u,
+     347922877u,  229101820u,  646611775u, 1066513022u, 1892689081u, 1774917112u, 1122387515u, 1543337850u,
+    3697634229u, 3313392372u, 3998419255u, 4148705398u, 3087642289u, 2702352368u, 2319436851u, 2468674930u
+  },
+  {
+             0u,   29518391u,   59036782u,   38190681u,  118073564u,  114017003u,   76381362u,   89069189u,
+     236147128u,  265370511u,  228034006u,  206958561u,  152762724u,  148411219u,  178138378u,  190596925u,
+     472294256u,  501532999u,  530741022u,  509615401u,  456068012u,  451764635u,  413917122u,  426358261u,
+     305525448u,  334993663u,  296822438u,  275991697u,  356276756u,  352202787u,  381193850u,  393929805u,
+     944588512u,  965684439u, 1003065998u,  973863097u, 1061482044u, 1049003019u, 1019230802u, 1023561829u,
+     912136024u,  933002607u,  903529270u,  874031361u,  827834244u,  815125939u,  852716522u,  856752605u,
+     611050896u,  631869351u,  669987326u,  640506825u,  593644876u,  580921211u,  551983394u,  556069653u,
+     712553512u,  733666847u,  704405574u,  675154545u,  762387700u,  749958851u,  787859610u,  792175277u,
+    1889177024u, 1901651959u, 1931368878u, 1927033753u, 2006131996u, 1985040171u, 1947726194u, 1976933189u,
+    2122964088u, 2135668303u, 2098006038u, 2093965857u, 2038461604u, 2017599123u, 2047123658u, 2076625661u,
+    1824272048u, 1836991623u, 1866005214u, 1861914857u, 1807058540u, 1786244187u, 1748062722u, 1777547317u,
+    1655668488u, 1668093247u, 1630251878u, 1625932113u, 1705433044u, 1684323811u, 1713505210u, 1742760333u,
+    1222101792u, 1226154263u, 1263738702u, 1251046777u, 1339974652u, 1310460363u, 1281013650u, 1301863845u,
+    1187289752u, 1191637167u, 1161842422u, 1149379777u, 1103966788u, 1074747507u, 1112139306u, 1133218845u,
+    1425107024u, 1429406311u, 1467333694u, 1454888457u, 1408811148u, 1379576507u, 1350309090u, 1371438805u,
+    1524775400u, 1528845279u, 1499917702u, 1487177649u, 1575719220u, 1546255107u, 1584350554u, 1605185389u,
+    3778354048u, 3774312887u, 3803303918u, 3816007129u, 3862737756u, 3892238699u, 3854067506u, 3833203973u,
+    4012263992u, 4007927823u, 3970080342u, 3982554209u, 3895452388u, 3924658387u, 3953866378u, 3932773565u,
+    4245928176u, 4241609415u, 4271336606u, 4283762345u, 4196012076u, 4225268251u, 4187931714u, 4166823541u,
+    4076923208u, 4072833919u, 4035198246u, 4047918865u, 4094247316u, 4123732899u, 4153251322u, 4132437965u,
+    3648544096u, 3636082519u, 3673983246u, 3678331705u, 3732010428u, 3753090955u, 3723829714u, 3694611429u,
+    3614117080u, 3601426159u, 3572488374u, 3576541825u, 3496125444u, 3516976691u, 3555094634u, 3525581405u,
+    3311336976u, 3298595879u, 3336186494u, 3340255305u, 3260503756u, 3281337595u, 3251864226u, 3222399125u,
+    3410866088u, 3398419871u, 3368647622u, 3372945905u, 3427010420u, 3448139075u, 3485520666u, 3456284973u,
+    2444203584u, 2423127159u, 2452308526u, 2481530905u, 2527477404u, 2539934891u, 2502093554u, 2497740997u,
+    2679949304u, 2659102159u, 2620920726u, 2650438049u, 2562027300u, 2574714131u, 2603727690u, 2599670141u,
+    2374579504u, 2353749767u, 2383274334u, 2412743529u, 2323684844u, 2336421851u, 2298759554u, 2294686645u,
+    2207933576u, 2186809023u, 2149495014u, 2178734801u, 2224278612u, 2236720739u, 2266437690u, 2262135309u,
+    2850214048u, 2820717207u, 2858812622u, 2879680249u, 2934667388u, 2938704459u, 2909776914u, 2897069605u,
+    2817622296u, 2788420399u, 2759153014u, 2780249921u, 2700618180u, 2704950259u, 2742877610u, 2730399645u,
+    3049550800u, 3020298727u, 3057690558u, 3078802825u, 2999835404u, 3004150075u, 2974355298u, 2961925461u,
+    3151438440u, 3121956959u, 3092510214u, 3113327665u, 3168701108u, 3172786307u, 3210370778u, 3197646061u
+  },
+  {
+             0u, 3099354981u, 2852767883u,  313896942u, 2405603159u,  937357362u,  627793884u, 2648127673u,
+    3316918511u, 2097696650u, 1874714724u, 3607201537u, 1255587768u, 4067088605u, 3772741427u, 1482887254u,
+    1343838111u, 3903140090u, 4195393300u, 1118632049u, 3749429448u, 1741137837u, 1970407491u, 3452858150u,
+    2511175536u,  756094997u, 1067759611u, 2266550430u,  449832999u, 2725482306u, 2965774508u,  142231497u,
+    2687676222u,  412010587u,  171665333u, 2995192016u,  793786473u, 2548850444u, 2237264098u, 1038456711u,
+    1703315409u, 3711623348u, 3482275674u, 1999841343u, 3940814982u, 1381529571u, 1089329165u, 4166106984u,
+    4029413537u, 1217896388u, 1512189994u, 3802027855u, 2135519222u, 3354724499u, 3577784189u, 1845280792u,
+     899665998u, 2367928107u, 2677414085u,  657096608u, 3137160985u,   37822588u,  284462994u, 2823350519u,
+    2601801789u,  598228824u,  824021174u, 2309093331u,  343330666u, 2898962447u, 3195996129u,  113467524u,
+    1587572946u, 3860600759u, 4104763481u, 1276501820u, 3519211397u, 1769898208u, 2076913422u, 3279374443u,
+    3406630818u, 1941006535u, 1627703081u, 3652755532u, 1148164341u, 4241751952u, 3999682686u, 1457141531u,
+     247015245u, 3053797416u, 2763059142u,  470583459u, 2178658330u,  963106687u,  735213713u, 2473467892u,
+     992409347u, 2207944806u, 2435792776u,  697522413u, 3024379988u,  217581361u,  508405983u, 2800865210u,
+    4271038444u, 1177467017u, 1419450215u, 3962007554u, 1911572667u, 3377213406u, 3690561584u, 1665525589u,
+    1799331996u, 3548628985u, 3241568279u, 2039091058u, 3831314379u, 1558270126u, 1314193216u, 4142438437u,
+    2928380019u,  372764438u,   75645176u, 3158189981u,  568925988u, 2572515393u, 2346768303u,  861712586u,
+    3982079547u, 1441124702u, 1196457648u, 4293663189u, 1648042348u, 3666298377u, 3358779879u, 1888390786u,
+     686661332u, 2421291441u, 2196002399u,  978858298u, 2811169155u,  523464422u,  226935048u, 3040519789u,
+    3175145892u,  100435649u,  390670639u, 2952089162u,  841119475u, 2325614998u, 2553003640u,  546822429u,
+    2029308235u, 3225988654u, 3539796416u, 1782671013u, 4153826844u, 1328167289u, 1570739863u, 3844338162u,
+    1298864389u, 4124540512u, 3882013070u, 1608431339u, 3255406162u, 2058742071u, 1744848601u, 3501990332u,
+    2296328682u,  811816591u,  584513889u, 2590678532u,  129869501u, 3204563416u, 2914283062u,  352848211u,
+     494030490u, 2781751807u, 3078325777u,  264757620u, 2450577869u,  715964072u,  941166918u, 2158327331u,
+    3636881013u, 1618608400u, 1926213374u, 3396585883u, 1470427426u, 4011365959u, 4255988137u, 1158766284u,
+    1984818694u, 3471935843u, 3695453837u, 1693991400u, 4180638033u, 1100160564u, 1395044826u, 3952793279u,
+    3019491049u,  189112716u,  435162722u, 2706139399u, 1016811966u, 2217162459u, 2526189877u,  774831696u,
+     643086745u, 2666061564u, 2354934034u,  887166583u, 2838900430u,  294275499u,   54519365u, 3145957664u,
+    3823145334u, 1532818963u, 1240029693u, 4048895640u, 1820460577u, 3560857924u, 3331051178u, 2117577167u,
+    3598663992u, 1858283101u, 2088143283u, 3301633750u, 1495127663u, 3785470218u, 4078182116u, 1269332353u,
+     332098007u, 2876706482u, 3116540252u,   25085497u, 2628386432u,  605395429u,  916469259u, 2384220526u,
+    2254837415u, 1054503362u,  745528876u, 2496903497u,  151290352u, 2981684885u, 2735556987u,  464596510u,
+    1137851976u, 4218313005u, 3923506883u, 1365741990u, 3434129695u, 1946996346u, 1723425172u, 3724871409u
+  },
+  {
+             0u, 1029712304u, 2059424608u, 1201699536u, 4118849216u, 3370159984u, 2403399072u, 2988497936u,
+     812665793u,  219177585u, 1253054625u, 2010132753u, 3320900865u, 4170237105u, 3207642721u, 2186319825u,
+    1625331586u, 1568718386u,  438355170u,  658566482u, 2506109250u, 2818578674u, 4020265506u, 3535817618u,
+    1351670851u, 1844508147u,  709922595u,  389064339u, 2769320579u, 2557498163u, 3754961379u, 3803185235u,
+    3250663172u, 4238411444u, 3137436772u, 2254525908u,  876710340u,  153198708u, 1317132964u, 1944187668u,
+    4054934725u, 3436268917u, 2339452837u, 3054575125u,   70369797u,  961670069u, 2129760613u, 1133623509u,
+    2703341702u, 2621542710u, 3689016294u, 3867263574u, 1419845190u, 1774270454u,  778128678u,  318858390u,
+    2438067015u, 2888948471u, 3952189479u, 3606153623u, 1691440519u, 1504803895u,  504432359u,  594620247u,
+    1492342857u, 1704161785u,  573770537u,  525542041u, 2910060169u, 2417219385u, 3618876905u, 3939730521u,
+    1753420680u, 1440954936u,  306397416u,  790849880u, 2634265928u, 2690882808u, 3888375336u, 3668168600u,
+     940822475u,   91481723u, 1121164459u, 2142483739u, 3448989963u, 4042473659u, 3075684971u, 2318603227u,
+     140739594u,  889433530u, 1923340138u, 1338244826u, 4259521226u, 3229813626u, 2267247018u, 3124975642u,
+    2570221389u, 2756861693u, 3824297005u, 3734113693u, 1823658381u, 1372780605u,  376603373u,  722643805u,
+    2839690380u, 2485261628u, 3548540908u, 4007806556u, 1556257356u, 1638052860u,  637716780u,  459464860u,
+    4191346895u, 3300051327u, 2199040943u, 3195181599u,  206718479u,  825388991u, 1989285231u, 1274166495u,
+    3382881038u, 4106388158u, 3009607790u, 2382549470u, 1008864718u,   21111934u, 1189240494u, 2072147742u,
+    2984685714u, 2357631266u, 3408323570u, 4131834434u, 1147541074u, 2030452706u, 1051084082u,   63335554u,
+    2174155603u, 3170292451u, 4216760371u, 3325460867u, 1947622803u, 1232499747u,  248909555u,  867575619u,
+    3506841360u, 3966111392u, 2881909872u, 2527485376u,  612794832u,  434546784u, 1581699760u, 1663499008u,
+    3782634705u, 3692447073u, 2612412337u, 2799048193u,  351717905u,  697754529u, 1849071985u, 1398190273u,
+    1881644950u, 1296545318u,  182963446u,  931652934u, 2242328918u, 3100053734u, 4284967478u, 3255255942u,
+    1079497815u, 2100821479u,  983009079u,  133672583u, 3050795671u, 2293717799u, 3474399735u, 4067887175u,
+     281479188u,  765927844u, 1778867060u, 1466397380u, 3846680276u, 3626469220u, 2676489652u, 2733102084u,
+     548881365u,  500656741u, 1517752501u, 1729575173u, 3577210133u, 3898068133u, 2952246901u, 2459410373u,
+    3910527195u, 3564487019u, 2480257979u, 2931134987u,  479546907u,  569730987u, 1716854139u, 1530213579u,
+    3647316762u, 3825568426u, 2745561210u, 2663766474u,  753206746u,  293940330u, 1445287610u, 1799716618u,
+    2314567513u, 3029685993u, 4080348217u, 3461678473u, 2088098201u, 1091956777u,  112560889u, 1003856713u,
+    3112514712u, 2229607720u, 3276105720u, 4263857736u, 1275433560u, 1902492648u,  918929720u,  195422344u,
+     685033439u,  364179055u, 1377080511u, 1869921551u, 3713294623u, 3761522863u, 2811507327u, 2599689167u,
+     413436958u,  633644462u, 1650777982u, 1594160846u, 3978570462u, 3494118254u, 2548332990u, 2860797966u,
+    1211387997u, 1968470509u,  854852413u,  261368461u, 3182753437u, 2161434413u, 3346310653u, 4195650637u,
+    2017729436u, 1160000044u,   42223868u, 1071931724u, 2378480988u, 2963576044u, 4144295484u, 3395602316u
+  },
+  {
+             0u, 3411858341u, 1304994059u, 2257875630u, 2609988118u, 1355649459u, 3596215069u,  486879416u,
+    3964895853u,  655315400u, 2711298918u, 1791488195u, 2009251963u, 3164476382u,  973758832u, 4048990933u,
+      64357019u, 3364540734u, 1310630800u, 2235723829u, 2554806413u, 1394316072u, 3582976390u,  517157411u,
+    4018503926u,  618222419u, 2722963965u, 1762783832u, 1947517664u, 3209171269u,  970744811u, 4068520014u,
+     128714038u, 3438335635u, 1248109629u, 2167961496u, 2621261600u, 1466012805u, 3522553387u,  447296910u,
+    3959392091u,  547575038u, 2788632144u, 1835791861u, 1886307661u, 3140622056u, 1034314822u, 4143626211u,
+      75106221u, 3475428360u, 1236444838u, 2196665603u, 2682996155u, 1421317662u, 3525567664u,  427767573u,
+    3895035328u,  594892389u, 2782995659u, 1857943406u, 1941489622u, 3101955187u, 1047553757u, 4113347960u,
+     257428076u, 3288652233u, 1116777319u, 2311878850u, 2496219258u, 1603640287u, 3640781169u,  308099796u,
+    3809183745u,  676813732u, 2932025610u, 1704983215u, 2023410199u, 3016104370u,  894593820u, 4262377657u,
+     210634999u, 3352484690u, 1095150076u, 2316991065u, 2535410401u, 1547934020u, 3671583722u,  294336591u,
+    3772615322u,  729897279u, 2903845777u, 1716123700u, 2068629644u, 2953845545u,  914647431u, 4258839074u,
+     150212442u, 3282623743u, 1161604689u, 2388688372u, 2472889676u, 1480171241u, 3735940167u,  368132066u,
+    3836185911u,  805002898u, 2842635324u, 1647574937u, 2134298401u, 3026852996u,  855535146u, 4188192143u,
+     186781121u, 3229539940u, 1189784778u, 2377547631u, 2427670487u, 1542429810u, 3715886812u,  371670393u,
+    3882979244u,  741170185u, 2864262823u, 1642462466u, 2095107514u, 3082559007u,  824732849u, 4201955092u,
+     514856152u, 3589064573u, 1400419795u, 2552522358u, 2233554638u, 1316849003u, 3370776517u,   62202976u,
+    4075001525u,  968836368u, 3207280574u, 1954014235u, 1769133219u, 2720925446u,  616199592u, 4024870413u,
+     493229635u, 3594175974u, 1353627464u, 2616354029u, 2264355925u, 1303087088u, 3409966430u,    6498043u,
+    4046820398u,  979978123u, 3170710821u, 2007099008u, 1789187640u, 2717386141u,  661419827u, 3962610838u,
+     421269998u, 3527459403u, 1423225061u, 2676515648u, 2190300152u, 1238466653u, 3477467891u,   68755798u,
+    4115633027u, 1041448998u, 3095868040u, 1943789869u, 1860096405u, 2776760880u,  588673182u, 3897205563u,
+     449450869u, 3516317904u, 1459794558u, 2623431131u, 2170245475u, 1242006214u, 3432247400u,  131015629u,
+    4137259288u, 1036337853u, 3142660115u, 1879958454u, 1829294862u, 2790523051u,  549483013u, 3952910752u,
+     300424884u, 3669282065u, 1545650111u, 2541513754u, 2323209378u, 1092980487u, 3350330793u,  216870412u,
+    4256931033u,  921128828u, 2960342482u, 2066738807u, 1714085583u, 2910195050u,  736264132u, 3770592353u,
+     306060335u, 3647131530u, 1610005796u, 2494197377u, 2309971513u, 1123257756u, 3295149874u,  255536279u,
+    4268596802u,  892423655u, 3013951305u, 2029645036u, 1711070292u, 2929725425u,  674528607u, 3815288570u,
+     373562242u, 3709388839u, 1535949449u, 2429577516u, 2379569556u, 1183418929u, 3223189663u,  188820282u,
+    4195850735u,  827017802u, 3084859620u, 2089020225u, 1636228089u, 2866415708u,  743340786u, 3876759895u,
+     361896217u, 3738094268u, 1482340370u, 2466671543u, 2382584591u, 1163888810u, 3284924932u,  144124321u,
+    4190215028u,  849168593u, 3020503679u, 2136336858u, 1649465698u, 2836138695u,  798521449u, 3838094284u
+  },
+  {
+             0u, 2792819636u, 2543784233u,  837294749u, 4098827283u, 1379413927u, 1674589498u, 3316072078u,
+     871321191u, 2509784531u, 2758827854u,   34034938u, 3349178996u, 1641505216u, 1346337629u, 4131942633u,
+    1742642382u, 3249117050u, 4030828007u, 1446413907u, 2475800797u,  904311657u,   68069876u, 2725880384u,
+    1412551337u, 4064729373u, 3283010432u, 1708771380u, 2692675258u,  101317902u,  937551763u, 2442587175u,
+    3485284764u, 1774858792u, 1478633653u, 4266992385u, 1005723023u, 2642744891u, 2892827814u,  169477906u,
+    4233263099u, 1512406095u, 1808623314u, 3451546982u,  136139752u, 2926205020u, 2676114113u,  972376437u,
+    2825102674u,  236236518u, 1073525883u, 2576072655u, 1546420545u, 4200303349u, 3417542760u, 1841601500u,
+    2609703733u, 1039917185u,  202635804u, 2858742184u, 1875103526u, 3384067218u, 4166835727u, 1579931067u,
+    1141601657u, 3799809741u, 3549717584u, 1977839588u, 2957267306u,  372464350u,  668680259u, 2175552503u,
+    2011446046u, 3516084394u, 3766168119u, 1175200131u, 2209029901u,  635180217u,  338955812u, 2990736784u,
+     601221559u, 2242044419u, 3024812190u,  306049834u, 3617246628u, 1911408144u, 1074125965u, 3866285881u,
+     272279504u, 3058543716u, 2275784441u,  567459149u, 3832906691u, 1107462263u, 1944752874u, 3583875422u,
+    2343980261u,  767641425u,  472473036u, 3126744696u, 2147051766u, 3649987394u, 3899029983u, 1309766251u,
+    3092841090u,  506333494u,  801510315u, 2310084639u, 1276520081u, 3932237093u, 3683203000u, 2113813516u,
+    3966292011u, 1243601823u, 2079834370u, 3716205238u,  405271608u, 3192979340u, 2411259153u,  701492901u,
+    3750207052u, 2045810168u, 1209569125u, 4000285905u,  734575199u, 2378150379u, 3159862134u,  438345922u,
+    2283203314u,  778166598u,  529136603u, 3120492655u, 2086260449u, 3660498261u, 3955679176u, 1303499900u,
+    3153699989u,  495890209u,  744928700u, 2316418568u, 1337360518u, 3921775410u, 3626602927u, 2120129051u,
+    4022892092u, 1237286280u, 2018993941u, 3726666913u,  461853231u, 3186645403u, 2350400262u,  711936178u,
+    3693557851u, 2052076527u, 1270360434u, 3989775046u,  677911624u, 2384402428u, 3220639073u,  427820757u,
+    1202443118u, 3789347034u, 3493118535u, 1984154099u, 3018127229u,  362020041u,  612099668u, 2181885408u,
+    1950653705u, 3526596285u, 3822816288u, 1168934804u, 2148251930u,  645706414u,  395618355u, 2984485767u,
+     544559008u, 2248295444u, 3085590153u,  295523645u, 3560598451u, 1917673479u, 1134918298u, 3855773998u,
+     328860103u, 3052210803u, 2214924526u,  577903450u, 3889505748u, 1101147744u, 1883911421u, 3594338121u,
+    3424493451u, 1785369663u, 1535282850u, 4260726038u,  944946072u, 2653270060u, 2949491377u,  163225861u,
+    4294103532u, 1501944408u, 1752023237u, 3457862513u,  196998655u, 2915761739u, 2619532502u,  978710370u,
+    2881684293u,  229902577u, 1012666988u, 2586515928u, 1603020630u, 4193987810u, 3356702335u, 1852063179u,
+    2553040162u, 1046169238u,  263412747u, 2848217023u, 1818454321u, 3390333573u, 4227627032u, 1569420204u,
+      60859927u, 2782375331u, 2487203646u,  843627658u, 4159668740u, 1368951216u, 1617990445u, 3322386585u,
+     810543216u, 2520310724u, 2815490393u,   27783917u, 3288386659u, 1652017111u, 1402985802u, 4125677310u,
+    1685994201u, 3255382381u, 4091620336u, 1435902020u, 2419138250u,  910562686u,  128847843u, 2715354199u,
+    1469150398u, 4058414858u, 3222168983u, 1719234083u, 2749255853u,   94984985u,  876691844u, 2453031472u
+  },
+  {
+             0u, 3433693342u, 1109723005u, 2391738339u, 2219446010u, 1222643300u, 3329165703u,  180685081u,
+    3555007413u,  525277995u, 2445286600u, 1567235158u, 1471092047u, 2600801745u,  361370162u, 3642757804u,
+    2092642603u, 2953916853u, 1050555990u, 4063508168u, 4176560081u,  878395215u, 3134470316u, 1987983410u,
+    2942184094u, 1676945920u, 3984272867u,  567356797u,  722740324u, 3887998202u, 1764827929u, 2778407815u,
+    4185285206u,  903635656u, 3142804779u, 2012833205u, 2101111980u, 2979425330u, 1058630609u, 4088621903u,
+     714308067u, 3862526333u, 1756790430u, 2753330688u, 2933487385u, 1651734407u, 3975966820u,  542535930u,
+    2244825981u, 1231508451u, 3353891840u,  188896414u,   25648519u, 3442302233u, 1134713594u, 2399689316u,
+    1445480648u, 2592229462u,  336416693u, 3634843435u, 3529655858u,  516441772u, 2420588879u, 1559052753u,
+     698204909u, 3845636723u, 1807271312u, 2803025166u, 2916600855u, 1635634313u, 4025666410u,  593021940u,
+    4202223960u,  919787974u, 3093159461u, 1962401467u, 2117261218u, 2996361020u, 1008193759u, 4038971457u,
+    1428616134u, 2576151384u,  386135227u, 3685348389u, 3513580860u,  499580322u, 2471098945u, 1608776415u,
+    2260985971u, 1248454893u, 3303468814u,  139259792u,   42591881u, 3458459159u, 1085071860u, 2349261162u,
+    3505103035u,  474062885u, 2463016902u, 1583654744u, 1419882049u, 2550902495u,  377792828u, 3660491170u,
+      51297038u, 3483679632u, 1093385331u, 2374089965u, 2269427188u, 1273935210u, 3311514249u,  164344343u,
+    2890961296u, 1627033870u, 4000683757u,  585078387u,  672833386u, 3836780532u, 1782552599u, 2794821769u,
+    2142603813u, 3005188795u, 1032883544u, 4047146438u, 4227826911u,  928351297u, 3118105506u, 1970307900u,
+    1396409818u, 2677114180u,  287212199u, 3719594553u, 3614542624u,  467372990u, 2505346141u, 1509854403u,
+    2162073199u, 1282711281u, 3271268626u,  240228748u,   76845205u, 3359543307u, 1186043880u, 2317064054u,
+     796964081u, 3811226735u, 1839575948u, 2702160658u, 2882189835u, 1734392469u, 3924802934u,  625327592u,
+    4234522436u,  818917338u, 3191908409u, 1927981223u, 2016387518u, 3028656416u,  973776579u, 4137723485u,
+    2857232268u, 1726474002u, 3899187441u,  616751215u,  772270454u, 3803048424u, 1814228491u, 2693328533u,
+    2041117753u, 3036871847u,  999160644u, 4146592730u, 4259508931u,  826864221u, 3217552830u, 1936586016u,
+    3606501031u,  442291769u, 2496909786u, 1484378436u, 1388107869u, 2652297411u,  278519584u, 3694387134u,
+      85183762u, 3384397196u, 1194773103u, 2342308593u, 2170143720u, 1307820918u, 3279733909u,  265733131u,
+    2057717559u, 3054258089u,  948125770u, 4096344276u, 4276898253u,  843467091u, 3167309488u, 1885556270u,
+    2839764098u, 1709792284u, 3949353983u,  667704161u,  755585656u, 3785577190u, 1865176325u, 2743489947u,
+     102594076u, 3401021058u, 1144549729u, 2291298815u, 2186770662u, 1325234296u, 3228729243u,  215514885u,
+    3589828009u,  424832311u, 2547870420u, 1534552650u, 1370645331u, 2635621325u,  328688686u, 3745342640u,
+    2211456353u, 1333405183u, 3254067740u,  224338562u,  127544219u, 3408931589u, 1170156774u, 2299866232u,
+    1345666772u, 2627681866u,  303053225u, 3736746295u, 3565105198u,  416624816u, 2522494803u, 1525692365u,
+    4285207626u,  868291796u, 3176010551u, 1910772649u, 2065767088u, 3079346734u,  956571085u, 4121828691u,
+     747507711u, 3760459617u, 1856702594u, 2717976604u, 2831417605u, 1684930971u, 3940615800u,  642451174u
+  }
 };
 
 /*Return the CRC of the bytes buf[0..len-1].*/
 unsigned lodepng_crc32(const unsigned char* data, size_t length)
 {
   unsigned r = 0xffffffffu;
-  size_t i;
-  for(i = 0; i < length; ++i)
+  while(length >= 8)
+  {
+    /*the first four bytes are combined with the CRC so far, little endian*/
+    unsigned lo = r ^ ((unsigned)data[0] | ((unsigned)data[1] << 8u)
+                    | ((unsigned)data[2] << 16u) | ((unsigned)data[3] << 24u));
+    r = lodepng_crc32_table[7][lo & 0xff] ^ lodepng_crc32_table[6][(lo >> 8u) & 0xff]
+      ^ lodepng_crc32_table[5][(lo >> 16u) & 0xff] ^ lodepng_crc32_table[4][lo >> 24u]
+      ^ lodepng_crc32_table[3][data[4]] ^ lodepng_crc32_table[2][data[5]]
+      ^ lodepng_crc32_table[1][data[6]] ^ lodepng_crc32_table[0][data[7]];
+    data += 8;
+    length -= 8;
+  }
+  while(length > 0)
   {
-    r = lodepng_crc32_table[(r ^ data[i]) & 0xff] ^ (r >> 8);
+    r = lodepng_crc32_table[0][(r ^ *data++) & 0xff] ^ (r >> 8);
+    --length;
   }
   return r ^ 0xffffffffu;
 }
@@ -2952,82 +3546,67 @@ static void addColorBits(unsigned char* out, size_t index, unsigned bits, unsign
   else out[index * bits / 8] |= in;
 }
 
-typedef struct ColorTree ColorTree;
+/*slots of a ColorTable, twice the most colors it ever holds*/
+#define COLOR_TABLE_SLOTS 512
 
 /*
-One node of a color tree
-This is the data structure used to count the number of unique colors and to get a palette
-index for a color. It's like an octree, but because the alpha channel is used too, each
-node has 16 instead of 8 children.
+Hash table from RGBA colors to palette indices, used to get the palette index of a color
+and to count the unique colors of an image. It holds at most 257 colors (a full palette,
+plus one to tell that an image needs more), so it is a fixed block of slots, open
+addressing with linear probing, and never allocates.
 */
-struct ColorTree
+typedef struct ColorTable
 {
-  ColorTree* children[16]; /*up to 16 pointers to ColorTree of next level*/
-  int index; /*the payload. Only has a meaningful value if this is in the last level*/
-};
+  unsigned colors[COLOR_TABLE_SLOTS]; /*r, g, b, a packed from most to least significant byte*/
+  short index[COLOR_TABLE_SLOTS]; /*the payload, -1 for an empty slot*/
+} ColorTable;
 
-static void color_tree_init(ColorTree* tree)
+static void color_table_init(ColorTable* table)
 {
   int i;
-  for(i = 0; i != 16; ++i) tree->children[i] = 0;
-  tree->index = -1;
+  for(i = 0; i != COLOR_TABLE_SLOTS; ++i) table->index[i] = -1;
 }
 
-static void color_tree_cleanup(ColorTree* tree)
+/*the slot holding the color, or the empty slot where it belongs*/
+static unsigned color_table_slot(const ColorTable* table, unsigned color)
 {
-  int i;
-  for(i = 0; i != 16; ++i)
-  {
-    if(tree->children[i])
-    {
-      color_tree_cleanup(tree->children[i]);
-      lodepng_free(tree->children[i]);
-    }
-  }
+  unsigned slot = (color * 2654435761u) >> 23; /*Fibonacci hashing to 9 bits*/
+  while(table->index[slot] >= 0 && table->colors[slot] != color) slot = (slot + 1) & (COLOR_TABLE_SLOTS - 1);
+  return slot;
+}
+
+static unsigned color_table_key(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+  return ((unsigned)r << 24u) | ((unsigned)g << 16u) | ((unsigned)b << 8u) | a;
 }
 
 /*returns -1 if color not present, its index otherwise*/
-static int color_tree_get(ColorTree* tree, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+static int color_table_get(const ColorTable* table, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
-  int bit = 0;
-  for(bit = 0; bit < 8; ++bit)
-  {
-    int i = 8 * ((r >> bit) & 1) + 4 * ((g >> bit) & 1) + 2 * ((b >> bit) & 1) + 1 * ((a >> bit) & 1);
-    if(!tree->children[i]) return -1;
-    else tree = tree->children[i];
-  }
-  return tree ? tree->index : -1;
+  return table->index[color_table_slot(table, color_table_key(r, g, b, a))];
 }
 
 #ifdef LODEPNG_COMPILE_ENCODER
-static int color_tree_has(ColorTree* tree, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+static int color_table_has(const ColorTable* table, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
-  return color_tree_get(tree, r, g, b, a) >= 0;
+  return color_table_get(table, r, g, b, a) >= 0;
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
-/*color is not allowed to already exist.
-Index should be >= 0 (it's signed to be compatible with using -1 for "doesn't exist")*/
-static void color_tree_add(ColorTree* tree,
-                           unsigned char r, unsigned char g, unsigned char b, unsigned char a, unsigned index)
+/*give the color index (0-256), replacing the index it had if it is present already.
+At most 257 different colors may be added*/
+static void color_table_add(ColorTable* table,
+                            unsigned char r, unsigned char g, unsigned char b, unsigned char a, unsigned index)
 {
-  int bit;
-  for(bit = 0; bit < 8; ++bit)
-  {
-    int i = 8 * ((r >> bit) & 1) + 4 * ((g >> bit) & 1) + 2 * ((b >> bit) & 1) + 1 * ((a >> bit) & 1);
-    if(!tree->children[i])
-    {
-      tree->children[i] = (ColorTree*)lodepng_malloc(sizeof(ColorTree));
-      color_tree_init(tree->children[i]);
-    }
-    tree = tree->children[i];
-  }
-  tree->index = (int)index;
+  unsigned color = color_table_key(r, g, b, a);
+  unsigned slot = color_table_slot(table, color);
+  table->colors[slot] = color;
+  table->index[slot] = (short)index;
 }
 
 /*put a pixel, given its RGBA color, into image of any color type*/
 static unsigned rgba8ToPixel(unsigned char* out, size_t i,
-                             const LodePNGColorMode* mode, ColorTree* tree /*for palette*/,
+                             const LodePNGColorMode* mode, const ColorTable* table /*for palette*/,
                              unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
   if(mode->colortype == LCT_GREY)
@@ -3059,7 +3638,7 @@ static unsigned rgba8ToPixel(unsigned char* out, size_t i,
   }
   else if(mode->colortype == LCT_PALETTE)
   {
-    int index = color_tree_get(tree, r, g, b, a);
+    int index = color_table_get(table, r, g, b, a);
     if(index < 0) return 82; /*color not in palette*/
     if(mode->bitdepth == 8) out[i] = index;
     else addColorBits(out, i, mode->bitdepth, (unsigned)index);
@@ -3257,7 +3836,57 @@ static void getPixelColorsRGBA8(unsigned char* buffer, size_t numpixels,
 {
   unsigned num_channels = has_alpha ? 4 : 3;
   size_t i;
-  if(mode->colortype == LCT_GREY)
+  if(mode->colortype == LCT_RGB && mode->bitdepth == 8 && has_alpha && !mode->key_defined)
+  {
+    /*the common opaque texture: one 32-bit store per pixel, alpha at the highest address*/
+    for(i = 0; i != numpixels; ++i, buffer += 4, in += 3)
+    {
+      unsigned char pixel[4];
+      pixel[0] = in[0];
+      pixel[1] = in[1];
+      pixel[2] = in[2];
+      pixel[3] = 255;
+      memcpy(buffer, pixel, 4);
+    }
+  }
+  else if(mode->colortype == LCT_GREY && mode->bitdepth == 8 && has_alpha && !mode->key_defined)
+  {
+    for(i = 0; i != numpixels; ++i, buffer += 4)
+    {
+      unsigned char pixel[4];
+      pixel[0] = pixel[1] = pixel[2] = in[i];
+      pixel[3] = 255;
+      memcpy(buffer, pixel, 4);
+    }
+  }
+  else if(mode->colortype == LCT_PALETTE && mode->bitdepth <= 8)
+  {
+    /*look the indices up in a table of every index the bit depth allows, out of range ones black*/
+    unsigned char table[256 * 4];
+    size_t entries = 1u << mode->bitdepth, j = 0;
+    for(i = 0; i != entries; ++i)
+    {
+      if(i < mode->palettesize) memcpy(&table[i * 4], &mode->palette[i * 4], 4);
+      else
+      {
+        table[i * 4 + 0] = table[i * 4 + 1] = table[i * 4 + 2] = 0;
+        table[i * 4 + 3] = 255;
+      }
+    }
+    if(mode->bitdepth == 8)
+    {
+      if(has_alpha) for(i = 0; i != numpixels; ++i) memcpy(&buffer[i * 4], &table[in[i] * 4], 4);
+      else for(i = 0; i != numpixels; ++i) memcpy(&buffer[i * 3], &table[in[i] * 4], 3);
+    }
+    else
+    {
+      for(i = 0; i != numpixels; ++i, buffer += num_channels)
+      {
+        memcpy(buffer, &table[readBitsFromReversedStream(&j, in, mode->bitdepth) * 4], num_channels);
+      }
+    }
+  }
+  else if(mode->colortype == LCT_GREY)
   {
     if(mode->bitdepth == 8)
     {
@@ -3314,31 +3943,6 @@ static void getPixelColorsRGBA8(unsigned char* buffer, size_t numpixels,
       }
     }
   }
-  else if(mode->colortype == LCT_PALETTE)
-  {
-    unsigned index;
-    size_t j = 0;
-    for(i = 0; i != numpixels; ++i, buffer += num_channels)
-    {
-      if(mode->bitdepth == 8) index = in[i];
-      else index = readBitsFromReversedStream(&j, in, mode->bitdepth);
-
-      if(index >= mode->palettesize)
-      {
-        /*This is an error according to the PNG spec, but most PNG decoders make it black instead.
-        Done here too, slightly faster due to no error handling needed.*/
-        buffer[0] = buffer[1] = buffer[2] = 0;
-        if(has_alpha) buffer[3] = 255;
-      }
-      else
-      {
-        buffer[0] = mode->palette[index * 4 + 0];
-        buffer[1] = mode->palette[index * 4 + 1];
-        buffer[2] = mode->palette[index * 4 + 2];
-        if(has_alpha) buffer[3] = mode->palette[index * 4 + 3];
-      }
-    }
-  }
   else if(mode->colortype == LCT_GREY_ALPHA)
   {
     if(mode->bitdepth == 8)
@@ -3424,13 +4028,13 @@ unsigned lodepng_convert(unsigned char* out, const unsigned char* in,
                          unsigned w, unsigned h)
 {
   size_t i;
-  ColorTree tree;
+  ColorTable table;
   size_t numpixels = w * h;
 
   if(lodepng_color_mode_equal(mode_out, mode_in))
   {
     size_t numbytes = lodepng_get_raw_size(w, h, mode_in);
-    for(i = 0; i != numbytes; ++i) out[i] = in[i];
+    memcpy(out, in, numbytes);
     return 0;
   }
 
@@ -3448,11 +4052,11 @@ unsigned lodepng_convert(unsigned char* out, const unsigned char* in,
       palette = mode_in->palette;
     }
     if(palettesize < palsize) palsize = palettesize;
-    color_tree_init(&tree);
+    color_table_init(&table);
     for(i = 0; i != palsize; ++i)
     {
       const unsigned char* p = &palette[i * 4];
-      color_tree_add(&tree, p[0], p[1], p[2], p[3], i);
+      color_table_add(&table, p[0], p[1], p[2], p[3], (unsigned)i);
     }
   }
 
@@ -3479,15 +4083,10 @@ unsigned lodepng_convert(unsigned char* out, const unsigned char* in,
     for(i = 0; i != numpixels; ++i)
     {
       getPixelColorRGBA8(&r, &g, &b, &a, in, i, mode_in);
-      CERROR_TRY_RETURN(rgba8ToPixel(out, i, mode_out, &tree, r, g, b, a));
+      CERROR_TRY_RETURN(rgba8ToPixel(out, i, mode_out, &table, r, g, b, a));
     }
   }
 
-  if(mode_out->colortype == LCT_PALETTE)
-  {
-    color_tree_cleanup(&tree);
-  }
-
   return 0; /*no error*/
 }
 
@@ -3533,7 +4132,7 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 {
   unsigned error = 0;
   size_t i;
-  ColorTree tree;
+  ColorTable table;
   size_t numpixels = w * h;
 
   unsigned colored_done = lodepng_is_greyscale_type(mode) ? 1 : 0;
@@ -3545,7 +4144,7 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
   unsigned sixteen = 0;
   if(bpp <= 8) maxnumcolors = bpp == 1 ? 2 : (bpp == 2 ? 4 : (bpp == 4 ? 16 : 256));
 
-  color_tree_init(&tree);
+  color_table_init(&table);
 
   /*Check if the 16-bit input is truly 16-bit*/
   if(mode->bitdepth == 16)
@@ -3655,9 +4254,9 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 
       if(!numcolors_done)
       {
-        if(!color_tree_has(&tree, r, g, b, a))
+        if(!color_table_has(&table, r, g, b, a))
         {
-          color_tree_add(&tree, r, g, b, a, profile->numcolors);
+          color_table_add(&table, r, g, b, a, profile->numcolors);
           if(profile->numcolors < 256)
           {
             unsigned char* p = profile->palette;
@@ -3681,7 +4280,6 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
     profile->key_b += (profile->key_b << 8);
   }
 
-  color_tree_cleanup(&tree);
   return error;
 }
 
@@ -3896,6 +4494,116 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
   return state->error;
 }
 
+#ifdef LODEPNG_SSE2
+/*
+SSE2 unfiltering of 8-bit RGB and RGBA scanlines. Sub, Average and Paeth depend
+on the pixel to the left, so they run a pixel at a time with all channels in one
+register; Up has no such dependency and runs 16 bytes at a time. Paeth picks its
+predictor with compares and masks instead of branches. bytewidth is 3 or 4
+*/
+/*
+Pixels move through a 32-bit integer. A 3-byte pixel is read as 4 bytes while
+there is room (the extra byte is not stored back) and written as 2 + 1 bytes
+*/
+static __m128i loadPixel(const unsigned char* p, size_t bytewidth, size_t remaining)
+{
+  unsigned value;
+  if(bytewidth == 4 || remaining >= 4) memcpy(&value, p, 4);
+  else value = p[0] | ((unsigned)p[1] << 8u) | ((unsigned)p[2] << 16u);
+  return _mm_cvtsi32_si128((int)value);
+}
+
+static void storePixel(unsigned char* p, __m128i pixel, size_t bytewidth)
+{
+  unsigned value = (unsigned)_mm_cvtsi128_si32(pixel);
+  if(bytewidth == 4) memcpy(p, &value, 4);
+  else
+  {
+    memcpy(p, &value, 2);
+    p[2] = (unsigned char)(value >> 16u);
+  }
+}
+
+static void unfilterSubSSE2(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length)
+{
+  size_t i;
+  __m128i a = _mm_setzero_si128();
+  for(i = 0; i < length; i += bytewidth)
+  {
+    a = _mm_add_epi8(a, loadPixel(&scanline[i], bytewidth, length - i));
+    storePixel(&recon[i], a, bytewidth);
+  }
+}
+
+static void unfilterUpSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                           size_t length)
+{
+  size_t i;
+  for(i = 0; i + 16 <= length; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+    __m128i b = _mm_loadu_si128((const __m128i*)&precon[i]);
+    _mm_storeu_si128((__m128i*)&recon[i], _mm_add_epi8(x, b));
+  }
+  for(; i != length; ++i) recon[i] = scanline[i] + precon[i];
+}
+
+static void unfilterAverageSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                size_t bytewidth, size_t length)
+{
+  size_t i;
+  const __m128i ones = _mm_set1_epi8(1);
+  __m128i a = _mm_setzero_si128();
+  for(i = 0; i < length; i += bytewidth)
+  {
+    __m128i b = loadPixel(&precon[i], bytewidth, length - i);
+    /*_mm_avg_epu8 rounds up, the filter rounds down: take off the odd sums' 1*/
+    __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), ones));
+    a = _mm_add_epi8(loadPixel(&scanline[i], bytewidth, length - i), average);
+    storePixel(&recon[i], a, bytewidth);
+  }
+}
+
+static __m128i absEpi16(__m128i x)
+{
+  return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static __m128i selectEpi16(__m128i mask, __m128i yes, __m128i no)
+{
+  return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+}
+
+static void unfilterPaethSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                              size_t bytewidth, size_t length)
+{
+  size_t i;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i low = _mm_set1_epi16(255);
+  /*left, up and upper left pixels, channels widened to 16 bits so the left
+  pixel carries over to the next one without a pack and unpack*/
+  __m128i a = zero, c = zero;
+  for(i = 0; i < length; i += bytewidth)
+  {
+    __m128i b = _mm_unpacklo_epi8(loadPixel(&precon[i], bytewidth, length - i), zero);
+    __m128i x = _mm_unpacklo_epi8(loadPixel(&scanline[i], bytewidth, length - i), zero);
+    /*p = a + b - c: pa = |p - a| = |b - c|, pb = |p - b| = |a - c|, pc = |p - c| = |(b - c) + (a - c)|*/
+    __m128i bc = _mm_sub_epi16(b, c);
+    __m128i pa = absEpi16(bc);
+    __m128i ac = _mm_sub_epi16(a, c);
+    __m128i pb = absEpi16(ac);
+    __m128i pc = absEpi16(_mm_add_epi16(bc, ac));
+    /*ties prefer a, then b, as in paethPredictor*/
+    __m128i notb = _mm_cmpgt_epi16(pb, pc);
+    __m128i nota = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    __m128i predictor = selectEpi16(nota, selectEpi16(notb, c, b), a);
+    a = _mm_and_si128(_mm_add_epi16(x, predictor), low);
+    storePixel(&recon[i], _mm_packus_epi16(a, a), bytewidth);
+    c = b;
+  }
+}
+#endif /*LODEPNG_SSE2*/
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
                                  size_t bytewidth, unsigned char filterType, size_t length)
 {
@@ -3909,6 +4617,31 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   */
 
   size_t i;
+#ifdef LODEPNG_SSE2
+  if(bytewidth == 3 || bytewidth == 4)
+  {
+    if(filterType == 1)
+    {
+      unfilterSubSSE2(recon, scanline, bytewidth, length);
+      return 0;
+    }
+    if(precon && filterType == 2)
+    {
+      unfilterUpSSE2(recon, scanline, precon, length);
+      return 0;
+    }
+    if(precon && filterType == 3)
+    {
+      unfilterAverageSSE2(recon, scanline, precon, bytewidth, length);
+      return 0;
+    }
+    if(precon && filterType == 4)
+    {
+      unfilterPaethSSE2(recon, scanline, precon, bytewidth, length);
+      return 0;
+    }
+  }
+#endif /*LODEPNG_SSE2*/
   switch(filterType)
   {
     case 0:
@@ -4448,17 +5181,15 @@ static unsigned readChunk_pHYs(LodePNGInfo* info, const unsigned char* data, siz
 }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-/*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-                          LodePNGState* state,
-                          const unsigned char* in, size_t insize)
+/*read the chunks of a PNG and gather its compressed image data in idat, with the size it must
+inflate to in predict. idat is initialized here and must be cleaned up by the caller also on error*/
+static void decodeChunks(ucvector* idat, size_t* predict, unsigned* w, unsigned* h,
+                         LodePNGState* state,
+                         const unsigned char* in, size_t insize)
 {
   unsigned char IEND = 0;
   const unsigned char* chunk;
   size_t i;
-  ucvector idat; /*the data from idat chunks*/
-  ucvector scanlines;
-  size_t predict;
   size_t numpixels;
 
   /*for unknown chunk order*/
@@ -4467,8 +5198,7 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-  /*provide some proper output values if error will happen*/
-  *out = 0;
+  ucvector_init(idat);
 
   state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
   if(state->error) return;
@@ -4481,7 +5211,6 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   bytes with 16-bit RGBA, the rest is room for filter bytes.*/
   if(numpixels > 268435455) CERROR_RETURN(state->error, 92);
 
-  ucvector_init(&idat);
   chunk = &in[33]; /*first byte of the first chunk after the header*/
 
   /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
@@ -4509,9 +5238,9 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     /*IDAT chunk, containing compressed image data*/
     if(lodepng_chunk_type_equals(chunk, "IDAT"))
     {
-      size_t oldsize = idat.size;
-      if(!ucvector_resize(&idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-      for(i = 0; i != chunkLength; ++i) idat.data[oldsize + i] = data[i];
+      size_t oldsize = idat->size;
+      if(!ucvector_resize(idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+      for(i = 0; i != chunkLength; ++i) idat->data[oldsize + i] = data[i];
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
       critical_pos = 3;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
@@ -4605,36 +5334,63 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     if(!IEND) chunk = lodepng_chunk_next_const(chunk);
   }
 
-  ucvector_init(&scanlines);
   /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
   If the decompressed size does not match the prediction, the image must be corrupt.*/
   if(state->info_png.interlace_method == 0)
   {
     /*The extra *h is added because this are the filter bytes every scanline starts with*/
-    predict = lodepng_get_raw_size_idat(*w, *h, &state->info_png.color) + *h;
+    *predict = lodepng_get_raw_size_idat(*w, *h, &state->info_png.color) + *h;
   }
   else
   {
     /*Adam-7 interlaced: predicted size is the sum of the 7 sub-images sizes*/
     const LodePNGColorMode* color = &state->info_png.color;
-    predict = 0;
-    predict += lodepng_get_raw_size_idat((*w + 7) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
-    if(*w > 4) predict += lodepng_get_raw_size_idat((*w + 3) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
-    predict += lodepng_get_raw_size_idat((*w + 3) >> 2, (*h + 3) >> 3, color) + ((*h + 3) >> 3);
-    if(*w > 2) predict += lodepng_get_raw_size_idat((*w + 1) >> 2, (*h + 3) >> 2, color) + ((*h + 3) >> 2);
-    predict += lodepng_get_raw_size_idat((*w + 1) >> 1, (*h + 1) >> 2, color) + ((*h + 1) >> 2);
-    if(*w > 1) predict += lodepng_get_raw_size_idat((*w + 0) >> 1, (*h + 1) >> 1, color) + ((*h + 1) >> 1);
-    predict += lodepng_get_raw_size_idat((*w + 0), (*h + 0) >> 1, color) + ((*h + 0) >> 1);
-  }
-  if(!state->error && !ucvector_reserve(&scanlines, predict)) state->error = 83; /*alloc fail*/
+    *predict = 0;
+    *predict += lodepng_get_raw_size_idat((*w + 7) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
+    if(*w > 4) *predict += lodepng_get_raw_size_idat((*w + 3) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
+    *predict += lodepng_get_raw_size_idat((*w + 3) >> 2, (*h + 3) >> 3, color) + ((*h + 3) >> 3);
+    if(*w > 2) *predict += lodepng_get_raw_size_idat((*w + 1) >> 2, (*h + 3) >> 2, color) + ((*h + 3) >> 2);
+    *predict += lodepng_get_raw_size_idat((*w + 1) >> 1, (*h + 1) >> 2, color) + ((*h + 1) >> 2);
+    if(*w > 1) *predict += lodepng_get_raw_size_idat((*w + 0) >> 1, (*h + 1) >> 1, color) + ((*h + 1) >> 1);
+    *predict += lodepng_get_raw_size_idat((*w + 0), (*h + 0) >> 1, color) + ((*h + 0) >> 1);
+  }
+}
+
+/*read the chunks of a PNG and inflate its image data into scanlines, still filtered and possibly
+interlaced. scanlines is initialized here and must be cleaned up by the caller also on error*/
+static void decodeScanlines(ucvector* scanlines, unsigned* w, unsigned* h,
+                            LodePNGState* state,
+                            const unsigned char* in, size_t insize)
+{
+  ucvector idat; /*the data from idat chunks*/
+  size_t predict = 0;
+
+  ucvector_init(scanlines);
+  decodeChunks(&idat, &predict, w, h, state, in, insize);
   if(!state->error)
   {
-    state->error = zlib_decompress(&scanlines.data, &scanlines.size, idat.data,
-                                   idat.size, &state->decoder.zlibsettings);
-    if(!state->error && scanlines.size != predict) state->error = 91; /*decompressed size doesn't match prediction*/
+    /*the inflator allocates the predicted size up front*/
+    LodePNGDecompressSettings zlibsettings = state->decoder.zlibsettings;
+    zlibsettings.expected_output_size = predict;
+    state->error = zlib_decompress(&scanlines->data, &scanlines->size, idat.data,
+                                   idat.size, &zlibsettings);
+    if(!state->error && scanlines->size != predict) state->error = 91; /*decompressed size doesn't match prediction*/
   }
   ucvector_cleanup(&idat);
+}
+
+/*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                          LodePNGState* state,
+                          const unsigned char* in, size_t insize)
+{
+  ucvector scanlines;
+  size_t i;
 
+  /*provide some proper output values if error will happen*/
+  *out = 0;
+
+  decodeScanlines(&scanlines, w, h, state, in, insize);
   if(!state->error)
   {
     size_t outsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
@@ -4691,6 +5447,227 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
   return state->error;
 }
 
+/*settle the color mode of the output after the header is read: state->info_raw becomes the PNG's
+own without color_convert. Sets *convert if the scanlines need converting, returns error code*/
+static unsigned decodeRawColor(LodePNGState* state, unsigned* convert)
+{
+  if(!state->decoder.color_convert)
+  {
+    CERROR_TRY_RETURN(lodepng_color_mode_copy(&state->info_raw, &state->info_png.color));
+  }
+  *convert = !lodepng_color_mode_equal(&state->info_raw, &state->info_png.color);
+  if(*convert && !(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+     && !(state->info_raw.bitdepth == 8))
+  {
+    return 56; /*unsupported color mode conversion*/
+  }
+  return 0;
+}
+
+unsigned lodepng_decode_into(unsigned char* out, size_t stride, size_t outsize,
+                             unsigned* w, unsigned* h, LodePNGState* state,
+                             const unsigned char* in, size_t insize)
+{
+  ucvector scanlines;
+  unsigned char* image = 0; /*the whole deinterlaced image, only for Adam7*/
+  unsigned char* lines = 0; /*the current and previous scanline in the color type of the PNG*/
+  const LodePNGColorMode* mode_png = &state->info_png.color;
+  unsigned convert, bpp, y;
+  size_t linebytes, rawbytes, x;
+
+  convert = 0;
+  decodeScanlines(&scanlines, w, h, state, in, insize);
+  if(!state->error) state->error = decodeRawColor(state, &convert);
+
+  bpp = lodepng_get_bpp(mode_png);
+  linebytes = ((size_t)*w * bpp + 7) / 8;
+  rawbytes = lodepng_get_raw_size(*w, 1, &state->info_raw);
+  if(!state->error && (stride < rawbytes || outsize < rawbytes || (outsize - rawbytes) / stride < *h - 1))
+  {
+    state->error = 95; /*the output buffer can't hold the image*/
+  }
+
+  if(!state->error)
+  {
+    lines = (unsigned char*)lodepng_malloc(linebytes * 2);
+    if(!lines) state->error = 83; /*alloc fail*/
+  }
+
+  if(!state->error && state->info_png.interlace_method == 0)
+  {
+    /*unfilter a scanline at a time, out is only written*/
+    size_t bytewidth = (bpp + 7) / 8;
+    unsigned char* prevline = 0;
+    for(y = 0; y < *h && !state->error; ++y)
+    {
+      const unsigned char* scanline = &scanlines.data[(1 + linebytes) * y];
+      unsigned char* line = &lines[(y & 1u) * linebytes];
+      state->error = unfilterScanline(line, &scanline[1], prevline, bytewidth, scanline[0], linebytes);
+      if(state->error) break;
+      if(convert) state->error = lodepng_convert(&out[y * stride], line, &state->info_raw, mode_png, *w, 1);
+      else for(x = 0; x != rawbytes; ++x) out[y * stride + x] = line[x];
+      prevline = line;
+    }
+  }
+  else if(!state->error)
+  {
+    /*Adam7 only completes a scanline with its last pass, so this needs the whole image*/
+    size_t imagesize = lodepng_get_raw_size(*w, *h, mode_png);
+    image = (unsigned char*)lodepng_malloc(imagesize);
+    if(!image) state->error = 83; /*alloc fail*/
+    else
+    {
+      for(x = 0; x != imagesize; ++x) image[x] = 0;
+      state->error = postProcessScanlines(image, scanlines.data, *w, *h, &state->info_png);
+    }
+    for(y = 0; y < *h && !state->error; ++y)
+    {
+      unsigned char* line = &image[y * linebytes];
+      if(bpp < 8)
+      {
+        /*the image has no padding bits between scanlines, move this one to a byte boundary*/
+        size_t ibp = (size_t)y * *w * bpp, obp = 0;
+        line = lines;
+        for(x = 0; x != (size_t)*w * bpp; ++x) setBitOfReversedStream(&obp, line, readBitFromReversedStream(&ibp, image));
+      }
+      if(convert) state->error = lodepng_convert(&out[y * stride], line, &state->info_raw, mode_png, *w, 1);
+      else for(x = 0; x != rawbytes; ++x) out[y * stride + x] = line[x];
+    }
+  }
+
+  lodepng_free(image);
+  lodepng_free(lines);
+  ucvector_cleanup(&scanlines);
+  return state->error;
+}
+
+#ifdef LODEPNG_COMPILE_ZLIB
+/*unfilters scanlines as the inflator produces them and hands them out in bands*/
+typedef struct RowStream
+{
+  const LodePNGColorMode* mode_png;
+  const LodePNGColorMode* mode_raw;
+  unsigned convert;
+  unsigned w, h;
+  unsigned y; /*scanlines unfiltered so far*/
+  size_t bytewidth, linebytes, rawbytes;
+  unsigned char* lines; /*the current and previous scanline in the color type of the PNG*/
+  unsigned char* band; /*band_rows scanlines in the output color type*/
+  unsigned band_rows, band_count;
+  size_t pending; /*bytes left over at the last call, the start of an incomplete scanline*/
+  LodePNGRowCallback callback;
+  void* user;
+} RowStream;
+
+static unsigned rowStreamConsume(void* context, const unsigned char* data, size_t size, size_t* used)
+{
+  RowStream* stream = (RowStream*)context;
+  size_t x;
+  while(size - *used >= 1 + stream->linebytes)
+  {
+    const unsigned char* scanline = &data[*used];
+    unsigned char* line = &stream->lines[(stream->y & 1u) * stream->linebytes];
+    unsigned char* prevline = stream->y ? &stream->lines[(~stream->y & 1u) * stream->linebytes] : 0;
+    unsigned char* dest = &stream->band[stream->band_count * stream->rawbytes];
+    if(stream->y == stream->h) return 91; /*more data than scanlines*/
+    CERROR_TRY_RETURN(unfilterScanline(line, &scanline[1], prevline, stream->bytewidth, scanline[0], stream->linebytes));
+    if(stream->convert)
+    {
+      CERROR_TRY_RETURN(lodepng_convert(dest, line, stream->mode_raw, stream->mode_png, stream->w, 1));
+    }
+    else for(x = 0; x != stream->rawbytes; ++x) dest[x] = line[x];
+    *used += 1 + stream->linebytes;
+    ++stream->y;
+    if(++stream->band_count == stream->band_rows || stream->y == stream->h)
+    {
+      CERROR_TRY_RETURN(stream->callback(stream->user, stream->band, stream->rawbytes,
+                                         stream->y - stream->band_count, stream->band_count));
+      stream->band_count = 0;
+    }
+  }
+  stream->pending = size - *used;
+  return 0;
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
+unsigned lodepng_decode_stream(unsigned* w, unsigned* h, LodePNGState* state,
+                               const unsigned char* in, size_t insize, unsigned band_rows,
+                               LodePNGRowCallback callback, void* user)
+{
+  unsigned convert = 0;
+  unsigned char* image = 0;
+  size_t rawbytes, y;
+  if(band_rows == 0) band_rows = 1;
+
+  state->error = lodepng_inspect(w, h, state, in, insize);
+  if(state->error) return state->error;
+
+#ifdef LODEPNG_COMPILE_ZLIB
+  if(state->info_png.interlace_method == 0
+     && !state->decoder.zlibsettings.custom_zlib && !state->decoder.zlibsettings.custom_inflate)
+  {
+    ucvector idat;
+    size_t predict = 0;
+    decodeChunks(&idat, &predict, w, h, state, in, insize);
+    if(!state->error) state->error = decodeRawColor(state, &convert);
+    if(!state->error)
+    {
+      RowStream stream;
+      InflateSink sink;
+      unsigned bpp = lodepng_get_bpp(&state->info_png.color);
+      stream.mode_png = &state->info_png.color;
+      stream.mode_raw = &state->info_raw;
+      stream.convert = convert;
+      stream.w = *w;
+      stream.h = *h;
+      stream.y = 0;
+      stream.bytewidth = (bpp + 7) / 8;
+      stream.linebytes = ((size_t)*w * bpp + 7) / 8;
+      stream.rawbytes = lodepng_get_raw_size(*w, 1, &state->info_raw);
+      if(band_rows > *h) band_rows = *h;
+      stream.band_rows = band_rows;
+      stream.band_count = 0;
+      stream.pending = 0;
+      stream.callback = callback;
+      stream.user = user;
+      stream.lines = (unsigned char*)lodepng_malloc(stream.linebytes * 2);
+      stream.band = (unsigned char*)lodepng_malloc(stream.rawbytes * band_rows);
+      if(!stream.lines || !stream.band) state->error = 83; /*alloc fail*/
+
+      sink.consume = rowStreamConsume;
+      sink.context = &stream;
+      /*inflate about a band at a time, but at least 64KB between moving the window*/
+      sink.band = (stream.linebytes + 1) * band_rows;
+      if(sink.band < 65536) sink.band = 65536;
+      if(!state->error) state->error = zlib_decompress_stream(idat.data, idat.size, &state->decoder.zlibsettings, &sink);
+      /*decompressed size doesn't match prediction*/
+      if(!state->error && (stream.y != *h || stream.pending)) state->error = 91;
+
+      lodepng_free(stream.lines);
+      lodepng_free(stream.band);
+    }
+    ucvector_cleanup(&idat);
+    return state->error;
+  }
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
+  /*Adam7 and custom decompressors: decode the whole image, then hand it out*/
+  state->error = decodeRawColor(state, &convert);
+  if(state->error) return state->error;
+  if((size_t)*w * *h > 268435455) return 92; /*too many pixels, as decodeGeneric checks*/
+  rawbytes = lodepng_get_raw_size(*w, 1, &state->info_raw);
+  image = (unsigned char*)lodepng_malloc(rawbytes * *h);
+  if(!image) return 83; /*alloc fail*/
+  state->error = lodepng_decode_into(image, rawbytes, rawbytes * *h, w, h, state, in, insize);
+  for(y = 0; y < *h && !state->error; y += band_rows)
+  {
+    unsigned count = *h - y < band_rows ? (unsigned)(*h - y) : band_rows;
+    state->error = callback(user, &image[y * rawbytes], rawbytes, (unsigned)y, count);
+  }
+  lodepng_free(image);
+  return state->error;
+}
+
 unsigned lodepng_decode_memory(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in,
                                size_t insize, LodePNGColorType colortype, unsigned bitdepth)
 {
@@ -4894,21 +5871,6 @@ static unsigned addChunk_tRNS(ucvector* out, const LodePNGColorMode* info)
   return error;
 }
 
-static unsigned addChunk_IDAT(ucvector* out, const unsigned char* data, size_t datasize,
-                              LodePNGCompressSettings* zlibsettings)
-{
-  ucvector zlibdata;
-  unsigned error = 0;
-
-  /*compress with the Zlib compressor*/
-  ucvector_init(&zlibdata);
-  error = zlib_compress(&zlibdata.data, &zlibdata.size, data, datasize, zlibsettings);
-  if(!error) error = addChunk(out, "IDAT", zlibdata.data, zlibdata.size);
-  ucvector_cleanup(&zlibdata);
-
-  return error;
-}
-
 static unsigned addChunk_IEND(ucvector* out)
 {
   unsigned error = 0;
@@ -5132,13 +6094,14 @@ static float flog2(float f)
   return result + 1.442695f * (f * f * f / 3 - 3 * f * f / 2 + 3 * f - 1.83333f);
 }
 
-static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h,
+static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned ybegin, unsigned yend,
                        const LodePNGColorMode* info, const LodePNGEncoderSettings* settings)
 {
   /*
   For PNG filter method 0
   out must be a buffer with as size: h + (w * h * bpp + 7) / 8, because there are
-  the scanlines with 1 extra byte per scanline
+  the scanlines with 1 extra byte per scanline. Only scanlines ybegin to yend are
+  filtered, so that separate ranges can be filtered concurrently
   */
 
   unsigned bpp = lodepng_get_bpp(info);
@@ -5146,7 +6109,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
   size_t linebytes = (w * bpp + 7) / 8;
   /*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
   size_t bytewidth = (bpp + 7) / 8;
-  const unsigned char* prevline = 0;
+  const unsigned char* prevline = ybegin ? &in[(ybegin - 1) * linebytes] : 0;
   unsigned x, y;
   unsigned error = 0;
   LodePNGFilterStrategy strategy = settings->filter_strategy;
@@ -5169,14 +6132,15 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
 
   if(bpp == 0) return 31; /*error: invalid color type*/
 
-  if(strategy == LFS_ZERO)
+  if(strategy == LFS_ZERO || strategy == LFS_FOUR)
   {
-    for(y = 0; y != h; ++y)
+    unsigned char type = strategy == LFS_FOUR ? 4 : 0;
+    for(y = ybegin; y != yend; ++y)
     {
       size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
       size_t inindex = linebytes * y;
-      out[outindex] = 0; /*filter type byte*/
-      filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, 0);
+      out[outindex] = type; /*filter type byte*/
+      filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, type);
       prevline = &in[inindex];
     }
   }
@@ -5196,7 +6160,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
 
     if(!error)
     {
-      for(y = 0; y != h; ++y)
+      for(y = ybegin; y != yend; ++y)
       {
         /*try the 5 filter types*/
         for(type = 0; type != 5; ++type)
@@ -5253,7 +6217,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
       if(!attempt[type]) return 83; /*alloc fail*/
     }
 
-    for(y = 0; y != h; ++y)
+    for(y = ybegin; y != yend; ++y)
     {
       /*try the 5 filter types*/
       for(type = 0; type != 5; ++type)
@@ -5287,7 +6251,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
   }
   else if(strategy == LFS_PREDEFINED)
   {
-    for(y = 0; y != h; ++y)
+    for(y = ybegin; y != yend; ++y)
     {
       size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
       size_t inindex = linebytes * y;
@@ -5322,7 +6286,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
       attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
       if(!attempt[type]) return 83; /*alloc fail*/
     }
-    for(y = 0; y != h; ++y) /*try the 5 filter types*/
+    for(y = ybegin; y != yend; ++y) /*try the 5 filter types*/
     {
       for(type = 0; type != 5; ++type)
       {
@@ -5464,14 +6428,14 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
         if(!error)
         {
           addPaddingBits(padded, in, ((w * bpp + 7) / 8) * 8, w * bpp, h);
-          error = filter(*out, padded, w, h, &info_png->color, settings);
+          error = filter(*out, padded, w, 0, h, &info_png->color, settings);
         }
         lodepng_free(padded);
       }
       else
       {
         /*we can immediately filter into the out buffer, no other steps needed*/
-        error = filter(*out, in, w, h, &info_png->color, settings);
+        error = filter(*out, in, w, 0, h, &info_png->color, settings);
       }
     }
   }
@@ -5504,13 +6468,13 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
           addPaddingBits(padded, &adam7[passstart[i]],
                          ((passw[i] * bpp + 7) / 8) * 8, passw[i] * bpp, passh[i]);
           error = filter(&(*out)[filter_passstart[i]], padded,
-                         passw[i], passh[i], &info_png->color, settings);
+                         passw[i], 0, passh[i], &info_png->color, settings);
           lodepng_free(padded);
         }
         else
         {
           error = filter(&(*out)[filter_passstart[i]], &adam7[padded_passstart[i]],
-                         passw[i], passh[i], &info_png->color, settings);
+                         passw[i], 0, passh[i], &info_png->color, settings);
         }
 
         if(error) break;
@@ -5523,6 +6487,139 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
   return error;
 }
 
+#ifdef LODEPNG_COMPILE_ZLIB
+/*The stripes of an image encoded by compressStripes, each filtered and deflated by its own task*/
+typedef struct EncodeStripes
+{
+  const unsigned char* in; /*the scanlines, padded to whole bytes*/
+  unsigned char* filtered; /*all the filtered scanlines, every stripe writes its own*/
+  unsigned w, h;
+  unsigned rows; /*per stripe, the last may have fewer*/
+  const LodePNGColorMode* color;
+  const LodePNGEncoderSettings* settings;
+  /*per stripe*/
+  ucvector* deflated;
+  unsigned* adler;
+  unsigned* error;
+} EncodeStripes;
+
+static void encodeStripe(void* data, size_t index)
+{
+  EncodeStripes* stripes = (EncodeStripes*)data;
+  size_t linebytes = (stripes->w * lodepng_get_bpp(stripes->color) + 7) / 8;
+  unsigned ybegin = (unsigned)index * stripes->rows;
+  unsigned yend = stripes->h - ybegin > stripes->rows ? ybegin + stripes->rows : stripes->h;
+  unsigned char* filtered = &stripes->filtered[(1 + linebytes) * ybegin];
+  size_t size = (1 + linebytes) * (yend - ybegin);
+  unsigned error = filter(stripes->filtered, stripes->in, stripes->w, ybegin, yend,
+                          stripes->color, stripes->settings);
+  if(!error)
+  {
+    error = deflateRange(&stripes->deflated[index], filtered, size, &stripes->settings->zlibsettings,
+                         yend == stripes->h);
+  }
+  if(!error) stripes->adler[index] = adler32(filtered, (unsigned)size);
+  stripes->error[index] = error;
+}
+
+/*
+Like preProcessScanlines followed by zlib_compress, for non-interlaced images only: in stripes
+of settings->stripe_rows scanlines, which are filtered and deflated independently, through
+settings->parallel_for if set. The deflate data of the stripes is joined into one zlib stream
+*/
+static unsigned compressStripes(ucvector* out, const unsigned char* in, unsigned w, unsigned h,
+                                const LodePNGInfo* info_png, const LodePNGEncoderSettings* settings)
+{
+  unsigned bpp = lodepng_get_bpp(&info_png->color);
+  size_t linebytes = (w * bpp + 7) / 8;
+  size_t count = (h + settings->stripe_rows - 1) / settings->stripe_rows;
+  size_t i;
+  unsigned error = 0;
+  unsigned adler = 1;
+  unsigned char* padded = 0;
+  EncodeStripes stripes;
+
+  stripes.in = in;
+  stripes.w = w;
+  stripes.h = h;
+  stripes.rows = settings->stripe_rows;
+  stripes.color = &info_png->color;
+  stripes.settings = settings;
+  stripes.filtered = (unsigned char*)lodepng_malloc(h * (1 + linebytes));
+  stripes.deflated = (ucvector*)lodepng_malloc(count * sizeof(ucvector));
+  stripes.adler = (unsigned*)lodepng_malloc(count * sizeof(unsigned));
+  stripes.error = (unsigned*)lodepng_malloc(count * sizeof(unsigned));
+  if(!stripes.filtered || !stripes.deflated || !stripes.adler || !stripes.error) error = 83; /*alloc fail*/
+
+  /*non multiple of 8 bits per scanline, padding bits needed per scanline*/
+  if(!error && bpp < 8 && w * bpp != linebytes * 8)
+  {
+    padded = (unsigned char*)lodepng_malloc(h * linebytes);
+    if(!padded) error = 83; /*alloc fail*/
+    else
+    {
+      addPaddingBits(padded, in, linebytes * 8, w * bpp, h);
+      stripes.in = padded;
+    }
+  }
+
+  if(!error)
+  {
+    for(i = 0; i != count; ++i) ucvector_init(&stripes.deflated[i]);
+    if(settings->parallel_for) settings->parallel_for(settings->parallel_context, count, encodeStripe, &stripes);
+    else for(i = 0; i != count; ++i) encodeStripe(&stripes, i);
+
+    /*the zlib header as lodepng_zlib_compress writes it, then the stripes in order*/
+    ucvector_push_back(out, 120);
+    ucvector_push_back(out, 1);
+    for(i = 0; i != count; ++i)
+    {
+      size_t stripesize = (1 + linebytes) * (h - i * stripes.rows > stripes.rows ? stripes.rows : h - i * stripes.rows);
+      if(!error) error = stripes.error[i];
+      if(!error)
+      {
+        size_t size = out->size;
+        if(!ucvector_resize(out, size + stripes.deflated[i].size)) error = 83; /*alloc fail*/
+        else if(stripes.deflated[i].size) memcpy(&out->data[size], stripes.deflated[i].data, stripes.deflated[i].size);
+        adler = i ? adler32_combine(adler, stripes.adler[i], stripesize) : stripes.adler[i];
+      }
+      ucvector_cleanup(&stripes.deflated[i]);
+    }
+    if(!error) lodepng_add32bitInt(out, adler);
+  }
+
+  lodepng_free(padded);
+  lodepng_free(stripes.filtered);
+  lodepng_free(stripes.deflated);
+  lodepng_free(stripes.adler);
+  lodepng_free(stripes.error);
+  return error;
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
+/*filter and zlib compress the image into the data of the IDAT chunks*/
+static unsigned compressScanlines(ucvector* out, const unsigned char* in, unsigned w, unsigned h,
+                                  const LodePNGInfo* info_png, const LodePNGEncoderSettings* settings)
+{
+  unsigned error;
+  unsigned char* data = 0; /*uncompressed version of the IDAT chunk data*/
+  size_t datasize = 0;
+
+#ifdef LODEPNG_COMPILE_ZLIB
+  /*stripes need the built in deflate, a custom one can't continue a stream*/
+  if(settings->stripe_rows && h > settings->stripe_rows && info_png->interlace_method == 0
+     && !settings->zlibsettings.custom_zlib && !settings->zlibsettings.custom_deflate)
+  {
+    return compressStripes(out, in, w, h, info_png, settings);
+  }
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
+  error = preProcessScanlines(&data, &datasize, in, w, h, info_png, settings);
+  if(!error) error = zlib_compress(&out->data, &out->size, data, datasize, &settings->zlibsettings);
+  lodepng_free(data);
+  return error;
+}
+
 /*
 palette must have 4 * palettesize bytes allocated, and given in format RGBARGBARGBARGBA...
 returns 0 if the palette is opaque,
@@ -5569,8 +6666,7 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
 {
   LodePNGInfo info;
   ucvector outv;
-  unsigned char* data = 0; /*uncompressed version of the IDAT chunk data*/
-  size_t datasize = 0;
+  ucvector idat; /*the zlib compressed data of the IDAT chunk*/
 
   /*provide some proper output values if error will happen*/
   *out = 0;
@@ -5579,6 +6675,7 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
 
   lodepng_info_init(&info);
   lodepng_info_copy(&info, &state->info_png);
+  ucvector_init(&idat);
 
   if((info.color.colortype == LCT_PALETTE || state->encoder.force_palette)
       && (info.color.palettesize == 0 || info.color.palettesize > 256))
@@ -5618,10 +6715,10 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
     {
       state->error = lodepng_convert(converted, image, &info.color, &state->info_raw, w, h);
     }
-    if(!state->error) preProcessScanlines(&data, &datasize, converted, w, h, &info, &state->encoder);
+    if(!state->error) state->error = compressScanlines(&idat, converted, w, h, &info, &state->encoder);
     lodepng_free(converted);
   }
-  else preProcessScanlines(&data, &datasize, image, w, h, &info, &state->encoder);
+  else state->error = compressScanlines(&idat, image, w, h, &info, &state->encoder);
 
   ucvector_init(&outv);
   while(!state->error) /*while only executed once, to break on error*/
@@ -5673,7 +6770,7 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
     }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
     /*IDAT (multiple IDAT chunks must be consecutive)*/
-    state->error = addChunk_IDAT(&outv, data, datasize, &state->encoder.zlibsettings);
+    state->error = addChunk(&outv, "IDAT", idat.data, idat.size);
     if(state->error) break;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
     /*tIME*/
@@ -5748,7 +6845,7 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
   }
 
   lodepng_info_cleanup(&info);
-  lodepng_free(data);
+  ucvector_cleanup(&idat);
   /*instead of cleaning the vector up, give it to the output*/
   *out = outv.data;
   *outsize = outv.size;
@@ -5813,12 +6910,26 @@ void lodepng_encoder_settings_init(LodePNGEncoderSettings* settings)
   settings->auto_convert = 1;
   settings->force_palette = 0;
   settings->predefined_filters = 0;
+  settings->stripe_rows = 0;
+  settings->parallel_for = 0;
+  settings->parallel_context = 0;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   settings->add_id = 0;
   settings->text_compression = 1;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 }
 
+void lodepng_encoder_settings_fast(LodePNGEncoderSettings* settings)
+{
+  /*Paeth is the best single filter for photographic and rendered images alike*/
+  settings->filter_strategy = LFS_FOUR;
+  /*greedy matching over a short hash chain: enough for the long runs of rendered frames*/
+  settings->zlibsettings.windowsize = 8192;
+  settings->zlibsettings.maxchainlength = 8;
+  settings->zlibsettings.nicematch = 32;
+  settings->zlibsettings.lazymatching = 0;
+}
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_PNG*/
 
@@ -5924,6 +7035,7 @@ const char* lodepng_error_text(unsigned code)
     case 92: return "too many pixels, not supported";
     case 93: return "zero width or height is invalid";
     case 94: return "header chunk must have a size of 13 bytes";
+    case 95: return "output buffer too small for the image at the given stride";
   }
   return "unknown error code";
 }
@@ -6085,6 +7197,15 @@ unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
   return decode(out, w, h, state, in.empty() ? 0 : &in[0], in.size());
 }
 
+unsigned decode(unsigned char* out, size_t stride, size_t outsize, unsigned& w, unsigned& h,
+                const unsigned char* in, size_t insize, LodePNGColorType colortype, unsigned bitdepth)
+{
+  State state;
+  state.info_raw.colortype = colortype;
+  state.info_raw.bitdepth = bitdepth;
+  return lodepng_decode_into(out, stride, outsize, &w, &h, &state, in, insize);
+}
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h, const std::string& filename,
                 LodePNGColorType colortype, unsigned bitdepth)
@@ -6143,6 +7264,24 @@ unsigned encode(std::vector<unsigned char>& out,
   return encode(out, in.empty() ? 0 : &in[0], w, h, state);
 }
 
+void parallel_for_threads(const void* context, size_t count, void (*task)(void* data, size_t index), void* data)
+{
+  unsigned threads = context ? *(const unsigned*)context : 0;
+  if(threads == 0) threads = std::thread::hardware_concurrency();
+  if(threads > count) threads = (unsigned)count;
+
+  /*the tasks are handed out in order through a shared counter, the calling thread takes its share too*/
+  std::atomic<size_t> next(0);
+  auto run = [&]()
+  {
+    for(size_t i = next++; i < count; i = next++) task(data, i);
+  };
+  std::vector<std::thread> pool;
+  for(unsigned i = 1; i < threads; ++i) pool.emplace_back(run);
+  run();
+  for(size_t i = 0; i != pool.size(); ++i) pool[i].join();
+}
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned encode(const std::string& filename,
                 const unsigned char* in, unsigned w, unsigned h,
@@ -256,6 +256,9 @@ typedef struct LodePNGDecompressSettings LodePNGDecompressSettings;
 struct LodePNGDecompressSettings
 {
   unsigned ignore_adler32; /*if 1, continue and don't give an error message if the Adler32 checksum is corrupted*/
+  /*decompressed size if known in advance (0 = unknown): the output is then allocated once at that
+  size instead of growing as it's decoded*/
+  size_t expected_output_size;
 
   /*use custom zlib decoder instead of built in one (default: null)*/
   unsigned (*custom_zlib)(unsigned char**, size_t*,
@@ -290,6 +293,9 @@ struct LodePNGCompressSettings /*deflate = compress*/
   unsigned minmatch; /*mininum lz77 length. 3 is normally best, 6 can be better for some PNGs. Default: 0*/
   unsigned nicematch; /*stop searching if >= this length found. Set to 258 for best compression. Default: 128*/
   unsigned lazymatching; /*use lazy matching: better compression but a bit slower. Default: true*/
+  /*hash chain entries compared per position: lower is faster but finds shorter matches.
+  Default: 0 = the window size from 8192 up, an eighth of it below*/
+  unsigned maxchainlength;
 
   /*use custom zlib encoder instead of built in one (default: null)*/
   unsigned (*custom_zlib)(unsigned char**, size_t*,
@@ -551,7 +557,9 @@ typedef enum LodePNGFilterStrategy
   */
   LFS_BRUTE_FORCE,
   /*use predefined_filters buffer: you specify the filter type for each scanline*/
-  LFS_PREDEFINED
+  LFS_PREDEFINED,
+  /*Paeth (filter type 4) on every scanline: no per-scanline search, for fast encoding*/
+  LFS_FOUR
 } LodePNGFilterStrategy;
 
 /*Gives characteristics about the colors of the image, which helps decide which color model to use for encoding.
@@ -605,6 +613,16 @@ typedef struct LodePNGEncoderSettings
   /*force creating a PLTE chunk if colortype is 2 or 6 (= a suggested palette).
   If colortype is 3, PLTE is _always_ created.*/
   unsigned force_palette;
+
+  /*encode non-interlaced images in stripes of this many scanlines, each filtered and deflated on
+  its own and joined into one zlib stream, so that stripes can be encoded concurrently. Every
+  stripe restarts LZ77 and the Huffman trees, for slightly larger files. Not used with a custom
+  zlib or deflate function. Default: 0 = one stream*/
+  unsigned stripe_rows;
+  /*if set, runs task(data, i) for every i from 0 to count, possibly concurrently, and returns once
+  all are done: stripes are encoded through it. lodepng::parallel_for_threads is one for C++. Default: null*/
+  void (*parallel_for)(const void* context, size_t count, void (*task)(void* data, size_t index), void* data);
+  const void* parallel_context; /*passed to parallel_for, e.g. the thread count. Default: null*/
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   /*add LodePNG identifier and version as a text chunk, for debugging*/
   unsigned add_id;
@@ -614,6 +632,14 @@ typedef struct LodePNGEncoderSettings
 } LodePNGEncoderSettings;
 
 void lodepng_encoder_settings_init(LodePNGEncoderSettings* settings);
+/*
+Tune initialized settings for encoding speed over size, e.g. to save captured frames at
+runtime: LFS_FOUR filtering instead of trying filters per scanline, and greedy LZ77 over a
+short hash chain. About a quarter faster than the defaults on 1080p frames, for files a few
+percent larger. Setting zlibsettings.btype to 0 afterwards stores the data uncompressed,
+several times faster again but about three times larger.
+*/
+void lodepng_encoder_settings_fast(LodePNGEncoderSettings* settings);
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 
@@ -651,6 +677,43 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                         LodePNGState* state,
                         const unsigned char* in, size_t insize);
 
+/*
+Same as lodepng_decode, but decodes into a buffer owned by the caller, such as a
+texture's staging memory, instead of allocating one: scanline y is written to
+out[y * stride], where stride is at least lodepng_get_raw_size(w, 1, &state->info_raw),
+and outsize must reach the end of the last scanline (error 95 otherwise). Get w and h
+with lodepng_inspect first to size it. Scanlines are converted to state->info_raw one
+at a time, so no image-sized buffer is allocated besides the inflated data (except for
+Adam7 interlaced PNGs). out is only written, never read.
+With fewer than 8 bits per pixel every scanline starts at a byte, unlike the packed
+output of lodepng_decode.
+*/
+unsigned lodepng_decode_into(unsigned char* out, size_t stride, size_t outsize,
+                             unsigned* w, unsigned* h, LodePNGState* state,
+                             const unsigned char* in, size_t insize);
+
+/*
+Receives the scanlines lodepng_decode_stream decodes: count of them starting at
+scanline y, in the color mode of state->info_raw, each starting stride bytes after
+the previous one at a byte (like lodepng_decode_into). The rows are only valid
+during the call. A nonzero return value stops the decode with that error code.
+*/
+typedef unsigned (*LodePNGRowCallback)(void* user, const unsigned char* rows, size_t stride,
+                                       unsigned y, unsigned count);
+
+/*
+Same as lodepng_decode, but streams the pixels to callback in bands of band_rows
+scanlines (the last band may have fewer) as they are inflated and unfiltered, so
+they can be used, e.g. uploaded with glTexSubImage2D, while later ones still decode.
+Besides the compressed image data, memory stays at the 32KB deflate window plus a
+band of scanlines, however large the image. Adam7 interlaced PNGs, and decoders set
+to use custom_zlib or custom_inflate, are decoded whole first and then handed out
+band by band.
+*/
+unsigned lodepng_decode_stream(unsigned* w, unsigned* h, LodePNGState* state,
+                               const unsigned char* in, size_t insize, unsigned band_rows,
+                               LodePNGRowCallback callback, void* user);
+
 /*
 Read the PNG header, but not the actual data. This returns only the information
 that is in the header chunk of the PNG, such as width, height and color type. The
@@ -834,6 +897,11 @@ unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
 unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
                 State& state,
                 const std::vector<unsigned char>& in);
+/*Same as lodepng_decode_into, decoding to the caller's out buffer with the given stride.
+The colortype is the format to output the pixels to. Default is RGBA 8-bit per channel.*/
+unsigned decode(unsigned char* out, size_t stride, size_t outsize, unsigned& w, unsigned& h,
+                const unsigned char* in, size_t insize,
+                LodePNGColorType colortype = LCT_RGBA, unsigned bitdepth = 8);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -844,6 +912,15 @@ unsigned encode(std::vector<unsigned char>& out,
 unsigned encode(std::vector<unsigned char>& out,
                 const std::vector<unsigned char>& in, unsigned w, unsigned h,
                 State& state);
+
+/*
+A LodePNGEncoderSettings::parallel_for on std::threads: context points to the unsigned number of
+threads, the calling one included (null or 0 = one per core). For example, to encode in stripes
+on every core:
+  state.encoder.stripe_rows = 64;
+  state.encoder.parallel_for = lodepng::parallel_for_threads;
+*/
+void parallel_for_threads(const void* context, size_t count, void (*task)(void* data, size_t index), void* data);
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 #ifdef LODEPNG_COMPILE_DISK
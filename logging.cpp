@@ -0,0 +1,275 @@
+#include "logging.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+std::atomic<int> Log::level_threshold((int)LogLevel::Info);
+std::atomic<unsigned> Log::muted(0);
+std::atomic<bool> Log::synchronous(false);
+std::atomic<uint64_t> Log::dropped(0);
+
+static const char* CATEGORY_NAMES[Log::CATEGORIES] = { "app", "tree", "render", "shader", "texture", "capture" };
+
+// === QUEUE ===
+// A bounded multi-producer ring (Vyukov's): slot k takes message n when its
+// sequence is n, and holds it once the sequence is n + 1. The writer frees
+// it for message n + QUEUE_MESSAGES
+
+struct LogMessage {
+    std::atomic<size_t> sequence;
+    LogLevel level;
+    unsigned short length;
+    char text[Log::MESSAGE_BYTES];
+};
+
+struct LogQueue {
+    LogMessage messages[Log::QUEUE_MESSAGES];
+    std::atomic<size_t> enqueued; // Next message number to claim
+    std::atomic<size_t> written;  // Messages the writer is done with
+    std::atomic<bool> stopping;
+    std::thread writer;
+    std::once_flag started;
+    std::mutex output_mutex; // Between the writer and synchronous messages
+    
+    LogQueue() : enqueued(0), written(0), stopping(false) {
+        for (int k = 0; k < Log::QUEUE_MESSAGES; k++) {
+            messages[k].sequence.store(k, std::memory_order_relaxed);
+        }
+    }
+};
+
+// Never freed, so messages of threads still running at exit find it
+static LogQueue& logQueue() {
+    static LogQueue* instance = new LogQueue();
+    return *instance;
+}
+
+static void writeMessage(LogLevel level, const char* text, size_t length) {
+    FILE* stream = level == LogLevel::Error ? stderr : stdout;
+    fwrite(text, 1, length, stream);
+    fputc('\n', stream);
+}
+
+// Drain what's queued, flushing once a batch is out, and say what a full
+// queue dropped since the last batch; sleep while empty
+static void writerLoop() {
+    LogQueue& queue = logQueue();
+    size_t next = queue.written.load(std::memory_order_relaxed);
+    uint64_t reported = 0;
+    for (;;) {
+        bool any = false;
+        {
+            std::lock_guard<std::mutex> lock(queue.output_mutex);
+            for (;;) {
+                LogMessage& message = queue.messages[next % Log::QUEUE_MESSAGES];
+                if (message.sequence.load(std::memory_order_acquire) != next + 1) break;
+                writeMessage(message.level, message.text, message.length);
+                message.sequence.store(next + Log::QUEUE_MESSAGES, std::memory_order_release);
+                next++;
+                any = true;
+            }
+            const uint64_t dropped = Log::getDropped();
+            if (dropped > reported) {
+                fprintf(stdout, "(%llu log messages dropped, the queue was full)\n",
+                        (unsigned long long)(dropped - reported));
+                reported = dropped;
+                any = true;
+            }
+            if (any) {
+                fflush(stdout);
+                fflush(stderr);
+            }
+        }
+        queue.written.store(next, std::memory_order_release);
+        if (any) continue;
+        if (queue.stopping.load(std::memory_order_acquire)) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+static void stopWriter() {
+    LogQueue& queue = logQueue();
+    Log::flush();
+    queue.stopping.store(true, std::memory_order_release);
+    if (queue.writer.joinable()) queue.writer.join();
+}
+
+void Log::start() {
+    LogQueue& queue = logQueue();
+    std::call_once(queue.started, [&queue]() {
+        queue.writer = std::thread(writerLoop);
+        atexit(stopWriter);
+    });
+}
+
+// === MESSAGES ===
+
+void Log::setCategoryEnabled(LogCategory category, bool on) {
+    if (on) muted.fetch_and(~(1u << (int)category), std::memory_order_relaxed);
+    else muted.fetch_or(1u << (int)category, std::memory_order_relaxed);
+}
+
+bool Log::muteCategories(const std::string& names) {
+    unsigned mask = 0;
+    size_t begin = 0;
+    while (begin <= names.size()) {
+        size_t end = names.find(',', begin);
+        if (end == std::string::npos) end = names.size();
+        std::string name = names.substr(begin, end - begin);
+        int c = 0;
+        while (c < CATEGORIES && name != CATEGORY_NAMES[c]) {
+            c++;
+        }
+        if (c == CATEGORIES) return false;
+        mask |= 1u << c;
+        begin = end + 1;
+    }
+    muted.fetch_or(mask, std::memory_order_relaxed);
+    return true;
+}
+
+void Log::push(LogLevel level, const char* text, size_t length) {
+    if (length >= (size_t)MESSAGE_BYTES) length = MESSAGE_BYTES - 1;
+    LogQueue& queue = logQueue();
+    if (synchronous.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(queue.output_mutex);
+        writeMessage(level, text, length);
+        fflush(level == LogLevel::Error ? stderr : stdout);
+        return;
+    }
+    start();
+    size_t position = queue.enqueued.load(std::memory_order_relaxed);
+    LogMessage* message;
+    for (;;) {
+        message = &queue.messages[position % QUEUE_MESSAGES];
+        size_t sequence = message->sequence.load(std::memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            if (queue.enqueued.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        } else if (difference < 0) {
+            // Full: the writer hasn't freed the slot a lap ago
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = queue.enqueued.load(std::memory_order_relaxed);
+        }
+    }
+    message->level = level;
+    message->length = (unsigned short)length;
+    memcpy(message->text, text, length);
+    message->sequence.store(position + 1, std::memory_order_release);
+}
+
+void Log::write(LogLevel level, LogCategory category, const std::string& text) {
+    if (!isEnabled(level, category)) return;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos) end = text.size();
+        // Long lines go out in pieces rather than cut short
+        size_t piece = begin;
+        do {
+            size_t piece_length = std::min<size_t>(end - piece, MESSAGE_BYTES - 1);
+            push(level, text.data() + piece, piece_length);
+            piece += piece_length;
+        } while (piece < end);
+        begin = end + 1;
+    }
+}
+
+void Log::flush() {
+    LogQueue& queue = logQueue();
+    const size_t target = queue.enqueued.load(std::memory_order_acquire);
+    if (!queue.writer.joinable()) return;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (queue.written.load(std::memory_order_acquire) < target && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool Log::admit(LogSite& site, unsigned& suppressed) {
+    const uint64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (site.second.load(std::memory_order_relaxed) != second) {
+        site.second.store(second, std::memory_order_relaxed);
+        site.count.store(0, std::memory_order_relaxed);
+    }
+    if (site.count.fetch_add(1, std::memory_order_relaxed) >= RATE_LIMIT) {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+// === LINES ===
+
+LogLine::LogLine(LogLevel line_level, LogCategory line_category, LogSite& site)
+    : level(line_level), category(line_category), active(false), suppressed(0), length(0) {
+    active = Log::isEnabled(level, category) && Log::admit(site, suppressed);
+}
+
+LogLine::~LogLine() {
+    if (!active) return;
+    if (suppressed > 0) appendFormatted(" (%u more suppressed)", suppressed);
+    Log::push(level, text, length);
+}
+
+void LogLine::appendFormatted(const char* format, ...) {
+    if (length >= sizeof(text) - 1) return;
+    va_list arguments;
+    va_start(arguments, format);
+    int written = vsnprintf(text + length, sizeof(text) - length, format, arguments);
+    va_end(arguments);
+    if (written > 0) length = std::min(length + written, sizeof(text) - 1);
+}
+
+LogLine& LogLine::operator<<(const char* value) {
+    if (active) appendFormatted("%s", value);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(char c) {
+    if (active) appendFormatted("%c", c);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(int value) {
+    if (active) appendFormatted("%d", value);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(unsigned value) {
+    if (active) appendFormatted("%u", value);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(long value) {
+    if (active) appendFormatted("%ld", value);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(unsigned long value) {
+    if (active) appendFormatted("%lu", value);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(long long value) {
+    if (active) appendFormatted("%lld", value);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(unsigned long long value) {
+    if (active) appendFormatted("%llu", value);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(double value) {
+    if (active) appendFormatted("%g", value);
+    return *this;
+}
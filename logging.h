@@ -0,0 +1,121 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Console messages off the calling thread: a message is formatted into a
+// fixed buffer on the caller's stack and copied into a bounded lock-free
+// queue, which a background thread drains to stdout (errors to stderr) and
+// flushes. Logging is then a few stores and never a write syscall, however
+// slow the terminal or the pipe; with the queue full a message is dropped
+// and counted rather than waited for.
+//
+//   LOG_INFO(Tree) << "Tree fully grown at " << time << " s";
+//
+// Each LOG_* line is a call site of its own, passing at most RATE_LIMIT
+// messages a second; the next one passed after a burst says how many were
+// suppressed. Messages below the level or of a muted category cost one
+// check, though their arguments are still evaluated. Log::flush() waits for
+// the queue to drain, as at exit (which flushes all the same)
+
+enum class LogLevel { Error, Warning, Info, Debug };
+
+enum class LogCategory { App, Tree, Render, Shader, Texture, Capture };
+
+// Rate limit state of one call site; approximate under contention
+struct LogSite {
+    std::atomic<uint64_t> second;     // Of the current window, on the steady clock
+    std::atomic<unsigned> count;      // Messages in the window
+    std::atomic<unsigned> suppressed; // Since the last one passed
+    
+    LogSite() : second(0), count(0), suppressed(0) {}
+};
+
+class Log {
+public:
+    static const int MESSAGE_BYTES = 512; // Longer messages are cut short
+    static const int QUEUE_MESSAGES = 1024;
+    static const int CATEGORIES = 6;
+    static const unsigned RATE_LIMIT = 10; // Messages per second per call site
+    
+    // Info by default; -v -v in tree_demo shows Debug
+    static void setLevel(LogLevel level) { level_threshold.store((int)level, std::memory_order_relaxed); }
+    static void setCategoryEnabled(LogCategory category, bool on);
+    // A comma-separated list of category names (app, tree, render, shader,
+    // texture, capture) muted; false, muting none, on an unknown name
+    static bool muteCategories(const std::string& names);
+    static bool isEnabled(LogLevel level, LogCategory category) {
+        return (int)level <= level_threshold.load(std::memory_order_relaxed) &&
+               (muted.load(std::memory_order_relaxed) & (1u << (int)category)) == 0;
+    }
+    // Write on the calling thread as each message is made, for debugging a
+    // crash whose last messages would otherwise still be queued
+    static void setSynchronous(bool on) { synchronous.store(on, std::memory_order_relaxed); }
+    
+    // Start the writer thread now rather than at the first message, which
+    // would allocate for it
+    static void start();
+    // Each line of text a message of its own, not rate limited: reports
+    // written to a stream first
+    static void write(LogLevel level, LogCategory category, const std::string& text);
+    // One message of length bytes, cut short at MESSAGE_BYTES - 1; the
+    // caller checked isEnabled()
+    static void push(LogLevel level, const char* text, size_t length);
+    // Wait, up to a second, until every message pushed so far is written
+    static void flush();
+    static uint64_t getDropped() { return dropped.load(std::memory_order_relaxed); }
+    
+    // Whether a message may pass site's rate limit; suppressed is set to the
+    // messages it held back since the last that passed
+    static bool admit(LogSite& site, unsigned& suppressed);
+
+private:
+    static std::atomic<int> level_threshold;
+    static std::atomic<unsigned> muted;
+    static std::atomic<bool> synchronous;
+    static std::atomic<uint64_t> dropped;
+};
+
+// One message, formatted with the stream operators and pushed when the
+// line ends
+class LogLine {
+public:
+    LogLine(LogLevel level, LogCategory category, LogSite& site);
+    ~LogLine();
+    
+    LogLine& operator<<(const char* text);
+    LogLine& operator<<(const std::string& text) { return *this << text.c_str(); }
+    LogLine& operator<<(char c);
+    LogLine& operator<<(int value);
+    LogLine& operator<<(unsigned value);
+    LogLine& operator<<(long value);
+    LogLine& operator<<(unsigned long value);
+    LogLine& operator<<(long long value);
+    LogLine& operator<<(unsigned long long value);
+    LogLine& operator<<(double value); // As std::cout would, 6 significant digits
+
+private:
+    LogLevel level;
+    LogCategory category;
+    bool active;         // Enabled and admitted by the site
+    unsigned suppressed; // Said at the end of the line
+    size_t length;
+    char text[Log::MESSAGE_BYTES];
+    
+    void appendFormatted(const char* format, ...);
+    
+    LogLine(const LogLine&);
+    LogLine& operator=(const LogLine&);
+};
+
+// A static LogSite per expansion
+#define LOG_SITE() ([]() -> LogSite& { static LogSite site; return site; }())
+#define LOG_ERROR(category) LogLine(LogLevel::Error, LogCategory::category, LOG_SITE())
+#define LOG_WARNING(category) LogLine(LogLevel::Warning, LogCategory::category, LOG_SITE())
+#define LOG_INFO(category) LogLine(LogLevel::Info, LogCategory::category, LOG_SITE())
+#define LOG_DEBUG(category) LogLine(LogLevel::Debug, LogCategory::category, LOG_SITE())
+
+#endif // LOGGING_H
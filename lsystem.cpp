@@ -0,0 +1,677 @@
+#include "lsystem.h"
+#include "tree_simple.h"
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <algorithm>
+
+// === PARSER ===
+// Recursive descent over one statement, emitting bytecode as it goes. Formal
+// parameters resolve to Param slots and #define constants to literals at
+// compile time, so evaluation never looks anything up by name
+namespace {
+
+struct GrammarParser {
+    const std::string& text;
+    size_t pos;
+    const std::vector<std::string>& formals;
+    const std::map<std::string, float>& defines;
+    std::vector<LSystemInstruction>& code;
+    int depth;
+    int max_depth;
+    std::string error;
+    
+    GrammarParser(const std::string& line, const std::vector<std::string>& formal_names,
+                  const std::map<std::string, float>& constants, std::vector<LSystemInstruction>& out)
+        : text(line), pos(0), formals(formal_names), defines(constants), code(out), depth(0), max_depth(0) {}
+    
+    void skipSpace() {
+        while (pos < text.size() && std::isspace((unsigned char)text[pos])) pos++;
+    }
+    
+    bool atEnd() {
+        skipSpace();
+        return pos >= text.size();
+    }
+    
+    bool accept(const char* token) {
+        skipSpace();
+        size_t length = std::char_traits<char>::length(token);
+        if (text.compare(pos, length, token) != 0) return false;
+        pos += length;
+        return true;
+    }
+    
+    bool fail(const std::string& message) {
+        if (error.empty()) {
+            std::ostringstream os;
+            os << message << " at column " << (pos + 1);
+            error = os.str();
+        }
+        return false;
+    }
+    
+    // Stack effect of each instruction is tracked so MAX_STACK is a compile-time guarantee
+    void emit(LSystemOp op, int stack_effect, int param = 0, float value = 0.0f) {
+        LSystemInstruction instruction;
+        instruction.op = op;
+        instruction.param = param;
+        instruction.value = value;
+        code.push_back(instruction);
+        depth += stack_effect;
+        max_depth = std::max(max_depth, depth);
+    }
+    
+    bool parseIdentifier(std::string& name) {
+        skipSpace();
+        size_t begin = pos;
+        while (pos < text.size() && (std::isalnum((unsigned char)text[pos]) || text[pos] == '_')) pos++;
+        name = text.substr(begin, pos - begin);
+        return !name.empty() && !std::isdigit((unsigned char)name[0]);
+    }
+    
+    bool parsePrimary() {
+        skipSpace();
+        if (pos >= text.size()) return fail("expression expected");
+        char c = text[pos];
+        if (std::isdigit((unsigned char)c) || c == '.') {
+            const char* begin = text.c_str() + pos;
+            char* end = 0;
+            float value = std::strtof(begin, &end);
+            if (end == begin) return fail("bad number");
+            pos += end - begin;
+            emit(LSystemOp::Const, 1, 0, value);
+            return true;
+        }
+        if (accept("(")) {
+            if (!parseExpression()) return false;
+            if (!accept(")")) return fail("')' expected");
+            return true;
+        }
+        std::string name;
+        if (!parseIdentifier(name)) return fail("unexpected character");
+        if (name == "rand") {
+            if (!accept("(") || !parseExpression() || !accept(",") || !parseExpression() || !accept(")")) {
+                return fail("rand(a, b) expected");
+            }
+            emit(LSystemOp::Rand, -1);
+            return true;
+        }
+        for (size_t i = 0; i < formals.size(); i++) {
+            if (formals[i] == name) {
+                emit(LSystemOp::Param, 1, i);
+                return true;
+            }
+        }
+        std::map<std::string, float>::const_iterator constant = defines.find(name);
+        if (constant == defines.end()) return fail("unknown name '" + name + "'");
+        emit(LSystemOp::Const, 1, 0, constant->second);
+        return true;
+    }
+    
+    bool parseUnary() {
+        if (accept("-")) {
+            if (!parseUnary()) return false;
+            emit(LSystemOp::Neg, 0);
+            return true;
+        }
+        return parsePrimary();
+    }
+    
+    bool parseProduct() {
+        if (!parseUnary()) return false;
+        for (;;) {
+            LSystemOp op;
+            if (accept("*")) op = LSystemOp::Mul;
+            else if (accept("/")) op = LSystemOp::Div;
+            else return true;
+            if (!parseUnary()) return false;
+            emit(op, -1);
+        }
+    }
+    
+    bool parseSum() {
+        if (!parseProduct()) return false;
+        for (;;) {
+            LSystemOp op;
+            if (accept("+")) op = LSystemOp::Add;
+            else if (accept("-")) op = LSystemOp::Sub;
+            else return true;
+            if (!parseProduct()) return false;
+            emit(op, -1);
+        }
+    }
+    
+    bool parseComparison() {
+        if (!parseSum()) return false;
+        LSystemOp op;
+        // Two-character operators first so "<=" isn't read as "<"
+        if (accept("<=")) op = LSystemOp::LessEqual;
+        else if (accept(">=")) op = LSystemOp::GreaterEqual;
+        else if (accept("==")) op = LSystemOp::Equal;
+        else if (accept("!=")) op = LSystemOp::NotEqual;
+        else if (accept("<")) op = LSystemOp::Less;
+        else if (accept(">")) op = LSystemOp::Greater;
+        else return true;
+        if (!parseSum()) return false;
+        emit(op, -1);
+        return true;
+    }
+    
+    bool parseConjunction() {
+        if (!parseComparison()) return false;
+        while (accept("&&")) {
+            if (!parseComparison()) return false;
+            emit(LSystemOp::And, -1);
+        }
+        return true;
+    }
+    
+    bool parseExpression() {
+        if (!parseConjunction()) return false;
+        while (accept("||")) {
+            if (!parseConjunction()) return false;
+            emit(LSystemOp::Or, -1);
+        }
+        return true;
+    }
+    
+    // One complete expression; its bytecode range is returned in expression
+    bool compileExpression(LSystemExpression& expression) {
+        expression.begin = code.size();
+        depth = 0;
+        if (!parseExpression()) return false;
+        if (max_depth > LSystemGrammar::MAX_STACK) return fail("expression too deep");
+        expression.end = code.size();
+        return true;
+    }
+    
+    // Module list of an axiom or successor: symbols with optional
+    // parenthesized parameter expressions
+    bool parseModules(std::vector<LSystemSuccessorModule>& modules, std::vector<LSystemExpression>& params) {
+        while (!atEnd()) {
+            char c = text[pos];
+            if (c == '(' || c == ')' || c == ',') return fail("module symbol expected");
+            pos++;
+            LSystemSuccessorModule module;
+            module.symbol = (unsigned char)c;
+            module.param_count = 0;
+            module.first_param = params.size();
+            skipSpace();
+            if (pos < text.size() && text[pos] == '(') {
+                pos++;
+                do {
+                    if (module.param_count == LSYSTEM_MAX_PARAMS) return fail("too many parameters");
+                    LSystemExpression expression;
+                    if (!compileExpression(expression)) return false;
+                    params.push_back(expression);
+                    module.param_count++;
+                } while (accept(","));
+                if (!accept(")")) return fail("')' expected");
+            }
+            modules.push_back(module);
+        }
+        return true;
+    }
+};
+
+static std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return std::string();
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+} // namespace
+
+LSystemGrammar::LSystemGrammar() {
+    first_axiom = 0;
+    axiom_count = 0;
+    derivations = 0;
+    source_hash = 0;
+}
+
+bool LSystemGrammar::compile(const std::string& source, std::string& error) {
+    rules.clear();
+    rule_first.assign(257, 0);
+    successors.clear();
+    param_expressions.clear();
+    code.clear();
+    first_axiom = 0;
+    axiom_count = 0;
+    derivations = 0;
+    source_hash = 0;
+    
+    std::map<std::string, float> defines;
+    std::vector<std::string> no_formals;
+    std::vector<LSystemSuccessorModule> axiom_modules;
+    std::istringstream lines(source);
+    std::string raw;
+    int line_number = 0;
+    bool ok = true;
+    
+    while (ok && std::getline(lines, raw)) {
+        line_number++;
+        std::string line = trim(raw);
+        std::ostringstream where;
+        where << "line " << line_number << ": ";
+        
+        // === #define NAME value ===
+        if (line.compare(0, 8, "#define ") == 0) {
+            std::vector<LSystemInstruction> scratch;
+            GrammarParser parser(line, no_formals, defines, scratch);
+            parser.pos = 8;
+            std::string name;
+            LSystemExpression value;
+            if (!parser.parseIdentifier(name)) {
+                error = where.str() + "constant name expected";
+                ok = false;
+            } else if (!parser.compileExpression(value) || !parser.atEnd()) {
+                error = where.str() + (parser.error.empty() ? "end of line expected" : parser.error);
+                ok = false;
+            } else {
+                // Constants fold to a literal; rand() here would be drawn once
+                std::mt19937_64 fold_rng(0);
+                code.swap(scratch);
+                defines[name] = evaluate(value, 0, fold_rng);
+                code.swap(scratch);
+            }
+            continue;
+        }
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line = trim(line.substr(0, comment));
+        if (line.empty()) continue;
+        
+        // === derivations: N ===
+        if (line.compare(0, 12, "derivations:") == 0) {
+            derivations = std::max(0, std::atoi(line.c_str() + 12));
+            continue;
+        }
+        
+        // === axiom: modules ===
+        if (line.compare(0, 6, "axiom:") == 0) {
+            GrammarParser parser(line, no_formals, defines, code);
+            parser.pos = 6;
+            axiom_modules.clear();
+            if (!parser.parseModules(axiom_modules, param_expressions)) {
+                error = where.str() + parser.error;
+                ok = false;
+            }
+            continue;
+        }
+        
+        // === RULE: pred(formals) : condition @ weight -> successor ===
+        size_t arrow = line.find("->");
+        if (arrow == std::string::npos) {
+            error = where.str() + "'->' expected";
+            ok = false;
+            continue;
+        }
+        std::string head = line.substr(0, arrow);
+        std::string body = line.substr(arrow + 2);
+        if (trim(head).empty()) {
+            error = where.str() + "predecessor expected";
+            ok = false;
+            continue;
+        }
+        
+        LSystemRule rule;
+        rule.predecessor = (unsigned char)head[0];
+        rule.param_count = 0;
+        rule.condition.begin = rule.condition.end = 0;
+        rule.weight = 1.0f;
+        std::vector<std::string> formals;
+        
+        size_t pos = 1;
+        while (pos < head.size() && std::isspace((unsigned char)head[pos])) pos++;
+        if (pos < head.size() && head[pos] == '(') {
+            size_t close = head.find(')', pos);
+            if (close == std::string::npos) {
+                error = where.str() + "')' expected after formal parameters";
+                ok = false;
+                continue;
+            }
+            std::istringstream names(head.substr(pos + 1, close - pos - 1));
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                formals.push_back(trim(name));
+            }
+            pos = close + 1;
+        }
+        if (formals.size() > (size_t)LSYSTEM_MAX_PARAMS) {
+            error = where.str() + "too many formal parameters";
+            ok = false;
+            continue;
+        }
+        rule.param_count = formals.size();
+        
+        GrammarParser parser(head, formals, defines, code);
+        parser.pos = pos;
+        if (parser.accept(":") && !parser.compileExpression(rule.condition)) {
+            error = where.str() + parser.error;
+            ok = false;
+            continue;
+        }
+        if (parser.accept("@")) {
+            LSystemExpression weight;
+            if (!parser.compileExpression(weight)) {
+                error = where.str() + parser.error;
+                ok = false;
+                continue;
+            }
+            std::mt19937_64 fold_rng(0);
+            rule.weight = std::max(0.0f, evaluate(weight, 0, fold_rng));
+            code.resize(weight.begin); // Folded, no need to keep it
+        }
+        if (!parser.atEnd()) {
+            error = where.str() + "'->' expected";
+            ok = false;
+            continue;
+        }
+        
+        GrammarParser successor_parser(body, formals, defines, code);
+        std::vector<LSystemSuccessorModule> modules;
+        if (!successor_parser.parseModules(modules, param_expressions)) {
+            error = where.str() + successor_parser.error;
+            ok = false;
+            continue;
+        }
+        rule.first_successor = successors.size();
+        rule.successor_count = modules.size();
+        successors.insert(successors.end(), modules.begin(), modules.end());
+        rules.push_back(rule);
+    }
+    
+    if (ok && axiom_modules.empty()) {
+        error = "no axiom";
+        ok = false;
+    }
+    if (!ok) {
+        rules.clear();
+        successors.clear();
+        param_expressions.clear();
+        code.clear();
+        return false;
+    }
+    
+    first_axiom = successors.size();
+    axiom_count = axiom_modules.size();
+    successors.insert(successors.end(), axiom_modules.begin(), axiom_modules.end());
+    
+    // === RULE TABLE ===
+    // Group rules by predecessor (keeping their written order, which breaks
+    // ties) so a module finds its candidates with two lookups
+    std::stable_sort(rules.begin(), rules.end(), [](const LSystemRule& a, const LSystemRule& b) {
+        return a.predecessor < b.predecessor;
+    });
+    for (const LSystemRule& rule : rules) {
+        rule_first[rule.predecessor + 1]++;
+    }
+    for (int s = 0; s < 256; s++) {
+        rule_first[s + 1] += rule_first[s];
+    }
+    source_hash = 14695981039346656037ULL;
+    for (unsigned char c : source) {
+        source_hash ^= c;
+        source_hash *= 1099511628211ULL;
+    }
+    return true;
+}
+
+float LSystemGrammar::evaluate(const LSystemExpression& expression, const float* params, std::mt19937_64& rng) const {
+    if (expression.begin == expression.end) return 1.0f;
+    
+    float stack[MAX_STACK];
+    int top = 0;
+    for (int i = expression.begin; i < expression.end; i++) {
+        const LSystemInstruction& instruction = code[i];
+        switch (instruction.op) {
+        case LSystemOp::Const: stack[top++] = instruction.value; break;
+        case LSystemOp::Param: stack[top++] = params[instruction.param]; break;
+        case LSystemOp::Neg: stack[top - 1] = -stack[top - 1]; break;
+        case LSystemOp::Rand: {
+            float a = stack[top - 2];
+            float b = stack[top - 1];
+            top--;
+            std::uniform_real_distribution<float> dist(std::min(a, b), std::max(a, b));
+            stack[top - 1] = dist(rng);
+            break;
+        }
+        default: {
+            float a = stack[top - 2];
+            float b = stack[top - 1];
+            float r = 0.0f;
+            switch (instruction.op) {
+            case LSystemOp::Add: r = a + b; break;
+            case LSystemOp::Sub: r = a - b; break;
+            case LSystemOp::Mul: r = a * b; break;
+            case LSystemOp::Div: r = (b != 0.0f) ? a / b : 0.0f; break;
+            case LSystemOp::Less: r = a < b; break;
+            case LSystemOp::Greater: r = a > b; break;
+            case LSystemOp::LessEqual: r = a <= b; break;
+            case LSystemOp::GreaterEqual: r = a >= b; break;
+            case LSystemOp::Equal: r = a == b; break;
+            case LSystemOp::NotEqual: r = a != b; break;
+            case LSystemOp::And: r = (a != 0.0f) && (b != 0.0f); break;
+            case LSystemOp::Or: r = (a != 0.0f) || (b != 0.0f); break;
+            default: break;
+            }
+            top--;
+            stack[top - 1] = r;
+            break;
+        }
+        }
+    }
+    return stack[0];
+}
+
+void LSystemGrammar::derive(LSystemWorkspace& workspace, int steps, std::mt19937_64& rng) const {
+    std::vector<LSystemModule>& current = workspace.current;
+    std::vector<LSystemModule>& next = workspace.next;
+    
+    // Append the instantiated successor modules [first, first + count),
+    // reading formal parameters from params
+    auto expand = [&](int first, int count, const float* params, std::vector<LSystemModule>& out) {
+        for (int k = first; k < first + count; k++) {
+            const LSystemSuccessorModule& successor = successors[k];
+            LSystemModule module;
+            module.symbol = successor.symbol;
+            module.param_count = successor.param_count;
+            for (int p = 0; p < successor.param_count; p++) {
+                module.params[p] = evaluate(param_expressions[successor.first_param + p], params, rng);
+            }
+            out.push_back(module);
+        }
+    };
+    
+    current.clear();
+    expand(first_axiom, axiom_count, 0, current);
+    
+    // Candidate rules of one module; a grammar rarely has more than a few per symbol
+    std::vector<int> candidates;
+    
+    for (int step = 0; step < steps && current.size() < MAX_MODULES; step++) {
+        // === ONE PARALLEL REWRITE: current -> next, then swap ===
+        // Both strings keep their capacity across steps and derivations
+        next.clear();
+        for (const LSystemModule& module : current) {
+            candidates.clear();
+            float total_weight = 0.0f;
+            for (int r = rule_first[module.symbol]; r < rule_first[module.symbol + 1]; r++) {
+                const LSystemRule& rule = rules[r];
+                if (rule.param_count != module.param_count) continue;
+                if (evaluate(rule.condition, module.params, rng) == 0.0f) continue;
+                candidates.push_back(r);
+                total_weight += rule.weight;
+            }
+            if (candidates.empty()) {
+                next.push_back(module); // No rule: the module copies itself
+                continue;
+            }
+            
+            int chosen = candidates[0];
+            if (candidates.size() > 1) {
+                std::uniform_real_distribution<float> pick(0.0f, total_weight);
+                float target = pick(rng);
+                for (int r : candidates) {
+                    chosen = r;
+                    target -= rules[r].weight;
+                    if (target < 0.0f) break;
+                }
+            }
+            expand(rules[chosen].first_successor, rules[chosen].successor_count, module.params, next);
+        }
+        current.swap(next);
+    }
+}
+
+// Rotate v about the unit axis by angle radians (Rodrigues)
+static glm::vec3 rotateAbout(glm::vec3 v, glm::vec3 axis, float angle) {
+    float c = cosf(angle);
+    float s = sinf(angle);
+    return v * c + glm::cross(axis, v) * s + axis * glm::dot(axis, v) * (1.0f - c);
+}
+
+void LSystemGrammar::interpret(const std::vector<LSystemModule>& modules, std::vector<TreeBranch>& branches,
+                               std::vector<TreeLeaf>& leaves) const {
+    // === TURTLE STATE ===
+    // heading x left = up; brackets save and restore the whole state
+    struct Turtle {
+        glm::vec3 position;
+        glm::vec3 heading;
+        glm::vec3 left;
+        glm::vec3 up;
+        float width;
+        int branch; // Last branch drawn on this path, parent of the next
+        int generation;
+    };
+    Turtle turtle;
+    turtle.position = glm::vec3(0.0f);
+    turtle.heading = glm::vec3(0.0f, 1.0f, 0.0f);
+    turtle.left = glm::vec3(-1.0f, 0.0f, 0.0f);
+    turtle.up = glm::vec3(0.0f, 0.0f, 1.0f);
+    turtle.width = 0.1f;
+    turtle.branch = -1;
+    turtle.generation = 0;
+    std::vector<Turtle> stack;
+    
+    const float to_radians = (float)M_PI / 180.0f;
+    for (const LSystemModule& module : modules) {
+        float a = module.param_count > 0 ? module.params[0] : 0.0f;
+        switch (module.symbol) {
+        case 'F': {
+            TreeBranch branch;
+            branch.start = turtle.position;
+            branch.end = turtle.position + turtle.heading * a;
+            branch.radius = module.param_count > 1 ? module.params[1] : turtle.width;
+            branch.generation = turtle.generation;
+            branch.growth_progress = 0.0f;
+            branch.parent_index = turtle.branch;
+            branch.first_child = 0;  // Filled in by Tree::buildChildAdjacency()
+            branch.child_count = 0;
+            branch.start_time = 0.0f; // Filled in by Tree::buildGrowthSchedule()
+            branch.growth_duration = 1.0f;
+            turtle.branch = branches.size();
+            turtle.position = branch.end;
+            branches.push_back(branch);
+            break;
+        }
+        case 'f':
+            turtle.position += turtle.heading * a;
+            break;
+        case 'L': {
+            // A leaf needs a branch to grow from
+            if (turtle.branch < 0) break;
+            TreeLeaf leaf;
+            leaf.position = turtle.position;
+            leaf.normal = glm::normalize(turtle.up);
+            leaf.size = a;
+            leaf.growth_progress = 0.0f;
+            leaf.parent_branch_index = turtle.branch;
+            leaf.spawn_delay = module.param_count > 1 ? module.params[1] : 0.0f;
+            leaf.start_time = 0.0f;
+            leaf.growth_duration = 1.0f;
+            leaves.push_back(leaf);
+            break;
+        }
+        case '+':
+        case '-': {
+            float angle = (module.symbol == '+' ? a : -a) * to_radians;
+            turtle.heading = rotateAbout(turtle.heading, turtle.up, angle);
+            turtle.left = rotateAbout(turtle.left, turtle.up, angle);
+            break;
+        }
+        case '&':
+        case '^': {
+            float angle = (module.symbol == '&' ? a : -a) * to_radians;
+            turtle.heading = rotateAbout(turtle.heading, turtle.left, angle);
+            turtle.up = rotateAbout(turtle.up, turtle.left, angle);
+            break;
+        }
+        case '/':
+        case '\\': {
+            float angle = (module.symbol == '/' ? a : -a) * to_radians;
+            turtle.left = rotateAbout(turtle.left, turtle.heading, angle);
+            turtle.up = rotateAbout(turtle.up, turtle.heading, angle);
+            break;
+        }
+        case '!':
+            turtle.width = a;
+            break;
+        case '[':
+            stack.push_back(turtle);
+            turtle.generation++;
+            break;
+        case ']':
+            if (!stack.empty()) {
+                turtle = stack.back();
+                stack.pop_back();
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+std::string LSystemGrammar::builtinSpecies(const std::string& name) {
+    if (name == "broadleaf") {
+        // The classic generator as a grammar: 2-4 children spread evenly
+        // around each branch, 0.8 length and 0.7 radius per generation, and a
+        // cluster of leaves on every branch from generation 2 on
+        const std::string child = " [&(rand(25, 50)) A(l*0.8, r*0.7, g+1)]";
+        const std::string leaf = " [/(rand(0, 360)) &(rand(30, 90)) f(rand(0, 0.4)) L(rand(0.28, 0.45), rand(0, 4))]";
+        std::string source = "axiom: A(3, 0.2, 0)\n";
+        for (int leafy = 0; leafy < 2; leafy++) {
+            for (int children = 2; children <= 4; children++) {
+                std::ostringstream rule;
+                rule << "A(l, r, g) : g " << (leafy ? ">=" : "<") << " 2 -> F(l, r)";
+                for (int k = 0; leafy && k < 8; k++) rule << leaf;
+                rule << " /(rand(0, 360))" << child;
+                for (int k = 1; k < children; k++) rule << " /(" << 360 / children << ")" << child;
+                source += rule.str() + "\n";
+            }
+        }
+        return source;
+    }
+    if (name == "conifer") {
+        // A single leader putting out a whorl of near-horizontal limbs every
+        // step; limbs fork in their plane and carry short needle tufts
+        return
+            "axiom: T(1.4, 0.22)\n"
+            "T(l, r) -> F(l, r) /(rand(20, 50)) [&(rand(75, 90)) S(l*1.1, r*0.45)] /(90) [&(rand(75, 90)) S(l*1.1, r*0.45)]"
+            " /(90) [&(rand(75, 90)) S(l*1.1, r*0.45)] /(90) [&(rand(75, 90)) S(l*1.1, r*0.45)] T(l*0.85, r*0.85)\n"
+            "S(l, r) -> F(l, r) [&(60) L(0.18, rand(0, 4))] [^(60) L(0.18, rand(0, 4))]"
+            " [+(40) S(l*0.5, r*0.6)] [-(40) S(l*0.5, r*0.6)] S(l*0.7, r*0.7)\n";
+    }
+    if (name == "shrub") {
+        // Five stems from a short base, each forking twice per step
+        return
+            "axiom: F(0.3, 0.08) [&(20) B(1, 0.05)] /(72) [&(20) B(1, 0.05)] /(72) [&(20) B(1, 0.05)] /(72) [&(20) B(1, 0.05)] /(72) [&(20) B(1, 0.05)]\n"
+            "B(l, r) -> F(l, r) [&(50) L(0.3, rand(0, 4))] [^(50) L(0.3, rand(0, 4))]"
+            " /(rand(60, 120)) [+(rand(20, 40)) B(l*0.75, r*0.7)] [-(rand(20, 40)) B(l*0.75, r*0.7)]\n";
+    }
+    return std::string();
+}
@@ -0,0 +1,136 @@
+#ifndef LSYSTEM_H
+#define LSYSTEM_H
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+struct TreeBranch;
+struct TreeLeaf;
+
+// Parametric L-system: a grammar is compiled once into a rule table and
+// expression bytecode, rewritten on flat module buffers and read back by a
+// turtle that emits branches and leaves.
+//
+// Grammar text, one statement per line ('#' starts a comment):
+//   #define NAME value                 constant usable in any expression
+//   derivations: N                     rewriting steps (else one per tree generation)
+//   axiom: A(3, 0.2) ...               starting string
+//   A(l, r) : l > 0.5 @ 2 -> F(l, r) [ +(30) A(l * 0.8, r * 0.7) ]
+//                                      rule: predecessor with formal parameters,
+//                                      optional condition, optional weight, successor
+// Among the rules whose symbol, parameter count and condition match, one is
+// picked with probability proportional to its weight. Expressions take
+// + - * / unary minus, comparisons, && || and rand(a, b).
+//
+// Turtle symbols (angles in degrees):
+//   F(l[, r])  branch of length l, radius r (else the current width)
+//   f(l)       move without drawing
+//   L(s[, d])  leaf of size s at the turtle, spawn delay d seconds
+//   + -        yaw about up       & ^   pitch about left    / \   roll about heading
+//   !(w)       set the width      [ ]   push / pop the turtle (a bracket opens a new generation)
+// Every other symbol only takes part in rewriting.
+
+static const int LSYSTEM_MAX_PARAMS = 4;
+
+// One module of a derived string: symbol and actual parameters (20 bytes)
+struct LSystemModule {
+    unsigned char symbol;
+    unsigned char param_count;
+    float params[LSYSTEM_MAX_PARAMS];
+};
+
+// Expression bytecode for a small stack machine
+enum class LSystemOp : unsigned char {
+    Const, Param,
+    Add, Sub, Mul, Div, Neg,
+    Less, Greater, LessEqual, GreaterEqual, Equal, NotEqual, And, Or,
+    Rand
+};
+
+struct LSystemInstruction {
+    LSystemOp op;
+    int param;   // Param: index into the predecessor's parameters
+    float value; // Const: the literal
+};
+
+// Bytecode range [begin, end) of one expression; empty means "true"
+struct LSystemExpression {
+    int begin;
+    int end;
+};
+
+// One successor module: its symbol and param_count expressions from first_param
+struct LSystemSuccessorModule {
+    unsigned char symbol;
+    unsigned char param_count;
+    int first_param;
+};
+
+struct LSystemRule {
+    unsigned char predecessor;
+    unsigned char param_count;
+    LSystemExpression condition;
+    float weight;
+    int first_successor; // Range into the grammar's successor modules
+    int successor_count;
+};
+
+// Scratch strings reused across derivations; after derive() the result is
+// in current
+struct LSystemWorkspace {
+    std::vector<LSystemModule> current;
+    std::vector<LSystemModule> next;
+};
+
+class LSystemGrammar {
+private:
+    // Rules grouped by predecessor: rules for symbol s are
+    // rules[rule_first[s], rule_first[s + 1])
+    std::vector<LSystemRule> rules;
+    std::vector<int> rule_first;
+    std::vector<LSystemSuccessorModule> successors;
+    std::vector<LSystemExpression> param_expressions;
+    std::vector<LSystemInstruction> code;
+    // The axiom is a successor list without formal parameters, evaluated
+    // (rand included) at the start of every derivation
+    int first_axiom;
+    int axiom_count;
+    int derivations; // 0 = caller's choice
+    uint64_t source_hash;
+    
+    float evaluate(const LSystemExpression& expression, const float* params, std::mt19937_64& rng) const;
+
+public:
+    // Deepest stack any compiled expression may need
+    static const int MAX_STACK = 32;
+    // Rewriting stops early once a string reaches this many modules
+    static const size_t MAX_MODULES = 1 << 22;
+    
+    LSystemGrammar();
+    
+    // Parse and compile source, replacing the current grammar. On failure
+    // returns false, leaves the grammar empty and describes the first error
+    bool compile(const std::string& source, std::string& error);
+    bool isEmpty() const { return axiom_count == 0; }
+    int getDerivations() const { return derivations; }
+    int getRuleCount() const { return rules.size(); }
+    // FNV-1a of the compiled source, 0 while empty: equal hashes, equal trees
+    uint64_t getSourceHash() const { return source_hash; }
+    
+    // Rewrite the axiom steps times; the result is left in workspace.current
+    void derive(LSystemWorkspace& workspace, int steps, std::mt19937_64& rng) const;
+    
+    // Walk a derived string with the turtle, appending branches (parents
+    // before children) and leaves; the trunk starts at the origin heading +Y
+    void interpret(const std::vector<LSystemModule>& modules, std::vector<TreeBranch>& branches,
+                   std::vector<TreeLeaf>& leaves) const;
+    
+    // Source of a built-in species ("broadleaf", "conifer", "shrub"), or an
+    // empty string for an unknown name
+    static std::string builtinSpecies(const std::string& name);
+};
+
+#endif // LSYSTEM_H
@@ -11,146 +11,2496 @@ Stripped down to focus only on tree generation logic.
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
 #include <stdlib.h>
 #include <stdio.h>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <random>
+#include "alloc_counter.h"
 #include "constants.h"
+#include "logging.h"
+#include "memory_stats.h"
 #include "shaderprogram.h"
 #include "tree_simple.h"
+#include "tree_vertex_pack.h"
+#include "tree_async.h"
+#include "tree_asset.h"
+#include "tree_cache.h"
+#include "tree_handoff.h"
+#include "tree_profile.h"
+#include "tree_export.h"
+#include "tree_snapshot.h"
+#include "gpu_mesh.h"
+#include "gpu_residency.h"
+#include "gl_state.h"
+#include "gl_dsa.h"
+#include "frame_uniforms.h"
+#include "material.h"
+#include "texture_array.h"
+#include "bindless_textures.h"
+#include "texture_streaming.h"
+#include "texture_ktx2.h"
+#include "texture_pack.h"
+#include "resource_bundle.h"
+#include "shader_variants.h"
+#include "lights.h"
+#include "render_queue.h"
+#include "tree_bvh.h"
+#include "tree_meshlets.h"
+#include "tree_lod.h"
+#include "tree_occlusion.h"
+#include "tree_impostor.h"
+#include "leaf_cards.h"
+#include "forest_scene.h"
+#include "tree_placement.h"
+#include "world_stream.h"
+#include "depth_pyramid.h"
+#include "static_batch.h"
+#include "primitives.h"
+#include "terrain.h"
+#include "grass_field.h"
+#include "shadow_maps.h"
+#include "sim_thread.h"
+#include "stream_buffer.h"
+#include "frame_pacer.h"
+#include "frame_limiter.h"
+#include "gpu_trees.h"
+#include "leaf_particles.h"
+#include "fog.h"
+#include "sky.h"
+#include "view_set.h"
+#include "offscreen_target.h"
+#include "dynamic_resolution.h"
+#include "frame_capture.h"
+#include "profiler.h"
+#include "gpu_profiler.h"
+#include "perf_hud.h"
+#include "render_stats.h"
+#include "bench_baseline.h"
 #include "camera.h"  // Add camera header
-#include "lodepng.h"
+#include "camera_path.h"
 #include <iostream> // Include iostream for std::cout and std::endl
-#include "myCube.h"
-#include "myCube2.h"
+#include <string>
+#include <fstream>
+#include <sstream>
 
 // Global variables
-float aspectRatio = 1.0f;
+// Program variants of the scene shaders; sp is the plain lit one, whose
+// attribute locations (pinned in v_simplest.glsl) every variant shares
+ShaderVariants shaders("v_simplest.glsl", "f_simplest.glsl");
 ShaderProgram *sp;
-Tree tree;
+GlStateCache glState; // Program, texture and uniform state; drops redundant calls
+// --no-dsa: edit buffers, textures and vertex arrays by binding them, as
+// if the context had no direct state access (GlDsa)
+bool directStateAccess = true;
+FrameUniformBuffer frameUniformBuffer; // Camera and clock, one upload per frame for every program
+LightBuffer lightBuffer; // The frame's point lights, read by the lit programs
+std::vector<PointLight> sceneLights; // Rebuilt every frame, sun first
+
+// --torches N: N more torches on a ring around the tree, each a light of
+// limited radius; fragments shade only the torches listed for their cluster
+int extraTorches = 0;
+std::vector<glm::vec3> torchPositions; // Torch bases on the ground
+// The tree being drawn; a replacement generates in the background and is
+// swapped in by drawScene when ready (R regenerates)
+std::unique_ptr<Tree> tree(new Tree);
+TreeGenerationJob treeJob;
 Camera camera;  // Add camera instance
+// --late-latch: sample the cursor again just before the view is culled and
+// written to the frame uniforms; --predict-ms MS leads a drag by that much
+bool lateLatch = false;
+float predictMilliseconds = 0.0f;
 double lastTime = 0.0;
-GLuint barkTex;
-GLuint leafTex;
-GLuint grassTex;
-GLuint sunTex;
-GLuint torchTex;
-
-// Custom ground normals - all pointing up for proper lighting
-float groundNormals[] = {
-    // All 36 vertices get upward normals (0, 1, 0)
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 1
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 2
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 3
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 4
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 5
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 6
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 7
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 8
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 9
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 10
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  // Triangle 11
-    0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f   // Triangle 12
+bool growthPaused = false; // P pauses the growth clock; [ ] and Backspace still seek
+
+// --on-demand: once nothing but the sun would change, the loop sleeps in
+// glfwWaitEventsTimeout and draws on input, resize, or idleRedrawRate
+// times a second for the sun (--idle-hz N, 0 = on input only)
+bool onDemandRendering = false;
+float idleRedrawRate = 10.0f;
+
+// --fps-cap N caps the frames a second while the window has the focus and
+// --background-fps N while it doesn't (0 = no cap); minimized nothing is
+// drawn unless --draw-minimized, but growth keeps to its ticks either way
+float focusedFrameRate = 0.0f;
+float backgroundFrameRate = 10.0f;
+bool drawMinimized = false;
+FrameLimiter frameLimiter;
+
+// --growth-hz N: growth advances in fixed ticks of 1/N s and the mesh is
+// reused between them (0 = every frame). Growth time is a whole number of
+// ticks, so a tree passes through the same states at any frame rate
+float growthTickRate = 30.0f;
+long long growthTicks = 0;
+double growthTickRemainder = 0.0; // Frame time not yet consumed by a tick
+int verbosity = 1; // Console diagnostics: raised with -v, stats printed with the I key
+GLuint materialTextures; // bark, leaf, grass, sun, torch and leaf clusters as layers of one array
+
+// materialTextures' files, a layer each in this order, and the colour each
+// layer is in the 1x1 placeholder sampled until the images are decoded
+const char* const MATERIAL_TEXTURE_FILES[] = {"bark.png", "leaf.png", "grass3.png", "sun_yellow.png", "torch2.png",
+                                              "leaf_cluster.png"};
+const int MATERIAL_TEXTURE_COUNT = sizeof(MATERIAL_TEXTURE_FILES) / sizeof(MATERIAL_TEXTURE_FILES[0]);
+const unsigned char MATERIAL_PLACEHOLDERS[MATERIAL_TEXTURE_COUNT][4] = {
+    { 92, 70, 52, 255 }, { 68, 112, 46, 255 }, { 86, 128, 58, 255 },
+    { 250, 214, 90, 255 }, { 222, 136, 52, 255 }, { 68, 112, 46, 255 }
+};
+
+// The material textures read and decoded by a background job, uploaded by
+// the render thread once it is done (installMaterialTextures)
+struct MaterialTextureLoad {
+    Job job;
+    bool pending;
+    bool try_compressed; // The GPU decodes S3TC: materials.ktx2 first
+    bool use_compressed; // ... and it was read
+    CompressedTextureArray compressed;
+    std::unique_ptr<TextureArrayBuilder> layers; // Decoded straight into its mapped buffer
+    
+    MaterialTextureLoad() : pending(false), try_compressed(false), use_compressed(false) {}
+};
+MaterialTextureLoad materialTextureLoad;
+
+// Startup is staged so the window's first frame comes as soon as it opens:
+// the programs compile, the first tree generates and the material textures
+// decode behind frames of the sky, then of a trunk-only tree with
+// placeholder textures, each swapped in when it is ready. --serial-startup
+// has everything ready before the first frame instead (bench and headless
+// runs always do)
+bool serialStartup = false;
+bool startupFinished = false; // finishStartup() has run
+
+// --stereo IPD: both eyes, IPD apart, side by side in the window, as a
+// head-mounted display's output takes them. Every scene draw covers both
+// (GpuMesh::setViewCount and the STEREO variants), culled once for the
+// pair, and the shadow maps are shared. The paths whose draw counts the
+// GPU writes, the branch lines and the impostors draw one view and are off
+bool stereoRendering = false;
+float stereoSeparation = 0.064f;
+
+// --view THETA,PHI,RADIUS: one more view beside the camera's in the window,
+// orbiting its target at those angles (degrees) and distance, up to
+// ViewSet::MAX_VIEWS in all. Every view draws the one draw list, culled
+// for all of them together and sorted once (ViewSet)
+ViewSet viewSet;
+
+// Side-by-side columns of the window: the eyes or the views
+int viewColumns() {
+    return stereoRendering ? 2 : viewSet.getCount();
+}
+
+// --bindless: sample each material's texture by handle, at the image's own
+// size (BindlessTextures), where GL_ARB_bindless_texture is supported;
+// otherwise, and by default, as a layer of the one texture array
+bool bindlessMaterials = false;
+BindlessTextures bindlessTextures;
+// --texture-budget MB: with --bindless, keep each material texture only at
+// the mip levels its nearest use needs, all within MB of GPU memory
+// (TextureStreamer); 0 = every texture whole
+float textureBudgetMB = 0.0f;
+TextureStreamer textureStreamer;
+// --gpu-memory-budget MB: keep the GL memory in use within MB, or with
+// "auto" within 80% of what the driver reports, by evicting the world's
+// proxies and the impostor atlas least recently drawn first and uploading
+// them again when they come back into view (GpuResidency); 0 = no budget
+float gpuBudgetMB = 0.0f;
+bool gpuBudgetFromDevice = false;
+GpuResidency gpuResidency;
+int impostorResidency = -1; // The atlas's handle, -1 = not registered
+
+// Surfaces of the scene, one material each
+MaterialLibrary materials;
+int barkMaterial = 0;
+int leafMaterial = 0;
+int barkFadeMaterial = 0; // Bark and leaves with the dithered LOD fade
+int leafFadeMaterial = 0;
+int leafCardMaterial = 0; // Leaf cards, solid and fading
+int leafCardFadeMaterial = 0;
+int barkBakeMaterial = 0; // Bark and leaves as baked into the impostor atlas
+int leafBakeMaterial = 0;
+int branchLineMaterial = 0; // The branch lines or tubes, shaded and baked
+int branchLineBakeMaterial = 0;
+int impostorMaterial = 0;
+int forestBarkMaterial = 0; // Bark and leaves of the forest instances
+int forestLeafMaterial = 0;
+int propMaterial = 0; // The static props, each shaded by its own PropMaterial
+int terrainMaterial = 0;
+int grassMaterial = 0;
+float frameGrowthTime = 0.0f; // Growth time the shaders evaluate this frame
+
+// The scene program for a define set, bound to the per-frame and light
+// uniform blocks when first submitted
+ShaderProgram* shaderVariant(const std::string& defines, ShaderVariants& variants = shaders) {
+    int compiled = variants.getCount();
+    std::string key = defines;
+    if (&variants == &shaders) {
+        if (bindlessMaterials) key += " BINDLESS";
+        if (stereoRendering) key += " STEREO";
+    }
+    ShaderProgram* program = variants.get(key);
+    if (variants.getCount() != compiled) {
+        program->bindUniformBlock(FrameUniformBuffer::blockName(), FrameUniformBuffer::BINDING);
+        program->bindUniformBlock(LightBuffer::blockName(), LightBuffer::BINDING);
+        program->bindUniformBlock(ShadowMaps::blockName(), ShadowMaps::BINDING);
+        program->bindUniformBlock(BindlessTextures::blockName(), BindlessTextures::BINDING);
+    }
+    return program;
+}
+
+// The torches and the sun: one batch drawn in one call, the sun's
+// vertices moved every frame
+StaticBatch staticProps;
+int sunProp = -1;
+
+// The ground: a heightfield over the square of half side --terrain-extent E
+// with hills up to --terrain-height H, flat around the tree, drawn in
+// chunks whose detail follows the distance
+Terrain terrain;
+float terrainExtent = 48.0f;
+float terrainHeight = 4.0f;
+// --grass D: D blades per square unit on the terrain out to --grass-radius
+// R, thinning out with distance
+float grassDensity = 0.0f;
+float grassRadius = 24.0f;
+GrassField grass;
+
+// --wind S: wind strength, 0 for still air. The vertex shader bends the
+// GPU-grown trees' branches (--gpu-growth, the forest) from their branch
+// table, flutters their leaves and bends the grass
+float windStrength = 1.0f;
+
+// --season S: the time of year in [0, 1) (0 = early spring, autumn from
+// 0.55, bare from 0.9), or its start with --year-seconds Y cycling it.
+// GPU-grown and instanced leaves bud, turn, drop and fall by it in the
+// shaders, keyed per leaf, with no mesh rebuilt
+float seasonStart = 0.3f;
+float yearSeconds = 0.0f;
+
+// Shadows of the sun in cascades and of the first torch in a cube map
+// (--no-shadows for none): --shadow-size N texels a cascade's side, half
+// that the cube's, --shadow-intervals A,B,C,T frames between redraws of
+// the moving casters in each cascade and the cube. The ground and the
+// trees cast; a tree standing still is drawn into the maps' static caches
+// once and kept
+bool shadowsEnabled = true;
+int shadowMapSize = 1024;
+int shadowIntervals[ShadowMaps::CASCADES + 1] = { 1, 2, 4, 2 };
+ShadowMaps shadowMaps;
+bool shadowCastersStale = true; // The static casters changed since the caches were drawn
+int shadowCasterKinds = -1;     // Which casters were drawn and which moved, at the last plan
+
+// Tree meshes; vertex buffers are patched in place from the tree's dirty ranges
+GpuMesh branchMesh; // Index buffer static for a generated tree, uploaded once
+GpuMesh leafMesh;
+size_t branchVBOSize = 0;
+size_t leafVBOSize = 0;
+std::vector<MeshDirtyRange> dirtyRanges;
+
+// Usage hint for the per-frame tree buffers: static once the tree reports
+// TreeCompleted, dynamic while it still changes
+GLenum treeBufferUsage = GL_DYNAMIC_DRAW;
+std::vector<GrowthEvent> growthEvents;
+
+bool tubeBranches = false; // --tubes: weld each limb into one connected mesh
+// --curved-branches C: slender mesh branches sag by up to C of their length,
+// meshed in sections within --curve-budget extra ring vertices per tree
+float branchCurvature = 0.0f;
+int curveVertexBudget = 0;
+
+// --single-sided-leaves: one indexed quad per leaf, lit from both sides
+bool singleSidedLeaves = false;
+bool mortonLeaves = false; // --morton-leaves: leaves and their mesh slots in Z-order through the crown
+
+// --leaf-mix R: share of the leaves' normal-based texture lookup; 0 saves
+// the second fetch on the most shaded fragments of the scene
+float leafMixRatio = 0.3f;
+
+// --msaa N: N samples per pixel; leaf edges then use alpha-to-coverage
+// --leaf-prepass: lay down the leaves' alpha-tested depth first, so the
+// shading pass lights only the texels left visible
+// --depth-prepass (Z toggles): the same for the whole scene, one lit
+// fragment per pixel
+int msaaSamples = 0;
+bool leafPrepass = false;
+bool depthPrepass = false;
+const float leafAlphaCutoff = 0.5f;
+const float leafCoverageCutoff = 0.1f; // Under MSAA; coverage fades the rest
+
+// --anisotropy N: anisotropic filtering of the material textures, up to N
+// samples per lookup (1 = trilinear only)
+float textureAnisotropy = 8.0f;
+
+// --instanced-leaves: one LeafInstance per leaf expanded from a unit quad
+bool instancedLeaves = false;
+GpuMesh leafQuadMesh;
+size_t leafInstanceVBOSize = 0;
+
+// --instanced-branches: one BranchInstance per branch expanded from a unit cylinder
+bool instancedBranches = false;
+GpuMesh branchCylinderMesh;
+size_t branchInstanceVBOSize = 0;
+
+// --branch-lines: the same records drawn as GL_LINES, two ends each, which
+// g_branch_lines.glsl expands into tubes with rings of more sides the
+// larger the branch is on screen; --branch-tubes draws them as patches of
+// two control points the tessellation stages cut as finely as the branch
+// is large on screen, bowing slender limbs a little (GL 4.0).
+// branchPixelScale, the pixels a unit spans at unit eye distance, gives
+// the shaders the size on screen
+bool branchLines = false;
+bool branchTubes = false;
+GpuMesh branchLineMesh;
+float branchPixelScale = 0.0f;
+
+// Frustum culling of the CPU-animated tree meshes (--no-culling or C turns
+// it off): a BVH over the branches and leaves, rebuilt with the layout and
+// refit while the tree grows, gives the visible slots as draw ranges
+bool frustumCulling = true;
+TreeBvh treeBvh;
+TreeDrawRanges visibleBranches;
+TreeDrawRanges visibleLeaves;
+bool treeCullPending = true; // The ranges are stale: new layout or culling switched on
+// --meshlets: the culled meshes are cut into meshlets instead, each culled
+// by a compute pass against the frustum and, for the wood, by its normal
+// cone (GL 4.3; the wood of the CPU-animated meshes and single-sided leaves,
+// not with --lod)
+bool meshletCulling = false;
+TreeMeshlets treeMeshlets;
+std::unique_ptr<ShaderProgram> meshletCullProgram;
+
+// --lod (or L): levels of detail for the CPU-animated tree meshes, chosen
+// by the tree's size on screen; the elements a level change adds or drops
+// fade in or out through the fading ranges. --lod-bias F > 1 picks coarser
+// levels sooner, as if the tree were F times smaller on screen
+bool treeLodEnabled = false;
+float treeLodBias = 1.0f;
+TreeLod treeLod;
+TreeDrawRanges fadingBranches;
+TreeDrawRanges fadingLeaves;
+
+// --leaf-cards (implies --lod): from LOD level 2 on, the leaves are drawn
+// as cards, one per cluster of up to 8 leaves on a branch
+bool leafCardsEnabled = false;
+LeafCards leafCards;
+GpuMesh cardMesh;
+bool cardsStale = true; // Growth moved the leaves since the cards were uploaded
+// --leaf-thinning NEAR,FAR,SHARE: past NEAR from the camera the GPU-grown
+// leaves thin out continuously, each at its own random rank, to SHARE of
+// them from FAR on, the ones kept grown to cover the same area (FrameData
+// leafThinning); between the full leaves and the cards, without a pop
+glm::vec3 leafThinning(20.0f, 80.0f, 1.0f);
+
+// --impostors N: N copies of the grown tree scattered around the scene as
+// octahedral impostors, baked each time a new layout is fully grown;
+// --impostor-distance D draws the tree itself as one from D away (0 = never)
+int impostorCount = 0;
+float impostorDistance = 0.0f;
+TreeImpostor treeImpostor;
+ShaderVariants impostorShaders("v_impostor.glsl", "f_impostor.glsl");
+ShaderProgram* impostorProgram = nullptr;
+GpuMesh impostorMesh;       // One quad, the copies as instances and the tree itself last
+bool impostorStale = true;  // The layout changed since the last bake
+bool treeAsImpostor = false; // This frame draws the tree itself as its impostor
+
+// --forest N: N instances of a few archetype trees (--forest-archetypes K)
+// scattered over the ground, or the square of half side --forest-extent E,
+// each scaled, turned, tinted and growing up to 20 s late; drawn instanced
+// per archetype and level of detail
+int forestCount = 0;
+int forestArchetypes = 4;
+float forestExtent = 8.0f;
+ForestScene forest;
+// --forest-spacing S: the forest and the world chunks are Poisson-disk
+// placed instead, crowns S times their radius apart (1 = touching), as
+// many as fit up to their counts
+float forestSpacing = 0.0f;
+TreePlacement forestPlacement; // Its kinds the archetypes, once grown
+// --world R: an endless forest of the same archetypes streamed in square
+// chunks of side --world-chunk S around the camera, --world-trees N trees
+// each: built in the background within R, dropped past R + S, and held to
+// --world-budget MB. --world-proxies D draws the grown chunks from D away
+// as one merged mesh each, cached in --world-cache DIR when given
+float worldRadius = 0.0f;
+float worldChunkSize = 16.0f;
+int worldChunkTrees = 24;
+float worldBudgetMB = 64.0f;
+float worldProxyDistance = 0.0f;
+std::string worldCacheDirectory;
+// --prefetch S: the world chunks (up to --prefetch-chunks N beyond the
+// load radius) and the material texture levels are streamed for where the
+// camera's orbit is headed S seconds ahead as well as for where it is
+// (0 = only where it is)
+float prefetchSeconds = 1.0f;
+int prefetchChunks = 8;
+WorldStream world;
+// --gpu-culling: the forest is culled and its levels chosen by a compute
+// shader and drawn with multi-draw indirect, where GL 4.3 allows
+bool forestGpuCulling = false;
+std::unique_ptr<ShaderProgram> forestCullProgram;
+// --forest-threads N: without GPU culling, cull the forest and record its
+// batches on N threads of the job system (0 = all cores)
+int forestSelectThreads = 1;
+// --occlusion-culling: GPU culling also drops the instances hidden behind
+// the last frame's depth, reduced into a pyramid after every frame
+bool occlusionCulling = false;
+DepthPyramid depthPyramid;
+std::unique_ptr<ShaderProgram> depthPyramidProgram;
+// --gpu-trees N: N more grown trees over the forest's square, generated and
+// meshed from a seed each by a compute shader (GL 4.3) and drawn with one
+// indirect draw for all their wood and one for all their leaves
+int gpuTreeCount = 0;
+GpuTreeGenerator gpuTrees;
+std::unique_ptr<ShaderProgram> treeGenerateProgram;
+// --falling-leaves N: room for N leaves falling from the instanced leaves
+// of the tree and the GPU trees as the season drops them, and from pruned
+// branches, stepped by a compute shader (GL 4.3)
+int fallingLeafCount = 0;
+LeafParticles leafParticles;
+std::unique_ptr<ShaderProgram> leafParticlesProgram;
+
+// --view-distance D: distance fog that closes at D, with the far plane,
+// so the frustum culling, there too, the grass and the streamed world no
+// further and the levels of detail coarser as the fog hides the trees.
+// --fog-height H,F makes it densest at height H and thin by e every 1 / F
+// above (F 0 = even). Without it the far plane stays at 50 and no fog
+float viewDistance = 0.0f;
+float fogBaseHeight = 0.0f;
+float fogHeightFalloff = 0.0f;
+DistanceFog distanceFog;
+// The clear colour, the sky the fog fades into
+static const glm::vec3 SKY_COLOR(0.5f, 0.7f, 0.9f);
+// --sky: a physically based sky behind the scene from precomputed tables
+// (Sky), whose colour the fog takes and whose light the ambient, under a
+// sun that rises and sets as it circles; not in stereo
+bool skyEnabled = false;
+Sky sky;
+std::unique_ptr<ShaderProgram> skyTransmittanceProgram;
+std::unique_ptr<ShaderProgram> skyViewProgram;
+std::unique_ptr<ShaderProgram> skyProgram;
+// The sun's elevation over a circle of --sky: SUN_NOON_ELEVATION at its
+// height, swinging by SUN_ELEVATION_SWING either way, so it spends a
+// stretch of each circle below the horizon
+static const float SUN_NOON_ELEVATION = 0.436f; // 25 degrees
+static const float SUN_ELEVATION_SWING = 0.611f; // 35 degrees
+
+// --twig-instances: branches from generation 4 on are drawn as instances of
+// a few shared twig prototypes
+bool twigInstances = false;
+
+// --avoid-overlaps: redraw or drop child branches that would pass through
+// a branch already placed (Tree::setBranchAvoidance)
+bool avoidOverlaps = false;
+
+// --baked-ao RAYS: bake every tree's ambient occlusion from its own
+// branches and leaves when it is generated (Tree::setOcclusionBaker), RAYS
+// per point, for the ambient and some of the direct light
+int bakedOcclusionRays = 0;
+GpuMesh twigMesh;
+
+// --max-branches / --max-leaves / --max-vertices N: per-tree generation budget
+TreeBudget treeBudget;
+
+// --lazy-detail N: generations from N on are grown only while the tree
+// looks large from the camera (0 = all up front)
+int lazyDetailGeneration = 0;
+
+// --species NAME / --grammar FILE: grow an L-system species instead of the
+// built-in branching rules
+std::shared_ptr<const LSystemGrammar> treeGrammar;
+
+// --space-colonization: grow the crown toward attractor points instead
+bool spaceColonization = false;
+
+// --profiles FILE: tree parameter profiles (tree_profile.h), [tree] for the
+// tree and [forest] for the forest archetypes (falling back on [tree]).
+// The file is read again twice a second while the demo runs, and a change
+// regrows the trees whose parameters it changed in the background
+std::string profileFile;
+TreeProfiles treeProfiles;
+double profilePollTime = 0.0;
+bool treeProfileStale = false;   // Waiting for the tree job to be free
+bool forestProfileStale = false; // Waiting for the archetype jobs
+std::vector<TreeGenerationJob> archetypeJobs;
+
+// --threads N: generate subtrees below generation 2 on N threads (0 = serial)
+int generationThreads = 0;
+
+// --update-threads N: run the per-frame growth and mesh passes on N threads
+int updateThreads = 0;
+
+// --load-tree FILE: start from a saved tree instead of generating one;
+// --save-tree FILE: save every tree as it is swapped in
+std::string loadTreeFile;
+std::string saveTreeFile;
+// --encode-mesh: save the prebuilt meshes encoded (mesh_codec.h)
+bool encodeSavedMesh = false;
+
+// --handoff NAME: take the trees a generator process hands over through
+// the shared-memory ring NAME (tree_serve --shm NAME) as they arrive
+std::string handoffName;
+TreeHandoffRing treeHandoff;
+
+// --export-tree FILE: export every tree as it is swapped in, fully grown,
+// as binary glTF (.glb) or OBJ (any other name). The export runs on a
+// background job from a snapshot while the tree grows on
+std::string exportTreeFile;
+TreeSnapshots treeSnapshots;
+struct TreeExportJob {
+    Job job;
+    std::shared_ptr<const TreeSnapshot> snapshot;
+} treeExport;
+
+// --shader-cache DIR: where linked shader binaries are kept between runs
+// ("" compiles from source every time)
+std::string shaderCacheDirectory = ".";
+
+// --watch-shaders: read the shader files again twice a second and swap in
+// the programs of the changed ones once they compile and link
+bool watchShaders = false;
+double shaderPollTime = 0.0;
+
+// --bundle FILE: the resource bundle to load the shaders and textures from
+// (tree_demo.res beside the executable by default); --no-bundle reads the
+// files in the working directory, as does --watch-shaders, which watches them
+std::string resourceBundleFile;
+bool useResourceBundle = true;
+
+// --texture-cache DIR: where decoded PNG texture layers are kept between
+// runs ("" decodes every time)
+std::string textureCacheDirectory;
+
+// Seeded trees and the forest archetypes come through the tree cache: up
+// to --tree-cache-mb MB (0 = off) of them in memory and, with
+// --tree-cache DIR, every one on disk between runs
+std::string treeCacheDirectory;
+float treeCacheMB = 128.0f;
+TreeCache treeCache;
+
+// F12 saves a screenshot, V starts and stops recording every frame to
+// recordPrefix + frame number + ".png"; --record PREFIX records from the
+// first frame. Readback and encoding stay off the render loop
+FrameCapture frameCapture;
+std::string recordPrefix = "frame_";
+bool recordFromStart = false;
+int screenshotCount = 0;
+
+// T writes the profiler's recent scopes of every thread to trace_NNN.json
+// (chrome://tracing, ui.perfetto.dev); --no-profile stops the recording
+int traceCount = 0;
+
+// The render passes timed on the GPU, into the same traces on a "GPU"
+// track; I prints the last frame read back
+GpuProfiler gpuProfiler;
+
+// H shows the performance HUD over the frame (--hud from the start): the
+// frame times, the CPU phases of drawScene, the GPU passes and the frame's
+// draw and upload counters
+PerfHud perfHud;
+std::unique_ptr<ShaderProgram> hudProgram;
+bool hudVisible = false;
+
+// The CPU time of each drawScene phase in the last frame, in the order they
+// end, for the HUD; zero while the profiler is off
+const int FRAME_PHASES = 9;
+const char* framePhaseNames[FRAME_PHASES] = { "update", "upload", "cull", "uniforms", "queue", "shadow maps",
+                                              "scene draws", "depth pyramid", "swap" };
+float framePhaseMilliseconds[FRAME_PHASES] = {};
+
+// Heap allocations of the last frame (alloc_counter.h), on the HUD and as
+// counters in the traces: drawScene's own on the render thread, and every
+// thread's over the same time, the HUD's left out of both.
+// --alloc-check N aborts at the first allocation of drawScene's thread
+// once N frames have warmed up, in a debugger at the allocating call
+AllocationCounts frameAllocations = {0, 0};
+AllocationCounts frameProcessAllocations = {0, 0};
+int allocCheckWarmup = -1; // -1 = off
+long long framesDrawn = 0;
+
+// --bench N: N frames along a camera path (--camera-path FILE, or a turn
+// around the tree) with vsync off and the scene clock stepping 1/60 s a
+// frame, so every run draws the same frames; their CPU and GPU times go to
+// --bench-output FILE as CSV. K appends the current view to a path file
+int benchFrames = 0;
+std::string benchOutputFile = "bench_frames.csv";
+// The baseline options (bench_baseline.h): the frames' CPU and GPU times
+// checked against this machine's stored tree_demo baseline, the run
+// exiting with status 2 when they regressed, or stored as it. A baseline
+// holds for the flags it was stored with
+BenchBaselineOptions benchBaseline;
+int exitStatus = EXIT_SUCCESS;
+// --frames-in-flight N (1-3): how many frames the CPU may run ahead of the
+// GPU (FramePacer), 0 = as many as the driver queues; --vsync 0|1 sets the
+// swap interval, by default 0 for bench and headless frames, 1 otherwise
+int framesInFlight = 0;
+int swapInterval = -1; // -1 = the default
+FramePacer framePacer;
+std::string cameraPathFile = "camera_path.txt";
+CameraPath cameraPath;
+// --seed S: the first tree's seed (1 in bench mode), -1 for a random one;
+// R regenerates at random either way
+long long firstTreeSeed = -1;
+
+// --headless FILE: a hidden window draws the (tree, camera) jobs of FILE
+// into an offscreen target of --size WxH (--msaa N samples) and saves each
+// through the frame capture, the next job's tree generating meanwhile. A
+// line is "seed theta phi radius image.png", # starting a comment
+struct HeadlessJob {
+    long long seed;
+    CameraKeyframe pose;
+    std::string path;
 };
+std::vector<HeadlessJob> headlessJobs;
+std::string headlessJobsFile;
+int offscreenWidth = 1024;
+int offscreenHeight = 1024;
+OffscreenTarget offscreenTarget;
+const int HEADLESS_SETTLE_FRAMES = 3; // Drawn before a job's image, for the LOD fades and the shadow map caches
 
-// Custom torch texture coordinates - matching exact cube structure with proper UV mapping
-float torchTexCoords[] = {
-    // Wall 1 (Front face Z-) 
-    0.0f, 0.0f,  1.0f, 1.0f,  1.0f, 0.0f,  // Triangle 1: bottom-right, top-left, bottom-left
-    0.0f, 0.0f,  0.0f, 1.0f,  1.0f, 1.0f,  // Triangle 2: bottom-right, top-right, top-left
+// Bench and headless frames step the scene clock 1/60 s each
+bool fixedClock = false;
+long long clockFrame = 0; // The frame being drawn on the fixed clock
 
-    // Wall 2 (Back face Z+)
-    0.0f, 0.0f,  1.0f, 1.0f,  1.0f, 0.0f,  // Triangle 1
-    0.0f, 0.0f,  0.0f, 1.0f,  1.0f, 1.0f,  // Triangle 2
+// Seconds of scene time: the wall clock, or the frame count on the fixed
+// clock
+double sceneClock() {
+    return fixedClock ? clockFrame / 60.0 : glfwGetTime();
+}
 
-    // Wall 3 (Bottom face Y-)
-    0.0f, 0.0f,  1.0f, 1.0f,  1.0f, 0.0f,  // Triangle 1
-    0.0f, 0.0f,  0.0f, 1.0f,  1.0f, 1.0f,  // Triangle 2
+// --dynamic-resolution MIN,MAX: the scene is drawn into offscreenTarget at
+// a share of the window's resolution between MIN and MAX, picked from the
+// GPU frame time, and stretched over the window; --gpu-budget MS is the
+// time a frame aims for (0 = 90% of the monitor's refresh interval)
+bool dynamicResolutionOn = false;
+float dynamicMinScale = 0.5f;
+float dynamicMaxScale = 1.0f;
+float gpuBudgetMilliseconds = 0.0f;
+DynamicResolution dynamicResolution;
+long long dynamicTimingsFrame = -1; // The GPU timings last fed to it
 
-    // Wall 4 (Top face Y+)
-    0.0f, 0.0f,  1.0f, 1.0f,  1.0f, 0.0f,  // Triangle 1
-    0.0f, 0.0f,  0.0f, 1.0f,  1.0f, 1.0f,  // Triangle 2
+// The framebuffer the scene is drawn into (0 = the window's) and its size
+GLuint sceneFramebuffer() {
+    return offscreenTarget.getFramebuffer();
+}
 
-    // Wall 5 (Left face X-)
-    0.0f, 0.0f,  1.0f, 1.0f,  1.0f, 0.0f,  // Triangle 1
-    0.0f, 0.0f,  0.0f, 1.0f,  1.0f, 1.0f,  // Triangle 2
+void sceneSize(GLFWwindow* window, int& width, int& height) {
+    if (offscreenTarget.isCreated()) {
+        width = offscreenTarget.getViewportWidth();
+        height = offscreenTarget.getViewportHeight();
+    } else {
+        glfwGetFramebufferSize(window, &width, &height);
+    }
+}
 
-    // Wall 6 (Right face X+)
-    0.0f, 0.0f,  1.0f, 1.0f,  1.0f, 0.0f,  // Triangle 1
-    0.0f, 0.0f,  0.0f, 1.0f,  1.0f, 1.0f   // Triangle 2
+// --packed-vertices: CPU-animated tree buffers hold PackedTreeVertex (20 bytes)
+bool packedVertices = false;
+std::vector<PackedTreeVertex> packScratch;
+
+// --stream-buffers: the CPU-animated tree meshes draw from persistently
+// mapped StreamBuffers (GL 4.4), their changed ranges written, packed if
+// need be, straight into the region the GPU is done with
+bool streamBuffers = false;
+StreamBuffer branchStream;
+StreamBuffer leafStream;
+
+// The growth step and mesh rebuild of the next frame run on a simulation
+// thread while the render thread submits this one (--no-sim-thread runs
+// them inline at the same point). The tree's CPU arrays are the back
+// buffer the step writes; the GPU buffers and treeDraw, taken before the
+// step starts, are the front buffer the draws read. Beyond those the draws
+// read only the tree's layout (the twigs), which growth leaves alone. A
+// frame shows the growth stepped during the one before it
+bool simulationThreaded = true;
+SimulationThread simulation;
+
+// What a frame's draws read of the tree
+struct TreeDrawState {
+    int branch_indices;
+    int leaf_indices;
+    int leaf_vertices;
+    int branch_instances;
+    int leaf_instances;
+    int branches;
+    bool grown;
 };
+TreeDrawState treeDraw = TreeDrawState();
+
+// GPU growth animation (--gpu-growth): static meshes animated in the vertex shader
+bool gpuGrowth = false;
+GLuint branchDataBuffer = 0;
+GLuint branchDataTex = 0;
+
+// Bring a buffer up to date with its CPU-side copy: reallocate and upload
+// whole when the size changed, otherwise send only the dirty byte ranges
+void syncBufferRanges(GLuint vbo, size_t& vboSize, const void* data, size_t bytes,
+                      const std::vector<MeshDirtyRange>& ranges) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (bytes != vboSize) {
+        glBufferData(GL_ARRAY_BUFFER, bytes, data, treeBufferUsage);
+        MemoryStats::trackBuffer(vbo, bytes, "tree");
+        RenderStats::countUpload(bytes);
+        vboSize = bytes;
+    } else {
+        const char* base = (const char*)data;
+        for (const MeshDirtyRange& range : ranges) {
+            glBufferSubData(GL_ARRAY_BUFFER, range.offset, range.size, base + range.offset);
+            RenderStats::countUpload(range.size);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Bring a tree vertex buffer up to date with its CPU-side array. When the
+// array size changes (a new tree) the buffer is reallocated and uploaded
+// whole; otherwise only the byte ranges the tree rewrote are sent. With
+// packedVertices each range is packed on the way and lands at the matching
+// vertex of the compact buffer.
+void syncTreeBuffer(GLuint vbo, size_t& vboSize, const std::vector<float>& vertices,
+                    const std::vector<MeshDirtyRange>& ranges) {
+    if (!packedVertices) {
+        syncBufferRanges(vbo, vboSize, vertices.data(), vertices.size() * sizeof(float), ranges);
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    
+    const size_t treeVertexBytes = Tree::VERTEX_FLOATS * sizeof(float);
+    size_t vertexCount = vertices.size() / Tree::VERTEX_FLOATS;
+    size_t bytes = vertexCount * sizeof(PackedTreeVertex);
+    if (bytes != vboSize) {
+        packScratch.resize(vertexCount);
+        packTreeVertices(vertices.data(), vertexCount, packScratch.data());
+        glBufferData(GL_ARRAY_BUFFER, bytes, packScratch.data(), treeBufferUsage);
+        MemoryStats::trackBuffer(vbo, bytes, "tree");
+        RenderStats::countUpload(bytes);
+        vboSize = bytes;
+    } else {
+        for (const MeshDirtyRange& range : ranges) {
+            size_t first = range.offset / treeVertexBytes;
+            size_t count = range.size / treeVertexBytes;
+            packScratch.resize(count);
+            packTreeVertices(&vertices[first * Tree::VERTEX_FLOATS], count, packScratch.data());
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(PackedTreeVertex),
+                            count * sizeof(PackedTreeVertex), packScratch.data());
+            RenderStats::countUpload(count * sizeof(PackedTreeVertex));
+        }
+    }
+    
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Upload the GPU-animated tree once: fully grown meshes and the per-branch
+// growth table the vertex shader reads through a buffer texture
+void uploadStaticTree() {
+    const std::vector<float>& branchVerts = tree->getStaticBranchVertices();
+    const std::vector<float>& leafVerts = tree->getStaticLeafVertices();
+    const std::vector<float>& growthData = tree->getBranchGrowthData();
+    
+    branchMesh.uploadVertices(branchVerts.data(), branchVerts.size() * sizeof(float), GL_STATIC_DRAW);
+    leafMesh.uploadVertices(leafVerts.data(), leafVerts.size() * sizeof(float), GL_STATIC_DRAW);
+    
+    if (branchDataBuffer == 0) glGenBuffers(1, &branchDataBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, branchDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, growthData.size() * sizeof(float), growthData.data(), GL_STATIC_DRAW);
+    MemoryStats::trackBuffer(branchDataBuffer, growthData.size() * sizeof(float), "tree");
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    
+    // Left bound on the unit the shader samples it from
+    if (branchDataTex == 0) glGenTextures(1, &branchDataTex);
+    glState.bindTexture(5, GL_TEXTURE_BUFFER, branchDataTex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, branchDataBuffer);
+}
+
+// Batch the scene's props: a cube torch on each of torchPositions and the
+// sun, a low-poly sphere drawScene moves
+void createStaticProps(const PropMaterial& torch, const PropMaterial& sun) {
+    staticProps.clear();
+    const PrimitiveMesh cube = makeCubeMesh();
+    for (const glm::vec3& torchPos : torchPositions) {
+        glm::mat4 torchModel = glm::translate(glm::mat4(1.0f), torchPos) *
+                               glm::scale(glm::mat4(1.0f), glm::vec3(0.2f, 0.5f, 0.2f)); // Tall, thin torch
+        staticProps.add(cube, torchModel, torch);
+    }
+    sunProp = staticProps.add(makeSphereMesh(10, 6), glm::mat4(1.0f), sun);
+    staticProps.upload();
+}
+
+// Point a tree mesh's attributes at its vertices, base bytes into buffer: position (4), texcoord (2), normal (3)
+// [, growthRef (4), cornerDir (3)] for GPU-animated vertices, or
+// PackedTreeVertex's vec3 position, 2_10_10_10 normal and half-float
+// texcoord with packedVertices
+void pointTreeMesh(GpuMesh& mesh, GLuint buffer, size_t base) {
+    int stride = (gpuGrowth ? Tree::GPU_VERTEX_FLOATS : Tree::VERTEX_FLOATS) * sizeof(GLfloat);
+    int posAttrib = sp->a("vertex");
+    int texAttrib = sp->a("texcoord");
+    int normAttrib = sp->a("normal");
+    if (packedVertices && !gpuGrowth) {
+        stride = sizeof(PackedTreeVertex);
+        mesh.attribute(buffer, posAttrib, 3, GL_FLOAT, false, stride, base);
+        mesh.attribute(buffer, texAttrib, 2, GL_HALF_FLOAT, false, stride, base + PACKED_TEXCOORD_OFFSET);
+        mesh.attribute(buffer, normAttrib, 4, GL_INT_2_10_10_10_REV, true, stride, base + PACKED_NORMAL_OFFSET);
+        return;
+    }
+    mesh.attribute(buffer, posAttrib, 4, GL_FLOAT, false, stride, base);
+    mesh.attribute(buffer, texAttrib, 2, GL_FLOAT, false, stride, base + 4 * sizeof(GLfloat));
+    mesh.attribute(buffer, normAttrib, 3, GL_FLOAT, false, stride, base + 6 * sizeof(GLfloat));
+    if (gpuGrowth) {
+        mesh.attribute(buffer, sp->a("growthRef"), 4, GL_FLOAT, false, stride, base + 9 * sizeof(GLfloat));
+        mesh.attribute(buffer, sp->a("cornerDir"), 3, GL_FLOAT, false, stride, base + 13 * sizeof(GLfloat));
+    }
+}
+
+// A tree mesh reading its own vbo
+void createTreeMesh(GpuMesh& mesh, bool indexed) {
+    mesh.create(indexed, false, "tree");
+    pointTreeMesh(mesh, mesh.vbo, 0);
+}
+
+// Tree vertices [first, first + count) into a region laid out like the vbo
+void writeTreeVertices(char* region, const std::vector<float>& vertices, size_t first, size_t count) {
+    const float* source = &vertices[first * Tree::VERTEX_FLOATS];
+    if (packedVertices) {
+        packTreeVertices(source, count, (PackedTreeVertex*)region + first);
+        RenderStats::countUpload(count * sizeof(PackedTreeVertex));
+    } else {
+        memcpy(region + first * Tree::VERTEX_FLOATS * sizeof(float), source, count * Tree::VERTEX_FLOATS * sizeof(float));
+        RenderStats::countUpload(count * Tree::VERTEX_FLOATS * sizeof(float));
+    }
+}
+
+// Back to the meshes' own buffers, uploaded whole at the next sync, when
+// a stream store cannot be mapped
+void stopStreaming() {
+    LOG_WARNING(Render) << "Stream buffers could not be mapped; uploading the tree meshes instead";
+    streamBuffers = false;
+    branchStream.release();
+    leafStream.release();
+    pointTreeMesh(branchMesh, branchMesh.vbo, 0);
+    pointTreeMesh(leafMesh, leafMesh.vbo, 0);
+    branchVBOSize = 0;
+    leafVBOSize = 0;
+}
+
+// syncTreeBuffer() through a StreamBuffer: the next region gets what it
+// lacks, copied from the CPU array, whole when the size changed (contentSize
+// tracks it like vboSize), and the mesh is pointed at it for the frame
+void streamTreeBuffer(StreamBuffer& stream, GpuMesh& mesh, size_t& contentSize, const std::vector<float>& vertices,
+                      const std::vector<MeshDirtyRange>& ranges) {
+    const size_t treeVertexBytes = Tree::VERTEX_FLOATS * sizeof(float);
+    size_t vertexCount = vertices.size() / Tree::VERTEX_FLOATS;
+    size_t bytes = vertexCount * (packedVertices ? sizeof(PackedTreeVertex) : treeVertexBytes);
+    // Headroom for the tree's growth, so the store is rarely made again
+    if (bytes > stream.getCapacity() && !stream.reserve(bytes + bytes / 2)) {
+        stopStreaming();
+        return;
+    }
+    bool whole = bytes != contentSize;
+    contentSize = bytes;
+    
+    stream.beginFrame(ranges, whole);
+    char* region = stream.getRegion();
+    if (stream.isWritingWhole()) {
+        if (vertexCount > 0) writeTreeVertices(region, vertices, 0, vertexCount);
+    } else {
+        for (const MeshDirtyRange& range : stream.getWrites()) {
+            writeTreeVertices(region, vertices, range.offset / treeVertexBytes, range.size / treeVertexBytes);
+        }
+    }
+    pointTreeMesh(mesh, stream.getBuffer(), stream.getRegionOffset());
+}
+
+// Unit leaf quad for instancing: corners in [-0.5, 0.5] with texcoords,
+// wound counter-clockwise around the leaf normal like a single-sided leaf.
+// Per-instance attributes advance once per quad
+void createLeafQuadMesh() {
+    static const float quad[] = {
+        -0.5f, -0.5f, 0.0f, 1.0f,  0.0f, 0.0f,
+         0.5f,  0.5f, 0.0f, 1.0f,  1.0f, 1.0f,
+         0.5f, -0.5f, 0.0f, 1.0f,  1.0f, 0.0f,
+        -0.5f, -0.5f, 0.0f, 1.0f,  0.0f, 0.0f,
+        -0.5f,  0.5f, 0.0f, 1.0f,  0.0f, 1.0f,
+         0.5f,  0.5f, 0.0f, 1.0f,  1.0f, 1.0f,
+    };
+    const int quadStride = 6 * sizeof(GLfloat);
+    const int instanceStride = sizeof(LeafInstance);
+    GpuMesh& mesh = leafQuadMesh;
+    mesh.create(false, true, "tree");
+    mesh.uploadVertices(quad, sizeof(quad), GL_STATIC_DRAW);
+    mesh.attribute(mesh.vbo, sp->a("vertex"), 4, GL_FLOAT, false, quadStride, 0);
+    mesh.attribute(mesh.vbo, sp->a("texcoord"), 2, GL_FLOAT, false, quadStride, 4 * sizeof(GLfloat));
+    mesh.attribute(mesh.instance_vbo, sp->a("instancePosition"), 3, GL_FLOAT, false, instanceStride, 0, 1);
+    mesh.attribute(mesh.instance_vbo, sp->a("instanceNormal"), 4, GL_INT_2_10_10_10_REV, true, instanceStride,
+                   3 * sizeof(GLfloat), 1);
+    mesh.attribute(mesh.instance_vbo, sp->a("instanceScale"), 2, GL_FLOAT, false, instanceStride,
+                   4 * sizeof(GLfloat), 1);
+}
+
+// The leaf card mesh: plain Tree vertices, uploaded as the cards change
+void createCardMesh() {
+    const int stride = Tree::VERTEX_FLOATS * sizeof(GLfloat);
+    cardMesh.create(false, false, "tree");
+    cardMesh.attribute(cardMesh.vbo, sp->a("vertex"), 4, GL_FLOAT, false, stride, 0);
+    cardMesh.attribute(cardMesh.vbo, sp->a("texcoord"), 2, GL_FLOAT, false, stride, 4 * sizeof(GLfloat));
+    cardMesh.attribute(cardMesh.vbo, sp->a("normal"), 3, GL_FLOAT, false, stride, 6 * sizeof(GLfloat));
+}
+
+// Whether the run has forest archetypes, scattered or streamed
+bool usingForest() {
+    return forestCount > 0 || worldRadius > 0.0f;
+}
+
+// Whether the run bakes and draws impostors at all
+bool usingImpostors() {
+    return impostorCount > 0 || impostorDistance > 0.0f;
+}
+
+// The impostor quad, and its instances: the copies on a ring around the
+// ground, out to near the far plane, and the tree itself at the origin
+void createImpostorMesh() {
+    static const float quad[] = {
+        -1.0f, -1.0f,   1.0f, 1.0f,   1.0f, -1.0f,
+        -1.0f, -1.0f,  -1.0f, 1.0f,   1.0f,  1.0f,
+    };
+    std::vector<ImpostorInstance> instances;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < impostorCount; i++) {
+        // Uniform over the ring's area
+        float distance = sqrtf(144.0f + unit(random) * (1600.0f - 144.0f));
+        float angle = 2.0f * glm::pi<float>() * unit(random);
+        ImpostorInstance instance;
+        instance.position = glm::vec3(distance * cos(angle), 0.0f, distance * sin(angle));
+        instance.position.y = terrain.heightAt(instance.position.x, instance.position.z);
+        instance.scale = 0.3f + 0.4f * unit(random);
+        instance.yaw = 2.0f * glm::pi<float>() * unit(random);
+        instances.push_back(instance);
+    }
+    ImpostorInstance self = { glm::vec3(0.0f), 1.0f, 0.0f };
+    instances.push_back(self);
+    
+    const int instanceStride = sizeof(ImpostorInstance);
+    GpuMesh& mesh = impostorMesh;
+    mesh.create(false, true, "impostors");
+    mesh.uploadVertices(quad, sizeof(quad), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(ImpostorInstance), instances.data(), GL_STATIC_DRAW);
+    MemoryStats::trackBuffer(mesh.instance_vbo, instances.size() * sizeof(ImpostorInstance), "impostors");
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    mesh.attribute(mesh.vbo, impostorProgram->a("vertex"), 2, GL_FLOAT, false, 2 * sizeof(GLfloat), 0);
+    mesh.attribute(mesh.instance_vbo, impostorProgram->a("instancePlacement"), 4, GL_FLOAT, false, instanceStride,
+                   0, 1);
+    mesh.attribute(mesh.instance_vbo, impostorProgram->a("instanceYaw"), 1, GL_FLOAT, false, instanceStride,
+                   4 * sizeof(GLfloat), 1);
+}
+
+// Unit cylinder for branch instancing: two rings of (cos, sin, ring, 1) with
+// texcoords; per-instance attributes advance once per cylinder
+void createBranchCylinderMesh() {
+    const int cylinderStride = 6 * sizeof(GLfloat);
+    const int instanceStride = sizeof(BranchInstance);
+    GpuMesh& mesh = branchCylinderMesh;
+    mesh.create(true, true, "tree");
+    mesh.attribute(mesh.vbo, sp->a("vertex"), 4, GL_FLOAT, false, cylinderStride, 0);
+    mesh.attribute(mesh.vbo, sp->a("texcoord"), 2, GL_FLOAT, false, cylinderStride, 4 * sizeof(GLfloat));
+    mesh.attribute(mesh.instance_vbo, sp->a("branchStart"), 4, GL_FLOAT, false, instanceStride, 0, 1);
+    mesh.attribute(mesh.instance_vbo, sp->a("branchEnd"), 4, GL_FLOAT, false, instanceStride, 4 * sizeof(GLfloat), 1);
+}
+
+// The branch records read as line ends: each BranchInstance is the two
+// vec4 vertices of a segment, straight from the cylinder's instance buffer
+void createBranchLineMesh() {
+    const int pointStride = sizeof(BranchInstance) / 2;
+    branchLineMesh.create(false, false, "tree");
+    branchLineMesh.attribute(branchCylinderMesh.instance_vbo, sp->a("vertex"), 4, GL_FLOAT, false, pointStride, 0);
+}
+
+// Twig prototypes and their instances: (axis x, start), (axis y, duration),
+// axis z, origin per instance. The instance pointers recorded here cover the
+// first prototype's group; drawTwigInstances re-points them per group
+const int twigInstanceSizes[4] = {4, 4, 3, 3};
+
+int twigInstanceAttrib(int i) {
+    static const char* names[4] = {"twigAxisX", "twigAxisY", "twigAxisZ", "twigOrigin"};
+    return (int)sp->a(names[i]);
+}
+
+void createTwigMesh() {
+    const int stride = Tree::VERTEX_FLOATS * sizeof(GLfloat);
+    GpuMesh& mesh = twigMesh;
+    mesh.create(true, true, "tree");
+    mesh.attribute(mesh.vbo, sp->a("vertex"), 4, GL_FLOAT, false, stride, 0);
+    mesh.attribute(mesh.vbo, sp->a("texcoord"), 2, GL_FLOAT, false, stride, 4 * sizeof(GLfloat));
+    mesh.attribute(mesh.vbo, sp->a("normal"), 3, GL_FLOAT, false, stride, 6 * sizeof(GLfloat));
+    for (int i = 0; i < 4; i++) {
+        mesh.attribute(mesh.instance_vbo, twigInstanceAttrib(i), twigInstanceSizes[i], GL_FLOAT, false,
+                       sizeof(TwigInstance), i * 4 * sizeof(GLfloat), 1);
+    }
+}
+
+// Scatter the GPU trees as the forest is scattered, planted on the terrain,
+// each with the hero tree's parameters and a seed of its own
+void scatterGpuTrees() {
+    const TreeParameters parameters = tree->getParameters();
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < gpuTreeCount; i++) {
+        glm::vec3 position;
+        for (int attempt = 0; attempt < 16; attempt++) {
+            position = glm::vec3((2.0f * unit(random) - 1.0f) * forestExtent, 0.0f,
+                                 (2.0f * unit(random) - 1.0f) * forestExtent);
+            if (glm::length(position) >= 2.0f) break;
+        }
+        position.y = terrain.heightAt(position.x, position.z);
+        float scale = 0.15f + 0.2f * unit(random);
+        float yaw = 2.0f * glm::pi<float>() * unit(random);
+        gpuTrees.addTree(position, scale, yaw, 2000 + i, parameters);
+    }
+}
+
+// What the GPU generated and how long it took; waits for the generation
+void printGpuTreeStats(std::ostream& os) {
+    os << "GPU trees: " << gpuTrees.getTreeCount() << " trees, " << gpuTrees.getBranchCount()
+       << " branches and " << gpuTrees.getLeafCount() << " leaves generated in "
+       << gpuTrees.getGenerationMs() << " ms";
+    if (gpuTrees.getDropped() > 0) os << " (" << gpuTrees.getDropped() << " dropped, out of room)";
+    os << std::endl;
+}
+
+// Create every scene mesh and record its layout against the shader's
+// attribute locations; the command-line options fix the tree vertex format
+// for the whole run
+void createSceneMeshes() {
+    createTreeMesh(branchMesh, true);
+    createTreeMesh(leafMesh, singleSidedLeaves);
+    createLeafQuadMesh();
+    createBranchCylinderMesh();
+    createBranchLineMesh();
+    createTwigMesh();
+    if (usingImpostors()) createImpostorMesh();
+    if (leafCardsEnabled) createCardMesh();
+    if (forest.getArchetypeCount() > 0) {
+        forest.upload();
+        glState.invalidateTextures();
+    }
+    if (treeGenerateProgram) {
+        gpuTrees.generate(glState, treeGenerateProgram.get());
+        if (verbosity >= 1) {
+            std::ostringstream stats;
+            printGpuTreeStats(stats);
+            Log::write(LogLevel::Info, LogCategory::Render, stats.str());
+        }
+    }
+    terrain.upload();
+    glState.invalidateTextures();
+    if (grass.getChunkCount() > 0) {
+        grass.upload();
+        glState.invalidateTextures();
+    }
+}
+
+// Draw one tree mesh. growthMode 0 = CPU-animated vertices, 1/2 =
+// GPU-animated branch/leaf vertices with growth attributes
+void drawTreeMesh(const GpuMesh& mesh, int count, int growthMode) {
+    glState.uniform1i("growthMode", growthMode);
+    mesh.bind();
+    mesh.draw(count);
+    GpuMesh::unbind();
+    glState.uniform1i("growthMode", 0);
+}
+
+// Whether this frame's tree meshes are drawn from the culled ranges; the
+// BVH bounds the CPU-animated geometry only
+bool cullingTreeMeshes() {
+    return (frustumCulling || treeLodEnabled) && !gpuGrowth;
+}
+
+// Whether this frame's culled meshes are drawn as meshlets
+bool usingMeshlets() {
+    return meshletCulling && frustumCulling && !treeLodEnabled && cullingTreeMeshes();
+}
+
+// Whether the fading elements of a level change are queued this frame
+bool fadingTreeLod() {
+    return treeLodEnabled && cullingTreeMeshes() && treeLod.isFading();
+}
+
+// Draw the visible ranges of a CPU-animated tree mesh
+void drawTreeRanges(const GpuMesh& mesh, const TreeDrawRanges& ranges) {
+    mesh.bind();
+    mesh.drawRanges(ranges.first.data(), ranges.count.data(), ranges.getRangeCount());
+    GpuMesh::unbind();
+}
+
+// Upload the unit cylinder's vertices and the first branch slot's indices,
+// which stitch its two rings
+void uploadBranchCylinder() {
+    const int ringVertices = Tree::BRANCH_RING_VERTICES;
+    const glm::vec2* circle = Tree::ringUnitCircle(ringVertices - 1);
+    std::vector<float> cylinder;
+    for (int ring = 0; ring < 2; ring++) {
+        for (int i = 0; i < ringVertices; i++) {
+            float u = (float)i / (ringVertices - 1);
+            cylinder.insert(cylinder.end(), {circle[i].x, circle[i].y, (float)ring, 1.0f, u, (float)ring});
+        }
+    }
+    branchCylinderMesh.uploadVertices(cylinder.data(), cylinder.size() * sizeof(float), GL_STATIC_DRAW);
+    
+    // Instanced trees use 8-sided rings and no tubes, so slot 0 indexes
+    // exactly vertices 0..17
+    const std::vector<GLuint>& indices = tree->getBranchIndices();
+    std::vector<GLuint> slotIndices(indices.begin(), indices.begin() + Tree::BRANCH_SLOT_INDICES);
+    branchCylinderMesh.uploadIndices(slotIndices);
+}
+
+// Draw every started branch as an instance of the unit cylinder
+void drawBranchInstances(int instanceCount) {
+    glState.uniform1i("growthMode", 4);
+    branchCylinderMesh.bind();
+    branchCylinderMesh.drawInstanced(Tree::BRANCH_SLOT_INDICES, instanceCount);
+    GpuMesh::unbind();
+    glState.uniform1i("growthMode", 0);
+}
+
+// Whether the branches are drawn as lines or tube patches (only the
+// CPU-animated records are)
+bool usingBranchLines() {
+    return (branchLines || branchTubes) && !gpuGrowth;
+}
+
+// The define of the programs that expand them
+const char* branchLineDefine() {
+    return branchTubes ? "BRANCH_TUBES" : "BRANCH_LINES";
+}
+
+// Draw every started branch as a line or patch for the later stages to
+// expand, as finely as pixelScale makes it large on screen (0 = the CPU
+// mesh's 8 sides)
+void drawBranchLines(float pixelScale) {
+    glState.uniform1f("branchPixelScale", pixelScale);
+    branchLineMesh.bind();
+    if (branchTubes) {
+        branchLineMesh.drawPatches(2 * treeDraw.branch_instances);
+    } else {
+        branchLineMesh.drawLines(2 * treeDraw.branch_instances);
+    }
+    GpuMesh::unbind();
+}
+
+// Draw every started leaf as an instance of the unit quad
+void drawLeafInstances(int instanceCount) {
+    glState.uniform1i("growthMode", 3);
+    leafQuadMesh.bind();
+    leafQuadMesh.drawInstanced(6, instanceCount);
+    GpuMesh::unbind();
+    glState.uniform1i("growthMode", 0);
+}
+
+// Upload a tree's twig prototypes and instances; both are fixed once the
+// tree is generated
+void uploadTwigs() {
+    std::shared_ptr<const TwigLibrary> library = tree->getTwigLibrary();
+    const std::vector<TwigInstance>& instances = tree->getTwigInstances();
+    if (!library || instances.empty()) return;
+    
+    twigMesh.uploadVertices(library->vertices.data(), library->vertices.size() * sizeof(float), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, twigMesh.instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(TwigInstance), instances.data(), GL_STATIC_DRAW);
+    MemoryStats::trackBuffer(twigMesh.instance_vbo, instances.size() * sizeof(TwigInstance), "tree");
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    twigMesh.uploadIndices(library->indices);
+}
+
+// Draw the wood (or leaves) of every twig, one instanced draw per prototype.
+// Instances are grouped by prototype; without base-instance draws (GL 3.3)
+// the instance attributes are re-pointed at each group. The shader hides
+// twigs that haven't started
+void drawTwigInstances(bool leafPass) {
+    std::shared_ptr<const TwigLibrary> library = tree->getTwigLibrary();
+    const std::vector<int>& offsets = tree->getTwigOffsets();
+    if (!library || tree->getTwigInstances().empty()) return;
+    const int instanceStride = sizeof(TwigInstance);
+    glState.uniform1i("growthMode", 5);
+    
+    int instanceAttribs[4];
+    for (int i = 0; i < 4; i++) {
+        instanceAttribs[i] = twigInstanceAttrib(i);
+    }
+    twigMesh.bind();
+    glBindBuffer(GL_ARRAY_BUFFER, twigMesh.instance_vbo);
+    for (size_t k = 0; k < library->prototypes.size(); k++) {
+        int count = offsets[k + 1] - offsets[k];
+        if (count == 0) continue;
+        size_t base = offsets[k] * (size_t)instanceStride;
+        for (int i = 0; i < 4; i++) {
+            if (instanceAttribs[i] < 0) continue;
+            glVertexAttribPointer(instanceAttribs[i], twigInstanceSizes[i], GL_FLOAT, false, instanceStride,
+                                  (void*)(base + i * 4 * sizeof(GLfloat)));
+        }
+        const TwigPrototype& prototype = library->prototypes[k];
+        int first = leafPass ? prototype.first_leaf_index : prototype.first_wood_index;
+        int indexCount = leafPass ? prototype.leaf_index_count : prototype.wood_index_count;
+        twigMesh.drawInstanced(indexCount, count, first);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GpuMesh::unbind();
+    
+    glState.uniform1i("growthMode", 0);
+}
+
+// The frame's draws, issued sorted by pass, render state and depth. A
+// material's state is its program's rank * 256 + its index, so the
+// materials of one program sort together (rankMaterialStates)
+RenderQueue renderQueue;
+std::vector<int> materialStates;
+glm::mat4 frameView = glm::mat4(1.0f); // V of the frame being queued
+
+void rankMaterialStates() {
+    std::vector<const ShaderProgram*> programs;
+    materialStates.clear();
+    for (int id = 0; id < materials.getCount(); id++) {
+        const ShaderProgram* program = materials.get(id).program;
+        int rank = std::find(programs.begin(), programs.end(), program) - programs.begin();
+        if (rank == (int)programs.size()) programs.push_back(program);
+        materialStates.push_back(rank * 256 + id);
+    }
+}
+
+// Queue a draw, its depth taken at center in object space
+void queueDraw(int material, const glm::mat4& model, void (*issue)(const RenderItem&),
+               const GpuMesh* mesh = nullptr, int count = 0, int pass = 0,
+               const glm::vec3& center = glm::vec3(0.0f)) {
+    float depth = RenderQueue::viewDepth(frameView, model, center);
+    renderQueue.submit(pass, materialStates[material], material, depth, model, issue, mesh, count);
+}
+
+void issueStaticProps(const RenderItem&) {
+    staticProps.draw();
+}
+
+void issueTerrain(const RenderItem&) {
+    terrain.draw(glState);
+}
+
+void issueGrass(const RenderItem&) {
+    grass.draw(glState, terrain);
+}
+
+// Branches and twig wood, the culled ranges only when culled
+void drawTreeWood(bool culled) {
+    if (usingBranchLines()) {
+        // Drawn by drawBranchLines, with the line programs
+    } else if (instancedBranches && !gpuGrowth) {
+        drawBranchInstances(treeDraw.branch_instances);
+    } else if (culled && usingMeshlets()) {
+        treeMeshlets.drawWood(branchMesh);
+    } else if (culled) {
+        drawTreeRanges(branchMesh, visibleBranches);
+    } else {
+        drawTreeMesh(branchMesh, treeDraw.branch_indices, gpuGrowth ? 1 : 0);
+    }
+    drawTwigInstances(false);
+}
+
+void issueTreeWood(const RenderItem&) {
+    drawTreeWood(cullingTreeMeshes());
+}
+
+void issueBranchLines(const RenderItem&) {
+    drawBranchLines(branchPixelScale);
+}
+
+// Leaves and twig leaves, alpha tested against the cutoff. Single-sided
+// leaves are indexed and flip their normal on the back face; nothing in the
+// scene enables GL_CULL_FACE, so both faces rasterize
+void drawLeaves(bool culled) {
+    glState.uniform1f("alphaCutoff", msaaSamples > 0 ? leafCoverageCutoff : leafAlphaCutoff);
+    glState.uniform1i("twoSidedLeaves", (singleSidedLeaves || instancedLeaves) ? 1 : 0);
+    if (instancedLeaves && !gpuGrowth) {
+        drawLeafInstances(treeDraw.leaf_instances);
+    } else if (culled && usingMeshlets() && treeMeshlets.getLeafMeshletCount() > 0) {
+        treeMeshlets.drawLeaves(leafMesh);
+    } else if (culled) {
+        drawTreeRanges(leafMesh, visibleLeaves);
+    } else if (singleSidedLeaves) {
+        drawTreeMesh(leafMesh, treeDraw.leaf_indices, gpuGrowth ? 2 : 0);
+    } else {
+        drawTreeMesh(leafMesh, treeDraw.leaf_vertices, gpuGrowth ? 2 : 0);
+    }
+    // Twig leaves are single-sided quads
+    glState.uniform1i("twoSidedLeaves", 1);
+    drawTwigInstances(true);
+}
+
+// Leaves, in the depth prepass and when lit
+void issueTreeLeaves(const RenderItem&) {
+    if (msaaSamples > 0) glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    drawLeaves(cullingTreeMeshes());
+    if (msaaSamples > 0) glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+}
+
+// The branches a level change fades in or out, dithered to its opacity
+void issueFadingWood(const RenderItem&) {
+    glState.uniform1f("lodFade", treeLod.getFadeOpacity());
+    drawTreeRanges(branchMesh, fadingBranches);
+}
+
+// The fading leaves, alpha tested like the rest
+void issueFadingLeaves(const RenderItem&) {
+    glState.uniform1f("lodFade", treeLod.getFadeOpacity());
+    glState.uniform1f("alphaCutoff", msaaSamples > 0 ? leafCoverageCutoff : leafAlphaCutoff);
+    glState.uniform1i("twoSidedLeaves", singleSidedLeaves ? 1 : 0);
+    if (msaaSamples > 0) glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    drawTreeRanges(leafMesh, fadingLeaves);
+    if (msaaSamples > 0) glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+}
+
+// Rebuild and upload the leaf cards when growth moved them since they were
+// last drawn
+void updateLeafCards() {
+    if (!cardsStale) return;
+    leafCards.update(*tree);
+    const std::vector<float>& vertices = leafCards.getVertices();
+    cardMesh.uploadVertices(vertices.data(), vertices.size() * sizeof(float), GL_DYNAMIC_DRAW);
+    cardsStale = false;
+}
+
+// The leaf cards at their opacity, dithered while they fade
+void issueLeafCards(const RenderItem&) {
+    float opacity = treeLod.getCardOpacity();
+    if (opacity < 1.0f) glState.uniform1f("lodFade", opacity);
+    glState.uniform1f("alphaCutoff", msaaSamples > 0 ? leafCoverageCutoff : leafAlphaCutoff);
+    glState.uniform1i("twoSidedLeaves", 0);
+    if (msaaSamples > 0) glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    drawTreeMesh(cardMesh, leafCards.getVertexCount(), 0);
+    if (msaaSamples > 0) glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+}
+
+// The forest's visible instances, a draw per archetype and level
+void issueForestWood(const RenderItem&) {
+    forest.drawWood(glState);
+}
+
+void issueForestLeaves(const RenderItem&) {
+    glState.uniform1f("alphaCutoff", msaaSamples > 0 ? leafCoverageCutoff : leafAlphaCutoff);
+    if (msaaSamples > 0) glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    forest.drawLeaves(glState);
+    if (msaaSamples > 0) glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+}
+
+// The GPU-generated trees, one indirect draw each
+void issueGpuTreeWood(const RenderItem&) {
+    gpuTrees.drawWood(glState);
+}
+
+void issueGpuTreeLeaves(const RenderItem&) {
+    glState.uniform1f("alphaCutoff", msaaSamples > 0 ? leafCoverageCutoff : leafAlphaCutoff);
+    glState.uniform1i("twoSidedLeaves", 1); // Single-sided quads, like the leaf instances
+    if (msaaSamples > 0) glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    gpuTrees.drawLeaves(glState);
+    if (msaaSamples > 0) glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+}
+
+// The falling leaves, one indirect draw of them all
+void issueFallingLeaves(const RenderItem&) {
+    glState.uniform1f("alphaCutoff", msaaSamples > 0 ? leafCoverageCutoff : leafAlphaCutoff);
+    glState.uniform1i("twoSidedLeaves", 1);
+    if (msaaSamples > 0) glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+    leafParticles.draw(glState);
+    if (msaaSamples > 0) glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+}
+
+// Drop the instanced leaves of the tree and the GPU trees whose drop time
+// the season passed into the falling leaves, and step them all
+void updateFallingLeaves(const FrameUniforms& frame, const glm::mat4& M, float deltaTime) {
+    GpuProfileScope timed(gpuProfiler, "falling leaves");
+    leafParticles.advanceSeason(frame.season);
+    if (instancedLeaves && !gpuGrowth && treeDraw.leaf_instances > 0) {
+        leafParticles.emitSeasonal(glState, leafQuadMesh.instance_vbo, treeDraw.leaf_instances, M);
+    }
+    if (gpuTrees.isGenerated()) {
+        leafParticles.emitSeasonal(glState, gpuTrees.getLeafBuffer(), gpuTrees.getLeafCount(), glm::mat4(1.0f));
+    }
+    leafParticles.simulate(glState, deltaTime, frame.time, frame.wind, frame.wind_gusts, terrain);
+}
+
+// The impostor copies, and the tree itself when it is drawn as one
+void issueImpostors(const RenderItem&) {
+    treeImpostor.apply(glState);
+    glState.uniform1f("alphaCutoff", leafAlphaCutoff);
+    impostorMesh.bind();
+    impostorMesh.drawInstanced(6, impostorCount + (treeAsImpostor ? 1 : 0));
+    GpuMesh::unbind();
+}
+
+// Uniforms every program variant needs, set once per frame after the
+// variant is put in use
+void setProgramUniforms() {
+    glState.uniform1i("materialTexture", MaterialLibrary::TEXTURE_UNIT); // Each material's texture
+    glState.uniform1i("branchData", 5);  // Branch growth table on unit 5
+    glState.uniform1i("clusterGrid", LightBuffer::GRID_UNIT);    // Lights per view cluster
+    glState.uniform1i("clusterLights", LightBuffer::INDEX_UNIT);
+    glState.uniform1i("sunShadow", ShadowMaps::CASCADE_UNIT);   // Shadow maps
+    glState.uniform1i("torchShadow", ShadowMaps::CUBE_UNIT);
+    glState.uniform1i("growthMode", 0);  // Cubes use final positions
+    glState.uniform1f("growthTime", frameGrowthTime);
+    glState.uniform1i("fallingLeaves", leafParticles.isCreated() ? 1 : 0);
+    glState.uniform1i("skyLighting", skyEnabled && sky.isReady() ? 1 : 0);
+    glState.uniform1i("skyView", Sky::VIEW_UNIT);
+    glState.uniform3fv("sunDirection", glm::value_ptr(sky.getSunDirection()));
+}
+
+// Whether a draw goes through the depth prepass this frame
+bool prepassed(const RenderItem& draw) {
+    if (materials.get(draw.material).depth_program == nullptr) return false;
+    return depthPrepass || (leafPrepass && draw.pass == 1);
+}
+
+// The GPU profiler's name for the draws of a material
+const char* gpuPassName(int material) {
+    if (material == barkMaterial) return "branches";
+    if (material == leafMaterial) return "leaves";
+    if (material == propMaterial) return "sun and torches";
+    if (material == terrainMaterial) return "ground";
+    if (material == grassMaterial) return "grass";
+    if (material == barkFadeMaterial || material == leafFadeMaterial) return "tree LOD fade";
+    if (material == leafCardMaterial || material == leafCardFadeMaterial) return "leaf cards";
+    if (material == branchLineMaterial) return "branch lines";
+    if (material == forestBarkMaterial) return "forest branches";
+    if (material == forestLeafMaterial) return "forest leaves";
+    if (material == impostorMaterial) return "impostors";
+    return "other";
+}
+
+// Issue the draws of one pass over the queue: the depth prepass (color
+// writes off, each material's depth program) or the lit pass. Each run of
+// draws of one material is timed as a GPU pass
+void issueScenePass(const glm::mat4& P, const glm::mat4& V, bool depth) {
+    int applied = -1;
+    bool equalDepth = false;
+    for (const RenderItem& draw : renderQueue.getItems()) {
+        bool prepass = prepassed(draw);
+        if (depth && !prepass) continue;
+        if (draw.material != applied) {
+            if (applied >= 0) gpuProfiler.end();
+            gpuProfiler.begin(gpuPassName(draw.material));
+            ShaderProgram* previous = glState.getProgram();
+            if (depth) materials.applyDepth(draw.material, glState);
+            else materials.apply(draw.material, glState);
+            if (glState.getProgram() != previous) {
+                setProgramUniforms();
+            }
+            applied = draw.material;
+        }
+        // A prepassed draw is lit only where its own depth won, so every
+        // visible fragment is shaded once and hidden ones not at all
+        if (!depth && prepass != equalDepth) {
+            glDepthFunc(prepass ? GL_EQUAL : GL_LESS);
+            glDepthMask(prepass ? GL_FALSE : GL_TRUE);
+            equalDepth = prepass;
+        }
+        glm::mat4 MV = V * draw.model;
+        glm::mat4 MVP = P * MV;
+        glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(MV));
+        glState.uniformMatrix4fv("MV", glm::value_ptr(MV));
+        glState.uniformMatrix4fv("MVP", glm::value_ptr(MVP));
+        glState.uniformMatrix3fv("normalMatrix", glm::value_ptr(normalMatrix));
+        if (stereoRendering) glState.uniform1i("viewCount", GpuMesh::getViewCount());
+        draw.issue(draw);
+    }
+    if (applied >= 0) gpuProfiler.end();
+    if (equalDepth) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+}
+
+// Issue the sorted queue's draws by pass, grouped by program variant and
+// material, front to back within each, for the view P, V; the queue is
+// kept for the next view. Each draw's model-view, model-view-projection
+// and normal matrices are multiplied out here, once per draw instead of
+// once per vertex. With a depth prepass the prepassed draws first lay down
+// their depth alone
+void issueSceneDraws(const glm::mat4& P, const glm::mat4& V) {
+    if (stereoRendering) {
+        GpuMesh::setViewCount(2);
+        glEnable(GL_CLIP_DISTANCE0);
+    }
+    if (depthPrepass || leafPrepass) {
+        GpuProfileScope pass(gpuProfiler, "depth prepass");
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        issueScenePass(P, V, true);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+    {
+        GpuProfileScope pass(gpuProfiler, "scene");
+        issueScenePass(P, V, false);
+    }
+    if (stereoRendering) {
+        GpuMesh::setViewCount(1);
+        glDisable(GL_CLIP_DISTANCE0);
+    }
+}
+
+// Draw one material's shadow casters into the pass' map with its depth program
+void castShadows(int material, const glm::mat4& viewProjection, void (*draw)()) {
+    ShaderProgram* previous = glState.getProgram();
+    materials.applyDepth(material, glState);
+    if (glState.getProgram() != previous) {
+        setProgramUniforms();
+    }
+    glState.uniformMatrix4fv("MVP", glm::value_ptr(viewProjection));
+    if (stereoRendering) glState.uniform1i("viewCount", 1);
+    draw();
+}
+
+// The casters: the whole tree whatever the camera sees, the forest and
+// the ground as selected for the camera
+void castTerrain() {
+    terrain.draw(glState);
+}
+
+void castTreeWood() {
+    drawTreeWood(false);
+}
+
+void castBranchLines() {
+    drawBranchLines(0.0f);
+}
+
+void castTreeLeaves() {
+    drawLeaves(false);
+}
+
+void castForestWood() {
+    forest.drawWood(glState);
+}
+
+void castForestLeaves() {
+    glState.uniform1f("alphaCutoff", leafAlphaCutoff);
+    forest.drawLeaves(glState);
+}
+
+void castGpuTreeWood() {
+    gpuTrees.drawWood(glState);
+}
+
+void castGpuTreeLeaves() {
+    glState.uniform1f("alphaCutoff", leafAlphaCutoff);
+    glState.uniform1i("twoSidedLeaves", 1);
+    gpuTrees.drawLeaves(glState);
+}
+
+// Redraw the shadow maps that are due. The ground is static; the tree is
+// dynamic while it grows or, grown on the GPU, sways in the wind, the
+// forest while there is wind or any of it still grows. A change in which
+// casters are static, a new layout or a static tree that moved anyway (a
+// seek) redraws the caches
+void renderShadowMaps(const glm::mat4& V, const glm::vec3& toSun, bool treeMoved, int viewportWidth,
+                      int viewportHeight) {
+    if (!shadowMaps.hasCascades() && !shadowMaps.hasCube()) return;
+    bool treeDrawn = !treeAsImpostor && treeDraw.branches > 0;
+    bool treeDynamic = treeDrawn && ((!growthPaused && !treeDraw.grown) || (gpuGrowth && windStrength > 0.0f));
+    bool forestDrawn = forest.getArchetypeCount() > 0;
+    bool forestDynamic = forestDrawn && (windStrength > 0.0f || !forest.isGrownAt((float)sceneClock()));
+    int kinds = (treeDrawn ? 1 : 0) | (treeDynamic ? 2 : 0) | (forestDynamic ? 4 : 0);
+    if (kinds != shadowCasterKinds || shadowCastersStale || (treeMoved && !treeDynamic)) {
+        shadowMaps.invalidateStatic();
+    }
+    shadowCasterKinds = kinds;
+    shadowCastersStale = false;
+    
+    shadowMaps.plan(V, camera.getFieldOfView(), camera.getAspectRatio(), camera.getNearPlane(), toSun,
+                    treeDynamic || forestDynamic);
+    if (!shadowMaps.getPasses().empty()) {
+        GpuProfileScope timed(gpuProfiler, "shadow maps");
+        // Casters in front of a cascade's near plane still cast, flattened onto it
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+        for (const ShadowMaps::Pass& pass : shadowMaps.getPasses()) {
+            shadowMaps.beginPass(pass);
+            bool dynamicPass = pass.casters == ShadowMaps::DYNAMIC_CASTERS;
+            if (!dynamicPass) {
+                castShadows(terrainMaterial, pass.view_projection, castTerrain);
+                // The GPU trees never move once generated
+                if (gpuTrees.isGenerated()) {
+                    castShadows(barkMaterial, pass.view_projection, castGpuTreeWood);
+                    castShadows(leafMaterial, pass.view_projection, castGpuTreeLeaves);
+                }
+            }
+            if (treeDrawn && treeDynamic == dynamicPass) {
+                castShadows(barkMaterial, pass.view_projection, castTreeWood);
+                if (usingBranchLines()) castShadows(branchLineMaterial, pass.view_projection, castBranchLines);
+                castShadows(leafMaterial, pass.view_projection, castTreeLeaves);
+            }
+            if (forestDrawn && forestDynamic == dynamicPass) {
+                castShadows(forestBarkMaterial, pass.view_projection, castForestWood);
+                castShadows(forestLeafMaterial, pass.view_projection, castForestLeaves);
+            }
+        }
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_DEPTH_CLAMP);
+        shadowMaps.endPasses(viewportWidth, viewportHeight, sceneFramebuffer());
+    }
+    shadowMaps.upload(V);
+    shadowMaps.bind(glState);
+}
+
+// Render the grown tree into the impostor atlas, once per frame direction,
+// with the bake variants of its materials. The tree's space is the view
+// space here, so the atlas holds the tree's own normals
+void bakeImpostor(GLFWwindow* window) {
+    PROFILE_SCOPE("bakeImpostor");
+    treeBvh.refit(*tree);
+    glm::vec3 low, high;
+    if (!treeBvh.getBounds(low, high)) return;
+    treeImpostor.beginBake(0.5f * (low + high), 0.5f * glm::length(high - low));
+    
+    const glm::mat4 identity = glm::mat4(1.0f);
+    const glm::mat3 normalMatrix = glm::mat3(1.0f);
+    const int bakeMaterials[3] = { barkBakeMaterial, leafBakeMaterial, branchLineBakeMaterial };
+    for (int m = 0; m < (usingBranchLines() ? 3 : 2); m++) {
+        materials.apply(bakeMaterials[m], glState);
+        setProgramUniforms();
+        glState.uniformMatrix4fv("MV", glm::value_ptr(identity));
+        glState.uniformMatrix3fv("normalMatrix", glm::value_ptr(normalMatrix));
+        for (int y = 0; y < treeImpostor.getFrames(); y++) {
+            for (int x = 0; x < treeImpostor.getFrames(); x++) {
+                glm::mat4 MVP = treeImpostor.beginFrame(x, y);
+                glState.uniformMatrix4fv("MVP", glm::value_ptr(MVP));
+                if (m == 0) drawTreeWood(false);
+                else if (m == 1) drawLeaves(false);
+                else drawBranchLines(0.0f);
+            }
+        }
+    }
+    
+    int framebufferWidth, framebufferHeight;
+    sceneSize(window, framebufferWidth, framebufferHeight);
+    treeImpostor.endBake(framebufferWidth, framebufferHeight, sceneFramebuffer());
+    glState.invalidateTextures();
+    if (verbosity >= 1) {
+        LOG_INFO(Render) << "Impostor baked: " << treeImpostor.getFrames() << "x" << treeImpostor.getFrames()
+                         << " frames of " << treeImpostor.getCellSize() << " px";
+    }
+}
+
+// Error handling callback
+void error_callback(int error, const char* description) {
+    fputs(description, stderr);
+}
+
+// Apply the command-line options to a tree before it is generated
+void configureTree(Tree& target) {
+    target.setVerbosity(verbosity);
+    target.setMeshAnimation(gpuGrowth ? MeshAnimation::Gpu : MeshAnimation::Cpu);
+    target.setBranchMeshing(tubeBranches ? BranchMeshing::Tubes : BranchMeshing::Cylinders);
+    target.setBranchCurvature(branchCurvature, curveVertexBudget);
+    target.setLeafFaces(singleSidedLeaves ? LeafFaces::SingleSided : LeafFaces::DoubleSided);
+    target.setLeafLayout(mortonLeaves ? LeafLayout::Morton : LeafLayout::Generation);
+    target.setLeafRendering(instancedLeaves ? LeafRendering::Instanced : LeafRendering::Mesh);
+    target.setBranchRendering(instancedBranches ? BranchRendering::Instanced : BranchRendering::Mesh);
+    target.setGenerationThreads(generationThreads);
+    target.setUpdateThreads(updateThreads);
+    target.setGrammar(treeGrammar);
+    target.setGenerator(spaceColonization ? TreeGenerator::SpaceColonization : TreeGenerator::Branching);
+    target.setTwigInstancing(twigInstances ? 4 : 0, 8);
+    target.setBranchAvoidance(avoidOverlaps);
+    if (bakedOcclusionRays > 0) {
+        const int rays = bakedOcclusionRays;
+        target.setOcclusionBaker([rays](const Tree& tree, std::vector<float>& branch, std::vector<float>& leaf) {
+            bakeTreeOcclusion(tree, rays, branch, leaf);
+        }, rays);
+    }
+    target.setBudget(treeBudget);
+    target.setLazyDetail(lazyDetailGeneration);
+    target.setParameters(treeProfiles.get("tree", target.getParameters()));
+}
+
+// Generate the forest's archetypes and scatter its instances. They grow
+// on the GPU from static meshes whatever the hero tree does, with indexed
+// single-sided leaves for the levels of detail
+std::unique_ptr<Tree> makeArchetype() {
+    std::unique_ptr<Tree> archetype(new Tree);
+    configureTree(*archetype);
+    archetype->setVerbosity(0);
+    archetype->setMeshAnimation(MeshAnimation::Gpu);
+    archetype->setLeafFaces(LeafFaces::SingleSided);
+    archetype->setLeafRendering(LeafRendering::Mesh);
+    archetype->setBranchRendering(BranchRendering::Mesh);
+    archetype->setTwigInstancing(0, 8);
+    archetype->setLazyDetail(0);
+    archetype->setParameters(treeProfiles.get("forest", archetype->getParameters()));
+    return archetype;
+}
+
+void generateForest() {
+    for (int k = 0; k < forestArchetypes; k++) {
+        std::unique_ptr<Tree> archetype = makeArchetype();
+        treeCache.generate(*archetype, 1000 + k);
+        forest.addArchetype(std::move(archetype));
+    }
+    if (forestSpacing > 0.0f) {
+        forestPlacement.setKinds(forest.getCrownRadii());
+        forestPlacement.setScaleRange(0.15f, 0.35f);
+        forestPlacement.setSpacing(forestSpacing);
+        // Clear of the tree at the origin
+        forestPlacement.setDensity([](float x, float z) { return x * x + z * z < 4.0f ? 0.0f : 1.0f; });
+        std::vector<ForestInstance> placed;
+        ForestScene::place(forestPlacement, glm::vec2(-forestExtent), glm::vec2(forestExtent), forestCount, 20.0f,
+                           1, placed);
+        for (const ForestInstance& instance : placed) forest.addInstance(instance);
+    } else {
+        forest.scatter(forestCount, forestExtent, 2.0f, 0.15f, 0.35f, 20.0f, 1);
+    }
+    forest.setLodBias(treeLodBias);
+    forest.setFog(&distanceFog);
+    forest.setSelectThreads(forestSelectThreads);
+    
+    // Planted on the terrain
+    std::vector<ForestInstance> instances = forest.getInstances();
+    forest.clearInstances();
+    for (ForestInstance& instance : instances) {
+        instance.position.y = terrain.heightAt(instance.position.x, instance.position.z);
+        forest.addInstance(instance);
+    }
+}
+
+// One chunk of --world, from a seed of its coordinates alone so it comes
+// back the same once dropped, planted on the terrain clear of the tree.
+// Runs on the workers, reading only what stays put while chunks stream
+void buildWorldChunk(int chunkX, int chunkZ, std::vector<ForestInstance>& instances) {
+    const uint32_t seed = (uint32_t)chunkX * 73856093u ^ (uint32_t)chunkZ * 19349663u ^ 0x5bd1e995u;
+    if (forestSpacing > 0.0f) {
+        ForestScene::place(forestPlacement, glm::vec2(chunkX, chunkZ) * worldChunkSize,
+                           glm::vec2(chunkX + 1, chunkZ + 1) * worldChunkSize, worldChunkTrees, 20.0f, seed, instances);
+        for (ForestInstance& instance : instances) {
+            instance.position.y = terrain.heightAt(instance.position.x, instance.position.z);
+        }
+        return;
+    }
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    instances.reserve(worldChunkTrees);
+    for (int i = 0; i < worldChunkTrees; i++) {
+        ForestInstance instance;
+        instance.position = glm::vec3((chunkX + unit(random)) * worldChunkSize, 0.0f,
+                                      (chunkZ + unit(random)) * worldChunkSize);
+        instance.scale = 0.15f + 0.2f * unit(random);
+        instance.yaw = 2.0f * 3.14159265f * unit(random);
+        instance.hue_shift = 0.7f * (unit(random) - 0.5f);
+        instance.growth_offset = 20.0f * unit(random);
+        instance.archetype = random() % forestArchetypes;
+        if (glm::length(glm::vec2(instance.position.x, instance.position.z)) < 2.0f) continue;
+        instance.position.y = terrain.heightAt(instance.position.x, instance.position.z);
+        instances.push_back(instance);
+    }
+}
+
+// Compile the grammar named on the command line; on failure the built-in
+// rules stay in use
+void loadTreeGrammar(const std::string& species, const std::string& grammarFile) {
+    std::string source;
+    if (!grammarFile.empty()) {
+        std::ifstream file(grammarFile.c_str());
+        if (!file) {
+            LOG_ERROR(Tree) << "Cannot open grammar " << grammarFile;
+            return;
+        }
+        std::ostringstream text;
+        text << file.rdbuf();
+        source = text.str();
+    } else if (!species.empty()) {
+        source = LSystemGrammar::builtinSpecies(species);
+        if (source.empty()) {
+            LOG_ERROR(Tree) << "Unknown species " << species << " (broadleaf, conifer, shrub)";
+            return;
+        }
+    } else {
+        return;
+    }
+    
+    std::shared_ptr<LSystemGrammar> grammar(new LSystemGrammar);
+    std::string error;
+    if (!grammar->compile(source, error)) {
+        LOG_ERROR(Tree) << "Grammar error: " << error;
+        return;
+    }
+    treeGrammar = grammar;
+}
+
+// Start generating a replacement tree on a worker, from seed or a random
+// one when negative; ignored while one is pending
+void startTreeGeneration(long long seed = -1) {
+    if (treeJob.isPending()) return;
+    std::unique_ptr<Tree> next(new Tree);
+    configureTree(*next);
+    if (seed >= 0) {
+        treeJob = TreeGenerationJob(std::move(next),
+                                    [seed](Tree& job_tree) { treeCache.generate(job_tree, (uint64_t)seed); });
+    } else {
+        treeJob = generateTreeAsync(std::move(next));
+    }
+}
+
+// A mesh's own indices with its meshlets' copies behind them
+void uploadMeshletIndices(GpuMesh& mesh, const std::vector<GLuint>& indices, const std::vector<GLuint>& meshlets) {
+    std::vector<GLuint> combined(indices);
+    combined.insert(combined.end(), meshlets.begin(), meshlets.end());
+    mesh.uploadIndices(combined);
+}
+
+// Upload what only changes with the tree's layout: index buffers, the
+// GPU-animated meshes and the twig instances. A caller that already
+// followed the edit in the BVH keeps it
+void uploadTreeLayout(bool rebuildBvh = true) {
+    if (rebuildBvh) treeBvh.build(*tree);
+    treeLod.build(*tree);
+    if (leafCardsEnabled) leafCards.build(*tree);
+    treeCullPending = true;
+    cardsStale = true;
+    impostorStale = true;
+    shadowCastersStale = true;
+    if (meshletCulling) {
+        treeMeshlets.build(*tree, singleSidedLeaves && !instancedLeaves);
+        uploadMeshletIndices(branchMesh, tree->getBranchIndices(), treeMeshlets.getWoodIndices());
+    } else {
+        branchMesh.uploadIndices(tree->getBranchIndices());
+    }
+    if (singleSidedLeaves && meshletCulling) {
+        uploadMeshletIndices(leafMesh, tree->getLeafIndices(), treeMeshlets.getLeafIndices());
+    } else if (singleSidedLeaves) {
+        leafMesh.uploadIndices(tree->getLeafIndices());
+    }
+    if (instancedBranches) {
+        uploadBranchCylinder();
+    }
+    if (gpuGrowth) {
+        uploadStaticTree();
+    }
+    uploadTwigs();
+}
+
+// Upload the tree's layout and forget the dynamic buffers, so the next sync
+// uploads them whole
+void reloadTreeBuffers() {
+    uploadTreeLayout();
+    branchVBOSize = 0;
+    leafVBOSize = 0;
+    branchInstanceVBOSize = 0;
+    leafInstanceVBOSize = 0;
+}
+
+void exportTree() {
+    // One file: the previous tree's export finishes first
+    JobSystem::shared().wait(treeExport.job);
+    treeSnapshots.publish(*tree, false);
+    treeExport.snapshot = treeSnapshots.acquire();
+    treeExport.job.setBackground(true);
+    treeExport.job.setTask([]() {
+        PROFILE_SCOPE("exportTree");
+        std::string error;
+        bool glb = exportTreeFile.size() >= 4 && exportTreeFile.compare(exportTreeFile.size() - 4, 4, ".glb") == 0;
+        bool exported;
+        if (glb) {
+            exported = exportGlb(snapshotExportSource(*treeExport.snapshot), exportTreeFile, error);
+        } else {
+            ObjWriter writer;
+            exported = writer.open(exportTreeFile, error);
+            if (exported) {
+                writer.add(snapshotExportSource(*treeExport.snapshot));
+                exported = writer.close(error);
+            }
+        }
+        if (!exported) LOG_ERROR(Tree) << "Cannot export tree: " << error;
+    });
+    JobSystem::shared().submit(treeExport.job);
+}
+
+// Swap in next as the tree
+void installTree(std::unique_ptr<Tree> next) {
+    tree = std::move(next);
+    reloadTreeBuffers();
+    growthTicks = 0;
+    growthTickRemainder = 0.0;
+    if (!saveTreeFile.empty()) {
+        std::string error;
+        if (!tree->save(saveTreeFile, error, true, encodeSavedMesh)) {
+            LOG_ERROR(Tree) << "Cannot save tree: " << error;
+        }
+    }
+    if (!exportTreeFile.empty()) exportTree();
+}
+
+// Swap in the background tree, waiting for it if need be
+void installTree() {
+    installTree(treeJob.take());
+}
+
+// Swap in a finished background tree
+void installReadyTree() {
+    if (treeJob.isReady()) installTree();
+}
+
+// Swap in the next tree waiting in the hand-off ring, one a frame, opening
+// the ring once the generator has made it. The tree loads from the slot in
+// place, which goes back to the generator straight after
+void installHandedOffTree() {
+    if (handoffName.empty()) return;
+    std::string error;
+    if (!treeHandoff.isOpen() && !treeHandoff.open(handoffName, error)) return;
+    size_t bytes;
+    uint64_t sequence;
+    const void* asset = treeHandoff.peek(bytes, sequence);
+    if (!asset) return;
+    std::unique_ptr<Tree> next(new Tree);
+    configureTree(*next);
+    const bool loaded = next->load(asset, bytes, error);
+    treeHandoff.release();
+    if (!loaded) {
+        LOG_ERROR(Tree) << "Cannot load handed-off tree " << sequence << ": " << error;
+        return;
+    }
+    LOG_INFO(Tree) << "Handed-off tree " << sequence << ", " << bytes / 1024 << " KB";
+    installTree(std::move(next));
+}
+
+// Stand a trunk-only tree in for the first one while it generates: one
+// generation without twigs or grammar, generated in a moment
+void generateTreePreview(long long seed) {
+    PROFILE_SCOPE("generateTreePreview");
+    TreeParameters parameters = tree->getParameters();
+    parameters.max_generations = 0;
+    tree->setParameters(parameters);
+    tree->setVerbosity(0);
+    tree->setGrammar(nullptr);
+    tree->setGenerator(TreeGenerator::Branching);
+    tree->setTwigInstancing(0, 8);
+    tree->setLazyDetail(false);
+    tree->generate(seed >= 0 ? (uint64_t)seed : 1);
+}
+
+// The material texture job: materials.ktx2 where the GPU takes S3TC, else
+// materials.pack or else the PNGs, into the builder's mapped buffer
+void decodeMaterialTextures() {
+    PROFILE_SCOPE("decodeMaterialTextures");
+    MaterialTextureLoad& load = materialTextureLoad;
+    std::string error;
+    load.use_compressed = load.try_compressed && loadKtx2(load.compressed, "materials.ktx2", error) &&
+                          load.compressed.layers == MATERIAL_TEXTURE_COUNT;
+    if (load.use_compressed) return;
+    if (verbosity > 0 && !error.empty()) {
+        LOG_WARNING(Texture) << "Using the PNG textures: " << error;
+    }
+    TexturePack texturePack;
+    std::string packError;
+    size_t bundledPackBytes = 0;
+    const unsigned char* bundledPack = ResourceBundle::shared().find("materials.pack", bundledPackBytes);
+    const bool packOpen = bundledPack ? texturePack.open(bundledPack, bundledPackBytes, "materials.pack", packError)
+                                      : texturePack.open("materials.pack", packError);
+    if (packOpen && texturePack.getCount() == MATERIAL_TEXTURE_COUNT) {
+        load.layers->addPack(texturePack);
+    } else {
+        if (verbosity > 0 && texturePack.isOpen()) {
+            LOG_WARNING(Texture) << "Ignoring materials.pack: " << texturePack.getCount() << " images, not "
+                                 << MATERIAL_TEXTURE_COUNT;
+        }
+        load.layers->addPngs(std::vector<std::string>(MATERIAL_TEXTURE_FILES,
+                                                      MATERIAL_TEXTURE_FILES + MATERIAL_TEXTURE_COUNT));
+    }
+}
+
+// Start the job and sample 1x1 placeholders of the layers meanwhile
+void startMaterialTextures() {
+    MaterialTextureLoad& load = materialTextureLoad;
+    load.try_compressed = glewIsSupported("GL_EXT_texture_compression_s3tc");
+    TextureArrayBuilder::setCacheDirectory(textureCacheDirectory);
+    load.layers.reset(new TextureArrayBuilder(1024, 1024));
+    load.layers->mapUploadBuffer(MATERIAL_TEXTURE_COUNT);
+    load.job.setTask(decodeMaterialTextures);
+    load.job.setBackground(true);
+    load.pending = true;
+    JobSystem::shared().submit(load.job);
+    
+    TextureArrayBuilder placeholders(1, 1);
+    for (int layer = 0; layer < MATERIAL_TEXTURE_COUNT; layer++) {
+        placeholders.addImage(MATERIAL_PLACEHOLDERS[layer], 1, 1);
+    }
+    materialTextures = placeholders.upload(1.0f);
+}
+
+// Upload the decoded textures in place of the placeholders, waiting for
+// the job if need be. Impostors and cached shadows drawn with the
+// placeholders are drawn again
+void installMaterialTextures() {
+    PROFILE_SCOPE("installMaterialTextures");
+    MaterialTextureLoad& load = materialTextureLoad;
+    JobSystem::shared().wait(load.job);
+    load.pending = false;
+    const GLuint texture = load.use_compressed ? uploadCompressed(load.compressed, textureAnisotropy)
+                                               : load.layers->upload(textureAnisotropy);
+    load.layers.reset();
+    load.compressed = CompressedTextureArray();
+    MemoryStats::forgetTextures(1, &materialTextures);
+    glDeleteTextures(1, &materialTextures);
+    materialTextures = texture;
+    materials.setTextureArray(materialTextures);
+    glState.invalidateTextures();
+    impostorStale = true;
+    shadowCastersStale = true;
+}
+
+void installReadyMaterialTextures() {
+    if (materialTextureLoad.pending && materialTextureLoad.job.isDone()) installMaterialTextures();
+}
+
+// Replace the forest's archetypes with the finished jobs' trees. The
+// instances stay; the world's chunks are dropped, as their proxies were
+// baked from the old archetypes, and build again
+void installArchetypes() {
+    world.clear();
+    forest.clearArchetypes();
+    for (TreeGenerationJob& job : archetypeJobs) {
+        forest.addArchetype(job.take());
+    }
+    archetypeJobs.clear();
+    forest.upload();
+    glState.invalidateTextures();
+    if (world.isEnabled()) world.apply(forest);
+    shadowCastersStale = true;
+}
+
+// Poll --profiles, and regrow what a change reshaped: the tree from its
+// seed once its job is free, and every archetype at once, swapped in
+// together when the last is done
+void updateTreeProfiles() {
+    if (profileFile.empty()) return;
+    const double now = glfwGetTime();
+    if (now >= profilePollTime) {
+        profilePollTime = now + 0.5;
+        std::string error;
+        if (treeProfiles.reloadIfChanged(error)) {
+            Tree configured;
+            configureTree(configured);
+            treeProfileStale = treeProfileStale || !sameTreeParameters(configured.getParameters(), tree->getParameters());
+            forestProfileStale = forestProfileStale ||
+                                 (forest.getArchetypeCount() > 0 &&
+                                  !sameTreeParameters(makeArchetype()->getParameters(),
+                                                      forest.getArchetype(0).getParameters()));
+            LOG_INFO(Tree) << "Reloaded " << profileFile << (treeProfileStale ? "; regrowing the tree" : "")
+                           << (forestProfileStale ? "; regrowing the forest" : "");
+        } else if (!error.empty()) {
+            LOG_ERROR(Tree) << "Cannot reload profiles: " << error;
+        }
+    }
+    if (treeProfileStale && !treeJob.isPending()) {
+        startTreeGeneration((long long)tree->getSeed());
+        treeProfileStale = false;
+    }
+    if (forestProfileStale && archetypeJobs.empty()) {
+        for (int k = 0; k < forest.getArchetypeCount(); k++) {
+            const uint64_t seed = 1000 + k;
+            archetypeJobs.emplace_back(makeArchetype(),
+                                       [seed](Tree& archetype) { treeCache.generate(archetype, seed); });
+        }
+        forestProfileStale = false;
+    }
+    if (archetypeJobs.empty()) return;
+    for (const TreeGenerationJob& job : archetypeJobs) {
+        if (!job.isReady()) return;
+    }
+    installArchetypes();
+}
+
+// Regrow one random main limb in place; the rest of the tree keeps growing.
+// Recycled slots go up as dirty ranges, appended ones resize the buffers
+void regrowRandomLimb() {
+    std::vector<int> limbs;
+    const std::vector<TreeBranch>& branches = tree->getBranches();
+    for (int i = 0; i < (int)branches.size(); i++) {
+        if (branches[i].generation == 1) limbs.push_back(i);
+    }
+    if (limbs.empty()) return;
+    std::random_device rd;
+    if (tree->regenerateSubtree(limbs[rd() % limbs.size()], rd()) && tree->takeLayoutChanged()) {
+        uploadTreeLayout();
+    }
+}
+
+// World-space ray through the cursor (the tree's space: it stands at the origin)
+void cursorRay(GLFWwindow* window, glm::vec3& origin, glm::vec3& direction) {
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    glm::vec2 ndc(2.0f * (float)x / std::max(width, 1) - 1.0f, 1.0f - 2.0f * (float)y / std::max(height, 1));
+    glm::mat4 inverse = glm::inverse(camera.getViewProjectionMatrix());
+    glm::vec4 near = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+    glm::vec4 far = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+    origin = glm::vec3(near) / near.w;
+    direction = glm::normalize(glm::vec3(far) / far.w - origin);
+}
+
+// The budded leaves of branch and its descendants, let fall as it is cut;
+// the tree stands at the origin
+void dropPrunedLeaves(int branch) {
+    const std::vector<TreeBranch>& branches = tree->getBranches();
+    const std::vector<int>& children = tree->getChildIndices();
+    std::vector<unsigned char> cut(branches.size(), 0);
+    std::vector<int> stack(1, branch);
+    while (!stack.empty()) {
+        int b = stack.back();
+        stack.pop_back();
+        cut[b] = 1;
+        for (int c = 0; c < branches[b].child_count; c++) {
+            stack.push_back(children[branches[b].first_child + c]);
+        }
+    }
+    std::vector<LeafInstance> records;
+    const std::vector<TreeLeaf>& leaves = tree->getLeaves();
+    for (int i = 0; i < (int)leaves.size(); i++) {
+        float growth = tree->leafProgress(i);
+        if (!cut[leaves[i].parent_branch_index] || growth <= 0.0f) continue;
+        LeafInstance record;
+        record.position = leaves[i].position;
+        record.normal = glm::packSnorm3x10_1x2(glm::vec4(leaves[i].normal, 0.0f));
+        record.size = leaves[i].size;
+        record.growth = growth;
+        records.push_back(record);
+    }
+    leafParticles.emit(glState, records, glm::mat4(1.0f));
+}
 
-// Custom torch normals - properly oriented for lighting calculations
-float torchNormals[] = {
-    // Wall 1 (Front face Z-)
-    0.0f, 0.0f, -1.0f,  0.0f, 0.0f, -1.0f,  0.0f, 0.0f, -1.0f,  // Triangle 1
-    0.0f, 0.0f, -1.0f,  0.0f, 0.0f, -1.0f,  0.0f, 0.0f, -1.0f,  // Triangle 2
+// Cut the branch under the cursor. Only its freed slots go up as dirty
+// ranges and the BVH follows the renames; the slots are packed again once
+// the scene is idle (compactTreeSlots)
+void pruneBranchAtCursor(GLFWwindow* window) {
+    glm::vec3 origin, direction;
+    cursorRay(window, origin, direction);
+    treeBvh.refit(*tree); // Boxes at the current growth
+    TreeRayHit hit;
+    if (!treeBvh.raycast(*tree, origin, direction, camera.getFarPlane(), hit)) return;
+    // A leaf stands for the branch that bears it
+    int branch = hit.branch >= 0 ? hit.branch : tree->getLeaves()[hit.leaf].parent_branch_index;
+    if (leafParticles.isCreated()) dropPrunedLeaves(branch);
+    TreeRemap remap;
+    if (!tree->pruneBranch(branch, &remap)) return;
+    treeBvh.remap(*tree, remap);
+    if (tree->takeLayoutChanged()) {
+        uploadTreeLayout(false);
+    }
+}
 
-    // Wall 2 (Back face Z+)
-    0.0f, 0.0f, 1.0f,   0.0f, 0.0f, 1.0f,   0.0f, 0.0f, 1.0f,   // Triangle 1
-    0.0f, 0.0f, 1.0f,   0.0f, 0.0f, 1.0f,   0.0f, 0.0f, 1.0f,   // Triangle 2
+// Pack the slots pruning and regrowth left out of order, rewriting the
+// started elements, so the tree draws its started prefix again
+void compactTreeSlots() {
+    if (!tree->compactSlots()) return;
+    if (tree->takeLayoutChanged()) {
+        reloadTreeBuffers();
+    }
+}
 
-    // Wall 3 (Bottom face Y-)
-    0.0f, -1.0f, 0.0f,  0.0f, -1.0f, 0.0f,  0.0f, -1.0f, 0.0f,  // Triangle 1
-    0.0f, -1.0f, 0.0f,  0.0f, -1.0f, 0.0f,  0.0f, -1.0f, 0.0f,  // Triangle 2
+// Scrub the growth timeline; a rewind that re-lays out the mesh reloads the buffers
+void seekGrowth(float time) {
+    if (growthTickRate > 0.0f) {
+        // Stay on the tick grid
+        growthTicks = std::max(0LL, std::llround(time * growthTickRate));
+        growthTickRemainder = 0.0;
+        time = (float)(growthTicks / (double)growthTickRate);
+    }
+    tree->setGrowthTime(time);
+    if (tree->takeLayoutChanged()) {
+        reloadTreeBuffers();
+    }
+}
 
-    // Wall 4 (Top face Y+)
-    0.0f, 1.0f, 0.0f,   0.0f, 1.0f, 0.0f,   0.0f, 1.0f, 0.0f,   // Triangle 1
-    0.0f, 1.0f, 0.0f,   0.0f, 1.0f, 0.0f,   0.0f, 1.0f, 0.0f,   // Triangle 2
+// Advance growth by one frame's time. With a tick rate the tree only
+// updates when at least one tick has elapsed, and any number of elapsed
+// ticks is a single seek: the state depends on the time alone
+void advanceGrowth(float deltaTime) {
+    if (growthTickRate <= 0.0f) {
+        tree->updateGrowth(deltaTime);
+        return;
+    }
+    growthTickRemainder += deltaTime;
+    long long ticks = (long long)(growthTickRemainder * growthTickRate);
+    if (ticks == 0) return;
+    growthTickRemainder -= ticks / (double)growthTickRate;
+    growthTicks += ticks;
+    tree->setGrowthTime((float)(growthTicks / (double)growthTickRate));
+}
 
-    // Wall 5 (Left face X-)
-    -1.0f, 0.0f, 0.0f,  -1.0f, 0.0f, 0.0f,  -1.0f, 0.0f, 0.0f,  // Triangle 1
-    -1.0f, 0.0f, 0.0f,  -1.0f, 0.0f, 0.0f,  -1.0f, 0.0f, 0.0f,  // Triangle 2
+// Take what this frame's draws read of the tree
+void takeTreeDrawState() {
+    treeDraw.branch_indices = tree->getBranchIndexCount();
+    treeDraw.leaf_indices = tree->getLeafIndexCount();
+    treeDraw.leaf_vertices = tree->getLeafVertexCount();
+    treeDraw.branch_instances = tree->getBranchInstanceCount();
+    treeDraw.leaf_instances = tree->getLeafInstanceCount();
+    treeDraw.branches = tree->getBranchCount();
+    treeDraw.grown = tree->isStatic();
+}
 
-    // Wall 6 (Right face X+)
-    1.0f, 0.0f, 0.0f,   1.0f, 0.0f, 0.0f,   1.0f, 0.0f, 0.0f,   // Triangle 1
-    1.0f, 0.0f, 0.0f,   1.0f, 0.0f, 0.0f,   1.0f, 0.0f, 0.0f    // Triangle 2
-};
+// Re-create the per-frame tree buffers with a new usage hint on the next sync
+void setTreeBufferUsage(GLenum usage) {
+    if (usage == treeBufferUsage) return;
+    treeBufferUsage = usage;
+    branchVBOSize = 0;
+    leafVBOSize = 0;
+    branchInstanceVBOSize = 0;
+    leafInstanceVBOSize = 0;
+}
 
-GLuint readTexture(const char* filename) {
-   GLuint tex;
-   glActiveTexture(GL_TEXTURE0);
-   
-   std::vector<unsigned char> image;
-   unsigned width, height;
-   
-   unsigned error = lodepng::decode(image, width, height, filename);
-   if (error) {
-    std::cout << "PNG load error: " << lodepng_error_text(error) << std::endl;
-}
-   
-   glGenTextures(1, &tex);
-   glBindTexture(GL_TEXTURE_2D, tex);
-   
-   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (unsigned char*) image.data());
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-   
-   return tex;
+// Act on the milestones the last growth update passed, once each: a fully
+// grown tree's buffers become static; a regrown limb, a rewind or a new
+// tree makes them dynamic again
+void handleGrowthEvents() {
+    tree->takeGrowthEvents(growthEvents);
+    for (const GrowthEvent& event : growthEvents) {
+        if (event.type == GrowthEventType::TreeCompleted) {
+            if (verbosity >= 1) {
+                LOG_INFO(Tree) << "Tree fully grown at " << event.time << " s";
+            }
+            setTreeBufferUsage(GL_STATIC_DRAW);
+        } else if (verbosity >= 2) {
+            LOG_INFO(Tree) << "Generation " << event.generation
+                           << (event.type == GrowthEventType::GenerationStarted ? " started" : " completed")
+                           << " at " << event.time << " s";
+        }
+    }
+    if (treeBufferUsage == GL_STATIC_DRAW && !tree->isStatic()) {
+        setTreeBufferUsage(GL_DYNAMIC_DRAW);
+    }
 }
 
-// Error handling callback
-void error_callback(int error, const char* description) {
-    fputs(description, stderr);
+// The sampled categories of MemoryStats: the shown tree and the forest's
+// archetypes, and the world's chunks
+void sampleTreeMemory() {
+    TreeMemory total = tree->getMemoryUsage();
+    for (int a = 0; a < forest.getArchetypeCount(); a++) {
+        TreeMemory archetype = forest.getArchetype(a).getMemoryUsage();
+        total.topology_bytes += archetype.topology_bytes;
+        total.topology_capacity += archetype.topology_capacity;
+        total.vertex_bytes += archetype.vertex_bytes;
+        total.vertex_capacity += archetype.vertex_capacity;
+    }
+    MemoryStats::setUsage(MemoryStats::TREE_TOPOLOGY, total.topology_bytes, total.topology_capacity);
+    MemoryStats::setUsage(MemoryStats::TREE_VERTICES, total.vertex_bytes, total.vertex_capacity);
+    MemoryStats::setUsage(MemoryStats::WORLD_CHUNKS, world.getMemoryBytes(), world.getMemoryBytes());
 }
 
 // Window resize callback
 void windowResizeCallback(GLFWwindow* window, int width, int height) {
     if (height == 0) return;
-    aspectRatio = (float)width / (float)height;
+    // Each eye or view has its column
+    camera.setAspectRatio(width / (float)(height * viewColumns()));
     glViewport(0, 0, width, height);
 }
 
+void windowFocusCallback(GLFWwindow* window, int focused) {
+    frameLimiter.setFocused(focused == GL_TRUE);
+}
+
+void windowIconifyCallback(GLFWwindow* window, int iconified) {
+    frameLimiter.setMinimized(iconified == GL_TRUE);
+}
+
 // Key callback - ESC to exit, camera controls
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    // Before the scene meshes exist only ESC does anything
+    if (!startupFinished && key != GLFW_KEY_ESCAPE) return;
     if (action == GLFW_PRESS || action == GLFW_REPEAT) {
         if (key == GLFW_KEY_ESCAPE) {
             glfwSetWindowShouldClose(window, GL_TRUE);
         }
+        if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+            // On-demand diagnostics instead of periodic prints in the frame
+            // loop, logged as one report
+            std::ostringstream report;
+            tree->printStats(report);
+            const GlStateCache::Counters& calls = glState.getLastFrame();
+            report << "GL state calls last frame: " << calls.issued << " issued, "
+                   << calls.skipped << " skipped" << std::endl;
+            if (cullingTreeMeshes()) {
+                report << "Frustum culling: " << visibleBranches.drawn_slots << " of "
+                       << visibleBranches.tested_slots << " branches in " << visibleBranches.getRangeCount()
+                       << " ranges, " << visibleLeaves.drawn_slots << " of " << visibleLeaves.tested_slots
+                       << " leaves in " << visibleLeaves.getRangeCount() << " ranges, "
+                       << treeBvh.getNodeCount() << " BVH nodes" << std::endl;
+            }
+            if (usingMeshlets()) {
+                report << "Meshlet culling: " << treeMeshlets.getDrawnMeshlets() << " of "
+                       << treeMeshlets.getWoodMeshletCount() + treeMeshlets.getLeafMeshletCount()
+                       << " meshlets drawn (" << treeMeshlets.getWoodMeshletCount() << " wood, "
+                       << treeMeshlets.getLeafMeshletCount() << " leaf)" << std::endl;
+            }
+            if (treeLodEnabled && cullingTreeMeshes()) {
+                report << "Tree LOD level " << treeLod.getLevel() << " of " << TreeLod::LEVELS - 1;
+                if (treeLod.isFading()) {
+                    report << " (fading " << fadingBranches.drawn_slots << " branches, "
+                           << fadingLeaves.drawn_slots << " leaves)";
+                }
+                report << std::endl;
+            }
+            if (forest.getArchetypeCount() > 0) {
+                report << "Forest: " << forest.getDrawnInstances() << " of " << forest.getInstances().size()
+                       << " trees of " << forest.getArchetypeCount() << " archetypes in "
+                       << forest.getDrawCalls() << (forest.isGpuCulling() ? " indirect multi-draws" : " instanced draws")
+                       << " per pass" << std::endl;
+                const VertexCacheStats& generated = forest.getGeneratedCacheStats();
+                const VertexCacheStats& optimized = forest.getOptimizedCacheStats();
+                report << "Forest meshes: " << optimized.triangles << " triangles, vertex cache ACMR "
+                       << generated.getAcmr() << " -> " << optimized.getAcmr() << ", ATVR "
+                       << generated.getAtvr() << " -> " << optimized.getAtvr() << std::endl;
+            }
+            if (world.isEnabled()) {
+                report << "World: " << world.getResidentChunks() << " chunks resident, "
+                       << world.getBuildingChunks() << " building, "
+                       << world.getMemoryBytes() / (1024.0 * 1024.0) << " of "
+                       << world.getMemoryBudget() / (1024.0 * 1024.0) << " MB; "
+                       << world.getBuiltChunks() << " built, " << world.getDroppedChunks() << " dropped, "
+                       << world.getProxyChunks() << " drawn as proxies (" << forest.getDrawnProxies() << " in view, "
+                       << world.getCachedProxies() << " read from the cache), "
+                       << world.getPrefetchedChunks() << " prefetched" << std::endl;
+            }
+            if (skyEnabled) {
+                report << "Sky: view table drawn " << sky.getViewUpdates() << " times, sun at "
+                       << glm::degrees(asinf(sky.getSunDirection().y)) << " degrees" << std::endl;
+            }
+            if (treeCache.isEnabled()) {
+                report << "Tree cache: " << treeCache.getMemoryHits() << " trees from memory, "
+                       << treeCache.getDiskHits() << " from disk, " << treeCache.getMisses() << " generated; "
+                       << treeCache.getMemoryBytes() / (1024.0 * 1024.0) << " of "
+                       << treeCache.getMemoryBudget() / (1024.0 * 1024.0) << " MB" << std::endl;
+            }
+            if (gpuTrees.isGenerated()) printGpuTreeStats(report);
+            report << "Terrain: " << terrain.getDrawnChunks() << " chunks of " << Terrain::GRID << "x"
+                   << Terrain::GRID << " quads over " << terrain.getLevels() << " levels, vertex cache ACMR "
+                   << terrain.getGeneratedCacheStats().getAcmr() << " -> "
+                   << terrain.getOptimizedCacheStats().getAcmr() << ", ATVR "
+                   << terrain.getGeneratedCacheStats().getAtvr() << " -> "
+                   << terrain.getOptimizedCacheStats().getAtvr() << std::endl;
+            if (grass.getChunkCount() > 0) {
+                report << "Grass: " << grass.getIssuedBlades() << " blades issued in " << grass.getDrawnChunks()
+                       << " of " << grass.getChunkCount() << " chunks" << std::endl;
+            }
+            if (shadowMaps.hasCascades() || shadowMaps.hasCube()) {
+                report << "Shadows: " << shadowMaps.getRedrawnMaps() << " maps redrawn last frame, "
+                       << shadowMaps.getStaticRedraws() << " with their static casters; cascades every";
+                for (int c = 0; c < ShadowMaps::CASCADES; c++) {
+                    report << (c > 0 ? ", " : " ") << shadowMaps.getCascadeInterval(c);
+                }
+                report << " frames" << std::endl;
+            }
+            if (gpuProfiler.isCreated()) {
+                report << "GPU passes " << GpuProfiler::FRAMES << " frames ago ("
+                       << gpuProfiler.getDroppedFrames() << " frames not ready in time):" << std::endl;
+                for (const GpuProfiler::Timing& timing : gpuProfiler.getTimings()) {
+                    report << std::string(2 + 2 * timing.depth, ' ') << timing.name << " "
+                           << timing.milliseconds << " ms" << std::endl;
+                }
+            }
+            report << "Simulation step: " << simulation.getLastStepMicroseconds() << " us "
+                   << (simulation.isThreaded() ? "on its own thread, the render thread waited " : "inline")
+                   << (simulation.isThreaded() ? std::to_string((int)simulation.getLastWaitMicroseconds()) + " us" : "")
+                   << std::endl;
+            if (streamBuffers) {
+                report << "Stream buffers: " << StreamBuffer::REGIONS << " regions of "
+                       << (branchStream.getCapacity() + leafStream.getCapacity()) / 1024 << " KB, "
+                       << branchStream.getStalls() + leafStream.getStalls() << " frames waited for the GPU"
+                       << std::endl;
+            }
+            if (leafCardsEnabled) {
+                report << "Leaf cards: " << leafCards.getCardCount() << " for " << tree->getLeafCount()
+                       << " leaves, drawn at opacity " << treeLod.getCardOpacity() << std::endl;
+            }
+            Log::write(LogLevel::Info, LogCategory::App, report.str());
+        }
+        if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+            startTreeGeneration();
+        }
+        if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+            regrowRandomLimb();
+        }
+        if (key == GLFW_KEY_X && action == GLFW_PRESS) {
+            pruneBranchAtCursor(window);
+        }
+        if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+            growthPaused = !growthPaused;
+        }
+        if (key == GLFW_KEY_Z && action == GLFW_PRESS) {
+            depthPrepass = !depthPrepass;
+            LOG_INFO(Render) << "Depth prepass " << (depthPrepass ? "on" : "off");
+        }
+        if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+            frustumCulling = !frustumCulling;
+            if (frustumCulling) {
+                treeBvh.refit(*tree); // Growth went on unfitted
+                treeCullPending = true;
+            }
+            LOG_INFO(Render) << "Frustum culling " << (frustumCulling ? "on" : "off");
+        }
+        if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+            treeLodEnabled = !treeLodEnabled;
+            treeBvh.refit(*tree);
+            treeCullPending = true;
+            LOG_INFO(Render) << "Tree LOD " << (treeLodEnabled ? "on" : "off");
+        }
+        if (key == GLFW_KEY_F12 && action == GLFW_PRESS) {
+            char name[32];
+            snprintf(name, sizeof(name), "screenshot_%03d.png", screenshotCount++);
+            frameCapture.screenshot(name);
+            LOG_INFO(Capture) << "Saving " << name;
+        }
+        if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+            hudVisible = !hudVisible;
+        }
+        if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+            CameraKeyframe keyframe = { camera.getTheta(), camera.getPhi(), camera.getRadius() };
+            cameraPath.add(keyframe);
+            std::string error;
+            if (cameraPath.save(cameraPathFile, error)) {
+                LOG_INFO(App) << "Camera path keyframe " << cameraPath.size() << " saved to " << cameraPathFile;
+            } else {
+                LOG_ERROR(App) << "Cannot write " << cameraPathFile << ": " << error;
+            }
+        }
+        if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+            sampleTreeMemory();
+            std::ostringstream report;
+            MemoryStats::printReport(report);
+            if (gpuResidency.getBudget() > 0) {
+                report << "\nGPU budget " << gpuResidency.getBudget() / (1024 * 1024) << " MB, "
+                       << gpuResidency.getEvictableBytes() / (1024 * 1024) << " MB evictable resident, "
+                       << gpuResidency.getEvictions() << " evictions, " << gpuResidency.getRestores() << " restores";
+            }
+            Log::write(LogLevel::Info, LogCategory::App, report.str());
+        }
+        if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+            char name[32];
+            snprintf(name, sizeof(name), "trace_%03d.json", traceCount++);
+            std::string error;
+            if (Profiler::writeChromeTrace(name, error)) {
+                LOG_INFO(App) << "Saved the profiler trace to " << name;
+            } else {
+                LOG_ERROR(App) << "Cannot write " << name << ": " << error;
+            }
+        }
+        if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+            if (frameCapture.isRecording()) {
+                frameCapture.stopRecording();
+                LOG_INFO(Capture) << "Recording stopped";
+            } else {
+                frameCapture.startRecording(recordPrefix);
+                LOG_INFO(Capture) << "Recording to " << recordPrefix << "*.png";
+            }
+        }
+        if (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET || key == GLFW_KEY_BACKSPACE) {
+            seekGrowth(key == GLFW_KEY_BACKSPACE ? 0.0f
+                       : tree->getGrowthTime() + (key == GLFW_KEY_LEFT_BRACKET ? -1.0f : 1.0f));
+        }
     }
-    
-    // Let camera handle key input
-    camera.processKeyInput(window);
 }
 
 // Mouse callback for camera control
@@ -164,263 +2514,1427 @@ void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
 }
 
 
+// The stage of startup that waits for the programs: the meshes take their
+// attribute locations from sp
+void finishStartup() {
+    PROFILE_SCOPE("finishStartup");
+    createSceneMeshes();
+    if (tree->getBranchCount() > 0) {
+        reloadTreeBuffers();
+    }
+    startupFinished = true;
+}
+
 // Initialization
 void initOpenGLProgram(GLFWwindow* window) {
-    glClearColor(0.5f, 0.7f, 0.9f, 1.0f); // Light blue background
+    glClearColor(SKY_COLOR.r, SKY_COLOR.g, SKY_COLOR.b, 1.0f); // Light blue background
     glEnable(GL_DEPTH_TEST);
+    if (msaaSamples > 0) glEnable(GL_MULTISAMPLE);
     
     glfwSetWindowSizeCallback(window, windowResizeCallback);
+    if (stereoRendering) {
+        int width, height;
+        glfwGetWindowSize(window, &width, &height);
+        windowResizeCallback(window, width, height);
+    }
     glfwSetKeyCallback(window, keyCallback);
     glfwSetCursorPosCallback(window, mouseCallback);     // Add mouse callback
     glfwSetScrollCallback(window, scrollCallback);       // Add scroll callback
+    glfwSetWindowFocusCallback(window, windowFocusCallback);
+    glfwSetWindowIconifyCallback(window, windowIconifyCallback);
+    frameLimiter.configure(focusedFrameRate, backgroundFrameRate, !drawMinimized);
+    frameLimiter.setFocused(glfwGetWindowAttrib(window, GLFW_FOCUSED) == GL_TRUE);
+    frameLimiter.setMinimized(glfwGetWindowAttrib(window, GLFW_ICONIFIED) == GL_TRUE);
+    
+    frameUniformBuffer.create();
+    lightBuffer.create();
+    if (!shadowMaps.create(shadowsEnabled ? shadowMapSize : 0, shadowsEnabled ? shadowMapSize / 2 : 0)) {
+        LOG_WARNING(Render) << "Cannot create the shadow maps; shadows are off";
+    }
+    for (int c = 0; c < ShadowMaps::CASCADES; c++) {
+        shadowMaps.setCascadeInterval(c, shadowIntervals[c]);
+    }
+    shadowMaps.setCubeInterval(shadowIntervals[ShadowMaps::CASCADES]);
+    glState.invalidateTextures();
+    ShaderProgram::setBinaryCache(shaderCacheDirectory);
+    ShaderProgram::enableParallelCompile();
+    
+    // Startup takes as long as its slowest stage, so the stages overlap:
+    // every program variant is submitted first and compiles while the tree
+    // generates and the textures decode; the first use of a program
+    // (createSceneMeshes for sp) waits for its link
+    shaders.setGeometryShader("BRANCH_LINES", "g_branch_lines.glsl");
+    shaders.setTessellationShaders("BRANCH_TUBES", "tc_branch_tubes.glsl", "te_branch_tubes.glsl");
+    sp = shaderVariant("");
+    ShaderProgram* leafProgram = shaderVariant("LEAF");
+    ShaderProgram* depthProgram = shaderVariant("DEPTH_ONLY");
+    ShaderProgram* leafDepthProgram = shaderVariant("LEAF DEPTH_ONLY");
+    ShaderProgram* propProgram = shaderVariant("PROPS");
+    ShaderProgram* fadeProgram = shaderVariant("LOD_FADE");
+    ShaderProgram* leafFadeProgram = shaderVariant("LEAF LOD_FADE");
+    ShaderProgram* fadeDepthProgram = shaderVariant("DEPTH_ONLY LOD_FADE");
+    ShaderProgram* leafFadeDepthProgram = shaderVariant("LEAF DEPTH_ONLY LOD_FADE");
+    ShaderProgram* forestProgram = nullptr;
+    ShaderProgram* forestLeafProgram = nullptr;
+    if (usingForest()) {
+        forestProgram = shaderVariant("FOREST");
+        forestLeafProgram = shaderVariant("LEAF FOREST");
+        if (forestGpuCulling && GLEW_VERSION_4_3) {
+            std::vector<std::string> defines(1, "LEVELS " + std::to_string(TreeLod::LEVELS));
+            defines.push_back("VIEWS " + std::to_string(ViewFrustum::MAX_VIEWS));
+            forestCullProgram.reset(new ShaderProgram("c_forest_cull.glsl", defines));
+            forest.setCullProgram(forestCullProgram.get());
+            if (occlusionCulling) {
+                depthPyramidProgram.reset(new ShaderProgram("c_depth_pyramid.glsl", std::vector<std::string>()));
+                forest.setOcclusion(&depthPyramid);
+            }
+        } else if (forestGpuCulling) {
+            LOG_WARNING(Render) << "GPU culling needs OpenGL 4.3; the forest is culled on the CPU";
+        }
+    }
+    if (meshletCulling && TreeMeshlets::isSupported() && !gpuGrowth && !instancedBranches) {
+        meshletCullProgram.reset(new ShaderProgram("c_meshlet_cull.glsl", std::vector<std::string>()));
+        treeMeshlets.setCullProgram(meshletCullProgram.get());
+    } else if (meshletCulling) {
+        LOG_WARNING(Render) << "Meshlet culling needs OpenGL 4.3 and the CPU-animated branch mesh; the tree is culled"
+                            << " by its BVH";
+        meshletCulling = false;
+    }
+    if (gpuTreeCount > 0 && GpuTreeGenerator::isSupported()) {
+        treeGenerateProgram.reset(new ShaderProgram("c_tree_generate.glsl", std::vector<std::string>()));
+    } else if (gpuTreeCount > 0) {
+        LOG_WARNING(Render) << "GPU tree generation needs OpenGL 4.3; --gpu-trees is ignored";
+        gpuTreeCount = 0;
+    }
+    if (fallingLeafCount > 0 && LeafParticles::isSupported()) {
+        leafParticlesProgram.reset(new ShaderProgram("c_leaf_particles.glsl", std::vector<std::string>()));
+        leafParticles.create(fallingLeafCount, leafParticlesProgram.get());
+    } else if (fallingLeafCount > 0) {
+        LOG_WARNING(Render) << "Falling leaves need OpenGL 4.3; --falling-leaves is ignored";
+        fallingLeafCount = 0;
+    }
+    ShaderProgram* bakeProgram = nullptr;
+    ShaderProgram* leafBakeProgram = nullptr;
+    if (usingImpostors()) {
+        bakeProgram = shaderVariant("IMPOSTOR_BAKE");
+        leafBakeProgram = shaderVariant("LEAF IMPOSTOR_BAKE");
+        impostorProgram = shaderVariant("", impostorShaders);
+    }
+    
+    // The first tree is loaded from --load-tree or generated in the
+    // background; until drawScene swaps it in a trunk-only preview stands
+    // in, or with --serial-startup the empty placeholder, which draws
+    // nothing
+    treeCache.configure((size_t)(treeCacheMB * 1024.0f * 1024.0f), treeCacheDirectory);
+    configureTree(*tree);
+    std::string error;
+    bool treeLoaded = !loadTreeFile.empty() && tree->load(loadTreeFile, error);
+    if (!treeLoaded) {
+        if (!loadTreeFile.empty()) {
+            LOG_ERROR(Tree) << "Cannot load tree: " << error;
+        }
+        if (!serialStartup) generateTreePreview(firstTreeSeed);
+        startTreeGeneration(firstTreeSeed);
+    }
+    // The ground first: the forest, the torches and the impostor copies
+    // stand on it
+    terrain.generate(terrainExtent, 32, terrainHeight, 9.0f, 7);
+    if (grassDensity > 0.0f) {
+        const float chunkSize = 4.0f;
+        grass.generate(terrain, std::min(grassRadius, terrainExtent), chunkSize,
+                       (int)(grassDensity * chunkSize * chunkSize));
+    }
+    if (gpuBudgetFromDevice && !gpuResidency.setBudgetFromDevice(0.8f)) {
+        LOG_WARNING(Render) << "The driver reports no memory size (GL_NVX_gpu_memory_info, GL_ATI_meminfo); "
+                               "there is no GPU budget";
+    } else if (!gpuBudgetFromDevice) {
+        gpuResidency.setBudget((size_t)(gpuBudgetMB * 1024.0f * 1024.0f));
+    }
+    if (gpuResidency.getBudget() > 0) {
+        LOG_INFO(Render) << "GPU budget: " << gpuResidency.getBudget() / (1024 * 1024) << " MB";
+        forest.setResidency(&gpuResidency);
+    }
+    if (usingForest()) {
+        generateForest();
+    }
+    if (worldRadius > 0.0f) {
+        world.configure(worldChunkSize, worldRadius, worldRadius + worldChunkSize,
+                        (size_t)(worldBudgetMB * 1024.0f * 1024.0f), 4);
+        world.setBuilder(buildWorldChunk);
+        if (worldProxyDistance > 0.0f) world.setProxies(&forest, worldProxyDistance, worldCacheDirectory);
+        world.setPrefetch(prefetchSeconds, prefetchChunks, [](float seconds) { return camera.predictPosition(seconds); });
+    }
+    if (gpuTreeCount > 0) {
+        scatterGpuTrees();
+    }
+    // One array for all material textures, a layer per file in this order:
+    // materials.ktx2, compressed with its mip chain by texture_convert
+    // (make -f Makefile_simple textures), when the GPU decodes S3TC, else
+    // materials.pack or else the PNGs, every image resampled to 1024x1024
+    // (the bark and torch size), read by a background job. With --bindless
+    // the same files, in the same order, are textures of their own instead
+    const int barkLayer = 0, leafLayer = 1, grassLayer = 2, sunLayer = 3, torchLayer = 4, leafClusterLayer = 5;
+    if (bindlessMaterials) {
+        // The PNGs at their own sizes, one resident texture each; the
+        // materials bind nothing
+        const std::vector<std::string> files(MATERIAL_TEXTURE_FILES, MATERIAL_TEXTURE_FILES + MATERIAL_TEXTURE_COUNT);
+        if (textureBudgetMB > 0.0f) {
+            textureStreamer.create(bindlessTextures, files, textureAnisotropy, (size_t)(textureBudgetMB * 1048576.0f));
+        } else {
+            bindlessTextures.create(files, textureAnisotropy);
+        }
+        materialTextures = 0;
+    } else {
+        startMaterialTextures();
+    }
+    glState.invalidateTextures(); // The bindless uploads bind behind the state cache
+    materials.setTextureArray(materialTextures);
     
-    sp = new ShaderProgram("v_simplest.glsl", NULL, "f_simplest.glsl");
+    // The original torch, then the extra ones evenly spaced on a ring,
+    // standing on the terrain
+    torchPositions.push_back(glm::vec3(3.0f, 0.5f, 2.0f));
+    for (int i = 0; i < extraTorches; i++) {
+        float angle = 2.0f * glm::pi<float>() * i / extraTorches;
+        torchPositions.push_back(glm::vec3(6.0f * cos(angle), 0.5f, 6.0f * sin(angle)));
+    }
+    for (glm::vec3& torchPos : torchPositions) {
+        torchPos.y = terrain.heightAt(torchPos.x, torchPos.z) + 0.5f;
+    }
+    if ((int)torchPositions.size() + 1 > LightUniforms::MAX_LIGHTS) {
+        LOG_WARNING(Render) << "Only " << LightUniforms::MAX_LIGHTS - 1 << " torches are lit";
+    }
+    // Layer, mix ratio of the normal-based lookup and ambient level per prop
+    PropMaterial torchProp = { (float)torchLayer, 0.0f, 0.4f, false };
+    PropMaterial sunPropMaterial = { (float)sunLayer, 0.0f, 0.0f, true };
+    createStaticProps(torchProp, sunPropMaterial);
     
-    // Initialize tree
-    tree.generate();
-    barkTex = readTexture("bark.png");
-    leafTex = readTexture("leaf.png");
-    grassTex = readTexture("grass3.png");
-    sunTex = readTexture("sun_yellow.png");
-    torchTex = readTexture("torch2.png");
+    // Program variant, mix ratio of the normal-based lookup and ambient
+    // level per surface, and the depth prepass program
+    barkMaterial = materials.add(sp, barkLayer, 0.25f, 0.02f, depthProgram);
+    leafMaterial = materials.add(leafProgram, leafLayer, leafMixRatio, 0.02f, leafDepthProgram);
+    propMaterial = materials.add(propProgram, grassLayer, 0.0f, 0.0f, depthProgram); // The props bring their own
+    terrainMaterial = materials.add(shaderVariant("TERRAIN"), grassLayer, 0.2f, 0.02f, shaderVariant("DEPTH_ONLY TERRAIN"));
+    if (grass.getChunkCount() > 0) {
+        grassMaterial = materials.add(shaderVariant("GRASS"), grassLayer, 0.0f, 0.1f, shaderVariant("DEPTH_ONLY GRASS"));
+    }
+    barkFadeMaterial = materials.add(fadeProgram, barkLayer, 0.25f, 0.02f, fadeDepthProgram);
+    leafFadeMaterial = materials.add(leafFadeProgram, leafLayer, leafMixRatio, 0.02f, leafFadeDepthProgram);
+    leafCardMaterial = materials.add(leafProgram, leafClusterLayer, leafMixRatio, 0.02f, leafDepthProgram);
+    leafCardFadeMaterial = materials.add(leafFadeProgram, leafClusterLayer, leafMixRatio, 0.02f, leafFadeDepthProgram);
+    // Foliage takes no highlight: it barely shows there, and leaves and
+    // grass cover most of the pixels
+    materials.setShininess(leafMaterial, 0.0f);
+    materials.setShininess(leafFadeMaterial, 0.0f);
+    materials.setShininess(leafCardMaterial, 0.0f);
+    materials.setShininess(leafCardFadeMaterial, 0.0f);
+    if (grass.getChunkCount() > 0) materials.setShininess(grassMaterial, 0.0f);
+    if (usingBranchLines()) {
+        std::string lines = branchLineDefine();
+        branchLineMaterial = materials.add(shaderVariant(lines), barkLayer, 0.25f, 0.02f,
+                                           shaderVariant(lines + " DEPTH_ONLY"));
+        // Every patch is a branch record's two ends
+        if (branchTubes) glPatchParameteri(GL_PATCH_VERTICES, 2);
+    }
+    if (usingForest()) {
+        forestBarkMaterial = materials.add(forestProgram, barkLayer, 0.25f, 0.02f, shaderVariant("DEPTH_ONLY FOREST"));
+        forestLeafMaterial = materials.add(forestLeafProgram, leafLayer, leafMixRatio, 0.02f,
+                                           shaderVariant("LEAF DEPTH_ONLY FOREST"));
+        materials.setShininess(forestLeafMaterial, 0.0f);
+    }
+    if (usingImpostors()) {
+        barkBakeMaterial = materials.add(bakeProgram, barkLayer, 0.25f, 0.02f);
+        leafBakeMaterial = materials.add(leafBakeProgram, leafLayer, leafMixRatio, 0.02f);
+        if (usingBranchLines()) {
+            branchLineBakeMaterial = materials.add(shaderVariant(std::string(branchLineDefine()) + " IMPOSTOR_BAKE"),
+                                                   barkLayer, 0.25f, 0.02f);
+        }
+        impostorMaterial = materials.add(impostorProgram, leafLayer, 0.0f, 0.02f);
+        const size_t usedBefore = GpuResidency::getUsedBytes();
+        if (!treeImpostor.create(12, 128)) {
+            LOG_WARNING(Render) << "Cannot create the impostor atlas; impostors are off";
+            impostorCount = 0;
+            impostorDistance = 0.0f;
+        } else if (gpuResidency.getBudget() > 0) {
+            impostorResidency = gpuResidency.add("impostors", GpuResidency::getUsedBytes() - usedBefore,
+                                                 []() { treeImpostor.release(); });
+        }
+        glState.invalidateTextures();
+    }
+    hudProgram.reset(new ShaderProgram("v_hud.glsl", NULL, "f_hud.glsl"));
+    perfHud.create();
+    if (skyEnabled) {
+        skyTransmittanceProgram.reset(new ShaderProgram("v_sky.glsl", NULL, "f_sky.glsl",
+                                                        std::vector<std::string>(1, "TRANSMITTANCE_LUT")));
+        skyViewProgram.reset(new ShaderProgram("v_sky.glsl", NULL, "f_sky.glsl",
+                                               std::vector<std::string>(1, "VIEW_LUT")));
+        skyProgram.reset(new ShaderProgram("v_sky.glsl", NULL, "f_sky.glsl"));
+        if (!sky.create()) {
+            LOG_WARNING(Render) << "Cannot create the sky tables; the sky is plain";
+            skyEnabled = false;
+        }
+    }
+    glState.invalidateTextures();
+    rankMaterialStates();
+    if (serialStartup) {
+        finishStartup();
+        if (materialTextureLoad.pending) installMaterialTextures();
+    }
+}
+
+// A frame of the sky while programs are still linking, else the rest of
+// startup; true once the scene can be drawn
+bool continueStartup(GLFWwindow* window) {
+    if (ShaderProgram::pendingLinks() > 0) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glfwSwapBuffers(window);
+        glfwWaitEventsTimeout(0.005);
+        return false;
+    }
+    finishStartup();
+    return true;
 }
 
 // Cleanup
 void freeOpenGLProgram(GLFWwindow* window) {
-    delete sp;
+    simulation.start(false);
+    JobSystem::shared().wait(treeExport.job); // The last export reaches its file
+    staticProps.release();
+    terrain.release();
+    grass.release();
+    branchMesh.release();
+    leafMesh.release();
+    branchStream.release();
+    leafStream.release();
+    leafQuadMesh.release();
+    branchCylinderMesh.release();
+    branchLineMesh.release();
+    twigMesh.release();
+    impostorMesh.release();
+    cardMesh.release();
+    world.clear();
+    world.apply(forest);
+    forest.release();
+    forest.setCullProgram(nullptr);
+    forest.setOcclusion(nullptr);
+    forestCullProgram.reset();
+    gpuTrees.release();
+    treeGenerateProgram.reset();
+    leafParticles.release();
+    leafParticlesProgram.reset();
+    treeMeshlets.release();
+    treeMeshlets.setCullProgram(nullptr);
+    meshletCullProgram.reset();
+    depthPyramid.release();
+    depthPyramidProgram.reset();
+    treeImpostor.release();
+    frameUniformBuffer.release();
+    lightBuffer.release();
+    shadowMaps.release();
+    frameCapture.release();
+    offscreenTarget.release();
+    gpuProfiler.release();
+    framePacer.release();
+    perfHud.release();
+    hudProgram.reset();
+    sky.release();
+    skyTransmittanceProgram.reset();
+    skyViewProgram.reset();
+    skyProgram.reset();
+    // A decode still running writes into the upload buffer
+    if (materialTextureLoad.pending) JobSystem::shared().wait(materialTextureLoad.job);
+    materialTextureLoad.layers.reset();
+    MemoryStats::forgetBuffers(1, &branchDataBuffer);
+    MemoryStats::forgetTextures(1, &materialTextures);
+    glDeleteBuffers(1, &branchDataBuffer);
+    glDeleteTextures(1, &branchDataTex);
+    glDeleteTextures(1, &materialTextures);
+    textureStreamer.release();
+    bindlessTextures.release();
+    shaders.clear();
+    impostorShaders.clear();
+}
+
+// A count for the HUD, abbreviated past ten thousand
+std::string hudCount(uint64_t count) {
+    char text[32];
+    if (count >= 10000000) snprintf(text, sizeof(text), "%.1fM", count * 1e-6);
+    else if (count >= 10000) snprintf(text, sizeof(text), "%.1fK", count * 1e-3);
+    else snprintf(text, sizeof(text), "%llu", (unsigned long long)count);
+    return text;
+}
+
+// Fill the HUD with the last frame's numbers and draw it over the frame:
+// the CPU phases and the counters in the first column, the GPU passes in
+// the second
+void drawHud(int width, int height) {
+    const glm::vec3 heading(0.6f, 0.8f, 1.0f);
+    char text[96];
+    if (Profiler::isEnabled()) {
+        perfHud.addLine(0, "CPU ms", heading);
+        for (int p = 0; p < FRAME_PHASES; p++) {
+            snprintf(text, sizeof(text), "  %-16s %6.2f", framePhaseNames[p], framePhaseMilliseconds[p]);
+            perfHud.addLine(0, text);
+        }
+    } else {
+        perfHud.addLine(0, "CPU phases off (--no-profile)", heading);
+    }
+    snprintf(text, sizeof(text), "  %-16s %6.2f", "simulation step", simulation.getLastStepMicroseconds() * 1e-3f);
+    perfHud.addLine(0, text);
+    
+    const RenderStats::Counters& counts = RenderStats::getLastFrame();
+    const GlStateCache::Counters& calls = glState.getLastFrame();
+    perfHud.addLine(0, "Frame", heading);
+    snprintf(text, sizeof(text), "  %d draws, %s triangles", counts.draw_calls, hudCount(counts.triangles).c_str());
+    perfHud.addLine(0, text);
+    snprintf(text, sizeof(text), "  %s vertices submitted", hudCount(counts.vertices).c_str());
+    perfHud.addLine(0, text);
+    snprintf(text, sizeof(text), "  %.1f KB uploaded", counts.upload_bytes / 1024.0);
+    perfHud.addLine(0, text);
+    snprintf(text, sizeof(text), "  %d GL state calls, %d skipped", calls.issued, calls.skipped);
+    perfHud.addLine(0, text);
+    snprintf(text, sizeof(text), "  %s allocations, %.1f KB (%s all threads)",
+             hudCount(frameAllocations.allocations).c_str(), frameAllocations.bytes / 1024.0,
+             hudCount(frameProcessAllocations.allocations).c_str());
+    perfHud.addLine(0, text);
+    snprintf(text, sizeof(text), "  %s branches, %s leaves", hudCount(tree->getBranchCount()).c_str(),
+             hudCount(tree->getLeafCount()).c_str());
+    perfHud.addLine(0, text);
+    if (forest.getArchetypeCount() > 0) {
+        snprintf(text, sizeof(text), "  %d of %d forest trees", forest.getDrawnInstances(),
+                 (int)forest.getInstances().size());
+        perfHud.addLine(0, text);
+        if (forest.getProxyCount() > 0) {
+            snprintf(text, sizeof(text), "  %d of %d chunk proxies", forest.getDrawnProxies(), forest.getProxyCount());
+            perfHud.addLine(0, text);
+        }
+    }
+    
+    
+    sampleTreeMemory();
+    perfHud.addLine(0, "Memory MB (M: report)", heading);
+    for (int c = 0; c < MemoryStats::CATEGORIES; c++) {
+        MemoryStats::Usage usage = MemoryStats::getUsage((MemoryStats::Category)c);
+        snprintf(text, sizeof(text), "  %-16s %6.1f", MemoryStats::getCategoryName((MemoryStats::Category)c),
+                 usage.bytes / (1024.0 * 1024.0));
+        perfHud.addLine(0, text);
+    }
+    
+    if (gpuProfiler.isCreated()) {
+        snprintf(text, sizeof(text), "GPU ms, %d frames ago", GpuProfiler::FRAMES);
+        perfHud.addLine(1, text, heading);
+        for (const GpuProfiler::Timing& timing : gpuProfiler.getTimings()) {
+            snprintf(text, sizeof(text), "%*s%-*s %6.2f", 2 + 2 * timing.depth, "", 20 - 2 * timing.depth,
+                     timing.name, timing.milliseconds);
+            perfHud.addLine(1, text);
+        }
+    } else {
+        perfHud.addLine(1, "GPU timing unsupported", heading);
+    }
+    if (framePacer.isCreated()) {
+        snprintf(text, sizeof(text), "  %-18s %6.2f", "pacing wait", framePacer.getWaitMilliseconds());
+        perfHud.addLine(1, text);
+    }
+    if (textureStreamer.isCreated()) {
+        snprintf(text, sizeof(text), "  %-18s %.1f / %.1f MB", "streamed textures",
+                 textureStreamer.getResidentBytes() / 1048576.0, textureStreamer.getBudget() / 1048576.0);
+        perfHud.addLine(1, text);
+    }
+    if (dynamicResolutionOn) {
+        snprintf(text, sizeof(text), "  %-18s %5.0f%% %dx%d", "resolution", dynamicResolution.getScale() * 100.0f,
+                 offscreenTarget.getViewportWidth(), offscreenTarget.getViewportHeight());
+        perfHud.addLine(1, text);
+        snprintf(text, sizeof(text), "  %-18s %6.2f / %.2f", "frame / budget", dynamicResolution.getAverage(),
+                 dynamicResolution.getBudget());
+        perfHud.addLine(1, text);
+    }
+    perfHud.draw(glState, hudProgram.get(), width, height);
+}
+
+// Size the scene's share of the offscreen target for the frame just begun:
+// a window resized since reallocates it, and new GPU timings move the scale
+void updateDynamicResolution(GLFWwindow* window) {
+    int windowWidth, windowHeight;
+    glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+    if (windowWidth <= 0 || windowHeight <= 0) return; // Minimized
+    if (offscreenTarget.getWidth() != windowWidth || offscreenTarget.getHeight() != windowHeight) {
+        offscreenTarget.release();
+        if (!offscreenTarget.create(windowWidth, windowHeight, msaaSamples)) {
+            LOG_WARNING(Render) << "Can't create a " << windowWidth << "x" << windowHeight
+                                << " scene target; dynamic resolution off";
+            dynamicResolutionOn = false;
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return;
+        }
+    }
+    const long long measured = gpuProfiler.getTimingsFrame();
+    if (measured >= 0 && measured != dynamicTimingsFrame) {
+        dynamicTimingsFrame = measured;
+        float milliseconds = 0.0f;
+        for (const GpuProfiler::Timing& timing : gpuProfiler.getTimings()) {
+            if (timing.depth == 0) milliseconds += timing.milliseconds;
+        }
+        // The frame just begun is the last counted
+        dynamicResolution.addFrameTime(milliseconds, measured, gpuProfiler.getFrame() - 1);
+    }
+    int width, height;
+    dynamicResolution.getSize(windowWidth, windowHeight, width, height);
+    offscreenTarget.setViewport(width, height);
+}
+
+// Where this frame's material textures are seen from, for the streamer:
+// the bark and leaves at the tree's bounds, the ground under the camera,
+// the sun and the nearest torch, from the eye and from where it is headed
+// (--prefetch), so the levels a nearer view needs are in before it. The
+// world sizes are roughly what one repeat of each texture covers
+void addTextureUses(const glm::vec3& sunPos) {
+    const int barkSlot = 0, leafSlot = 1, grassSlot = 2, sunSlot = 3, torchSlot = 4, leafClusterSlot = 5;
+    glm::vec3 eyes[1 + ViewSet::MAX_VIEWS];
+    int eyeCount = 0;
+    eyes[eyeCount++] = camera.getPosition();
+    if (prefetchSeconds > 0.0f) eyes[eyeCount++] = camera.predictPosition(prefetchSeconds);
+    for (int view = 1; view < viewSet.getCount(); view++) {
+        eyes[eyeCount++] = viewSet.getCamera(view).getPosition();
+    }
+    for (int i = 0; i < eyeCount; i++) {
+        const glm::vec3& eye = eyes[i];
+        float treeDistance = glm::length(eye);
+        glm::vec3 low, high;
+        if (treeBvh.getBounds(low, high)) treeDistance = glm::length(eye - glm::clamp(eye, low, high));
+        treeDistance = std::max(treeDistance, camera.getNearPlane());
+        textureStreamer.addUse(barkSlot, treeDistance, 1.0f);
+        textureStreamer.addUse(leafSlot, treeDistance, 0.15f);
+        textureStreamer.addUse(leafClusterSlot, treeDistance, 0.6f);
+        textureStreamer.addUse(sunSlot, glm::length(eye - sunPos), 1.2f);
+        for (const glm::vec3& torchPos : torchPositions) {
+            textureStreamer.addUse(torchSlot, std::max(glm::length(eye - torchPos), camera.getNearPlane()), 0.5f);
+        }
+    }
+    textureStreamer.addUse(grassSlot, camera.getNearPlane(), 1.0f);
 }
 
 // Main drawing procedure
 void drawScene(GLFWwindow* window, float time) {
+    PROFILE_SCOPE("drawScene");
+    // Each phase of the frame is its own event in the trace (T) and its
+    // Before the input is read, so it is at most framesInFlight frames
+    // older than the display
+    framePacer.wait();
+    
+    // CPU time on the HUD (H)
+    ProfileScope phase("drawScene: update");
+    int phaseIndex = 0;
+    auto nextPhase = [&phase, &phaseIndex](const char* name) {
+        framePhaseMilliseconds[phaseIndex++] = phase.next(name) * 1e-6f;
+    };
+    const AllocationCounts threadStart = AllocationCounter::getThreadCounts();
+    const AllocationCounts processStart = AllocationCounter::getProcessCounts();
+    const bool allocTrap = allocCheckWarmup >= 0 && framesDrawn >= allocCheckWarmup;
+    AllocationCounter::setThreadTrap(allocTrap);
+    gpuProfiler.beginFrame();
+    if (dynamicResolutionOn) updateDynamicResolution(window);
+    if (offscreenTarget.isCreated()) offscreenTarget.bind();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     // Calculate delta time
-    double currentTime = glfwGetTime();
+    double currentTime = sceneClock();
     float deltaTime = (float)(currentTime - lastTime);
     lastTime = currentTime;
+    perfHud.addFrameTime(deltaTime * 1000.0f);
     
     // Update camera
     camera.update(window);
     
-    // Update tree growth with actual delta time
-    tree.updateGrowth(deltaTime);
+    // Swap in a background-generated tree once it is complete, and the
+    // decoded material textures
+    installReadyTree();
+    installHandedOffTree();
+    installReadyMaterialTextures();
+    updateTreeProfiles();
+    if (watchShaders && glfwGetTime() >= shaderPollTime) {
+        shaderPollTime = glfwGetTime() + 0.5;
+        if (ShaderProgram::reloadChanged() > 0) glState.invalidateProgram();
+    }
+    
+    // Grow or drop the deep generations as the camera moves
+    if (tree->updateDetail(camera.getPosition(), camera.getFieldOfView())) {
+        tree->takeLayoutChanged();
+        reloadTreeBuffers();
+    }
+    
+    // The growth the simulation step made during the last frame
+    handleGrowthEvents();
+    
+    // Upload only the parts of the tree meshes that changed (GPU growth
+    // needs no per-frame upload at all)
+    nextPhase("drawScene: upload");
+    bool treeMoved = false;
+    if (!gpuGrowth) {
+        tree->takeBranchDirtyRanges(dirtyRanges);
+        treeMoved = !dirtyRanges.empty();
+        if (instancedBranches) {
+            const std::vector<BranchInstance>& instances = tree->getBranchInstances();
+            syncBufferRanges(branchCylinderMesh.instance_vbo, branchInstanceVBOSize, instances.data(),
+                             instances.size() * sizeof(BranchInstance), dirtyRanges);
+        } else {
+            if (streamBuffers) {
+                streamTreeBuffer(branchStream, branchMesh, branchVBOSize, tree->getBranchVertices(), dirtyRanges);
+            } else {
+                syncTreeBuffer(branchMesh.vbo, branchVBOSize, tree->getBranchVertices(), dirtyRanges);
+            }
+        }
+        tree->takeLeafDirtyRanges(dirtyRanges);
+        treeMoved = treeMoved || !dirtyRanges.empty();
+        cardsStale = cardsStale || treeMoved;
+        if (instancedLeaves) {
+            const std::vector<LeafInstance>& instances = tree->getLeafInstances();
+            syncBufferRanges(leafQuadMesh.instance_vbo, leafInstanceVBOSize, instances.data(),
+                             instances.size() * sizeof(LeafInstance), dirtyRanges);
+        } else {
+            if (streamBuffers) {
+                streamTreeBuffer(leafStream, leafMesh, leafVBOSize, tree->getLeafVertices(), dirtyRanges);
+            } else {
+                syncTreeBuffer(leafMesh.vbo, leafVBOSize, tree->getLeafVertices(), dirtyRanges);
+            }
+        }
+    }
+    takeTreeDrawState();
     
-    // Debug: Print growth progress every few seconds
-    static double lastDebugTime = 0.0;
-    if (currentTime - lastDebugTime > 5.0) {  // Every 5 seconds
-        printf("Time: %.1fs, Growth Progress: %.1f%%, Branches visible: %d\n", 
-               currentTime, tree.getGrowthProgress() * 100.0f, tree.getBranchVertexCount() / 24);  // Rough branch count
-        lastDebugTime = currentTime;
+    // A new layout is baked once it is fully grown; until then the last
+    // bake stands in for it
+    nextPhase("drawScene: cull");
+    if (impostorResidency >= 0) {
+        // Wanted while copies are drawn or the tree is far enough to be
+        // one; an evicted atlas is made and baked again
+        const bool wanted = impostorCount > 0 || (impostorDistance > 0.0f &&
+                            glm::length(camera.getPosition() - treeImpostor.getCenter()) >= impostorDistance);
+        if (wanted && !gpuResidency.touch(impostorResidency)) {
+            gpuResidency.makeResident(impostorResidency);
+            treeImpostor.create(12, 128);
+            glState.invalidateTextures();
+            impostorStale = true;
+        }
+    }
+    if (impostorStale && treeImpostor.isCreated() && tree->isStatic() && tree->getBranchCount() > 0) {
+        bakeImpostor(window);
+        impostorStale = false;
     }
     
+    // The uploads are done: sample the cursor again for the view drawn, and
+    // cull with it
+    if (lateLatch) camera.latch(window, predictMilliseconds * 1e-3f);
+    treeAsImpostor = impostorDistance > 0.0f && treeImpostor.isBaked() &&
+                     glm::length(camera.getPosition() - treeImpostor.getCenter()) >= impostorDistance;
+    
     // Set up matrices
-    glm::mat4 P = glm::perspective(glm::radians(50.0f), aspectRatio, 1.0f, 50.0f);
-    glm::mat4 V = camera.getViewMatrix();
+    const glm::mat4& P = camera.getProjectionMatrix();
+    const glm::mat4& V = camera.getViewMatrix();
+    frameView = V;
     glm::mat4 M = glm::mat4(1.0f);
-
-    sp->use();
-    glUniformMatrix4fv(sp->u("P"), 1, false, glm::value_ptr(P));
-    glUniformMatrix4fv(sp->u("V"), 1, false, glm::value_ptr(V));
-    glUniformMatrix4fv(sp->u("M"), 1, false, glm::value_ptr(M));
-
+    // Stereo culls once for both eyes, from behind them by as far as makes
+    // the one frustum's sides pass through the eyes'
+    ViewFrustum cullFrustum = camera.getFrustum();
+    // More views cull once for all: what any of them sees is kept
+    if (viewSet.isMultiple()) {
+        viewSet.update(camera, camera.getAspectRatio());
+        cullFrustum = viewSet.getCullFrustum(camera);
+    }
+    if (stereoRendering) {
+        const float pullback = 0.5f * stereoSeparation * P[0][0];
+        cullFrustum = ViewFrustum::fromMatrix(P * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -pullback)) * V);
+    }
+    
+    // Refit only when growth moved the meshes, and walk again only when
+    // they, the view or the level of detail changed. The tree is at the
+    // origin, so the camera's world frustum is its own
+    if (cullingTreeMeshes()) {
+        if (treeMoved) treeBvh.refit(*tree);
+        bool lodChanged = false;
+        glm::vec3 low, high;
+        if (treeLodEnabled && treeBvh.getBounds(low, high)) {
+            const glm::vec3 center = 0.5f * (low + high);
+            float size = TreeLod::projectedSize(center, 0.5f * glm::length(high - low),
+                                                camera.getPosition(), camera.getFieldOfView()) / treeLodBias;
+            size *= distanceFog.visibility(glm::length(center - camera.getPosition()));
+            lodChanged = treeLod.update(size, deltaTime);
+        }
+        if (treeMoved || treeCullPending || lodChanged || camera.hasChanged()) {
+            treeBvh.cull(*tree, frustumCulling ? &cullFrustum : nullptr, treeLodEnabled ? &treeLod : nullptr,
+                         visibleBranches, visibleLeaves, &fadingBranches, &fadingLeaves);
+            if (usingMeshlets()) {
+                if (treeMoved || treeCullPending) treeMeshlets.refit(*tree);
+                treeMeshlets.cull(glState, *tree, cullFrustum, camera.getPosition());
+            }
+            treeCullPending = false;
+        }
+    }
+    
+    nextPhase("drawScene: uniforms");
+    FrameUniforms frame = FrameUniforms();
+    frame.P = P;
+    frame.V = V;
+    frame.time = (float)currentTime;
+    frame.season = seasonStart;
+    if (yearSeconds > 0.0f) {
+        frame.season = (float)fmod(seasonStart + currentTime / yearSeconds, 1.0);
+    }
+    // Wind from the southwest, gusting to half its strength either way
+    frame.wind = glm::vec4(0.8f, 0.6f, windStrength, 0.5f);
+    frame.wind_gusts = glm::vec4(1.1f, 0.15f, 9.0f, 0.0f);
+    frame.camera = glm::vec4(camera.getPosition(), 1.0f);
+    frame.leaf_thinning = glm::vec4(leafThinning, 0.0f);
+    frame.fog = distanceFog.getParameters();
+    frame.fog_color = distanceFog.getColorParameters();
+    if (stereoRendering) {
+        for (int eye = 0; eye < 2; eye++) {
+            const glm::vec3 offset((eye == 0 ? -0.5f : 0.5f) * stereoSeparation, 0.0f, 0.0f);
+            frame.eye_projection[eye] = P * glm::translate(glm::mat4(1.0f), -offset);
+            frame.eye_offset[eye] = glm::vec4(offset, 0.0f);
+        }
+    }
+    
     // --- MOVING SUN LIGHT (DEBUG & DYNAMIC PATH) ---
     float sun_radius = 10.0f;
     float sun_height = 8.0f;
     float sun_speed = 0.25f; // radians per second
-    float sun_angle = sun_speed * (float)glfwGetTime();
+    float sun_angle = sun_speed * (float)sceneClock();
     // Sun moves in a circular path above the scene
     glm::vec3 sunPos = glm::vec3(sun_radius * cos(sun_angle), sun_height, sun_radius * sin(sun_angle));
-    glUniform3fv(sp->u("lightPos"), 1, glm::value_ptr(sunPos));
-    
-    // --- STATIC TORCH LIGHT ON GROUND ---
-    glm::vec3 torchPos = glm::vec3(3.0f, 0.5f, 2.0f); // Fixed position on ground
-    glm::vec3 torchLightPos = glm::vec3(3.0f, 1.0f, 2.2f); // Light source slightly above and in front of torch
-    glUniform3fv(sp->u("torchPos"), 1, glm::value_ptr(torchLightPos));
-    
-    glUniform1i(sp->u("textureMap0"), 0); // Bark texture on unit 0
-    glUniform1i(sp->u("textureMap1"), 1); // Leaf texture on unit 1
-    glUniform1i(sp->u("textureMap2"), 2); // Grass texture on unit 2
-    glUniform1i(sp->u("textureMap3"), 3); // Sun texture on unit 3
-    glUniform1i(sp->u("textureMap4"), 4); // Torch texture on unit 4
-    
-    // Bind all textures at once for all objects
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, barkTex);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, leafTex);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, grassTex);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, sunTex);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, torchTex);
-    
-    // Debug: Print sun position and light position every second
-    static double lastSunDebug = 0.0;
-    if (currentTime - lastSunDebug > 1.0) {
-        printf("[DEBUG] SunPos: (%.2f, %.2f, %.2f), TorchPos: (%.2f, %.2f, %.2f)\n", 
-               sunPos.x, sunPos.y, sunPos.z, torchPos.x, torchPos.y, torchPos.z);
-        lastSunDebug = currentTime;
+    if (skyEnabled) {
+        // As far out, rising and setting once a circle
+        float elevation = SUN_NOON_ELEVATION + SUN_ELEVATION_SWING * sin(sun_angle);
+        glm::vec3 toSun(cos(elevation) * cos(sun_angle), sin(elevation), cos(elevation) * sin(sun_angle));
+        sunPos = glm::length(sunPos) * toSun;
+        int width, height;
+        sceneSize(window, width, height);
+        GpuProfileScope pass(gpuProfiler, "sky tables");
+        if (sky.update(glState, skyTransmittanceProgram.get(), skyViewProgram.get(), toSun, sceneFramebuffer(),
+                       width, height)) {
+            glState.invalidateTextures();
+        }
+        sky.bind(glState);
+    }
+    sceneLights.clear();
+    PointLight sun = PointLight();
+    sun.position = sunPos;
+    sun.radius = 0.0f; // Lights the whole scene
+    sun.color = skyEnabled ? sky.sunColor(sunPos) : glm::vec3(1.0f);
+    sun.intensity = 0.7f;
+    sun.specular = 0.7f;
+    sun.shadow = shadowMaps.hasCascades() ? ShadowMaps::SUN_SHADOW : 0.0f;
+    sceneLights.push_back(sun);
+    
+    // --- STATIC TORCH LIGHTS ON GROUND ---
+    for (const glm::vec3& torchPos : torchPositions) {
+        PointLight torch = PointLight();
+        torch.position = torchPos + glm::vec3(0.0f, 0.5f, 0.2f); // Slightly above and in front of the torch
+        torch.radius = 10.0f;
+        torch.color = glm::vec3(1.0f, 0.6f, 0.2f); // Orange torch light
+        torch.intensity = 1.2f;
+        torch.specular = 0.3f;
+        // The first torch has the cube map
+        if (sceneLights.size() == 1 && shadowMaps.hasCube()) {
+            torch.shadow = ShadowMaps::TORCH_SHADOW;
+            shadowMaps.setTorch(torch.position, torch.radius);
+        }
+        sceneLights.push_back(torch);
+    }
+    frameUniformBuffer.update(frame);
+    lightBuffer.update(sceneLights, V, P, camera.getNearPlane(), camera.getFarPlane());
+    
+    // The shader evaluates the schedule itself, so GPU growth runs ahead
+    // of the last tick by the unconsumed frame time and stays smooth
+    frameGrowthTime = tree->getGrowthTime();
+    if (gpuGrowth && !growthPaused) {
+        frameGrowthTime += (float)growthTickRemainder;
     }
+    
+    // The materials bind their own textures
+    glState.bindTexture(5, GL_TEXTURE_BUFFER, branchDataTex);
+    glState.bindTexture(LightBuffer::GRID_UNIT, GL_TEXTURE_BUFFER, lightBuffer.getGridTexture());
+    glState.bindTexture(LightBuffer::INDEX_UNIT, GL_TEXTURE_BUFFER, lightBuffer.getIndexTexture());
+    
     // --- END MOVING SUN LIGHT ---
-
-    // --- DRAW SUN CUBE (MODERN OPENGL) ---
+    
+    // Every prop in one draw; only the sun's vertices change
+    nextPhase("drawScene: queue");
+    if (textureStreamer.isCreated()) {
+        addTextureUses(sunPos);
+        int width, height;
+        sceneSize(window, width, height);
+        if (textureStreamer.update(height / camera.getFieldOfView())) glState.invalidateTextures();
+    }
     glm::mat4 sunModel = glm::translate(glm::mat4(1.0f), sunPos) * glm::scale(glm::mat4(1.0f), glm::vec3(0.6f));
-    glUniformMatrix4fv(sp->u("M"), 1, false, glm::value_ptr(sunModel));
-    glUniform1i(sp->u("useBarkTex"), 0);
-    glUniform1i(sp->u("useLeafTex"), 0);
-    glUniform1i(sp->u("useGroundTex"), 0);
-    glUniform1i(sp->u("useSunTex"), 1); // Use sun texture
-    glUniform1i(sp->u("useTorchTex"), 0); // Not using torch texture
-    glUniform1i(sp->u("useTorchTex"), 0); // Not using torch texture
-    
-    int sunPosAttrib = sp->a("vertex");
-    int sunTexAttrib = sp->a("texcoord");
-    int sunNormAttrib = sp->a("normal");
-    if (sunPosAttrib >= 0) {
-        glEnableVertexAttribArray(sunPosAttrib);
-        glVertexAttribPointer(sunPosAttrib, 4, GL_FLOAT, false, 0, myCubeVertices);
-    }
-    if (sunTexAttrib >= 0) {
-        glEnableVertexAttribArray(sunTexAttrib);
-        glVertexAttribPointer(sunTexAttrib, 2, GL_FLOAT, false, 0, myCubeTexCoords);
-    }
-    if (sunNormAttrib >= 0) {
-        glEnableVertexAttribArray(sunNormAttrib);
-        glVertexAttribPointer(sunNormAttrib, 3, GL_FLOAT, false, 0, myCubeNormals);
-    }
-    glDrawArrays(GL_TRIANGLES, 0, myCubeVertexCount);
-    if (sunPosAttrib >= 0) glDisableVertexAttribArray(sunPosAttrib);
-    if (sunTexAttrib >= 0) glDisableVertexAttribArray(sunTexAttrib);
-    if (sunNormAttrib >= 0) glDisableVertexAttribArray(sunNormAttrib);
-    glUniformMatrix4fv(sp->u("M"), 1, false, glm::value_ptr(M));
-    // --- END DRAW SUN CUBE ---
-
-    // --- DRAW TORCH (MODERN OPENGL) ---
-    glm::mat4 torchModel = glm::translate(glm::mat4(1.0f), torchPos) * 
-                          glm::scale(glm::mat4(1.0f), glm::vec3(0.2f, 0.5f, 0.2f)); // Tall, thin torch
-    glUniformMatrix4fv(sp->u("M"), 1, false, glm::value_ptr(torchModel));
-    glUniform1i(sp->u("useBarkTex"), 0);
-    glUniform1i(sp->u("useLeafTex"), 0);
-    glUniform1i(sp->u("useGroundTex"), 0);
-    glUniform1i(sp->u("useSunTex"), 0); // Not using sun texture
-    glUniform1i(sp->u("useTorchTex"), 1); // Use torch texture
-    
-    int torchPosAttrib = sp->a("vertex");
-    int torchTexAttrib = sp->a("texcoord");
-    int torchNormAttrib = sp->a("normal");
-    if (torchPosAttrib >= 0) {
-        glEnableVertexAttribArray(torchPosAttrib);
-        glVertexAttribPointer(torchPosAttrib, 4, GL_FLOAT, false, 0, myCubeVertices);
-    }
-    if (torchTexAttrib >= 0) {
-        glEnableVertexAttribArray(torchTexAttrib);
-        glVertexAttribPointer(torchTexAttrib, 2, GL_FLOAT, false, 0, myCubeTexCoords);
-    }
-    if (torchNormAttrib >= 0) {
-        glEnableVertexAttribArray(torchNormAttrib);
-        glVertexAttribPointer(torchNormAttrib, 3, GL_FLOAT, false, 0, torchNormals);
-    }
-    glDrawArrays(GL_TRIANGLES, 0, myCubeVertexCount);
-    if (torchPosAttrib >= 0) glDisableVertexAttribArray(torchPosAttrib);
-    if (torchTexAttrib >= 0) glDisableVertexAttribArray(torchTexAttrib);
-    if (torchNormAttrib >= 0) glDisableVertexAttribArray(torchNormAttrib);
-    glUniformMatrix4fv(sp->u("M"), 1, false, glm::value_ptr(M));
-    // --- END DRAW TORCH ---
-
-    
-    glm::mat4 groundModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -2.0f, 0.0f))
-        * glm::scale(glm::mat4(1.0f), glm::vec3(8.0f, 2.0f, 8.0f));
-    glUniformMatrix4fv(sp->u("M"), 1, false, glm::value_ptr(groundModel));
-    glUniform1i(sp->u("useBarkTex"), 0);
-    glUniform1i(sp->u("useLeafTex"), 0);
-    glUniform1i(sp->u("useGroundTex"), 1); // Use ground texture
-    glUniform1i(sp->u("useSunTex"), 0); // Not using sun texture
-    glUniform1i(sp->u("useTorchTex"), 0); // Not using torch texture
-    glUniform1i(sp->u("useTorchTex"), 0); // Not using torch texture
-    int groundPosAttrib = sp->a("vertex");
-    int groundTexAttrib = sp->a("texcoord");
-    int groundNormAttrib = sp->a("normal");
-    if (groundPosAttrib >= 0) {
-        glEnableVertexAttribArray(groundPosAttrib);
-        glVertexAttribPointer(groundPosAttrib, 4, GL_FLOAT, false, 0, myCubeVertices);
-    }
-    if (groundTexAttrib >= 0) {
-        glEnableVertexAttribArray(groundTexAttrib);
-        glVertexAttribPointer(groundTexAttrib, 2, GL_FLOAT, false, 0, myCubeTexCoords);
-    }
-    if (groundNormAttrib >= 0) {
-        glEnableVertexAttribArray(groundNormAttrib);
-        glVertexAttribPointer(groundNormAttrib, 3, GL_FLOAT, false, 0, groundNormals);
-    }
-    glDrawArrays(GL_TRIANGLES, 0, myCubeVertexCount);
-    if (groundPosAttrib >= 0) glDisableVertexAttribArray(groundPosAttrib);
-    if (groundTexAttrib >= 0) glDisableVertexAttribArray(groundTexAttrib);
-    if (groundNormAttrib >= 0) glDisableVertexAttribArray(groundNormAttrib);
-    glUniformMatrix4fv(sp->u("M"), 1, false, glm::value_ptr(M));
-    // --- END DRAW GROUND CUBE ---
-
-    // Render tree branches with bark texture
-    glUniform1i(sp->u("useBarkTex"), 1); // Use bark texture
-    glUniform1i(sp->u("useLeafTex"), 0); // Not using leaf texture
-    glUniform1i(sp->u("useGroundTex"), 0); // Not using ground texture
-    glUniform1i(sp->u("useSunTex"), 0); // Not using sun texture
-    glUniform1i(sp->u("useTorchTex"), 0); // Not using torch texture
-    glUniform1i(sp->u("useTorchTex"), 0); // Not using torch texture
-    // Set up attributes: position (4), texcoord (2), normal (3)
-    const std::vector<GLfloat>& branchVerts = tree.getBranchVertices();
-    int stride = 9 * sizeof(GLfloat);
-    int posAttrib = sp->a("vertex");
-    int texAttrib = sp->a("texcoord");
-    int normAttrib = sp->a("normal");
-    if (posAttrib >= 0) {
-        glEnableVertexAttribArray(posAttrib);
-        glVertexAttribPointer(posAttrib, 4, GL_FLOAT, false, stride, branchVerts.data());
-    }
-    if (texAttrib >= 0) {
-        glEnableVertexAttribArray(texAttrib);
-        glVertexAttribPointer(texAttrib, 2, GL_FLOAT, false, stride, branchVerts.data() + 4);
-    }
-    if (normAttrib >= 0) {
-        glEnableVertexAttribArray(normAttrib);
-        glVertexAttribPointer(normAttrib, 3, GL_FLOAT, false, stride, branchVerts.data() + 6);
-    }
-    glDrawArrays(GL_TRIANGLES, 0, tree.getBranchVertexCount());
-    if (posAttrib >= 0) glDisableVertexAttribArray(posAttrib);
-    if (texAttrib >= 0) glDisableVertexAttribArray(texAttrib);
-    if (normAttrib >= 0) glDisableVertexAttribArray(normAttrib);
-
-    // Render tree leaves (9 floats per vertex: position + texcoord + normal)
-    glUniform1i(sp->u("useBarkTex"), 0);
-    glUniform1i(sp->u("useLeafTex"), 1);
-    glUniform1i(sp->u("useGroundTex"), 0);
-    glUniform1i(sp->u("useSunTex"), 0); // Not using sun texture
-    glUniform1i(sp->u("useTorchTex"), 0); // Not using torch texture
-    glUniform1i(sp->u("useTorchTex"), 0); // Not using torch texture
-    const std::vector<GLfloat>& leafVerts = tree.getLeafVertices();
-    if (posAttrib >= 0) {
-        glEnableVertexAttribArray(posAttrib);
-        glVertexAttribPointer(posAttrib, 4, GL_FLOAT, false, stride, leafVerts.data());
-    }
-    if (texAttrib >= 0) {
-        glEnableVertexAttribArray(texAttrib);
-        glVertexAttribPointer(texAttrib, 2, GL_FLOAT, false, stride, leafVerts.data() + 4);
-    }
-    if (normAttrib >= 0) {
-        glEnableVertexAttribArray(normAttrib);
-        glVertexAttribPointer(normAttrib, 3, GL_FLOAT, false, stride, leafVerts.data() + 6);
-    }
-    glDrawArrays(GL_TRIANGLES, 0, tree.getLeafVertexCount());
-    if (posAttrib >= 0) glDisableVertexAttribArray(posAttrib);
-    if (texAttrib >= 0) glDisableVertexAttribArray(texAttrib);
-    if (normAttrib >= 0) glDisableVertexAttribArray(normAttrib);
+    staticProps.setTransform(sunProp, sunModel);
+    staticProps.sync();
+    queueDraw(propMaterial, M, issueStaticProps);
+    int viewportWidth, viewportHeight;
+    sceneSize(window, viewportWidth, viewportHeight);
+    terrain.select(frustumCulling ? &cullFrustum : nullptr, camera.getPosition(), camera.getFieldOfView(),
+                   viewportHeight);
+    queueDraw(terrainMaterial, M, issueTerrain);
+    if (grass.getChunkCount() > 0) {
+        grass.select(frustumCulling ? &cullFrustum : nullptr, camera.getPosition());
+        queueDraw(grassMaterial, M, issueGrass);
+    }
+    
+    if (!treeAsImpostor) {
+        queueDraw(barkMaterial, M, issueTreeWood);
+        if (usingBranchLines()) {
+            branchPixelScale = P[1][1] * viewportHeight * 0.5f;
+            queueDraw(branchLineMaterial, M, issueBranchLines);
+        }
+        // Foliage goes after the opaque pass, whose depth rejects hidden leaves early
+        queueDraw(leafMaterial, M, issueTreeLeaves, nullptr, 0, 1);
+        if (fadingTreeLod()) {
+            if (!instancedBranches) queueDraw(barkFadeMaterial, M, issueFadingWood);
+            if (!instancedLeaves) queueDraw(leafFadeMaterial, M, issueFadingLeaves, nullptr, 0, 1);
+        }
+        // Leaf cards stand in for the leaves from their level on
+        bool cardLevels = leafCardsEnabled && treeLodEnabled && cullingTreeMeshes();
+        float cardOpacity = cardLevels ? treeLod.getCardOpacity() : 0.0f;
+        if (cardOpacity > 0.0f) updateLeafCards();
+        if (cardOpacity >= 1.0f) {
+            queueDraw(leafCardMaterial, M, issueLeafCards, nullptr, 0, 1);
+        } else if (cardOpacity > 0.0f) {
+            queueDraw(leafCardFadeMaterial, M, issueLeafCards, nullptr, 0, 1);
+        }
+    }
+    if (world.update(camera.getPosition(), (float)sceneClock())) world.apply(forest);
+    if (forest.getArchetypeCount() > 0) {
+        forest.select(glState, frustumCulling ? &cullFrustum : nullptr, camera.getPosition(), camera.getFieldOfView());
+        queueDraw(forestBarkMaterial, M, issueForestWood);
+        queueDraw(forestLeafMaterial, M, issueForestLeaves, nullptr, 0, 1);
+    }
+    if (gpuTrees.isGenerated()) {
+        queueDraw(barkMaterial, M, issueGpuTreeWood);
+        queueDraw(leafMaterial, M, issueGpuTreeLeaves, nullptr, 0, 1);
+    }
+    if (leafParticles.isCreated()) {
+        updateFallingLeaves(frame, M, deltaTime);
+        queueDraw(leafMaterial, M, issueFallingLeaves, nullptr, 0, 1);
+    }
+    if (treeImpostor.isBaked() && (impostorCount > 0 || treeAsImpostor)) {
+        queueDraw(impostorMaterial, M, issueImpostors, nullptr, 0, 1);
+    }
+    // Nothing below reads the tree: step the next frame's growth, with
+    // this frame's time, while this one is drawn
+    if (!growthPaused) {
+        simulation.post([deltaTime]() { advanceGrowth(deltaTime); });
+    }
+    nextPhase("drawScene: shadow maps");
+    renderShadowMaps(V, sunPos, treeMoved, viewportWidth, viewportHeight);
+    nextPhase("drawScene: scene draws");
+    renderQueue.sort();
+    for (int view = 0; view < viewSet.getCount(); view++) {
+        const Camera& viewCamera = view == 0 ? camera : viewSet.getCamera(view);
+        const glm::mat4& viewP = viewCamera.getProjectionMatrix();
+        const glm::mat4& viewV = viewCamera.getViewMatrix();
+        if (view > 0) {
+            // A fixed view's own matrices, eye-space lights and shadows
+            frame.P = viewP;
+            frame.V = viewV;
+            frame.camera = glm::vec4(viewCamera.getPosition(), 1.0f);
+            frameUniformBuffer.update(frame);
+            lightBuffer.update(sceneLights, viewV, viewP, viewCamera.getNearPlane(), viewCamera.getFarPlane());
+            shadowMaps.upload(viewV);
+        }
+        if (viewSet.isMultiple()) {
+            int x, y, width, height;
+            viewSet.getViewport(view, viewportWidth, viewportHeight, x, y, width, height);
+            glViewport(x, y, width, height);
+        }
+        issueSceneDraws(viewP, viewV);
+        if (skyEnabled) {
+            GpuProfileScope pass(gpuProfiler, "sky");
+            // Clip space to world directions: the view's turn alone, the rays
+            // from the eye
+            sky.draw(glState, skyProgram.get(), glm::inverse(viewP * glm::mat4(glm::mat3(viewV))));
+        }
+    }
+    renderQueue.clear();
+    if (viewSet.isMultiple()) glViewport(0, 0, viewportWidth, viewportHeight);
+    
+    int framebufferWidth, framebufferHeight;
+    sceneSize(window, framebufferWidth, framebufferHeight);
+    // The next frame's forest is culled against this one's depth
+    nextPhase("drawScene: depth pyramid");
+    if (depthPyramidProgram) {
+        GpuProfileScope pass(gpuProfiler, "depth pyramid");
+        if (!depthPyramid.isCreated() || depthPyramid.getWidth() != framebufferWidth ||
+            depthPyramid.getHeight() != framebufferHeight) {
+            depthPyramid.create(framebufferWidth, framebufferHeight);
+            glState.invalidateTextures();
+        }
+        depthPyramid.build(glState, depthPyramidProgram.get(), P * V, sceneFramebuffer());
+    }
     
+    // The regions written this frame are fenced behind its draws
+    branchStream.endFrame();
+    leafStream.endFrame();
+    glState.endFrame();
+    gpuResidency.endFrame();
+    RenderStats::endFrame();
+    gpuProfiler.endFrame();
+    nextPhase("drawScene: swap");
+    if (offscreenTarget.isCreated()) offscreenTarget.resolve();
+    if (dynamicResolutionOn) {
+        // Captures and the HUD are of the window, at its own resolution
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        offscreenTarget.present(framebufferWidth, framebufferHeight);
+    }
+    frameCapture.endFrame(framebufferWidth, framebufferHeight);
+    // After the capture, so screenshots and recordings leave it out
+    AllocationCounter::setThreadTrap(false);
+    const AllocationCounts hudStart = AllocationCounter::getThreadCounts();
+    if (hudVisible) drawHud(framebufferWidth, framebufferHeight);
+    const AllocationCounts hudEnd = AllocationCounter::getThreadCounts();
+    AllocationCounter::setThreadTrap(allocTrap);
     glfwSwapBuffers(window);
+    framePacer.endFrame();
+    nextPhase("drawScene: simulation wait");
+    simulation.wait(); // The input callbacks and the next frame own the tree again
+    
+    AllocationCounter::setThreadTrap(false);
+    const AllocationCounts threadEnd = AllocationCounter::getThreadCounts();
+    const AllocationCounts processEnd = AllocationCounter::getProcessCounts();
+    const uint64_t hudAllocations = hudEnd.allocations - hudStart.allocations;
+    const uint64_t hudBytes = hudEnd.bytes - hudStart.bytes;
+    frameAllocations.allocations = threadEnd.allocations - threadStart.allocations - hudAllocations;
+    frameAllocations.bytes = threadEnd.bytes - threadStart.bytes - hudBytes;
+    frameProcessAllocations.allocations = processEnd.allocations - processStart.allocations - hudAllocations;
+    frameProcessAllocations.bytes = processEnd.bytes - processStart.bytes - hudBytes;
+    Profiler::recordCounter("frame allocations", frameAllocations.allocations);
+    Profiler::recordCounter("frame allocations, all threads", frameProcessAllocations.allocations);
+    framesDrawn++;
+}
+
+// Whether the next frame differs from the last only by the sun's motion:
+// the tree is not growing, the camera held still in the last update, no
+// recording needs every frame, no capture waits for a later endFrame and
+// no level-of-detail fade is running
+bool sceneIsIdle() {
+    return (growthPaused || tree->isStatic()) && !camera.hasChanged() && !frameCapture.isRecording() &&
+           !frameCapture.hasPendingFrames() && !fadingTreeLod() && forest.isGrownAt((float)sceneClock());
+}
+
+// Sleep until an event or the next sun update is due. The time spent idle
+// is no growth time: a P that resumes growth starts from this moment
+void waitForNextFrame() {
+    PROFILE_SCOPE("waitForNextFrame");
+    if (idleRedrawRate > 0.0f) {
+        glfwWaitEventsTimeout(1.0 / idleRedrawRate);
+    } else if (treeJob.isPending() || materialTextureLoad.pending) {
+        glfwWaitEventsTimeout(0.1); // Keep looking for the background tree and textures
+    } else {
+        glfwWaitEvents();
+    }
+    lastTime = glfwGetTime();
+}
+
+// Sleep, still taking input, until the frame cap lets the next frame
+// start or the window is minimized
+void waitForFrameSlot(GLFWwindow* window) {
+    PROFILE_SCOPE("waitForFrameSlot");
+    double wait;
+    while ((wait = frameLimiter.getWait(glfwGetTime())) > 0.0 && !frameLimiter.isPaused() &&
+           !glfwWindowShouldClose(window)) {
+        glfwWaitEventsTimeout(wait);
+    }
+}
+
+// Minimized: no frame, but growth goes on tick by tick so the tree is
+// where it would have been when the window comes back
+void simulateMinimized() {
+    PROFILE_SCOPE("simulateMinimized");
+    glfwWaitEventsTimeout(growthTickRate > 0.0f ? 1.0 / growthTickRate : 0.1);
+    const double now = sceneClock();
+    if (!growthPaused) advanceGrowth((float)(now - lastTime));
+    lastTime = now;
+}
+
+// Nearest-rank percentile, p in (0, 1], of values; 0 when there are none
+float benchPercentile(std::vector<float> values, float p) {
+    if (values.empty()) return 0.0f;
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(p * values.size());
+    return values[std::min(std::max<size_t>(rank, 1), values.size()) - 1];
+}
+
+// === BENCHMARK ===
+// Draw the benchFrames frames and write their times. A frame's GPU time,
+// the sum of its outermost timed passes, is read back GpuProfiler::FRAMES
+// frames later, and the last ones after a glFinish()
+void runBenchmark(GLFWwindow* window) {
+    struct BenchRow {
+        float cpu_milliseconds;
+        float phase_milliseconds[FRAME_PHASES];
+        float wait_milliseconds; // For the GPU, in FramePacer::wait()
+        float gpu_milliseconds;  // -1 until read back
+    };
+    std::vector<BenchRow> rows;
+    rows.reserve(benchFrames);
+    auto collectGpuTime = [&rows]() {
+        long long frame = gpuProfiler.getTimingsFrame();
+        if (frame < 0 || frame >= (long long)rows.size() || rows[frame].gpu_milliseconds >= 0.0f) return;
+        float total = 0.0f;
+        for (const GpuProfiler::Timing& timing : gpuProfiler.getTimings()) {
+            if (timing.depth == 0) total += timing.milliseconds;
+        }
+        rows[frame].gpu_milliseconds = total;
+    };
+    
+    LOG_INFO(App) << "Benchmark: " << benchFrames << " frames along a path of " << cameraPath.size()
+                  << " keyframes";
+    for (clockFrame = 0; clockFrame < benchFrames && !glfwWindowShouldClose(window); clockFrame++) {
+        CameraKeyframe pose = cameraPath.evaluate(benchFrames > 1 ? (float)clockFrame / (benchFrames - 1) : 0.0f);
+        camera.setOrbit(pose.theta, pose.phi, pose.radius);
+        uint64_t start = Profiler::now();
+        drawScene(window, (float)sceneClock());
+        BenchRow row;
+        row.cpu_milliseconds = (Profiler::now() - start) * 1e-6f;
+        std::copy(framePhaseMilliseconds, framePhaseMilliseconds + FRAME_PHASES, row.phase_milliseconds);
+        row.wait_milliseconds = framePacer.getWaitMilliseconds();
+        row.gpu_milliseconds = -1.0f;
+        rows.push_back(row);
+        collectGpuTime();
+        if (sceneIsIdle()) compactTreeSlots();
+        glfwPollEvents();
+    }
+    // Empty frames read back the sets still in flight
+    glFinish();
+    for (int f = 0; f < GpuProfiler::FRAMES; f++) {
+        gpuProfiler.beginFrame();
+        collectGpuTime();
+        gpuProfiler.endFrame();
+    }
+    
+    // === RESULTS ===
+    // One row per frame; a GPU time never read back is left empty
+    std::string csv = "frame,cpu_ms";
+    for (int p = 0; p < FRAME_PHASES; p++) {
+        csv += ",";
+        for (const char* c = framePhaseNames[p]; *c; c++) {
+            csv += *c == ' ' ? '_' : *c;
+        }
+        csv += "_ms";
+    }
+    csv += ",pacing_wait_ms,gpu_ms\n";
+    std::vector<float> cpuTimes, waitTimes, gpuTimes;
+    char text[64];
+    for (size_t f = 0; f < rows.size(); f++) {
+        const BenchRow& row = rows[f];
+        snprintf(text, sizeof(text), "%zu,%.4f", f, row.cpu_milliseconds);
+        csv += text;
+        for (int p = 0; p < FRAME_PHASES; p++) {
+            snprintf(text, sizeof(text), ",%.4f", row.phase_milliseconds[p]);
+            csv += text;
+        }
+        snprintf(text, sizeof(text), ",%.4f", row.wait_milliseconds);
+        csv += text;
+        if (row.gpu_milliseconds >= 0.0f) {
+            snprintf(text, sizeof(text), ",%.4f\n", row.gpu_milliseconds);
+            csv += text;
+            gpuTimes.push_back(row.gpu_milliseconds);
+        } else {
+            csv += ",\n";
+        }
+        cpuTimes.push_back(row.cpu_milliseconds);
+        waitTimes.push_back(row.wait_milliseconds);
+    }
+    FILE* file = fopen(benchOutputFile.c_str(), "wb");
+    bool written = file && fwrite(csv.data(), 1, csv.size(), file) == csv.size();
+    if (file && fclose(file) != 0) written = false;
+    if (written) {
+        LOG_INFO(App) << "Saved " << rows.size() << " frame times to " << benchOutputFile;
+    } else {
+        LOG_ERROR(App) << "Cannot write " << benchOutputFile;
+    }
+    LOG_INFO(App) << "CPU ms: median " << benchPercentile(cpuTimes, 0.5f) << ", p95 "
+                  << benchPercentile(cpuTimes, 0.95f) << ", p99 " << benchPercentile(cpuTimes, 0.99f);
+    if (framePacer.isCreated()) {
+        LOG_INFO(App) << "Pacing wait ms (" << framePacer.getFramesInFlight() << " frames in flight): median "
+                      << benchPercentile(waitTimes, 0.5f) << ", p95 " << benchPercentile(waitTimes, 0.95f) << ", "
+                      << framePacer.getStalls() << " stalls";
+    }
+    if (!gpuTimes.empty()) {
+        LOG_INFO(App) << "GPU ms: median " << benchPercentile(gpuTimes, 0.5f) << ", p95 "
+                      << benchPercentile(gpuTimes, 0.95f) << ", p99 " << benchPercentile(gpuTimes, 0.99f) << " ("
+                      << gpuTimes.size() << " of " << rows.size() << " frames read back)";
+    }
+    
+    BenchBaseline run;
+    for (float time : cpuTimes) run.add("frame_cpu", time);
+    for (float time : gpuTimes) run.add("frame_gpu", time);
+    std::ostringstream report;
+    const int status = benchBaseline.finish("tree_demo", run, report);
+    if (!report.str().empty()) {
+        if (status == 0) {
+            LOG_INFO(App) << report.str();
+        } else {
+            LOG_WARNING(App) << report.str();
+        }
+    }
+    if (status != 0) exitStatus = status;
+}
+
+// === HEADLESS ===
+
+// The jobs of a --headless file into headlessJobs
+bool loadHeadlessJobs(const std::string& path, std::string& error) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        error = "cannot open";
+        return false;
+    }
+    std::string line;
+    int number = 0;
+    while (std::getline(file, line)) {
+        number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        std::istringstream fields(line);
+        HeadlessJob job;
+        if (!(fields >> job.seed)) continue; // Blank
+        if (!(fields >> job.pose.theta >> job.pose.phi >> job.pose.radius >> job.path) || job.seed < 0) {
+            error = "line " + std::to_string(number) + ": expected seed theta phi radius image.png";
+            return false;
+        }
+        headlessJobs.push_back(job);
+    }
+    if (headlessJobs.empty()) error = "no jobs";
+    return !headlessJobs.empty();
+}
+
+// Draw every job in turn: its tree, fully grown, from its camera, the
+// image taken on the last of HEADLESS_SETTLE_FRAMES + 1 frames. Each job
+// starts the scene clock again, so an image doesn't depend on its place in
+// the file, and the encoders write the images while the next ones draw
+void runHeadless(GLFWwindow* window) {
+    uint64_t start = Profiler::now();
+    // The next job's tree, kept out of treeJob so drawScene doesn't swap
+    // it in early
+    TreeGenerationJob nextTree;
+    for (size_t j = 0; j < headlessJobs.size() && !glfwWindowShouldClose(window); j++) {
+        const HeadlessJob& job = headlessJobs[j];
+        // The first job's tree was started with the program
+        if (nextTree.isPending()) treeJob = std::move(nextTree);
+        if (!treeJob.isPending()) startTreeGeneration(job.seed);
+        installTree();
+        if (j + 1 < headlessJobs.size()) {
+            startTreeGeneration(headlessJobs[j + 1].seed);
+            nextTree = std::move(treeJob);
+        }
+        seekGrowth(tree->getScheduleEnd());
+        camera.setOrbit(job.pose.theta, job.pose.phi, job.pose.radius);
+        clockFrame = 0;
+        lastTime = sceneClock();
+        for (int f = 0; f <= HEADLESS_SETTLE_FRAMES; f++) {
+            if (f == HEADLESS_SETTLE_FRAMES) frameCapture.screenshot(job.path);
+            drawScene(window, (float)sceneClock());
+            clockFrame++;
+        }
+        glfwPollEvents();
+    }
+    frameCapture.finish();
+    float seconds = (Profiler::now() - start) * 1e-9f;
+    LOG_INFO(App) << "Rendered " << headlessJobs.size() << " images at " << offscreenWidth << "x" << offscreenHeight
+                  << " in " << seconds << " s";
 }
 
-int main(void) {
+int main(int argc, char** argv) {
     GLFWwindow* window;
     
+    // Each -v raises console verbosity (2: per-generation tree detail);
+    // --gpu-growth animates the tree in the vertex shader, --tubes welds limbs,
+    // --packed-vertices uploads the compact 20-byte vertex format,
+    // --single-sided-leaves halves the leaf geometry, --instanced-leaves
+    // and --instanced-branches draw from per-element records (--branch-lines
+    // expands the branch records in a geometry shader, --branch-tubes
+    // tessellates them), --threads N
+    // generates subtrees in parallel, --species / --grammar pick an L-system,
+    // --space-colonization switches the generator, --twig-instances shares
+    // a few twig prototypes across the deep generations, --avoid-overlaps
+    // keeps branches from growing through each other, --max-branches /
+    // --max-leaves / --max-vertices cap each tree, --lazy-detail N grows
+    // generations from N on only when the camera is close, --load-tree /
+    // --save-tree read and write binary tree files (--encode-mesh encodes
+    // the saved meshes), --handoff NAME takes trees from a generator
+    // process through shared memory, --bundle FILE / --no-bundle pick where
+    // the shaders and textures come from, --export-tree FILE
+    // exports each tree as .glb or .obj, --growth-hz N sets the
+    // growth tick rate, --update-threads N spreads the per-frame update,
+    // --shader-cache DIR keeps linked shader binaries, --torches N adds
+    // torches around the tree, --msaa N multisamples, --leaf-prepass draws
+    // leaf depth before leaf shading, --depth-prepass does so for everything,
+    // --anisotropy N sets the texture filtering, --texture-cache DIR keeps
+    // decoded textures, --record PREFIX saves every frame as PNG,
+    // --no-culling draws the whole tree whatever the view, --meshlets culls
+    // it by meshlets on the GPU, --on-demand stops redrawing an idle scene
+    // but at --idle-hz N, --lod draws simpler trees
+    // from afar (--lod-bias F sooner), --impostors N scatters N impostor
+    // copies of the grown tree and --impostor-distance D draws the tree
+    // itself as one from D away, --leaf-cards draws leaf cards in place of
+    // the leaves at mid distance and beyond, --forest N plants N instanced
+    // trees of --forest-archetypes K shapes over --forest-extent E, culled
+    // on the GPU with --gpu-culling and hidden ones dropped too with
+    // --occlusion-culling, --world R streams an endless forest in chunks
+    // around the camera out to R (drawn as merged proxies from
+    // --world-proxies D on) and, with --prefetch S, where the camera
+    // heads S seconds ahead, --terrain-extent E and --terrain-height H size
+    // the ground's heightfield, --grass D grows D blades per square unit on
+    // it out to --grass-radius R, --wind S sets the wind strength (0 = still),
+    // --season S sets the time of year and --year-seconds Y cycles it,
+    // --no-shadows turns the shadow maps off, --shadow-size N sizes them and
+    // --shadow-intervals A,B,C,T sets how often each is redrawn,
+    // --no-sim-thread steps growth on the render thread, --stream-buffers
+    // writes the animated tree meshes into persistently mapped buffers,
+    // --gpu-trees N generates and meshes N more trees on the GPU,
+    // --falling-leaves N lets up to N dropped or pruned leaves fall,
+    // --view-distance D fogs the scene out to D and draws nothing past it
+    // (--fog-height H,F densest at H, thinning by F above), --sky draws a
+    // physically based sky under a rising and setting sun, --view T,P,R
+    // adds a view orbiting at those angles and distance beside the camera's,
+    // --no-profile stops recording the profiler's scopes, --hud shows
+    // the performance HUD, --alloc-check N aborts at the first allocation
+    // of a frame after N warm-up frames, --seed S fixes the first tree's seed and
+    // --bench N times N frames along --camera-path FILE into
+    // --bench-output FILE, then exits (--compare checks the times against
+    // the stored baseline, --save-baseline stores them), and --headless FILE renders the jobs
+    // of FILE into --size WxH images in a hidden window, then exits;
+    // --log-mute A,B silences the named log categories and --sync-log
+    // writes each message as it is made
+    Profiler::setThreadName("main");
+    Log::start();
+    std::string species;
+    std::string grammarFile;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "-v") verbosity++;
+        if (std::string(argv[i]) == "--gpu-growth") gpuGrowth = true;
+        if (std::string(argv[i]) == "--tubes") tubeBranches = true;
+        if (std::string(argv[i]) == "--curved-branches" && i + 1 < argc) branchCurvature = atof(argv[++i]);
+        if (std::string(argv[i]) == "--curve-budget" && i + 1 < argc) curveVertexBudget = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--packed-vertices") packedVertices = true;
+        if (std::string(argv[i]) == "--single-sided-leaves") singleSidedLeaves = true;
+        if (std::string(argv[i]) == "--morton-leaves") mortonLeaves = true;
+        if (std::string(argv[i]) == "--leaf-mix" && i + 1 < argc) leafMixRatio = atof(argv[++i]);
+        if (std::string(argv[i]) == "--instanced-leaves") instancedLeaves = true;
+        if (std::string(argv[i]) == "--instanced-branches") instancedBranches = true;
+        if (std::string(argv[i]) == "--branch-lines") branchLines = instancedBranches = true;
+        if (std::string(argv[i]) == "--branch-tubes") branchTubes = instancedBranches = true;
+        if (std::string(argv[i]) == "--threads" && i + 1 < argc) generationThreads = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--update-threads" && i + 1 < argc) updateThreads = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--species" && i + 1 < argc) species = argv[++i];
+        if (std::string(argv[i]) == "--grammar" && i + 1 < argc) grammarFile = argv[++i];
+        if (std::string(argv[i]) == "--profiles" && i + 1 < argc) profileFile = argv[++i];
+        if (std::string(argv[i]) == "--space-colonization") spaceColonization = true;
+        if (std::string(argv[i]) == "--twig-instances") twigInstances = true;
+        if (std::string(argv[i]) == "--avoid-overlaps") avoidOverlaps = true;
+        if (std::string(argv[i]) == "--sky") skyEnabled = true;
+        if (std::string(argv[i]) == "--baked-ao" && i + 1 < argc) bakedOcclusionRays = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--max-branches" && i + 1 < argc) treeBudget.max_branches = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--max-leaves" && i + 1 < argc) treeBudget.max_leaves = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--max-vertices" && i + 1 < argc) treeBudget.max_vertices = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--lazy-detail" && i + 1 < argc) lazyDetailGeneration = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--load-tree" && i + 1 < argc) loadTreeFile = argv[++i];
+        if (std::string(argv[i]) == "--save-tree" && i + 1 < argc) saveTreeFile = argv[++i];
+        if (std::string(argv[i]) == "--encode-mesh") encodeSavedMesh = true;
+        if (std::string(argv[i]) == "--handoff" && i + 1 < argc) handoffName = argv[++i];
+        if (std::string(argv[i]) == "--export-tree" && i + 1 < argc) exportTreeFile = argv[++i];
+        if (std::string(argv[i]) == "--growth-hz" && i + 1 < argc) growthTickRate = atof(argv[++i]);
+        if (std::string(argv[i]) == "--shader-cache" && i + 1 < argc) shaderCacheDirectory = argv[++i];
+        if (std::string(argv[i]) == "--watch-shaders") watchShaders = true;
+        if (std::string(argv[i]) == "--bundle" && i + 1 < argc) resourceBundleFile = argv[++i];
+        if (std::string(argv[i]) == "--no-bundle") useResourceBundle = false;
+        if (std::string(argv[i]) == "--tree-cache" && i + 1 < argc) treeCacheDirectory = argv[++i];
+        if (std::string(argv[i]) == "--tree-cache-mb" && i + 1 < argc) treeCacheMB = std::max(0.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--torches" && i + 1 < argc) extraTorches = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--msaa" && i + 1 < argc) msaaSamples = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--dynamic-resolution" && i + 1 < argc) {
+            dynamicResolutionOn = sscanf(argv[++i], "%f,%f", &dynamicMinScale, &dynamicMaxScale) == 2;
+        }
+        if (std::string(argv[i]) == "--gpu-budget" && i + 1 < argc) gpuBudgetMilliseconds = atof(argv[++i]);
+        if (std::string(argv[i]) == "--late-latch") lateLatch = true;
+        if (std::string(argv[i]) == "--frames-in-flight" && i + 1 < argc) framesInFlight = atoi(argv[++i]);
+        if (std::string(argv[i]) == "--vsync" && i + 1 < argc) swapInterval = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--predict-ms" && i + 1 < argc) {
+            predictMilliseconds = std::max(0.0f, (float)atof(argv[++i]));
+            lateLatch = true;
+        }
+        if (std::string(argv[i]) == "--leaf-prepass") leafPrepass = true;
+        if (std::string(argv[i]) == "--depth-prepass") depthPrepass = true;
+        if (std::string(argv[i]) == "--no-culling") frustumCulling = false;
+        if (std::string(argv[i]) == "--meshlets") meshletCulling = true;
+        if (std::string(argv[i]) == "--lod") treeLodEnabled = true;
+        if (std::string(argv[i]) == "--forest" && i + 1 < argc) forestCount = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--forest-archetypes" && i + 1 < argc) forestArchetypes = std::max(1, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--forest-extent" && i + 1 < argc) forestExtent = atof(argv[++i]);
+        if (std::string(argv[i]) == "--forest-spacing" && i + 1 < argc) forestSpacing = std::max(0.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--gpu-culling") forestGpuCulling = true;
+        if (std::string(argv[i]) == "--forest-threads" && i + 1 < argc) forestSelectThreads = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--world" && i + 1 < argc) worldRadius = std::max(0.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--world-chunk" && i + 1 < argc) worldChunkSize = std::max(1.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--world-trees" && i + 1 < argc) worldChunkTrees = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--world-budget" && i + 1 < argc) worldBudgetMB = std::max(0.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--world-proxies" && i + 1 < argc) worldProxyDistance = std::max(0.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--world-cache" && i + 1 < argc) worldCacheDirectory = argv[++i];
+        if (std::string(argv[i]) == "--prefetch" && i + 1 < argc) prefetchSeconds = std::max(0.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--prefetch-chunks" && i + 1 < argc) prefetchChunks = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--gpu-trees" && i + 1 < argc) gpuTreeCount = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--view-distance" && i + 1 < argc) viewDistance = std::max(0.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--fog-height" && i + 1 < argc) {
+            sscanf(argv[++i], "%f,%f", &fogBaseHeight, &fogHeightFalloff);
+        }
+        if (std::string(argv[i]) == "--falling-leaves" && i + 1 < argc) fallingLeafCount = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--terrain-extent" && i + 1 < argc) terrainExtent = std::max(1.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--terrain-height" && i + 1 < argc) terrainHeight = atof(argv[++i]);
+        if (std::string(argv[i]) == "--grass" && i + 1 < argc) grassDensity = std::max(0.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--grass-radius" && i + 1 < argc) grassRadius = atof(argv[++i]);
+        if (std::string(argv[i]) == "--wind" && i + 1 < argc) windStrength = std::max(0.0f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--season" && i + 1 < argc) seasonStart = (float)fmod(fabs(atof(argv[++i])), 1.0);
+        if (std::string(argv[i]) == "--year-seconds" && i + 1 < argc) yearSeconds = atof(argv[++i]);
+        if (std::string(argv[i]) == "--no-shadows") shadowsEnabled = false;
+        if (std::string(argv[i]) == "--no-sim-thread") simulationThreaded = false;
+        if (std::string(argv[i]) == "--stream-buffers") streamBuffers = true;
+        if (std::string(argv[i]) == "--shadow-size" && i + 1 < argc) shadowMapSize = std::max(16, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--shadow-intervals" && i + 1 < argc) {
+            sscanf(argv[++i], "%d,%d,%d,%d", &shadowIntervals[0], &shadowIntervals[1], &shadowIntervals[2],
+                   &shadowIntervals[3]);
+        }
+        if (std::string(argv[i]) == "--occlusion-culling") occlusionCulling = forestGpuCulling = true;
+        if (std::string(argv[i]) == "--leaf-cards") leafCardsEnabled = treeLodEnabled = true;
+        if (std::string(argv[i]) == "--leaf-thinning" && i + 1 < argc) {
+            leafThinning.z = 0.3f;
+            sscanf(argv[++i], "%f,%f,%f", &leafThinning.x, &leafThinning.y, &leafThinning.z);
+            leafThinning.y = std::max(leafThinning.y, leafThinning.x);
+            leafThinning.z = glm::clamp(leafThinning.z, 0.01f, 1.0f);
+        }
+        if (std::string(argv[i]) == "--impostors" && i + 1 < argc) impostorCount = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--impostor-distance" && i + 1 < argc) impostorDistance = atof(argv[++i]);
+        if (std::string(argv[i]) == "--lod-bias" && i + 1 < argc) treeLodBias = std::max(0.01f, (float)atof(argv[++i]));
+        if (std::string(argv[i]) == "--on-demand") onDemandRendering = true;
+        if (std::string(argv[i]) == "--idle-hz" && i + 1 < argc) idleRedrawRate = atof(argv[++i]);
+        if (std::string(argv[i]) == "--fps-cap" && i + 1 < argc) focusedFrameRate = atof(argv[++i]);
+        if (std::string(argv[i]) == "--background-fps" && i + 1 < argc) backgroundFrameRate = atof(argv[++i]);
+        if (std::string(argv[i]) == "--draw-minimized") drawMinimized = true;
+        if (std::string(argv[i]) == "--serial-startup") serialStartup = true;
+        if (std::string(argv[i]) == "--stereo" && i + 1 < argc) {
+            stereoRendering = true;
+            stereoSeparation = std::max(0.0f, (float)atof(argv[++i]));
+        }
+        if (std::string(argv[i]) == "--view" && i + 1 < argc) {
+            std::string error;
+            if (!viewSet.add(argv[++i], error)) LOG_ERROR(App) << "Cannot add the view: " << error;
+        }
+        if (std::string(argv[i]) == "--anisotropy" && i + 1 < argc) textureAnisotropy = atof(argv[++i]);
+        if (std::string(argv[i]) == "--bindless") bindlessMaterials = true;
+        if (std::string(argv[i]) == "--no-dsa") directStateAccess = false;
+        if (std::string(argv[i]) == "--texture-budget" && i + 1 < argc) {
+            textureBudgetMB = std::max(0.0f, (float)atof(argv[++i]));
+        }
+        if (std::string(argv[i]) == "--texture-cache" && i + 1 < argc) textureCacheDirectory = argv[++i];
+        if (std::string(argv[i]) == "--gpu-memory-budget" && i + 1 < argc) {
+            const std::string budget = argv[++i];
+            gpuBudgetFromDevice = budget == "auto";
+            gpuBudgetMB = std::max(0.0f, (float)atof(budget.c_str()));
+        }
+        if (std::string(argv[i]) == "--record" && i + 1 < argc) {
+            recordPrefix = argv[++i];
+            recordFromStart = true;
+        }
+        if (std::string(argv[i]) == "--no-profile") Profiler::setEnabled(false);
+        if (std::string(argv[i]) == "--hud") hudVisible = true;
+        if (std::string(argv[i]) == "--alloc-check" && i + 1 < argc) allocCheckWarmup = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--bench" && i + 1 < argc) benchFrames = std::max(0, atoi(argv[++i]));
+        if (std::string(argv[i]) == "--bench-output" && i + 1 < argc) benchOutputFile = argv[++i];
+        benchBaseline.parse(argc, argv, i);
+        if (std::string(argv[i]) == "--camera-path" && i + 1 < argc) {
+            cameraPathFile = argv[++i];
+            std::string error;
+            if (!cameraPath.load(cameraPathFile, error)) {
+                LOG_ERROR(App) << "Cannot load camera path " << cameraPathFile << ": " << error;
+            }
+        }
+        if (std::string(argv[i]) == "--seed" && i + 1 < argc) firstTreeSeed = std::max(0LL, atoll(argv[++i]));
+        if (std::string(argv[i]) == "--headless" && i + 1 < argc) headlessJobsFile = argv[++i];
+        if (std::string(argv[i]) == "--size" && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &offscreenWidth, &offscreenHeight);
+            offscreenWidth = std::max(1, offscreenWidth);
+            offscreenHeight = std::max(1, offscreenHeight);
+        }
+        if (std::string(argv[i]) == "--log-mute" && i + 1 < argc && !Log::muteCategories(argv[++i])) {
+            LOG_ERROR(App) << "Unknown log category in " << argv[i]
+                           << " (app, tree, render, shader, texture, capture)";
+        }
+        if (std::string(argv[i]) == "--sync-log") Log::setSynchronous(true);
+    }
+    if (verbosity >= 2) Log::setLevel(LogLevel::Debug);
+    // Before any shader or texture is read. Only an explicit --bundle that
+    // can't be opened is worth a warning: most trees have none
+    if (useResourceBundle && !watchShaders) {
+        const bool explicitBundle = !resourceBundleFile.empty();
+        if (!explicitBundle) resourceBundleFile = ResourceBundle::besideExecutable(argv[0], "tree_demo.res");
+        std::string error;
+        if (ResourceBundle::shared().open(resourceBundleFile, error)) {
+            LOG_INFO(App) << "Loading " << ResourceBundle::shared().getCount() << " resources from "
+                          << resourceBundleFile;
+        } else if (explicitBundle) {
+            LOG_WARNING(App) << "Reading the resource files instead: " << error;
+        }
+    }
+    // Instanced leaves are drawn whole at every level, so cards would only
+    // add to them
+    if (leafCardsEnabled && instancedLeaves) {
+        LOG_WARNING(Render) << "Leaf cards need the leaf mesh; off with --instanced-leaves";
+        leafCardsEnabled = false;
+    }
+    if (leafCardsEnabled) treeLod.setCardLevel(2);
+    // The sky pass draws one view
+    if (skyEnabled && stereoRendering) {
+        LOG_WARNING(Render) << "The sky needs one view; off with --stereo";
+        skyEnabled = false;
+    }
+    if (viewSet.isMultiple() && stereoRendering) {
+        LOG_WARNING(Render) << "Stereo fills the window with its eyes; --view is off";
+        viewSet.clear();
+    }
+    // Both cull for one eye: the meshlets' normal cones and the pyramid of
+    // the first view's depth would drop what the others see
+    if (viewSet.isMultiple() && (meshletCulling || occlusionCulling)) {
+        LOG_WARNING(Render) << "Several views cull together; meshlet and occlusion culling are off";
+        meshletCulling = occlusionCulling = false;
+    }
+    // The fog closes at the far plane: nothing past it is drawn, grown or
+    // kept streamed in
+    if (viewDistance > 0.0f) {
+        viewDistance = std::max(viewDistance, 2.0f * camera.getNearPlane());
+        distanceFog.configure(viewDistance, fogHeightFalloff, fogBaseHeight, SKY_COLOR);
+        camera.setProjection(camera.getFieldOfView(), camera.getNearPlane(), viewDistance);
+        grassRadius = std::min(grassRadius, viewDistance);
+        if (worldRadius > 0.0f) worldRadius = std::min(worldRadius, viewDistance);
+    }
+    if (benchFrames > 0) {
+        if (firstTreeSeed < 0) firstTreeSeed = 1;
+        if (cameraPath.empty()) cameraPath = CameraPath::orbit();
+        onDemandRendering = false; // Every frame is drawn and timed
+        fixedClock = true;
+    }
+    const bool headless = !headlessJobsFile.empty();
+    if (headless) {
+        std::string error;
+        if (!loadHeadlessJobs(headlessJobsFile, error)) {
+            fprintf(stderr, "Cannot load %s: %s\n", headlessJobsFile.c_str(), error.c_str());
+            exit(EXIT_FAILURE);
+        }
+        firstTreeSeed = headlessJobs[0].seed;
+        onDemandRendering = false;
+        fixedClock = true;
+    }
+    loadTreeGrammar(species, grammarFile);
+    if (!profileFile.empty()) {
+        std::string error;
+        if (!treeProfiles.load(profileFile, error)) LOG_ERROR(Tree) << "Cannot load profiles: " << error;
+    }
+    
     glfwSetErrorCallback(error_callback);
     
     if (!glfwInit()) {
@@ -428,6 +3942,10 @@ int main(void) {
         exit(EXIT_FAILURE);
     }
     
+    // Headless and dynamic resolution frames multisample in the offscreen
+    // target instead
+    if (msaaSamples > 0 && !headless && !dynamicResolutionOn) glfwWindowHint(GLFW_SAMPLES, msaaSamples);
+    if (headless) glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
     window = glfwCreateWindow(800, 600, "Tree Generation Demo", NULL, NULL);
     
     if (!window) {
@@ -438,26 +3956,118 @@ int main(void) {
     
     glfwMakeContextCurrent(window);
     
-    glfwSwapInterval(1);
+    // Bench and headless frames go as fast as they render, unless --vsync
+    glfwSwapInterval(swapInterval >= 0 ? swapInterval : benchFrames > 0 || headless ? 0 : 1);
     
     if (glewInit() != GLEW_OK) {
         fprintf(stderr, "Can't initialize GLEW.\n");
         exit(EXIT_FAILURE);
     }
+    GlDsa::init(directStateAccess);
+    GlDsa::setStateCache(&glState);
+    LOG_DEBUG(Render) << "Direct state access " << (GlDsa::isEnabled() ? "on" : "off");
     
+    if (branchTubes && !GLEW_VERSION_4_0 && !GLEW_ARB_tessellation_shader) {
+        LOG_WARNING(Render) << "Branch tubes need OpenGL 4.0; the geometry shader expands the branch lines";
+        branchTubes = false;
+        branchLines = true;
+    }
+    if (bindlessMaterials && !BindlessTextures::isSupported()) {
+        LOG_WARNING(Render) << "Bindless material textures need ARB_bindless_texture; using the texture array";
+        bindlessMaterials = false;
+    }
+    if (textureBudgetMB > 0.0f && !bindlessMaterials) {
+        LOG_WARNING(Texture) << "Texture streaming needs --bindless; the textures stay whole";
+        textureBudgetMB = 0.0f;
+    }
+    if (framesInFlight > 0) {
+        if (FramePacer::isSupported()) {
+            framePacer.create(framesInFlight);
+        } else {
+            LOG_WARNING(Render) << "Frame pacing needs OpenGL 3.2 or ARB_sync; off";
+        }
+    }
+    if (streamBuffers && !StreamBuffer::isSupported()) {
+        LOG_WARNING(Render) << "Stream buffers need OpenGL 4.4 or ARB_buffer_storage; off";
+        streamBuffers = false;
+    }
+    if (stereoRendering && (forestGpuCulling || meshletCulling || gpuTreeCount > 0 || fallingLeafCount > 0 ||
+                            branchLines || branchTubes || usingImpostors())) {
+        LOG_WARNING(Render) << "Stereo draws every view of a draw itself: GPU culling, meshlets, GPU trees, falling"
+                            << " leaves, branch lines and impostors are off";
+        forestGpuCulling = occlusionCulling = meshletCulling = branchLines = branchTubes = false;
+        gpuTreeCount = fallingLeafCount = 0;
+        impostorCount = 0;
+        impostorDistance = 0.0f;
+    }
+    // Bench and headless frames are of the whole scene from the first
+    if (benchFrames > 0 || headless) serialStartup = true;
     initOpenGLProgram(window);
+    if (GpuProfiler::isSupported()) {
+        gpuProfiler.create();
+    } else {
+        LOG_WARNING(Render) << "GPU pass timing needs OpenGL 3.3 or ARB_timer_query; off";
+    }
+    if (headless) {
+        if (!offscreenTarget.create(offscreenWidth, offscreenHeight, msaaSamples)) {
+            fprintf(stderr, "Can't create a %dx%d offscreen target with %d samples.\n", offscreenWidth,
+                    offscreenHeight, msaaSamples);
+            exit(EXIT_FAILURE);
+        }
+        camera.setAspectRatio(offscreenWidth / (float)(offscreenHeight * viewColumns()));
+    }
+    if (dynamicResolutionOn && (headless || !gpuProfiler.isCreated())) {
+        LOG_WARNING(Render) << "Dynamic resolution needs GPU pass timing and a window; off";
+        dynamicResolutionOn = false;
+    }
+    if (dynamicResolutionOn) {
+        if (gpuBudgetMilliseconds <= 0.0f) {
+            const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+            gpuBudgetMilliseconds = mode && mode->refreshRate > 0 ? 900.0f / mode->refreshRate : 15.0f;
+        }
+        dynamicResolution.configure(dynamicMinScale, dynamicMaxScale, gpuBudgetMilliseconds);
+        LOG_INFO(Render) << "Dynamic resolution " << dynamicMinScale << " to " << dynamicMaxScale << ", "
+                         << gpuBudgetMilliseconds << " ms GPU budget";
+    }
+    simulation.start(simulationThreaded);
     
     glfwSetTime(0);
-    lastTime = glfwGetTime();  // Initialize lastTime
+    lastTime = sceneClock();  // Initialize lastTime
+    if (recordFromStart) frameCapture.startRecording(recordPrefix);
+    
+    if (benchFrames > 0) {
+        // Every run starts from the whole first tree
+        if (treeJob.isPending()) installTree();
+        runBenchmark(window);
+        glfwSetWindowShouldClose(window, GL_TRUE);
+    }
+    if (headless) {
+        runHeadless(window);
+        glfwSetWindowShouldClose(window, GL_TRUE);
+    }
     
     // Main loop
     while (!glfwWindowShouldClose(window)) {
-        drawScene(window, glfwGetTime());
-        glfwPollEvents();
+        if (!startupFinished && !continueStartup(window)) continue;
+        if (!frameLimiter.isPaused()) waitForFrameSlot(window);
+        if (frameLimiter.isPaused()) {
+            simulateMinimized();
+            continue;
+        }
+        if (glfwWindowShouldClose(window)) break;
+        frameLimiter.frameStarted(glfwGetTime());
+        drawScene(window, sceneClock());
+        bool idle = sceneIsIdle();
+        if (idle) compactTreeSlots();
+        if (onDemandRendering && idle) {
+            waitForNextFrame();
+        } else {
+            glfwPollEvents();
+        }
     }
     
     freeOpenGLProgram(window);
     glfwDestroyWindow(window);
     glfwTerminate();
-    exit(EXIT_SUCCESS);
+    exit(exitStatus);
 }
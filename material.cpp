@@ -0,0 +1,32 @@
+#include "material.h"
+#include "gl_state.h"
+
+int MaterialLibrary::add(ShaderProgram* program, int layer, float mix_ratio, float ambient,
+                         ShaderProgram* depth_program) {
+    Material material;
+    material.program = program;
+    material.depth_program = depth_program;
+    material.layer = layer;
+    material.mix_ratio = mix_ratio;
+    material.ambient = ambient;
+    material.shininess = DEFAULT_SHININESS;
+    materials.push_back(material);
+    return materials.size() - 1;
+}
+
+void MaterialLibrary::apply(int id, GlStateCache& state) const {
+    const Material& material = materials[id];
+    state.useProgram(material.program);
+    if (texture_array != 0) state.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, texture_array);
+    state.uniform1f("materialLayer", (float)material.layer);
+    state.uniform1f("materialMix", material.mix_ratio);
+    state.uniform1f("materialAmbient", material.ambient);
+    state.uniform1f("materialShininess", material.shininess);
+}
+
+void MaterialLibrary::applyDepth(int id, GlStateCache& state) const {
+    const Material& material = materials[id];
+    state.useProgram(material.depth_program);
+    if (texture_array != 0) state.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, texture_array);
+    state.uniform1f("materialLayer", (float)material.layer);
+}
@@ -0,0 +1,62 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <GL/glew.h>
+#include <vector>
+
+class GlStateCache;
+class ShaderProgram;
+
+// A material's exponent unless set: the half-vector highlight about as wide
+// as a reflection-vector one of exponent 25
+const float DEFAULT_SHININESS = 100.0f;
+
+// How a surface is shaded: the program variant (an emissive one for the sun,
+// a two-sided one for leaves) and its parameters. Its texture is a layer of
+// the library's texture array, sampled twice, at the mesh texcoords and at coordinates derived from the normal,
+// and the two are blended by mix_ratio for variation
+struct Material {
+    ShaderProgram* program;
+    ShaderProgram* depth_program; // Depth prepass program, nullptr = not prepassed
+    int layer;       // Layer of the texture array
+    float mix_ratio; // Share of the normal-derived lookup, 0 = texcoords only (one texture fetch)
+    float ambient;   // Ambient light as a fraction of the diffuse colour
+    float shininess; // Blinn-Phong exponent of the highlight, 0 = none (no specular term)
+};
+
+// The scene's materials, referred to by index. apply() sets a material's
+// program, layer and uniforms through the state cache, so switching
+// between draws of one material costs nothing. All materials share one
+// GL_TEXTURE_2D_ARRAY (texture_array.h) on one unit: the bind happens once
+// and a material change only sets the materialLayer uniform
+class MaterialLibrary {
+private:
+    std::vector<Material> materials;
+    GLuint texture_array;
+
+public:
+    static const int TEXTURE_UNIT = 0; // The materialTexture sampler's unit
+    
+    MaterialLibrary() : texture_array(0) {}
+    
+    // The array the materials' layers index; the library doesn't own it.
+    // 0 when the programs sample by handle (BindlessTextures): nothing is
+    // bound, and the layer picks the handle
+    void setTextureArray(GLuint texture) { texture_array = texture; }
+    GLuint getTextureArray() const { return texture_array; }
+    
+    int add(ShaderProgram* program, int layer, float mix_ratio, float ambient,
+            ShaderProgram* depth_program = nullptr);
+    const Material& get(int id) const { return materials[id]; }
+    void setShininess(int id, float shininess) { materials[id].shininess = shininess; }
+    void setMixRatio(int id, float mix_ratio) { materials[id].mix_ratio = mix_ratio; }
+    int getCount() const { return materials.size(); }
+    
+    // Put material id's program in use and set its parameters
+    void apply(int id, GlStateCache& state) const;
+    // Put material id's depth program in use, with the layer its alpha
+    // test reads
+    void applyDepth(int id, GlStateCache& state) const;
+};
+
+#endif // MATERIAL_H
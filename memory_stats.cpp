@@ -0,0 +1,202 @@
+#include "memory_stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+std::atomic<uint64_t> MemoryStats::scratch_bytes(0);
+std::atomic<uint64_t> MemoryStats::scratch_peak(0);
+
+struct MemoryRecord {
+    size_t bytes;
+    const char* owner;
+};
+
+// Render thread only, as the GL calls they follow. Renderbuffers share the
+// texture records, above the 32-bit names
+typedef std::unordered_map<uint64_t, MemoryRecord> MemoryRecords;
+static const uint64_t RENDERBUFFER_KEY = 1ull << 32;
+static MemoryRecords buffer_records;
+static MemoryRecords texture_records;
+static uint64_t buffer_bytes = 0;
+static uint64_t texture_bytes = 0;
+static MemoryStats::Usage sampled[MemoryStats::CATEGORIES] = {};
+
+static void track(MemoryRecords& records, uint64_t& total, GLuint name, uint64_t key, size_t bytes,
+                  const char* owner) {
+    if (name == 0) return;
+    MemoryRecord& record = records[key | name];
+    // A new record is zeroed
+    total = total - record.bytes + bytes;
+    record.bytes = bytes;
+    record.owner = owner;
+}
+
+static void forget(MemoryRecords& records, uint64_t& total, uint64_t key, GLsizei count, const GLuint* names) {
+    for (GLsizei k = 0; k < count; k++) {
+        MemoryRecords::iterator found = records.find(key | names[k]);
+        if (found == records.end()) continue;
+        total -= found->second.bytes;
+        records.erase(found);
+    }
+}
+
+void MemoryStats::trackBuffer(GLuint buffer, size_t bytes, const char* owner) {
+    track(buffer_records, buffer_bytes, buffer, 0, bytes, owner);
+}
+
+void MemoryStats::trackTexture(GLuint texture, size_t bytes, const char* owner) {
+    track(texture_records, texture_bytes, texture, 0, bytes, owner);
+}
+
+void MemoryStats::trackRenderbuffer(GLuint renderbuffer, size_t bytes, const char* owner) {
+    track(texture_records, texture_bytes, renderbuffer, RENDERBUFFER_KEY, bytes, owner);
+}
+
+void MemoryStats::forgetBuffers(GLsizei count, const GLuint* buffers) {
+    forget(buffer_records, buffer_bytes, 0, count, buffers);
+}
+
+void MemoryStats::forgetTextures(GLsizei count, const GLuint* textures) {
+    forget(texture_records, texture_bytes, 0, count, textures);
+}
+
+void MemoryStats::forgetRenderbuffers(GLsizei count, const GLuint* renderbuffers) {
+    forget(texture_records, texture_bytes, RENDERBUFFER_KEY, count, renderbuffers);
+}
+
+// Bytes of a 4x4 block of the compressed formats, 0 for the others
+static size_t blockBytes(GLenum format) {
+    switch (format) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+// Bytes per texel of the uncompressed formats the demo allocates; 4 for
+// the rest
+static size_t texelBytes(GLenum format) {
+    switch (format) {
+    case GL_R8:
+        return 1;
+    case GL_RG8:
+    case GL_R16F:
+        return 2;
+    case GL_RGBA16F:
+    case GL_RG32F:
+        return 8;
+    case GL_RGBA32F:
+        return 16;
+    default:
+        return 4; // RGBA8, R32F, RG16F and the 24- and 32-bit depth formats
+    }
+}
+
+size_t MemoryStats::textureBytes(GLenum internal_format, int width, int height, int depth, int levels) {
+    if (levels <= 0) {
+        levels = 1;
+        while ((std::max(width, height) >> levels) > 0) {
+            levels++;
+        }
+    }
+    const size_t block = blockBytes(internal_format);
+    size_t bytes = 0;
+    for (int level = 0; level < levels; level++) {
+        size_t w = std::max(width >> level, 1);
+        size_t h = std::max(height >> level, 1);
+        bytes += block ? ((w + 3) / 4) * ((h + 3) / 4) * block : w * h * texelBytes(internal_format);
+    }
+    return bytes * std::max(depth, 1);
+}
+
+void MemoryStats::addScratch(size_t bytes) {
+    uint64_t held = scratch_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    uint64_t peak = scratch_peak.load(std::memory_order_relaxed);
+    while (held > peak && !scratch_peak.compare_exchange_weak(peak, held, std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryStats::removeScratch(size_t bytes) {
+    scratch_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void MemoryStats::setUsage(Category category, size_t bytes, size_t capacity) {
+    sampled[category].bytes = bytes;
+    sampled[category].capacity = std::max(bytes, capacity);
+}
+
+MemoryStats::Usage MemoryStats::getUsage(Category category) {
+    Usage usage = sampled[category];
+    if (category == IMAGE_SCRATCH) {
+        usage.bytes = scratch_bytes.load(std::memory_order_relaxed);
+        usage.capacity = usage.bytes;
+    } else if (category == TEXTURES) {
+        usage.bytes = usage.capacity = texture_bytes;
+    } else if (category == GL_BUFFERS) {
+        usage.bytes = usage.capacity = buffer_bytes;
+    }
+    return usage;
+}
+
+const char* MemoryStats::getCategoryName(Category category) {
+    static const char* names[CATEGORIES] = { "tree topology", "tree vertices", "image scratch", "textures",
+                                             "GL buffers", "world chunks" };
+    return names[category];
+}
+
+// === REPORT ===
+
+static void printOwners(std::ostream& os, const MemoryRecords& records) {
+    // Owners by name, so the same literal from two files is one owner
+    std::unordered_map<std::string, std::pair<uint64_t, int>> owners;
+    for (const std::pair<const uint64_t, MemoryRecord>& record : records) {
+        std::pair<uint64_t, int>& owner = owners[record.second.owner ? record.second.owner : "?"];
+        owner.first += record.second.bytes;
+        owner.second++;
+    }
+    std::vector<std::pair<std::string, std::pair<uint64_t, int>>> sorted(owners.begin(), owners.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<std::string, std::pair<uint64_t, int>>& a,
+                 const std::pair<std::string, std::pair<uint64_t, int>>& b) {
+                  return a.second.first > b.second.first;
+              });
+    char line[128];
+    for (const std::pair<std::string, std::pair<uint64_t, int>>& owner : sorted) {
+        snprintf(line, sizeof(line), "    %-22s %10.2f MB in %d", owner.first.c_str(),
+                 owner.second.first / (1024.0 * 1024.0), owner.second.second);
+        os << line << std::endl;
+    }
+}
+
+void MemoryStats::printReport(std::ostream& os) {
+    os << "Memory:" << std::endl;
+    char line[128];
+    for (int c = 0; c < CATEGORIES; c++) {
+        Usage usage = getUsage((Category)c);
+        snprintf(line, sizeof(line), "  %-24s %10.2f MB", getCategoryName((Category)c),
+                 usage.bytes / (1024.0 * 1024.0));
+        os << line;
+        if (usage.capacity > usage.bytes) {
+            snprintf(line, sizeof(line), " (%.2f MB reserved)", usage.capacity / (1024.0 * 1024.0));
+            os << line;
+        }
+        if (c == IMAGE_SCRATCH) {
+            snprintf(line, sizeof(line), " (peak %.2f MB)", getScratchPeak() / (1024.0 * 1024.0));
+            os << line;
+        }
+        os << std::endl;
+        if (c == TEXTURES) printOwners(os, texture_records);
+        if (c == GL_BUFFERS) printOwners(os, buffer_records);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <GL/glew.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Bytes held per subsystem, for capacity planning. GL buffers and textures
+// are recorded as they are allocated and deleted, each under its owner's
+// name, so the report breaks them down; texture sizes are computed from
+// their formats and mip chains, as the GL doesn't tell. The image scratch
+// is counted while the decoders and encoders hold it, with its peak. The
+// tree categories are the arrays' sizes and capacities as the caller last
+// sampled them (Tree::getMemoryUsage), the world chunks the instances a
+// WorldStream holds resident.
+//
+// The GL records are render thread only; the scratch counter is atomic,
+// as images decode and encode on workers. Owner names are kept as
+// pointers, as the profiler's are
+class MemoryStats {
+public:
+    enum Category { TREE_TOPOLOGY, TREE_VERTICES, IMAGE_SCRATCH, TEXTURES, GL_BUFFERS, WORLD_CHUNKS, CATEGORIES };
+    
+    struct Usage {
+        uint64_t bytes;
+        uint64_t capacity; // Reserved, bytes or more; the same as bytes where nothing is reserved ahead
+    };
+    
+    // === GL RESOURCES ===
+    // A buffer's or texture's storage is (re)allocated; replaces its last record
+    static void trackBuffer(GLuint buffer, size_t bytes, const char* owner);
+    static void trackTexture(GLuint texture, size_t bytes, const char* owner);
+    static void trackRenderbuffer(GLuint renderbuffer, size_t bytes, const char* owner); // Counted with the textures
+    // Names being deleted; untracked ones are ignored
+    static void forgetBuffers(GLsizei count, const GLuint* buffers);
+    static void forgetTextures(GLsizei count, const GLuint* textures);
+    static void forgetRenderbuffers(GLsizei count, const GLuint* renderbuffers);
+    // Bytes of levels mip levels (0 = the full chain) of a width x height x
+    // depth image in internal_format; cube maps pass their 6 faces as depth
+    static size_t textureBytes(GLenum internal_format, int width, int height, int depth = 1, int levels = 1);
+    
+    // === IMAGE SCRATCH ===
+    static void addScratch(size_t bytes);
+    static void removeScratch(size_t bytes);
+    
+    // === SAMPLED ===
+    static void setUsage(Category category, size_t bytes, size_t capacity);
+    
+    static Usage getUsage(Category category);
+    static uint64_t getScratchPeak() { return scratch_peak.load(std::memory_order_relaxed); }
+    static const char* getCategoryName(Category category);
+    // Every category, and the GL ones by owner, largest first
+    static void printReport(std::ostream& os);
+
+private:
+    static std::atomic<uint64_t> scratch_bytes;
+    static std::atomic<uint64_t> scratch_peak;
+};
+
+// Counts bytes of image scratch for its lifetime
+class ScratchMemory {
+public:
+    explicit ScratchMemory(size_t scratch_bytes = 0) : bytes(0) { resize(scratch_bytes); }
+    ~ScratchMemory() { resize(0); }
+    
+    void resize(size_t new_bytes) {
+        if (new_bytes > bytes) MemoryStats::addScratch(new_bytes - bytes);
+        else if (new_bytes < bytes) MemoryStats::removeScratch(bytes - new_bytes);
+        bytes = new_bytes;
+    }
+
+private:
+    size_t bytes;
+    
+    ScratchMemory(const ScratchMemory&);
+    ScratchMemory& operator=(const ScratchMemory&);
+};
+
+#endif // MEMORY_STATS_H
@@ -0,0 +1,249 @@
+#include "mesh_codec.h"
+#include "job_system.h"
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+static const char MESH_STREAM_MAGIC[4] = {'M', 'S', 'H', '1'};
+// Values a block holds: indices, and vertices (times the stride)
+static const uint32_t INDEX_BLOCK_VALUES = 16384;
+static const uint32_t VERTEX_BLOCK_VERTICES = 1024;
+// Quantized components stay within this, so their differences can't wrap
+// further than the decoder's own arithmetic undoes
+static const float QUANTIZED_LIMIT = 1073741824.0f;
+
+// Followed by stride float steps, block_count uint64_t block ends (bytes
+// into the payload) and the payload; read with memcpy, as nothing after
+// the header is aligned
+struct MeshStreamHeader {
+    char magic[4];        // MESH_STREAM_MAGIC
+    uint32_t stride;      // Components per vertex; 0 for an index stream
+    uint64_t value_count; // 32-bit values decoded
+    uint32_t block_values;
+    uint32_t block_count;
+};
+
+// === VARINTS ===
+
+static uint32_t zigzag(uint32_t difference) {
+    return (difference << 1) ^ (uint32_t)((int32_t)difference >> 31);
+}
+
+static uint32_t unzigzag(uint32_t value) {
+    return (value >> 1) ^ (0u - (value & 1u));
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80u) {
+        out.push_back((uint8_t)(value | 0x80u));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& value) {
+    // Most differences are one byte
+    if (p < end && *p < 0x80u) {
+        value = *p++;
+        return true;
+    }
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end) return false;
+        const uint8_t byte = *p++;
+        value |= (uint32_t)(byte & 0x7fu) << shift;
+        if (byte < 0x80u) return true;
+    }
+    return false;
+}
+
+static uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// === ENCODING ===
+
+// Header, steps and a zeroed block table; the caller fills the table in as
+// it appends the blocks
+static size_t beginStream(std::vector<uint8_t>& out, uint32_t stride, uint64_t value_count, uint32_t block_values,
+                          const float* steps) {
+    MeshStreamHeader header;
+    memcpy(header.magic, MESH_STREAM_MAGIC, sizeof(header.magic));
+    header.stride = stride;
+    header.value_count = value_count;
+    header.block_values = block_values;
+    header.block_count = (uint32_t)((value_count + block_values - 1) / block_values);
+    const size_t table = sizeof(header) + stride * sizeof(float);
+    out.assign(table + header.block_count * sizeof(uint64_t), 0);
+    memcpy(out.data(), &header, sizeof(header));
+    if (stride > 0) memcpy(out.data() + sizeof(header), steps, stride * sizeof(float));
+    return table;
+}
+
+static void endBlock(std::vector<uint8_t>& out, size_t table, size_t payload, uint32_t block) {
+    const uint64_t end = out.size() - payload;
+    memcpy(out.data() + table + block * sizeof(uint64_t), &end, sizeof(end));
+}
+
+void encodeMeshIndices(const uint32_t* indices, size_t count, std::vector<uint8_t>& out) {
+    const size_t table = beginStream(out, 0, count, INDEX_BLOCK_VALUES, nullptr);
+    const size_t payload = out.size();
+    out.reserve(payload + count + count / 4);
+    uint32_t block = 0;
+    for (size_t first = 0; first < count; first += INDEX_BLOCK_VALUES, block++) {
+        const size_t last = std::min(count, first + INDEX_BLOCK_VALUES);
+        uint32_t previous = 0;
+        for (size_t i = first; i < last; i++) {
+            putVarint(out, zigzag(indices[i] - previous));
+            previous = indices[i];
+        }
+        endBlock(out, table, payload, block);
+    }
+}
+
+void encodeMeshVertices(const float* vertices, size_t vertex_count, int stride, const float* steps,
+                        std::vector<uint8_t>& out) {
+    // === STEPS: EXACT FOR A COMPONENT THAT WOULDN'T QUANTIZE ===
+    float used[MESH_CODEC_MAX_STRIDE];
+    for (int c = 0; c < stride; c++) {
+        used[c] = steps[c] > 0.0f ? steps[c] : 0.0f;
+        for (size_t v = 0; v < vertex_count && used[c] > 0.0f; v++) {
+            const float scaled = vertices[v * stride + c] / used[c];
+            if (!(std::fabs(scaled) < QUANTIZED_LIMIT)) used[c] = 0.0f;
+        }
+    }
+    
+    // === BLOCKS ===
+    const size_t table = beginStream(out, stride, vertex_count * stride, VERTEX_BLOCK_VERTICES * stride, used);
+    const size_t payload = out.size();
+    out.reserve(payload + vertex_count * stride * 2);
+    uint32_t previous[MESH_CODEC_MAX_STRIDE];
+    uint32_t block = 0;
+    for (size_t first = 0; first < vertex_count; first += VERTEX_BLOCK_VERTICES, block++) {
+        const size_t last = std::min(vertex_count, first + VERTEX_BLOCK_VERTICES);
+        memset(previous, 0, sizeof(previous));
+        for (size_t v = first; v < last; v++) {
+            const float* vertex = &vertices[v * stride];
+            for (int c = 0; c < stride; c++) {
+                if (used[c] > 0.0f) {
+                    const uint32_t q = (uint32_t)(int32_t)std::lrint(vertex[c] / used[c]);
+                    putVarint(out, zigzag(q - previous[c]));
+                    previous[c] = q;
+                } else {
+                    // Exact: the bits that differ from the last vertex's
+                    const uint32_t bits = floatBits(vertex[c]);
+                    putVarint(out, bits ^ previous[c]);
+                    previous[c] = bits;
+                }
+            }
+        }
+        endBlock(out, table, payload, block);
+    }
+}
+
+// === DECODING ===
+
+// What decoding needs from a stream, read and checked once
+struct MeshStreamLayout {
+    MeshStreamHeader header;
+    float steps[MESH_CODEC_MAX_STRIDE];
+    const uint8_t* table;
+    const uint8_t* payload;
+    uint64_t payload_bytes;
+    
+    uint64_t blockEnd(uint32_t block) const {
+        uint64_t end;
+        memcpy(&end, table + block * sizeof(uint64_t), sizeof(end));
+        return end;
+    }
+};
+
+static bool readLayout(const void* stream, size_t bytes, MeshStreamLayout& layout) {
+    const uint8_t* data = static_cast<const uint8_t*>(stream);
+    MeshStreamHeader& header = layout.header;
+    if (!data || bytes < sizeof(header)) return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, MESH_STREAM_MAGIC, sizeof(header.magic)) != 0 || header.stride > MESH_CODEC_MAX_STRIDE ||
+        header.block_values == 0 || (header.stride > 0 && header.block_values % header.stride != 0) ||
+        (header.stride > 0 && header.value_count % header.stride != 0) ||
+        header.block_count != (header.value_count + header.block_values - 1) / header.block_values) {
+        return false;
+    }
+    const size_t steps_bytes = header.stride * sizeof(float);
+    const uint64_t table_bytes = (uint64_t)header.block_count * sizeof(uint64_t);
+    if (bytes - sizeof(header) < steps_bytes || bytes - sizeof(header) - steps_bytes < table_bytes) return false;
+    memcpy(layout.steps, data + sizeof(header), steps_bytes);
+    layout.table = data + sizeof(header) + steps_bytes;
+    layout.payload = layout.table + table_bytes;
+    layout.payload_bytes = bytes - sizeof(header) - steps_bytes - table_bytes;
+    // Every value takes a byte at least, and the blocks run in order
+    if (header.value_count > layout.payload_bytes) return false;
+    uint64_t start = 0;
+    for (uint32_t b = 0; b < header.block_count; b++) {
+        const uint64_t end = layout.blockEnd(b);
+        if (end < start || end > layout.payload_bytes) return false;
+        start = end;
+    }
+    return true;
+}
+
+size_t meshStreamValueCount(const void* stream, size_t bytes) {
+    MeshStreamLayout layout;
+    return readLayout(stream, bytes, layout) ? layout.header.value_count : 0;
+}
+
+// One block into out; it must use up exactly its bytes
+static bool decodeBlock(const MeshStreamLayout& layout, uint32_t block, uint32_t* out) {
+    const MeshStreamHeader& header = layout.header;
+    const uint8_t* p = layout.payload + (block > 0 ? layout.blockEnd(block - 1) : 0);
+    const uint8_t* end = layout.payload + layout.blockEnd(block);
+    const uint64_t first = (uint64_t)block * header.block_values;
+    const uint64_t count = std::min<uint64_t>(header.block_values, header.value_count - first);
+    out += first;
+    uint32_t value;
+    
+    if (header.stride == 0) {
+        uint32_t previous = 0;
+        for (uint64_t i = 0; i < count; i++) {
+            if (!getVarint(p, end, value)) return false;
+            previous += unzigzag(value);
+            out[i] = previous;
+        }
+        return p == end;
+    }
+    
+    const int stride = header.stride;
+    uint32_t previous[MESH_CODEC_MAX_STRIDE];
+    memset(previous, 0, sizeof(previous));
+    for (uint64_t i = 0; i < count; i += stride) {
+        for (int c = 0; c < stride; c++) {
+            if (!getVarint(p, end, value)) return false;
+            if (layout.steps[c] > 0.0f) {
+                previous[c] += unzigzag(value);
+                out[i + c] = floatBits((float)(int32_t)previous[c] * layout.steps[c]);
+            } else {
+                previous[c] ^= value;
+                out[i + c] = previous[c];
+            }
+        }
+    }
+    return p == end;
+}
+
+bool decodeMeshStream(const void* stream, size_t bytes, void* out, size_t value_count) {
+    PROFILE_SCOPE("decodeMeshStream");
+    MeshStreamLayout layout;
+    if (!readLayout(stream, bytes, layout) || layout.header.value_count != value_count) return false;
+    uint32_t* values = static_cast<uint32_t*>(out);
+    std::atomic<bool> intact(true);
+    JobSystem::shared().parallelFor(layout.header.block_count, 1, [&](int, int begin, int end) {
+        for (int b = begin; b < end && intact.load(std::memory_order_relaxed); b++) {
+            if (!decodeBlock(layout, b, values)) intact.store(false, std::memory_order_relaxed);
+        }
+    });
+    return intact.load();
+}
@@ -0,0 +1,43 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compact streams for the prebuilt index and vertex buffers of stored
+// assets (tree_asset.h), several times smaller than the arrays and
+// decoded straight into their destination.
+//
+// Index streams store each index as the zigzagged difference from the one
+// before it. Vertex streams quantize each component on its own step
+// (step 0 keeps it exact) and store the zigzagged difference from the
+// same component of the vertex before. Either way the values go out as
+// little-endian base-128 varints, one to five bytes, so the common small
+// differences cost a byte. The values are cut into blocks that each
+// predict from zero, and a table of block ends lets the job system decode
+// the blocks in parallel.
+//
+// A stream decodes to 32-bit values (uint32_t indices or float
+// components). Decoding writes its output front to back and never reads
+// it back, so the output may be a write-only mapped GPU buffer. A damaged
+// stream is reported, never read past its end.
+
+// Components of a vertex stream at most
+static const int MESH_CODEC_MAX_STRIDE = 64;
+
+// Index buffer into out, replacing its contents
+void encodeMeshIndices(const uint32_t* indices, size_t count, std::vector<uint8_t>& out);
+// Interleaved vertices of stride floats into out, component c rounded to a
+// multiple of steps[c]. A component whose values don't fit the step's
+// integer range is kept exact instead
+void encodeMeshVertices(const float* vertices, size_t vertex_count, int stride, const float* steps,
+                        std::vector<uint8_t>& out);
+
+// 32-bit values the stream decodes to; 0 when its header is damaged
+size_t meshStreamValueCount(const void* stream, size_t bytes);
+// Decode the stream into out, which holds value_count values; false when
+// the count is not the stream's or the stream is damaged
+bool decodeMeshStream(const void* stream, size_t bytes, void* out, size_t value_count);
+
+#endif // MESH_CODEC_H
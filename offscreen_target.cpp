@@ -0,0 +1,100 @@
+#include "offscreen_target.h"
+#include "memory_stats.h"
+#include <algorithm>
+
+OffscreenTarget::OffscreenTarget()
+    : width(0), height(0), samples(0), viewport_width(0), viewport_height(0), framebuffer(0), color_buffer(0),
+      depth_buffer(0), resolve_framebuffer(0), resolve_buffer(0) {}
+
+OffscreenTarget::~OffscreenTarget() {
+    release();
+}
+
+// A renderbuffer of format attached to the bound framebuffer
+static GLuint attachRenderbuffer(GLenum attachment, GLenum format, int samples, int width, int height) {
+    GLuint renderbuffer = 0;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    if (samples > 0) {
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, format, width, height);
+    } else {
+        glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+    }
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer);
+    MemoryStats::trackRenderbuffer(renderbuffer, MemoryStats::textureBytes(format, width, height) * std::max(samples, 1),
+                                   "offscreen target");
+    return renderbuffer;
+}
+
+bool OffscreenTarget::create(int new_width, int new_height, int new_samples) {
+    release();
+    width = std::max(new_width, 1);
+    height = std::max(new_height, 1);
+    samples = std::max(new_samples, 0);
+    viewport_width = width;
+    viewport_height = height;
+    
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    color_buffer = attachRenderbuffer(GL_COLOR_ATTACHMENT0, GL_RGBA8, samples, width, height);
+    depth_buffer = attachRenderbuffer(GL_DEPTH_STENCIL_ATTACHMENT, GL_DEPTH24_STENCIL8, samples, width, height);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete && samples > 0) {
+        glGenFramebuffers(1, &resolve_framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, resolve_framebuffer);
+        resolve_buffer = attachRenderbuffer(GL_COLOR_ATTACHMENT0, GL_RGBA8, 0, width, height);
+        complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+void OffscreenTarget::release() {
+    const GLuint renderbuffers[3] = { color_buffer, depth_buffer, resolve_buffer };
+    MemoryStats::forgetRenderbuffers(3, renderbuffers);
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    if (resolve_framebuffer) glDeleteFramebuffers(1, &resolve_framebuffer);
+    if (color_buffer) glDeleteRenderbuffers(1, &color_buffer);
+    if (depth_buffer) glDeleteRenderbuffers(1, &depth_buffer);
+    if (resolve_buffer) glDeleteRenderbuffers(1, &resolve_buffer);
+    framebuffer = resolve_framebuffer = color_buffer = depth_buffer = resolve_buffer = 0;
+    width = height = samples = viewport_width = viewport_height = 0;
+}
+
+void OffscreenTarget::setViewport(int new_width, int new_height) {
+    viewport_width = std::min(std::max(new_width, 1), width);
+    viewport_height = std::min(std::max(new_height, 1), height);
+}
+
+void OffscreenTarget::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, viewport_width, viewport_height);
+}
+
+void OffscreenTarget::resolve() const {
+    if (!resolve_framebuffer) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        return;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_framebuffer);
+    glBlitFramebuffer(0, 0, viewport_width, viewport_height, 0, 0, viewport_width, viewport_height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolve_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+}
+
+void OffscreenTarget::present(int window_width, int window_height) const {
+    // The read framebuffer is single-sampled after resolve(), so the blit
+    // may scale
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, viewport_width, viewport_height, 0, 0, window_width, window_height,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, window_width, window_height);
+}
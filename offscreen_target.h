@@ -0,0 +1,61 @@
+#ifndef OFFSCREEN_TARGET_H
+#define OFFSCREEN_TARGET_H
+
+#include <GL/glew.h>
+
+// A framebuffer of its own size and sample count to draw the scene into
+// instead of the window's: RGBA8 color and 24-bit depth with 8-bit
+// stencil, the default framebuffer's formats, so the passes that blit from
+// the scene's depth work on either. A multisampled target resolves into a
+// single-sampled copy of the color, which FrameCapture reads back.
+//
+// The scene may take only part of it, the viewport, from the lower left
+// corner: dynamic resolution draws into a target of the largest size and
+// present() stretches the part drawn over the window
+class OffscreenTarget {
+public:
+    OffscreenTarget();
+    ~OffscreenTarget();
+    
+    // width x height pixels, samples per pixel (0 = single); false when the
+    // framebuffer is incomplete, as for more samples than the GL allows
+    bool create(int width, int height, int samples);
+    void release();
+    bool isCreated() const { return framebuffer != 0; }
+    
+    // The part drawn into, clamped to the target; create() sets all of it
+    void setViewport(int viewport_width, int viewport_height);
+    
+    // Bind the target to draw into, with its viewport
+    void bind() const;
+    // Resolve the viewport's samples and bind the result as the read
+    // framebuffer, for glReadPixels
+    void resolve() const;
+    // After resolve(): stretch the viewport over the window's framebuffer,
+    // filtered bilinearly, and leave that bound with its own viewport
+    void present(int window_width, int window_height) const;
+    
+    GLuint getFramebuffer() const { return framebuffer; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getSamples() const { return samples; }
+    int getViewportWidth() const { return viewport_width; }
+    int getViewportHeight() const { return viewport_height; }
+
+private:
+    int width;
+    int height;
+    int samples;
+    int viewport_width;
+    int viewport_height;
+    GLuint framebuffer;         // Drawn into
+    GLuint color_buffer;
+    GLuint depth_buffer;
+    GLuint resolve_framebuffer; // Multisampled targets only: the resolved color
+    GLuint resolve_buffer;
+    
+    OffscreenTarget(const OffscreenTarget&);
+    OffscreenTarget& operator=(const OffscreenTarget&);
+};
+
+#endif // OFFSCREEN_TARGET_H
@@ -0,0 +1,325 @@
+#include "perf_hud.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include "shaderprogram.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// === FONT ===
+// ASCII 32-95, seven rows of five pixels each, the leftmost in bit 4
+static const int FIRST_GLYPH = 32;
+static const int GLYPHS = 64;
+static const int GLYPH_WIDTH = 5;
+static const int GLYPH_HEIGHT = 7;
+static const int CELL = 8;            // Atlas cells are CELL x CELL texels, so its rows stay 4-byte aligned
+static const int SOLID = GLYPHS;      // The atlas cell after the glyphs, all set
+static const int ADVANCE = 6;         // Font pixels from one glyph to the next
+static const int LINE_HEIGHT = 10;
+static const int ATLAS_WIDTH = (GLYPHS + 1) * CELL;
+static const int GRAPH_HEIGHT = 60;   // Font pixels
+static const int PADDING = 4;
+
+static const unsigned char FONT[GLYPHS][GLYPH_HEIGHT] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // '!'
+    { 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '"'
+    { 0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a }, // '#'
+    { 0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04 }, // '$'
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // '%'
+    { 0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d }, // '&'
+    { 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00 }, // "'"
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // '('
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // ')'
+    { 0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00 }, // '*'
+    { 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 }, // '+'
+    { 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 }, // ','
+    { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 }, // '-'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c }, // '.'
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // '/'
+    { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e }, // '0'
+    { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e }, // '1'
+    { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f }, // '2'
+    { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e }, // '3'
+    { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 }, // '4'
+    { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e }, // '5'
+    { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e }, // '6'
+    { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // '7'
+    { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e }, // '8'
+    { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c }, // '9'
+    { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 }, // ':'
+    { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08 }, // ';'
+    { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // '<'
+    { 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 }, // '='
+    { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // '>'
+    { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, // '?'
+    { 0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e }, // '@'
+    { 0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, // 'A'
+    { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e }, // 'B'
+    { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e }, // 'C'
+    { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c }, // 'D'
+    { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f }, // 'E'
+    { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 }, // 'F'
+    { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f }, // 'G'
+    { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, // 'H'
+    { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, // 'I'
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c }, // 'J'
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // 'K'
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f }, // 'L'
+    { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 }, // 'M'
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // 'N'
+    { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // 'O'
+    { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 }, // 'P'
+    { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d }, // 'Q'
+    { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 }, // 'R'
+    { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e }, // 'S'
+    { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // 'T'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // 'U'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 }, // 'V'
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a }, // 'W'
+    { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 }, // 'X'
+    { 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04, 0x04 }, // 'Y'
+    { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f }, // 'Z'
+    { 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e }, // '['
+    { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, // backslash
+    { 0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e }, // ']'
+    { 0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00 }, // '^'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f }, // '_'
+};
+
+// The atlas cell drawn for c; lowercase as uppercase, anything else outside
+// the font as '?'
+static int glyphCell(char c) {
+    if (c >= 'a' && c <= 'z') c = c - 'a' + 'A';
+    if (c < FIRST_GLYPH || c >= FIRST_GLYPH + GLYPHS) c = '?';
+    return c - FIRST_GLYPH;
+}
+
+PerfHud::PerfHud() : font_texture(0), pixel_to_clip(0.0f), frame_count(0), next_frame(0) {
+    std::fill(frame_times, frame_times + HISTORY, 0.0f);
+}
+
+PerfHud::~PerfHud() {
+    release();
+}
+
+void PerfHud::create() {
+    if (isCreated()) return;
+    std::vector<unsigned char> atlas((size_t)ATLAS_WIDTH * CELL, 0);
+    for (int g = 0; g < GLYPHS; g++) {
+        for (int y = 0; y < GLYPH_HEIGHT; y++) {
+            for (int x = 0; x < GLYPH_WIDTH; x++) {
+                if (FONT[g][y] & (1 << (GLYPH_WIDTH - 1 - x))) atlas[(size_t)y * ATLAS_WIDTH + g * CELL + x] = 255;
+            }
+        }
+    }
+    for (int y = 0; y < CELL; y++) {
+        std::fill(&atlas[(size_t)y * ATLAS_WIDTH + SOLID * CELL], &atlas[(size_t)y * ATLAS_WIDTH + SOLID * CELL] + CELL, 255);
+    }
+    // Texel rows run down the glyphs, so v grows downwards as y does
+    glGenTextures(1, &font_texture);
+    glBindTexture(GL_TEXTURE_2D, font_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_WIDTH, CELL, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    MemoryStats::trackTexture(font_texture, atlas.size(), "hud");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    mesh.create(false, false, "hud");
+    const int stride = 8 * sizeof(float);
+    mesh.attribute(mesh.vbo, 0, 4, GL_FLOAT, false, stride, 0);
+    mesh.attribute(mesh.vbo, 1, 4, GL_FLOAT, false, stride, 4 * sizeof(float));
+}
+
+void PerfHud::release() {
+    if (!isCreated()) return;
+    MemoryStats::forgetTextures(1, &font_texture);
+    glDeleteTextures(1, &font_texture);
+    font_texture = 0;
+    mesh.release();
+}
+
+void PerfHud::addFrameTime(float milliseconds) {
+    frame_times[next_frame] = milliseconds;
+    next_frame = (next_frame + 1) % HISTORY;
+    frame_count = std::min(frame_count + 1, HISTORY);
+}
+
+float PerfHud::getFrameTimePercentile(float p) const {
+    if (frame_count == 0) return 0.0f;
+    float sorted[HISTORY];
+    std::copy(frame_times, frame_times + frame_count, sorted);
+    int k = std::min(frame_count - 1, (int)(glm::clamp(p, 0.0f, 1.0f) * (frame_count - 1) + 0.5f));
+    std::nth_element(sorted, sorted + k, sorted + frame_count);
+    return sorted[k];
+}
+
+void PerfHud::addLine(int column, const std::string& text, const glm::vec3& color) {
+    Line line;
+    line.column = std::max(0, std::min(column, COLUMNS - 1));
+    line.text = text;
+    line.color = color;
+    lines.push_back(line);
+}
+
+// === GEOMETRY ===
+
+void PerfHud::addQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1,
+                      const glm::vec4& color) {
+    const float corners[6][4] = {
+        { x0, y0, u0, v0 }, { x1, y0, u1, v0 }, { x1, y1, u1, v1 },
+        { x0, y0, u0, v0 }, { x1, y1, u1, v1 }, { x0, y1, u0, v1 },
+    };
+    for (const float* corner : corners) {
+        vertices.push_back(corner[0] * pixel_to_clip.x - 1.0f);
+        vertices.push_back(1.0f - corner[1] * pixel_to_clip.y);
+        vertices.push_back(corner[2]);
+        vertices.push_back(corner[3]);
+        vertices.push_back(color.r);
+        vertices.push_back(color.g);
+        vertices.push_back(color.b);
+        vertices.push_back(color.a);
+    }
+}
+
+void PerfHud::addRectangle(float x0, float y0, float x1, float y1, const glm::vec4& color) {
+    const float u = (SOLID * CELL + 0.5f * CELL) / ATLAS_WIDTH;
+    addQuad(x0, y0, x1, y1, u, 0.5f, u, 0.5f, color);
+}
+
+// A line from a to b as a quad width pixels across
+void PerfHud::addSegment(const glm::vec2& a, const glm::vec2& b, float width, const glm::vec4& color) {
+    glm::vec2 along = b - a;
+    float length = glm::length(along);
+    if (length <= 0.0f) return;
+    glm::vec2 side = glm::vec2(-along.y, along.x) * (0.5f * width / length);
+    const float u = (SOLID * CELL + 0.5f * CELL) / ATLAS_WIDTH;
+    const glm::vec2 corners[6] = { a - side, b - side, b + side, a - side, b + side, a + side };
+    for (const glm::vec2& corner : corners) {
+        vertices.push_back(corner.x * pixel_to_clip.x - 1.0f);
+        vertices.push_back(1.0f - corner.y * pixel_to_clip.y);
+        vertices.push_back(u);
+        vertices.push_back(0.5f);
+        vertices.push_back(color.r);
+        vertices.push_back(color.g);
+        vertices.push_back(color.b);
+        vertices.push_back(color.a);
+    }
+}
+
+void PerfHud::addText(float x, float y, int scale, const std::string& text, const glm::vec4& color) {
+    for (char c : text) {
+        if (c != ' ') {
+            float u0 = (float)(glyphCell(c) * CELL) / ATLAS_WIDTH;
+            float u1 = (float)(glyphCell(c) * CELL + GLYPH_WIDTH) / ATLAS_WIDTH;
+            float v1 = (float)GLYPH_HEIGHT / CELL;
+            addQuad(x, y, x + GLYPH_WIDTH * scale, y + GLYPH_HEIGHT * scale, u0, 0.0f, u1, v1, color);
+        }
+        x += ADVANCE * scale;
+    }
+}
+
+// === DRAW ===
+
+void PerfHud::draw(GlStateCache& state, ShaderProgram* program, int width, int height) {
+    if (!isCreated() || !program || width <= 0 || height <= 0) {
+        lines.clear();
+        return;
+    }
+    pixel_to_clip = glm::vec2(2.0f / width, 2.0f / height);
+    const int scale = std::max(1, height / 540);
+    const float advance = ADVANCE * scale;
+    const float line_height = LINE_HEIGHT * scale;
+    
+    // === LAYOUT ===
+    // The frame time line and the graph, then the columns side by side,
+    // each as wide as its longest line
+    char header[96];
+    snprintf(header, sizeof(header), "FRAME %.2f MS  P50 %.2f  P95 %.2f  P99 %.2f",
+             frame_count > 0 ? frame_times[(next_frame + HISTORY - 1) % HISTORY] : 0.0f,
+             getFrameTimePercentile(0.5f), getFrameTimePercentile(0.95f), getFrameTimePercentile(0.99f));
+    size_t column_chars[COLUMNS] = {};
+    int column_lines[COLUMNS] = {};
+    for (const Line& line : lines) {
+        column_chars[line.column] = std::max(column_chars[line.column], line.text.size());
+        column_lines[line.column]++;
+    }
+    float column_x[COLUMNS];
+    float columns_width = 0.0f;
+    int rows = 0;
+    for (int c = 0; c < COLUMNS; c++) {
+        column_x[c] = columns_width;
+        if (column_lines[c] > 0) columns_width += (column_chars[c] + (c + 1 < COLUMNS ? 3 : 0)) * advance;
+        rows = std::max(rows, column_lines[c]);
+    }
+    const float graph_width = (float)HISTORY * scale;
+    const float graph_height = (float)GRAPH_HEIGHT * scale;
+    const float padding = PADDING * scale;
+    const float content_width = std::max(std::max(graph_width, strlen(header) * advance), columns_width);
+    const float left = padding;
+    const float top = padding;
+    const float graph_top = top + padding + line_height;
+    const float text_top = graph_top + graph_height + padding;
+    
+    vertices.clear();
+    addRectangle(left, top, left + content_width + 2.0f * padding, text_top + rows * line_height + padding,
+                 glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+    addText(left + padding, top + padding, scale, header, glm::vec4(1.0f));
+    
+    // === GRAPH ===
+    // Scaled to the 30 Hz frame time, doubled until the slowest frame fits;
+    // lines at the 60 and 30 Hz times
+    const float graph_left = left + padding;
+    float slowest = 0.0f;
+    for (int i = 0; i < frame_count; i++) {
+        slowest = std::max(slowest, frame_times[i]);
+    }
+    float range = 1000.0f / 30.0f;
+    while (slowest > range && range < 1e6f) {
+        range *= 2.0f;
+    }
+    addRectangle(graph_left, graph_top, graph_left + graph_width, graph_top + graph_height,
+                 glm::vec4(0.1f, 0.1f, 0.1f, 0.8f));
+    const float guides[2] = { 1000.0f / 60.0f, 1000.0f / 30.0f };
+    for (float guide : guides) {
+        float y = graph_top + graph_height * (1.0f - guide / range);
+        addRectangle(graph_left, y, graph_left + graph_width, y + scale, glm::vec4(0.4f, 0.4f, 0.4f, 0.8f));
+    }
+    glm::vec2 previous;
+    for (int i = 0; i < frame_count; i++) {
+        float milliseconds = frame_times[(next_frame + HISTORY - frame_count + i) % HISTORY];
+        glm::vec2 point(graph_left + (float)i * graph_width / (HISTORY - 1),
+                        graph_top + graph_height * (1.0f - std::min(milliseconds / range, 1.0f)));
+        if (i > 0) {
+            glm::vec4 color = milliseconds <= 1000.0f / 55.0f ? glm::vec4(0.3f, 1.0f, 0.3f, 1.0f)
+                            : milliseconds <= 1000.0f / 28.0f ? glm::vec4(1.0f, 0.9f, 0.2f, 1.0f)
+                                                               : glm::vec4(1.0f, 0.3f, 0.2f, 1.0f);
+            addSegment(previous, point, 1.5f * scale, color);
+        }
+        previous = point;
+    }
+    
+    // === TEXT ===
+    int row[COLUMNS] = {};
+    for (const Line& line : lines) {
+        addText(left + padding + column_x[line.column], text_top + row[line.column]++ * line_height, scale,
+                line.text, glm::vec4(line.color, 1.0f));
+    }
+    lines.clear();
+    
+    mesh.uploadVertices(vertices.data(), vertices.size() * sizeof(float), GL_STREAM_DRAW);
+    state.useProgram(program);
+    state.uniform1i("hudFont", FONT_UNIT);
+    state.bindTexture(FONT_UNIT, GL_TEXTURE_2D, font_texture);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    mesh.bind();
+    mesh.draw(vertices.size() / 8);
+    GpuMesh::unbind();
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,76 @@
+#ifndef PERF_HUD_H
+#define PERF_HUD_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "gpu_mesh.h"
+
+class GlStateCache;
+class ShaderProgram;
+
+// An overlay of performance numbers drawn over the finished frame: a graph
+// of the last HISTORY frame times with their percentiles, and lines of text
+// the caller sets each frame in up to COLUMNS columns. Text is a built-in
+// 5x7 bitmap font of ASCII 32-95, lowercase shown as uppercase, scaled by
+// whole pixels with the window's height. Everything is one batch of
+// quads, textured and colored per vertex (v_hud.glsl / f_hud.glsl), rebuilt
+// and uploaded per draw.
+//
+// create() binds a texture directly, behind a GlStateCache's back
+// (GlStateCache::invalidateTextures)
+class PerfHud {
+public:
+    static const int FONT_UNIT = 15;  // The hudFont sampler's unit
+    static const int HISTORY = 240;   // Frame times in the graph and the percentiles
+    static const int COLUMNS = 2;
+    
+    PerfHud();
+    ~PerfHud();
+    
+    void create();
+    void release();
+    bool isCreated() const { return font_texture != 0; }
+    
+    // Record a frame's time, whether the overlay is drawn or not
+    void addFrameTime(float milliseconds);
+    // The p-th percentile (p in [0, 1]) of the recorded frame times; 0
+    // before the first
+    float getFrameTimePercentile(float p) const;
+    
+    // The text of the next draw, cleared by the draw
+    void addLine(int column, const std::string& text, const glm::vec3& color = glm::vec3(1.0f));
+    
+    // Draw over the default framebuffer, width x height pixels, with
+    // program; depth testing is off meanwhile and blending on
+    void draw(GlStateCache& state, ShaderProgram* program, int width, int height);
+
+private:
+    struct Line {
+        int column;
+        std::string text;
+        glm::vec3 color;
+    };
+    
+    GLuint font_texture; // R8 atlas of the glyphs in a row, then a solid cell
+    GpuMesh mesh;
+    std::vector<float> vertices; // Per vertex: x, y in clip space, u, v, r, g, b, a
+    glm::vec2 pixel_to_clip;     // Clip units per pixel of the draw's framebuffer
+    std::vector<Line> lines;
+    float frame_times[HISTORY];
+    int frame_count; // Frames recorded, up to HISTORY
+    int next_frame;  // Where the next goes
+    
+    void addQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1,
+                 const glm::vec4& color);
+    void addRectangle(float x0, float y0, float x1, float y1, const glm::vec4& color);
+    void addSegment(const glm::vec2& a, const glm::vec2& b, float width, const glm::vec4& color);
+    // Lay out text from its top left (x, y), scale pixels per font pixel
+    void addText(float x, float y, int scale, const std::string& text, const glm::vec4& color);
+    
+    PerfHud(const PerfHud&);
+    PerfHud& operator=(const PerfHud&);
+};
+
+#endif // PERF_HUD_H
@@ -0,0 +1,322 @@
+// Benchmark of lodepng's decoder and encoder, stage by stage, to validate
+// changes to them:
+//
+//   png_bench [--repeat N] [--no-synthetic] [baseline options] [file.png...]
+//
+// Without files it runs the material textures. Two synthetic 4096x4096
+// images follow unless --no-synthetic: photographic-like RGBA noise over
+// gradients, and flat-shaded RGB like a rendered frame. Every time is the
+// best of N runs (default 5).
+//
+// Stages that lodepng keeps internal are timed through its hooks or taken
+// as the remainder of a whole decode or encode:
+//   crc       lodepng_crc32 over every chunk, per file byte
+//   inflate   the zlib stream without its Adler-32 (custom_zlib hook)
+//   adler     the zlib stream checked minus unchecked (0 within the noise)
+//   unfilter  native-color decode minus zlib and CRC, per scanline byte
+//   convert   lodepng_convert to RGBA8, per output byte
+//   deflate   lodepng_zlib_compress inside the encoder (custom_zlib hook)
+//   filter    native-color encode minus zlib and CRC, per scanline byte
+// with decode, encode and the fast encoder preset as wholes for reference.
+// Those three keep every run's time for the baseline options
+// (bench_baseline.h): checked against this machine's stored baseline
+// (--compare, exiting with status 2 on a regression) or stored as it
+#include "bench_baseline.h"
+#include "lodepng.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Time spent in the zlib hook, and how it runs lodepng's own zlib
+struct ZlibTimer {
+    double seconds;
+    unsigned ignore_adler32;
+};
+
+unsigned timedDecompress(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize,
+                         const LodePNGDecompressSettings* settings) {
+    ZlibTimer* timer = (ZlibTimer*)settings->custom_context;
+    LodePNGDecompressSettings plain = *settings;
+    plain.custom_zlib = 0;
+    plain.ignore_adler32 = timer->ignore_adler32;
+    Clock::time_point start = Clock::now();
+    unsigned error = lodepng_zlib_decompress(out, outsize, in, insize, &plain);
+    timer->seconds += secondsSince(start);
+    return error;
+}
+
+unsigned timedCompress(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize,
+                       const LodePNGCompressSettings* settings) {
+    ZlibTimer* timer = (ZlibTimer*)settings->custom_context;
+    LodePNGCompressSettings plain = *settings;
+    plain.custom_zlib = 0;
+    Clock::time_point start = Clock::now();
+    unsigned error = lodepng_zlib_compress(out, outsize, in, insize, &plain);
+    timer->seconds += secondsSince(start);
+    return error;
+}
+
+struct Image {
+    std::string name;
+    std::vector<unsigned char> png;
+};
+
+struct Stage {
+    const char* name;
+    double seconds; // Best of the runs
+    double bytes;   // Processed per run, for MB/s
+};
+
+void report(const std::vector<Stage>& stages) {
+    for (const Stage& stage : stages) {
+        double seconds = std::max(stage.seconds, 0.0);
+        printf("  %-10s %9.2f ms", stage.name, seconds * 1000.0);
+        if (seconds > 0.0) printf(" %9.1f MB/s", stage.bytes / seconds / 1e6);
+        printf("\n");
+    }
+}
+
+// Every run of the whole decodes and encodes, for the baseline
+BenchBaseline samples;
+
+// Best of repeat runs of fn, which returns a negative time on an error;
+// each run's time also a sample of metric unless it is empty
+template <typename F>
+double best(int repeat, F fn, const std::string& metric = std::string()) {
+    double fastest = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        double seconds = fn();
+        if (seconds < 0.0) return -1.0;
+        fastest = std::min(fastest, seconds);
+        if (!metric.empty()) samples.add(metric, seconds * 1000.0);
+    }
+    return fastest;
+}
+
+bool bench(const Image& image, int repeat) {
+    const std::vector<unsigned char>& png = image.png;
+    unsigned w, h;
+    lodepng::State info; // The PNG's header and palette
+    std::vector<unsigned char> rgba, raw;
+    unsigned error = lodepng::decode(rgba, w, h, info, png);
+    if (error) {
+        std::cout << image.name << ": " << lodepng_error_text(error) << std::endl;
+        return false;
+    }
+    const LodePNGColorMode& native = info.info_png.color;
+    const double scanline_bytes = (double)h * (1 + ((size_t)w * lodepng_get_bpp(&native) + 7) / 8);
+    const double rgba_bytes = (double)w * h * 4;
+    printf("%s: %ux%u, %u-bit %s%s, %.1f KB\n", image.name.c_str(), w, h, native.bitdepth,
+           native.colortype == LCT_GREY ? "grey" : native.colortype == LCT_RGB ? "RGB" :
+           native.colortype == LCT_PALETTE ? "palette" : native.colortype == LCT_GREY_ALPHA ? "grey+alpha" : "RGBA",
+           info.info_png.interlace_method ? " Adam7" : "", png.size() / 1024.0);
+
+    // Whole decodes: to RGBA8, and to the PNG's own color type
+    double decode = best(repeat, [&]() {
+        rgba.clear();
+        Clock::time_point start = Clock::now();
+        unsigned w2, h2;
+        if (lodepng::decode(rgba, w2, h2, png)) return -1.0;
+        return secondsSince(start);
+    }, image.name + "/decode");
+    ZlibTimer inflate_timer = { 0.0, 1 };
+    ZlibTimer zlib_timer = { 0.0, 0 };
+    double inflate_seconds = 1e30, zlib_seconds = 1e30;
+    double native_decode = best(repeat, [&]() {
+        lodepng::State state;
+        state.decoder.color_convert = 0;
+        state.decoder.zlibsettings.custom_zlib = timedDecompress;
+        state.decoder.zlibsettings.custom_context = &zlib_timer;
+        zlib_timer.seconds = 0.0;
+        raw.clear();
+        Clock::time_point start = Clock::now();
+        unsigned w2, h2;
+        if (lodepng::decode(raw, w2, h2, state, png)) return -1.0;
+        double seconds = secondsSince(start);
+        zlib_seconds = std::min(zlib_seconds, zlib_timer.seconds);
+        // The same again without the checksum
+        state.decoder.zlibsettings.custom_context = &inflate_timer;
+        inflate_timer.seconds = 0.0;
+        std::vector<unsigned char> again;
+        lodepng::decode(again, w2, h2, state, png);
+        inflate_seconds = std::min(inflate_seconds, inflate_timer.seconds);
+        return seconds;
+    });
+    if (decode < 0.0 || native_decode < 0.0) {
+        std::cout << "  cannot decode" << std::endl;
+        return false;
+    }
+
+    double crc = best(repeat, [&]() {
+        Clock::time_point start = Clock::now();
+        unsigned sum = 0;
+        const unsigned char* end = png.data() + png.size();
+        for (const unsigned char* chunk = png.data() + 8; chunk + 12 <= end; chunk = lodepng_chunk_next_const(chunk)) {
+            size_t length = lodepng_chunk_length(chunk);
+            if (length > (size_t)(end - chunk) - 12) break;
+            sum += lodepng_crc32(chunk + 4, length + 4);
+        }
+        volatile unsigned keep = sum;
+        (void)keep;
+        return secondsSince(start);
+    });
+
+    LodePNGColorMode rgba_mode;
+    lodepng_color_mode_init(&rgba_mode);
+    std::vector<unsigned char> converted(w * h * 4);
+    double convert = best(repeat, [&]() {
+        Clock::time_point start = Clock::now();
+        if (lodepng_convert(converted.data(), raw.data(), &rgba_mode, &native, w, h)) return -1.0;
+        return secondsSince(start);
+    });
+    lodepng_color_mode_cleanup(&rgba_mode);
+
+    // Encodes of the decoded pixels: in their own color type with the
+    // zlib stage timed, then whole from RGBA8 as an application would
+    ZlibTimer deflate_timer = { 0.0, 0 };
+    double deflate_seconds = 1e30, encoded_bytes = 0.0;
+    double native_encode = best(repeat, [&]() {
+        lodepng::State state;
+        lodepng_color_mode_copy(&state.info_raw, &native);
+        lodepng_color_mode_copy(&state.info_png.color, &native);
+        state.encoder.auto_convert = 0;
+        state.encoder.zlibsettings.custom_zlib = timedCompress;
+        state.encoder.zlibsettings.custom_context = &deflate_timer;
+        deflate_timer.seconds = 0.0;
+        std::vector<unsigned char> out;
+        Clock::time_point start = Clock::now();
+        if (lodepng::encode(out, raw, w, h, state)) return -1.0;
+        double seconds = secondsSince(start);
+        deflate_seconds = std::min(deflate_seconds, deflate_timer.seconds);
+        encoded_bytes = out.size();
+        return seconds;
+    });
+    double encode = best(repeat, [&]() {
+        std::vector<unsigned char> out;
+        Clock::time_point start = Clock::now();
+        if (lodepng::encode(out, rgba, w, h)) return -1.0;
+        return secondsSince(start);
+    }, image.name + "/encode");
+    double fast_bytes = 0.0;
+    double fast_encode = best(repeat, [&]() {
+        lodepng::State state;
+        lodepng_encoder_settings_fast(&state.encoder);
+        std::vector<unsigned char> out;
+        Clock::time_point start = Clock::now();
+        if (lodepng::encode(out, rgba, w, h, state)) return -1.0;
+        fast_bytes = out.size();
+        return secondsSince(start);
+    }, image.name + "/fast");
+    if (native_encode < 0.0 || encode < 0.0 || fast_encode < 0.0) {
+        std::cout << "  cannot encode" << std::endl;
+        return false;
+    }
+
+    std::vector<Stage> stages;
+    stages.push_back(Stage{ "decode", decode, rgba_bytes });
+    stages.push_back(Stage{ "crc", crc, (double)png.size() });
+    stages.push_back(Stage{ "inflate", inflate_seconds, scanline_bytes });
+    stages.push_back(Stage{ "adler", zlib_seconds - inflate_seconds, scanline_bytes });
+    stages.push_back(Stage{ "unfilter", native_decode - zlib_seconds - crc, scanline_bytes });
+    stages.push_back(Stage{ "convert", convert, rgba_bytes });
+    stages.push_back(Stage{ "encode", encode, rgba_bytes });
+    stages.push_back(Stage{ "filter", native_encode - deflate_seconds - crc * encoded_bytes / png.size(), scanline_bytes });
+    stages.push_back(Stage{ "deflate", deflate_seconds, scanline_bytes });
+    stages.push_back(Stage{ "fast", fast_encode, rgba_bytes });
+    report(stages);
+    printf("  encoded %.1f KB, fast preset %.1f KB\n", encoded_bytes / 1024.0, fast_bytes / 1024.0);
+    return true;
+}
+
+// Pseudo-random but the same every run
+unsigned nextRandom(unsigned& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 24;
+}
+
+Image syntheticImage(const char* name, unsigned w, unsigned h, bool photographic) {
+    std::vector<unsigned char> pixels((size_t)w * h * 4);
+    unsigned seed = 1;
+    for (unsigned y = 0; y < h; y++) {
+        for (unsigned x = 0; x < w; x++) {
+            unsigned char* p = &pixels[((size_t)y * w + x) * 4];
+            if (photographic) {
+                p[0] = (unsigned char)((x * 255 / w + nextRandom(seed) % 24) & 255);
+                p[1] = (unsigned char)((y * 255 / h + nextRandom(seed) % 24) & 255);
+                p[2] = (unsigned char)(((x + y) * 127 / w + nextRandom(seed) % 24) & 255);
+                p[3] = (unsigned char)(255 - nextRandom(seed) % 8);
+            } else {
+                // Flat shaded cells with hard edges, as in a rendered frame
+                unsigned cell = (x / 64) * 31 + (y / 48) * 17;
+                p[0] = (unsigned char)(cell * 7);
+                p[1] = (unsigned char)(cell * 13 + y / 16);
+                p[2] = (unsigned char)(cell * 3 + x / 32);
+                p[3] = 255;
+            }
+        }
+    }
+    Image image;
+    image.name = name;
+    lodepng::State state;
+    state.info_png.color.colortype = photographic ? LCT_RGBA : LCT_RGB;
+    state.encoder.auto_convert = 0;
+    if (lodepng::encode(image.png, pixels, w, h, state)) image.png.clear();
+    return image;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int repeat = 5;
+    bool synthetic = true;
+    std::vector<std::string> files;
+    BenchBaselineOptions baseline;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc) repeat = std::max(1, atoi(argv[++i]));
+        else if (arg == "--no-synthetic") synthetic = false;
+        else if (baseline.parse(argc, argv, i)) continue;
+        else files.push_back(arg);
+    }
+    if (files.empty()) {
+        const char* textures[] = {"bark.png", "leaf.png", "grass.png", "grass2.png", "grass3.png",
+                                  "torch.png", "torch2.png", "sun_yellow.png"};
+        files.assign(textures, textures + sizeof(textures) / sizeof(textures[0]));
+    }
+
+    int failed = 0;
+    std::vector<Image> images;
+    for (const std::string& file : files) {
+        Image image;
+        image.name = file;
+        unsigned error = lodepng::load_file(image.png, file);
+        if (error) {
+            std::cout << file << ": " << lodepng_error_text(error) << std::endl;
+            failed++;
+            continue;
+        }
+        images.push_back(image);
+    }
+    if (synthetic) {
+        images.push_back(syntheticImage("synthetic 4096x4096 photographic", 4096, 4096, true));
+        images.push_back(syntheticImage("synthetic 4096x4096 flat", 4096, 4096, false));
+    }
+
+    for (const Image& image : images) {
+        if (!bench(image, repeat)) failed++;
+    }
+    if (failed) return 1;
+    return baseline.finish("png_bench", samples, std::cout);
+}
@@ -0,0 +1,136 @@
+#include "primitives.h"
+#include "constants.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+void addVertex(PrimitiveMesh& mesh, float x, float y, float z, float u, float v, float nx, float ny, float nz) {
+    const float position[] = { x, y, z, 1.0f };
+    const float texcoord[] = { u, v };
+    const float normal[] = { nx, ny, nz };
+    mesh.positions.insert(mesh.positions.end(), position, position + 4);
+    mesh.texcoords.insert(mesh.texcoords.end(), texcoord, texcoord + 2);
+    mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+}
+
+// Two triangles over the corners a, b, c, d, counter-clockwise
+void addQuad(PrimitiveMesh& mesh, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    const uint32_t quad[] = { a, b, c, a, c, d };
+    mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+}
+
+// A cube face: its outward normal and the directions of texture u and v,
+// with u x v = normal so the corners wind counter-clockwise
+struct CubeFace {
+    float normal[3];
+    float u[3];
+    float v[3];
+};
+
+const CubeFace CUBE_FACES[6] = {
+    { { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+    { { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+    { { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } },
+    { { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+    { { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+    { { 0.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } }
+};
+
+const float QUAD_CORNERS[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+
+}
+
+// === PRIMITIVES ===
+
+PrimitiveMesh makeCubeMesh() {
+    PrimitiveMesh mesh;
+    for (const CubeFace& face : CUBE_FACES) {
+        const uint32_t first = mesh.getVertexCount();
+        for (const float* corner : QUAD_CORNERS) {
+            const float s = corner[0] * 2.0f - 1.0f, t = corner[1] * 2.0f - 1.0f;
+            addVertex(mesh, face.normal[0] + s * face.u[0] + t * face.v[0],
+                      face.normal[1] + s * face.u[1] + t * face.v[1],
+                      face.normal[2] + s * face.u[2] + t * face.v[2], corner[0], 1.0f - corner[1], face.normal[0],
+                      face.normal[1], face.normal[2]);
+        }
+        addQuad(mesh, first, first + 1, first + 2, first + 3);
+    }
+    return mesh;
+}
+
+// One ring of slices + 1 vertices per stack boundary, the seam's column
+// doubled for its texcoord; the poles' rings collapse to a point
+PrimitiveMesh makeSphereMesh(int slices, int stacks) {
+    slices = std::max(3, slices);
+    stacks = std::max(2, stacks);
+    PrimitiveMesh mesh;
+    for (int j = 0; j <= stacks; j++) {
+        const float v = (float)j / stacks;
+        const float polar = PI * (1.0f - v); // From the south pole
+        const float y = cos(polar), ring = sin(polar);
+        for (int i = 0; i <= slices; i++) {
+            const float u = (float)i / slices;
+            const float x = ring * cos(2.0f * PI * u), z = -ring * sin(2.0f * PI * u);
+            addVertex(mesh, x, y, z, u, 1.0f - v, x, y, z);
+        }
+    }
+    for (int j = 0; j < stacks; j++) {
+        for (int i = 0; i < slices; i++) {
+            const uint32_t a = j * (slices + 1) + i, b = a + 1, c = b + slices + 1, d = a + slices + 1;
+            // The pole rows' degenerate halves are left out
+            if (j == 0) {
+                const uint32_t triangle[] = { a, c, d };
+                mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+            } else if (j == stacks - 1) {
+                const uint32_t triangle[] = { a, b, c };
+                mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+            } else {
+                addQuad(mesh, a, b, c, d);
+            }
+        }
+    }
+    return mesh;
+}
+
+PrimitiveMesh makeCylinderMesh(int segments) {
+    segments = std::max(3, segments);
+    PrimitiveMesh mesh;
+    // Side: a bottom and a top ring, the seam doubled
+    for (int i = 0; i <= segments; i++) {
+        const float u = (float)i / segments;
+        const float x = cos(2.0f * PI * u), z = -sin(2.0f * PI * u);
+        addVertex(mesh, x, -1.0f, z, u, 1.0f, x, 0.0f, z);
+        addVertex(mesh, x, 1.0f, z, u, 0.0f, x, 0.0f, z);
+    }
+    for (int i = 0; i < segments; i++) {
+        addQuad(mesh, 2 * i, 2 * i + 2, 2 * i + 3, 2 * i + 1);
+    }
+    // Caps: a fan around the center of each
+    for (int cap = 0; cap < 2; cap++) {
+        const float y = cap == 0 ? -1.0f : 1.0f;
+        const uint32_t center = mesh.getVertexCount();
+        addVertex(mesh, 0.0f, y, 0.0f, 0.5f, 0.5f, 0.0f, y, 0.0f);
+        for (int i = 0; i < segments; i++) {
+            const float angle = 2.0f * PI * i / segments;
+            const float x = cos(angle), z = -sin(angle);
+            addVertex(mesh, x, y, z, 0.5f + 0.5f * x, 0.5f - 0.5f * z, 0.0f, y, 0.0f);
+        }
+        for (int i = 0; i < segments; i++) {
+            const uint32_t a = center + 1 + i, b = center + 1 + (i + 1) % segments;
+            const uint32_t triangle[] = { center, cap == 0 ? b : a, cap == 0 ? a : b };
+            mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+        }
+    }
+    return mesh;
+}
+
+PrimitiveMesh makeQuadMesh() {
+    PrimitiveMesh mesh;
+    for (const float* corner : QUAD_CORNERS) {
+        addVertex(mesh, corner[0] * 2.0f - 1.0f, 0.0f, 1.0f - corner[1] * 2.0f, corner[0], 1.0f - corner[1], 0.0f,
+                  1.0f, 0.0f);
+    }
+    addQuad(mesh, 0, 1, 2, 3);
+    return mesh;
+}
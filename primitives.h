@@ -0,0 +1,34 @@
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <cstdint>
+#include <vector>
+
+// An indexed mesh of one of the procedural primitives, in the layout
+// StaticBatch::add() takes: positions (x, y, z, 1), texcoords (u, v) and
+// unit normals (x, y, z) per vertex, and triangles counter-clockwise seen
+// from outside. Texture v 0 is the image's top row, as textures load, and
+// v runs down the primitive. Vertices are shared within a flat face or a smooth
+// surface and split only where the normal or the texcoord jumps
+struct PrimitiveMesh {
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+    std::vector<float> normals;
+    std::vector<uint32_t> indices;
+    
+    int getVertexCount() const { return positions.size() / 4; }
+};
+
+// The cube from -1 to 1: 24 vertices, 4 a face, each face's texture whole
+// and the sides' upright
+PrimitiveMesh makeCubeMesh();
+// The unit sphere in slices around the y axis and stacks pole to pole,
+// texture u around and v from the north pole down
+PrimitiveMesh makeSphereMesh(int slices, int stacks);
+// The cylinder of radius 1 from y -1 to 1 in segments around, with caps:
+// the side's texture wrapped once around, each cap's the disc in its square
+PrimitiveMesh makeCylinderMesh(int segments);
+// The square from -1 to 1 in x and z, facing +y, texture v along +z
+PrimitiveMesh makeQuadMesh();
+
+#endif // PRIMITIVES_H
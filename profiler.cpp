@@ -0,0 +1,275 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Profiler::enabled(true);
+
+// One recorded scope, or a counter's value at begin with end holding the
+// value. Its fields are atomics so a trace written while the
+// owner overwrites the slot reads stale or torn values, which it then
+// discards, rather than racing
+struct ProfileEvent {
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> begin;
+    std::atomic<uint64_t> end;
+    std::atomic<int> thread; // The writer's id, kept when the buffer changes hands
+    std::atomic<bool> counter;
+};
+
+// A thread's or a created track's ring: only its owner writes. Event k
+// lives in slot k % EVENTS; claimed is raised before the slot is rewritten
+// and written after, so a reader that copied [written - EVENTS, written)
+// keeps only the events above claimed - EVENTS, which no write touched
+// during the copy
+struct ProfileTrack {
+    ProfileEvent events[Profiler::EVENTS];
+    std::atomic<uint64_t> claimed;
+    std::atomic<uint64_t> written;
+    int thread;  // The current owner's id
+    bool in_use; // False once the owner thread exited, until the next takes it; tracks stay in use
+    
+    ProfileTrack() : claimed(0), written(0), thread(0), in_use(false) {}
+};
+
+// Buffers are created on a thread's first scope and never freed, so a
+// thread still recording while the process exits never loses its own
+struct ProfileRegistry {
+    std::mutex mutex;
+    std::vector<ProfileTrack*> buffers;
+    std::vector<std::string> thread_names; // By thread id
+    std::chrono::steady_clock::time_point epoch;
+    
+    ProfileRegistry() : epoch(std::chrono::steady_clock::now()) {}
+};
+
+static ProfileRegistry& registry() {
+    static ProfileRegistry* instance = new ProfileRegistry();
+    return *instance;
+}
+
+// The calling thread's buffer, handed back to the registry at its exit
+struct ProfileThreadSlot {
+    ProfileTrack* buffer;
+    
+    ProfileThreadSlot() : buffer(nullptr) {}
+    ~ProfileThreadSlot() {
+        if (!buffer) return;
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        buffer->in_use = false;
+    }
+};
+
+static thread_local ProfileThreadSlot thread_slot;
+
+// The calling thread's buffer: a free one or a new one on its first scope,
+// under a new thread id either way
+static ProfileTrack& threadBuffer() {
+    if (thread_slot.buffer) return *thread_slot.buffer;
+    ProfileRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    ProfileTrack* buffer = nullptr;
+    for (ProfileTrack* candidate : reg.buffers) {
+        if (!candidate->in_use) {
+            buffer = candidate;
+            break;
+        }
+    }
+    if (!buffer) {
+        buffer = new ProfileTrack();
+        reg.buffers.push_back(buffer);
+    }
+    buffer->in_use = true;
+    buffer->thread = reg.thread_names.size();
+    reg.thread_names.push_back("thread " + std::to_string(buffer->thread));
+    thread_slot.buffer = buffer;
+    return *buffer;
+}
+
+uint64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                registry().epoch).count();
+}
+
+void Profiler::record(const char* name, uint64_t begin, uint64_t end) {
+    record(&threadBuffer(), name, begin, end);
+}
+
+ProfileTrack* Profiler::createTrack(const std::string& name) {
+    ProfileRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    ProfileTrack* track = new ProfileTrack();
+    track->in_use = true;
+    track->thread = reg.thread_names.size();
+    reg.thread_names.push_back(name);
+    reg.buffers.push_back(track);
+    return track;
+}
+
+static void writeEvent(ProfileTrack& buffer, const char* name, uint64_t begin, uint64_t end, bool counter) {
+    const uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.claimed.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ProfileEvent& event = buffer.events[index % Profiler::EVENTS];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    event.thread.store(buffer.thread, std::memory_order_relaxed);
+    event.counter.store(counter, std::memory_order_relaxed);
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::record(ProfileTrack* track, const char* name, uint64_t begin, uint64_t end) {
+    writeEvent(*track, name, begin, end, false);
+}
+
+void Profiler::recordCounter(const char* name, uint64_t value) {
+    if (!isEnabled()) return;
+    writeEvent(threadBuffer(), name, now(), value, true);
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    ProfileTrack& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    registry().thread_names[buffer.thread] = name;
+}
+
+uint64_t ProfileScope::next(const char* scope_name) {
+    uint64_t time = Profiler::now();
+    uint64_t duration = 0;
+    if (name) {
+        Profiler::record(name, begin, time);
+        duration = time - begin;
+    }
+    name = Profiler::isEnabled() ? scope_name : nullptr;
+    begin = time;
+    return duration;
+}
+
+// === CHROME TRACE EXPORT ===
+
+struct ProfileEventCopy {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+    int thread;
+    bool counter;
+};
+
+// The events of buffer no write touched while they were copied
+static void copyEvents(const ProfileTrack& buffer, std::vector<ProfileEventCopy>& out) {
+    const uint64_t written = buffer.written.load(std::memory_order_acquire);
+    const uint64_t first = written > (uint64_t)Profiler::EVENTS ? written - Profiler::EVENTS : 0;
+    const size_t start = out.size();
+    for (uint64_t k = first; k < written; k++) {
+        const ProfileEvent& event = buffer.events[k % Profiler::EVENTS];
+        ProfileEventCopy copy;
+        copy.name = event.name.load(std::memory_order_relaxed);
+        copy.begin = event.begin.load(std::memory_order_relaxed);
+        copy.end = event.end.load(std::memory_order_relaxed);
+        copy.thread = event.thread.load(std::memory_order_relaxed);
+        copy.counter = event.counter.load(std::memory_order_relaxed);
+        out.push_back(copy);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t claimed = buffer.claimed.load(std::memory_order_relaxed);
+    // Events below claimed - EVENTS may have been overwritten mid-copy
+    const uint64_t valid = claimed > (uint64_t)Profiler::EVENTS ? claimed - Profiler::EVENTS : 0;
+    if (valid > first) {
+        size_t stale = std::min<uint64_t>(valid - first, out.size() - start);
+        out.erase(out.begin() + start, out.begin() + start + stale);
+    }
+}
+
+static void appendJsonString(std::string& out, const char* text) {
+    out += '"';
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out += '\\';
+            out += *c;
+        } else if ((unsigned char)*c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+            out += escaped;
+        } else {
+            out += *c;
+        }
+    }
+    out += '"';
+}
+
+// Nanoseconds as microseconds with three decimals, the trace's unit
+static void appendMicroseconds(std::string& out, uint64_t nanoseconds) {
+    char text[32];
+    snprintf(text, sizeof(text), "%llu.%03u", (unsigned long long)(nanoseconds / 1000),
+             (unsigned)(nanoseconds % 1000));
+    out += text;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path, std::string& error) {
+    // === SNAPSHOT ===
+    // The registry lock keeps buffers from changing hands and names from
+    // changing; the owners go on recording into them meanwhile
+    std::vector<ProfileEventCopy> events;
+    std::vector<std::string> names;
+    {
+        ProfileRegistry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        events.reserve(reg.buffers.size() * EVENTS);
+        for (const ProfileTrack* buffer : reg.buffers) {
+            copyEvents(*buffer, events);
+        }
+        names = reg.thread_names;
+    }
+    
+    // === JSON ===
+    // Complete ("X") and counter ("C") events with their thread, then one
+    // thread_name metadata event for each thread seen
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    std::vector<char> seen(names.size(), 0);
+    bool first = true;
+    for (const ProfileEventCopy& event : events) {
+        if (!event.name || (!event.counter && event.end < event.begin)) continue;
+        if (!first) json += ",\n";
+        first = false;
+        json += "{\"name\":";
+        appendJsonString(json, event.name);
+        if (event.counter) {
+            json += ",\"ph\":\"C\",\"pid\":1,\"tid\":" + std::to_string(event.thread) + ",\"ts\":";
+            appendMicroseconds(json, event.begin);
+            json += ",\"args\":{\"value\":" + std::to_string(event.end) + "}}";
+            if (event.thread >= 0 && event.thread < (int)seen.size()) seen[event.thread] = 1;
+            continue;
+        }
+        json += ",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(event.thread) + ",\"ts\":";
+        appendMicroseconds(json, event.begin);
+        json += ",\"dur\":";
+        appendMicroseconds(json, event.end - event.begin);
+        json += '}';
+        if (event.thread >= 0 && event.thread < (int)seen.size()) seen[event.thread] = 1;
+    }
+    for (size_t t = 0; t < names.size(); t++) {
+        if (!seen[t]) continue;
+        if (!first) json += ",\n";
+        first = false;
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(t) +
+                ",\"args\":{\"name\":";
+        appendJsonString(json, names[t].c_str());
+        json += "}}";
+    }
+    json += "\n]}\n";
+    
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        error = strerror(errno);
+        return false;
+    }
+    bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+    if (fclose(file) != 0) written = false;
+    if (!written) error = "write failed";
+    return written;
+}
@@ -0,0 +1,87 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped CPU timers recorded into per-thread ring buffers and written out as
+// a Chrome trace (chrome://tracing or ui.perfetto.dev):
+//
+//   void Tree::updateGrowth(float delta_time) {
+//       PROFILE_SCOPE("Tree::updateGrowth");
+//
+// A scope costs two clock reads and a few stores into its thread's own
+// buffer: no lock, and no allocation after the thread's first scope. Each
+// buffer keeps its thread's last Profiler::EVENTS scopes, overwriting the
+// oldest, so a trace written at any moment shows the recent past of every
+// thread. A thread's buffer goes to the next thread started after it exits.
+//
+// Names are kept as pointers, not copied: pass string literals or other
+// strings that live as long as the process
+
+struct ProfileTrack;
+
+class Profiler {
+public:
+    static const int EVENTS = 16384; // Per thread
+    
+    // Scopes record only while enabled (the default); a disabled scope is
+    // one relaxed load
+    static void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    
+    // Name the calling thread in the traces (copied); unnamed threads show
+    // as "thread N"
+    static void setThreadName(const std::string& name);
+    
+    // Every thread's recorded scopes as Chrome trace event JSON, times in
+    // microseconds since the first scope of the process. Threads go on
+    // recording while it is written; false with error set on a failed write
+    static bool writeChromeTrace(const std::string& path, std::string& error);
+    
+    // Nanoseconds on the profiler's clock
+    static uint64_t now();
+    static void record(const char* name, uint64_t begin, uint64_t end);
+    
+    // A timeline of its own in the traces, for events timed elsewhere (the
+    // GPU's, gpu_profiler.h) and recorded by one thread at a time. Tracks
+    // live as long as the process
+    static ProfileTrack* createTrack(const std::string& name);
+    static void record(ProfileTrack* track, const char* name, uint64_t begin, uint64_t end);
+    
+    // A counter's value from now on, drawn as a graph of its own in the
+    // traces; a no-op while disabled
+    static void recordCounter(const char* name, uint64_t value);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// Times its own lifetime as one event under name
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* scope_name)
+        : name(Profiler::isEnabled() ? scope_name : nullptr), begin(name ? Profiler::now() : 0) {}
+    ~ProfileScope() {
+        if (name) Profiler::record(name, begin, Profiler::now());
+    }
+    
+    // End this event and time the rest of the scope as scope_name: the
+    // phases of a long function without a block per phase. Returns the
+    // nanoseconds of the event ended, 0 while the profiler was disabled
+    uint64_t next(const char* scope_name);
+
+private:
+    const char* name; // Null while the profiler was disabled at the start
+    uint64_t begin;
+    
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+#endif // PROFILER_H
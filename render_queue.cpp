@@ -0,0 +1,36 @@
+#include "render_queue.h"
+#include <algorithm>
+#include <cstring>
+
+uint64_t RenderQueue::makeKey(int pass, int state, float depth) {
+    float clamped = std::max(depth, 0.0f);
+    uint32_t depth_bits;
+    std::memcpy(&depth_bits, &clamped, sizeof(depth_bits));
+    uint64_t pass_field = (uint64_t)(pass & ((1 << PASS_BITS) - 1));
+    uint64_t state_field = (uint64_t)(state & ((1 << STATE_BITS) - 1));
+    return (pass_field << (STATE_BITS + 32)) | (state_field << 32) | depth_bits;
+}
+
+float RenderQueue::viewDepth(const glm::mat4& V, const glm::mat4& model, const glm::vec3& center) {
+    return -(V * model * glm::vec4(center, 1.0f)).z;
+}
+
+void RenderQueue::submit(int pass, int state, int material, float depth, const glm::mat4& model,
+                         void (*issue)(const RenderItem&), const GpuMesh* mesh, int count) {
+    RenderItem item;
+    item.key = makeKey(pass, state, depth);
+    item.pass = pass;
+    item.material = material;
+    item.depth = depth;
+    item.model = model;
+    item.issue = issue;
+    item.mesh = mesh;
+    item.count = count;
+    items.push_back(item);
+}
+
+void RenderQueue::sort() {
+    std::stable_sort(items.begin(), items.end(), [](const RenderItem& a, const RenderItem& b) {
+        return a.key < b.key;
+    });
+}
@@ -0,0 +1,52 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class GpuMesh;
+
+// One submitted draw: what RenderQueue sorts by and what its issue call
+// needs. issue() draws the item with its material already applied
+struct RenderItem {
+    uint64_t key;  // pass | state | depth, see RenderQueue::makeKey
+    int pass;      // 0 = opaque, 1 = alpha-tested foliage
+    int material;
+    float depth;   // View-space depth of the draw's center
+    glm::mat4 model;
+    void (*issue)(const RenderItem& item);
+    const GpuMesh* mesh; // Static mesh and vertex count for simple draws
+    int count;
+};
+
+// The frame's draws, submitted in any order and issued sorted by one
+// 64-bit key: the pass first, then the render state (program and material,
+// ranked by the caller so equal state sits together), then depth front to
+// back, so within a state the nearest draws fill the depth buffer first
+// and early-z rejects what they hide. Equal keys keep submission order.
+// Culling or instancing can drop or merge items between submit and sort
+class RenderQueue {
+private:
+    std::vector<RenderItem> items;
+    
+public:
+    static const int PASS_BITS = 8;
+    static const int STATE_BITS = 24;
+    
+    // Depth is stored as its float bit pattern, which orders like the value
+    // for depths >= 0 (nearer draws behind the near plane clamp to 0)
+    static uint64_t makeKey(int pass, int state, float depth);
+    // View-space depth of center (object space) under V * model
+    static float viewDepth(const glm::mat4& V, const glm::mat4& model, const glm::vec3& center = glm::vec3(0.0f));
+    
+    void submit(int pass, int state, int material, float depth, const glm::mat4& model,
+                void (*issue)(const RenderItem&), const GpuMesh* mesh = nullptr, int count = 0);
+    void sort();
+    void clear() { items.clear(); }
+    
+    const std::vector<RenderItem>& getItems() const { return items; }
+    int getCount() const { return items.size(); }
+};
+
+#endif // RENDER_QUEUE_H
@@ -0,0 +1,9 @@
+#include "render_stats.h"
+
+RenderStats::Counters RenderStats::frame = RenderStats::Counters();
+RenderStats::Counters RenderStats::last_frame = RenderStats::Counters();
+
+void RenderStats::endFrame() {
+    last_frame = frame;
+    frame = Counters();
+}
@@ -0,0 +1,37 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-frame totals of the work handed to GL: draw calls, the vertices and
+// triangles they submit and the bytes uploaded into buffers. GpuMesh counts
+// its own draws and uploads; the other per-frame upload sites call
+// countUpload. Indirect draws count as calls only, their sizes being
+// written on the GPU. Render thread only
+class RenderStats {
+public:
+    struct Counters {
+        int draw_calls;
+        uint64_t vertices;  // Indices or vertices read, times the instances
+        uint64_t triangles; // Of triangle draws; lines and patches are expanded on the GPU
+        uint64_t upload_bytes;
+    };
+    
+    static void countDraw(uint64_t vertices, uint64_t triangles) {
+        frame.draw_calls++;
+        frame.vertices += vertices;
+        frame.triangles += triangles;
+    }
+    static void countUpload(size_t bytes) { frame.upload_bytes += bytes; }
+    
+    // Close the frame's counters; getLastFrame reports them until the next one
+    static void endFrame();
+    static const Counters& getLastFrame() { return last_frame; }
+
+private:
+    static Counters frame;
+    static Counters last_frame;
+};
+
+#endif // RENDER_STATS_H
@@ -0,0 +1,234 @@
+#include "resource_bundle.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char RESOURCE_BUNDLE_MAGIC[8] = {'R', 'E', 'S', 'B', 'N', 'D', 'L', '1'};
+static const uint32_t RESOURCE_BUNDLE_BYTE_ORDER = 0x01020304u;
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + RESOURCE_BUNDLE_ALIGNMENT - 1) / RESOURCE_BUNDLE_ALIGNMENT * RESOURCE_BUNDLE_ALIGNMENT;
+}
+
+static bool readFileBytes(const std::string& path, std::vector<unsigned char>& out) {
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    out.resize((size_t)in.tellg());
+    in.seekg(0);
+    return out.empty() || in.read(reinterpret_cast<char*>(out.data()), out.size());
+}
+
+// === WRITER ===
+
+bool writeResourceBundle(const std::vector<std::string>& files, const std::string& path, std::string& error) {
+    // === LAYOUT: HEADER AND INDEX, THEN EVERY FILE ON AN ALIGNED OFFSET ===
+    ResourceBundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RESOURCE_BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = RESOURCE_BUNDLE_VERSION;
+    header.byte_order = RESOURCE_BUNDLE_BYTE_ORDER;
+    header.entry_size = sizeof(ResourceBundleEntry);
+    header.entry_count = files.size();
+    std::vector<ResourceBundleEntry> entries(files.size());
+    std::vector<std::vector<unsigned char> > contents(files.size());
+    uint64_t offset = alignOffset(sizeof(ResourceBundleHeader) + entries.size() * sizeof(ResourceBundleEntry));
+    for (size_t i = 0; i < files.size(); i++) {
+        ResourceBundleEntry& entry = entries[i];
+        memset(&entry, 0, sizeof(entry));
+        const std::string name = files[i].substr(files[i].find_last_of('/') + 1);
+        if (name.size() >= sizeof(entry.name)) {
+            error = "name too long for a resource bundle: " + name;
+            return false;
+        }
+        if (!readFileBytes(files[i], contents[i])) {
+            error = "cannot read " + files[i];
+            return false;
+        }
+        memcpy(entry.name, name.c_str(), name.size());
+        entry.offset = offset;
+        entry.size = contents[i].size();
+        offset = alignOffset(offset + entry.size);
+    }
+    header.file_size = offset;
+    
+    // === WRITE NEXT TO THE TARGET, THEN RENAME OVER IT ===
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot create " + temporary;
+        return false;
+    }
+    static const char padding[RESOURCE_BUNDLE_ALIGNMENT] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ResourceBundleEntry));
+    uint64_t written = sizeof(header) + entries.size() * sizeof(ResourceBundleEntry);
+    for (size_t i = 0; i < files.size(); i++) {
+        out.write(padding, entries[i].offset - written);
+        out.write(reinterpret_cast<const char*>(contents[i].data()), entries[i].size);
+        written = entries[i].offset + entries[i].size;
+    }
+    out.write(padding, header.file_size - written);
+    out.close();
+    if (!out) {
+        error = "write to " + temporary + " failed";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "cannot replace " + path;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// === MAPPED FILE ===
+
+ResourceBundle::ResourceBundle() : data(nullptr), size(0), mapped(false) {}
+
+ResourceBundle::~ResourceBundle() {
+    close();
+}
+
+ResourceBundle& ResourceBundle::shared() {
+    static ResourceBundle bundle;
+    return bundle;
+}
+
+std::string ResourceBundle::besideExecutable(const char* argv0, const std::string& file) {
+    std::string executable;
+#if defined(__linux__)
+    char link[4096];
+    const ssize_t length = readlink("/proc/self/exe", link, sizeof(link) - 1);
+    if (length > 0) executable.assign(link, length);
+#endif
+    if (executable.empty() && argv0) executable = argv0;
+    const size_t slash = executable.find_last_of("/\\");
+    return slash == std::string::npos ? file : executable.substr(0, slash + 1) + file;
+}
+
+void ResourceBundle::close() {
+#if !defined(_WIN32)
+    if (mapped) {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+#endif
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+    mapped = false;
+}
+
+bool ResourceBundle::open(const std::string& path, std::string& error) {
+    close();
+    
+    // === MAP THE WHOLE FILE READ-ONLY AND READ IT AHEAD ===
+#if defined(_WIN32)
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    size = in.tellg();
+    buffer.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(buffer.data()), size);
+    if (!in) {
+        error = "cannot read " + path;
+        close();
+        return false;
+    }
+    data = reinterpret_cast<const unsigned char*>(buffer.data());
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(ResourceBundleHeader))) {
+        ::close(fd);
+        error = path + " is not a resource bundle";
+        return false;
+    }
+    size = info.st_size;
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        size = 0;
+        error = "cannot map " + path;
+        return false;
+    }
+    // Every resource is read at startup: one sequential read-ahead of the
+    // whole file rather than a fault per page as the loaders touch them
+    madvise(view, size, MADV_WILLNEED);
+    data = static_cast<const unsigned char*>(view);
+    mapped = true;
+#endif
+
+    // === HEADER AND INDEX ===
+    const char* reason = nullptr;
+    const ResourceBundleHeader* header = reinterpret_cast<const ResourceBundleHeader*>(data);
+    if (memcmp(header->magic, RESOURCE_BUNDLE_MAGIC, sizeof(header->magic)) != 0) {
+        reason = "is not a resource bundle";
+    } else if (header->version != RESOURCE_BUNDLE_VERSION) {
+        reason = "has an unsupported version";
+    } else if (header->byte_order != RESOURCE_BUNDLE_BYTE_ORDER || header->entry_size != sizeof(ResourceBundleEntry)) {
+        reason = "was written for another byte order or struct layout";
+    } else if (header->file_size != size) {
+        reason = "is truncated";
+    } else if (header->entry_count > (size - sizeof(ResourceBundleHeader)) / sizeof(ResourceBundleEntry)) {
+        reason = "has an index outside the file";
+    } else {
+        for (int i = 0; i < getCount() && !reason; i++) {
+            const ResourceBundleEntry& entry = getEntry(i);
+            if (entry.offset % RESOURCE_BUNDLE_ALIGNMENT != 0 || entry.offset > size || entry.size > size - entry.offset) {
+                reason = "has a resource outside the file";
+            } else if (entry.name[sizeof(entry.name) - 1] != '\0') {
+                reason = "has an unterminated name";
+            }
+        }
+    }
+    if (reason) {
+        error = path + " " + reason;
+        close();
+        return false;
+    }
+    return true;
+}
+
+int ResourceBundle::getCount() const {
+    return data ? reinterpret_cast<const ResourceBundleHeader*>(data)->entry_count : 0;
+}
+
+const ResourceBundleEntry& ResourceBundle::getEntry(int index) const {
+    return reinterpret_cast<const ResourceBundleEntry*>(data + sizeof(ResourceBundleHeader))[index];
+}
+
+const unsigned char* ResourceBundle::find(const std::string& name, size_t& bytes) const {
+    // A few dozen entries: a scan is as quick as any index
+    for (int i = 0; i < getCount(); i++) {
+        const ResourceBundleEntry& entry = getEntry(i);
+        if (name == entry.name) {
+            bytes = entry.size;
+            return data + entry.offset;
+        }
+    }
+    return nullptr;
+}
+
+bool readResource(const std::string& name, std::vector<unsigned char>& out) {
+    size_t bytes = 0;
+    const unsigned char* bundled = ResourceBundle::shared().find(name, bytes);
+    if (bundled) {
+        out.assign(bundled, bundled + bytes);
+        return true;
+    }
+    return readFileBytes(name, out);
+}
@@ -0,0 +1,82 @@
+#ifndef RESOURCE_BUNDLE_H
+#define RESOURCE_BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Resource bundle: the files tree_demo reads at startup (the shaders, the
+// converted materials.ktx2 / materials.pack and the PNGs) in one file,
+// an index followed by the files verbatim, each 64-byte aligned like the
+// texture pack's blobs. It is mapped read-only and read ahead in one go,
+// so a cold start is a single sequential read instead of one seek per
+// file. It lives next to the executable (texture_convert --bundle writes
+// it), so the demo runs from any working directory.
+//
+// The loaders look a name up in the shared bundle first and fall back to
+// the file of that name relative to the working directory, so a tree
+// without a bundle, or a resource it doesn't hold, loads as before.
+// Files are native-endian; the header records the byte order
+
+static const uint32_t RESOURCE_BUNDLE_VERSION = 1;
+static const size_t RESOURCE_BUNDLE_ALIGNMENT = 64;
+
+struct ResourceBundleEntry {
+    char name[64];   // As the loaders ask for it ("v_simplest.glsl"), zero terminated
+    uint64_t offset; // From the start of the file
+    uint64_t size;
+};
+
+struct ResourceBundleHeader {
+    char magic[8];        // "RESBNDL1"
+    uint32_t version;     // RESOURCE_BUNDLE_VERSION
+    uint32_t byte_order;  // 0x01020304 as written
+    uint32_t entry_size;  // sizeof(ResourceBundleEntry)
+    uint32_t entry_count; // Entries right after the header
+    uint64_t file_size;
+};
+
+// Pack files into a bundle at path, each under its name without the
+// directory; false with error set when one can't be read or written
+bool writeResourceBundle(const std::vector<std::string>& files, const std::string& path, std::string& error);
+
+class ResourceBundle {
+private:
+    const unsigned char* data;
+    size_t size;
+    bool mapped;
+    std::vector<uint64_t> buffer; // Fallback storage when not mapped, 8-byte aligned
+    
+    ResourceBundle(const ResourceBundle&);
+    ResourceBundle& operator=(const ResourceBundle&);
+
+public:
+    ResourceBundle();
+    ~ResourceBundle();
+    
+    // The process's bundle, the one the loaders look in; closed until the
+    // program opens it
+    static ResourceBundle& shared();
+    // file in the directory of the running executable (argv0 where the
+    // platform can't say), or file itself when neither is known
+    static std::string besideExecutable(const char* argv0, const std::string& file);
+    
+    // Map path, check its header and index and read it ahead; on failure
+    // the bundle is closed and error says why
+    bool open(const std::string& path, std::string& error);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    
+    int getCount() const;
+    const ResourceBundleEntry& getEntry(int index) const;
+    // A resource's bytes in place and its size, or null when the bundle
+    // doesn't hold it. Valid while the bundle is open; 64-byte aligned
+    const unsigned char* find(const std::string& name, size_t& bytes) const;
+};
+
+// The bytes of name from the shared bundle, or else of the file name;
+// false when neither has it
+bool readResource(const std::string& name, std::vector<unsigned char>& out);
+
+#endif // RESOURCE_BUNDLE_H
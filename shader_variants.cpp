@@ -0,0 +1,54 @@
+#include "shader_variants.h"
+#include <algorithm>
+#include <sstream>
+
+ShaderVariants::ShaderVariants(const std::string& vertex, const std::string& fragment)
+    : vertex_file(vertex), fragment_file(fragment) {}
+
+void ShaderVariants::setGeometryShader(const std::string& define, const std::string& file) {
+    geometry_define = define;
+    geometry_file = file;
+}
+
+void ShaderVariants::setTessellationShaders(const std::string& define, const std::string& control,
+                                            const std::string& evaluation) {
+    tessellation_define = define;
+    tess_control_file = control;
+    tess_evaluation_file = evaluation;
+}
+
+bool ShaderVariants::includes(const std::vector<std::string>& defines, const std::string& define) {
+    return !define.empty() && std::find(defines.begin(), defines.end(), define) != defines.end();
+}
+
+std::vector<std::string> ShaderVariants::normalize(const std::string& defines) {
+    std::vector<std::string> names;
+    std::istringstream in(defines);
+    std::string name;
+    while (in >> name) {
+        names.push_back(name);
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    return names;
+}
+
+ShaderProgram* ShaderVariants::get(const std::string& defines) {
+    std::vector<std::string> names = normalize(defines);
+    std::string key;
+    for (const std::string& name : names) {
+        key += (key.empty() ? "" : " ") + name;
+    }
+    
+    std::unique_ptr<ShaderProgram>& program = programs[key];
+    if (!program) {
+        const char* geometry = includes(names, geometry_define) ? geometry_file.c_str() : NULL;
+        if (includes(names, tessellation_define)) {
+            program.reset(new ShaderProgram(vertex_file.c_str(), tess_control_file.c_str(),
+                                            tess_evaluation_file.c_str(), geometry, fragment_file.c_str(), names));
+        } else {
+            program.reset(new ShaderProgram(vertex_file.c_str(), geometry, fragment_file.c_str(), names));
+        }
+    }
+    return program.get();
+}
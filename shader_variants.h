@@ -0,0 +1,47 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include "shaderprogram.h"
+
+// Specialized programs built from one vertex/fragment shader pair, one per
+// set of #defines. A set is named by a space-separated list ("LEAF",
+// "EMISSIVE", "" for the plain program); order and repeats don't matter, so
+// equal sets share one program, submitted on first request. The shaders
+// must pin their vertex inputs with layout(location) so a VAO recorded
+// against one variant draws with any other. Sets naming the geometry or
+// tessellation define also get those stages
+class ShaderVariants {
+private:
+    std::string vertex_file;
+    std::string fragment_file;
+    std::string geometry_define;
+    std::string geometry_file;
+    std::string tessellation_define;
+    std::string tess_control_file;
+    std::string tess_evaluation_file;
+    
+    static bool includes(const std::vector<std::string>& defines, const std::string& define);
+    std::map<std::string, std::unique_ptr<ShaderProgram>> programs; // By normalized define list
+
+public:
+    ShaderVariants(const std::string& vertex, const std::string& fragment);
+    // Link file as the geometry stage of the sets that include define;
+    // affects the programs submitted afterwards
+    void setGeometryShader(const std::string& define, const std::string& file);
+    // The same for a tessellation control and evaluation shader pair (GL 4.0)
+    void setTessellationShaders(const std::string& define, const std::string& control,
+                                const std::string& evaluation);
+    
+    // The program for a define set; the first request submits its compile
+    ShaderProgram* get(const std::string& defines);
+    int getCount() const { return programs.size(); }
+    void clear() { programs.clear(); }
+    
+    // Sorted, deduplicated define names
+    static std::vector<std::string> normalize(const std::string& defines);
+};
+
+#endif // SHADER_VARIANTS_H
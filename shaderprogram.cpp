@@ -14,16 +14,31 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "shaderprogram.h"
+#include "logging.h"
+#include "profiler.h"
+#include "resource_bundle.h"
+#include <algorithm>
+#include <string.h>
 
 
 
 
-//Procedure reads a file into an array of chars
+//Procedure reads a file into an array of chars, from the resource bundle
+//when it holds the file
 char* ShaderProgram::readFile(const char* fileName) {
 	int filesize;
 	FILE *plik;
 	char* result;
 
+	size_t bundled=0;
+	const unsigned char* bytes=ResourceBundle::shared().find(fileName, bundled);
+	if (bytes != NULL) {
+		result = new char[bundled + 1];
+		memcpy(result, bytes, bundled);
+		result[bundled] = 0;
+		return result;
+	}
+
 	#pragma warning(suppress : 4996) //Turn off an error in Visual Studio stemming from Microsoft not adhering to standards
 	plik=fopen(fileName,"rb");
 	if (plik != NULL) {
@@ -44,20 +59,42 @@ char* ShaderProgram::readFile(const char* fileName) {
 }
 
 
-//The method reads a shader code, compiles it and returns a corresponding handle
-GLuint ShaderProgram::loadShader(GLenum shaderType,const char* fileName) {
+//The method reads a shader file and returns its code with the defines inserted.
+//They must follow the #version line, so they go after it together with a
+//#line resetting the numbering to the file's own
+std::string ShaderProgram::shaderSource(const char* fileName,const std::string& defines) {
+	char* fileText=readFile(fileName);
+	std::string text=(fileText!=NULL) ? fileText : "";
+	delete []fileText;
+	sourceTexts.push_back(std::make_pair(std::string(fileName), text));
+
+	size_t body=0;
+	if (text.compare(0, 8, "#version")==0) {
+		body=text.find('\n');
+		body=(body!=std::string::npos) ? body+1 : text.size();
+	}
+	std::string version=text.substr(0, body);
+	if (!version.empty() && version[version.size()-1]!='\n') version+='\n';
+	return version+defines+"#line "+(version.empty() ? "1" : "2")+"\n"+text.substr(body);
+}
+
+//The method submits a shader code for compilation and returns a corresponding
+//handle. Its log is read in finish(), as asking for it waits for the compiler
+GLuint ShaderProgram::loadShader(GLenum shaderType,const std::string& source) {
 	//Create a shader handle
-	GLuint shader=glCreateShader(shaderType);//shaderType to GL_VERTEX_SHADER, GL_GEOMETRY_SHADER lub GL_FRAGMENT_SHADER
-	//Read a shader source file into an array of chars
-	const GLchar* shaderSource=readFile(fileName);
+	GLuint shader=glCreateShader(shaderType);//shaderType to GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER lub GL_COMPUTE_SHADER
 	//Associate source code with the shader handle
+	const GLchar* shaderSource=source.c_str();
 	glShaderSource(shader,1,&shaderSource,NULL);
 	//Compile source code
 	glCompileShader(shader);
-	//Delete source code from memory (it is no longer needed)
-	delete []shaderSource;
 
-	//Download a compilation error log and display it
+	//Return shader handle
+	return shader;
+}
+
+//Download a compilation error log and display it
+static void printShaderLog(GLuint shader) {
 	int infologLength = 0;
 	int charsWritten  = 0;
 	char *infoLog;
@@ -67,40 +104,282 @@ GLuint ShaderProgram::loadShader(GLenum shaderType,const char* fileName) {
 	if (infologLength > 1) {
 		infoLog = new char[infologLength];
 		glGetShaderInfoLog(shader, infologLength, &charsWritten, infoLog);
-		printf("%s\n",infoLog);
+		Log::write(LogLevel::Error,LogCategory::Shader,infoLog);
 		delete []infoLog;
 	}
+}
 
-	//Return shader handle
-	return shader;
+//Let the driver compile and link on its own threads where it offers
+//GL_KHR_parallel_shader_compile (or the ARB version); without it compiles
+//may still run in the background, depending on the driver
+void ShaderProgram::enableParallelCompile() {
+	if (glewIsSupported("GL_KHR_parallel_shader_compile")) glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+	else if (glewIsSupported("GL_ARB_parallel_shader_compile")) glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+	else return;
+	parallelCompile=true;
 }
 
-ShaderProgram::ShaderProgram(const char* vertexShaderFile,const char* geometryShaderFile,const char* fragmentShaderFile) {
-	//Load vertex shader
-	printf("Loading vertex shader...\n");
-	vertexShader=loadShader(GL_VERTEX_SHADER,vertexShaderFile);
+//With parallel compile the link status can be polled without waiting
+bool ShaderProgram::parallelCompile=false;
 
-	//Load geometry shader
-	if (geometryShaderFile!=NULL) {
-		printf("Loading geometry shader...\n");
-		geometryShader=loadShader(GL_GEOMETRY_SHADER,geometryShaderFile);
-	} else {
-		geometryShader=0;
+//Directory of the program binary cache, empty when it is off
+std::string ShaderProgram::binaryCacheDirectory;
+
+void ShaderProgram::setBinaryCache(const std::string& directory) {
+	binaryCacheDirectory=directory;
+}
+
+//Cache files begin with this tag; a change of layout changes the version
+static const char binaryCacheTag[8]={'G','L','P','B','I','N','0','1'};
+
+//The cache file for key: an FNV-1a hash of the key names the file, and the
+//file repeats the key so a hash collision reads as a miss. Empty when the
+//cache is off or the driver offers no binary formats
+std::string ShaderProgram::binaryCachePath(const std::string& key) {
+	if (binaryCacheDirectory.empty()) return "";
+	GLint formats=0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats<=0) return "";
+
+	unsigned long long hash=14695981039346656037ULL;
+	for (size_t i=0;i<key.size();i++) {
+		hash^=(unsigned char)key[i];
+		hash*=1099511628211ULL;
 	}
+	char name[32];
+	snprintf(name, sizeof(name), "shader_%016llx.bin", hash);
+	return binaryCacheDirectory+"/"+name;
+}
 
-	//Load fragment shader
-	printf("Loading fragment shader...\n");
-	fragmentShader=loadShader(GL_FRAGMENT_SHADER,fragmentShaderFile);
+//Load the program from a cache file written for key. False on a missing,
+//stale or unreadable file, or when the driver rejects the binary (after a
+//driver update, for instance)
+bool ShaderProgram::loadBinary(const std::string& path,const std::string& key) {
+	#pragma warning(suppress : 4996) //Turn off an error in Visual Studio stemming from Microsoft not adhering to standards
+	FILE* file=fopen(path.c_str(),"rb");
+	if (file==NULL) return false;
+
+	char tag[sizeof(binaryCacheTag)];
+	unsigned int keyLength=0, format=0, length=0;
+	bool valid=fread(tag, 1, sizeof(tag), file)==sizeof(tag) && memcmp(tag, binaryCacheTag, sizeof(tag))==0
+		&& fread(&keyLength, sizeof(keyLength), 1, file)==1 && keyLength==key.size();
+	std::vector<char> data;
+	if (valid) {
+		data.resize(keyLength);
+		valid=fread(data.data(), 1, keyLength, file)==keyLength && memcmp(data.data(), key.data(), keyLength)==0
+			&& fread(&format, sizeof(format), 1, file)==1 && fread(&length, sizeof(length), 1, file)==1 && length>0;
+	}
+	if (valid) {
+		data.resize(length);
+		valid=fread(data.data(), 1, length, file)==length;
+	}
+	fclose(file);
+	if (!valid) return false;
+
+	glProgramBinary(shaderProgram, format, data.data(), length);
+	GLint linked=GL_FALSE;
+	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &linked);
+	return linked==GL_TRUE;
+}
+
+//Write the linked program to the cache file for key
+void ShaderProgram::saveBinary(const std::string& path,const std::string& key) {
+	GLint linked=GL_FALSE, length=0;
+	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &linked);
+	glGetProgramiv(shaderProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (linked!=GL_TRUE || length<=0) return;
+	std::vector<char> data(length);
+	GLenum format=0;
+	glGetProgramBinary(shaderProgram, length, &length, &format, data.data());
+
+	#pragma warning(suppress : 4996) //Turn off an error in Visual Studio stemming from Microsoft not adhering to standards
+	FILE* file=fopen(path.c_str(),"wb");
+	if (file==NULL) return;
+	unsigned int keyLength=key.size(), binaryFormat=format, binaryLength=length;
+	bool written=fwrite(binaryCacheTag, 1, sizeof(binaryCacheTag), file)==sizeof(binaryCacheTag)
+		&& fwrite(&keyLength, sizeof(keyLength), 1, file)==1 && fwrite(key.data(), 1, keyLength, file)==keyLength
+		&& fwrite(&binaryFormat, sizeof(binaryFormat), 1, file)==1 && fwrite(&binaryLength, sizeof(binaryLength), 1, file)==1
+		&& fwrite(data.data(), 1, binaryLength, file)==binaryLength;
+	//A truncated file would fail its length check; remove it anyway
+	if (fclose(file)!=0 || !written) remove(path.c_str());
+}
+
+//One #define line per entry, shared by every stage
+std::string ShaderProgram::defineLines(const std::vector<std::string>& defines) {
+	std::string lines;
+	for (size_t i=0;i<defines.size();i++) {
+		size_t space=defines[i].find(' ');
+		lines+="#define "+defines[i]+(space==std::string::npos ? " 1" : "")+"\n";
+	}
+	return lines;
+}
+
+std::string ShaderProgram::driverIdentity() {
+	std::string identity;
+	const GLenum names[3]={GL_VENDOR, GL_RENDERER, GL_VERSION};
+	for (int i=0;i<3;i++) {
+		const GLubyte* text=glGetString(names[i]);
+		identity+=std::string(text!=NULL ? (const char*)text : "")+"\n";
+	}
+	return identity;
+}
+
+ShaderProgram::ShaderProgram(const char* vertexShaderFile,const char* geometryShaderFile,const char* fragmentShaderFile,
+	const std::vector<std::string>& defines) {
+	submit(vertexShaderFile,NULL,NULL,geometryShaderFile,fragmentShaderFile,defines);
+}
+
+ShaderProgram::ShaderProgram(const char* vertexShaderFile,const char* tessControlShaderFile,
+	const char* tessEvaluationShaderFile,const char* geometryShaderFile,const char* fragmentShaderFile,
+	const std::vector<std::string>& defines) {
+	submit(vertexShaderFile,tessControlShaderFile,tessEvaluationShaderFile,geometryShaderFile,fragmentShaderFile,defines);
+}
+
+void ShaderProgram::submit(const char* vertexShaderFile,const char* tessControlShaderFile,
+	const char* tessEvaluationShaderFile,const char* geometryShaderFile,const char* fragmentShaderFile,
+	const std::vector<std::string>& defines) {
+	std::string lines=defineLines(defines);
+	PROFILE_SCOPE("ShaderProgram::submit");
+	bool tessellated=tessControlShaderFile!=NULL && tessEvaluationShaderFile!=NULL;
+	vertexFile=vertexShaderFile;
+	tessControlFile=tessellated ? tessControlShaderFile : "";
+	tessEvaluationFile=tessellated ? tessEvaluationShaderFile : "";
+	geometryFile=(geometryShaderFile!=NULL) ? geometryShaderFile : "";
+	fragmentFile=fragmentShaderFile;
+	sourceDefines=defines;
+	livePrograms.push_back(this);
+
+	//Read the sources; with the driver's identity they key the binary cache
+	std::string vertexSource=shaderSource(vertexShaderFile,lines);
+	std::string tessControlSource=tessellated ? shaderSource(tessControlShaderFile,lines) : "";
+	std::string tessEvaluationSource=tessellated ? shaderSource(tessEvaluationShaderFile,lines) : "";
+	std::string geometrySource=(geometryShaderFile!=NULL) ? shaderSource(geometryShaderFile,lines) : "";
+	std::string fragmentSource=shaderSource(fragmentShaderFile,lines);
+	vertexShader=0;
+	tessControlShader=0;
+	tessEvaluationShader=0;
+	geometryShader=0;
+	fragmentShader=0;
+	computeShader=0;
+	pending=false;
 
 	//Generate shader program handle
 	shaderProgram=glCreateProgram();
 
-	//Attach shaders and link shader program
-	glAttachShader(shaderProgram,vertexShader);
-	glAttachShader(shaderProgram,fragmentShader);
-	if (geometryShaderFile!=NULL) glAttachShader(shaderProgram,geometryShader);
+	//The tessellation stages only join the key when present, so the keys of
+	//the other programs stay as they were
+	std::string key=driverIdentity()+vertexSource+'\0'+geometrySource+'\0'+fragmentSource;
+	if (tessellated) key+=std::string("\0tessellation\0",14)+tessControlSource+'\0'+tessEvaluationSource;
+	std::string cachePath=binaryCachePath(key);
+
+	if (!cachePath.empty() && loadBinary(cachePath,key)) {
+		LOG_INFO(Shader) << "Shader program loaded from " << cachePath;
+	} else {
+		//A rejected binary leaves the program unusable, so start over
+		if (!cachePath.empty()) {
+			glDeleteProgram(shaderProgram);
+			shaderProgram=glCreateProgram();
+		}
+
+		//Load vertex shader
+		LOG_INFO(Shader) << "Loading vertex shader...";
+		vertexShader=loadShader(GL_VERTEX_SHADER,vertexSource);
+
+		//Load tessellation shaders (GL 4.0)
+		if (tessellated) {
+			LOG_INFO(Shader) << "Loading tessellation shaders...";
+			tessControlShader=loadShader(GL_TESS_CONTROL_SHADER,tessControlSource);
+			tessEvaluationShader=loadShader(GL_TESS_EVALUATION_SHADER,tessEvaluationSource);
+		}
+
+		//Load geometry shader
+		if (geometryShaderFile!=NULL) {
+			LOG_INFO(Shader) << "Loading geometry shader...";
+			geometryShader=loadShader(GL_GEOMETRY_SHADER,geometrySource);
+		}
+
+		//Load fragment shader
+		LOG_INFO(Shader) << "Loading fragment shader...";
+		fragmentShader=loadShader(GL_FRAGMENT_SHADER,fragmentSource);
+
+		//Attach shaders and link shader program
+		glAttachShader(shaderProgram,vertexShader);
+		glAttachShader(shaderProgram,fragmentShader);
+		if (tessellated) {
+			glAttachShader(shaderProgram,tessControlShader);
+			glAttachShader(shaderProgram,tessEvaluationShader);
+		}
+		if (geometryShaderFile!=NULL) glAttachShader(shaderProgram,geometryShader);
+		if (!cachePath.empty()) glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(shaderProgram);
+
+		//The link runs on while the caller goes on; finish() collects it
+		pending=true;
+		pendingCachePath=cachePath;
+		pendingCacheKey=key;
+		return;
+	}
+
+	introspect();
+	LOG_INFO(Shader) << "Shader program created";
+}
+
+ShaderProgram::ShaderProgram(const char* computeShaderFile,const std::vector<std::string>& defines) {
+	PROFILE_SCOPE("ShaderProgram::submit");
+	computeFile=computeShaderFile;
+	sourceDefines=defines;
+	livePrograms.push_back(this);
+	std::string computeSource=shaderSource(computeShaderFile,defineLines(defines));
+	vertexShader=0;
+	tessControlShader=0;
+	tessEvaluationShader=0;
+	geometryShader=0;
+	fragmentShader=0;
+	computeShader=0;
+	pending=false;
+
+	shaderProgram=glCreateProgram();
+
+	//Marked so it can never share a key with a vertex shader of the same text
+	std::string key=driverIdentity()+"compute"+'\0'+computeSource;
+	std::string cachePath=binaryCachePath(key);
+
+	if (!cachePath.empty() && loadBinary(cachePath,key)) {
+		LOG_INFO(Shader) << "Shader program loaded from " << cachePath;
+		introspect();
+		LOG_INFO(Shader) << "Shader program created";
+		return;
+	}
+	if (!cachePath.empty()) {
+		glDeleteProgram(shaderProgram);
+		shaderProgram=glCreateProgram();
+	}
+
+	LOG_INFO(Shader) << "Loading compute shader...";
+	computeShader=loadShader(GL_COMPUTE_SHADER,computeSource);
+	glAttachShader(shaderProgram,computeShader);
+	if (!cachePath.empty()) glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(shaderProgram);
 
+	pending=true;
+	pendingCachePath=cachePath;
+	pendingCacheKey=key;
+}
+
+//Wait for a submitted link, then display the logs, read the variables, make
+//the recorded uniform block bindings and store the binary in the cache
+void ShaderProgram::finish() {
+	if (!pending) return;
+	pending=false;
+	PROFILE_SCOPE("ShaderProgram::finish");
+
+	if (vertexShader!=0) printShaderLog(vertexShader);
+	if (tessControlShader!=0) printShaderLog(tessControlShader);
+	if (tessEvaluationShader!=0) printShaderLog(tessEvaluationShader);
+	if (geometryShader!=0) printShaderLog(geometryShader);
+	if (fragmentShader!=0) printShaderLog(fragmentShader);
+	if (computeShader!=0) printShaderLog(computeShader);
+
 	//Download an error log and display it
 	int infologLength = 0;
 	int charsWritten  = 0;
@@ -112,23 +391,42 @@ ShaderProgram::ShaderProgram(const char* vertexShaderFile,const char* geometrySh
 	{
 		infoLog = new char[infologLength];
 		glGetProgramInfoLog(shaderProgram, infologLength, &charsWritten, infoLog);
-		printf("%s\n",infoLog);
+		Log::write(LogLevel::Error,LogCategory::Shader,infoLog);
 		delete []infoLog;
 	}
 
-	printf("Shader program created \n");
+	if (!pendingCachePath.empty()) saveBinary(pendingCachePath,pendingCacheKey);
+	pendingCachePath.clear();
+	pendingCacheKey.clear();
+
+	introspect();
+	//A block this variant does not use is skipped, as bindUniformBlock would
+	for (size_t i=0;i<pendingBlocks.size();i++) {
+		bindUniformBlock(pendingBlocks[i].first.c_str(), pendingBlocks[i].second);
+	}
+	pendingBlocks.clear();
+	LOG_INFO(Shader) << "Shader program created";
 }
 
 ShaderProgram::~ShaderProgram() {
-	//Detach shaders from program
-	glDetachShader(shaderProgram, vertexShader);
+	std::vector<ShaderProgram*>::iterator live=std::find(livePrograms.begin(), livePrograms.end(), this);
+	if (live!=livePrograms.end()) livePrograms.erase(live);
+
+	//Detach shaders from program (a program loaded from the cache has none)
+	if (vertexShader!=0) glDetachShader(shaderProgram, vertexShader);
+	if (tessControlShader!=0) glDetachShader(shaderProgram, tessControlShader);
+	if (tessEvaluationShader!=0) glDetachShader(shaderProgram, tessEvaluationShader);
 	if (geometryShader!=0) glDetachShader(shaderProgram, geometryShader);
-	glDetachShader(shaderProgram, fragmentShader);
+	if (fragmentShader!=0) glDetachShader(shaderProgram, fragmentShader);
+	if (computeShader!=0) glDetachShader(shaderProgram, computeShader);
 
 	//Delete shaders
-	glDeleteShader(vertexShader);
+	if (vertexShader!=0) glDeleteShader(vertexShader);
+	if (tessControlShader!=0) glDeleteShader(tessControlShader);
+	if (tessEvaluationShader!=0) glDeleteShader(tessEvaluationShader);
 	if (geometryShader!=0) glDeleteShader(geometryShader);
-	glDeleteShader(fragmentShader);
+	if (fragmentShader!=0) glDeleteShader(fragmentShader);
+	if (computeShader!=0) glDeleteShader(computeShader);
 
 	//Delete program
 	glDeleteProgram(shaderProgram);
@@ -137,15 +435,234 @@ ShaderProgram::~ShaderProgram() {
 
 //Make the shader program active
 void ShaderProgram::use() {
+	finish();
 	glUseProgram(shaderProgram);
 }
 
+//Read every active uniform and attribute with its location. An array uniform
+//is listed as "name[0]" and is also entered under its bare name
+void ShaderProgram::introspect() {
+	GLint count=0;
+	GLint maxLength=0;
+	glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> name(std::max(maxLength, 1));
+	glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &count);
+	for (GLint i=0;i<count;i++) {
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(shaderProgram, i, name.size(), NULL, &size, &type, name.data());
+		Variable variable={name.data(), glGetUniformLocation(shaderProgram, name.data()), 0, {0}};
+		uniforms.push_back(variable);
+		size_t bracket=variable.name.find('[');
+		if (bracket!=std::string::npos) {
+			variable.name.erase(bracket);
+			uniforms.push_back(variable);
+		}
+	}
+
+	glGetProgramiv(shaderProgram, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+	name.resize(std::max(maxLength, 1));
+	glGetProgramiv(shaderProgram, GL_ACTIVE_ATTRIBUTES, &count);
+	for (GLint i=0;i<count;i++) {
+		GLint size;
+		GLenum type;
+		glGetActiveAttrib(shaderProgram, i, name.size(), NULL, &size, &type, name.data());
+		Variable variable={name.data(), glGetAttribLocation(shaderProgram, name.data()), 0, {0}};
+		attributes.push_back(variable);
+	}
+
+	struct ByName {
+		bool operator()(const Variable& x, const Variable& y) const { return x.name<y.name; }
+	};
+	std::sort(uniforms.begin(), uniforms.end(), ByName());
+	std::sort(attributes.begin(), attributes.end(), ByName());
+}
+
+//Binary search of a table by name. A name that is not listed (an inactive
+//variable, an array element past [0]) is resolved by the driver once and
+//inserted, -1 included
+ShaderProgram::Variable& ShaderProgram::find(std::vector<Variable>& table, const char* variableName, bool uniform) {
+	finish();
+	size_t low=0, high=table.size();
+	while (low<high) {
+		size_t mid=(low+high)/2;
+		if (strcmp(table[mid].name.c_str(), variableName)<0) low=mid+1;
+		else high=mid;
+	}
+	if (low<table.size() && table[low].name==variableName) return table[low];
+
+	GLint location=uniform ? glGetUniformLocation(shaderProgram,variableName) : glGetAttribLocation(shaderProgram,variableName);
+	Variable variable={variableName, location, 0, {0}};
+	return *table.insert(table.begin()+low, variable);
+}
+
 //Get the slot number corresponding to the uniform variableName
 GLuint ShaderProgram::u(const char* variableName) {
-	return glGetUniformLocation(shaderProgram,variableName);
+	return find(uniforms, variableName, true).location;
 }
 
 //Get the slot number corresponding to the attribute variableName
 GLuint ShaderProgram::a(const char* variableName) {
-	return glGetAttribLocation(shaderProgram,variableName);
+	return find(attributes, variableName, false).location;
+}
+
+//The uniform to set when value differs from its last one, recorded as the
+//new last value. The program keeps its uniform values while other programs
+//are in use, so an unchanged value needs no call
+ShaderProgram::Variable* ShaderProgram::changed(const char* variableName, const void* value, int bytes) {
+	Variable& variable=find(uniforms, variableName, true);
+	if (variable.location<0) return NULL;
+	if (variable.valueBytes==bytes && memcmp(variable.value, value, bytes)==0) return NULL;
+	memcpy(variable.value, value, bytes);
+	variable.valueBytes=bytes;
+	return &variable;
+}
+
+bool ShaderProgram::uniform1i(const char* variableName, GLint value) {
+	Variable* variable=changed(variableName, &value, sizeof(value));
+	if (variable!=NULL) glUniform1i(variable->location, value);
+	return variable!=NULL;
+}
+
+bool ShaderProgram::uniform1f(const char* variableName, GLfloat value) {
+	Variable* variable=changed(variableName, &value, sizeof(value));
+	if (variable!=NULL) glUniform1f(variable->location, value);
+	return variable!=NULL;
+}
+
+bool ShaderProgram::uniform3fv(const char* variableName, const GLfloat* value) {
+	Variable* variable=changed(variableName, value, 3*sizeof(GLfloat));
+	if (variable!=NULL) glUniform3fv(variable->location, 1, value);
+	return variable!=NULL;
+}
+
+bool ShaderProgram::uniformMatrix3fv(const char* variableName, const GLfloat* value) {
+	Variable* variable=changed(variableName, value, 9*sizeof(GLfloat));
+	if (variable!=NULL) glUniformMatrix3fv(variable->location, 1, false, value);
+	return variable!=NULL;
+}
+
+bool ShaderProgram::uniformMatrix4fv(const char* variableName, const GLfloat* value) {
+	Variable* variable=changed(variableName, value, 16*sizeof(GLfloat));
+	if (variable!=NULL) glUniformMatrix4fv(variable->location, 1, false, value);
+	return variable!=NULL;
+}
+
+//Connect the uniform block blockName to binding point binding, where a
+//buffer bound with glBindBufferBase supplies it. A program still linking
+//records the binding for finish()
+bool ShaderProgram::bindUniformBlock(const char* blockName, GLuint binding) {
+	blockBindings.push_back(std::make_pair(std::string(blockName), binding));
+	if (pending) {
+		pendingBlocks.push_back(std::make_pair(std::string(blockName), binding));
+		return true;
+	}
+	GLuint index=glGetUniformBlockIndex(shaderProgram, blockName);
+	if (index==GL_INVALID_INDEX) return false;
+	glUniformBlockBinding(shaderProgram, index, binding);
+	return true;
+}
+
+
+//Every program constructed and not yet destroyed, less those compiling as
+//another's reload
+std::vector<ShaderProgram*> ShaderProgram::livePrograms;
+
+//Whether a file the program was compiled from reads differently now. A file
+//is read once per poll however many programs share it
+bool ShaderProgram::sourcesChanged(std::map<std::string,std::string>& texts) {
+	for (size_t i=0;i<sourceTexts.size();i++) {
+		std::map<std::string,std::string>::iterator text=texts.find(sourceTexts[i].first);
+		if (text==texts.end()) {
+			char* fileText=readFile(sourceTexts[i].first.c_str());
+			text=texts.insert(std::make_pair(sourceTexts[i].first, std::string(fileText!=NULL ? fileText : ""))).first;
+			delete []fileText;
+		}
+		if (text->second!=sourceTexts[i].second) return true;
+	}
+	return false;
+}
+
+ShaderProgram* ShaderProgram::resubmit() {
+	if (!computeFile.empty()) return new ShaderProgram(computeFile.c_str(), sourceDefines);
+	const char* geometry=geometryFile.empty() ? NULL : geometryFile.c_str();
+	if (!tessControlFile.empty()) {
+		return new ShaderProgram(vertexFile.c_str(), tessControlFile.c_str(), tessEvaluationFile.c_str(), geometry,
+			fragmentFile.c_str(), sourceDefines);
+	}
+	return new ShaderProgram(vertexFile.c_str(), geometry, fragmentFile.c_str(), sourceDefines);
+}
+
+//Without parallel compile there is nothing to ask, and finish() waits
+bool ShaderProgram::linkDone() {
+	if (!pending || !parallelCompile) return true;
+	GLint done=GL_FALSE;
+	glGetProgramiv(shaderProgram, GL_COMPLETION_STATUS_KHR, &done);
+	return done==GL_TRUE;
+}
+
+void ShaderProgram::swapProgram(ShaderProgram& other) {
+	std::swap(shaderProgram, other.shaderProgram);
+	std::swap(vertexShader, other.vertexShader);
+	std::swap(tessControlShader, other.tessControlShader);
+	std::swap(tessEvaluationShader, other.tessEvaluationShader);
+	std::swap(geometryShader, other.geometryShader);
+	std::swap(fragmentShader, other.fragmentShader);
+	std::swap(computeShader, other.computeShader);
+	std::swap(pending, other.pending);
+	std::swap(pendingCachePath, other.pendingCachePath);
+	std::swap(pendingCacheKey, other.pendingCacheKey);
+	std::swap(pendingBlocks, other.pendingBlocks);
+	std::swap(uniforms, other.uniforms);
+	std::swap(attributes, other.attributes);
+}
+
+int ShaderProgram::pendingLinks() {
+	int pendingCount=0;
+	for (size_t i=0;i<livePrograms.size();i++) {
+		if (!livePrograms[i]->linkDone()) pendingCount++;
+	}
+	return pendingCount;
+}
+
+//Submit the programs whose files changed, and collect the reloads whose
+//links are done. The new program gets the running one's uniform block
+//bindings; its uniform tables start empty, so every value is set again
+int ShaderProgram::reloadChanged() {
+	std::map<std::string,std::string> texts;
+	int swapped=0;
+	for (size_t i=0;i<livePrograms.size();i++) {
+		ShaderProgram* program=livePrograms[i];
+		if (!program->reloaded) {
+			if (!program->sourcesChanged(texts)) continue;
+			LOG_INFO(Shader) << "Reloading " << (program->computeFile.empty() ? program->vertexFile : program->computeFile)
+				<< " (" << program->sourceDefines.size() << " defines)";
+			ShaderProgram* next=program->resubmit();
+			//Constructed last, so it is the last entry
+			livePrograms.pop_back();
+			program->reloaded.reset(next);
+			for (size_t b=0;b<program->blockBindings.size();b++) {
+				next->bindUniformBlock(program->blockBindings[b].first.c_str(), program->blockBindings[b].second);
+			}
+			continue;
+		}
+		if (!program->reloaded->linkDone()) continue;
+
+		ShaderProgram& next=*program->reloaded;
+		next.finish();
+		GLint linked=GL_FALSE;
+		glGetProgramiv(next.shaderProgram, GL_LINK_STATUS, &linked);
+		//The failed text is remembered too, so only a further change retries
+		program->sourceTexts.swap(next.sourceTexts);
+		if (linked==GL_TRUE) {
+			program->swapProgram(next);
+			swapped++;
+			LOG_INFO(Shader) << "Shader program reloaded";
+		} else {
+			LOG_ERROR(Shader) << "Reloaded shader program failed to link; the running one stays";
+		}
+		//Deletes whichever GL program lost
+		program->reloaded.reset();
+	}
+	return swapped;
 }
@@ -19,21 +19,112 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "GL/glew.h"
 #include "stdio.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 class ShaderProgram {
 private:
 	GLuint shaderProgram; //Shader program handle
 	GLuint vertexShader; //Vertex shader handle
+	GLuint tessControlShader; //Tessellation control shader handle
+	GLuint tessEvaluationShader; //Tessellation evaluation shader handle
 	GLuint geometryShader; //Geometry shader handle
 	GLuint fragmentShader; //Fragment shader handle
+	GLuint computeShader; //Compute shader handle, only in a compute program
+
+	//A program compiled from source is linked without waiting; the first
+	//call that needs the result waits in finish()
+	bool pending;
+	std::string pendingCachePath; //Where finish() saves the binary, empty = nowhere
+	std::string pendingCacheKey;
+	std::vector<std::pair<std::string,GLuint> > pendingBlocks; //bindUniformBlock calls made while linking
+	std::vector<std::pair<std::string,GLuint> > blockBindings; //Every bindUniformBlock call, for a reloaded program
+
+	//What the program was built from, for reloadChanged(): the stage files
+	//("" = no such stage), the defines and each file's text as compiled
+	std::string vertexFile, tessControlFile, tessEvaluationFile, geometryFile, fragmentFile, computeFile;
+	std::vector<std::string> sourceDefines;
+	std::vector<std::pair<std::string,std::string> > sourceTexts;
+	std::unique_ptr<ShaderProgram> reloaded; //The program from changed files while it compiles
+	static std::vector<ShaderProgram*> livePrograms;
+	static bool parallelCompile;
+	bool sourcesChanged(std::map<std::string,std::string>& texts); //texts caches the files read during one poll
+	ShaderProgram* resubmit(); //A new program from the same files and defines
+	bool linkDone(); //Whether finish() would return without waiting
+	void swapProgram(ShaderProgram& other); //Exchanges the GL objects and everything read from them
+
+	//Active variables read back after linking, sorted by name, so lookups in
+	//the frame loop never reach the driver
+	struct Variable {
+		std::string name;
+		GLint location;
+		int valueBytes; //Size of the last value set through the uniform setters, 0 = none
+		unsigned char value[16*sizeof(GLfloat)];
+	};
+	std::vector<Variable> uniforms;
+	std::vector<Variable> attributes;
+	void introspect(); //Fills the tables from GL_ACTIVE_UNIFORMS and GL_ACTIVE_ATTRIBUTES
+	Variable& find(std::vector<Variable>& table, const char* variableName, bool uniform); //Unknown names are asked once and remembered
+	Variable* changed(const char* variableName, const void* value, int bytes); //The uniform to set, or NULL when it already holds value
 	char* readFile(const char* fileName); //File reading method
-	GLuint loadShader(GLenum shaderType,const char* fileName); //Method reads shader source file, compiles it and returns the corresponding handle
+	std::string shaderSource(const char* fileName,const std::string& defines); //Method reads shader source file and injects defines after #version
+	static std::string defineLines(const std::vector<std::string>& defines); //The #define lines injected into every stage
+	static std::string driverIdentity(); //Vendor, renderer and version, the start of every cache key
+	GLuint loadShader(GLenum shaderType,const std::string& source); //Method submits shader source for compilation and returns the corresponding handle
+	//Reads, submits and links the stages the constructors name; NULL skips one
+	void submit(const char* vertexShaderFile,const char* tessControlShaderFile,const char* tessEvaluationShaderFile,
+		const char* geometryShaderFile,const char* fragmentShaderFile,const std::vector<std::string>& defines);
+	static std::string binaryCacheDirectory;
+	std::string binaryCachePath(const std::string& key); //Cache file for a program keyed by its sources and the driver
+	bool loadBinary(const std::string& path,const std::string& key); //Links from a cached binary; false when missing, stale or rejected
+	void saveBinary(const std::string& path,const std::string& key); //Stores the linked binary for the next start
 public:
-	ShaderProgram(const char* vertexShaderFile,const char* geometryShaderFile,const char* fragmentShaderFile);
+	//Linked programs are cached as driver binaries in directory, keyed by
+	//their sources and the driver's vendor, renderer and version, and later
+	//programs load from there instead of compiling; "" (the default) turns
+	//the cache off
+	static void setBinaryCache(const std::string& directory);
+	//Lets the driver compile on its own threads where it can; call once after GLEW starts
+	static void enableParallelCompile();
+	//Shader hot reload, polled from the frame loop: every live program whose
+	//files changed is compiled again beside the running one, and swapped in
+	//once the link is done and succeeded; one that fails logs its errors and
+	//the running program stays. The ShaderProgram objects remain the same,
+	//so pointers to them stay valid, but the GL program in use changes:
+	//returns how many were swapped, after which the caller must use() again
+	static int reloadChanged();
+	//How many live programs are still compiling or linking; with parallel
+	//compile off none are, as their first use waits for them anyway
+	static int pendingLinks();
+	//The constructor only submits the sources: compiling and linking overlap
+	//whatever the caller does next, and the first use of the program (or finish)
+	//waits for them. defines are macro names (or "NAME value") each turned
+	//into a #define line for every stage
+	ShaderProgram(const char* vertexShaderFile,const char* geometryShaderFile,const char* fragmentShaderFile,
+		const std::vector<std::string>& defines=std::vector<std::string>());
+	//The same with tessellation control and evaluation shaders (GL 4.0);
+	//geometryShaderFile may be NULL
+	ShaderProgram(const char* vertexShaderFile,const char* tessControlShaderFile,const char* tessEvaluationShaderFile,
+		const char* geometryShaderFile,const char* fragmentShaderFile,const std::vector<std::string>& defines);
+	//A compute program (GL 4.3) from one shader, submitted and cached the
+	//same way; dispatch it with glDispatchCompute after use()
+	ShaderProgram(const char* computeShaderFile,const std::vector<std::string>& defines);
 	~ShaderProgram();
+	void finish(); //Waits for the link and reads the program back; the other methods call it
 	void use(); //Turns on the shader program
 	GLuint u(const char* variableName); //Returns the slot number corresponding to the uniform variableName
 	GLuint a(const char* variableName); //Returns the slot number corresponding to the attribute variableName
+	//Set a uniform of the program in use, skipping a repeat of the last value
+	//set; each returns whether a GL call was issued
+	bool uniform1i(const char* variableName, GLint value);
+	bool uniform1f(const char* variableName, GLfloat value);
+	bool uniform3fv(const char* variableName, const GLfloat* value);
+	bool uniformMatrix3fv(const char* variableName, const GLfloat* value);
+	bool uniformMatrix4fv(const char* variableName, const GLfloat* value);
+	bool bindUniformBlock(const char* blockName, GLuint binding); //Connects a uniform block to a buffer binding point; false when the program has no such block
 };
 
 
@@ -0,0 +1,336 @@
+#include "shadow_maps.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include "render_stats.h"
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+
+static const float SPLIT_LOG_SHARE = 0.75f; // Slice ends between uniform (0) and logarithmic (1) spacing
+static const float COVER_MARGIN = 0.25f;    // A refitted cascade covers this much more than its slice
+static const float TORCH_NEAR = 0.05f;
+
+// Each cube face's view direction and up, in GL's face order
+static const glm::vec3 FACE_DIRECTIONS[6] = {
+    glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+};
+static const glm::vec3 FACE_UPS[6] = {
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+    glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+};
+
+// A depth texture for the maps (compared, filtered 2x2 by the sampler) or
+// their caches (plain, only copied)
+static GLuint createDepthTexture(GLenum target, int size, int layers, bool compared) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    const int depth = target == GL_TEXTURE_2D_ARRAY ? layers : 6;
+    MemoryStats::trackTexture(texture, MemoryStats::textureBytes(GL_DEPTH_COMPONENT24, size, size, depth), "shadow maps");
+    if (target == GL_TEXTURE_2D_ARRAY) {
+        glTexImage3D(target, 0, GL_DEPTH_COMPONENT24, size, size, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    } else {
+        for (int face = 0; face < 6; face++) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                         GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        }
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, compared ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, compared ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+    if (target == GL_TEXTURE_2D_ARRAY) {
+        // Outside a cascade is unshadowed
+        const GLfloat border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, border);
+    } else {
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    if (compared) {
+        glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+    glBindTexture(target, 0);
+    return texture;
+}
+
+ShadowMaps::ShadowMaps()
+    : shadow_distance(40.0f), caster_reach(20.0f), sun_step(0.02f), sun_direction(0.0f, 1.0f, 0.0f),
+      sun_set(false), torch_position(0.0f), torch_radius(0.0f), torch_set(false), frame(0), cascade_size(0),
+      cube_size(0), cascade_texture(0), cascade_cache(0), cube_texture(0), cube_cache(0), framebuffer(0),
+      cache_framebuffer(0), ubo(0) {
+    for (int t = 0; t < CASCADES + CUBE_FACES; t++) {
+        targets[t].view_projection = glm::mat4(1.0f);
+        targets[t].interval = 1;
+        targets[t].static_stale = true;
+        targets[t].drawn = false;
+    }
+    for (int c = 0; c < CASCADES; c++) {
+        targets[c].interval = 1 << c;
+        cascade_center[c] = glm::vec3(0.0f);
+        cascade_radius[c] = 0.0f;
+        cascade_end[c] = 0.0f;
+    }
+}
+
+ShadowMaps::~ShadowMaps() {
+    release();
+}
+
+// === SETUP ===
+
+bool ShadowMaps::create(int new_cascade_size, int new_cube_size) {
+    release();
+    if (ubo == 0) glGenBuffers(1, &ubo);
+    ShadowUniforms off = ShadowUniforms();
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowUniforms), &off, GL_DYNAMIC_DRAW);
+    MemoryStats::trackBuffer(ubo, sizeof(ShadowUniforms), "shadow maps");
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+    
+    cascade_size = std::max(new_cascade_size, 0);
+    cube_size = std::max(new_cube_size, 0);
+    if (cascade_size == 0 && cube_size == 0) return true;
+    if (cascade_size > 0) {
+        cascade_texture = createDepthTexture(GL_TEXTURE_2D_ARRAY, cascade_size, CASCADES, true);
+        cascade_cache = createDepthTexture(GL_TEXTURE_2D_ARRAY, cascade_size, CASCADES, false);
+    }
+    if (cube_size > 0) {
+        cube_texture = createDepthTexture(GL_TEXTURE_CUBE_MAP, cube_size, 1, true);
+        cube_cache = createDepthTexture(GL_TEXTURE_CUBE_MAP, cube_size, 1, false);
+    }
+    
+    // Depth only; the completeness check runs on the first target
+    bool complete = true;
+    GLuint framebuffers[2];
+    glGenFramebuffers(2, framebuffers);
+    framebuffer = framebuffers[0];
+    cache_framebuffer = framebuffers[1];
+    for (int f = 0; f < 2; f++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[f]);
+        attach(GL_FRAMEBUFFER, f == 1, cascade_size > 0 ? 0 : CASCADES);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+void ShadowMaps::release() {
+    GLuint textures[4] = { cascade_texture, cascade_cache, cube_texture, cube_cache };
+    MemoryStats::forgetTextures(4, textures);
+    MemoryStats::forgetBuffers(1, &ubo);
+    glDeleteTextures(4, textures);
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    if (cache_framebuffer) glDeleteFramebuffers(1, &cache_framebuffer);
+    if (ubo) glDeleteBuffers(1, &ubo);
+    cascade_texture = cascade_cache = cube_texture = cube_cache = 0;
+    framebuffer = cache_framebuffer = ubo = 0;
+    cascade_size = cube_size = 0;
+    passes.clear();
+    sun_set = false;
+    for (int t = 0; t < CASCADES + CUBE_FACES; t++) {
+        targets[t].static_stale = true;
+        targets[t].drawn = false;
+    }
+}
+
+void ShadowMaps::setCascadeInterval(int cascade, int frames) {
+    if (cascade >= 0 && cascade < CASCADES) targets[cascade].interval = std::max(frames, 1);
+}
+
+void ShadowMaps::setCubeInterval(int frames) {
+    for (int face = 0; face < CUBE_FACES; face++) {
+        targets[CASCADES + face].interval = std::max(frames, 1);
+    }
+}
+
+// The faces look along the axes from the torch and reach to its radius
+void ShadowMaps::setTorch(const glm::vec3& position, float radius) {
+    if (torch_set && position == torch_position && radius == torch_radius) return;
+    torch_position = position;
+    torch_radius = std::max(radius, TORCH_NEAR * 2.0f);
+    torch_set = true;
+    glm::mat4 projection = glm::perspective(0.5f * glm::pi<float>(), 1.0f, TORCH_NEAR, torch_radius);
+    for (int face = 0; face < CUBE_FACES; face++) {
+        Target& target = targets[CASCADES + face];
+        target.view_projection = projection * glm::lookAt(position, position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+        target.static_stale = true;
+    }
+}
+
+void ShadowMaps::invalidateStatic() {
+    for (int t = 0; t < CASCADES + CUBE_FACES; t++) {
+        targets[t].static_stale = true;
+    }
+}
+
+// === PER FRAME ===
+
+// The slice from start to end gets its bounding sphere, which depends only
+// on the depths and so keeps its size as the camera turns. A cascade is
+// refitted when its slice leaves the sphere it covers or shrinks to half
+// of it, or when the sun has moved: a margin larger, its center snapped to
+// whole texels across the sun's view
+void ShadowMaps::fitCascade(int cascade, const glm::mat4& inverse_view, float start, float end, float tan_x,
+                            float tan_y, bool refit) {
+    float corner2 = tan_x * tan_x + tan_y * tan_y; // Squared distance off the axis per unit of depth
+    float depth = std::min(0.5f * (start + end) * (1.0f + corner2), end);
+    float radius = std::sqrt(std::max((depth - start) * (depth - start) + start * start * corner2,
+                                      (end - depth) * (end - depth) + end * end * corner2));
+    glm::vec3 center = glm::vec3(inverse_view * glm::vec4(0.0f, 0.0f, -depth, 1.0f));
+    cascade_end[cascade] = end;
+    bool fits = glm::length(center - cascade_center[cascade]) + radius <= cascade_radius[cascade] &&
+                radius >= 0.5f * cascade_radius[cascade];
+    if (!refit && fits) return;
+    
+    float covered = radius * (1.0f + COVER_MARGIN);
+    glm::vec3 up = std::fabs(sun_direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 rotation = glm::lookAt(glm::vec3(0.0f), -sun_direction, up);
+    glm::vec3 across = glm::vec3(rotation * glm::vec4(center, 1.0f));
+    float texel = 2.0f * covered / cascade_size;
+    across.x = std::floor(across.x / texel) * texel;
+    across.y = std::floor(across.y / texel) * texel;
+    center = glm::vec3(glm::inverse(rotation) * glm::vec4(across, 1.0f));
+    
+    float back = covered + caster_reach;
+    glm::mat4 view = glm::lookAt(center + sun_direction * back, center, up);
+    glm::mat4 projection = glm::ortho(-covered, covered, -covered, covered, 0.0f, back + covered);
+    cascade_center[cascade] = center;
+    cascade_radius[cascade] = covered;
+    targets[cascade].view_projection = projection * view;
+    targets[cascade].static_stale = true;
+}
+
+// A map is due when its cache is stale, or when there are dynamic casters
+// and its interval comes round; the targets are offset by their index so
+// equal intervals take turns
+void ShadowMaps::plan(const glm::mat4& V, float fov_y, float aspect, float near_plane, const glm::vec3& to_sun,
+                      bool dynamic_casters) {
+    passes.clear();
+    frame++;
+    if (hasCascades()) {
+        glm::vec3 direction = glm::normalize(to_sun);
+        bool refit = !sun_set || std::acos(glm::clamp(glm::dot(direction, sun_direction), -1.0f, 1.0f)) > sun_step;
+        if (refit) sun_direction = direction;
+        sun_set = true;
+        
+        float start = std::max(near_plane, 0.01f);
+        float distance = std::max(shadow_distance, start * 2.0f);
+        float tan_y = std::tan(0.5f * fov_y);
+        glm::mat4 inverse_view = glm::inverse(V);
+        float end = start;
+        for (int c = 0; c < CASCADES; c++) {
+            float share = (float)(c + 1) / CASCADES;
+            float uniform = start + (distance - start) * share;
+            float logarithmic = start * std::pow(distance / start, share);
+            float slice_start = end;
+            end = uniform + (logarithmic - uniform) * SPLIT_LOG_SHARE;
+            fitCascade(c, inverse_view, slice_start, end, tan_y * aspect, tan_y, refit);
+        }
+    }
+    
+    for (int t = 0; t < CASCADES + CUBE_FACES; t++) {
+        if (t < CASCADES ? !hasCascades() : !(hasCube() && torch_set)) continue;
+        Target& target = targets[t];
+        bool due = target.static_stale || !target.drawn || (dynamic_casters && (frame + t) % target.interval == 0);
+        if (!due) continue;
+        Pass pass;
+        pass.target = t;
+        pass.view_projection = target.view_projection;
+        if (target.static_stale || !target.drawn) {
+            pass.casters = STATIC_CASTERS;
+            passes.push_back(pass);
+        }
+        pass.casters = DYNAMIC_CASTERS;
+        passes.push_back(pass);
+        target.static_stale = false;
+        target.drawn = true;
+    }
+}
+
+void ShadowMaps::attach(GLenum framebuffer_target, bool cache, int target) const {
+    if (target < CASCADES) {
+        glFramebufferTextureLayer(framebuffer_target, GL_DEPTH_ATTACHMENT, cache ? cascade_cache : cascade_texture,
+                                  0, target);
+    } else {
+        glFramebufferTexture2D(framebuffer_target, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + target - CASCADES,
+                               cache ? cube_cache : cube_texture, 0);
+    }
+}
+
+void ShadowMaps::beginPass(const Pass& pass) {
+    int size = targetSize(pass.target);
+    if (pass.casters == STATIC_CASTERS) {
+        glBindFramebuffer(GL_FRAMEBUFFER, cache_framebuffer);
+        attach(GL_FRAMEBUFFER, true, pass.target);
+        glViewport(0, 0, size, size);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        return;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, cache_framebuffer);
+    attach(GL_READ_FRAMEBUFFER, true, pass.target);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    attach(GL_DRAW_FRAMEBUFFER, false, pass.target);
+    glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, size, size);
+}
+
+void ShadowMaps::endPasses(int width, int height, GLuint scene_framebuffer) {
+    glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer);
+    glViewport(0, 0, width, height);
+}
+
+// Eye space goes back to world space, then into the sun's view of each
+// cascade and on to [0, 1] texture coordinates and depth
+void ShadowMaps::upload(const glm::mat4& V) {
+    if (ubo == 0) return;
+    ShadowUniforms uniforms = ShadowUniforms();
+    glm::mat4 inverse_view = glm::inverse(V);
+    if (hasCascades() && sun_set) {
+        glm::mat4 bias = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+        for (int c = 0; c < CASCADES; c++) {
+            uniforms.cascades[c] = bias * targets[c].view_projection * inverse_view;
+            uniforms.cascade_far[c] = cascade_end[c];
+            uniforms.cascade_texel[c] = 2.0f * cascade_radius[c] / cascade_size;
+        }
+        uniforms.cascade_far.w = 1.0f;
+    }
+    if (hasCube() && torch_set) {
+        uniforms.torch = glm::translate(glm::mat4(1.0f), -torch_position) * inverse_view;
+        uniforms.torch_depth = glm::vec4(TORCH_NEAR, torch_radius, 0.0f, 1.0f);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowUniforms), &uniforms);
+    RenderStats::countUpload(sizeof(ShadowUniforms));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ShadowMaps::bind(GlStateCache& state) const {
+    if (hasCascades()) state.bindTexture(CASCADE_UNIT, GL_TEXTURE_2D_ARRAY, cascade_texture);
+    if (hasCube()) state.bindTexture(CUBE_UNIT, GL_TEXTURE_CUBE_MAP, cube_texture);
+}
+
+int ShadowMaps::getRedrawnMaps() const {
+    int maps = 0;
+    for (const Pass& pass : passes) {
+        if (pass.casters == DYNAMIC_CASTERS) maps++;
+    }
+    return maps;
+}
+
+int ShadowMaps::getStaticRedraws() const {
+    return passes.size() - getRedrawnMaps();
+}
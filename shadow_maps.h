@@ -0,0 +1,153 @@
+#ifndef SHADOW_MAPS_H
+#define SHADOW_MAPS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+class GlStateCache;
+
+// The ShadowData uniform block of f_simplest.glsl, std140 layout. CASCADES
+// must match its array size
+struct ShadowUniforms {
+    static const int CASCADES = 3;
+    glm::mat4 cascades[CASCADES]; // Eye space -> (u, v, depth) in each cascade's map
+    glm::vec4 cascade_far;        // Eye depth each cascade reaches (xyz), w = 1 when the sun casts shadows
+    glm::vec4 cascade_texel;      // World size of a texel of each cascade (xyz), for the normal offset
+    glm::mat4 torch;              // Eye space -> world offset from the torch
+    glm::vec4 torch_depth;        // (near, far) of the cube's faces, w = 1 when the torch casts shadows
+};
+
+static_assert(sizeof(ShadowUniforms) == 304, "ShadowUniforms must match the std140 ShadowData block");
+
+// Shadow maps for the sun and one torch. The sun's shadows treat it as a
+// directional light: the view out to the shadow distance is cut into
+// CASCADES slices, nearer ones shorter, each covered by an orthographic
+// layer of a depth texture array. The torch has a depth cube map.
+//
+// Drawing them is split by how often the casters change. Every map keeps a
+// cache holding only the static casters (the ground, a grown tree in still
+// air); a redraw blits the cache into the map and draws the dynamic
+// casters (growing or wind-swept trees) over it. A cascade keeps its
+// matrix while its slice stays inside the area it covers and the sun has
+// moved less than the sun step, snapped to whole texels when it moves, so
+// the cache outlives small camera moves and the shadows do not shimmer.
+// On top of that each map has an update interval: the dynamic casters are
+// redrawn into it every that many frames, the far cascades less often.
+//
+// Per frame plan() lists the passes of the maps that are due; the caller
+// draws each pass' casters with the depth programs after beginPass(), and
+// endPasses() returns to the default framebuffer. upload() writes
+// ShadowUniforms for the frame's view. create() binds textures directly,
+// behind a GlStateCache's back (GlStateCache::invalidateTextures)
+class ShadowMaps {
+public:
+    static const int CASCADES = ShadowUniforms::CASCADES;
+    static const int CUBE_FACES = 6;
+    static const int CASCADE_UNIT = 1; // The sunShadow sampler's unit
+    static const int CUBE_UNIT = 2;    // The torchShadow sampler's unit
+    static const GLuint BINDING = 2;
+    static const char* blockName() { return "ShadowData"; }
+    // PointLight::shadow of the lights with a map
+    static const int SUN_SHADOW = 1;
+    static const int TORCH_SHADOW = 2;
+    
+    enum Casters { STATIC_CASTERS, DYNAMIC_CASTERS };
+    // One drawing into a map: target is a cascade, or CASCADES + a cube face
+    struct Pass {
+        int target;
+        Casters casters;
+        glm::mat4 view_projection;
+    };
+    
+    ShadowMaps();
+    ~ShadowMaps();
+    
+    // === SETUP ===
+    // Cascades of cascade_size and a cube of cube_size texels a side, 0 for
+    // none. The uniform buffer is created either way, so the lit programs
+    // always read a valid ShadowData; false when a framebuffer is
+    // incomplete, the maps then being off
+    bool create(int cascade_size, int cube_size);
+    void release();
+    bool hasCascades() const { return cascade_texture != 0; }
+    bool hasCube() const { return cube_texture != 0; }
+    // Frames between redraws of the dynamic casters (1 = every frame)
+    void setCascadeInterval(int cascade, int frames);
+    void setCubeInterval(int frames);
+    int getCascadeInterval(int cascade) const { return targets[cascade].interval; }
+    // Sun shadows out to distance from the eye
+    void setShadowDistance(float distance) { shadow_distance = distance; }
+    // How far toward the sun beyond a cascade's slice casters still cast into it
+    void setCasterReach(float reach) { caster_reach = reach; }
+    // The cascades follow the sun in steps of this many radians
+    void setSunStep(float radians) { sun_step = radians; }
+    // The torch with the cube map and the distance its shadows reach
+    void setTorch(const glm::vec3& position, float radius);
+    // The static casters changed: every cache is redrawn at the next plan()
+    void invalidateStatic();
+    
+    // === PER FRAME ===
+    // Choose the due maps for the view V (vertical field of view in radians,
+    // aspect ratio and near plane) and the direction toward the sun. Maps
+    // are only due for the dynamic casters when there are some
+    void plan(const glm::mat4& V, float fov_y, float aspect, float near_plane, const glm::vec3& to_sun,
+              bool dynamic_casters);
+    const std::vector<Pass>& getPasses() const { return passes; }
+    // Bind a pass' target: a static pass clears the cache, the dynamic pass
+    // of the same target starts from a copy of it
+    void beginPass(const Pass& pass);
+    // Back to scene_framebuffer (0 = the default one) with a width x height
+    // viewport
+    void endPasses(int width, int height, GLuint scene_framebuffer = 0);
+    // ShadowUniforms for the frame's view
+    void upload(const glm::mat4& V);
+    // The maps on their units, for the lit programs
+    void bind(GlStateCache& state) const;
+    // Maps redrawn at the last plan(), and how many of them from scratch
+    int getRedrawnMaps() const;
+    int getStaticRedraws() const;
+
+private:
+    struct Target {
+        glm::mat4 view_projection;
+        int interval;
+        bool static_stale; // The cache must be drawn again
+        bool drawn;        // The map holds a drawing
+    };
+    Target targets[CASCADES + CUBE_FACES];
+    // Each cascade's covered sphere and the eye depth its slice ends at
+    glm::vec3 cascade_center[CASCADES];
+    float cascade_radius[CASCADES];
+    float cascade_end[CASCADES];
+    float shadow_distance;
+    float caster_reach;
+    float sun_step;
+    glm::vec3 sun_direction;  // Toward the sun, as the cascades were last fitted to it
+    bool sun_set;
+    glm::vec3 torch_position;
+    float torch_radius;
+    bool torch_set;
+    int frame;
+    std::vector<Pass> passes;
+    
+    int cascade_size;
+    int cube_size;
+    GLuint cascade_texture;   // Depth array, a layer per cascade, compared when sampled
+    GLuint cascade_cache;     // Static casters only
+    GLuint cube_texture;
+    GLuint cube_cache;
+    GLuint framebuffer;       // Draws into the maps
+    GLuint cache_framebuffer; // Draws into a cache and reads it for the copy
+    GLuint ubo;
+    
+    void fitCascade(int cascade, const glm::mat4& inverse_view, float start, float end, float tan_x, float tan_y,
+                    bool refit);
+    void attach(GLenum framebuffer_target, bool cache, int target) const;
+    int targetSize(int target) const { return target < CASCADES ? cascade_size : cube_size; }
+    
+    ShadowMaps(const ShadowMaps&);
+    ShadowMaps& operator=(const ShadowMaps&);
+};
+
+#endif // SHADOW_MAPS_H
@@ -0,0 +1,76 @@
+#include "sim_thread.h"
+#include "profiler.h"
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+SimulationThread::SimulationThread() : pending(false), stopping(false), step_us(0.0f), wait_us(0.0f) {}
+
+SimulationThread::~SimulationThread() {
+    start(false);
+}
+
+void SimulationThread::start(bool threaded) {
+    finish();
+    if (threaded == isThreaded()) return;
+    if (threaded) {
+        stopping = false;
+        worker = std::thread(&SimulationThread::workerLoop, this);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+// The step's time goes in step_us before the caller is released
+void SimulationThread::run() {
+    PROFILE_SCOPE("SimulationThread::step");
+    Clock::time_point start = Clock::now();
+    step();
+    step_us = std::chrono::duration<float, std::micro>(Clock::now() - start).count();
+}
+
+void SimulationThread::workerLoop() {
+    Profiler::setThreadName("simulation");
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [&]() { return stopping || pending; });
+        if (stopping) return;
+        lock.unlock();
+        run();
+        lock.lock();
+        pending = false;
+        step = nullptr;
+        done.notify_one();
+    }
+}
+
+void SimulationThread::post(const std::function<void()>& fn) {
+    finish();
+    step = fn;
+    if (!isThreaded()) {
+        run();
+        step = nullptr;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = true;
+    }
+    wake.notify_one();
+}
+
+void SimulationThread::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return !pending; });
+}
+
+void SimulationThread::wait() {
+    Clock::time_point start = Clock::now();
+    finish();
+    wait_us = std::chrono::duration<float, std::micro>(Clock::now() - start).count();
+}
@@ -0,0 +1,52 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// A persistent thread for the simulation step of the next frame, run while
+// the render thread submits the current one, so a frame costs the longer
+// of the two instead of their sum. post() hands over a step and returns at
+// once; wait() blocks until it is done, after which the caller owns the
+// simulated state again. One step is in flight at a time. Without a thread
+// (start(false), the default) post() runs the step inline
+class SimulationThread {
+private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake; // Worker: a step or shutdown
+    std::condition_variable done; // Caller: the step finished
+    std::function<void()> step;
+    bool pending;
+    bool stopping;
+    
+    float step_us;  // The last step's run time
+    float wait_us;  // How long the last wait() blocked
+    
+    void workerLoop();
+    void run();
+    void finish(); // wait() without the timing
+    
+    SimulationThread(const SimulationThread&);
+    SimulationThread& operator=(const SimulationThread&);
+
+public:
+    SimulationThread();
+    ~SimulationThread();
+    
+    // Start (or stop) the worker; waits for a step in flight first
+    void start(bool threaded);
+    bool isThreaded() const { return worker.joinable(); }
+    
+    // Run fn, on the worker when there is one. A step still in flight is
+    // waited for first
+    void post(const std::function<void()>& fn);
+    void wait();
+    
+    float getLastStepMicroseconds() const { return step_us; }
+    float getLastWaitMicroseconds() const { return wait_us; }
+};
+
+#endif // SIM_THREAD_H
@@ -0,0 +1,181 @@
+#include "sky.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include "shaderprogram.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+
+const float Sky::VIEW_STEP = 0.01f;
+
+// f_sky.glsl's planet, in km
+static const float GROUND_RADIUS = 6360.0f;
+static const float TOP_RADIUS = 6460.0f;
+static const float EYE_RADIUS = GROUND_RADIUS + 0.2f;
+
+Sky::Sky()
+    : framebuffer(0), transmittance_texture(0), view_texture(0), vertex_array(0), sun_direction(0.0f, 1.0f, 0.0f),
+      view_elevation(-2.0f), view_updates(0) {}
+
+Sky::~Sky() {
+    release();
+}
+
+static GLuint createTable(int width, int height, bool mipmaps) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+    int levels = 1;
+    if (mipmaps) {
+        while ((std::max(width, height) >> levels) > 0) {
+            levels++;
+        }
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    MemoryStats::trackTexture(texture, MemoryStats::textureBytes(GL_RGBA16F, width, height, 1, levels), "sky");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+bool Sky::create() {
+    if (isCreated()) return true;
+    transmittance_texture = createTable(TRANSMITTANCE_WIDTH, TRANSMITTANCE_HEIGHT, false);
+    view_texture = createTable(VIEW_WIDTH, VIEW_HEIGHT, true);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenVertexArrays(1, &vertex_array);
+    
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, view_texture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+void Sky::release() {
+    MemoryStats::forgetTextures(1, &transmittance_texture);
+    MemoryStats::forgetTextures(1, &view_texture);
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    if (transmittance_texture) glDeleteTextures(1, &transmittance_texture);
+    if (view_texture) glDeleteTextures(1, &view_texture);
+    if (vertex_array) glDeleteVertexArrays(1, &vertex_array);
+    framebuffer = transmittance_texture = view_texture = vertex_array = 0;
+    transmittance.clear();
+    view_elevation = -2.0f;
+    view_updates = 0;
+}
+
+// === TABLES ===
+
+void Sky::drawTable(GlStateCache& state, ShaderProgram* program, GLuint texture, int width, int height) {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glViewport(0, 0, width, height);
+    state.useProgram(program);
+    state.uniform1i("transmittanceLut", TRANSMITTANCE_UNIT);
+    state.uniform3fv("sunDirection", glm::value_ptr(sun_direction));
+    glBindVertexArray(vertex_array);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+}
+
+bool Sky::update(GlStateCache& state, ShaderProgram* transmittance_program, ShaderProgram* view_program,
+                 const glm::vec3& to_sun, GLuint scene_framebuffer, int viewport_width, int viewport_height) {
+    if (!isCreated()) return false;
+    sun_direction = glm::normalize(to_sun);
+    const float elevation = asinf(std::min(std::max(sun_direction.y, -1.0f), 1.0f));
+    const bool first = transmittance.empty();
+    if (!first && fabsf(elevation - view_elevation) <= VIEW_STEP) return false;
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glDisable(GL_DEPTH_TEST);
+    if (first) {
+        drawTable(state, transmittance_program, transmittance_texture, TRANSMITTANCE_WIDTH, TRANSMITTANCE_HEIGHT);
+        // The copy sunColor() reads; once, so the stall is at startup
+        transmittance.resize(4 * TRANSMITTANCE_WIDTH * TRANSMITTANCE_HEIGHT);
+        glBindTexture(GL_TEXTURE_2D, transmittance_texture);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, transmittance.data());
+    }
+    state.bindTexture(TRANSMITTANCE_UNIT, GL_TEXTURE_2D, transmittance_texture);
+    drawTable(state, view_program, view_texture, VIEW_WIDTH, VIEW_HEIGHT);
+    glBindTexture(GL_TEXTURE_2D, view_texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    view_elevation = elevation;
+    view_updates++;
+    
+    glEnable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer);
+    glViewport(0, 0, viewport_width, viewport_height);
+    return true;
+}
+
+// === DRAWING ===
+
+void Sky::bind(GlStateCache& state) const {
+    state.bindTexture(TRANSMITTANCE_UNIT, GL_TEXTURE_2D, transmittance_texture);
+    state.bindTexture(VIEW_UNIT, GL_TEXTURE_2D, view_texture);
+}
+
+// At the far plane, where the depth test passes only what is still the
+// clear depth, without writing it
+void Sky::draw(GlStateCache& state, ShaderProgram* program, const glm::mat4& sky_rays) const {
+    if (!isReady()) return;
+    bind(state);
+    state.useProgram(program);
+    state.uniform1i("transmittanceLut", TRANSMITTANCE_UNIT);
+    state.uniform1i("skyView", VIEW_UNIT);
+    state.uniform3fv("sunDirection", glm::value_ptr(sun_direction));
+    state.uniformMatrix4fv("skyRays", glm::value_ptr(sky_rays));
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(vertex_array);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+// === SUNLIGHT ===
+
+// The read-back table at (r, mu), bilinearly, by f_sky.glsl's mapping
+glm::vec3 Sky::transmittanceAt(float r, float mu) const {
+    const float discriminant = r * r * (mu * mu - 1.0f) + GROUND_RADIUS * GROUND_RADIUS;
+    if (transmittance.empty() || (mu < 0.0f && discriminant >= 0.0f)) return glm::vec3(0.0f);
+    const float horizon = sqrtf(TOP_RADIUS * TOP_RADIUS - GROUND_RADIUS * GROUND_RADIUS);
+    const float rho = sqrtf(std::max(r * r - GROUND_RADIUS * GROUND_RADIUS, 0.0f));
+    const float d = std::max(-r * mu + sqrtf(std::max(r * r * (mu * mu - 1.0f) + TOP_RADIUS * TOP_RADIUS, 0.0f)), 0.0f);
+    const float d_min = TOP_RADIUS - r;
+    const float d_max = rho + horizon;
+    const float u = (d - d_min) / (d_max - d_min);
+    const float v = rho / horizon;
+    
+    // Texel centers at (i + 0.5) / size
+    const float x = std::min(std::max(u * TRANSMITTANCE_WIDTH - 0.5f, 0.0f), TRANSMITTANCE_WIDTH - 1.0f);
+    const float y = std::min(std::max(v * TRANSMITTANCE_HEIGHT - 0.5f, 0.0f), TRANSMITTANCE_HEIGHT - 1.0f);
+    const int x0 = (int)x;
+    const int y0 = (int)y;
+    const int x1 = std::min(x0 + 1, TRANSMITTANCE_WIDTH - 1);
+    const int y1 = std::min(y0 + 1, TRANSMITTANCE_HEIGHT - 1);
+    const float fx = x - x0;
+    const float fy = y - y0;
+    auto texel = [this](int tx, int ty) {
+        const float* rgba = &transmittance[4 * (ty * TRANSMITTANCE_WIDTH + tx)];
+        return glm::vec3(rgba[0], rgba[1], rgba[2]);
+    };
+    return glm::mix(glm::mix(texel(x0, y0), texel(x1, y0), fx), glm::mix(texel(x0, y1), texel(x1, y1), fx), fy);
+}
+
+glm::vec3 Sky::sunColor(const glm::vec3& to_sun) const {
+    const glm::vec3 zenith = transmittanceAt(EYE_RADIUS, 1.0f);
+    if (zenith.r <= 0.0f || zenith.g <= 0.0f || zenith.b <= 0.0f) return glm::vec3(1.0f);
+    const float mu = glm::normalize(to_sun).y;
+    return glm::min(transmittanceAt(EYE_RADIUS, mu) / zenith, glm::vec3(1.0f));
+}
@@ -0,0 +1,80 @@
+#ifndef SKY_H
+#define SKY_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+class GlStateCache;
+class ShaderProgram;
+
+// A physically based sky from two precomputed tables (Hillaire 2020),
+// f_sky.glsl's variants: the atmosphere's transmittance by height and
+// zenith angle, marched once, and the light the sky scatters toward the
+// eye by azimuth from the sun and elevation, marched through the first and
+// redone only when the sun's elevation moves by more than VIEW_STEP (the
+// table is relative to the sun, so its azimuth is free). The sky pass
+// behind the scene and the lit programs' ambient and fog colour are then a
+// fetch or two of the view table per pixel, and the sun's colour a lookup
+// of a copy of the transmittance table read back once.
+//
+// update() and create() bind textures directly, behind a GlStateCache's
+// back (GlStateCache::invalidateTextures)
+class Sky {
+public:
+    static const int TRANSMITTANCE_UNIT = 3; // The transmittanceLut sampler's unit
+    static const int VIEW_UNIT = 4;          // The skyView sampler's unit
+    static const int TRANSMITTANCE_WIDTH = 256; // By zenith angle
+    static const int TRANSMITTANCE_HEIGHT = 64; // By height
+    static const int VIEW_WIDTH = 192;  // By azimuth from the sun, over half a turn
+    static const int VIEW_HEIGHT = 108; // By elevation, denser toward the horizon
+    static const float VIEW_STEP;       // Sun elevation change, in radians, that redoes the view table
+    
+    Sky();
+    ~Sky();
+    
+    // Allocate the tables; false when their framebuffer is incomplete
+    bool create();
+    void release();
+    bool isCreated() const { return framebuffer != 0; }
+    
+    // March the transmittance table with transmittance_program the first
+    // time, and the view table with view_program when the sun toward
+    // to_sun has moved enough in elevation. scene_framebuffer and a
+    // viewport_width x viewport_height viewport are bound again after;
+    // true when a table was drawn, and textures bound directly
+    bool update(GlStateCache& state, ShaderProgram* transmittance_program, ShaderProgram* view_program,
+                const glm::vec3& to_sun, GLuint scene_framebuffer, int viewport_width, int viewport_height);
+    bool isReady() const { return view_elevation > -2.0f; }
+    
+    // Both tables on their units, for the programs that read them
+    void bind(GlStateCache& state) const;
+    // The sky behind whatever the scene drew, where the depth is still
+    // cleared, with program (f_sky.glsl without a table's define);
+    // sky_rays takes clip space to world directions
+    void draw(GlStateCache& state, ShaderProgram* program, const glm::mat4& sky_rays) const;
+    
+    // The sunlight reaching the ground from to_sun, white with the sun at
+    // the zenith, reddening toward the horizon and black below it
+    glm::vec3 sunColor(const glm::vec3& to_sun) const;
+    const glm::vec3& getSunDirection() const { return sun_direction; }
+    int getViewUpdates() const { return view_updates; }
+
+private:
+    GLuint framebuffer;
+    GLuint transmittance_texture; // RGBA16F
+    GLuint view_texture;          // RGBA16F with mipmaps, the coarsest the ambient
+    GLuint vertex_array;          // Empty: v_sky.glsl makes its triangle from gl_VertexID
+    std::vector<float> transmittance; // The transmittance table read back, RGBA per texel
+    glm::vec3 sun_direction;
+    float view_elevation; // The sun's at the view table's last update, -2 before the first
+    int view_updates;
+    
+    glm::vec3 transmittanceAt(float r, float mu) const;
+    void drawTable(GlStateCache& state, ShaderProgram* program, GLuint texture, int width, int height);
+    
+    Sky(const Sky&);
+    Sky& operator=(const Sky&);
+};
+
+#endif // SKY_H
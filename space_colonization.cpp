@@ -0,0 +1,301 @@
+#include "space_colonization.h"
+#include "job_system.h"
+#include "tree_simple.h"
+#include <cmath>
+#include <algorithm>
+
+SpaceColonizationParameters::SpaceColonizationParameters() {
+    attractor_count = 10000;
+    crown_center = glm::vec3(0.0f, 7.0f, 0.0f);
+    crown_radii = glm::vec3(4.0f, 3.5f, 4.0f);
+    influence_radius = 1.5f;
+    kill_radius = 0.4f;
+    segment_length = 0.15f;
+    max_iterations = 300;
+    segments_per_branch = 3;
+    tip_radius = 0.02f;
+    radius_exponent = 3.0f; // Keeps a ~2000-tip crown's trunk near the built-in 0.2
+    leaves_per_tip = 6;
+}
+
+SpaceColonization::SpaceColonization() {
+    cell_size = 1.0f;
+}
+
+// === SPATIAL HASH ===
+
+uint32_t SpaceColonization::bucketOf(glm::vec3 p) const {
+    int x = (int)floorf(p.x / cell_size);
+    int y = (int)floorf(p.y / cell_size);
+    int z = (int)floorf(p.z / cell_size);
+    uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ (uint32_t)z * 83492791u;
+    return h & (bucket_head.size() - 1);
+}
+
+void SpaceColonization::insertNode(int node) {
+    uint32_t bucket = bucketOf(node_position[node]);
+    node_next[node] = bucket_head[bucket];
+    bucket_head[bucket] = node;
+}
+
+void SpaceColonization::rehash(size_t bucket_count) {
+    bucket_head.assign(bucket_count, -1);
+    for (size_t n = 0; n < node_position.size(); n++) {
+        insertNode(n);
+    }
+}
+
+int SpaceColonization::addNode(glm::vec3 position, int parent) {
+    int node = node_position.size();
+    node_position.push_back(position);
+    node_parent.push_back(parent);
+    node_pull.push_back(glm::vec3(0.0f));
+    node_pull_count.push_back(0);
+    node_next.push_back(-1);
+    // Keep the load factor at or below one half; buckets are a power of two
+    if (node_position.size() * 2 > bucket_head.size()) {
+        rehash(bucket_head.size() * 2);
+    } else {
+        insertNode(node);
+    }
+    return node;
+}
+
+int SpaceColonization::nearestNode(glm::vec3 p, float radius, float& distance) const {
+    // Cells are at least radius wide, so the 27 cells around p cover the
+    // search sphere; colliding buckets only add distance checks
+    int best = -1;
+    float best_d2 = radius * radius;
+    int cx = (int)floorf(p.x / cell_size);
+    int cy = (int)floorf(p.y / cell_size);
+    int cz = (int)floorf(p.z / cell_size);
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                uint32_t h = (uint32_t)(cx + dx) * 73856093u ^ (uint32_t)(cy + dy) * 19349663u ^
+                             (uint32_t)(cz + dz) * 83492791u;
+                for (int n = bucket_head[h & (bucket_head.size() - 1)]; n >= 0; n = node_next[n]) {
+                    glm::vec3 d = node_position[n] - p;
+                    float d2 = glm::dot(d, d);
+                    // Ties go to the lower index so the result is order independent
+                    if (d2 < best_d2 || (d2 == best_d2 && best >= 0 && n < best)) {
+                        best_d2 = d2;
+                        best = n;
+                    }
+                }
+            }
+        }
+    }
+    distance = sqrtf(best_d2);
+    return best;
+}
+
+void SpaceColonization::assignAttractors(int begin, int end, float kill_radius, float influence_radius) {
+    for (int a = begin; a < end; a++) {
+        float distance;
+        int node = nearestNode(attractors[a], influence_radius, distance);
+        attractor_node[a] = (node >= 0 && distance < kill_radius) ? -2 : node;
+    }
+}
+
+void SpaceColonization::generate(const SpaceColonizationParameters& parameters, int threads, std::mt19937_64& rng,
+                                 std::vector<TreeBranch>& branches, std::vector<TreeLeaf>& leaves) {
+    node_position.clear();
+    node_parent.clear();
+    node_pull.clear();
+    node_pull_count.clear();
+    node_next.clear();
+    cell_size = std::max(parameters.influence_radius, 1e-3f);
+    bucket_head.assign(1024, -1);
+    
+    // === ATTRACTORS: UNIFORM IN THE CROWN ELLIPSOID ===
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    attractors.clear();
+    attractors.reserve(parameters.attractor_count);
+    while ((int)attractors.size() < parameters.attractor_count) {
+        glm::vec3 q(unit(rng), unit(rng), unit(rng));
+        if (glm::dot(q, q) > 1.0f) continue;
+        attractors.push_back(parameters.crown_center + q * parameters.crown_radii);
+    }
+    
+    // === TRUNK: STRAIGHT UP UNTIL THE CROWN IS IN REACH ===
+    int tip = addNode(glm::vec3(0.0f), -1);
+    float reach2 = parameters.influence_radius * parameters.influence_radius;
+    float trunk_limit = parameters.crown_center.y + parameters.crown_radii.y;
+    for (;;) {
+        glm::vec3 p = node_position[tip];
+        bool in_reach = false;
+        for (const glm::vec3& a : attractors) {
+            glm::vec3 d = a - p;
+            if (glm::dot(d, d) < reach2) {
+                in_reach = true;
+                break;
+            }
+        }
+        if (in_reach || attractors.empty() || p.y > trunk_limit) break;
+        tip = addNode(p + glm::vec3(0.0f, parameters.segment_length, 0.0f), tip);
+    }
+    
+    // === COLONIZATION ===
+    const float duplicate_radius = parameters.segment_length * 0.1f;
+    std::vector<int> pulled;
+    for (int iteration = 0; iteration < parameters.max_iterations && !attractors.empty(); iteration++) {
+        // Every attractor finds its nearest node independently: split the
+        // list across workers, each writing only its own slice
+        int count = attractors.size();
+        attractor_node.resize(count);
+        int workers = std::max(1, std::min(threads, count / 1024));
+        JobSystem::shared().parallelFor(count, (count + workers - 1) / workers, [&](int, int begin, int end) {
+            assignAttractors(begin, end, parameters.kill_radius, parameters.influence_radius);
+        }, workers);
+        
+        // Accumulate pulls in attractor order (deterministic) and drop the
+        // reached attractors
+        pulled.clear();
+        int kept = 0;
+        for (int a = 0; a < count; a++) {
+            int node = attractor_node[a];
+            if (node == -2) continue;
+            if (node >= 0) {
+                if (node_pull_count[node] == 0) pulled.push_back(node);
+                node_pull[node] += glm::normalize(attractors[a] - node_position[node]);
+                node_pull_count[node]++;
+            }
+            attractors[kept++] = attractors[a];
+        }
+        attractors.resize(kept);
+        
+        // Grow one segment from every pulled node, skipping growth that
+        // would land on an existing node (balanced pulls repeat themselves)
+        std::sort(pulled.begin(), pulled.end());
+        int grown = 0;
+        for (int node : pulled) {
+            glm::vec3 pull = node_pull[node];
+            node_pull[node] = glm::vec3(0.0f);
+            node_pull_count[node] = 0;
+            float length = glm::length(pull);
+            if (length < 1e-4f) continue;
+            glm::vec3 position = node_position[node] + pull / length * parameters.segment_length;
+            float distance;
+            if (nearestNode(position, duplicate_radius, distance) >= 0) continue;
+            addNode(position, node);
+            grown++;
+        }
+        if (grown == 0) break;
+    }
+    
+    emitTree(parameters, rng, branches, leaves);
+}
+
+void SpaceColonization::emitTree(const SpaceColonizationParameters& parameters, std::mt19937_64& rng,
+                                 std::vector<TreeBranch>& branches, std::vector<TreeLeaf>& leaves) {
+    const int node_count = node_position.size();
+    if (node_count < 2) return;
+    
+    // === CHILD LISTS (CSR) ===
+    child_first.assign(node_count + 1, 0);
+    for (int n = 1; n < node_count; n++) {
+        child_first[node_parent[n] + 1]++;
+    }
+    for (int n = 0; n < node_count; n++) {
+        child_first[n + 1] += child_first[n];
+    }
+    child_nodes.resize(node_count - 1);
+    {
+        std::vector<int> cursor(child_first.begin(), child_first.end() - 1);
+        for (int n = 1; n < node_count; n++) {
+            child_nodes[cursor[node_parent[n]]++] = n;
+        }
+    }
+    
+    // === PIPE-MODEL RADII ===
+    // Children always follow their parent, so one reverse pass sees every
+    // child before its parent
+    node_radius.assign(node_count, 0.0f);
+    const float e = parameters.radius_exponent;
+    for (int n = node_count - 1; n >= 1; n--) {
+        float sum = 0.0f;
+        for (int k = child_first[n]; k < child_first[n + 1]; k++) {
+            sum += powf(node_radius[child_nodes[k]], e);
+        }
+        node_radius[n] = (sum > 0.0f) ? powf(sum, 1.0f / e) : parameters.tip_radius;
+    }
+    
+    // === GENERATIONS ===
+    // The thickest child continues its parent's axis; the others start a
+    // new generation
+    node_generation.assign(node_count, 0);
+    for (int n = 0; n < node_count; n++) {
+        int main_child = -1;
+        for (int k = child_first[n]; k < child_first[n + 1]; k++) {
+            int c = child_nodes[k];
+            if (main_child < 0 || node_radius[c] > node_radius[main_child]) main_child = c;
+        }
+        for (int k = child_first[n]; k < child_first[n + 1]; k++) {
+            int c = child_nodes[k];
+            node_generation[c] = node_generation[n] + (c == main_child ? 0 : 1);
+        }
+    }
+    
+    // === BRANCHES: MERGED NODE RUNS, DEPTH-FIRST ===
+    // A branch covers up to segments_per_branch nodes while the run stays
+    // unbranched; its radius is that of its first segment
+    std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> size_dist(0.28f, 0.45f);
+    std::uniform_real_distribution<float> delay_dist(0.0f, 4.0f);
+    const int run_limit = std::max(1, parameters.segments_per_branch);
+    
+    struct Pending {
+        int node;          // First node of the run
+        int parent_branch; // Branch ending at the run's start, -1 for the trunk
+    };
+    std::vector<Pending> stack;
+    for (int k = child_first[1] - 1; k >= child_first[0]; k--) {
+        stack.push_back(Pending{child_nodes[k], -1});
+    }
+    while (!stack.empty()) {
+        Pending run = stack.back();
+        stack.pop_back();
+        
+        int last = run.node;
+        for (int length = 1; length < run_limit && child_first[last + 1] - child_first[last] == 1; length++) {
+            last = child_nodes[child_first[last]];
+        }
+        
+        TreeBranch branch;
+        branch.start = node_position[node_parent[run.node]];
+        branch.end = node_position[last];
+        branch.radius = node_radius[run.node];
+        branch.generation = node_generation[run.node];
+        branch.growth_progress = 0.0f;
+        branch.parent_index = run.parent_branch;
+        branch.first_child = 0;   // Filled in by Tree::buildChildAdjacency()
+        branch.child_count = 0;
+        branch.start_time = 0.0f; // Filled in by Tree::buildGrowthSchedule()
+        branch.growth_duration = 1.0f;
+        int branch_index = branches.size();
+        branches.push_back(branch);
+        
+        int children = child_first[last + 1] - child_first[last];
+        if (children == 0) {
+            // === LEAF CLUSTER AT EVERY TIP ===
+            for (int j = 0; j < parameters.leaves_per_tip; j++) {
+                TreeLeaf leaf;
+                leaf.position = branch.end + glm::vec3(jitter(rng) * 0.3f, jitter(rng) * 0.2f, jitter(rng) * 0.3f);
+                leaf.normal = glm::normalize(glm::vec3(jitter(rng) * 0.5f, 0.8f + std::abs(jitter(rng)) * 0.2f,
+                                                       jitter(rng) * 0.5f));
+                leaf.size = size_dist(rng);
+                leaf.growth_progress = 0.0f;
+                leaf.parent_branch_index = branch_index;
+                leaf.spawn_delay = delay_dist(rng);
+                leaf.start_time = 0.0f;
+                leaf.growth_duration = 1.0f;
+                leaves.push_back(leaf);
+            }
+        }
+        // Reverse push so the first child is laid out first
+        for (int k = child_first[last + 1] - 1; k >= child_first[last]; k--) {
+            stack.push_back(Pending{child_nodes[k], branch_index});
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef SPACE_COLONIZATION_H
+#define SPACE_COLONIZATION_H
+
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+struct TreeBranch;
+struct TreeLeaf;
+
+// Shape of a space-colonization tree
+struct SpaceColonizationParameters {
+    int attractor_count;       // Points scattered through the crown volume
+    glm::vec3 crown_center;
+    glm::vec3 crown_radii;     // Ellipsoid half-extents
+    float influence_radius;    // Attractors pull on the nearest node within this distance
+    float kill_radius;         // and are consumed once a node gets this close
+    float segment_length;      // Growth per node per iteration
+    int max_iterations;
+    int segments_per_branch;   // Unbranched node runs merged into one TreeBranch
+    float tip_radius;          // Radius of the outermost segments
+    float radius_exponent;     // Pipe model: r^e of a node is the sum over its children
+    int leaves_per_tip;
+    
+    SpaceColonizationParameters();
+};
+
+// Space colonization (Runions et al.): the trunk grows up into a cloud of
+// attractors; every iteration each attractor pulls its nearest node, every
+// pulled node grows one segment toward the mean pull, and attractors a node
+// has reached are removed. Nearest-node queries go through a spatial hash
+// of the nodes with cells one influence radius wide, so a query visits 27
+// cells instead of every node; the per-attractor queries are independent and
+// run on a small thread pool. The result is plain TreeBranch / TreeLeaf data
+// (depth-first, parents before children), so meshing and growth are shared
+// with the other generators
+class SpaceColonization {
+private:
+    // Growth nodes: the root at the origin, then one per segment
+    std::vector<glm::vec3> node_position;
+    std::vector<int> node_parent;
+    std::vector<glm::vec3> node_pull;   // Summed unit directions toward the attractors
+    std::vector<int> node_pull_count;
+    
+    // Spatial hash: per-bucket linked lists threaded through node_next
+    std::vector<int> bucket_head;
+    std::vector<int> node_next;
+    float cell_size;
+    
+    // Live attractors and, per iteration, the node each one pulls
+    // (-1 = out of reach, -2 = reached and to be removed)
+    std::vector<glm::vec3> attractors;
+    std::vector<int> attractor_node;
+    
+    // Conversion scratch: per-node radius, generation and child lists
+    std::vector<float> node_radius;
+    std::vector<int> node_generation;
+    std::vector<int> child_first;
+    std::vector<int> child_nodes;
+    
+    uint32_t bucketOf(glm::vec3 p) const;
+    void insertNode(int node);
+    void rehash(size_t bucket_count);
+    int addNode(glm::vec3 position, int parent);
+    int nearestNode(glm::vec3 p, float radius, float& distance) const;
+    void assignAttractors(int begin, int end, float kill_radius, float influence_radius);
+    void emitTree(const SpaceColonizationParameters& parameters, std::mt19937_64& rng,
+                  std::vector<TreeBranch>& branches, std::vector<TreeLeaf>& leaves);
+
+public:
+    SpaceColonization();
+    
+    // Grow a tree, appending to branches / leaves. threads <= 1 assigns
+    // attractors on the calling thread; the result does not depend on it
+    void generate(const SpaceColonizationParameters& parameters, int threads, std::mt19937_64& rng,
+                  std::vector<TreeBranch>& branches, std::vector<TreeLeaf>& leaves);
+    
+    int getNodeCount() const { return node_position.size(); }
+};
+
+#endif // SPACE_COLONIZATION_H
@@ -0,0 +1,117 @@
+#include "static_batch.h"
+#include "render_stats.h"
+
+// === PROPS ===
+
+int StaticBatch::add(const float* positions, const float* texcoords, const float* normals, int vertex_count,
+                     const glm::mat4& model, const PropMaterial& material) {
+    Prop prop;
+    prop.first_vertex = getVertexCount();
+    prop.vertex_count = vertex_count;
+    prop.moved = false;
+    props.push_back(prop);
+    
+    for (int i = 0; i < vertex_count; i++) {
+        indices.push_back(prop.first_vertex + i);
+        sources.insert(sources.end(), positions + i * 4, positions + i * 4 + 4);
+        sources.insert(sources.end(), normals + i * 3, normals + i * 3 + 3);
+        float vertex[VERTEX_FLOATS] = {
+            0.0f, 0.0f, 0.0f, 1.0f,
+            texcoords[i * 2], texcoords[i * 2 + 1],
+            0.0f, 0.0f, 0.0f,
+            material.layer, material.mix_ratio, material.ambient, material.emissive ? 1.0f : 0.0f
+        };
+        vertices.insert(vertices.end(), vertex, vertex + VERTEX_FLOATS);
+    }
+    transform(props.size() - 1, model);
+    return props.size() - 1;
+}
+
+int StaticBatch::add(const PrimitiveMesh& primitive, const glm::mat4& model, const PropMaterial& material) {
+    const size_t first_index = indices.size();
+    const GLuint first_vertex = getVertexCount();
+    const int prop = add(primitive.positions.data(), primitive.texcoords.data(), primitive.normals.data(),
+                         primitive.getVertexCount(), model, material);
+    // In place of the sequential ones
+    indices.resize(first_index);
+    for (uint32_t index : primitive.indices) {
+        indices.push_back(first_vertex + index);
+    }
+    return prop;
+}
+
+void StaticBatch::setTransform(int prop, const glm::mat4& model) {
+    transform(prop, model);
+    props[prop].moved = true;
+}
+
+// Positions by model, normals by its inverse transpose, as the scene
+// program would with model in MV
+void StaticBatch::transform(int index, const glm::mat4& model) {
+    const Prop& prop = props[index];
+    glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    for (int i = prop.first_vertex; i < prop.first_vertex + prop.vertex_count; i++) {
+        const float* source = &sources[i * 7];
+        float* vertex = &vertices[i * VERTEX_FLOATS];
+        glm::vec4 position = model * glm::vec4(source[0], source[1], source[2], source[3]);
+        glm::vec3 normal = normal_matrix * glm::vec3(source[4], source[5], source[6]);
+        float length = glm::length(normal);
+        if (length > 0.0f) normal /= length;
+        vertex[0] = position.x;
+        vertex[1] = position.y;
+        vertex[2] = position.z;
+        vertex[3] = position.w;
+        vertex[6] = normal.x;
+        vertex[7] = normal.y;
+        vertex[8] = normal.z;
+    }
+}
+
+void StaticBatch::clear() {
+    props.clear();
+    sources.clear();
+    vertices.clear();
+    indices.clear();
+}
+
+// === GPU ===
+
+void StaticBatch::upload() {
+    const int stride = VERTEX_FLOATS * sizeof(GLfloat);
+    mesh.create(true, false, "static batches");
+    mesh.uploadVertices(vertices.data(), vertices.size() * sizeof(float), GL_DYNAMIC_DRAW);
+    mesh.uploadIndices(indices);
+    mesh.attribute(mesh.vbo, 0, 4, GL_FLOAT, false, stride, 0);                   // vertex
+    mesh.attribute(mesh.vbo, 2, 2, GL_FLOAT, false, stride, 4 * sizeof(GLfloat)); // texcoord
+    mesh.attribute(mesh.vbo, 1, 3, GL_FLOAT, false, stride, 6 * sizeof(GLfloat)); // normal
+    mesh.attribute(mesh.vbo, MATERIAL_LOCATION, 4, GL_FLOAT, false, stride, 9 * sizeof(GLfloat));
+    for (Prop& prop : props) {
+        prop.moved = false;
+    }
+}
+
+void StaticBatch::sync() {
+    if (!mesh.isCreated()) return;
+    bool bound = false;
+    for (Prop& prop : props) {
+        if (!prop.moved) continue;
+        if (!bound) glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        bound = true;
+        glBufferSubData(GL_ARRAY_BUFFER, (size_t)prop.first_vertex * VERTEX_FLOATS * sizeof(float),
+                        (size_t)prop.vertex_count * VERTEX_FLOATS * sizeof(float),
+                        &vertices[prop.first_vertex * VERTEX_FLOATS]);
+        RenderStats::countUpload((size_t)prop.vertex_count * VERTEX_FLOATS * sizeof(float));
+        prop.moved = false;
+    }
+    if (bound) glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StaticBatch::release() {
+    mesh.release();
+}
+
+void StaticBatch::draw() const {
+    mesh.bind();
+    mesh.draw(getIndexCount());
+    GpuMesh::unbind();
+}
@@ -0,0 +1,72 @@
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "gpu_mesh.h"
+#include "primitives.h"
+
+// How a prop of a StaticBatch is shaded: a Material's parameters, carried
+// per vertex
+struct PropMaterial {
+    float layer;     // Layer of the texture array
+    float mix_ratio; // Share of the normal-derived lookup
+    float ambient;   // Ambient light as a fraction of the diffuse colour
+    bool emissive;   // Texture colour only, as the EMISSIVE variant (the sun)
+};
+
+// The scene's props (ground, torches, the sun, anything else static or
+// moved as a whole) pre-transformed into one vertex buffer and drawn with
+// one call by the PROPS variant of the scene program, whatever their
+// number. Each vertex carries its prop's material, so props of different
+// materials still share the draw; moving a prop rewrites only its own
+// vertices, sent by the next sync().
+//
+// Vertices are world-space position (4), texcoord (2), normal (3) and
+// material (layer, mix ratio, ambient, emissive), drawn through one index
+// buffer; the draw's model matrix is the identity
+class StaticBatch {
+public:
+    static const int VERTEX_FLOATS = 13;
+    static const int MATERIAL_LOCATION = 14; // v_simplest.glsl's PROPS input
+    
+    // === PROPS ===
+    // Add vertex_count vertices, positions as (x, y, z, w), texcoords as
+    // (u, v) and normals as (x, y, z), placed by model; returns the prop's
+    // index for setTransform
+    int add(const float* positions, const float* texcoords, const float* normals, int vertex_count,
+            const glm::mat4& model, const PropMaterial& material);
+    // Add an indexed primitive (primitives.h) the same way
+    int add(const PrimitiveMesh& primitive, const glm::mat4& model, const PropMaterial& material);
+    // Place prop anew; sync() sends its vertices
+    void setTransform(int prop, const glm::mat4& model);
+    void clear();
+    int getPropCount() const { return props.size(); }
+    int getVertexCount() const { return vertices.size() / VERTEX_FLOATS; }
+    int getIndexCount() const { return indices.size(); }
+    
+    // === GPU ===
+    // Upload every prop and record the layout at the fixed locations
+    void upload();
+    // Send the vertices of the props moved since the last upload or sync
+    void sync();
+    void release();
+    // One draw of every prop, with a PROPS program in use
+    void draw() const;
+
+private:
+    struct Prop {
+        int first_vertex;
+        int vertex_count;
+        bool moved;
+    };
+    std::vector<Prop> props;
+    std::vector<float> sources;  // Every prop's object-space position and normal, 7 floats a vertex
+    std::vector<float> vertices;
+    std::vector<GLuint> indices;
+    GpuMesh mesh;
+    
+    void transform(int prop, const glm::mat4& model);
+};
+
+#endif // STATIC_BATCH_H
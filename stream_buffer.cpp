@@ -0,0 +1,93 @@
+#include "stream_buffer.h"
+#include "memory_stats.h"
+
+static const size_t REGION_ALIGNMENT = 256; // Keeps every region's attribute offsets aligned
+
+StreamBuffer::StreamBuffer() : buffer(0), mapping(nullptr), region_bytes(0), region(0), stalls(0) {
+    for (int r = 0; r < REGIONS; r++) {
+        fences[r] = 0;
+        stale_whole[r] = true;
+    }
+}
+
+StreamBuffer::~StreamBuffer() {
+    release();
+}
+
+bool StreamBuffer::isSupported() {
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+bool StreamBuffer::reserve(size_t bytes) {
+    if (isCreated() && bytes <= region_bytes) return true;
+    release();
+    region_bytes = (bytes + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT * REGION_ALIGNMENT;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferStorage(GL_ARRAY_BUFFER, REGIONS * region_bytes, nullptr, flags);
+    MemoryStats::trackBuffer(buffer, REGIONS * region_bytes, "stream buffers");
+    mapping = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, REGIONS * region_bytes, flags);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (mapping == nullptr) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+// The store is unmapped with it; the fences go as well, a deleted buffer
+// staying alive for the draws still reading it
+void StreamBuffer::release() {
+    for (int r = 0; r < REGIONS; r++) {
+        if (fences[r]) glDeleteSync(fences[r]);
+        fences[r] = 0;
+        stale[r].clear();
+        stale_whole[r] = true;
+    }
+    if (buffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        MemoryStats::forgetBuffers(1, &buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapping = nullptr;
+    region_bytes = 0;
+    region = 0;
+}
+
+// === PER FRAME ===
+
+void StreamBuffer::beginFrame(const std::vector<MeshDirtyRange>& changed, bool whole) {
+    region = (region + 1) % REGIONS;
+    for (int r = 0; r < REGIONS; r++) {
+        if (whole) {
+            stale_whole[r] = true;
+            stale[r].clear();
+        } else if (!stale_whole[r]) {
+            stale[r].insert(stale[r].end(), changed.begin(), changed.end());
+        }
+    }
+    
+    GLsync& fence = fences[region];
+    if (fence == 0) return;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        stalls++;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+void StreamBuffer::endFrame() {
+    if (!isCreated()) return;
+    if (fences[region]) glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stale[region].clear();
+    stale_whole[region] = false;
+}
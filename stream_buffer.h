@@ -0,0 +1,67 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+#include "tree_simple.h"
+
+// A vertex buffer for an array that changes every frame: REGIONS copies of
+// it in one immutable store, mapped once for good (persistent and
+// coherent, GL 4.4 or ARB_buffer_storage). Each frame writes the next
+// region and draws from it; a fence behind the frame's draws guards the
+// region, and beginFrame() waits on it before the region is written again,
+// REGIONS frames later, so the CPU never writes what the GPU still reads
+// and no upload call or reallocation happens per frame.
+//
+// A region comes round REGIONS frames stale, so its writes are the byte
+// ranges changed this frame and those the other regions took since it was
+// last written. The caller writes them into getRegion() itself (converting
+// on the way if it likes) and points its vertex attributes at
+// getRegionOffset()
+class StreamBuffer {
+public:
+    static const int REGIONS = 3;
+    
+    StreamBuffer();
+    ~StreamBuffer();
+    
+    static bool isSupported();
+    // Room for region_bytes in every region; more than the capacity makes a
+    // new store, every region then written whole. False when the store
+    // cannot be mapped
+    bool reserve(size_t region_bytes);
+    void release();
+    bool isCreated() const { return buffer != 0; }
+    GLuint getBuffer() const { return buffer; }
+    size_t getCapacity() const { return region_bytes; }
+    
+    // === PER FRAME ===
+    // Move to the next region once the GPU is done with it, with this
+    // frame's changed ranges (or all of it when whole)
+    void beginFrame(const std::vector<MeshDirtyRange>& changed, bool whole);
+    char* getRegion() const { return mapping + getRegionOffset(); }
+    size_t getRegionOffset() const { return region * region_bytes; }
+    // What the region needs: everything, or these ranges
+    bool isWritingWhole() const { return stale_whole[region]; }
+    const std::vector<MeshDirtyRange>& getWrites() const { return stale[region]; }
+    // Fence the region behind the draws issued from it; its writes are done
+    void endFrame();
+    // Frames whose beginFrame() had to wait for the GPU
+    int getStalls() const { return stalls; }
+
+private:
+    GLuint buffer;
+    char* mapping;
+    size_t region_bytes;
+    int region;                                 // Written and drawn this frame
+    GLsync fences[REGIONS];
+    std::vector<MeshDirtyRange> stale[REGIONS]; // Ranges each region lacks
+    bool stale_whole[REGIONS];
+    int stalls;
+    
+    StreamBuffer(const StreamBuffer&);
+    StreamBuffer& operator=(const StreamBuffer&);
+};
+
+#endif // STREAM_BUFFER_H
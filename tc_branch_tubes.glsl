@@ -0,0 +1,68 @@
+#version 400
+
+/*
+ * BRANCH TUBE TESSELLATION CONTROL SHADER (the BRANCH_TUBES variants)
+ *
+ * Each branch arrives as a patch of two control points, the halves of its
+ * BranchInstance record (tree_simple.h) as for a branch line: (animated
+ * start, base radius) and (animated end, growth progress). This stage
+ * chooses how finely te_branch_tubes.glsl cuts the tube: sides around it
+ * from its radius on screen, sections along it from how far its bow bends
+ * on screen. The levels are fractional, so the detail follows the distance
+ * without popping. Without a pixel scale (the shadow and impostor passes)
+ * the ring has the CPU mesh's 8 sides
+ */
+
+const float SIDES_PER_PIXEL = 1.5; // Around the ring, per pixel of radius
+const float MIN_SIDES = 3.0;
+const float MAX_SIDES = 16.0;
+const float MAX_SECTIONS = 16.0;
+// Bow of a level branch, as a share of its length; slender branches bow
+// fully, those thicker than a thirtieth of their length less
+const float BOW_SHARE = 0.05;
+const float SLENDER_RATIO = 30.0;
+
+layout(vertices = 2) out;
+
+uniform mat4 MV; // Model-view matrix (object space -> eye space)
+uniform float branchPixelScale; // Pixels a unit spans at unit eye distance, 0 = fixed detail
+
+in vec4 branchPoint[]; // v_simplest.glsl passes the record's halves on as they are
+out vec4 tubePoint[];
+patch out float tubeBow; // How far the axis sags below the chord at mid-length
+
+void main(void) {
+    tubePoint[gl_InvocationID] = branchPoint[gl_InvocationID];
+    if (gl_InvocationID != 0) return;
+    
+    vec3 axis = branchPoint[1].xyz - branchPoint[0].xyz;
+    float radius = branchPoint[0].w;
+    float len = length(axis);
+    // Not started yet, or not out of its parent: level 0 drops the patch
+    if (branchPoint[1].w <= 0.0 || len < 1e-6) {
+        gl_TessLevelOuter[0] = 0.0;
+        gl_TessLevelOuter[1] = 0.0;
+        gl_TessLevelOuter[2] = 0.0;
+        gl_TessLevelOuter[3] = 0.0;
+        return;
+    }
+    float horizontal = sqrt(max(1.0 - axis.y * axis.y / (len * len), 0.0)); // The trunk stands straight
+    tubeBow = BOW_SHARE * len * horizontal * clamp(len / (radius * SLENDER_RATIO), 0.0, 1.0);
+    
+    float sides = 8.0;
+    float sections = tubeBow > 0.0 ? 4.0 : 1.0;
+    if (branchPixelScale > 0.0) {
+        float eyeDistance = max(-(MV * vec4(0.5 * (branchPoint[0].xyz + branchPoint[1].xyz), 1.0)).z, 0.01);
+        float pixels = branchPixelScale / eyeDistance;
+        sides = clamp(SIDES_PER_PIXEL * radius * pixels, MIN_SIDES, MAX_SIDES);
+        // n straight sections miss a bow of b pixels by about b / n^2
+        sections = clamp(sqrt(2.0 * tubeBow * pixels), 1.0, MAX_SECTIONS);
+    }
+    // u runs around the ring, v along the branch
+    gl_TessLevelOuter[0] = sections; // The u = 0 and u = 1 seam
+    gl_TessLevelOuter[1] = sides;    // The base ring
+    gl_TessLevelOuter[2] = sections;
+    gl_TessLevelOuter[3] = sides;    // The tip ring
+    gl_TessLevelInner[0] = sides;
+    gl_TessLevelInner[1] = sections;
+}
@@ -0,0 +1,63 @@
+#version 400
+
+/*
+ * BRANCH TUBE TESSELLATION EVALUATION SHADER (the BRANCH_TUBES variants)
+ *
+ * Places a vertex of a branch's tube: u round the ring, v from the base to
+ * the tip. The axis is a parabola through the record's fixed ends, sagging
+ * tubeBow below the chord at mid-length (tc_branch_tubes.glsl), so the
+ * children and leaves at the ends stay put. The ring is the instanced
+ * cylinder's frame turned onto the axis' slope, 70% of the base radius at
+ * the tip. The outputs are v_simplest.glsl's, for f_simplest.glsl
+ */
+
+layout(quads, fractional_odd_spacing, ccw) in;
+
+uniform mat4 MV; // Model-view matrix (object space -> eye space)
+uniform mat4 MVP; // Model-view-projection matrix (object space -> clip space)
+uniform mat3 normalMatrix; // Inverse transpose of MV's upper 3x3 (object normals -> eye space)
+
+in vec4 tubePoint[];
+patch in float tubeBow;
+
+//Bit-identical to the depth prepass, like the vertex shader's positions
+invariant gl_Position;
+
+out mediump vec3 n; // Normal vector in eye space (surface orientation), as v_simplest.glsl's
+out vec3 eyePosition; // Vertex position in eye space; the light and view vectors start here
+out vec2 iTexCoord0; // (around the ring, along the branch) like the unit cylinder's texcoords
+out float occlusion; // Always open: the records carry no bake
+
+void main(void) {
+    float u = gl_TessCoord.x;
+    float v = gl_TessCoord.y;
+    vec3 start = tubePoint[0].xyz;
+    vec3 end = tubePoint[1].xyz;
+    float radius = tubePoint[0].w * mix(1.0, 0.7, v); // 70% radius at tip
+    vec3 axis = end - start;
+    
+    vec3 direction = normalize(axis);
+    vec3 up = (abs(direction.y) > 0.9) ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(direction, up));
+    
+    // Down, square to the chord; a branch that bows is never vertical
+    vec3 sag = vec3(0.0);
+    if (tubeBow > 0.0) {
+        sag = normalize(vec3(0.0, -1.0, 0.0) + direction * direction.y) * tubeBow;
+    }
+    vec3 center = mix(start, end, v) + sag * (4.0 * v * (1.0 - v));
+    vec3 tangent = normalize(axis + sag * (4.0 - 8.0 * v));
+    vec3 ringX = normalize(right - tangent * dot(right, tangent));
+    vec3 ringY = cross(ringX, tangent);
+    
+    // u = 1 is u = 0 exactly, so the seam closes
+    float angle = (u < 1.0) ? 6.2831853 * u : 0.0;
+    vec3 radial = ringX * cos(angle) + ringY * sin(angle);
+    vec4 modelVertex = vec4(center + radial * radius, 1.0);
+    
+    eyePosition = (MV * modelVertex).xyz;
+    n = normalize(normalMatrix * radial);
+    iTexCoord0 = vec2(u, v);
+    occlusion = 1.0;
+    gl_Position = MVP * modelVertex;
+}
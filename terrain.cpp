@@ -0,0 +1,305 @@
+#include "terrain.h"
+#include "frustum.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include "render_stats.h"
+#include "shaderprogram.h"
+#include <algorithm>
+#include <cmath>
+
+// Share of a level's range, from the previous level's, before its odd
+// vertices start moving onto the next coarser level's
+static const float MORPH_START = 0.7f;
+static const float NOISE_FREQUENCY = 1.0f / 12.0f; // Of the first octave, per world unit
+static const int NOISE_OCTAVES = 5;
+
+// === NOISE ===
+
+static float lattice(int x, int z, uint32_t seed) {
+    uint32_t h = seed ^ ((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)z * 0xd8163841u);
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return (h & 0xffffff) / (float)0xffffff;
+}
+
+// Smoothly interpolated lattice values in [0, 1]
+static float valueNoise(float x, float z, uint32_t seed) {
+    int x0 = (int)std::floor(x);
+    int z0 = (int)std::floor(z);
+    float fx = x - x0;
+    float fz = z - z0;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+    float a = lattice(x0, z0, seed) + (lattice(x0 + 1, z0, seed) - lattice(x0, z0, seed)) * fx;
+    float b = lattice(x0, z0 + 1, seed) + (lattice(x0 + 1, z0 + 1, seed) - lattice(x0, z0 + 1, seed)) * fx;
+    return a + (b - a) * fz;
+}
+
+// Octaves of value noise, each twice the frequency and half the amplitude
+// of the one before, normalized back to [0, 1]
+static float fractalNoise(float x, float z, uint32_t seed) {
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    float total = 0.0f;
+    float frequency = NOISE_FREQUENCY;
+    for (int octave = 0; octave < NOISE_OCTAVES; octave++) {
+        sum += valueNoise(x * frequency, z * frequency, seed + octave) * amplitude;
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    return sum / total;
+}
+
+Terrain::Terrain()
+    : half_extent(0.0f), samples(0), levels(0), pixel_error(8.0f), eye(0.0f), height_texture(0),
+      chunk_buffer_size(0) {
+    std::fill(ranges, ranges + MAX_LEVELS, 0.0f);
+}
+
+Terrain::~Terrain() {
+    release();
+}
+
+// === HEIGHTS ===
+
+void Terrain::generate(float new_half_extent, int chunks_per_side, float height, float flat_radius, uint32_t seed) {
+    half_extent = std::max(new_half_extent, 0.001f);
+    int per_side = 1;
+    levels = 1;
+    while (per_side < chunks_per_side && levels < MAX_LEVELS) {
+        per_side *= 2;
+        levels++;
+    }
+    samples = per_side * GRID + 1;
+    
+    heights.resize((size_t)samples * samples);
+    float spacing = 2.0f * half_extent / (samples - 1);
+    for (int z = 0; z < samples; z++) {
+        for (int x = 0; x < samples; x++) {
+            float wx = -half_extent + x * spacing;
+            float wz = -half_extent + z * spacing;
+            // Flat at the origin, the hills rising from flat_radius on
+            float t = glm::clamp((std::sqrt(wx * wx + wz * wz) - flat_radius) / std::max(flat_radius, 0.001f),
+                                 0.0f, 1.0f);
+            float blend = t * t * (3.0f - 2.0f * t);
+            heights[(size_t)z * samples + x] = fractalNoise(wx, wz, seed) * height * blend;
+        }
+    }
+    
+    nodes.assign(1, Node());
+    buildNode(0, glm::vec2(-half_extent), 2.0f * half_extent, levels - 1, 0, 0, samples - 1);
+}
+
+float Terrain::sample(int x, int z) const {
+    x = std::min(std::max(x, 0), samples - 1);
+    z = std::min(std::max(z, 0), samples - 1);
+    return heights[(size_t)z * samples + x];
+}
+
+// The children go in four consecutive nodes, appended before recursing, so
+// the tree is addressed by index only while it grows
+void Terrain::buildNode(int index, const glm::vec2& corner, float size, int level, int x0, int z0, int span) {
+    Node node;
+    node.corner = corner;
+    node.size = size;
+    node.level = level;
+    node.first_child = -1;
+    node.min_height = 1e30f;
+    node.max_height = -1e30f;
+    if (level == 0) {
+        for (int z = z0; z <= z0 + span; z++) {
+            for (int x = x0; x <= x0 + span; x++) {
+                node.min_height = std::min(node.min_height, sample(x, z));
+                node.max_height = std::max(node.max_height, sample(x, z));
+            }
+        }
+    } else {
+        node.first_child = nodes.size();
+        nodes.resize(nodes.size() + 4);
+        int half = span / 2;
+        for (int c = 0; c < 4; c++) {
+            int cx = c & 1;
+            int cz = c >> 1;
+            buildNode(node.first_child + c, corner + glm::vec2(cx, cz) * (size * 0.5f), size * 0.5f, level - 1,
+                      x0 + cx * half, z0 + cz * half, half);
+            node.min_height = std::min(node.min_height, nodes[node.first_child + c].min_height);
+            node.max_height = std::max(node.max_height, nodes[node.first_child + c].max_height);
+        }
+    }
+    nodes[index] = node;
+}
+
+float Terrain::heightAt(float x, float z) const {
+    if (samples < 2) return 0.0f;
+    float u = glm::clamp((x + half_extent) / (2.0f * half_extent), 0.0f, 1.0f) * (samples - 1);
+    float v = glm::clamp((z + half_extent) / (2.0f * half_extent), 0.0f, 1.0f) * (samples - 1);
+    int x0 = std::min((int)u, samples - 2);
+    int z0 = std::min((int)v, samples - 2);
+    float fx = u - x0;
+    float fz = v - z0;
+    float a = sample(x0, z0) + (sample(x0 + 1, z0) - sample(x0, z0)) * fx;
+    float b = sample(x0, z0 + 1) + (sample(x0 + 1, z0 + 1) - sample(x0, z0 + 1)) * fx;
+    return a + (b - a) * fz;
+}
+
+// Central differences over one sample spacing, as the TERRAIN shader takes them
+glm::vec3 Terrain::normalAt(float x, float z) const {
+    if (samples < 2) return glm::vec3(0.0f, 1.0f, 0.0f);
+    float e = 2.0f * half_extent / (samples - 1);
+    glm::vec3 normal(heightAt(x - e, z) - heightAt(x + e, z), 2.0f * e, heightAt(x, z - e) - heightAt(x, z + e));
+    return glm::normalize(normal);
+}
+
+// === GPU ===
+
+void Terrain::upload() {
+    if (samples < 2) return;
+    // Linear filtering interpolates the heights as heightAt does
+    if (height_texture == 0) glGenTextures(1, &height_texture);
+    glBindTexture(GL_TEXTURE_2D, height_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, samples, samples, 0, GL_RED, GL_FLOAT, heights.data());
+    MemoryStats::trackTexture(height_texture, MemoryStats::textureBytes(GL_R32F, samples, samples), "terrain");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    // One chunk's grid, (x, z) in [0, 1], its triangles facing +y
+    const int row = GRID + 1;
+    std::vector<float> grid;
+    grid.reserve(row * row * 2);
+    for (int z = 0; z <= GRID; z++) {
+        for (int x = 0; x <= GRID; x++) {
+            grid.push_back((float)x / GRID);
+            grid.push_back((float)z / GRID);
+        }
+    }
+    std::vector<GLuint> indices;
+    indices.reserve(GRID * GRID * 6);
+    for (int z = 0; z < GRID; z++) {
+        for (int x = 0; x < GRID; x++) {
+            GLuint a = z * row + x;
+            indices.push_back(a);
+            indices.push_back(a + row);
+            indices.push_back(a + 1);
+            indices.push_back(a + 1);
+            indices.push_back(a + row);
+            indices.push_back(a + row + 1);
+        }
+    }
+    // Rows of GRID + 1 vertices outrun the cache, so row order shades
+    // nearly every vertex twice
+    generated_cache = analyzeVertexCache(indices.data(), indices.size());
+    optimizeVertexCache(indices.data(), indices.size());
+    optimizeVertexFetch(grid, 2, indices);
+    optimized_cache = analyzeVertexCache(indices.data(), indices.size());
+    mesh.create(true, true, "terrain");
+    mesh.uploadVertices(grid.data(), grid.size() * sizeof(float), GL_STATIC_DRAW);
+    mesh.uploadIndices(indices);
+    mesh.attribute(mesh.vbo, 0, 2, GL_FLOAT, false, 2 * sizeof(GLfloat), 0); // vertex
+    mesh.attribute(mesh.instance_vbo, NODE_LOCATION, 4, GL_FLOAT, false, sizeof(glm::vec4), 0, 1);
+    chunk_buffer_size = 0;
+}
+
+void Terrain::release() {
+    mesh.release();
+    MemoryStats::forgetTextures(1, &height_texture);
+    if (height_texture) glDeleteTextures(1, &height_texture);
+    height_texture = 0;
+    chunk_buffer_size = 0;
+}
+
+// === PER FRAME ===
+
+// Level L's samples are spacing * 2^L apart, and stay within the pixel
+// error up to the distance where the next level's would; the coarsest
+// level takes everything beyond
+void Terrain::select(const ViewFrustum* frustum, const glm::vec3& new_eye, float fov_y, int viewport_height) {
+    chunks.clear();
+    if (nodes.empty()) return;
+    eye = new_eye;
+    float spacing = 2.0f * half_extent / (samples - 1);
+    float pixels_per_distance = viewport_height / (2.0f * std::tan(fov_y * 0.5f) * std::max(pixel_error, 0.01f));
+    for (int level = 0; level < levels; level++) {
+        ranges[level] = spacing * (float)(2 << level) * pixels_per_distance;
+    }
+    ranges[levels - 1] = 1e30f;
+    selectNode(nodes[0], frustum);
+    
+    if (!mesh.isCreated() || chunks.empty()) return;
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.instance_vbo);
+    size_t bytes = chunks.size() * sizeof(glm::vec4);
+    if (bytes > chunk_buffer_size) {
+        glBufferData(GL_ARRAY_BUFFER, bytes, chunks.data(), GL_STREAM_DRAW);
+        MemoryStats::trackBuffer(mesh.instance_vbo, bytes, "terrain");
+        chunk_buffer_size = bytes;
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, chunks.data());
+    }
+    RenderStats::countUpload(bytes);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Whether any of node's box is within range of the eye
+bool Terrain::reaches(const Node& node, float range) const {
+    glm::vec3 min(node.corner.x, node.min_height, node.corner.y);
+    glm::vec3 max(node.corner.x + node.size, node.max_height, node.corner.y + node.size);
+    glm::vec3 nearest = glm::clamp(eye, min, max);
+    glm::vec3 offset = nearest - eye;
+    return glm::dot(offset, offset) <= range * range;
+}
+
+// False when node is beyond its level's range, for the parent to cover.
+// A child left to its parent is still drawn as its own grid: being beyond
+// its level's range, it is morphed all the way to the parent's
+bool Terrain::selectNode(const Node& node, const ViewFrustum* frustum) {
+    if (!reaches(node, ranges[node.level])) return false;
+    glm::vec3 min(node.corner.x, node.min_height, node.corner.y);
+    glm::vec3 max(node.corner.x + node.size, node.max_height, node.corner.y + node.size);
+    if (frustum && frustum->classify(min, max) < 0) return true;
+    if (node.level == 0 || !reaches(node, ranges[node.level - 1])) {
+        chunks.push_back(glm::vec4(node.corner, node.size, node.level));
+        return true;
+    }
+    for (int c = 0; c < 4; c++) {
+        const Node& child = nodes[node.first_child + c];
+        if (selectNode(child, frustum)) continue;
+        glm::vec3 child_min(child.corner.x, child.min_height, child.corner.y);
+        glm::vec3 child_max(child.corner.x + child.size, child.max_height, child.corner.y + child.size);
+        if (frustum && frustum->classify(child_min, child_max) < 0) continue;
+        chunks.push_back(glm::vec4(child.corner, child.size, child.level));
+    }
+    return true;
+}
+
+void Terrain::draw(GlStateCache& state) const {
+    if (!mesh.isCreated() || chunks.empty()) return;
+    bindHeights(state);
+    // Each level morphs over the last part of its range
+    GLfloat morph[MAX_LEVELS * 2];
+    float previous = 0.0f;
+    for (int level = 0; level < MAX_LEVELS; level++) {
+        float end = level < levels ? ranges[level] : 1e30f;
+        morph[level * 2] = previous + (end - previous) * MORPH_START;
+        morph[level * 2 + 1] = end;
+        previous = end;
+    }
+    glUniform2fv(state.getProgram()->u("terrainMorph"), MAX_LEVELS, morph);
+    state.uniform3fv("terrainEye", &eye[0]);
+    state.uniform1f("terrainGrid", (float)GRID);
+    mesh.bind();
+    mesh.drawInstanced(GRID * GRID * 6, chunks.size(), 0);
+    GpuMesh::unbind();
+}
+
+void Terrain::bindHeights(GlStateCache& state) const {
+    state.bindTexture(HEIGHT_UNIT, GL_TEXTURE_2D, height_texture);
+    state.uniform1i("heightMap", HEIGHT_UNIT);
+    glUniform4f(state.getProgram()->u("terrainBounds"), -half_extent, -half_extent, 2.0f * half_extent,
+                (float)(samples - 1));
+}
@@ -0,0 +1,110 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "gpu_mesh.h"
+#include "vertex_cache.h"
+
+class GlStateCache;
+struct ViewFrustum;
+
+// A heightfield ground drawn with continuous distance-dependent levels of
+// detail (CDLOD): the heights are a square grid of samples, generated as
+// fractal noise flattened around the origin where the tree stands, and a
+// quadtree of chunks over them. Every frame select() walks the quadtree
+// and keeps, for each area, the coarsest chunk whose sample spacing still
+// projects to at most the pixel error, culling chunks outside the frustum.
+// All chosen chunks are instances of one GRID x GRID vertex grid, drawn in
+// one call by the TERRAIN variant of v_simplest.glsl, which reads the
+// heights from a texture and, over the last part of each level's range,
+// morphs the grid's odd vertices onto the next coarser level's so levels
+// meet without cracks or pops.
+//
+// heightAt() and normalAt() query the same surface on the CPU, so trees and
+// props can be planted on it. upload() and draw() bind the height texture
+// directly, behind a GlStateCache's back (GlStateCache::invalidateTextures)
+class Terrain {
+public:
+    static const int GRID = 32;           // Quads along a chunk's side
+    static const int MAX_LEVELS = 12;     // v_simplest.glsl's terrainMorph array
+    static const int HEIGHT_UNIT = 13;    // The heightMap sampler's unit
+    static const int NODE_LOCATION = 14;  // v_simplest.glsl's TERRAIN input
+    
+    Terrain();
+    ~Terrain();
+    
+    // === HEIGHTS ===
+    // Heights over the square of half_extent around the origin, with
+    // chunks_per_side finest chunks (rounded up to a power of two) along a
+    // side: noise up to height, flat within flat_radius of the origin
+    // and blending into the hills over as much again
+    void generate(float half_extent, int chunks_per_side, float height, float flat_radius, uint32_t seed);
+    // Bilinear height and normal at (x, z), clamped to the edge outside
+    float heightAt(float x, float z) const;
+    glm::vec3 normalAt(float x, float z) const;
+    float getHalfExtent() const { return half_extent; }
+    int getLevels() const { return levels; }
+    
+    // === LEVELS OF DETAIL ===
+    // Largest on-screen size of a level's sample spacing, in pixels
+    void setPixelError(float pixels) { pixel_error = pixels; }
+    
+    // === GPU ===
+    // Build the chunk grid, its triangles reordered for the vertex cache,
+    // and upload it with the heights
+    void upload();
+    void release();
+    // The grid's vertex cache use in row order, and as drawn
+    const VertexCacheStats& getGeneratedCacheStats() const { return generated_cache; }
+    const VertexCacheStats& getOptimizedCacheStats() const { return optimized_cache; }
+    
+    // === PER FRAME ===
+    // Choose the chunks for the eye, the vertical field of view and the
+    // viewport height in pixels, cull them against the frustum (nullptr =
+    // keep all) and upload them
+    void select(const ViewFrustum* frustum, const glm::vec3& eye, float fov_y, int viewport_height);
+    int getDrawnChunks() const { return chunks.size(); }
+    // The chunks with a TERRAIN program in use
+    void draw(GlStateCache& state) const;
+    // Bind the height texture and set heightMap and terrainBounds for the
+    // program in use, for anything else standing on the surface
+    void bindHeights(GlStateCache& state) const;
+
+private:
+    struct Node {
+        glm::vec2 corner; // Smallest x and z
+        float size;
+        float min_height;
+        float max_height;
+        int level;        // 0 = finest
+        int first_child;  // Four children from here, -1 = a finest chunk
+    };
+    float half_extent;
+    int samples;                   // Heights along a side, a power of two plus one
+    std::vector<float> heights;    // samples x samples, row by row along +z
+    std::vector<Node> nodes;       // The quadtree, root first
+    int levels;
+    float pixel_error;
+    
+    float ranges[MAX_LEVELS];      // Farthest distance each level is drawn at, this frame
+    glm::vec3 eye;
+    std::vector<glm::vec4> chunks; // This frame's (corner x, corner z, size, level)
+    GpuMesh mesh;
+    VertexCacheStats generated_cache;
+    VertexCacheStats optimized_cache;
+    GLuint height_texture;
+    size_t chunk_buffer_size;
+    
+    float sample(int x, int z) const;
+    void buildNode(int index, const glm::vec2& corner, float size, int level, int x0, int z0, int span);
+    bool selectNode(const Node& node, const ViewFrustum* frustum);
+    bool reaches(const Node& node, float range) const;
+    
+    Terrain(const Terrain&);
+    Terrain& operator=(const Terrain&);
+};
+
+#endif // TERRAIN_H
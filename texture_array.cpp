@@ -0,0 +1,422 @@
+#include "texture_array.h"
+#include "gl_dsa.h"
+#include "job_system.h"
+#include "lodepng.h"
+#include "logging.h"
+#include "memory_stats.h"
+#include "profiler.h"
+#include "resource_bundle.h"
+#include "texture_pack.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace {
+
+struct Tap {
+    int index;
+    float weight;
+};
+
+// Source taps of each destination texel along one axis: the texels under
+// its footprint, weighted by overlap, when shrinking; the two nearest
+// texel centers when growing
+std::vector<std::vector<Tap> > axisTaps(int src_size, int dst_size) {
+    std::vector<std::vector<Tap> > taps(dst_size);
+    float scale = (float)src_size / dst_size;
+    for (int i = 0; i < dst_size; i++) {
+        if (scale > 1.0f) {
+            float start = i * scale;
+            float end = start + scale;
+            for (int s = (int)start; s < src_size && s < end; s++) {
+                float overlap = std::min(end, s + 1.0f) - std::max(start, (float)s);
+                if (overlap > 0.0f) {
+                    Tap tap = { s, overlap / scale };
+                    taps[i].push_back(tap);
+                }
+            }
+        } else {
+            float center = std::max((i + 0.5f) * scale - 0.5f, 0.0f);
+            int s = std::min((int)center, src_size - 1);
+            float t = center - s;
+            Tap first = { s, 1.0f - t };
+            Tap second = { std::min(s + 1, src_size - 1), t };
+            taps[i].push_back(first);
+            taps[i].push_back(second);
+        }
+    }
+    return taps;
+}
+
+// lodepng_decode_stream callback copying each band of rows into the layer
+// passed as user
+unsigned copyRows(void* user, const unsigned char* rows, size_t stride, unsigned y, unsigned count) {
+    std::memcpy((unsigned char*)user + y * stride, rows, stride * count);
+    return 0;
+}
+
+// Run task(k) for every k below count on at most threads threads of the
+// job system (0 = all of them), the calling thread among them, one index a
+// chunk so a slow item doesn't hold up the others
+template <typename Task>
+void runConcurrently(size_t count, int threads, const Task& task) {
+    JobSystem::shared().parallelFor(count, 1, [&](int k, int, int) { task(k); }, threads);
+}
+
+}
+
+static const char TEXTURE_CACHE_MAGIC[8] = {'T', 'E', 'X', 'R', 'A', 'W', '0', '1'};
+
+// Start of a cache file, followed by key_length bytes of key and the
+// layer's width * height * 4 bytes
+struct TextureCacheHeader {
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t key_length;
+    uint32_t reserved;
+};
+
+std::string TextureArrayBuilder::cache_directory;
+
+TextureArrayBuilder::TextureArrayBuilder(int width, int height)
+    : width(width), height(height), layer_count(0), upload_buffer(0), mapped(nullptr), mapped_capacity(0) {}
+
+TextureArrayBuilder::~TextureArrayBuilder() {
+    releaseUploadBuffer();
+    MemoryStats::removeScratch(pixels.size());
+}
+
+// === LAYER STORAGE ===
+
+bool TextureArrayBuilder::mapUploadBuffer(int layers) {
+    if (layer_count > 0 || upload_buffer != 0 || layers <= 0) return false;
+    glGenBuffers(1, &upload_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, layers * layerBytes(), nullptr, GL_STREAM_DRAW);
+    MemoryStats::trackBuffer(upload_buffer, layers * layerBytes(), "texture uploads");
+    mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, layers * layerBytes(),
+                                                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!mapped) {
+        releaseUploadBuffer();
+        return false;
+    }
+    mapped_capacity = layers;
+    return true;
+}
+
+void TextureArrayBuilder::releaseUploadBuffer() {
+    if (upload_buffer == 0) return;
+    if (mapped) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    MemoryStats::forgetBuffers(1, &upload_buffer);
+    glDeleteBuffers(1, &upload_buffer);
+    upload_buffer = 0;
+    mapped = nullptr;
+    mapped_capacity = 0;
+}
+
+unsigned char* TextureArrayBuilder::appendLayers(int count) {
+    int first = layer_count;
+    if (upload_buffer != 0) {
+        if (first + count > mapped_capacity) {
+            LOG_WARNING(Texture) << "Texture array is full (" << mapped_capacity << " layers)";
+            return nullptr;
+        }
+        layer_count += count;
+        memset(mapped + first * layerBytes(), 0, count * layerBytes());
+        return mapped + first * layerBytes();
+    }
+    layer_count += count;
+    pixels.resize(layer_count * layerBytes(), 0);
+    MemoryStats::addScratch(count * layerBytes());
+    return &pixels[first * layerBytes()];
+}
+
+// === DECODED LAYER CACHE ===
+
+std::string TextureArrayBuilder::cachePath(const char* filename, std::string& key) const {
+    struct stat source;
+    if (cache_directory.empty() || stat(filename, &source) != 0) return "";
+    key = std::string(filename) + "|" + std::to_string((long long)source.st_size) + "|" +
+          std::to_string((long long)source.st_mtime) + "|" + std::to_string(width) + "x" + std::to_string(height);
+    
+    // An FNV-1a hash of the key names the file, which repeats the key so a
+    // collision reads as a miss, as in the shader binary cache
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "texture_%016llx.raw", hash);
+    return cache_directory + "/" + name;
+}
+
+bool TextureArrayBuilder::loadCached(const std::string& path, const std::string& key, unsigned char* layer) const {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    TextureCacheHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.width != (uint32_t)width || header.height != (uint32_t)height || header.key_length != key.size()) {
+        return false;
+    }
+    std::string stored(key.size(), '\0');
+    if (!in.read(&stored[0], stored.size()) || stored != key) return false;
+    // Straight into the layer: the pixels are ready to upload
+    return (bool)in.read(reinterpret_cast<char*>(layer), (size_t)width * height * 4);
+}
+
+void TextureArrayBuilder::saveCached(const std::string& path, const std::string& key, const unsigned char* layer) const {
+    TextureCacheHeader header;
+    memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+    header.width = width;
+    header.height = height;
+    header.key_length = key.size();
+    header.reserved = 0;
+    
+    // Write next to the target, then rename over it, so a concurrent start
+    // never reads half a layer
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(key.data(), key.size());
+    out.write(reinterpret_cast<const char*>(layer), (size_t)width * height * 4);
+    out.close();
+    if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+    }
+}
+
+bool TextureArrayBuilder::decodePngData(const unsigned char* png, size_t size, unsigned char* layer,
+                                        std::string& error) const {
+    lodepng::State state;
+    unsigned image_width = 0, image_height = 0;
+    unsigned code = lodepng_inspect(&image_width, &image_height, &state, png, size);
+    if (!code && image_width == (unsigned)width && image_height == (unsigned)height) {
+        // Already the layer size: stream the rows straight into the layer,
+        // which may be the mapped upload buffer, without ever holding the
+        // whole inflated image
+        code = lodepng_decode_stream(&image_width, &image_height, &state, png, size,
+                                     64, copyRows, layer);
+        if (code) std::memset(layer, 0, layerBytes());
+    } else if (!code) {
+        std::vector<unsigned char> image;
+        ScratchMemory scratch;
+        // lodepng's own pixel limit, checked before allocating for them
+        if ((unsigned long long)image_width * image_height > 268435455ull) {
+            code = 92;
+        } else {
+            image.resize((size_t)image_width * image_height * 4);
+            scratch.resize(image.size());
+            code = lodepng_decode_into(image.data(), image_width * 4, image.size(), &image_width,
+                                       &image_height, &state, png, size);
+        }
+        if (!code) resample(image.data(), image_width, image_height, layer, width, height);
+    }
+    if (code) {
+        error = lodepng_error_text(code);
+        return false;
+    }
+    return true;
+}
+
+bool TextureArrayBuilder::decodePng(const char* filename, unsigned char* layer, std::string& error) const {
+    PROFILE_SCOPE("TextureArrayBuilder::decodePng");
+    // A bundled PNG is decoded in place; the cache, keyed by a file's size
+    // and time, is for loose files
+    size_t bundled = 0;
+    const unsigned char* bytes = ResourceBundle::shared().find(filename, bundled);
+    if (bytes) return decodePngData(bytes, bundled, layer, error);
+    
+    std::string key;
+    std::string cache = cachePath(filename, key);
+    if (!cache.empty() && loadCached(cache, key, layer)) return true;
+    
+    std::vector<unsigned char> png;
+    unsigned code = lodepng::load_file(png, filename);
+    if (code) {
+        error = lodepng_error_text(code);
+        return false;
+    }
+    ScratchMemory scratch(png.size());
+    if (!decodePngData(png.data(), png.size(), layer, error)) return false;
+    if (!cache.empty()) saveCached(cache, key, layer);
+    return true;
+}
+
+int TextureArrayBuilder::addPng(const char* filename) {
+    return addPngs(std::vector<std::string>(1, filename), 1);
+}
+
+int TextureArrayBuilder::addPngs(const std::vector<std::string>& filenames, int threads) {
+    PROFILE_SCOPE("TextureArrayBuilder::addPngs");
+    // Every file gets its zeroed layer up front, so the workers write
+    // disjoint ranges and a failed decode leaves transparent black
+    int first = getLayerCount();
+    unsigned char* layers = appendLayers(filenames.size());
+    if (!layers) return -1;
+    
+    // === DECODE ON A SHARED COUNTER ===
+    // lodepng keeps no global state, so decodes of different files run in
+    // parallel; the slowest file bounds the total instead of the sum
+    const size_t file_count = filenames.size();
+    std::vector<std::string> errors(file_count);
+    runConcurrently(file_count, threads, [&](size_t k) {
+        decodePng(filenames[k].c_str(), layers + k * layerBytes(), errors[k]);
+    });
+    
+    for (size_t k = 0; k < file_count; k++) {
+        if (!errors[k].empty()) {
+            LOG_ERROR(Texture) << "PNG load error: " << errors[k];
+        }
+    }
+    return first;
+}
+
+int TextureArrayBuilder::addPack(const TexturePack& pack, int threads) {
+    PROFILE_SCOPE("TextureArrayBuilder::addPack");
+    int first = getLayerCount();
+    unsigned char* layers = appendLayers(pack.getCount());
+    if (!layers) return -1;
+    
+    // === DECODE EVERY ENTRY OUT OF THE MAPPING ===
+    // The blobs are independent, so they decode as concurrently as files
+    // do, without a read or allocation per image; raw entries of the layer
+    // size are a copy
+    const size_t entry_count = pack.getCount();
+    std::vector<std::string> errors(entry_count);
+    runConcurrently(entry_count, threads, [&](size_t k) {
+        const TexturePackEntry& entry = pack.getEntry(k);
+        unsigned char* layer = layers + k * layerBytes();
+        if (entry.encoding == static_cast<uint32_t>(TexturePackEncoding::RawRgba8)) {
+            resample(pack.getBlob(k), entry.width, entry.height, layer, width, height);
+        } else if (!decodePngData(pack.getBlob(k), entry.size, layer, errors[k])) {
+            errors[k] = std::string(entry.name) + ": " + errors[k];
+        }
+    });
+    
+    for (size_t k = 0; k < entry_count; k++) {
+        if (!errors[k].empty()) {
+            LOG_ERROR(Texture) << "PNG load error: " << errors[k];
+        }
+    }
+    return first;
+}
+
+bool TextureArrayBuilder::readPngSize(const char* filename, int& image_width, int& image_height) {
+    // The signature and the IHDR chunk
+    unsigned char header[33];
+    size_t read = 0;
+    const unsigned char* bundled = ResourceBundle::shared().find(filename, read);
+    if (bundled) {
+        if (read < sizeof(header)) return false;
+        memcpy(header, bundled, sizeof(header));
+        read = sizeof(header);
+    } else {
+        FILE* file = fopen(filename, "rb");
+        if (!file) return false;
+        read = fread(header, 1, sizeof(header), file);
+        fclose(file);
+        if (read != sizeof(header)) return false;
+    }
+    lodepng::State state;
+    unsigned png_width = 0, png_height = 0;
+    if (lodepng_inspect(&png_width, &png_height, &state, header, read) != 0) return false;
+    image_width = png_width;
+    image_height = png_height;
+    return true;
+}
+
+int TextureArrayBuilder::addImage(const unsigned char* rgba, int image_width, int image_height) {
+    int layer = getLayerCount();
+    unsigned char* pixels = appendLayers(1);
+    if (!pixels) return -1;
+    resample(rgba, image_width, image_height, pixels, width, height);
+    return layer;
+}
+
+GLuint TextureArrayBuilder::upload(float anisotropy) {
+    PROFILE_SCOPE("TextureArrayBuilder::upload");
+    // Immutable storage for the whole chain, filled level 0 first
+    const int levels = 1 + (int)std::floor(std::log2((float)std::max(width, height)));
+    GLuint texture = GlDsa::createTexture(GL_TEXTURE_2D_ARRAY);
+    GlDsa::textureStorage3D(texture, GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, width, height, std::max(layer_count, 1));
+    MemoryStats::trackTexture(texture, MemoryStats::textureBytes(GL_RGBA8, width, height, layer_count, 0), "materials");
+    if (upload_buffer != 0) {
+        // Source the texture from the buffer: the driver schedules the
+        // transfer and the buffer is freed once it's done
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_buffer);
+        if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE) {
+            LOG_WARNING(Texture) << "Texture upload buffer was lost, layers are undefined";
+        }
+        mapped = nullptr;
+        if (layer_count > 0) {
+            GlDsa::textureSubImage3D(texture, GL_TEXTURE_2D_ARRAY, 0, width, height, layer_count, GL_RGBA,
+                                     GL_UNSIGNED_BYTE, nullptr);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        releaseUploadBuffer();
+        layer_count = 0;
+    } else if (layer_count > 0) {
+        GlDsa::textureSubImage3D(texture, GL_TEXTURE_2D_ARRAY, 0, width, height, layer_count, GL_RGBA,
+                                 GL_UNSIGNED_BYTE, pixels.data());
+    }
+    GlDsa::generateMipmap(texture, GL_TEXTURE_2D_ARRAY);
+    setFiltering(texture, anisotropy);
+    return texture;
+}
+
+void TextureArrayBuilder::setFiltering(GLuint texture, float anisotropy) {
+    GlDsa::textureParameteri(texture, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    GlDsa::textureParameteri(texture, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (anisotropy > 1.0f && glewIsSupported("GL_EXT_texture_filter_anisotropic")) {
+        GLfloat max_anisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_anisotropy);
+        GlDsa::textureParameterf(texture, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+                                 std::min(anisotropy, max_anisotropy));
+    }
+}
+
+void TextureArrayBuilder::resample(const unsigned char* src, int src_width, int src_height,
+                                   unsigned char* dst, int dst_width, int dst_height) {
+    if (src_width == dst_width && src_height == dst_height) {
+        std::copy(src, src + (size_t)src_width * src_height * 4, dst);
+        return;
+    }
+    
+    // Separable: rows to the new width first, then columns to the new height
+    std::vector<std::vector<Tap> > taps_x = axisTaps(src_width, dst_width);
+    std::vector<std::vector<Tap> > taps_y = axisTaps(src_height, dst_height);
+    std::vector<float> rows((size_t)dst_width * src_height * 4, 0.0f);
+    for (int y = 0; y < src_height; y++) {
+        const unsigned char* src_row = src + (size_t)y * src_width * 4;
+        float* row = &rows[(size_t)y * dst_width * 4];
+        for (int x = 0; x < dst_width; x++) {
+            for (const Tap& tap : taps_x[x]) {
+                for (int c = 0; c < 4; c++) {
+                    row[x * 4 + c] += src_row[tap.index * 4 + c] * tap.weight;
+                }
+            }
+        }
+    }
+    
+    for (int y = 0; y < dst_height; y++) {
+        unsigned char* dst_row = dst + (size_t)y * dst_width * 4;
+        for (int x = 0; x < dst_width * 4; x++) {
+            float value = 0.0f;
+            for (const Tap& tap : taps_y[y]) {
+                value += rows[(size_t)tap.index * dst_width * 4 + x] * tap.weight;
+            }
+            dst_row[x] = (unsigned char)std::min(std::max(value + 0.5f, 0.0f), 255.0f);
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class TexturePack;
+
+// Builds one GL_TEXTURE_2D_ARRAY out of separate images so every material
+// samples the same texture object and a draw picks its image by layer.
+// Layers of an array share one size: each image is resampled to it on add,
+// box-filtered where it shrinks and bilinear where it grows. Texture
+// coordinates are normalized, so a stretched aspect ratio maps back onto
+// the mesh unchanged.
+//
+// With a cache directory set, every decoded and resampled layer is also
+// written there as a raw header + RGBA8 payload, found again by the
+// source's path, size and modification time and the layer size, so later
+// starts read the pixels back in one go instead of inflating the PNG.
+//
+// mapUploadBuffer() puts the layers in a mapped pixel unpack buffer
+// instead of client memory: decodes, resamples and cache reads write
+// straight into driver memory, and upload() sources the texture from the
+// buffer, so the driver neither copies the pixels again nor blocks the
+// call on them
+class TextureArrayBuilder {
+private:
+    int width;
+    int height;
+    int layer_count;
+    std::vector<unsigned char> pixels; // RGBA8, layer after layer, when not mapped
+    GLuint upload_buffer;    // GL_PIXEL_UNPACK_BUFFER holding the layers, 0 = none
+    unsigned char* mapped;   // Its write-only mapping
+    int mapped_capacity;     // Layers it has room for
+    static std::string cache_directory;
+    
+    // Room for count more layers, zeroed; nullptr when the mapped buffer
+    // is full
+    unsigned char* appendLayers(int count);
+    size_t layerBytes() const { return (size_t)width * height * 4; }
+    void releaseUploadBuffer();
+    
+    // Decode filename into one layer's pixels, straight into the layer
+    // when the image already has its size; false (and the layer cleared)
+    // if it can't be read
+    bool decodePng(const char* filename, unsigned char* layer, std::string& error) const;
+    // decodePng for a PNG already in memory, without the cache
+    bool decodePngData(const unsigned char* png, size_t size, unsigned char* layer, std::string& error) const;
+    // The cache file of a source and its key, "" when the cache is off or
+    // the source is missing
+    std::string cachePath(const char* filename, std::string& key) const;
+    bool loadCached(const std::string& path, const std::string& key, unsigned char* layer) const;
+    void saveCached(const std::string& path, const std::string& key, const unsigned char* layer) const;
+    
+    TextureArrayBuilder(const TextureArrayBuilder&);
+    TextureArrayBuilder& operator=(const TextureArrayBuilder&);
+
+public:
+    TextureArrayBuilder(int width, int height);
+    ~TextureArrayBuilder();
+    
+    // Stage the next layers in a mapped pixel unpack buffer with room for
+    // layers of them; later adds past that return -1. Only before the
+    // first add, and false (client memory is used) if the buffer can't be
+    // mapped. getLayer() can't read a mapped builder's pixels
+    bool mapUploadBuffer(int layers);
+    
+    // Keep decoded layers in directory ("" = off, the default)
+    static void setCacheDirectory(const std::string& directory) { cache_directory = directory; }
+    
+    // Decode a PNG and append it; returns its layer. A file that can't be
+    // read still takes a layer, left transparent black, so the layers of
+    // the other images don't shift
+    int addPng(const char* filename);
+    // addPng for several files at once, decoded and resampled concurrently
+    // on threads workers (0 = one per core, the caller among them). Returns
+    // the first layer; the files take consecutive layers in their order
+    int addPngs(const std::vector<std::string>& filenames, int threads = 0);
+    // addPngs for every entry of an open pack, in index order, decoded
+    // concurrently on threads workers straight from its mapping
+    int addPack(const TexturePack& pack, int threads = 0);
+    // Append width x height RGBA8 pixels, resampled to the layer size
+    int addImage(const unsigned char* rgba, int image_width, int image_height);
+    int getLayerCount() const { return layer_count; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const unsigned char* getLayer(int layer) const { return &pixels[layer * layerBytes()]; }
+    
+    // Create the array texture with a full mip chain and upload the
+    // layers, filtered trilinearly and, where EXT_texture_filter_anisotropic
+    // is supported, with up to anisotropy samples along the axis of
+    // greatest stretch (clamped to the driver's maximum, 1 = off). Storage
+    // is immutable, and set through GlDsa, so with direct state access
+    // nothing is left bound. A mapped builder hands its buffer to the
+    // texture and is empty afterwards
+    GLuint upload(float anisotropy = 1.0f);
+    // The sampling parameters upload() sets, for an array texture created
+    // by GlDsa
+    static void setFiltering(GLuint texture, float anisotropy);
+    
+    // The size in a PNG's header, without decoding it; false if it can't
+    // be read
+    static bool readPngSize(const char* filename, int& image_width, int& image_height);
+    
+    // Resample RGBA8 source pixels to dst_width x dst_height into dst
+    static void resample(const unsigned char* src, int src_width, int src_height,
+                         unsigned char* dst, int dst_width, int dst_height);
+};
+
+#endif // TEXTURE_ARRAY_H
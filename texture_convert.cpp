@@ -0,0 +1,180 @@
+// Offline texture converter: packs PNG images into one mipmapped,
+// block-compressed KTX2 texture array that tree_demo loads instead of
+// decoding the PNGs (texture_ktx2.h). Layers keep the order of the inputs.
+//
+//   texture_convert [--size N] [--bc1 | --bc3] output.ktx2 input.png...
+//
+// Every input is resampled to N x N (default 1024, as tree_demo does with
+// the PNGs). Without --bc1/--bc3 the format is BC3 when any texel is not
+// fully opaque, BC1 otherwise
+//
+//   texture_convert --pack [--raw] [--size N] output.pack input.png...
+//
+// writes a texture pack instead (texture_pack.h), for GPUs without S3TC:
+// the PNG files as they are, or with --raw decoded and resampled to N x N,
+// so loading them is a copy
+//
+//   texture_convert --leaf-clusters [--size N] output.png leaf.png
+//
+// bakes the leaf cluster texture of leaf cards (leaf_cards.h) from a leaf
+// image, an N x N PNG that then goes into the array like any input
+//
+//   texture_convert --bundle output.res file...
+//
+// packs any files (the shaders, the converted textures, the PNGs) into the
+// resource bundle tree_demo maps at startup (resource_bundle.h), under
+// their names without the directory
+#include "leaf_cards.h"
+#include "lodepng.h"
+#include "resource_bundle.h"
+#include "texture_array.h"
+#include "texture_ktx2.h"
+#include "texture_pack.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int writePack(const std::vector<std::string>& files, bool raw, int size) {
+    std::vector<TexturePackImage> images(files.size() - 1);
+    TextureArrayBuilder layers(size, size);
+    if (raw) layers.addPngs(std::vector<std::string>(files.begin() + 1, files.end()));
+    for (size_t i = 0; i < images.size(); i++) {
+        TexturePackImage& image = images[i];
+        const std::string& file = files[i + 1];
+        image.name = file.substr(file.find_last_of('/') + 1);
+        if (raw) {
+            image.width = size;
+            image.height = size;
+            image.encoding = TexturePackEncoding::RawRgba8;
+            const unsigned char* layer = layers.getLayer(i);
+            image.data.assign(layer, layer + (size_t)size * size * 4);
+            continue;
+        }
+        // Verbatim; the index only needs the size from the header
+        lodepng::State state;
+        unsigned width = 0, height = 0;
+        unsigned code = lodepng::load_file(image.data, file);
+        if (!code) code = lodepng_inspect(&width, &height, &state, image.data.data(), image.data.size());
+        if (code) {
+            std::cout << "Cannot read " << file << ": " << lodepng_error_text(code) << std::endl;
+            return 1;
+        }
+        image.width = width;
+        image.height = height;
+        image.encoding = TexturePackEncoding::Png;
+    }
+    
+    std::string error;
+    if (!writeTexturePack(images, files[0], error)) {
+        std::cout << "Cannot write texture pack: " << error << std::endl;
+        return 1;
+    }
+    size_t bytes = 0;
+    for (const TexturePackImage& image : images) {
+        bytes += image.data.size();
+    }
+    std::cout << files[0] << ": " << images.size() << " images, " << (raw ? "raw RGBA8" : "PNG") << ", "
+              << bytes / 1024 << " KB" << std::endl;
+    return 0;
+}
+
+static int writeBundle(const std::vector<std::string>& files) {
+    std::string error;
+    if (!writeResourceBundle(std::vector<std::string>(files.begin() + 1, files.end()), files[0], error)) {
+        std::cout << "Cannot write resource bundle: " << error << std::endl;
+        return 1;
+    }
+    ResourceBundle bundle;
+    if (!bundle.open(files[0], error)) {
+        std::cout << "Cannot read back resource bundle: " << error << std::endl;
+        return 1;
+    }
+    size_t bytes = 0;
+    for (int i = 0; i < bundle.getCount(); i++) {
+        bytes += bundle.getEntry(i).size;
+    }
+    std::cout << files[0] << ": " << bundle.getCount() << " files, " << bytes / 1024 << " KB" << std::endl;
+    return 0;
+}
+
+static int writeLeafClusters(const std::vector<std::string>& files, int size) {
+    std::vector<unsigned char> leaf;
+    unsigned width = 0, height = 0;
+    unsigned code = lodepng::decode(leaf, width, height, files[1]);
+    if (code) {
+        std::cout << "Cannot read " << files[1] << ": " << lodepng_error_text(code) << std::endl;
+        return 1;
+    }
+    std::vector<unsigned char> clusters;
+    bakeLeafClusterTexture(leaf.data(), width, height, size, clusters);
+    code = lodepng::encode(files[0], clusters, size, size);
+    if (code) {
+        std::cout << "Cannot write " << files[0] << ": " << lodepng_error_text(code) << std::endl;
+        return 1;
+    }
+    std::cout << files[0] << ": " << LeafCards::VARIANTS << " leaf clusters, " << size << " x " << size << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int size = 1024;
+    uint32_t format = 0;
+    bool pack = false;
+    bool raw = false;
+    bool leaf_clusters = false;
+    bool bundle = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) size = atoi(argv[++i]);
+        else if (arg == "--bc1") format = KTX2_FORMAT_BC1_RGB;
+        else if (arg == "--bc3") format = KTX2_FORMAT_BC3;
+        else if (arg == "--pack") pack = true;
+        else if (arg == "--raw") raw = true;
+        else if (arg == "--leaf-clusters") leaf_clusters = true;
+        else if (arg == "--bundle") bundle = true;
+        else files.push_back(arg);
+    }
+    if (files.size() < 2 || size <= 0) {
+        std::cout << "Usage: " << argv[0] << " [--size N] [--bc1 | --bc3] output.ktx2 input.png..." << std::endl
+                  << "       " << argv[0] << " --pack [--raw] [--size N] output.pack input.png..." << std::endl
+                  << "       " << argv[0] << " --leaf-clusters [--size N] output.png leaf.png" << std::endl
+                  << "       " << argv[0] << " --bundle output.res file..." << std::endl;
+        return 1;
+    }
+    if (bundle) return writeBundle(files);
+    if (pack) return writePack(files, raw, size);
+    if (leaf_clusters) return writeLeafClusters(files, size);
+    
+    TextureArrayBuilder layers(size, size);
+    layers.addPngs(std::vector<std::string>(files.begin() + 1, files.end()));
+    
+    if (format == 0) {
+        format = KTX2_FORMAT_BC1_RGB;
+        size_t texels = (size_t)size * size * layers.getLayerCount();
+        const unsigned char* pixels = layers.getLayer(0);
+        for (size_t t = 0; t < texels; t++) {
+            if (pixels[t * 4 + 3] != 255) {
+                format = KTX2_FORMAT_BC3;
+                break;
+            }
+        }
+    }
+    
+    CompressedTextureArray texture;
+    compressTextureArray(layers, format, texture);
+    std::string error;
+    if (!saveKtx2(texture, files[0], error)) {
+        std::cout << "Cannot write texture: " << error << std::endl;
+        return 1;
+    }
+    size_t bytes = 0;
+    for (const std::vector<unsigned char>& level : texture.levels) {
+        bytes += level.size();
+    }
+    std::cout << files[0] << ": " << texture.layers << " layers, " << texture.levels.size() << " levels, "
+              << (format == KTX2_FORMAT_BC3 ? "BC3" : "BC1") << ", " << bytes / 1024 << " KB" << std::endl;
+    return 0;
+}
@@ -0,0 +1,384 @@
+#include "texture_ktx2.h"
+#include "gl_dsa.h"
+#include "memory_stats.h"
+#include "texture_array.h"
+#include "profiler.h"
+#include "resource_bundle.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+static const unsigned char KTX2_IDENTIFIER[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+static const size_t KTX2_HEADER_SIZE = 80; // Identifier, header and index
+static const size_t KTX2_LEVEL_ENTRY_SIZE = 24;
+
+// Data format descriptor values (Khronos Data Format Specification 1.3)
+static const uint32_t KHR_DF_MODEL_BC1A = 128;
+static const uint32_t KHR_DF_MODEL_BC3 = 130;
+static const uint32_t KHR_DF_CHANNEL_COLOR = 0;
+static const uint32_t KHR_DF_CHANNEL_BC3_ALPHA = 15;
+static const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+static const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+
+size_t compressedBlockBytes(uint32_t format) {
+    if (format == KTX2_FORMAT_BC1_RGB) return 8;
+    if (format == KTX2_FORMAT_BC3) return 16;
+    return 0;
+}
+
+GLenum compressedGlFormat(uint32_t format) {
+    if (format == KTX2_FORMAT_BC1_RGB) return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    if (format == KTX2_FORMAT_BC3) return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    return 0;
+}
+
+static size_t levelBytes(uint32_t format, int width, int height, int layers) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * compressedBlockBytes(format) * layers;
+}
+
+// === BLOCK ENCODERS ===
+
+static uint16_t pack565(const float color[3]) {
+    int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpack565(uint16_t packed, int color[3]) {
+    int r = packed >> 11;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+void compressBC1Block(const unsigned char* rgba, unsigned char* out) {
+    // === ENDPOINTS ALONG THE PRINCIPAL AXIS ===
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int t = 0; t < 16; t++) {
+        for (int c = 0; c < 3; c++) mean[c] += rgba[t * 4 + c] / 16.0f;
+    }
+    float covariance[3][3] = {};
+    for (int t = 0; t < 16; t++) {
+        float d[3] = {rgba[t * 4] - mean[0], rgba[t * 4 + 1] - mean[1], rgba[t * 4 + 2] - mean[2]};
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) covariance[i][j] += d[i] * d[j];
+        }
+    }
+    // A few power iterations from the gray axis are enough for 16 texels
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3];
+        for (int i = 0; i < 3; i++) {
+            next[i] = covariance[i][0] * axis[0] + covariance[i][1] * axis[1] + covariance[i][2] * axis[2];
+        }
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f) break; // Flat block: any axis does
+        for (int i = 0; i < 3; i++) axis[i] = next[i] / length;
+    }
+    float low = 0.0f, high = 0.0f;
+    for (int t = 0; t < 16; t++) {
+        float d = (rgba[t * 4] - mean[0]) * axis[0] + (rgba[t * 4 + 1] - mean[1]) * axis[1] +
+                  (rgba[t * 4 + 2] - mean[2]) * axis[2];
+        low = std::min(low, d);
+        high = std::max(high, d);
+    }
+    float end0[3], end1[3];
+    for (int c = 0; c < 3; c++) {
+        end0[c] = mean[c] + axis[c] * high;
+        end1[c] = mean[c] + axis[c] * low;
+    }
+    // color0 > color1 selects the four-color mode
+    uint16_t color0 = pack565(end0);
+    uint16_t color1 = pack565(end1);
+    if (color0 < color1) std::swap(color0, color1);
+    
+    // === NEAREST OF THE FOUR COLORS PER TEXEL ===
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        unpack565(color0, palette[0]);
+        unpack565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int t = 0; t < 16; t++) {
+            int best = 0;
+            int bestError = 1 << 30;
+            for (int p = 0; p < 4; p++) {
+                int error = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = rgba[t * 4 + c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * t);
+        }
+    }
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++) out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+void compressBC3Block(const unsigned char* rgba, unsigned char* out) {
+    int alpha0 = 0, alpha1 = 255;
+    for (int t = 0; t < 16; t++) {
+        alpha0 = std::max(alpha0, (int)rgba[t * 4 + 3]);
+        alpha1 = std::min(alpha1, (int)rgba[t * 4 + 3]);
+    }
+    // alpha0 > alpha1 selects the eight-step mode: both ends, then six
+    // values in between from alpha0 towards alpha1
+    uint64_t indices = 0;
+    if (alpha0 != alpha1) {
+        int palette[8] = {alpha0, alpha1};
+        for (int p = 2; p < 8; p++) palette[p] = ((8 - p) * alpha0 + (p - 1) * alpha1) / 7;
+        for (int t = 0; t < 16; t++) {
+            int best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::abs(rgba[t * 4 + 3] - palette[p]) < std::abs(rgba[t * 4 + 3] - palette[best])) best = p;
+            }
+            indices |= (uint64_t)best << (3 * t);
+        }
+    }
+    out[0] = alpha0;
+    out[1] = alpha1;
+    for (int i = 0; i < 6; i++) out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    compressBC1Block(rgba, out + 8);
+}
+
+void compressImage(const unsigned char* rgba, int width, int height, uint32_t format,
+                   std::vector<unsigned char>& out) {
+    size_t blockBytes = compressedBlockBytes(format);
+    unsigned char block[64];
+    unsigned char packed[16];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            for (int y = 0; y < 4; y++) {
+                int sy = std::min(by + y, height - 1);
+                for (int x = 0; x < 4; x++) {
+                    int sx = std::min(bx + x, width - 1);
+                    memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+                }
+            }
+            if (format == KTX2_FORMAT_BC3) compressBC3Block(block, packed);
+            else compressBC1Block(block, packed);
+            out.insert(out.end(), packed, packed + blockBytes);
+        }
+    }
+}
+
+void compressTextureArray(const TextureArrayBuilder& layers, uint32_t format,
+                          CompressedTextureArray& out) {
+    out.format = format;
+    out.width = layers.getWidth();
+    out.height = layers.getHeight();
+    out.layers = layers.getLayerCount();
+    out.levels.clear();
+    for (int layer = 0; layer < out.layers; layer++) {
+        int width = out.width;
+        int height = out.height;
+        const unsigned char* first = layers.getLayer(layer);
+        std::vector<unsigned char> image(first, first + (size_t)width * height * 4);
+        for (int level = 0; ; level++) {
+            if ((int)out.levels.size() <= level) out.levels.push_back(std::vector<unsigned char>());
+            compressImage(image.data(), width, height, format, out.levels[level]);
+            if (width == 1 && height == 1) break;
+            int nextWidth = std::max(width / 2, 1);
+            int nextHeight = std::max(height / 2, 1);
+            std::vector<unsigned char> next((size_t)nextWidth * nextHeight * 4);
+            TextureArrayBuilder::resample(image.data(), width, height, next.data(), nextWidth, nextHeight);
+            image.swap(next);
+            width = nextWidth;
+            height = nextHeight;
+        }
+    }
+}
+
+// === KTX2 FILES ===
+
+static void putU32(std::vector<unsigned char>& bytes, size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; i++) bytes[offset + i] = (value >> (8 * i)) & 0xFF;
+}
+
+static void putU64(std::vector<unsigned char>& bytes, size_t offset, uint64_t value) {
+    for (int i = 0; i < 8; i++) bytes[offset + i] = (value >> (8 * i)) & 0xFF;
+}
+
+static uint32_t getU32(const std::vector<unsigned char>& bytes, size_t offset) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= (uint32_t)bytes[offset + i] << (8 * i);
+    return value;
+}
+
+static uint64_t getU64(const std::vector<unsigned char>& bytes, size_t offset) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value |= (uint64_t)bytes[offset + i] << (8 * i);
+    return value;
+}
+
+bool saveKtx2(const CompressedTextureArray& texture, const std::string& path, std::string& error) {
+    size_t blockBytes = compressedBlockBytes(texture.format);
+    if (blockBytes == 0 || texture.levels.empty()) {
+        error = "nothing to write to " + path;
+        return false;
+    }
+    int levelCount = texture.levels.size();
+    bool alpha = texture.format == KTX2_FORMAT_BC3;
+    
+    // === HEADER, LEVEL INDEX AND DATA FORMAT DESCRIPTOR ===
+    size_t sampleCount = alpha ? 2 : 1;
+    size_t descriptorBlockSize = 24 + 16 * sampleCount;
+    size_t dfdOffset = KTX2_HEADER_SIZE + KTX2_LEVEL_ENTRY_SIZE * levelCount;
+    size_t dfdLength = 4 + descriptorBlockSize;
+    std::vector<unsigned char> bytes(dfdOffset + dfdLength, 0);
+    memcpy(&bytes[0], KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    putU32(bytes, 12, texture.format);
+    putU32(bytes, 16, 1); // typeSize
+    putU32(bytes, 20, texture.width);
+    putU32(bytes, 24, texture.height);
+    putU32(bytes, 28, 0); // pixelDepth
+    putU32(bytes, 32, texture.layers);
+    putU32(bytes, 36, 1); // faceCount
+    putU32(bytes, 40, levelCount);
+    putU32(bytes, 44, 0); // No supercompression
+    putU32(bytes, 48, dfdOffset);
+    putU32(bytes, 52, dfdLength);
+    
+    size_t dfd = dfdOffset;
+    putU32(bytes, dfd, dfdLength);
+    putU32(bytes, dfd + 4, 0); // Khronos vendor, basic descriptor type
+    putU32(bytes, dfd + 8, 2 | (descriptorBlockSize << 16));
+    putU32(bytes, dfd + 12, (alpha ? KHR_DF_MODEL_BC3 : KHR_DF_MODEL_BC1A) |
+                            (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_LINEAR << 16));
+    putU32(bytes, dfd + 16, 3 | (3 << 8)); // 4x4x1x1 texel blocks
+    putU32(bytes, dfd + 20, blockBytes);   // bytesPlane0
+    size_t sample = dfd + 28;
+    if (alpha) {
+        putU32(bytes, sample, 0 | (63 << 16) | (KHR_DF_CHANNEL_BC3_ALPHA << 24));
+        putU32(bytes, sample + 12, 0xFFFFFFFFu);
+        sample += 16;
+    }
+    putU32(bytes, sample, (alpha ? 64 : 0) | (63 << 16) | (KHR_DF_CHANNEL_COLOR << 24));
+    putU32(bytes, sample + 12, 0xFFFFFFFFu);
+    
+    // === LEVELS, SMALLEST FIRST, EACH ALIGNED TO A BLOCK ===
+    for (int level = levelCount - 1; level >= 0; level--) {
+        bytes.resize((bytes.size() + blockBytes - 1) / blockBytes * blockBytes, 0);
+        size_t entry = KTX2_HEADER_SIZE + KTX2_LEVEL_ENTRY_SIZE * level;
+        putU64(bytes, entry, bytes.size());
+        putU64(bytes, entry + 8, texture.levels[level].size());
+        putU64(bytes, entry + 16, texture.levels[level].size());
+        bytes.insert(bytes.end(), texture.levels[level].begin(), texture.levels[level].end());
+    }
+    
+    // Write next to the target, then rename over it, as tree_asset does
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot create " + temporary;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    out.close();
+    if (!out) {
+        error = "write to " + temporary + " failed";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "cannot replace " + path;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadKtx2(CompressedTextureArray& texture, const std::string& path, std::string& error) {
+    PROFILE_SCOPE("loadKtx2");
+    std::vector<unsigned char> bytes;
+    if (!readResource(path, bytes)) {
+        error = "cannot read " + path;
+        return false;
+    }
+    
+    // === HEADER ===
+    if (bytes.size() < KTX2_HEADER_SIZE || memcmp(&bytes[0], KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        error = path + " is not a KTX2 file";
+        return false;
+    }
+    texture.format = getU32(bytes, 12);
+    texture.width = getU32(bytes, 20);
+    texture.height = getU32(bytes, 24);
+    texture.layers = std::max(getU32(bytes, 32), 1u); // 0 = not an array
+    uint32_t depth = getU32(bytes, 28);
+    uint32_t faces = getU32(bytes, 36);
+    uint32_t levelCount = getU32(bytes, 40);
+    uint32_t supercompression = getU32(bytes, 44);
+    if (compressedGlFormat(texture.format) == 0 || depth != 0 || faces != 1 || supercompression != 0 ||
+        texture.width <= 0 || texture.height <= 0) {
+        error = path + ": only uncompressed BC1/BC3 2D arrays are supported";
+        return false;
+    }
+    if (levelCount == 0 || bytes.size() < KTX2_HEADER_SIZE + KTX2_LEVEL_ENTRY_SIZE * levelCount) {
+        error = path + ": bad level index";
+        return false;
+    }
+    
+    // === LEVELS ===
+    texture.levels.assign(levelCount, std::vector<unsigned char>());
+    int width = texture.width;
+    int height = texture.height;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        size_t entry = KTX2_HEADER_SIZE + KTX2_LEVEL_ENTRY_SIZE * level;
+        uint64_t offset = getU64(bytes, entry);
+        uint64_t length = getU64(bytes, entry + 8);
+        if (length != levelBytes(texture.format, width, height, texture.layers) ||
+            offset > bytes.size() || length > bytes.size() - offset) {
+            error = path + ": level " + std::to_string(level) + " is truncated";
+            return false;
+        }
+        texture.levels[level].assign(bytes.begin() + offset, bytes.begin() + offset + length);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return true;
+}
+
+// === UPLOAD ===
+
+GLuint uploadCompressed(const CompressedTextureArray& texture, float anisotropy) {
+    PROFILE_SCOPE("uploadCompressed");
+    GLenum format = compressedGlFormat(texture.format);
+    GLuint name = GlDsa::createTexture(GL_TEXTURE_2D_ARRAY);
+    // Storage for the file's levels alone: a chain that stops short of 1x1
+    // is still complete
+    GlDsa::textureStorage3D(name, GL_TEXTURE_2D_ARRAY, texture.levels.size(), format, texture.width, texture.height,
+                            texture.layers);
+    int width = texture.width;
+    int height = texture.height;
+    size_t bytes = 0;
+    for (size_t level = 0; level < texture.levels.size(); level++) {
+        bytes += texture.levels[level].size();
+        GlDsa::compressedTextureSubImage3D(name, GL_TEXTURE_2D_ARRAY, level, width, height, texture.layers, format,
+                                           texture.levels[level].size(), texture.levels[level].data());
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    MemoryStats::trackTexture(name, bytes, "materials");
+    TextureArrayBuilder::setFiltering(name, anisotropy);
+    return name;
+}
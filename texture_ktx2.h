@@ -0,0 +1,64 @@
+#ifndef TEXTURE_KTX2_H
+#define TEXTURE_KTX2_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class TextureArrayBuilder;
+
+// Block-compressed texture arrays stored as KTX2 files. texture_convert
+// compresses the material textures offline, with their mip chain, so the
+// demo uploads them as they are: no PNG inflate at startup, and the GPU
+// keeps 4x4 texel blocks of 8 bytes (BC1, opaque) or 16 bytes (BC3, with
+// alpha) instead of 64 bytes of RGBA8.
+//
+// Files are standard KTX2 with one basic data format descriptor, no
+// key/value data and no supercompression. Only what texture_convert writes
+// is read back: BC1 RGB or BC3, one face, any number of layers and levels
+
+// vkFormat values of the two block formats
+static const uint32_t KTX2_FORMAT_BC1_RGB = 131; // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+static const uint32_t KTX2_FORMAT_BC3 = 137;     // VK_FORMAT_BC3_UNORM_BLOCK
+
+// A texture array as it goes to glCompressedTexImage3D, level 0 first.
+// Each level holds every layer's blocks back to back
+struct CompressedTextureArray {
+    uint32_t format;
+    int width;
+    int height;
+    int layers;
+    std::vector<std::vector<unsigned char> > levels;
+};
+
+// Bytes per 4x4 block of a format, 0 if it isn't one of the two above
+size_t compressedBlockBytes(uint32_t format);
+// The GL internal format of a KTX2 format, 0 if unsupported
+GLenum compressedGlFormat(uint32_t format);
+
+// Compress one 4x4 RGBA8 block (64 bytes, row by row) to 8 bytes: the two
+// endpoints at the extremes of the colors' principal axis, and for each
+// texel the nearest of the four colors they span
+void compressBC1Block(const unsigned char* rgba, unsigned char* out);
+// The same to 16 bytes, preceded by an alpha block ranging over the
+// block's smallest to largest alpha in eight steps
+void compressBC3Block(const unsigned char* rgba, unsigned char* out);
+// Compress a width x height image, edge texels repeated into partial blocks
+void compressImage(const unsigned char* rgba, int width, int height, uint32_t format,
+                   std::vector<unsigned char>& out);
+
+// Compress every layer of an array and its box-filtered mip chain down to 1x1
+void compressTextureArray(const TextureArrayBuilder& layers, uint32_t format,
+                          CompressedTextureArray& out);
+
+bool saveKtx2(const CompressedTextureArray& texture, const std::string& path, std::string& error);
+// path from the resource bundle when it holds it (resource_bundle.h)
+bool loadKtx2(CompressedTextureArray& texture, const std::string& path, std::string& error);
+
+// Create the GL_TEXTURE_2D_ARRAY with every stored level, filtered like
+// TextureArrayBuilder::upload, its storage immutable and set through GlDsa
+GLuint uploadCompressed(const CompressedTextureArray& texture, float anisotropy = 1.0f);
+
+#endif // TEXTURE_KTX2_H
@@ -0,0 +1,204 @@
+#include "texture_pack.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char TEXTURE_PACK_MAGIC[8] = {'T', 'E', 'X', 'P', 'A', 'C', 'K', '1'};
+static const uint32_t TEXTURE_PACK_BYTE_ORDER = 0x01020304u;
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + TEXTURE_PACK_ALIGNMENT - 1) / TEXTURE_PACK_ALIGNMENT * TEXTURE_PACK_ALIGNMENT;
+}
+
+// === WRITER ===
+
+bool writeTexturePack(const std::vector<TexturePackImage>& images, const std::string& path, std::string& error) {
+    // === LAYOUT: HEADER AND INDEX, THEN EVERY BLOB ON AN ALIGNED OFFSET ===
+    TexturePackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TEXTURE_PACK_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_PACK_VERSION;
+    header.byte_order = TEXTURE_PACK_BYTE_ORDER;
+    header.header_size = sizeof(TexturePackHeader);
+    header.entry_size = sizeof(TexturePackEntry);
+    header.entry_count = images.size();
+    std::vector<TexturePackEntry> entries(images.size());
+    uint64_t offset = alignOffset(sizeof(TexturePackHeader) + entries.size() * sizeof(TexturePackEntry));
+    for (size_t i = 0; i < images.size(); i++) {
+        TexturePackEntry& entry = entries[i];
+        memset(&entry, 0, sizeof(entry));
+        if (images[i].name.size() >= sizeof(entry.name)) {
+            error = "name too long for a texture pack: " + images[i].name;
+            return false;
+        }
+        memcpy(entry.name, images[i].name.c_str(), images[i].name.size());
+        entry.width = images[i].width;
+        entry.height = images[i].height;
+        entry.encoding = static_cast<uint32_t>(images[i].encoding);
+        entry.offset = offset;
+        entry.size = images[i].data.size();
+        offset = alignOffset(offset + entry.size);
+    }
+    header.file_size = offset;
+    
+    // === WRITE NEXT TO THE TARGET, THEN RENAME OVER IT ===
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot create " + temporary;
+        return false;
+    }
+    static const char padding[TEXTURE_PACK_ALIGNMENT] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(TexturePackEntry));
+    uint64_t written = sizeof(header) + entries.size() * sizeof(TexturePackEntry);
+    for (size_t i = 0; i < images.size(); i++) {
+        out.write(padding, entries[i].offset - written);
+        out.write(reinterpret_cast<const char*>(images[i].data.data()), entries[i].size);
+        written = entries[i].offset + entries[i].size;
+    }
+    out.write(padding, header.file_size - written);
+    out.close();
+    if (!out) {
+        error = "write to " + temporary + " failed";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "cannot replace " + path;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// === MAPPED FILE ===
+
+TexturePack::TexturePack() : data(nullptr), size(0), mapped(false) {}
+
+TexturePack::~TexturePack() {
+    close();
+}
+
+void TexturePack::close() {
+#if !defined(_WIN32)
+    if (mapped) {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+#endif
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+    mapped = false;
+}
+
+int TexturePack::getCount() const {
+    return reinterpret_cast<const TexturePackHeader*>(data)->entry_count;
+}
+
+const TexturePackEntry& TexturePack::getEntry(int index) const {
+    return reinterpret_cast<const TexturePackEntry*>(data + sizeof(TexturePackHeader))[index];
+}
+
+bool TexturePack::open(const std::string& path, std::string& error) {
+    close();
+    
+    // === MAP THE WHOLE FILE READ-ONLY ===
+#if defined(_WIN32)
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    size = in.tellg();
+    buffer.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(buffer.data()), size);
+    if (!in) {
+        error = "cannot read " + path;
+        close();
+        return false;
+    }
+    data = reinterpret_cast<const unsigned char*>(buffer.data());
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(TexturePackHeader))) {
+        ::close(fd);
+        error = path + " is not a texture pack";
+        return false;
+    }
+    size = info.st_size;
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        size = 0;
+        error = "cannot map " + path;
+        return false;
+    }
+    data = static_cast<const unsigned char*>(view);
+    mapped = true;
+#endif
+    return check(path, error);
+}
+
+bool TexturePack::open(const void* bytes, size_t byte_count, const std::string& name, std::string& error) {
+    close();
+    size = byte_count;
+    data = static_cast<const unsigned char*>(bytes);
+    if (reinterpret_cast<uintptr_t>(bytes) % sizeof(uint64_t) != 0) {
+        buffer.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        memcpy(buffer.data(), bytes, size);
+        data = reinterpret_cast<const unsigned char*>(buffer.data());
+    }
+    return check(name, error);
+}
+
+bool TexturePack::check(const std::string& path, std::string& error) {
+    // === HEADER AND INDEX ===
+    // The decoders read straight through the offsets, so they are checked
+    // against the file before use
+    const char* reason = nullptr;
+    const TexturePackHeader* header = reinterpret_cast<const TexturePackHeader*>(data);
+    if (size < sizeof(TexturePackHeader) || memcmp(header->magic, TEXTURE_PACK_MAGIC, sizeof(header->magic)) != 0) {
+        reason = "is not a texture pack";
+    } else if (header->version != TEXTURE_PACK_VERSION) {
+        reason = "has an unsupported version";
+    } else if (header->byte_order != TEXTURE_PACK_BYTE_ORDER || header->header_size != sizeof(TexturePackHeader) ||
+               header->entry_size != sizeof(TexturePackEntry)) {
+        reason = "was written for another byte order or struct layout";
+    } else if (header->file_size != size) {
+        reason = "is truncated";
+    } else if (header->entry_count > (size - sizeof(TexturePackHeader)) / sizeof(TexturePackEntry)) {
+        reason = "has an index outside the file";
+    } else {
+        for (int i = 0; i < getCount() && !reason; i++) {
+            const TexturePackEntry& entry = getEntry(i);
+            if (entry.offset % TEXTURE_PACK_ALIGNMENT != 0 || entry.offset > size || entry.size > size - entry.offset) {
+                reason = "has an image outside the file";
+            } else if (entry.name[sizeof(entry.name) - 1] != '\0') {
+                reason = "has an unterminated name";
+            } else if (entry.encoding == static_cast<uint32_t>(TexturePackEncoding::RawRgba8)) {
+                if (entry.size != (uint64_t)entry.width * entry.height * 4) reason = "has a raw image of the wrong size";
+            } else if (entry.encoding != static_cast<uint32_t>(TexturePackEncoding::Png)) {
+                reason = "has an image of unknown encoding";
+            }
+        }
+    }
+    if (reason) {
+        error = path + " " + reason;
+        close();
+        return false;
+    }
+    return true;
+}
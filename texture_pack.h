@@ -0,0 +1,93 @@
+#ifndef TEXTURE_PACK_H
+#define TEXTURE_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Texture pack: the material images in one file, an index followed by the
+// image blobs, each 64-byte aligned. A blob is either a PNG file verbatim
+// or raw RGBA8 rows ready to upload. The index gives every entry's name and
+// size, so the texture array and its upload buffer can be allocated before
+// anything is decoded, and the blobs are independent, so they decode
+// concurrently straight out of one read-only mapping
+// (TextureArrayBuilder::addPack). texture_convert --pack writes them.
+// Files are native-endian; the header records the byte order
+
+static const uint32_t TEXTURE_PACK_VERSION = 1;
+static const size_t TEXTURE_PACK_ALIGNMENT = 64;
+
+enum class TexturePackEncoding : uint32_t {
+    Png = 1,      // A PNG file
+    RawRgba8 = 2  // width * height * 4 bytes, top row first
+};
+
+struct TexturePackEntry {
+    char name[64];     // The source file name, zero terminated
+    uint32_t width;
+    uint32_t height;
+    uint32_t encoding; // TexturePackEncoding
+    uint32_t reserved;
+    uint64_t offset;   // From the start of the file
+    uint64_t size;     // Bytes of the blob
+};
+
+struct TexturePackHeader {
+    char magic[8];        // "TEXPACK1"
+    uint32_t version;     // TEXTURE_PACK_VERSION
+    uint32_t byte_order;  // 0x01020304 as written
+    uint32_t header_size; // sizeof(TexturePackHeader)
+    uint32_t entry_size;  // sizeof(TexturePackEntry)
+    uint32_t entry_count; // Entries right after the header
+    uint32_t reserved;
+    uint64_t file_size;
+};
+
+// One image to write: its name, and the blob with its size and encoding
+struct TexturePackImage {
+    std::string name;
+    uint32_t width;
+    uint32_t height;
+    TexturePackEncoding encoding;
+    std::vector<unsigned char> data;
+};
+
+// Write images as a pack, next to path and then renamed over it
+bool writeTexturePack(const std::vector<TexturePackImage>& images, const std::string& path, std::string& error);
+
+// Read-only view of a pack: memory-mapped where the platform allows (read
+// into memory otherwise). Blob pointers stay valid while the pack is open
+class TexturePack {
+private:
+    const unsigned char* data;
+    size_t size;
+    bool mapped;
+    std::vector<uint64_t> buffer; // Fallback storage when not mapped, 8-byte aligned
+    
+    // Header and index of what data points to; closes on failure
+    bool check(const std::string& name, std::string& error);
+    
+    TexturePack(const TexturePack&);
+    TexturePack& operator=(const TexturePack&);
+
+public:
+    TexturePack();
+    ~TexturePack();
+    
+    // Map path and check its header and index; on failure the pack is
+    // closed and error says why
+    bool open(const std::string& path, std::string& error);
+    // The same checks on a pack already in memory (a bundled one; name
+    // stands for the path in errors), used in place when it is 8-byte
+    // aligned: the bytes must outlive the pack
+    bool open(const void* bytes, size_t byte_count, const std::string& name, std::string& error);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    
+    int getCount() const;
+    const TexturePackEntry& getEntry(int index) const;
+    const unsigned char* getBlob(int index) const { return data + getEntry(index).offset; }
+};
+
+#endif // TEXTURE_PACK_H
@@ -0,0 +1,160 @@
+#include "texture_streaming.h"
+#include "bindless_textures.h"
+#include "lodepng.h"
+#include "logging.h"
+#include "memory_stats.h"
+#include "profiler.h"
+#include "resource_bundle.h"
+#include "texture_array.h"
+#include <algorithm>
+#include <cmath>
+
+TextureStreamer::TextureStreamer() : bindless(nullptr), anisotropy(1.0f), budget(0), updates(0) {}
+
+bool TextureStreamer::create(BindlessTextures& textures, const std::vector<std::string>& files, float filtering,
+                             size_t budget_bytes, int max_size) {
+    release();
+    if (!textures.create(files.size())) return false;
+    PROFILE_SCOPE("TextureStreamer::create");
+    GLint limit = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+    max_size = std::min(max_size, (int)limit);
+    bindless = &textures;
+    anisotropy = filtering;
+    budget = budget_bytes;
+    updates = 0;
+    
+    images.resize(files.size());
+    for (size_t k = 0; k < files.size(); k++) {
+        Image& image = images[k];
+        std::vector<unsigned char> decoded;
+        unsigned width = 0, height = 0;
+        std::vector<unsigned char> png;
+        unsigned code = readResource(files[k], png) ? lodepng::decode(decoded, width, height, png) : 78; // 78: cannot open
+        if (code != 0) {
+            // Its slot stays, a transparent black texel
+            LOG_WARNING(Texture) << "Cannot read " << files[k] << ": " << lodepng_error_text(code);
+            decoded.assign(4, 0);
+            width = height = 1;
+        }
+        image.width = std::min((int)width, max_size);
+        image.height = std::min((int)height, max_size);
+        if (image.width == (int)width && image.height == (int)height) {
+            image.pixels.swap(decoded);
+        } else {
+            image.pixels.resize((size_t)image.width * image.height * 4);
+            TextureArrayBuilder::resample(decoded.data(), width, height, image.pixels.data(), image.width,
+                                          image.height);
+        }
+        MemoryStats::addScratch(image.pixels.size());
+        image.max_level = 0;
+        while ((std::max(image.width, image.height) >> (image.max_level + 1)) >= MIN_SIZE) {
+            image.max_level++;
+        }
+        image.nearest_use = -1.0f;
+        image.last_used = -1;
+        rebuild(k, image.max_level);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return true;
+}
+
+// The slots' textures stay with the BindlessTextures
+void TextureStreamer::release() {
+    for (const Image& image : images) {
+        MemoryStats::removeScratch(image.pixels.size());
+    }
+    images.clear();
+    bindless = nullptr;
+}
+
+size_t TextureStreamer::levelBytes(const Image& image, int level) {
+    return MemoryStats::textureBytes(GL_RGBA8, std::max(image.width >> level, 1), std::max(image.height >> level, 1),
+                                     1, 0);
+}
+
+size_t TextureStreamer::getResidentBytes() const {
+    size_t bytes = 0;
+    for (const Image& image : images) {
+        bytes += levelBytes(image, image.level);
+    }
+    return bytes;
+}
+
+void TextureStreamer::rebuild(int texture, int level) {
+    Image& image = images[texture];
+    TextureArrayBuilder builder(std::max(image.width >> level, 1), std::max(image.height >> level, 1));
+    builder.addImage(image.pixels.data(), image.width, image.height);
+    bindless->setTexture(texture, builder.upload(anisotropy));
+    image.level = level;
+}
+
+// === PER FRAME ===
+
+void TextureStreamer::addUse(int texture, float distance, float world_size) {
+    if (!isCreated() || texture < 0 || texture >= (int)images.size() || world_size <= 0.0f) return;
+    Image& image = images[texture];
+    const float use = std::max(distance, 0.0f) / world_size;
+    if (image.nearest_use < 0.0f || use < image.nearest_use) image.nearest_use = use;
+}
+
+bool TextureStreamer::update(float pixels_per_radian) {
+    if (!isCreated()) return false;
+    bindless->collectRetired();
+    updates++;
+    
+    // === LEVELS THE USES NEED ===
+    std::vector<int> target(images.size());
+    size_t total = 0;
+    for (size_t k = 0; k < images.size(); k++) {
+        Image& image = images[k];
+        target[k] = image.level;
+        if (image.nearest_use >= 0.0f) {
+            image.last_used = updates;
+            // Texels of the top level across one pixel at the nearest use
+            const float texels = std::max(image.width, image.height) * image.nearest_use / pixels_per_radian;
+            const int wanted = std::min(texels > 1.0f ? (int)std::floor(std::log2(texels)) : 0, image.max_level);
+            target[k] = wanted < image.level ? wanted : std::max(image.level, wanted - 1);
+        }
+        image.nearest_use = -1.0f;
+        total += levelBytes(image, target[k]);
+    }
+    
+    // === BUDGET ===
+    // Coarser by a level at a time, least recently used first, the larger
+    // of a tie
+    while (total > budget) {
+        int victim = -1;
+        for (size_t k = 0; k < images.size(); k++) {
+            if (target[k] >= images[k].max_level) continue;
+            if (victim < 0 || images[k].last_used < images[victim].last_used ||
+                (images[k].last_used == images[victim].last_used &&
+                 levelBytes(images[k], target[k]) > levelBytes(images[victim], target[victim]))) {
+                victim = k;
+            }
+        }
+        if (victim < 0) break;
+        total -= levelBytes(images[victim], target[victim]);
+        target[victim]++;
+        total += levelBytes(images[victim], target[victim]);
+    }
+    
+    // === ONE REBUILD ===
+    // A texture going coarser first, else the one with the most to gain
+    int chosen = -1;
+    for (size_t k = 0; k < images.size() && chosen < 0; k++) {
+        if (target[k] > images[k].level) chosen = k;
+    }
+    if (chosen < 0) {
+        for (size_t k = 0; k < images.size(); k++) {
+            if (target[k] < images[k].level &&
+                (chosen < 0 || images[k].level - target[k] > images[chosen].level - target[chosen])) {
+                chosen = k;
+            }
+        }
+    }
+    if (chosen < 0) return false;
+    PROFILE_SCOPE("TextureStreamer::rebuild");
+    rebuild(chosen, target[chosen]);
+    return true;
+}
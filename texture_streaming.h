@@ -0,0 +1,79 @@
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class BindlessTextures;
+
+// Keeps each bindless material texture (bindless_textures.h) at only the
+// mip levels the view needs, within a GPU memory budget. The images stay
+// decoded in memory; a texture's resident chain starts at the level its
+// nearest use needs, found from its distance and the world size one
+// repeat of the texture covers, going one level coarser per doubling of
+// distance past where a texel meets a pixel. Past the budget, the textures
+// used least recently are made coarser first.
+//
+// A texture changing level is rebuilt at the new size with its chain and
+// swapped in under the same slot, one per update() so a frame uploads at
+// most one image; coarser ones go first, freeing room for the finer. A
+// texture drops a level only once its uses are two levels coarser, so a
+// distance near a boundary doesn't rebuild it back and forth, and one
+// unused stays as it is until the budget needs its memory
+class TextureStreamer {
+public:
+    static const int MIN_SIZE = 32; // The coarsest a texture gets, on its longer side
+    
+    TextureStreamer();
+    
+    // Decode the PNGs, in slot order, at up to max_size on either side, and
+    // create textures' slots with each at its coarsest. False (nothing
+    // created) where BindlessTextures::create(count) fails
+    bool create(BindlessTextures& textures, const std::vector<std::string>& files, float anisotropy,
+                size_t budget_bytes, int max_size = 4096);
+    void release();
+    bool isCreated() const { return bindless != nullptr; }
+    
+    // === PER FRAME ===
+    // A use of texture this frame at distance from the camera, one repeat
+    // of it covering world_size; the nearest of a frame's uses counts
+    void addUse(int texture, float distance, float world_size);
+    // Pick the levels for the uses since the last update, keep them in the
+    // budget and rebuild at most one texture. pixels_per_radian is the
+    // viewport's height over the vertical field of view. True when a
+    // texture was rebuilt, which binds GL_TEXTURE_2D_ARRAY on the active
+    // unit
+    bool update(float pixels_per_radian);
+    
+    // Levels dropped from the top of texture's chain, 0 = full size
+    int getLevel(int texture) const { return images[texture].level; }
+    size_t getResidentBytes() const;
+    size_t getBudget() const { return budget; }
+
+private:
+    struct Image {
+        std::vector<unsigned char> pixels; // RGBA8, the full size
+        int width;
+        int height;
+        int level;       // Resident
+        int max_level;   // Down to MIN_SIZE
+        float nearest_use;   // Distance over world size of the frame's nearest use; negative = unused
+        long long last_used; // update() count
+    };
+    
+    BindlessTextures* bindless;
+    float anisotropy;
+    size_t budget;
+    long long updates;
+    std::vector<Image> images;
+    
+    static size_t levelBytes(const Image& image, int level);
+    void rebuild(int texture, int level);
+    
+    TextureStreamer(const TextureStreamer&);
+    TextureStreamer& operator=(const TextureStreamer&);
+};
+
+#endif // TEXTURE_STREAMING_H
@@ -0,0 +1,644 @@
+#include "tree_asset.h"
+#include "logging.h"
+#include "mesh_codec.h"
+#include "tree_forest.h"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char TREE_ASSET_MAGIC[8] = {'T', 'R', 'E', 'E', 'A', 'S', 'E', 'T'};
+static const uint32_t TREE_ASSET_BYTE_ORDER = 0x01020304u;
+
+// === WRITER ===
+
+TreeAssetWriter::TreeAssetWriter() {
+    for (int s = 0; s < TREE_ASSET_SECTION_COUNT; s++) {
+        sections[s].data = nullptr;
+        sections[s].count = 0;
+        sections[s].element_size = 0;
+        sections[s].encoding = static_cast<uint32_t>(TreeAssetEncoding::Raw);
+    }
+}
+
+void TreeAssetWriter::add(TreeAssetSection section, const void* data, size_t count, size_t element_size) {
+    Pending& pending = sections[static_cast<int>(section)];
+    pending.data = data;
+    pending.count = count;
+    pending.element_size = element_size;
+    pending.encoding = static_cast<uint32_t>(TreeAssetEncoding::Raw);
+}
+
+void TreeAssetWriter::addEncoded(TreeAssetSection section, const std::vector<uint8_t>& stream) {
+    add(section, stream.data(), stream.size(), 1);
+    sections[static_cast<int>(section)].encoding = static_cast<uint32_t>(TreeAssetEncoding::Mesh);
+}
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + TREE_ASSET_ALIGNMENT - 1) / TREE_ASSET_ALIGNMENT * TREE_ASSET_ALIGNMENT;
+}
+
+// Write next to the target, then rename over it: a reader mapping the old
+// file never sees a half-written one
+template <typename Write>
+static bool replaceFile(const std::string& path, std::string& error, Write write) {
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot create " + temporary;
+        return false;
+    }
+    const bool written = write(out);
+    out.close();
+    if (!out) error = "write to " + temporary + " failed";
+    if (!written || !out) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "cannot replace " + path;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TreeAssetWriter::write(const std::string& path, TreeAssetHeader& header, std::string& error) const {
+    return replaceFile(path, error, [&](std::ostream& out) { return write(out, header, error); });
+}
+
+bool TreeAssetWriter::write(std::ostream& out, TreeAssetHeader& header, std::string& error) const {
+    // === LAYOUT: HEADER, THEN EVERY SECTION ON AN ALIGNED OFFSET ===
+    memcpy(header.magic, TREE_ASSET_MAGIC, sizeof(header.magic));
+    header.version = TREE_ASSET_VERSION;
+    header.byte_order = TREE_ASSET_BYTE_ORDER;
+    header.header_size = sizeof(TreeAssetHeader);
+    header.branch_size = sizeof(TreeBranch);
+    header.leaf_size = sizeof(TreeLeaf);
+    uint64_t offset = alignOffset(sizeof(TreeAssetHeader));
+    for (int s = 0; s < TREE_ASSET_SECTION_COUNT; s++) {
+        TreeAssetSectionEntry& entry = header.sections[s];
+        entry.count = sections[s].count;
+        entry.element_size = sections[s].element_size;
+        entry.encoding = sections[s].encoding;
+        entry.offset = (entry.count > 0) ? offset : 0;
+        offset = alignOffset(offset + entry.count * entry.element_size);
+    }
+    header.file_size = offset;
+    
+    // === WRITE ===
+    static const char padding[TREE_ASSET_ALIGNMENT] = {};
+    uint64_t written = sizeof(TreeAssetHeader);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(TreeAssetHeader));
+    for (int s = 0; s < TREE_ASSET_SECTION_COUNT; s++) {
+        const TreeAssetSectionEntry& entry = header.sections[s];
+        if (entry.count == 0) continue;
+        out.write(padding, entry.offset - written);
+        out.write(static_cast<const char*>(sections[s].data), entry.count * entry.element_size);
+        written = entry.offset + entry.count * entry.element_size;
+    }
+    out.write(padding, header.file_size - written);
+    if (!out) {
+        error = "write failed";
+        return false;
+    }
+    return true;
+}
+
+// === MAPPED FILE ===
+
+TreeAssetFile::TreeAssetFile() : data(nullptr), size(0), mapped(false) {}
+
+TreeAssetFile::~TreeAssetFile() {
+    close();
+}
+
+void TreeAssetFile::close() {
+#if !defined(_WIN32)
+    if (mapped) {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+#endif
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+    mapped = false;
+}
+
+bool TreeAssetFile::open(const std::string& path, TreeAssetKind kind, std::string& error) {
+    close();
+    
+    // === MAP THE WHOLE FILE READ-ONLY ===
+#if defined(_WIN32)
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    size = in.tellg();
+    buffer.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(buffer.data()), size);
+    if (!in) {
+        error = "cannot read " + path;
+        close();
+        return false;
+    }
+    data = reinterpret_cast<const unsigned char*>(buffer.data());
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(TreeAssetHeader))) {
+        ::close(fd);
+        error = path + " is not a tree asset";
+        return false;
+    }
+    size = info.st_size;
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        size = 0;
+        error = "cannot map " + path;
+        return false;
+    }
+    data = static_cast<const unsigned char*>(view);
+    mapped = true;
+#endif
+    return check(path, kind, error);
+}
+
+bool TreeAssetFile::open(const void* bytes, size_t byte_count, const std::string& name, TreeAssetKind kind,
+                         std::string& error) {
+    close();
+    size = byte_count;
+    data = static_cast<const unsigned char*>(bytes);
+    if (reinterpret_cast<uintptr_t>(bytes) % sizeof(uint64_t) != 0) {
+        buffer.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        memcpy(buffer.data(), bytes, size);
+        data = reinterpret_cast<const unsigned char*>(buffer.data());
+    }
+    return check(name, kind, error);
+}
+
+bool TreeAssetFile::check(const std::string& path, TreeAssetKind kind, std::string& error) {
+    // === HEADER AND SECTION TABLE ===
+    // Everything later reads straight through these offsets, so they are
+    // the one thing checked before use
+    const char* reason = nullptr;
+    if (size < sizeof(TreeAssetHeader)) {
+        reason = "is not a tree asset";
+    } else {
+        const TreeAssetHeader& header = getHeader();
+        if (memcmp(header.magic, TREE_ASSET_MAGIC, sizeof(header.magic)) != 0) {
+            reason = "is not a tree asset";
+        } else if (header.version != TREE_ASSET_VERSION) {
+            reason = "has an unsupported version";
+        } else if (header.byte_order != TREE_ASSET_BYTE_ORDER || header.header_size != sizeof(TreeAssetHeader) ||
+                   header.branch_size != sizeof(TreeBranch) || header.leaf_size != sizeof(TreeLeaf)) {
+            reason = "was written for another byte order or struct layout";
+        } else if (header.kind != static_cast<uint32_t>(kind)) {
+            reason = (kind == TreeAssetKind::Tree) ? "is not a tree file" : "is not a forest file";
+        } else if (header.file_size != size) {
+            reason = "is truncated";
+        } else {
+            for (int s = 0; s < TREE_ASSET_SECTION_COUNT && !reason; s++) {
+                const TreeAssetSectionEntry& entry = header.sections[s];
+                if (entry.count == 0) continue;
+                if (entry.offset % TREE_ASSET_ALIGNMENT != 0 || entry.offset > size || entry.element_size == 0 ||
+                    entry.count > (size - entry.offset) / entry.element_size) {
+                    reason = "has a section outside the file";
+                } else if (entry.encoding > static_cast<uint32_t>(TreeAssetEncoding::Mesh) ||
+                           (entry.encoding == static_cast<uint32_t>(TreeAssetEncoding::Mesh) && entry.element_size != 1)) {
+                    reason = "has a section in an unknown encoding";
+                }
+            }
+        }
+    }
+    if (reason) {
+        error = path + " " + reason;
+        close();
+        return false;
+    }
+    return true;
+}
+
+size_t TreeAssetFile::getCount(TreeAssetSection section) const {
+    const TreeAssetSectionEntry& entry = getHeader().sections[static_cast<int>(section)];
+    if (!isEncoded(section)) return entry.count;
+    return meshStreamValueCount(data + entry.offset, entry.count);
+}
+
+bool TreeAssetFile::decode(TreeAssetSection section, void* out, size_t byte_count) const {
+    const TreeAssetSectionEntry& entry = getHeader().sections[static_cast<int>(section)];
+    if (isEncoded(section)) {
+        return byte_count % sizeof(uint32_t) == 0 &&
+               decodeMeshStream(data + entry.offset, entry.count, out, byte_count / sizeof(uint32_t));
+    }
+    if (byte_count != entry.count * entry.element_size) return false;
+    if (byte_count > 0) memcpy(out, data + entry.offset, byte_count);
+    return true;
+}
+
+// === TWIG LIBRARY SECTIONS ===
+
+// Flattened prototypes, kept alive until the writer has written them
+struct TwigLibraryRecords {
+    std::vector<TreeAssetTwigPrototype> prototypes;
+    std::vector<TreeBranch> branches;
+    std::vector<TreeLeaf> leaves;
+};
+
+static void addTwigLibrary(TreeAssetWriter& writer, const TwigLibrary& library, TwigLibraryRecords& records) {
+    for (const TwigPrototype& prototype : library.prototypes) {
+        TreeAssetTwigPrototype record;
+        record.first_branch = records.branches.size();
+        record.branch_count = prototype.branches.size();
+        record.first_leaf = records.leaves.size();
+        record.leaf_count = prototype.leaves.size();
+        record.first_wood_index = prototype.first_wood_index;
+        record.wood_index_count = prototype.wood_index_count;
+        record.first_leaf_index = prototype.first_leaf_index;
+        record.leaf_index_count = prototype.leaf_index_count;
+        record.growth_span = prototype.growth_span;
+        records.prototypes.push_back(record);
+        records.branches.insert(records.branches.end(), prototype.branches.begin(), prototype.branches.end());
+        records.leaves.insert(records.leaves.end(), prototype.leaves.begin(), prototype.leaves.end());
+    }
+    writer.add(TreeAssetSection::TwigPrototypes, records.prototypes);
+    writer.add(TreeAssetSection::TwigBranches, records.branches);
+    writer.add(TreeAssetSection::TwigLeaves, records.leaves);
+    writer.add(TreeAssetSection::TwigVertices, library.vertices);
+    writer.add(TreeAssetSection::TwigIndices, library.indices);
+}
+
+// The library of a file, or null with error set when its ranges don't fit
+static std::shared_ptr<const TwigLibrary> loadTwigLibrary(const TreeAssetFile& file, std::string& error) {
+    const TreeAssetHeader& header = file.getHeader();
+    std::shared_ptr<TwigLibrary> library(new TwigLibrary);
+    library->parameters = header.parameters;
+    library->layout = static_cast<BranchLayout>(header.branch_layout);
+    library->depth = header.twig_depth;
+    std::vector<TreeAssetTwigPrototype> records;
+    std::vector<TreeBranch> branches;
+    std::vector<TreeLeaf> leaves;
+    if (!file.copy(TreeAssetSection::TwigPrototypes, records) || !file.copy(TreeAssetSection::TwigBranches, branches) ||
+        !file.copy(TreeAssetSection::TwigLeaves, leaves) || !file.copy(TreeAssetSection::TwigVertices, library->vertices) ||
+        !file.copy(TreeAssetSection::TwigIndices, library->indices)) {
+        error = "twig library sections have the wrong element size";
+        return nullptr;
+    }
+    const size_t vertex_count = library->vertices.size() / Tree::VERTEX_FLOATS;
+    for (uint32_t index : library->indices) {
+        if (index >= vertex_count) {
+            error = "twig library index out of range";
+            return nullptr;
+        }
+    }
+    for (const TreeAssetTwigPrototype& record : records) {
+        if (record.first_branch < 0 || record.branch_count < 0 || record.first_branch + (size_t)record.branch_count > branches.size() ||
+            record.first_leaf < 0 || record.leaf_count < 0 || record.first_leaf + (size_t)record.leaf_count > leaves.size() ||
+            record.first_wood_index < 0 || record.wood_index_count < 0 ||
+            record.first_wood_index + (size_t)record.wood_index_count > library->indices.size() ||
+            record.first_leaf_index < 0 || record.leaf_index_count < 0 ||
+            record.first_leaf_index + (size_t)record.leaf_index_count > library->indices.size()) {
+            error = "twig prototype range out of bounds";
+            return nullptr;
+        }
+        TwigPrototype prototype;
+        prototype.branches.assign(branches.begin() + record.first_branch,
+                                  branches.begin() + record.first_branch + record.branch_count);
+        prototype.leaves.assign(leaves.begin() + record.first_leaf, leaves.begin() + record.first_leaf + record.leaf_count);
+        prototype.first_wood_index = record.first_wood_index;
+        prototype.wood_index_count = record.wood_index_count;
+        prototype.first_leaf_index = record.first_leaf_index;
+        prototype.leaf_index_count = record.leaf_index_count;
+        prototype.growth_span = record.growth_span;
+        library->prototypes.push_back(prototype);
+        // Stored as the library that was saved reordered them
+        const uint32_t* indices = library->indices.data();
+        VertexCacheStats cache = analyzeVertexCache(indices + record.first_wood_index, record.wood_index_count);
+        cache.add(analyzeVertexCache(indices + record.first_leaf_index, record.leaf_index_count));
+        library->generated_cache.add(cache);
+        library->optimized_cache.add(cache);
+    }
+    return library;
+}
+
+// === STRUCTURE CHECKS ===
+// A file that passed the header checks can still carry indices that would
+// send the per-frame passes out of bounds; one pass over each array
+// catches them
+
+// Generations size the per-generation tables; grammars nest deeper than
+// max_generations, but never more than a generation per branch, so a
+// damaged one can't size them past the file's own
+static bool validBranches(const std::vector<TreeBranch>& branches, int first, int count, int max_generations) {
+    const int64_t generation_limit = (int64_t)max_generations + count;
+    for (int i = 0; i < count; i++) {
+        int parent = branches[first + i].parent_index;
+        int generation = branches[first + i].generation;
+        if (parent < -1 || parent >= first + i || (parent >= 0 && parent < first) || generation < 0 ||
+            generation > generation_limit || (parent >= 0 && generation < branches[parent].generation)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool validLeaves(const std::vector<TreeLeaf>& leaves, int first, int count, int first_branch, int branch_count) {
+    for (int i = first; i < first + count; i++) {
+        int parent = leaves[i].parent_branch_index;
+        if (parent < first_branch || parent >= first_branch + branch_count) return false;
+    }
+    return true;
+}
+
+static bool validTwigs(const std::vector<TwigInstance>& twigs, int first, int count, int first_branch, int branch_count,
+                       const std::shared_ptr<const TwigLibrary>& library) {
+    const int prototype_count = library ? library->prototypes.size() : 0;
+    for (int t = first; t < first + count; t++) {
+        const TwigInstance& twig = twigs[t];
+        if (twig.parent_branch_index < first_branch || twig.parent_branch_index >= first_branch + branch_count ||
+            twig.prototype < 0 || twig.prototype >= prototype_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// === TREE FILES ===
+
+// Quantization of the GPU-animated vertices when encoded: offsets, normals,
+// corner directions and texcoords to 1/4096, the branch or parent index
+// (growthRef.x) exactly and the occlusion to 1/1024. A leaf's schedule and
+// size take the step of a branch vertex's share along it (growthRef.yzw)
+static const float GPU_VERTEX_STEPS[Tree::GPU_VERTEX_FLOATS] = {
+    1.0f / 4096, 1.0f / 4096, 1.0f / 4096, 1.0f / 1024, // position offset, occlusion
+    1.0f / 4096, 1.0f / 4096,                           // texcoord
+    1.0f / 4096, 1.0f / 4096, 1.0f / 4096,              // normal
+    1.0f, 1.0f / 4096, 1.0f / 4096, 1.0f / 4096,        // growthRef
+    1.0f / 4096, 1.0f / 4096, 1.0f / 4096               // cornerDir
+};
+
+bool Tree::save(const std::string& path, std::string& error, bool include_mesh, bool encode_mesh) const {
+    if (branches.empty()) {
+        error = "the tree has not been generated";
+        return false;
+    }
+    return replaceFile(path, error, [&](std::ostream& out) { return save(out, error, include_mesh, encode_mesh); });
+}
+
+bool Tree::save(std::ostream& out, std::string& error, bool include_mesh, bool encode_mesh) const {
+    if (branches.empty()) {
+        error = "the tree has not been generated";
+        return false;
+    }
+    TreeAssetHeader header;
+    memset(&header, 0, sizeof(header));
+    header.kind = static_cast<uint32_t>(TreeAssetKind::Tree);
+    header.seed = seed;
+    header.parameters = getParameters();
+    header.branch_layout = static_cast<int32_t>(branch_layout);
+    header.twig_depth = twig_depth;
+    header.twig_prototype_count = twig_prototype_count;
+    header.schedule_end_time = schedule_end_time;
+    header.mesh_animation = static_cast<int32_t>(mesh_animation);
+    header.branch_meshing = static_cast<int32_t>(branch_meshing);
+    header.branch_rendering = static_cast<int32_t>(branch_rendering);
+    header.leaf_faces = static_cast<int32_t>(leaf_faces);
+    header.min_ring_segments = min_ring_segments;
+    header.max_ring_segments = max_ring_segments;
+    header.branch_curvature = branch_curvature;
+    header.occlusion_settings = occlusion_settings;
+    
+    TreeAssetWriter writer;
+    writer.add(TreeAssetSection::Branches, branches);
+    writer.add(TreeAssetSection::Leaves, leaves);
+    writer.add(TreeAssetSection::ChildIndices, child_indices);
+    writer.add(TreeAssetSection::GenerationOffsets, generation_offsets);
+    TwigLibraryRecords twig_records;
+    if (twig_library && !twig_instances.empty()) {
+        writer.add(TreeAssetSection::TwigInstances, twig_instances);
+        addTwigLibrary(writer, *twig_library, twig_records);
+    }
+    
+    // Prebuilt buffers only describe the start-ordered slots a loader
+    // rebuilds; after regenerateSubtree they don't
+    std::vector<uint8_t> streams[4];
+    if (include_mesh && slots_in_start_order && !branch_index_offset.empty()) {
+        header.has_mesh = 1;
+        if (encode_mesh) {
+            encodeMeshIndices(branch_indices.data(), branch_indices.size(), streams[0]);
+            encodeMeshIndices(leaf_indices.data(), leaf_indices.size(), streams[1]);
+            encodeMeshVertices(static_branch_vertices.data(), static_branch_vertices.size() / GPU_VERTEX_FLOATS,
+                               GPU_VERTEX_FLOATS, GPU_VERTEX_STEPS, streams[2]);
+            encodeMeshVertices(static_leaf_vertices.data(), static_leaf_vertices.size() / GPU_VERTEX_FLOATS,
+                               GPU_VERTEX_FLOATS, GPU_VERTEX_STEPS, streams[3]);
+            writer.addEncoded(TreeAssetSection::BranchIndices, streams[0]);
+            writer.addEncoded(TreeAssetSection::LeafIndices, streams[1]);
+            writer.addEncoded(TreeAssetSection::StaticBranchVertices, streams[2]);
+            writer.addEncoded(TreeAssetSection::StaticLeafVertices, streams[3]);
+        } else {
+            writer.add(TreeAssetSection::BranchIndices, branch_indices);
+            writer.add(TreeAssetSection::LeafIndices, leaf_indices);
+            writer.add(TreeAssetSection::StaticBranchVertices, static_branch_vertices);
+            writer.add(TreeAssetSection::StaticLeafVertices, static_leaf_vertices);
+        }
+        // A few floats a branch, exact for the growth shader
+        writer.add(TreeAssetSection::BranchGrowthData, branch_growth_data);
+    }
+    return writer.write(out, header, error);
+}
+
+bool Tree::load(const std::string& path, std::string& error) {
+    TreeAssetFile file;
+    return file.open(path, TreeAssetKind::Tree, error) && adopt(file, path, error);
+}
+
+bool Tree::load(const void* bytes, size_t byte_count, std::string& error) {
+    TreeAssetFile file;
+    return file.open(bytes, byte_count, "tree asset", TreeAssetKind::Tree, error) && adopt(file, "tree asset", error);
+}
+
+bool Tree::adopt(const TreeAssetFile& file, const std::string& path, std::string& error) {
+    const TreeAssetHeader& header = file.getHeader();
+    
+    // === COPY THE STRUCTURE OUT OF THE MAPPING ===
+    // Into scratch arrays first, so a damaged file leaves the tree untouched
+    std::vector<TreeBranch> new_branches;
+    std::vector<TreeLeaf> new_leaves;
+    std::vector<int> new_generation_offsets;
+    std::vector<TwigInstance> new_twigs;
+    if (!file.copy(TreeAssetSection::Branches, new_branches) || !file.copy(TreeAssetSection::Leaves, new_leaves) ||
+        !file.copy(TreeAssetSection::GenerationOffsets, new_generation_offsets) ||
+        !file.copy(TreeAssetSection::TwigInstances, new_twigs)) {
+        error = path + " has sections with the wrong element size";
+        return false;
+    }
+    std::shared_ptr<const TwigLibrary> library;
+    if (!new_twigs.empty()) {
+        library = loadTwigLibrary(file, error);
+        if (!library) {
+            error = path + ": " + error;
+            return false;
+        }
+    }
+    const std::string parameters_error = checkTreeParameters(header.parameters, TREE_MAX_GENERATIONS);
+    if (!parameters_error.empty()) {
+        error = path + ": " + parameters_error;
+        return false;
+    }
+    const int branch_count = new_branches.size();
+    if (branch_count == 0 || !validBranches(new_branches, 0, branch_count, header.parameters.max_generations) ||
+        !validLeaves(new_leaves, 0, new_leaves.size(), 0, branch_count) ||
+        !validTwigs(new_twigs, 0, new_twigs.size(), 0, branch_count, library)) {
+        error = path + " has out-of-range element indices";
+        return false;
+    }
+    
+    // === ADOPT IT AS A FRESHLY GENERATED TREE ===
+    branches.swap(new_branches);
+    leaves.swap(new_leaves);
+    generation_offsets.swap(new_generation_offsets);
+    twig_instances.swap(new_twigs);
+    twig_library = library;
+    for (TreeBranch& branch : branches) branch.growth_progress = 0.0f;
+    for (TreeLeaf& leaf : leaves) leaf.growth_progress = 0.0f;
+    // The adjacency is cheap to rebuild and can't then disagree with the parents
+    buildChildAdjacency();
+    if (twig_library) {
+        groupTwigs();
+    } else {
+        twig_offsets.clear();
+    }
+    
+    seed = header.seed;
+    setParameters(header.parameters);
+    branch_layout = static_cast<BranchLayout>(header.branch_layout);
+    twig_depth = header.twig_depth;
+    twig_prototype_count = header.twig_prototype_count;
+    schedule_end_time = header.schedule_end_time;
+    current_growth_time = 0.0f;
+    detail_active = false;
+    budget_report = TreeBudgetReport();
+    
+    // === DRAWABLE STATE, REUSING THE SAVED GPU MESH WHEN IT FITS ===
+    // The slot layout is a function of the structure and these settings
+    bool same_slots = header.has_mesh && header.mesh_animation == static_cast<int32_t>(mesh_animation) &&
+                      header.branch_meshing == static_cast<int32_t>(branch_meshing) &&
+                      header.branch_rendering == static_cast<int32_t>(branch_rendering) &&
+                      header.leaf_faces == static_cast<int32_t>(leaf_faces) &&
+                      header.min_ring_segments == min_ring_segments && header.max_ring_segments == max_ring_segments &&
+                      header.branch_curvature == branch_curvature;
+    // The static vertices carry the baked occlusion in their position w
+    bool reuse_static = same_slots && mesh_animation == MeshAnimation::Gpu &&
+                        header.occlusion_settings == occlusion_settings;
+    prepareDrawable(!reuse_static);
+    restartEdits(0);
+    if (reuse_static) {
+        bool sized = file.getCount(TreeAssetSection::StaticBranchVertices) == branch_vertex_offset.back() * (size_t)GPU_VERTEX_FLOATS &&
+                     file.getCount(TreeAssetSection::StaticLeafVertices) == leaves.size() * leaf_slot_vertices * GPU_VERTEX_FLOATS &&
+                     file.getCount(TreeAssetSection::BranchGrowthData) == branches.size() * GPU_BRANCH_TEXELS * 4;
+        if (!sized || !file.copy(TreeAssetSection::StaticBranchVertices, static_branch_vertices) ||
+            !file.copy(TreeAssetSection::StaticLeafVertices, static_leaf_vertices) ||
+            !file.copy(TreeAssetSection::BranchGrowthData, branch_growth_data)) {
+            buildStaticMesh();
+        }
+        mesh_version = nextVersion();
+    }
+    if (verbosity >= 1) {
+        std::ostringstream stats;
+        printStats(stats);
+        Log::write(LogLevel::Info, LogCategory::Tree, stats.str());
+    }
+    return true;
+}
+
+// === FOREST FILES ===
+
+bool saveForest(const Forest& forest, const std::string& path, std::string& error) {
+    TreeAssetHeader header;
+    memset(&header, 0, sizeof(header));
+    header.kind = static_cast<uint32_t>(TreeAssetKind::Forest);
+    
+    TreeAssetWriter writer;
+    writer.add(TreeAssetSection::Branches, forest.branches);
+    writer.add(TreeAssetSection::Leaves, forest.leaves);
+    writer.add(TreeAssetSection::ChildIndices, forest.child_indices);
+    writer.add(TreeAssetSection::ForestTrees, forest.trees);
+    TwigLibraryRecords twig_records;
+    if (forest.twig_library && !forest.twig_instances.empty()) {
+        header.parameters = forest.twig_library->parameters;
+        header.branch_layout = static_cast<int32_t>(forest.twig_library->layout);
+        header.twig_depth = forest.twig_library->depth;
+        header.twig_prototype_count = forest.twig_library->prototypes.size();
+        writer.add(TreeAssetSection::TwigInstances, forest.twig_instances);
+        addTwigLibrary(writer, *forest.twig_library, twig_records);
+    }
+    return writer.write(path, header, error);
+}
+
+bool loadForest(Forest& forest, const std::string& path, std::string& error) {
+    TreeAssetFile file;
+    if (!file.open(path, TreeAssetKind::Forest, error)) return false;
+    
+    Forest loaded;
+    if (!file.copy(TreeAssetSection::Branches, loaded.branches) || !file.copy(TreeAssetSection::Leaves, loaded.leaves) ||
+        !file.copy(TreeAssetSection::ChildIndices, loaded.child_indices) ||
+        !file.copy(TreeAssetSection::ForestTrees, loaded.trees) ||
+        !file.copy(TreeAssetSection::TwigInstances, loaded.twig_instances)) {
+        error = path + " has sections with the wrong element size";
+        return false;
+    }
+    if (!loaded.twig_instances.empty()) {
+        loaded.twig_library = loadTwigLibrary(file, error);
+        if (!loaded.twig_library) {
+            error = path + ": " + error;
+            return false;
+        }
+    }
+    
+    // Every range inside the pools, every index inside its own tree's range
+    for (const ForestTreeRange& tree : loaded.trees) {
+        bool inside = tree.first_branch >= 0 && tree.branch_count >= 0 &&
+                      tree.first_branch + (size_t)tree.branch_count <= loaded.branches.size() &&
+                      tree.first_leaf >= 0 && tree.leaf_count >= 0 &&
+                      tree.first_leaf + (size_t)tree.leaf_count <= loaded.leaves.size() &&
+                      tree.first_twig >= 0 && tree.twig_count >= 0 &&
+                      tree.first_twig + (size_t)tree.twig_count <= loaded.twig_instances.size() &&
+                      tree.first_child >= 0 && tree.first_child <= (int)loaded.child_indices.size();
+        if (!inside || !validBranches(loaded.branches, tree.first_branch, tree.branch_count, TREE_MAX_GENERATIONS) ||
+            !validLeaves(loaded.leaves, tree.first_leaf, tree.leaf_count, tree.first_branch, tree.branch_count) ||
+            !validTwigs(loaded.twig_instances, tree.first_twig, tree.twig_count, tree.first_branch, tree.branch_count,
+                        loaded.twig_library)) {
+            error = path + " has out-of-range element indices";
+            return false;
+        }
+    }
+    for (const TreeBranch& branch : loaded.branches) {
+        if (branch.first_child < 0 || branch.child_count < 0 ||
+            branch.first_child + (size_t)branch.child_count > loaded.child_indices.size()) {
+            error = path + " has out-of-range child ranges";
+            return false;
+        }
+    }
+    for (int child : loaded.child_indices) {
+        if (child < 0 || child >= (int)loaded.branches.size()) {
+            error = path + " has out-of-range child indices";
+            return false;
+        }
+    }
+    
+    std::swap(forest, loaded);
+    return true;
+}
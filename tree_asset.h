@@ -0,0 +1,222 @@
+#ifndef TREE_ASSET_H
+#define TREE_ASSET_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include "tree_simple.h"
+
+struct Forest;
+
+// Binary tree asset: a fixed header, a table of typed sections and the
+// section data, each section 64-byte aligned. Sections are the in-memory
+// arrays verbatim (the element types are trivially copyable), so a mapped
+// file is used in place: the only work on load is checking the header and
+// the section bounds. Files are native-endian and tied to the struct
+// layouts; the header records both and anything else is rejected.
+//
+// A tree file holds the structure (branches, leaves, adjacency, generation
+// ranges, twigs and their library) and, optionally, the buffers a renderer
+// uploads as they are: slot index buffers and the GPU-animated meshes.
+// A forest file holds a Forest's pooled arrays and tree ranges.
+//
+// The prebuilt buffers may instead be stored encoded (mesh_codec.h), the
+// vertices quantized: such a section can't be used in place, and copy()
+// or decode() expand it on load.
+
+static const uint32_t TREE_ASSET_VERSION = 1;
+static const size_t TREE_ASSET_ALIGNMENT = 64;
+
+enum class TreeAssetKind : uint32_t {
+    Tree = 1,
+    Forest = 2
+};
+
+// How a section's bytes are stored
+enum class TreeAssetEncoding : uint32_t {
+    Raw = 0,  // The elements verbatim
+    Mesh = 1  // A mesh_codec.h stream of 32-bit elements, count bytes long
+};
+
+// Section slots of the table; a section absent from a file has count 0
+enum class TreeAssetSection : uint32_t {
+    Branches,             // TreeBranch
+    Leaves,               // TreeLeaf
+    ChildIndices,         // int
+    GenerationOffsets,    // int, breadth-first trees only
+    TwigInstances,        // TwigInstance
+    TwigPrototypes,       // TreeAssetTwigPrototype
+    TwigBranches,         // TreeBranch, every prototype's in order
+    TwigLeaves,           // TreeLeaf
+    TwigVertices,         // float, VERTEX_FLOATS layout
+    TwigIndices,          // uint32_t
+    BranchIndices,        // uint32_t, slot order
+    LeafIndices,          // uint32_t, single-sided leaves only
+    StaticBranchVertices, // float, GPU_VERTEX_FLOATS layout
+    StaticLeafVertices,   // float
+    BranchGrowthData,     // float, GPU_BRANCH_TEXELS vec4s per branch
+    ForestTrees,          // ForestTreeRange
+    Count
+};
+
+static const int TREE_ASSET_SECTION_COUNT = static_cast<int>(TreeAssetSection::Count);
+
+struct TreeAssetSectionEntry {
+    uint64_t offset;       // From the start of the file
+    uint64_t count;        // Elements
+    uint32_t element_size; // Bytes per element, checked against the reader's type
+    uint32_t encoding;     // TreeAssetEncoding; 0 in files from before encoded meshes
+};
+
+// Flat record of one twig prototype; its branches and leaves are ranges of
+// the TwigBranches / TwigLeaves sections
+struct TreeAssetTwigPrototype {
+    int32_t first_branch;
+    int32_t branch_count;
+    int32_t first_leaf;
+    int32_t leaf_count;
+    int32_t first_wood_index;
+    int32_t wood_index_count;
+    int32_t first_leaf_index;
+    int32_t leaf_index_count;
+    float growth_span;
+};
+
+struct TreeAssetHeader {
+    char magic[8];              // "TREEASET"
+    uint32_t version;           // TREE_ASSET_VERSION
+    uint32_t byte_order;        // 0x01020304 as written
+    uint32_t header_size;       // sizeof(TreeAssetHeader)
+    uint32_t kind;              // TreeAssetKind
+    uint32_t branch_size;       // sizeof(TreeBranch) / sizeof(TreeLeaf) of the writer
+    uint32_t leaf_size;
+    uint64_t file_size;
+    
+    // Tree settings the structure was generated with
+    uint64_t seed;
+    TreeParameters parameters;
+    int32_t branch_layout;      // BranchLayout
+    int32_t twig_depth;
+    int32_t twig_prototype_count;
+    float schedule_end_time;
+    
+    // Slot layout the prebuilt buffers were built for; a loader with other
+    // settings rebuilds them instead
+    int32_t mesh_animation;     // MeshAnimation
+    int32_t branch_meshing;     // BranchMeshing
+    int32_t branch_rendering;   // BranchRendering
+    int32_t leaf_faces;         // LeafFaces
+    int32_t min_ring_segments;
+    int32_t max_ring_segments;
+    int32_t has_mesh;           // Prebuilt buffer sections present
+    float branch_curvature;     // Tree::getBranchCurvature(); 0 in files from before curved branches
+    uint32_t occlusion_settings; // Tree::getOcclusionSettings() of the meshes' baked occlusion; 0 in older files
+    
+    TreeAssetSectionEntry sections[TREE_ASSET_SECTION_COUNT];
+};
+
+// Collects section pointers and writes them as one file; the data must stay
+// alive until write() returns
+class TreeAssetWriter {
+private:
+    struct Pending {
+        const void* data;
+        uint64_t count;
+        uint32_t element_size;
+        uint32_t encoding;
+    };
+    Pending sections[TREE_ASSET_SECTION_COUNT];
+
+public:
+    TreeAssetWriter();
+    
+    template <typename T>
+    void add(TreeAssetSection section, const std::vector<T>& data) {
+        add(section, data.data(), data.size(), sizeof(T));
+    }
+    void add(TreeAssetSection section, const void* data, size_t count, size_t element_size);
+    // A section as a stream from encodeMeshIndices / encodeMeshVertices
+    void addEncoded(TreeAssetSection section, const std::vector<uint8_t>& stream);
+    
+    // Fills in the magic, sizes and section table of header and writes the file
+    bool write(const std::string& path, TreeAssetHeader& header, std::string& error) const;
+    // The same bytes to out, for assets that never touch the disk
+    bool write(std::ostream& out, TreeAssetHeader& header, std::string& error) const;
+};
+
+// Read-only view of an asset file: memory-mapped where the platform allows
+// (read into memory otherwise) and unmapped on close or destruction.
+// Section pointers stay valid while the file is open
+class TreeAssetFile {
+private:
+    const unsigned char* data;
+    size_t size;
+    bool mapped;
+    std::vector<uint64_t> buffer; // Fallback storage when not mapped, 8-byte aligned
+    
+    // Header and section table of what data points to; closes on failure
+    bool check(const std::string& name, TreeAssetKind kind, std::string& error);
+    
+    TreeAssetFile(const TreeAssetFile&);
+    TreeAssetFile& operator=(const TreeAssetFile&);
+
+public:
+    TreeAssetFile();
+    ~TreeAssetFile();
+    
+    // Map path and check its header and section table; on failure the file
+    // is closed and error says why
+    bool open(const std::string& path, TreeAssetKind kind, std::string& error);
+    // The same checks on an asset already in memory (name stands for the
+    // path in errors), used in place when it is 8-byte aligned and copied
+    // otherwise: the bytes must outlive the file
+    bool open(const void* bytes, size_t byte_count, const std::string& name, TreeAssetKind kind, std::string& error);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    
+    const TreeAssetHeader& getHeader() const { return *reinterpret_cast<const TreeAssetHeader*>(data); }
+    // Elements of a section, those an encoded one decodes to (0 when its
+    // stream is damaged)
+    size_t getCount(TreeAssetSection section) const;
+    bool isEncoded(TreeAssetSection section) const {
+        return getHeader().sections[static_cast<int>(section)].encoding != static_cast<uint32_t>(TreeAssetEncoding::Raw);
+    }
+    
+    // Typed pointer to a section in place, or null when it is empty, was
+    // written with another element size or is encoded
+    template <typename T>
+    const T* get(TreeAssetSection section) const {
+        const TreeAssetSectionEntry& entry = getHeader().sections[static_cast<int>(section)];
+        if (entry.count == 0 || entry.element_size != sizeof(T) || isEncoded(section)) return nullptr;
+        return reinterpret_cast<const T*>(data + entry.offset);
+    }
+    
+    // A section's elements into out, byte_count bytes: all of them, decoded
+    // when encoded. out may be a mapped GPU buffer. False when the sizes
+    // differ or the stream is damaged
+    bool decode(TreeAssetSection section, void* out, size_t byte_count) const;
+    
+    // Copy a section into a vector; false if the element size doesn't match
+    // or an encoded section doesn't decode
+    template <typename T>
+    bool copy(TreeAssetSection section, std::vector<T>& out) const {
+        const TreeAssetSectionEntry& entry = getHeader().sections[static_cast<int>(section)];
+        if (isEncoded(section)) {
+            if (sizeof(T) != sizeof(uint32_t)) return false;
+            out.resize(getCount(section));
+            return decode(section, out.data(), out.size() * sizeof(T));
+        }
+        if (entry.count != 0 && entry.element_size != sizeof(T)) return false;
+        const T* first = reinterpret_cast<const T*>(data + entry.offset);
+        out.assign(first, first + entry.count);
+        return true;
+    }
+};
+
+// A Forest as one asset file; loading replaces the forest's contents
+bool saveForest(const Forest& forest, const std::string& path, std::string& error);
+bool loadForest(Forest& forest, const std::string& path, std::string& error);
+
+#endif // TREE_ASSET_H
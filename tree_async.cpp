@@ -0,0 +1,44 @@
+#include "tree_async.h"
+#include "profiler.h"
+
+TreeGenerationJob::TreeGenerationJob(std::unique_ptr<Tree> tree, const std::function<void(Tree&)>& work)
+    : state(new State()) {
+    // The job owns the tree until take() hands it back
+    state->tree = std::move(tree);
+    state->work = work;
+    State* job_state = state.get();
+    state->job.setBackground(true);
+    state->job.setTask([job_state]() {
+        PROFILE_SCOPE("generateTreeAsync");
+        job_state->work(*job_state->tree);
+    });
+    JobSystem::shared().submit(state->job);
+}
+
+TreeGenerationJob& TreeGenerationJob::operator=(TreeGenerationJob&& other) {
+    if (this != &other) {
+        wait();
+        state = std::move(other.state);
+    }
+    return *this;
+}
+
+void TreeGenerationJob::wait() {
+    if (state) JobSystem::shared().wait(state->job);
+}
+
+std::unique_ptr<Tree> TreeGenerationJob::take() {
+    if (!state) return nullptr;
+    wait();
+    std::unique_ptr<Tree> tree = std::move(state->tree);
+    state.reset();
+    return tree;
+}
+
+TreeGenerationJob generateTreeAsync(std::unique_ptr<Tree> tree) {
+    return TreeGenerationJob(std::move(tree), [](Tree& job_tree) { job_tree.generate(); });
+}
+
+TreeGenerationJob generateTreeAsync(std::unique_ptr<Tree> tree, uint64_t seed) {
+    return TreeGenerationJob(std::move(tree), [seed](Tree& job_tree) { job_tree.generate(seed); });
+}
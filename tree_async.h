@@ -0,0 +1,50 @@
+#ifndef TREE_ASYNC_H
+#define TREE_ASYNC_H
+
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include "job_system.h"
+#include "tree_simple.h"
+
+// Handle to a tree being generated by a background job of the job system
+// (job_system.h). The render loop polls isReady() once per frame and
+// take()s the finished tree, so the tree it is drawing keeps rendering
+// until the swap. Destroying or replacing a pending job waits for it to
+// finish
+class TreeGenerationJob {
+private:
+    struct State {
+        std::unique_ptr<Tree> tree;
+        std::function<void(Tree&)> work;
+        Job job;
+    };
+    std::unique_ptr<State> state;
+    
+    void wait();
+    
+    TreeGenerationJob(const TreeGenerationJob&);
+    TreeGenerationJob& operator=(const TreeGenerationJob&);
+
+public:
+    TreeGenerationJob() {}
+    // Submit work(*tree) at once
+    TreeGenerationJob(std::unique_ptr<Tree> tree, const std::function<void(Tree&)>& work);
+    TreeGenerationJob(TreeGenerationJob&& other) : state(std::move(other.state)) {}
+    TreeGenerationJob& operator=(TreeGenerationJob&& other);
+    ~TreeGenerationJob() { wait(); }
+    
+    // True from launch until the tree has been taken
+    bool isPending() const { return state != nullptr; }
+    // Never blocks
+    bool isReady() const { return state && state->job.isDone(); }
+    // Blocks if the job is still running; the job is empty afterwards
+    std::unique_ptr<Tree> take();
+};
+
+// Run generate() as a background job for a tree already configured through
+// its setters; it must not be touched until taken back from the job
+TreeGenerationJob generateTreeAsync(std::unique_ptr<Tree> tree);                // Fresh random seed
+TreeGenerationJob generateTreeAsync(std::unique_ptr<Tree> tree, uint64_t seed); // Deterministic
+
+#endif // TREE_ASYNC_H
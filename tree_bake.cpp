@@ -0,0 +1,119 @@
+// Offline tree baker: generates trees in batches on a worker pool
+// (ForestBuilder) and exports them fully grown (tree_export.h).
+//
+//   tree_bake [--seed S] [--threads N] [--batch N] [--spacing D] output.obj count
+//
+// streams count trees, seeds S to S + count - 1 (default 1), into one OBJ
+// file, planted on a square grid D apart (default 10); only --batch trees
+// (default 256) are held at a time however many are baked
+//
+//   tree_bake --glb [--seed S] [--threads N] [--batch N] prefix count
+//
+// writes each tree at the origin to its own prefix_SEED.glb instead.
+// --twigs DEPTH instances twig prototypes from generation DEPTH on
+// (Tree::setTwigInstancing). Both print the trees, triangles and bytes
+// written per second
+#include "tree_export.h"
+#include "tree_forest.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+
+int main(int argc, char** argv) {
+    uint64_t seed = 1;
+    int threads = 0;
+    int batch = 256;
+    int twig_depth = 0;
+    float spacing = 10.0f;
+    bool glb = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--batch" && i + 1 < argc) batch = atoi(argv[++i]);
+        else if (arg == "--twigs" && i + 1 < argc) twig_depth = atoi(argv[++i]);
+        else if (arg == "--spacing" && i + 1 < argc) spacing = atof(argv[++i]);
+        else if (arg == "--glb") glb = true;
+        else files.push_back(arg);
+    }
+    int count = files.size() == 2 ? atoi(files[1].c_str()) : 0;
+    if (count <= 0 || batch <= 0) {
+        std::cout << "Usage: " << argv[0] << " [--seed S] [--threads N] [--batch N] [--spacing D] [--twigs DEPTH]"
+                  << " output.obj count" << std::endl
+                  << "       " << argv[0] << " --glb [--seed S] [--threads N] [--batch N] [--twigs DEPTH]"
+                  << " prefix count" << std::endl;
+        return 1;
+    }
+    
+    const TreeParameters parameters = Tree().getParameters();
+    const int columns = (int)std::ceil(std::sqrt((double)count));
+    ForestBuilder builder;
+    builder.setThreads(threads);
+    if (twig_depth > 0) builder.setTwigInstancing(twig_depth, 8);
+    Forest forest;
+    TreeExportMesh mesh; // --glb's, reused for every tree
+    ObjWriter obj;
+    std::string error;
+    if (!glb && !obj.open(files[0], error)) {
+        std::cout << "Cannot write " << files[0] << ": " << error << std::endl;
+        return 1;
+    }
+    
+    // === BATCHES ===
+    // Generate a batch, export it, and reuse the builder's and the forest's
+    // storage for the next
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double generation_seconds = 0.0;
+    size_t triangles = 0;
+    size_t bytes = 0;
+    for (int first = 0; first < count; first += batch) {
+        const int size = std::min(batch, count - first);
+        builder.clear();
+        for (int k = first; k < first + size; k++) {
+            glm::vec3 position(0.0f);
+            if (!glb) position = glm::vec3((k % columns) * spacing, 0.0f, (k / columns) * spacing);
+            builder.add(seed + k, parameters, glm::translate(glm::mat4(1.0f), position));
+        }
+        std::chrono::steady_clock::time_point generated = std::chrono::steady_clock::now();
+        builder.build(forest);
+        generation_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - generated).count();
+        
+        for (int t = 0; t < size; t++) {
+            TreeExportSource source = forestExportSource(forest, t);
+            if (!glb) {
+                obj.add(source);
+                continue;
+            }
+            std::string path = files[0] + "_" + std::to_string(seed + first + t) + ".glb";
+            meshTreeForExport(source, true, mesh);
+            if (!writeGlb(mesh, path, error)) {
+                std::cout << "Cannot write " << path << ": " << error << std::endl;
+                return 1;
+            }
+            struct stat info;
+            if (stat(path.c_str(), &info) == 0) bytes += info.st_size;
+            triangles += (mesh.wood_indices.size() + mesh.leaf_indices.size()) / 3;
+        }
+    }
+    if (!glb) {
+        triangles = obj.getTriangleCount();
+        if (!obj.close(error)) {
+            std::cout << "Cannot write " << files[0] << ": " << error << std::endl;
+            return 1;
+        }
+        bytes = obj.getBytesWritten();
+    }
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double export_seconds = std::max(seconds - generation_seconds, 1e-9);
+    std::cout << count << " trees, " << triangles << " triangles, " << bytes / (1024 * 1024) << " MB in " << seconds
+              << " s (generation " << generation_seconds << " s, export " << count / export_seconds << " trees/s, "
+              << bytes / (1024.0 * 1024.0) / export_seconds << " MB/s)" << std::endl;
+    return 0;
+}
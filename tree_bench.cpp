@@ -0,0 +1,247 @@
+// Headless benchmark of the tree pipeline: for every max_generations of a
+// range and every seed, times generate(), the full growth replayed frame by
+// frame, a mesh rebuild (a seek from the start to the grown tree rewrites
+// every element) and a save and load of the tree file, and reports the
+// median and p99 of each with its heap allocations as JSON.
+//
+//   tree_bench [--seed S] [--seeds N] [--runs N] [--min-generations A]
+//              [--max-generations B] [--update-threads N] [--scratch FILE]
+//              [--output FILE]
+//
+// Seeds S to S + N - 1 (default 1, 3 seeds), generations A to B (default
+// 4 to 9), N timed runs of each (default 5) after one untimed warm-up. The
+// tree file goes to FILE (default tree_bench.tree) and is removed at the
+// end; the JSON goes to stdout unless --output names a file, progress to
+// stderr.
+//
+// With the baseline options (bench_baseline.h) the samples of each
+// operation at each max_generations are checked against this machine's
+// stored baseline (--compare), exiting with status 2 when one regressed,
+// or stored as it (--save-baseline).
+//
+// The first seed's fresh tree also reports the bytes its topology arrays
+// hold and the capacity they reserved in generate(); the bench exits with
+// status 3 when the capacity is more than TOPOLOGY_SLACK times the bytes
+#include "bench_baseline.h"
+#include "tree_simple.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// === ALLOCATION COUNTING ===
+// Every operator new of the process, the worker threads' included
+
+static std::atomic<uint64_t> allocationCount(0);
+static std::atomic<uint64_t> allocatedBytes(0);
+
+static void* countedAllocate(size_t bytes) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    void* memory = malloc(bytes ? bytes : 1);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t bytes) { return countedAllocate(bytes); }
+void* operator new[](size_t bytes) { return countedAllocate(bytes); }
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+
+// === MEASUREMENT ===
+
+struct Sample {
+    double milliseconds;
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+template <typename Work>
+static Sample measure(Work work) {
+    const uint64_t allocations = allocationCount.load(std::memory_order_relaxed);
+    const uint64_t bytes = allocatedBytes.load(std::memory_order_relaxed);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    work();
+    Sample sample;
+    sample.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    sample.allocations = allocationCount.load(std::memory_order_relaxed) - allocations;
+    sample.bytes = allocatedBytes.load(std::memory_order_relaxed) - bytes;
+    return sample;
+}
+
+// Nearest-rank percentile, p in (0, 1], of values
+template <typename T>
+static T percentile(std::vector<T> values, double p) {
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(p * values.size());
+    return values[std::min(std::max<size_t>(rank, 1), values.size()) - 1];
+}
+
+enum Operation { GENERATE, GROWTH_REPLAY, MESH_REBUILD, SAVE, LOAD, OPERATIONS };
+static const char* OPERATION_NAMES[OPERATIONS] = { "generate", "growth_replay", "mesh_rebuild", "save", "load" };
+
+static const float FRAME_SECONDS = 1.0f / 60.0f;
+static const double TOPOLOGY_SLACK = 2.0;
+
+int main(int argc, char** argv) {
+    uint64_t seed = 1;
+    int seeds = 3;
+    int runs = 5;
+    int min_generations = 4;
+    int max_generations = 9;
+    int update_threads = 0;
+    std::string scratch = "tree_bench.tree";
+    std::string output;
+    BenchBaselineOptions baseline;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--seeds" && i + 1 < argc) seeds = atoi(argv[++i]);
+        else if (arg == "--runs" && i + 1 < argc) runs = atoi(argv[++i]);
+        else if (arg == "--min-generations" && i + 1 < argc) min_generations = atoi(argv[++i]);
+        else if (arg == "--max-generations" && i + 1 < argc) max_generations = atoi(argv[++i]);
+        else if (arg == "--update-threads" && i + 1 < argc) update_threads = atoi(argv[++i]);
+        else if (arg == "--scratch" && i + 1 < argc) scratch = argv[++i];
+        else if (arg == "--output" && i + 1 < argc) output = argv[++i];
+        else if (baseline.parse(argc, argv, i)) continue;
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--seed S] [--seeds N] [--runs N] [--min-generations A]"
+                      << " [--max-generations B] [--update-threads N] [--scratch FILE] [--output FILE] "
+                      << BenchBaselineOptions::usage() << std::endl;
+            return 1;
+        }
+    }
+    if (seeds <= 0 || runs <= 0 || min_generations < 1 || max_generations < min_generations) {
+        std::cerr << "Need at least one seed, one run and generations 1 <= A <= B" << std::endl;
+        return 1;
+    }
+    
+    std::string json = "{\n  \"benchmark\": \"tree_bench\",\n";
+    char text[256];
+    snprintf(text, sizeof(text), "  \"first_seed\": %llu,\n  \"seeds\": %d,\n  \"runs\": %d,\n"
+             "  \"update_threads\": %d,\n  \"frame_seconds\": %.6f,\n  \"results\": [\n",
+             (unsigned long long)seed, seeds, runs, update_threads, FRAME_SECONDS);
+    json += text;
+    BenchBaseline run;
+    bool overreserved = false;
+    
+    for (int generations = min_generations; generations <= max_generations; generations++) {
+        std::vector<Sample> samples[OPERATIONS];
+        std::vector<int> frames;
+        long long branches = 0;
+        long long leaves = 0;
+        TreeMemory topology = TreeMemory();
+        for (int s = 0; s < seeds; s++) {
+            Tree tree;
+            tree.setVerbosity(0);
+            tree.setUpdateThreads(update_threads);
+            TreeParameters parameters = tree.getParameters();
+            parameters.max_generations = generations;
+            tree.setParameters(parameters);
+            
+            // === RUNS ===
+            // Run 0 warms the tree's storage and the allocator up and is
+            // left out
+            for (int run = 0; run <= runs; run++) {
+                Sample sample[OPERATIONS];
+                std::string error;
+                bool saved = false;
+                bool loaded = false;
+                int frame_count = 0;
+                sample[GENERATE] = measure([&]() { tree.generate(seed + s); });
+                if (s == 0 && run == 0) topology = tree.getMemoryUsage();
+                
+                tree.setGrowthTime(0.0f);
+                const int frame_limit = (int)std::ceil(tree.getScheduleEnd() / FRAME_SECONDS) + 600;
+                sample[GROWTH_REPLAY] = measure([&]() {
+                    while (!tree.isStatic() && frame_count < frame_limit) {
+                        tree.updateGrowth(FRAME_SECONDS);
+                        frame_count++;
+                    }
+                });
+                
+                tree.setGrowthTime(0.0f);
+                sample[MESH_REBUILD] = measure([&]() { tree.setGrowthTime(tree.getScheduleEnd()); });
+                sample[SAVE] = measure([&]() { saved = tree.save(scratch, error); });
+                if (saved) sample[LOAD] = measure([&]() { loaded = tree.load(scratch, error); });
+                if (!saved || !loaded) {
+                    std::cerr << "Cannot " << (saved ? "load " : "save ") << scratch << ": " << error << std::endl;
+                    remove(scratch.c_str());
+                    return 1;
+                }
+                if (run == 0) continue;
+                for (int op = 0; op < OPERATIONS; op++) {
+                    samples[op].push_back(sample[op]);
+                }
+                frames.push_back(frame_count);
+            }
+            if (s == 0) {
+                branches = tree.getBranchCount();
+                leaves = tree.getLeafCount();
+            }
+        }
+        
+        // === REPORT ===
+        snprintf(text, sizeof(text), "    {\n      \"max_generations\": %d,\n      \"branches\": %lld,\n"
+                 "      \"leaves\": %lld,\n      \"topology_bytes\": %llu,\n      \"topology_capacity\": %llu,\n"
+                 "      \"replay_frames\": %d,\n      \"operations\": {\n",
+                 generations, branches, leaves, (unsigned long long)topology.topology_bytes,
+                 (unsigned long long)topology.topology_capacity, percentile(frames, 0.5));
+        json += text;
+        if (topology.topology_capacity > TOPOLOGY_SLACK * topology.topology_bytes) {
+            std::cerr << "max_generations " << generations << ": topology capacity " << topology.topology_capacity
+                      << " bytes for " << topology.topology_bytes << " in use" << std::endl;
+            overreserved = true;
+        }
+        std::cerr << "max_generations " << generations << ", " << branches << " branches:";
+        for (int op = 0; op < OPERATIONS; op++) {
+            std::vector<double> times;
+            std::vector<uint64_t> allocations;
+            std::vector<uint64_t> bytes;
+            const std::string metric = std::string(OPERATION_NAMES[op]) + "/g" + std::to_string(generations);
+            for (const Sample& sample : samples[op]) {
+                run.add(metric, sample.milliseconds);
+                times.push_back(sample.milliseconds);
+                allocations.push_back(sample.allocations);
+                bytes.push_back(sample.bytes);
+            }
+            double median = percentile(times, 0.5);
+            snprintf(text, sizeof(text), "        \"%s\": { \"median_ms\": %.4f, \"p99_ms\": %.4f, "
+                     "\"allocations\": %llu, \"allocated_bytes\": %llu }%s\n",
+                     OPERATION_NAMES[op], median, percentile(times, 0.99),
+                     (unsigned long long)percentile(allocations, 0.5), (unsigned long long)percentile(bytes, 0.5),
+                     op + 1 < OPERATIONS ? "," : "");
+            json += text;
+            std::cerr << " " << OPERATION_NAMES[op] << " " << median << " ms";
+        }
+        std::cerr << std::endl;
+        json += "      }\n    }";
+        json += generations < max_generations ? ",\n" : "\n";
+    }
+    json += "  ]\n}\n";
+    remove(scratch.c_str());
+    
+    if (output.empty()) {
+        std::cout << json;
+        int status = baseline.finish("tree_bench", run, std::cerr);
+        return status == 0 && overreserved ? 3 : status;
+    }
+    FILE* file = fopen(output.c_str(), "wb");
+    if (!file || fwrite(json.data(), 1, json.size(), file) != json.size()) {
+        std::cerr << "Cannot write " << output << std::endl;
+        if (file) fclose(file);
+        return 1;
+    }
+    if (fclose(file) != 0) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return 1;
+    }
+    int status = baseline.finish("tree_bench", run, std::cerr);
+    return status == 0 && overreserved ? 3 : status;
+}
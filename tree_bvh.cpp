@@ -0,0 +1,512 @@
+#include "tree_bvh.h"
+#include "tree_lod.h"
+#include <algorithm>
+#include <limits>
+
+// === HIERARCHY ===
+
+TreeBvh::TreeBvh() : branch_count(0), grown_shapes(false) {}
+
+void TreeBvh::fitElements(const Tree& tree, bool grown) {
+    const std::vector<TreeBranch>& branches = tree.getBranches();
+    const std::vector<TreeLeaf>& leaves = tree.getLeaves();
+    const int count = branches.size() + leaves.size();
+    element_min.resize(count);
+    element_max.resize(count);
+    branch_end.resize(branches.size());
+    
+    // Parents precede their children in both branch layouts, so one forward
+    // pass resolves every animated endpoint, as Tree does for its meshes
+    for (int i = 0; i < (int)branches.size(); i++) {
+        const TreeBranch& branch = branches[i];
+        float progress = grown ? 1.0f : tree.branchProgress(i);
+        glm::vec3 start = branch.parent_index < 0 ? branch.start : branch_end[branch.parent_index];
+        glm::vec3 end = start + (branch.end - branch.start) * progress;
+        branch_end[i] = end;
+        float radius = branch.parent_index < 0 ? branch.radius
+                                               : std::max(branch.radius, branches[branch.parent_index].radius);
+        element_min[i] = glm::min(start, end) - glm::vec3(radius);
+        element_max[i] = glm::max(start, end) + glm::vec3(radius);
+    }
+    
+    // Leaves keep their offset from the parent's end; a quad never gets
+    // smaller than the builder's minimum size
+    const int leaf_base = branches.size();
+    for (int j = 0; j < (int)leaves.size(); j++) {
+        const TreeLeaf& leaf = leaves[j];
+        int p = leaf.parent_branch_index;
+        if (p < 0 || p >= leaf_base) {
+            element_min[leaf_base + j] = glm::vec3(std::numeric_limits<float>::max());
+            element_max[leaf_base + j] = glm::vec3(-std::numeric_limits<float>::max());
+            continue;
+        }
+        glm::vec3 position = branch_end[p] + (leaf.position - branches[p].end);
+        float half_diagonal = 0.71f * std::max(leaf.size, 0.05f);
+        element_min[leaf_base + j] = position - glm::vec3(half_diagonal);
+        element_max[leaf_base + j] = position + glm::vec3(half_diagonal);
+    }
+}
+
+void TreeBvh::build(const Tree& tree) {
+    buildHierarchy(tree);
+    refit(tree);
+}
+
+void TreeBvh::buildGrown(const Tree& tree) {
+    buildHierarchy(tree);
+    if (nodes.empty()) return;
+    // buildHierarchy left the element boxes fully grown
+    fitNodes();
+    grown_shapes = true;
+}
+
+void TreeBvh::buildHierarchy(const Tree& tree) {
+    nodes.clear();
+    elements.clear();
+    branch_count = tree.getBranchCount();
+    const int count = branch_count + tree.getLeafCount();
+    if (count == 0) return;
+    
+    // === SPLIT THE FULLY GROWN TREE ===
+    fitElements(tree, true);
+    std::vector<glm::vec3> centers(count);
+    for (int e = 0; e < count; e++) {
+        centers[e] = (element_min[e] + element_max[e]) * 0.5f;
+        elements.push_back(e);
+    }
+    nodes.reserve(2 * (count / LEAF_ELEMENTS + 1));
+    Node root = { glm::vec3(0.0f), 0, glm::vec3(0.0f), count, -1 };
+    nodes.push_back(root);
+    split(0, centers);
+}
+
+void TreeBvh::split(int node, const std::vector<glm::vec3>& centers) {
+    const int first = nodes[node].first;
+    const int count = nodes[node].count;
+    if (count <= LEAF_ELEMENTS) return;
+    
+    // Median of the longest axis of the element centers: both halves get
+    // the same number of elements, so the depth stays log2(count / 16)
+    glm::vec3 low = centers[elements[first]];
+    glm::vec3 high = low;
+    for (int k = first + 1; k < first + count; k++) {
+        low = glm::min(low, centers[elements[k]]);
+        high = glm::max(high, centers[elements[k]]);
+    }
+    glm::vec3 extent = high - low;
+    int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+    const int half = count / 2;
+    std::nth_element(elements.begin() + first, elements.begin() + first + half, elements.begin() + first + count,
+                     [&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+    
+    const int left = nodes.size();
+    nodes[node].left = left;
+    Node lower = { glm::vec3(0.0f), first, glm::vec3(0.0f), half, -1 };
+    Node upper = { glm::vec3(0.0f), first + half, glm::vec3(0.0f), count - half, -1 };
+    nodes.push_back(lower);
+    nodes.push_back(upper);
+    split(left, centers);
+    split(left + 1, centers);
+}
+
+void TreeBvh::refit(const Tree& tree) {
+    if (nodes.empty()) return;
+    fitElements(tree, false);
+    grown_shapes = false;
+    fitNodes();
+}
+
+void TreeBvh::fitNodes() {
+    // Children come after their parent, so a backward pass sees both
+    // children of a node before the node itself
+    for (int n = nodes.size() - 1; n >= 0; n--) {
+        Node& node = nodes[n];
+        if (node.left >= 0) {
+            node.min = glm::min(nodes[node.left].min, nodes[node.left + 1].min);
+            node.max = glm::max(nodes[node.left].max, nodes[node.left + 1].max);
+            continue;
+        }
+        // A cluster pruning emptied keeps an inverted box
+        node.min = glm::vec3(std::numeric_limits<float>::max());
+        node.max = glm::vec3(-std::numeric_limits<float>::max());
+        for (int k = node.first; k < node.first + node.count; k++) {
+            node.min = glm::min(node.min, element_min[elements[k]]);
+            node.max = glm::max(node.max, element_max[elements[k]]);
+        }
+    }
+}
+
+void TreeBvh::remap(const Tree& tree, const TreeRemap& remap) {
+    if (nodes.empty()) return;
+    if (remap.branch_old_to_new.size() != (size_t)branch_count ||
+        remap.branch_old_to_new.size() + remap.leaf_old_to_new.size() != elements.size()) {
+        build(tree);
+        return;
+    }
+    
+    // Survivors keep their order, so a node's range becomes the survivors
+    // of its old one: it starts after those before it
+    std::vector<int> kept_before(elements.size() + 1);
+    const int new_branch_count = tree.getBranchCount();
+    int kept = 0;
+    for (size_t k = 0; k < elements.size(); k++) {
+        kept_before[k] = kept;
+        int e = elements[k];
+        int n = e < branch_count ? remap.branch_old_to_new[e] : remap.leaf_old_to_new[e - branch_count];
+        if (n < 0) continue;
+        elements[kept++] = e < branch_count ? n : new_branch_count + n;
+    }
+    kept_before[elements.size()] = kept;
+    for (Node& node : nodes) {
+        int end = kept_before[node.first + node.count];
+        node.first = kept_before[node.first];
+        node.count = end - node.first;
+    }
+    elements.resize(kept);
+    branch_count = new_branch_count;
+    refit(tree);
+}
+
+bool TreeBvh::getBounds(glm::vec3& min, glm::vec3& max) const {
+    if (nodes.empty()) return false;
+    min = nodes[0].min;
+    max = nodes[0].max;
+    return true;
+}
+
+// === CULLING ===
+
+void TreeBvh::markVisible(const Tree& tree, const TreeLod* lod, int first, int count) {
+    for (int k = first; k < first + count; k++) {
+        int e = elements[k];
+        unsigned char mark = 2;
+        if (lod) {
+            int level = lod->getElementLevel(e);
+            if (level < lod->getFadeLevel()) continue;
+            if (level < lod->getSolidLevel()) mark = 1;
+        }
+        if (e < branch_count) {
+            int slot = tree.getBranchSlot(e);
+            if (slot < (int)branch_visible.size()) branch_visible[slot] = mark;
+        } else {
+            int slot = tree.getLeafSlot(e - branch_count);
+            if (slot < (int)leaf_visible.size()) leaf_visible[slot] = mark;
+        }
+    }
+}
+
+// Append a slot's range to the runs, extending the last run when it ends
+// where this one starts
+static void appendRange(TreeDrawRanges& ranges, int first, int count) {
+    if (count <= 0) return;
+    ranges.total += count;
+    ranges.drawn_slots++;
+    if (!ranges.first.empty() && ranges.first.back() + ranges.count.back() == first) {
+        ranges.count.back() += count;
+        return;
+    }
+    ranges.first.push_back(first);
+    ranges.count.push_back(count);
+}
+
+static void clearRanges(TreeDrawRanges& ranges, int tested_slots) {
+    ranges.first.clear();
+    ranges.count.clear();
+    ranges.total = 0;
+    ranges.drawn_slots = 0;
+    ranges.tested_slots = tested_slots;
+}
+
+void TreeBvh::cull(const Tree& tree, const ViewFrustum* frustum, const TreeLod* lod,
+                   TreeDrawRanges& branch_ranges, TreeDrawRanges& leaf_ranges,
+                   TreeDrawRanges* fading_branch_ranges, TreeDrawRanges* fading_leaf_ranges) {
+    const int drawn_branches = tree.drawnBranchSlots();
+    const int drawn_leaves = tree.drawnLeafSlots();
+    clearRanges(branch_ranges, drawn_branches);
+    clearRanges(leaf_ranges, drawn_leaves);
+    TreeDrawRanges& fading_branches = fading_branch_ranges ? *fading_branch_ranges : branch_ranges;
+    TreeDrawRanges& fading_leaves = fading_leaf_ranges ? *fading_leaf_ranges : leaf_ranges;
+    if (fading_branch_ranges) clearRanges(*fading_branch_ranges, 0);
+    if (fading_leaf_ranges) clearRanges(*fading_leaf_ranges, 0);
+    if (nodes.empty()) return;
+    branch_visible.assign(std::max(0, drawn_branches), 0);
+    leaf_visible.assign(std::max(0, drawn_leaves), 0);
+    
+    // === WALK THE HIERARCHY ===
+    // A node entirely inside takes all its elements without testing below it
+    int stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const Node& node = nodes[stack[--depth]];
+        int side = frustum ? frustum->classify(node.min, node.max) : 1;
+        if (side < 0) continue;
+        if (side > 0 || node.left < 0) {
+            markVisible(tree, lod, node.first, node.count);
+        } else {
+            stack[depth++] = node.left;
+            stack[depth++] = node.left + 1;
+        }
+    }
+    
+    // === VISIBLE SLOTS TO RUNS ===
+    // In slot order, so neighbours in the buffer merge into one range
+    const std::vector<int>& offsets = tree.getBranchIndexOffsets();
+    for (int s = 0; s < drawn_branches; s++) {
+        if (branch_visible[s] == 2) appendRange(branch_ranges, offsets[s], offsets[s + 1] - offsets[s]);
+        else if (branch_visible[s] == 1) appendRange(fading_branches, offsets[s], offsets[s + 1] - offsets[s]);
+    }
+    const int leaf_units = tree.getLeafIndices().empty() ? tree.getLeafSlotVertices() : Tree::LEAF_SINGLE_SLOT_INDICES;
+    for (int s = 0; s < drawn_leaves; s++) {
+        if (leaf_visible[s] == 2) appendRange(leaf_ranges, s * leaf_units, leaf_units);
+        else if (leaf_visible[s] == 1) appendRange(fading_leaves, s * leaf_units, leaf_units);
+    }
+}
+
+// === QUERIES ===
+
+bool TreeBvh::branchCapsule(const Tree& tree, int branch_index, glm::vec3& a, glm::vec3& b, float& radius) const {
+    if (!grown_shapes && tree.branchProgress(branch_index) <= 0.0f) return false;
+    const TreeBranch& branch = tree.getBranches()[branch_index];
+    a = branch.parent_index < 0 ? branch.start : branch_end[branch.parent_index];
+    b = branch_end[branch_index];
+    radius = branch.radius;
+    return true;
+}
+
+bool TreeBvh::leafDisc(const Tree& tree, int leaf_index, glm::vec3& center, glm::vec3& normal, float& radius) const {
+    float progress = grown_shapes ? 1.0f : tree.leafProgress(leaf_index);
+    const TreeLeaf& leaf = tree.getLeaves()[leaf_index];
+    int p = leaf.parent_branch_index;
+    if (progress <= 0.0f || p < 0 || p >= branch_count) return false;
+    center = branch_end[p] + (leaf.position - tree.getBranches()[p].end);
+    normal = leaf.normal;
+    // The quad's inscribed disc, growing from the builder's minimum size
+    radius = 0.5f * (0.05f + (leaf.size - 0.05f) * progress);
+    return true;
+}
+
+// Distance along the ray to where it enters the box, or infinity when it
+// misses it before limit
+static float rayEntersBox(const glm::vec3& origin, const glm::vec3& inverse_direction,
+                          const glm::vec3& min, const glm::vec3& max, float limit) {
+    glm::vec3 t0 = (min - origin) * inverse_direction;
+    glm::vec3 t1 = (max - origin) * inverse_direction;
+    glm::vec3 near = glm::min(t0, t1);
+    glm::vec3 far = glm::max(t0, t1);
+    float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    float exit = std::min(std::min(far.x, far.y), std::min(far.z, limit));
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+// Distance along the ray (unit direction) to a sphere, or -1
+static float raySphere(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& center, float radius) {
+    glm::vec3 oc = origin - center;
+    float b = glm::dot(direction, oc);
+    float c = glm::dot(oc, oc) - radius * radius;
+    if (c <= 0.0f) return 0.0f; // Starting inside
+    float h = b * b - c;
+    if (h < 0.0f || b > 0.0f) return -1.0f;
+    return -b - std::sqrt(h);
+}
+
+// Distance along the ray (unit direction) to the capsule around [a, b],
+// or -1: the cylinder's side, then the cap sphere on the side it falls past
+static float rayCapsuleNear(const glm::vec3& origin, const glm::vec3& direction,
+                            const glm::vec3& a, const glm::vec3& b, float radius) {
+    glm::vec3 ba = b - a;
+    glm::vec3 oa = origin - a;
+    float baba = glm::dot(ba, ba);
+    float bard = glm::dot(ba, direction);
+    float baoa = glm::dot(ba, oa);
+    float qa = baba - bard * bard;
+    if (baba > 1e-12f && qa > 1e-9f * baba) {
+        float qb = baba * glm::dot(direction, oa) - baoa * bard;
+        float qc = baba * glm::dot(oa, oa) - baoa * baoa - radius * radius * baba;
+        if (qc <= 0.0f && baoa >= 0.0f && baoa <= baba) return 0.0f; // Starting inside the side
+        float h = qb * qb - qa * qc;
+        if (h < 0.0f) return -1.0f;
+        float t = (-qb - std::sqrt(h)) / qa;
+        float y = baoa + t * bard;
+        if (y > 0.0f && y < baba) return t >= 0.0f ? t : -1.0f;
+        return raySphere(origin, direction, y <= 0.0f ? a : b, radius);
+    }
+    // Along the axis or a point: the nearer cap
+    float ta = raySphere(origin, direction, a, radius);
+    float tb = raySphere(origin, direction, b, radius);
+    if (ta < 0.0f) return tb;
+    return tb < 0.0f ? ta : std::min(ta, tb);
+}
+
+// The same from the point of the ray nearest a, so the quadratics work on
+// small numbers far from the origin; a hit behind that point is still found
+static float rayCapsule(const glm::vec3& origin, const glm::vec3& direction,
+                        const glm::vec3& a, const glm::vec3& b, float radius) {
+    float shift = std::max(0.0f, glm::dot(a - origin, direction) - glm::length(b - a) - radius);
+    float t = rayCapsuleNear(origin + direction * shift, direction, a, b, radius);
+    return t < 0.0f ? -1.0f : t + shift;
+}
+
+// Distance along the ray (unit direction) to a disc, or -1; either face
+static float rayDisc(const glm::vec3& origin, const glm::vec3& direction,
+                     const glm::vec3& center, const glm::vec3& normal, float radius) {
+    float facing = glm::dot(direction, normal);
+    if (std::fabs(facing) < 1e-8f) return -1.0f;
+    float t = glm::dot(center - origin, normal) / facing;
+    if (t < 0.0f) return -1.0f;
+    glm::vec3 offset = origin + direction * t - center;
+    return glm::dot(offset, offset) <= radius * radius ? t : -1.0f;
+}
+
+// Closest points of segments [p1, q1] and [p2, q2]; returns their squared
+// distance (Ericson's clamped solution)
+static float segmentSegmentDistance2(const glm::vec3& p1, const glm::vec3& q1,
+                                     const glm::vec3& p2, const glm::vec3& q2) {
+    glm::vec3 d1 = q1 - p1;
+    glm::vec3 d2 = q2 - p2;
+    glm::vec3 r = p1 - p2;
+    float a = glm::dot(d1, d1);
+    float e = glm::dot(d2, d2);
+    float f = glm::dot(d2, r);
+    float s = 0.0f;
+    float t = 0.0f;
+    if (a <= 1e-12f && e <= 1e-12f) {
+        return glm::dot(r, r);
+    }
+    if (a <= 1e-12f) {
+        t = glm::clamp(f / e, 0.0f, 1.0f);
+    } else {
+        float c = glm::dot(d1, r);
+        if (e <= 1e-12f) {
+            s = glm::clamp(-c / a, 0.0f, 1.0f);
+        } else {
+            float b = glm::dot(d1, d2);
+            float denominator = a * e - b * b;
+            s = denominator > 0.0f ? glm::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            } else if (t > 1.0f) {
+                t = 1.0f;
+                s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+    glm::vec3 gap = (p1 + d1 * s) - (p2 + d2 * t);
+    return glm::dot(gap, gap);
+}
+
+// Lower bound of the distance from segment [a, b] to a disc: zero where
+// the segment crosses it, else the nearer of its ends' distances and its
+// distance to the center less the disc's radius. Exact for a point, as a
+// sphere query passes
+static float segmentDiscDistance(const glm::vec3& a, const glm::vec3& b,
+                                 const glm::vec3& center, const glm::vec3& normal, float radius) {
+    float da = glm::dot(a - center, normal);
+    float db = glm::dot(b - center, normal);
+    if ((da <= 0.0f) != (db <= 0.0f)) {
+        glm::vec3 crossing = a + (b - a) * (da / (da - db));
+        if (glm::length(crossing - center) <= radius) return 0.0f;
+    }
+    float nearest = std::numeric_limits<float>::max();
+    const glm::vec3* ends[2] = { &a, &b };
+    const float heights[2] = { da, db };
+    for (int k = 0; k < 2; k++) {
+        glm::vec3 in_plane = *ends[k] - normal * heights[k] - center;
+        float radial = glm::length(in_plane);
+        float outside = std::max(0.0f, radial - radius);
+        nearest = std::min(nearest, std::sqrt(heights[k] * heights[k] + outside * outside));
+    }
+    if (a == b) return nearest;
+    float axis = std::sqrt(segmentSegmentDistance2(a, b, center, center)) - radius;
+    return std::min(nearest, std::max(0.0f, axis));
+}
+
+bool TreeBvh::raycast(const Tree& tree, const glm::vec3& origin, const glm::vec3& direction, float max_distance,
+                      TreeRayHit& hit) const {
+    hit.branch = -1;
+    hit.leaf = -1;
+    hit.distance = max_distance;
+    if (nodes.empty() || branch_end.size() != (size_t)branch_count || branch_count != tree.getBranchCount()) {
+        return false;
+    }
+    const glm::vec3 inverse_direction = 1.0f / direction;
+    
+    // Nearer child first, and nodes entered past the nearest hit so far are
+    // skipped, so the walk ends soon after the first hit
+    int stack[64];
+    int depth = 0;
+    if (rayEntersBox(origin, inverse_direction, nodes[0].min, nodes[0].max, hit.distance) <= hit.distance) {
+        stack[depth++] = 0;
+    }
+    while (depth > 0) {
+        const Node& node = nodes[stack[--depth]];
+        if (node.left >= 0) {
+            const Node& left = nodes[node.left];
+            const Node& right = nodes[node.left + 1];
+            float t_left = rayEntersBox(origin, inverse_direction, left.min, left.max, hit.distance);
+            float t_right = rayEntersBox(origin, inverse_direction, right.min, right.max, hit.distance);
+            bool left_first = t_left <= t_right;
+            float t_far = left_first ? t_right : t_left;
+            float t_near = left_first ? t_left : t_right;
+            if (t_far <= hit.distance) stack[depth++] = left_first ? node.left + 1 : node.left;
+            if (t_near <= hit.distance) stack[depth++] = left_first ? node.left : node.left + 1;
+            continue;
+        }
+        for (int k = node.first; k < node.first + node.count; k++) {
+            int e = elements[k];
+            if (rayEntersBox(origin, inverse_direction, element_min[e], element_max[e], hit.distance) > hit.distance) {
+                continue;
+            }
+            float t = -1.0f;
+            glm::vec3 a, b;
+            float radius;
+            if (e < branch_count) {
+                if (branchCapsule(tree, e, a, b, radius)) t = rayCapsule(origin, direction, a, b, radius);
+            } else if (leafDisc(tree, e - branch_count, a, b, radius)) {
+                t = rayDisc(origin, direction, a, b, radius);
+            }
+            if (t < 0.0f || t > hit.distance) continue;
+            hit.distance = t;
+            hit.branch = e < branch_count ? e : -1;
+            hit.leaf = e < branch_count ? -1 : e - branch_count;
+        }
+    }
+    return hit.branch >= 0 || hit.leaf >= 0;
+}
+
+void TreeBvh::overlapCapsule(const Tree& tree, const glm::vec3& a, const glm::vec3& b, float radius,
+                             std::vector<int>& branches, std::vector<int>& leaves) const {
+    branches.clear();
+    leaves.clear();
+    if (nodes.empty() || branch_end.size() != (size_t)branch_count || branch_count != tree.getBranchCount()) return;
+    const glm::vec3 low = glm::min(a, b) - glm::vec3(radius);
+    const glm::vec3 high = glm::max(a, b) + glm::vec3(radius);
+    
+    int stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const Node& node = nodes[stack[--depth]];
+        if (glm::any(glm::lessThan(node.max, low)) || glm::any(glm::greaterThan(node.min, high))) continue;
+        if (node.left >= 0) {
+            stack[depth++] = node.left;
+            stack[depth++] = node.left + 1;
+            continue;
+        }
+        for (int k = node.first; k < node.first + node.count; k++) {
+            int e = elements[k];
+            if (glm::any(glm::lessThan(element_max[e], low)) || glm::any(glm::greaterThan(element_min[e], high))) continue;
+            glm::vec3 p, q;
+            float element_radius;
+            if (e < branch_count) {
+                if (!branchCapsule(tree, e, p, q, element_radius)) continue;
+                float reach = radius + element_radius;
+                if (segmentSegmentDistance2(a, b, p, q) <= reach * reach) branches.push_back(e);
+            } else if (leafDisc(tree, e - branch_count, p, q, element_radius)) {
+                if (segmentDiscDistance(a, b, p, q, element_radius) <= radius) leaves.push_back(e - branch_count);
+            }
+        }
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef TREE_BVH_H
+#define TREE_BVH_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "frustum.h"
+#include "tree_simple.h"
+
+class TreeLod;
+
+// What a TreeBvh::raycast hit: a branch or a leaf index, the other -1
+struct TreeRayHit {
+    int branch;
+    int leaf;
+    float distance; // Along the ray
+};
+
+// Visible slots of one tree mesh as runs for glMultiDraw*: count[i]
+// indices (or vertices) from first[i], adjacent slots merged
+struct TreeDrawRanges {
+    std::vector<GLint> first;
+    std::vector<GLsizei> count;
+    int total;        // Sum of count
+    int drawn_slots;  // Slots in the runs
+    int tested_slots; // Slots the tree would draw unculled
+    
+    TreeDrawRanges() : total(0), drawn_slots(0), tested_slots(0) {}
+    int getRangeCount() const { return first.size(); }
+};
+
+// Bounding volume hierarchy over one tree's branches and leaves, for
+// frustum culling its meshes and for ray and overlap queries. build()
+// splits the fully grown elements at the median of their longest axis down
+// to clusters of LEAF_ELEMENTS, so the hierarchy fits the finished tree;
+// refit() recomputes every box from the current growth (children start
+// where their parent currently ends) without changing the tree structure,
+// and is all a growing frame needs. cull() walks the hierarchy against a
+// frustum and turns the clusters that survive into draw ranges over the
+// tree's mesh slots, keeping only the elements a TreeLod selects. The
+// queries walk it too, testing the exact shapes only in the clusters they
+// reach.
+//
+// Boxes hold the geometry of the CPU-animated meshes: branch cylinders
+// padded by their radius (welded tubes by the parent's, whose ring they
+// share) and leaf quads by their half diagonal. Instances, twigs and the
+// GPU-animated meshes are not covered
+class TreeBvh {
+public:
+    static const int LEAF_ELEMENTS = 16;
+    
+    TreeBvh();
+    
+    // Rebuild for a tree's elements; needed whenever its layout changes.
+    // Leaves the boxes fitted to the current growth
+    void build(const Tree& tree);
+    // Refit the boxes to the tree's current growth
+    void refit(const Tree& tree);
+    // Follow an edit that only removed elements (Tree::pruneBranch): the
+    // survivors keep their clusters under their new numbers, and the boxes
+    // are refitted. The hierarchy loosens as elements go, until the next
+    // build()
+    void remap(const Tree& tree, const TreeRemap& remap);
+    // build() for the fully grown tree, whatever its growth: the boxes and
+    // the queries' shapes are every element at full size until the next
+    // refit(), for bakes of the finished tree. Needs only the tree's
+    // elements, not its growth state
+    void buildGrown(const Tree& tree);
+    
+    // === QUERIES ===
+    // Against the tree at the last refit (or fully grown after
+    // buildGrown), in its space: branches as
+    // capsules of their base radius, leaves as the discs inscribed in their
+    // quads, both growing with them and absent before they start.
+    //
+    // The first branch or leaf the ray from origin along the unit direction
+    // meets within max_distance; false when it meets none
+    bool raycast(const Tree& tree, const glm::vec3& origin, const glm::vec3& direction, float max_distance,
+                 TreeRayHit& hit) const;
+    // Branches and leaves overlapping the capsule of radius around segment
+    // [a, b] (a sphere for a == b), in element order within each cluster.
+    // Leaves are tested conservatively: one a little past radius may count
+    void overlapCapsule(const Tree& tree, const glm::vec3& a, const glm::vec3& b, float radius,
+                        std::vector<int>& branches, std::vector<int>& leaves) const;
+    void overlapSphere(const Tree& tree, const glm::vec3& center, float radius,
+                       std::vector<int>& branches, std::vector<int>& leaves) const {
+        overlapCapsule(tree, center, center, radius, branches, leaves);
+    }
+    
+    // Draw ranges of the elements that may be visible through frustum, in
+    // the tree's space (ViewFrustum::fromMatrix(P * V * M)): branch
+    // indices, and leaf vertices, or indices for single-sided leaves. Only
+    // the slots the tree draws unculled are considered. A null frustum
+    // keeps every element; with a lod only the elements of its solid
+    // levels go to branch_ranges and leaf_ranges, and those of its fading
+    // ones to the fading ranges (to the solid ones when those are null)
+    void cull(const Tree& tree, const ViewFrustum* frustum, const TreeLod* lod,
+              TreeDrawRanges& branch_ranges, TreeDrawRanges& leaf_ranges,
+              TreeDrawRanges* fading_branch_ranges = nullptr, TreeDrawRanges* fading_leaf_ranges = nullptr);
+    
+    int getNodeCount() const { return nodes.size(); }
+    bool isEmpty() const { return nodes.empty(); }
+    // Box around the whole tree at its last refit; false when empty
+    bool getBounds(glm::vec3& min, glm::vec3& max) const;
+
+private:
+    struct Node {
+        glm::vec3 min;
+        int first;  // Elements [first, first + count) of the element order
+        glm::vec3 max;
+        int count;
+        int left;   // First of the two children (left + 1 the other), -1 for a cluster
+    };
+    
+    std::vector<Node> nodes;      // Root first, children after their parent
+    std::vector<int> elements;    // Elements in cluster order: branch i is i, leaf j branch_count + j
+    int branch_count;
+    bool grown_shapes; // The queries see the fully grown tree (buildGrown)
+    
+    // Per element, by element number
+    std::vector<glm::vec3> element_min;
+    std::vector<glm::vec3> element_max;
+    
+    // Scratch: animated branch ends, and the slots marked visible (1
+    // fading, 2 solid)
+    std::vector<glm::vec3> branch_end;
+    std::vector<unsigned char> branch_visible;
+    std::vector<unsigned char> leaf_visible;
+    
+    // Element boxes at the current growth, or fully grown
+    void fitElements(const Tree& tree, bool grown);
+    // The hierarchy's nodes over the fully grown elements, boxes unfitted
+    void buildHierarchy(const Tree& tree);
+    // Split a node's elements in two children, recursively down to clusters
+    void split(int node, const std::vector<glm::vec3>& centers);
+    // Every node's box from the element boxes
+    void fitNodes();
+    void markVisible(const Tree& tree, const TreeLod* lod, int first, int count);
+    // An element's query shape at the last refit; false before it starts
+    bool branchCapsule(const Tree& tree, int branch_index, glm::vec3& a, glm::vec3& b, float& radius) const;
+    bool leafDisc(const Tree& tree, int leaf_index, glm::vec3& center, glm::vec3& normal, float& radius) const;
+};
+
+#endif // TREE_BVH_H
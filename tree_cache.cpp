@@ -0,0 +1,220 @@
+#include "tree_cache.h"
+#include "logging.h"
+#include "lsystem.h"
+#include "profiler.h"
+#include "space_colonization.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+TreeCache::TreeCache() : memory_budget(0), memory_bytes(0), memory_hits(0), disk_hits(0), misses(0) {}
+
+void TreeCache::configure(size_t budget, const std::string& cache_directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    memory_budget = budget;
+    directory = cache_directory;
+    while (memory_bytes > memory_budget && !uses.empty()) {
+        auto oldest = entries.find(uses.back());
+        memory_bytes -= oldest->second.asset->size();
+        entries.erase(oldest);
+        uses.pop_back();
+    }
+}
+
+// === KEYS ===
+
+namespace {
+
+// FNV-1a over values one at a time, so struct padding never reaches it
+struct KeyHash {
+    uint64_t hash;
+    
+    KeyHash() : hash(14695981039346656037ULL) {}
+    
+    template <typename T>
+    void add(const T& value) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(&value);
+        for (size_t i = 0; i < sizeof(T); i++) {
+            hash ^= p[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    void add(const glm::vec3& value) {
+        add(value.x);
+        add(value.y);
+        add(value.z);
+    }
+};
+
+}
+
+uint64_t TreeCache::keyFor(const Tree& tree, uint64_t seed) {
+    KeyHash key;
+    key.add(TREE_GENERATOR_VERSION);
+    key.add(seed);
+    const TreeParameters parameters = tree.getParameters();
+    key.add(parameters.max_generations);
+    key.add(parameters.branch_angle_variance);
+    key.add(parameters.length_reduction_factor);
+    key.add(parameters.radius_reduction_factor);
+    key.add(parameters.max_growth_time);
+    key.add(static_cast<int32_t>(tree.getBranchLayout()));
+    key.add(static_cast<int32_t>(tree.getLeafLayout()));
+    key.add(tree.getTwigDepth());
+    key.add(tree.getTwigDepth() > 0 ? tree.getTwigPrototypeCount() : 0);
+    // Any thread count grows the same tree, but not the serial one's
+    key.add(tree.getGenerationThreads() > 0);
+    key.add(tree.getBranchAvoidance());
+    const TreeBudget& budget = tree.getBudget();
+    key.add(budget.max_branches);
+    key.add(budget.max_leaves);
+    key.add(budget.max_vertices);
+    // The mesh settings only decide whether the saved buffers are reused
+    // on load, but a tree loading buffers built for others rebuilds them
+    key.add(static_cast<int32_t>(tree.getMeshAnimation()));
+    key.add(static_cast<int32_t>(tree.getBranchMeshing()));
+    key.add(static_cast<int32_t>(tree.getBranchRendering()));
+    key.add(static_cast<int32_t>(tree.getLeafFaces()));
+    int min_segments, max_segments;
+    tree.getRingSegmentRange(min_segments, max_segments);
+    key.add(min_segments);
+    key.add(max_segments);
+    key.add(tree.getBranchCurvature());
+    key.add(tree.getCurveVertexBudget());
+    key.add(tree.getOcclusionSettings());
+    
+    key.add(static_cast<int32_t>(tree.getGenerator()));
+    if (tree.getGenerator() == TreeGenerator::SpaceColonization) {
+        const SpaceColonizationParameters& colonization = tree.getSpaceColonizationParameters();
+        key.add(colonization.attractor_count);
+        key.add(colonization.crown_center);
+        key.add(colonization.crown_radii);
+        key.add(colonization.influence_radius);
+        key.add(colonization.kill_radius);
+        key.add(colonization.segment_length);
+        key.add(colonization.max_iterations);
+        key.add(colonization.segments_per_branch);
+        key.add(colonization.tip_radius);
+        key.add(colonization.radius_exponent);
+        key.add(colonization.leaves_per_tip);
+    } else {
+        key.add(tree.getGrammar() ? tree.getGrammar()->getSourceHash() : 0);
+    }
+    return key.hash;
+}
+
+std::string TreeCache::pathFor(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "tree_%016llx.tree", (unsigned long long)key);
+    return directory + "/" + name;
+}
+
+// === LOOKUP ===
+
+TreeCacheSource TreeCache::generate(Tree& tree, uint64_t seed) {
+    if (!isEnabled() || !isCacheable(tree)) {
+        tree.generate(seed);
+        return TreeCacheSource::Generated;
+    }
+    PROFILE_SCOPE("TreeCache::generate");
+    const uint64_t key = keyFor(tree, seed);
+    std::string error;
+    std::shared_ptr<const std::string> asset;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        asset = find(key);
+        if (!directory.empty()) path = pathFor(key);
+    }
+    if (asset && tree.load(asset->data(), asset->size(), error)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        memory_hits++;
+        return TreeCacheSource::Memory;
+    }
+    
+    // === DISK ===
+    // Loaded through the mapping, then read into memory when it fits there;
+    // one that won't load (from a crashed write, say) is generated over
+    if (!path.empty() && tree.load(path, error) && tree.getSeed() == seed) {
+        std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+        const size_t size = in ? (size_t)in.tellg() : 0;
+        std::lock_guard<std::mutex> lock(mutex);
+        disk_hits++;
+        if (size > 0 && size <= memory_budget) {
+            std::string bytes(size, '\0');
+            in.seekg(0);
+            if (in.read(&bytes[0], size)) insert(key, std::make_shared<const std::string>(std::move(bytes)));
+        }
+        return TreeCacheSource::Disk;
+    }
+    
+    // === MISS ===
+    tree.generate(seed);
+    std::ostringstream out;
+    if (!tree.save(out, error)) {
+        LOG_WARNING(Tree) << "Tree cache: " << error;
+        return TreeCacheSource::Generated;
+    }
+    asset = std::make_shared<const std::string>(out.str());
+    if (!path.empty()) {
+        // Next to the target, then renamed over it, so a concurrent reader
+        // never loads half a tree
+        const std::string temporary = path + ".tmp";
+        std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(asset->data(), asset->size());
+        file.close();
+        if (!file || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            LOG_WARNING(Tree) << "Tree cache: cannot write " << path;
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    insert(key, asset);
+    misses++;
+    return TreeCacheSource::Generated;
+}
+
+// === MEMORY ===
+
+std::shared_ptr<const std::string> TreeCache::find(uint64_t key) {
+    auto entry = entries.find(key);
+    if (entry == entries.end()) return nullptr;
+    uses.splice(uses.begin(), uses, entry->second.use);
+    return entry->second.asset;
+}
+
+void TreeCache::insert(uint64_t key, const std::shared_ptr<const std::string>& asset) {
+    if (asset->size() > memory_budget || entries.count(key)) return;
+    while (memory_bytes + asset->size() > memory_budget && !uses.empty()) {
+        auto oldest = entries.find(uses.back());
+        memory_bytes -= oldest->second.asset->size();
+        entries.erase(oldest);
+        uses.pop_back();
+    }
+    uses.push_front(key);
+    Entry entry = { asset, uses.begin() };
+    entries[key] = entry;
+    memory_bytes += asset->size();
+}
+
+// === STATISTICS ===
+
+uint64_t TreeCache::getMemoryHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memory_hits;
+}
+
+uint64_t TreeCache::getDiskHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return disk_hits;
+}
+
+uint64_t TreeCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+size_t TreeCache::getMemoryBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memory_bytes;
+}
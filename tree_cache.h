@@ -0,0 +1,79 @@
+#ifndef TREE_CACHE_H
+#define TREE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "tree_simple.h"
+
+enum class TreeCacheSource {
+    Generated, // Not cached (or not cacheable): generate() ran
+    Memory,
+    Disk
+};
+
+// Content-addressed cache in front of Tree::generate(seed): a tree is named
+// by a hash of the seed, TREE_GENERATOR_VERSION and every setting that
+// shapes its structure (parameters, layout, twigs, generator and its
+// parameters, the grammar's source, threaded or not, the budget), and
+// kept as its asset file (tree_asset.h) in memory up to a byte budget,
+// least recently used out first, and in a directory as tree_KEY.tree. A
+// repeated archetype is then a load rather than a generation. The mesh
+// settings and the occlusion bake's (Tree::getOcclusionSettings) are in
+// the key too, so a loaded tree reuses the saved GPU meshes rather than
+// building them again.
+//
+// Lazily detailed trees aren't cached (their coarse structure is all a
+// file can hold), and a cached tree's budget report is empty.
+// Thread-safe: any number of trees may generate through one cache
+class TreeCache {
+public:
+    TreeCache();
+    
+    // memory_budget 0 keeps nothing in memory, directory "" nothing on disk.
+    // Not while trees generate through the cache
+    void configure(size_t memory_budget, const std::string& directory);
+    bool isEnabled() const { return memory_budget > 0 || !directory.empty(); }
+    
+    // tree.generate(seed), or the same tree from the cache
+    TreeCacheSource generate(Tree& tree, uint64_t seed);
+    
+    static bool isCacheable(const Tree& tree) { return tree.getDetailGeneration() == 0; }
+    static uint64_t keyFor(const Tree& tree, uint64_t seed);
+    
+    // === STATISTICS ===
+    uint64_t getMemoryHits() const;
+    uint64_t getDiskHits() const;
+    uint64_t getMisses() const; // Cacheable trees generated
+    size_t getMemoryBytes() const;
+    size_t getMemoryBudget() const { return memory_budget; }
+
+private:
+    struct Entry {
+        std::shared_ptr<const std::string> asset;
+        std::list<uint64_t>::iterator use; // In uses
+    };
+    
+    size_t memory_budget;
+    std::string directory;
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    std::list<uint64_t> uses; // Most recently used first
+    size_t memory_bytes;
+    uint64_t memory_hits;
+    uint64_t disk_hits;
+    uint64_t misses;
+    
+    std::string pathFor(uint64_t key) const;
+    std::shared_ptr<const std::string> find(uint64_t key);
+    void insert(uint64_t key, const std::shared_ptr<const std::string>& asset);
+    
+    TreeCache(const TreeCache&);
+    TreeCache& operator=(const TreeCache&);
+};
+
+#endif // TREE_CACHE_H
@@ -0,0 +1,245 @@
+#include "tree_compact.h"
+#include "tree_forest.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+
+static const float QUANT_STEPS = 65535.0f;
+
+// Scale mapping [0, range] onto the 16-bit steps; 0 for an empty range,
+// which then quantizes everything to 0
+static float quantScale(float range) {
+    return range > 0.0f ? range / QUANT_STEPS : 0.0f;
+}
+
+static uint16_t quantize(float value, float offset, float scale) {
+    if (scale <= 0.0f) return 0;
+    float q = std::round((value - offset) / scale);
+    return static_cast<uint16_t>(std::min(QUANT_STEPS, std::max(0.0f, q)));
+}
+
+static uint8_t quantizeProgress(float progress) {
+    return static_cast<uint8_t>(std::round(std::min(1.0f, std::max(0.0f, progress)) * 255.0f));
+}
+
+// Octahedral normal: project onto |x| + |y| + |z| = 1, fold the lower half
+// over the upper, store x and y as signed bytes
+static uint16_t encodeNormal(glm::vec3 n) {
+    n /= std::max(1e-20f, std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z));
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f) {
+        e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::packSnorm2x8(e);
+}
+
+static glm::vec3 decodeNormal(uint16_t packed) {
+    glm::vec2 e = glm::unpackSnorm2x8(packed);
+    glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    if (n.z < 0.0f) {
+        glm::vec2 folded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        n.x = folded.x;
+        n.y = folded.y;
+    }
+    return glm::normalize(n);
+}
+
+static glm::vec3 dequantize(const uint16_t q[3], const CompactTreeRange& tree) {
+    return tree.bounds_min + glm::vec3(q[0], q[1], q[2]) * tree.bounds_scale;
+}
+
+void CompactForest::clear() {
+    branches.clear();
+    leaves.clear();
+    parents16.clear();
+    parents32.clear();
+    trees.clear();
+    twig_library.reset();
+    twig_instances.clear();
+}
+
+void CompactForest::assign(const Forest& forest) {
+    clear();
+    branches.resize(forest.branches.size());
+    leaves.resize(forest.leaves.size());
+    trees.resize(forest.trees.size());
+    twig_library = forest.twig_library;
+    twig_instances = forest.twig_instances;
+    
+    for (size_t k = 0; k < forest.trees.size(); k++) {
+        const ForestTreeRange& source = forest.trees[k];
+        CompactTreeRange& tree = trees[k];
+        tree.first_branch = source.first_branch;
+        tree.branch_count = source.branch_count;
+        tree.first_leaf = source.first_leaf;
+        tree.leaf_count = source.leaf_count;
+        tree.first_twig = source.first_twig;
+        tree.twig_count = source.twig_count;
+        tree.seed = source.seed;
+        tree.transform = source.transform;
+        const TreeBranch* src_branches = forest.branches.data() + source.first_branch;
+        const TreeLeaf* src_leaves = forest.leaves.data() + source.first_leaf;
+        
+        // === QUANTIZATION RANGES ===
+        // The tree's own bounds and maxima, so small trees keep their precision
+        glm::vec3 lo(0.0f);
+        glm::vec3 hi(0.0f);
+        float max_radius = 0.0f;
+        float max_leaf_size = 0.0f;
+        float end_time = 0.0f;
+        for (int i = 0; i < source.branch_count; i++) {
+            const TreeBranch& branch = src_branches[i];
+            if (i == 0) lo = hi = branch.start;
+            lo = glm::min(lo, glm::min(branch.start, branch.end));
+            hi = glm::max(hi, glm::max(branch.start, branch.end));
+            max_radius = std::max(max_radius, branch.radius);
+            end_time = std::max(end_time, branch.start_time + branch.growth_duration);
+        }
+        for (int i = 0; i < source.leaf_count; i++) {
+            const TreeLeaf& leaf = src_leaves[i];
+            lo = glm::min(lo, leaf.position);
+            hi = glm::max(hi, leaf.position);
+            max_leaf_size = std::max(max_leaf_size, leaf.size);
+            end_time = std::max(end_time, leaf.start_time + leaf.growth_duration);
+        }
+        tree.bounds_min = lo;
+        tree.bounds_scale = glm::vec3(quantScale(hi.x - lo.x), quantScale(hi.y - lo.y), quantScale(hi.z - lo.z));
+        tree.radius_scale = quantScale(max_radius);
+        tree.leaf_size_scale = quantScale(max_leaf_size);
+        tree.time_scale = quantScale(end_time);
+        
+        // === RECORDS ===
+        CompactBranch* dst_branches = branches.data() + source.first_branch;
+        for (int i = 0; i < source.branch_count; i++) {
+            const TreeBranch& branch = src_branches[i];
+            CompactBranch& out = dst_branches[i];
+            for (int a = 0; a < 3; a++) {
+                out.start[a] = quantize(branch.start[a], lo[a], tree.bounds_scale[a]);
+                out.end[a] = quantize(branch.end[a], lo[a], tree.bounds_scale[a]);
+            }
+            out.radius = quantize(branch.radius, 0.0f, tree.radius_scale);
+            out.start_time = quantize(branch.start_time, 0.0f, tree.time_scale);
+            out.growth_duration = quantize(branch.growth_duration, 0.0f, tree.time_scale);
+            out.generation = static_cast<uint8_t>(std::min(255, std::max(0, branch.generation)));
+            out.growth_progress = quantizeProgress(branch.growth_progress);
+        }
+        CompactLeaf* dst_leaves = leaves.data() + source.first_leaf;
+        for (int i = 0; i < source.leaf_count; i++) {
+            const TreeLeaf& leaf = src_leaves[i];
+            CompactLeaf& out = dst_leaves[i];
+            for (int a = 0; a < 3; a++) {
+                out.position[a] = quantize(leaf.position[a], lo[a], tree.bounds_scale[a]);
+            }
+            out.normal = encodeNormal(leaf.normal);
+            out.size = quantize(leaf.size, 0.0f, tree.leaf_size_scale);
+            out.start_time = quantize(leaf.start_time, 0.0f, tree.time_scale);
+            out.growth_duration = quantize(leaf.growth_duration, 0.0f, tree.time_scale);
+            out.growth_progress = quantizeProgress(leaf.growth_progress);
+            out.reserved = 0;
+        }
+        
+        // === PARENT STREAM, AS NARROW AS THE TREE ALLOWS ===
+        // Branch parents are stored + 1 so the trunk's -1 fits unsigned
+        tree.parent_bits = (source.branch_count < 65536) ? 16 : 32;
+        if (tree.parent_bits == 16) {
+            tree.first_parent = parents16.size();
+            for (int i = 0; i < source.branch_count; i++) {
+                int parent = src_branches[i].parent_index;
+                parents16.push_back(parent < 0 ? 0 : parent - source.first_branch + 1);
+            }
+            for (int i = 0; i < source.leaf_count; i++) {
+                parents16.push_back(src_leaves[i].parent_branch_index - source.first_branch);
+            }
+        } else {
+            tree.first_parent = parents32.size();
+            for (int i = 0; i < source.branch_count; i++) {
+                int parent = src_branches[i].parent_index;
+                parents32.push_back(parent < 0 ? 0 : parent - source.first_branch + 1);
+            }
+            for (int i = 0; i < source.leaf_count; i++) {
+                parents32.push_back(src_leaves[i].parent_branch_index - source.first_branch);
+            }
+        }
+    }
+}
+
+void CompactForest::updateGrowth(float time) {
+    // Work in each tree's quantized time units, so the pass reads only the
+    // 20-byte records and writes one byte per element
+    for (const CompactTreeRange& tree : trees) {
+        float t = (tree.time_scale > 0.0f) ? time / tree.time_scale : QUANT_STEPS;
+        CompactBranch* branch = branches.data() + tree.first_branch;
+        for (int i = 0; i < tree.branch_count; i++, branch++) {
+            float since = t - branch->start_time;
+            float progress = (branch->growth_duration > 0) ? since / branch->growth_duration : (since >= 0.0f ? 1.0f : 0.0f);
+            branch->growth_progress = quantizeProgress(progress);
+        }
+        CompactLeaf* leaf = leaves.data() + tree.first_leaf;
+        for (int i = 0; i < tree.leaf_count; i++, leaf++) {
+            float since = t - leaf->start_time;
+            float progress = (leaf->growth_duration > 0) ? since / leaf->growth_duration : (since >= 0.0f ? 1.0f : 0.0f);
+            leaf->growth_progress = quantizeProgress(progress);
+        }
+    }
+}
+
+void CompactForest::expandTree(int k, std::vector<TreeBranch>& out_branches, std::vector<TreeLeaf>& out_leaves,
+                               std::vector<int>& out_child_indices) const {
+    const CompactTreeRange& tree = trees[k];
+    out_branches.resize(tree.branch_count);
+    out_leaves.resize(tree.leaf_count);
+    auto parentAt = [&](int i) -> int {
+        return (tree.parent_bits == 16) ? parents16[tree.first_parent + i] : static_cast<int>(parents32[tree.first_parent + i]);
+    };
+    
+    for (int i = 0; i < tree.branch_count; i++) {
+        const CompactBranch& in = branches[tree.first_branch + i];
+        TreeBranch& branch = out_branches[i];
+        branch.start = dequantize(in.start, tree);
+        branch.end = dequantize(in.end, tree);
+        branch.radius = in.radius * tree.radius_scale;
+        branch.generation = in.generation;
+        branch.growth_progress = in.growth_progress / 255.0f;
+        branch.parent_index = parentAt(i) - 1;
+        branch.start_time = in.start_time * tree.time_scale;
+        branch.growth_duration = in.growth_duration * tree.time_scale;
+        branch.child_count = 0;
+    }
+    for (int i = 0; i < tree.leaf_count; i++) {
+        const CompactLeaf& in = leaves[tree.first_leaf + i];
+        TreeLeaf& leaf = out_leaves[i];
+        leaf.position = dequantize(in.position, tree);
+        leaf.normal = decodeNormal(in.normal);
+        leaf.size = in.size * tree.leaf_size_scale;
+        leaf.growth_progress = in.growth_progress / 255.0f;
+        leaf.parent_branch_index = parentAt(tree.branch_count + i);
+        leaf.spawn_delay = 0.0f;
+        leaf.start_time = in.start_time * tree.time_scale;
+        leaf.growth_duration = in.growth_duration * tree.time_scale;
+    }
+    
+    // Child adjacency as Tree::buildChildAdjacency lays it out: slices in
+    // branch order, children ascending
+    for (const TreeBranch& branch : out_branches) {
+        if (branch.parent_index >= 0) out_branches[branch.parent_index].child_count++;
+    }
+    int offset = 0;
+    for (TreeBranch& branch : out_branches) {
+        branch.first_child = offset;
+        offset += branch.child_count;
+    }
+    out_child_indices.assign(offset, -1);
+    std::vector<int> fill(tree.branch_count, 0);
+    for (int i = 0; i < tree.branch_count; i++) {
+        int parent = out_branches[i].parent_index;
+        if (parent >= 0) {
+            out_child_indices[out_branches[parent].first_child + fill[parent]++] = i;
+        }
+    }
+}
+
+size_t CompactForest::getMemoryBytes() const {
+    return branches.size() * sizeof(CompactBranch) + leaves.size() * sizeof(CompactLeaf) +
+           parents16.size() * sizeof(uint16_t) + parents32.size() * sizeof(uint32_t) +
+           trees.size() * sizeof(CompactTreeRange) + twig_instances.size() * sizeof(TwigInstance);
+}
@@ -0,0 +1,96 @@
+#ifndef TREE_COMPACT_H
+#define TREE_COMPACT_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "tree_simple.h"
+
+struct Forest;
+
+// Quantized branch: 20 bytes instead of TreeBranch's 56. Positions are
+// 16-bit fractions of the tree's bounding box, radius and times 16-bit
+// fractions of the tree's largest; the parent index lives in the tree's
+// parent stream and the child adjacency is derived from it on expansion
+struct CompactBranch {
+    uint16_t start[3];
+    uint16_t end[3];
+    uint16_t radius;
+    uint16_t start_time;
+    uint16_t growth_duration;
+    uint8_t generation;      // Clamped to 255
+    uint8_t growth_progress; // 0..255
+};
+
+// Quantized leaf: 16 bytes instead of TreeLeaf's 48, the normal
+// octahedron-encoded in two signed bytes. spawn_delay is not kept; it is
+// already folded into start_time
+struct CompactLeaf {
+    uint16_t position[3];
+    uint16_t normal;
+    uint16_t size;
+    uint16_t start_time;
+    uint16_t growth_duration;
+    uint8_t growth_progress;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(CompactBranch) == 20, "CompactBranch must stay tightly packed");
+static_assert(sizeof(CompactLeaf) == 16, "CompactLeaf must stay tightly packed");
+
+// One tree of a compact forest: its element ranges and the scales that map
+// its quantized values back. Parent indices are tree-local and stored 16 bits
+// wide when the tree has fewer than 65536 branches, 32 bits otherwise:
+// branch_count branch parents (local index + 1, 0 for the trunk) followed by
+// leaf_count leaf parents, from first_parent in parents16 or parents32
+struct CompactTreeRange {
+    int first_branch;
+    int branch_count;
+    int first_leaf;
+    int leaf_count;
+    int first_twig;
+    int twig_count;
+    int first_parent;
+    int parent_bits; // 16 or 32
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_scale; // Per unit of the 16-bit position
+    float radius_scale;
+    float leaf_size_scale;
+    float time_scale;
+    uint64_t seed;
+    glm::mat4 transform;
+};
+
+// A Forest in roughly 2.5x less memory, for keeping many trees resident;
+// updateGrowth streams through the quantized records and expandTree gives
+// back one full-precision tree. Quantization error is half a step: 1/131070
+// of the tree's extent per axis, of its largest radius and of its schedule;
+// leaf normals are within about a degree
+struct CompactForest {
+    std::vector<CompactBranch> branches;
+    std::vector<CompactLeaf> leaves;
+    std::vector<uint16_t> parents16;
+    std::vector<uint32_t> parents32;
+    std::vector<CompactTreeRange> trees;
+    std::shared_ptr<const TwigLibrary> twig_library;
+    std::vector<TwigInstance> twig_instances; // Kept as they are; few per tree
+    
+    // Replace the contents with a quantized copy of forest
+    void assign(const Forest& forest);
+    void clear();
+    
+    // Set every element's progress for the trees' common growth time
+    void updateGrowth(float time);
+    
+    // Tree k in full precision with tree-local indices, as Tree::getBranches /
+    // getLeaves / the child adjacency of a generated tree
+    void expandTree(int k, std::vector<TreeBranch>& out_branches, std::vector<TreeLeaf>& out_leaves,
+                    std::vector<int>& out_child_indices) const;
+    
+    int getTreeCount() const { return trees.size(); }
+    size_t getMemoryBytes() const;
+};
+
+#endif // TREE_COMPACT_H
@@ -0,0 +1,247 @@
+#include "tree_delta.h"
+#include "tree_simple.h"
+#include <cmath>
+#include <cstring>
+
+// === ENCODING ===
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80u) {
+        out.push_back((uint8_t)(value | 0x80u));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static void putFloat(std::vector<uint8_t>& out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int shift = 0; shift < 32; shift += 8) out.push_back((uint8_t)(bits >> shift));
+}
+
+bool encodeTreeDelta(const Tree& tree, uint32_t from_sequence, std::vector<uint8_t>& out, std::string& error) {
+    const uint32_t first = tree.getFirstEditSequence();
+    const uint32_t to_sequence = tree.getEditSequence();
+    if (from_sequence < first || from_sequence > to_sequence) {
+        error = "the edit log holds edits " + std::to_string(first) + " to " + std::to_string(to_sequence) +
+                ", not from " + std::to_string(from_sequence);
+        return false;
+    }
+    out.assign(TREE_DELTA_MAGIC, TREE_DELTA_MAGIC + 4);
+    putVarint(out, TREE_DELTA_VERSION);
+    putVarint(out, TREE_GENERATOR_VERSION);
+    putVarint(out, tree.getSeed());
+    putVarint(out, from_sequence);
+    putVarint(out, to_sequence - from_sequence);
+    putFloat(out, tree.getGrowthTime());
+    
+    const std::vector<TreeEdit>& edits = tree.getEdits();
+    for (size_t i = from_sequence - first; i < edits.size(); i++) {
+        const TreeEdit& edit = edits[i];
+        out.push_back((uint8_t)edit.type);
+        switch (edit.type) {
+            case TreeEditType::Prune:
+                putVarint(out, edit.branch_index);
+                break;
+            case TreeEditType::Regrow:
+                putVarint(out, edit.branch_index);
+                putVarint(out, edit.seed);
+                putFloat(out, edit.time);
+                break;
+            case TreeEditType::Parameters:
+                putVarint(out, zigzag(edit.parameters.max_generations));
+                putFloat(out, edit.parameters.branch_angle_variance);
+                putFloat(out, edit.parameters.length_reduction_factor);
+                putFloat(out, edit.parameters.radius_reduction_factor);
+                putFloat(out, edit.parameters.max_growth_time);
+                break;
+        }
+        putVarint(out, edit.branch_count);
+        putVarint(out, edit.leaf_count);
+    }
+    return true;
+}
+
+// === DECODING ===
+
+// Never past end; false for a truncated or overlong value
+static bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p == end) return false;
+        const uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7fu) << shift;
+        if (byte < 0x80u) return true;
+    }
+    return false;
+}
+
+static bool getInt(const uint8_t*& p, const uint8_t* end, int& value) {
+    uint64_t raw;
+    if (!getVarint(p, end, raw) || raw > (uint64_t)INT32_MAX) return false;
+    value = (int)raw;
+    return true;
+}
+
+static bool getFloat(const uint8_t*& p, const uint8_t* end, float& value) {
+    if (end - p < 4) return false;
+    const uint32_t bits = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    memcpy(&value, &bits, sizeof(value));
+    p += 4;
+    return true;
+}
+
+// Growth times seek the tree; NaN or negative ones are damage
+static bool isTime(float time) {
+    return std::isfinite(time) && time >= 0.0f;
+}
+
+struct TreeDeltaHeader {
+    uint64_t generator_version;
+    uint64_t seed;
+    uint32_t from_sequence;
+    uint32_t edit_count;
+    float growth_time;
+};
+
+static bool readHeader(const uint8_t*& p, const uint8_t* end, TreeDeltaHeader& header) {
+    uint64_t version, from_sequence, edit_count;
+    if (end - p < 4 || memcmp(p, TREE_DELTA_MAGIC, 4) != 0) return false;
+    p += 4;
+    if (!getVarint(p, end, version) || version != TREE_DELTA_VERSION) return false;
+    if (!getVarint(p, end, header.generator_version) || !getVarint(p, end, header.seed) ||
+        !getVarint(p, end, from_sequence) || !getVarint(p, end, edit_count) ||
+        !getFloat(p, end, header.growth_time)) {
+        return false;
+    }
+    if (from_sequence + edit_count > UINT32_MAX || !isTime(header.growth_time)) return false;
+    header.from_sequence = (uint32_t)from_sequence;
+    header.edit_count = (uint32_t)edit_count;
+    return true;
+}
+
+static bool readEdit(const uint8_t*& p, const uint8_t* end, TreeEdit& edit) {
+    if (p == end) return false;
+    edit = TreeEdit();
+    edit.type = (TreeEditType)*p++;
+    switch (edit.type) {
+        case TreeEditType::Prune:
+            if (!getInt(p, end, edit.branch_index)) return false;
+            break;
+        case TreeEditType::Regrow:
+            if (!getInt(p, end, edit.branch_index) || !getVarint(p, end, edit.seed) || !getFloat(p, end, edit.time) ||
+                !isTime(edit.time)) {
+                return false;
+            }
+            break;
+        case TreeEditType::Parameters: {
+            uint64_t generations;
+            if (!getVarint(p, end, generations) || !getFloat(p, end, edit.parameters.branch_angle_variance) ||
+                !getFloat(p, end, edit.parameters.length_reduction_factor) ||
+                !getFloat(p, end, edit.parameters.radius_reduction_factor) ||
+                !getFloat(p, end, edit.parameters.max_growth_time)) {
+                return false;
+            }
+            edit.parameters.max_generations = (int)((generations >> 1) ^ (0u - (generations & 1u)));
+            break;
+        }
+        default:
+            return false;
+    }
+    return getInt(p, end, edit.branch_count) && getInt(p, end, edit.leaf_count);
+}
+
+bool readTreeDeltaRange(const void* bytes, size_t byte_count, uint32_t& from_sequence, uint32_t& to_sequence) {
+    const uint8_t* p = static_cast<const uint8_t*>(bytes);
+    TreeDeltaHeader header;
+    if (!readHeader(p, p + byte_count, header)) return false;
+    from_sequence = header.from_sequence;
+    to_sequence = header.from_sequence + header.edit_count;
+    return true;
+}
+
+// === APPLYING ===
+
+bool applyTreeDelta(Tree& tree, const void* bytes, size_t byte_count, std::string& error) {
+    const uint8_t* p = static_cast<const uint8_t*>(bytes);
+    const uint8_t* end = p + byte_count;
+    TreeDeltaHeader header;
+    if (!readHeader(p, end, header)) {
+        error = "not a tree delta, or a damaged one";
+        return false;
+    }
+    if (header.generator_version != TREE_GENERATOR_VERSION) {
+        error = "delta from another generator version";
+        return false;
+    }
+    if (header.seed != tree.getSeed()) {
+        error = "delta for another tree (seed " + std::to_string(header.seed) + ")";
+        return false;
+    }
+    if (header.from_sequence != tree.getEditSequence()) {
+        error = "delta from edit " + std::to_string(header.from_sequence) + ", the tree is at edit " +
+                std::to_string(tree.getEditSequence());
+        return false;
+    }
+    
+    // The whole stream is read before the tree is touched; a record is at
+    // least three bytes, which bounds the count a damaged header can claim
+    if (header.edit_count > (size_t)(end - p) / 3) {
+        error = "damaged tree delta";
+        return false;
+    }
+    std::vector<TreeEdit> edits(header.edit_count);
+    for (TreeEdit& edit : edits) {
+        if (!readEdit(p, end, edit)) {
+            error = "damaged tree delta";
+            return false;
+        }
+        if (edit.type == TreeEditType::Parameters) {
+            const std::string parameters_error = checkTreeParameters(edit.parameters, TREE_MAX_GENERATIONS);
+            if (!parameters_error.empty()) {
+                error = "damaged tree delta: " + parameters_error;
+                return false;
+            }
+        }
+    }
+    if (p != end) {
+        error = "damaged tree delta";
+        return false;
+    }
+    
+    for (size_t i = 0; i < edits.size(); i++) {
+        const TreeEdit& edit = edits[i];
+        bool made = true;
+        switch (edit.type) {
+            case TreeEditType::Prune:
+                made = tree.pruneBranch(edit.branch_index);
+                break;
+            case TreeEditType::Regrow:
+                made = tree.regenerateSubtree(edit.branch_index, edit.seed, edit.time);
+                break;
+            case TreeEditType::Parameters:
+                tree.setParameters(edit.parameters);
+                break;
+        }
+        const uint32_t sequence = header.from_sequence + (uint32_t)i;
+        if (!made) {
+            error = "edit " + std::to_string(sequence) + " failed on this tree; it needs a new snapshot";
+            return false;
+        }
+        if (tree.getBranchCount() != edit.branch_count || tree.getLeafCount() != edit.leaf_count) {
+            error = "edit " + std::to_string(sequence) + " left " + std::to_string(tree.getBranchCount()) +
+                    " branches and " + std::to_string(tree.getLeafCount()) + " leaves, not " +
+                    std::to_string(edit.branch_count) + " and " + std::to_string(edit.leaf_count) +
+                    "; the tree needs a new snapshot";
+            return false;
+        }
+    }
+    if (tree.getGrowthTime() != header.growth_time) {
+        tree.setGrowthTime(header.growth_time);
+    }
+    return true;
+}
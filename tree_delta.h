@@ -0,0 +1,56 @@
+#ifndef TREE_DELTA_H
+#define TREE_DELTA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Tree;
+
+// Compact deltas that keep copies of a tree in step with the original's
+// edits (a shared session where anyone prunes or regrows), without sending
+// the tree again: a delta carries the edits of the original's log
+// (Tree::getEdits) from a sequence number on, and its growth time.
+//
+// A copy starts from a snapshot, the original's asset (Tree::save) loaded
+// and numbered by Tree::restartEdits with the sequence it was saved at,
+// and applies each delta against that base through the tree's own edit
+// paths: pruneBranch tombstones the cut subtree's slots and
+// regenerateSubtree grows the same subtree from the same seed and time
+// into recycled ones, so only the edited slots go up as dirty ranges. The
+// copy logs the edits as it makes them and ends at the original's
+// sequence, ready for the next delta or to pass this one on.
+//
+// A regrown subtree is sent as its seed, not its elements, so a delta's
+// size and cost follow the number of edits, whatever they grow: a prune
+// is under 10 bytes, a regrowth or a parameter change about 25. The
+// stream is a small header (magic, format, the tree's seed, the base and
+// end sequences and the growth time) then one record per edit, with the
+// element counts the edit left on the original; integers as little-endian
+// base-128 varints, floats as their four bytes. Copies must be grown by
+// the same build (TREE_GENERATOR_VERSION), with the same branch layout and
+// twig settings (both in the asset) and without lazy detail
+// (Tree::setLazyDetail), which renames elements by view
+
+static const char TREE_DELTA_MAGIC[4] = {'T', 'D', 'L', '1'};
+static const uint32_t TREE_DELTA_VERSION = 1;
+
+// tree's edits from from_sequence up to its current one, and its growth
+// time, into out, replacing its contents. False with error set when the
+// log no longer holds them (Tree::trimEdits) or doesn't reach that far
+bool encodeTreeDelta(const Tree& tree, uint32_t from_sequence, std::vector<uint8_t>& out, std::string& error);
+
+// The base and end sequences of a delta; false when its header is damaged
+bool readTreeDeltaRange(const void* bytes, size_t byte_count, uint32_t& from_sequence, uint32_t& to_sequence);
+
+// Make a delta's edits on tree, which must be the same tree at the
+// delta's base sequence, then seek it to the delta's growth time (a rewind
+// re-evaluates the whole tree, Tree::setGrowthTime). False with error set
+// for a damaged delta (parameters out of checkTreeParameters' bounds and
+// negative or non-finite times included) or another tree or base, with
+// the tree untouched, or when an edit fails or leaves other element counts than it did on the
+// original: the copies have diverged, and the tree needs a new snapshot
+bool applyTreeDelta(Tree& tree, const void* bytes, size_t byte_count, std::string& error);
+
+#endif // TREE_DELTA_H
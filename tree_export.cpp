@@ -0,0 +1,487 @@
+#include "tree_export.h"
+#include "tree_forest.h"
+#include "tree_snapshot.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cmath>
+#include <cstring>
+
+// Tubes as the branch instances draw them
+static const int TUBE_SEGMENTS = Tree::BRANCH_RING_VERTICES - 1;
+static const float TIP_RADIUS = 0.7f;
+
+// The OBJ buffer is written out whenever it grows past this
+static const size_t OBJ_FLUSH_BYTES = 1 << 20;
+
+// glTF constants
+static const int GLTF_FLOAT = 5126;
+static const int GLTF_UNSIGNED_INT = 5125;
+static const int GLTF_ARRAY_BUFFER = 34962;
+static const int GLTF_ELEMENT_ARRAY_BUFFER = 34963;
+static const uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+static const uint32_t GLB_JSON_CHUNK = 0x4E4F534A; // "JSON"
+static const uint32_t GLB_BIN_CHUNK = 0x004E4942;  // "BIN\0"
+
+// === SOURCES ===
+
+TreeExportSource treeExportSource(const Tree& tree, const glm::mat4& transform) {
+    TreeExportSource source;
+    source.branches = tree.getBranches().data();
+    source.branch_count = tree.getBranchCount();
+    source.leaves = tree.getLeaves().data();
+    source.leaf_count = tree.getLeafCount();
+    source.twig_library = tree.getTwigLibrary().get();
+    source.twigs = tree.getTwigInstances().data();
+    source.twig_count = tree.getTwigInstances().size();
+    source.transform = transform;
+    return source;
+}
+
+TreeExportSource snapshotExportSource(const TreeSnapshot& snapshot, const glm::mat4& transform) {
+    const TreeSnapshotLayout& layout = *snapshot.layout;
+    TreeExportSource source;
+    source.branches = layout.branches.data();
+    source.branch_count = layout.branches.size();
+    source.leaves = layout.leaves.data();
+    source.leaf_count = layout.leaves.size();
+    source.twig_library = layout.twig_library.get();
+    source.twigs = layout.twig_instances.data();
+    source.twig_count = layout.twig_instances.size();
+    source.transform = transform;
+    return source;
+}
+
+TreeExportSource forestExportSource(const Forest& forest, int index) {
+    const ForestTreeRange& range = forest.trees[index];
+    TreeExportSource source;
+    source.branches = forest.branches.data() + range.first_branch;
+    source.branch_count = range.branch_count;
+    source.leaves = forest.leaves.data() + range.first_leaf;
+    source.leaf_count = range.leaf_count;
+    source.twig_library = forest.twig_library.get();
+    source.twigs = forest.twig_instances.data() + range.first_twig;
+    source.twig_count = range.twig_count;
+    source.transform = range.transform;
+    return source;
+}
+
+// === MESHING ===
+
+// Writes a tree-space vertex in the exported space
+struct ExportTransform {
+    glm::mat4 transform;
+    glm::mat3 normal_matrix;
+    bool flip_v;
+    
+    float* vertex(float* out, const glm::vec3& position, const glm::vec3& normal, float u, float v) const {
+        glm::vec3 p = glm::vec3(transform * glm::vec4(position, 1.0f));
+        glm::vec3 n = glm::normalize(normal_matrix * normal);
+        out[0] = p.x; out[1] = p.y; out[2] = p.z;
+        out[3] = n.x; out[4] = n.y; out[5] = n.z;
+        out[6] = u; out[7] = flip_v ? 1.0f - v : v;
+        return out + EXPORT_VERTEX_FLOATS;
+    }
+};
+
+// One prototype range's vertices: its indices all fall in [first, last]
+struct TwigVertexRange {
+    uint32_t first;
+    uint32_t last;
+};
+
+static TwigVertexRange twigRange(const TwigLibrary& library, int first_index, int count) {
+    TwigVertexRange range = { 0xFFFFFFFFu, 0 };
+    for (int i = 0; i < count; i++) {
+        range.first = std::min<uint32_t>(range.first, library.indices[first_index + i]);
+        range.last = std::max<uint32_t>(range.last, library.indices[first_index + i]);
+    }
+    return range;
+}
+
+// Append one placed copy of library range [first_index, first_index +
+// count) and its vertices; the library's wood winds inward, so its
+// triangles turn when reverse is set
+static void appendTwig(const ExportTransform& place, const TwigLibrary& library, const TwigInstance& twig,
+                       int first_index, int count, const TwigVertexRange& range, bool reverse,
+                       std::vector<float>& vertices, std::vector<uint32_t>& indices) {
+    if (count == 0) return;
+    const uint32_t base = vertices.size() / EXPORT_VERTEX_FLOATS;
+    const size_t vertex_count = range.last - range.first + 1;
+    vertices.resize(vertices.size() + vertex_count * EXPORT_VERTEX_FLOATS);
+    float* out = &vertices[base * EXPORT_VERTEX_FLOATS];
+    const glm::mat3 axes(twig.axis_x, twig.axis_y, twig.axis_z);
+    for (uint32_t v = range.first; v <= range.last; v++) {
+        const float* in = &library.vertices[v * Tree::VERTEX_FLOATS];
+        glm::vec3 position = twig.origin + axes * glm::vec3(in[0], in[1], in[2]);
+        out = place.vertex(out, position, axes * glm::vec3(in[6], in[7], in[8]), in[4], in[5]);
+    }
+    for (int i = 0; i < count; i += 3) {
+        const uint32_t* triangle = &library.indices[first_index + i];
+        indices.push_back(base + triangle[0] - range.first);
+        indices.push_back(base + triangle[reverse ? 2 : 1] - range.first);
+        indices.push_back(base + triangle[reverse ? 1 : 2] - range.first);
+    }
+}
+
+void meshTreeForExport(const TreeExportSource& tree, bool flip_v, TreeExportMesh& mesh) {
+    ExportTransform place;
+    place.transform = tree.transform;
+    place.normal_matrix = glm::transpose(glm::inverse(glm::mat3(tree.transform)));
+    place.flip_v = flip_v;
+    mesh.wood_vertices.clear();
+    mesh.wood_indices.clear();
+    mesh.leaf_vertices.clear();
+    mesh.leaf_indices.clear();
+    
+    // === WOOD ===
+    // Two rings a branch, the first vertex of each repeated so the bark
+    // wraps; quads wind outward
+    const int ring_vertices = TUBE_SEGMENTS + 1;
+    const glm::vec2* circle = Tree::ringUnitCircle(TUBE_SEGMENTS);
+    mesh.wood_vertices.reserve((size_t)tree.branch_count * 2 * ring_vertices * EXPORT_VERTEX_FLOATS);
+    mesh.wood_indices.reserve((size_t)tree.branch_count * 6 * TUBE_SEGMENTS);
+    for (int b = 0; b < tree.branch_count; b++) {
+        const TreeBranch& branch = tree.branches[b];
+        glm::vec3 axis = branch.end - branch.start;
+        if (glm::length(axis) <= 0.0f) continue;
+        glm::vec3 direction = glm::normalize(axis);
+        glm::vec3 up = (std::abs(direction.y) > 0.9f) ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+        glm::vec3 right = glm::normalize(glm::cross(direction, up));
+        up = glm::normalize(glm::cross(right, direction));
+        
+        const uint32_t start_ring = mesh.wood_vertices.size() / EXPORT_VERTEX_FLOATS;
+        const uint32_t end_ring = start_ring + ring_vertices;
+        mesh.wood_vertices.resize(mesh.wood_vertices.size() + 2 * ring_vertices * EXPORT_VERTEX_FLOATS);
+        float* out = &mesh.wood_vertices[start_ring * EXPORT_VERTEX_FLOATS];
+        for (int ring = 0; ring < 2; ring++) {
+            glm::vec3 center = (ring == 0) ? branch.start : branch.end;
+            float radius = (ring == 0) ? branch.radius : branch.radius * TIP_RADIUS;
+            for (int i = 0; i < ring_vertices; i++) {
+                glm::vec3 radial = right * circle[i].x + up * circle[i].y;
+                out = place.vertex(out, center + radial * radius, radial, (float)i / TUBE_SEGMENTS, (float)ring);
+            }
+        }
+        for (int i = 0; i < TUBE_SEGMENTS; i++) {
+            uint32_t p1 = start_ring + i;
+            uint32_t p3 = end_ring + i;
+            uint32_t quad[] = { p1, p3, p1 + 1, p1 + 1, p3, p3 + 1 };
+            mesh.wood_indices.insert(mesh.wood_indices.end(), quad, quad + 6);
+        }
+    }
+    
+    // === LEAVES ===
+    // One quad each, facing along the leaf's normal; the material is two-sided
+    mesh.leaf_vertices.reserve((size_t)tree.leaf_count * 4 * EXPORT_VERTEX_FLOATS);
+    mesh.leaf_indices.reserve((size_t)tree.leaf_count * 6);
+    for (int l = 0; l < tree.leaf_count; l++) {
+        const TreeLeaf& leaf = tree.leaves[l];
+        glm::vec3 right = glm::cross(leaf.normal, glm::vec3(0, 1, 0));
+        right = (glm::length(right) < 0.01f) ? glm::vec3(1, 0, 0) : glm::normalize(right);
+        glm::vec3 up = glm::normalize(glm::cross(right, leaf.normal));
+        right *= leaf.size * 0.5f;
+        up *= leaf.size * 0.5f;
+        
+        const uint32_t base = mesh.leaf_vertices.size() / EXPORT_VERTEX_FLOATS;
+        mesh.leaf_vertices.resize(mesh.leaf_vertices.size() + 4 * EXPORT_VERTEX_FLOATS);
+        float* out = &mesh.leaf_vertices[base * EXPORT_VERTEX_FLOATS];
+        out = place.vertex(out, leaf.position - right - up, leaf.normal, 0.0f, 0.0f);
+        out = place.vertex(out, leaf.position + right - up, leaf.normal, 1.0f, 0.0f);
+        out = place.vertex(out, leaf.position + right + up, leaf.normal, 1.0f, 1.0f);
+        out = place.vertex(out, leaf.position - right + up, leaf.normal, 0.0f, 1.0f);
+        uint32_t quad[] = { base, base + 2, base + 1, base, base + 3, base + 2 };
+        mesh.leaf_indices.insert(mesh.leaf_indices.end(), quad, quad + 6);
+    }
+    
+    // === TWIGS ===
+    if (!tree.twig_library || tree.twig_count == 0) return;
+    const TwigLibrary& library = *tree.twig_library;
+    std::vector<TwigVertexRange> wood_ranges, leaf_ranges;
+    for (const TwigPrototype& prototype : library.prototypes) {
+        wood_ranges.push_back(twigRange(library, prototype.first_wood_index, prototype.wood_index_count));
+        leaf_ranges.push_back(twigRange(library, prototype.first_leaf_index, prototype.leaf_index_count));
+    }
+    for (int t = 0; t < tree.twig_count; t++) {
+        const TwigInstance& twig = tree.twigs[t];
+        const TwigPrototype& prototype = library.prototypes[twig.prototype];
+        appendTwig(place, library, twig, prototype.first_wood_index, prototype.wood_index_count,
+                   wood_ranges[twig.prototype], true, mesh.wood_vertices, mesh.wood_indices);
+        appendTwig(place, library, twig, prototype.first_leaf_index, prototype.leaf_index_count,
+                   leaf_ranges[twig.prototype], false, mesh.leaf_vertices, mesh.leaf_indices);
+    }
+}
+
+// === BINARY GLTF ===
+
+static void appendFormat(std::string& out, const char* format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length > 0) out.append(text, std::min<size_t>(length, sizeof(text) - 1));
+}
+
+// One primitive's views and accessors, the vertices at offset of the
+// buffer and the indices right after them
+static void appendPrimitiveViews(std::string& views, std::string& accessors, int view, size_t offset,
+                                 const std::vector<float>& vertices, const std::vector<uint32_t>& indices) {
+    const size_t vertex_count = vertices.size() / EXPORT_VERTEX_FLOATS;
+    const size_t vertex_bytes = vertices.size() * sizeof(float);
+    glm::vec3 low(vertices[0], vertices[1], vertices[2]);
+    glm::vec3 high = low;
+    for (size_t v = 0; v < vertex_count; v++) {
+        glm::vec3 p(vertices[v * EXPORT_VERTEX_FLOATS], vertices[v * EXPORT_VERTEX_FLOATS + 1],
+                    vertices[v * EXPORT_VERTEX_FLOATS + 2]);
+        low = glm::min(low, p);
+        high = glm::max(high, p);
+    }
+    if (!views.empty()) views += ",";
+    appendFormat(views, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"byteStride\":%d,\"target\":%d},",
+                 offset, vertex_bytes, (int)(EXPORT_VERTEX_FLOATS * sizeof(float)), GLTF_ARRAY_BUFFER);
+    appendFormat(views, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":%d}",
+                 offset + vertex_bytes, indices.size() * sizeof(uint32_t), GLTF_ELEMENT_ARRAY_BUFFER);
+    
+    if (!accessors.empty()) accessors += ",";
+    appendFormat(accessors, "{\"bufferView\":%d,\"byteOffset\":0,\"componentType\":%d,\"count\":%zu,\"type\":\"VEC3\","
+                 "\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},", view, GLTF_FLOAT, vertex_count,
+                 low.x, low.y, low.z, high.x, high.y, high.z);
+    appendFormat(accessors, "{\"bufferView\":%d,\"byteOffset\":12,\"componentType\":%d,\"count\":%zu,\"type\":\"VEC3\"},",
+                 view, GLTF_FLOAT, vertex_count);
+    appendFormat(accessors, "{\"bufferView\":%d,\"byteOffset\":24,\"componentType\":%d,\"count\":%zu,\"type\":\"VEC2\"},",
+                 view, GLTF_FLOAT, vertex_count);
+    appendFormat(accessors, "{\"bufferView\":%d,\"byteOffset\":0,\"componentType\":%d,\"count\":%zu,\"type\":\"SCALAR\"}",
+                 view + 1, GLTF_UNSIGNED_INT, indices.size());
+}
+
+bool exportGlb(const TreeExportSource& tree, const std::string& path, std::string& error) {
+    TreeExportMesh mesh;
+    meshTreeForExport(tree, true, mesh);
+    return writeGlb(mesh, path, error);
+}
+
+bool writeGlb(const TreeExportMesh& mesh, const std::string& path, std::string& error) {
+    // === JSON ===
+    // The wood's and then the leaves' vertices and indices, back to back in
+    // the binary chunk; every piece is a multiple of 4 bytes, so no padding
+    const std::vector<float>* vertices[2] = { &mesh.wood_vertices, &mesh.leaf_vertices };
+    const std::vector<uint32_t>* indices[2] = { &mesh.wood_indices, &mesh.leaf_indices };
+    std::string primitives, views, accessors;
+    size_t buffer_bytes = 0;
+    int view = 0;
+    for (int part = 0; part < 2; part++) {
+        if (indices[part]->empty()) continue;
+        appendPrimitiveViews(views, accessors, view, buffer_bytes, *vertices[part], *indices[part]);
+        if (!primitives.empty()) primitives += ",";
+        int accessor = 2 * view;
+        appendFormat(primitives, "{\"attributes\":{\"POSITION\":%d,\"NORMAL\":%d,\"TEXCOORD_0\":%d},"
+                     "\"indices\":%d,\"material\":%d}", accessor, accessor + 1, accessor + 2, accessor + 3, part);
+        buffer_bytes += vertices[part]->size() * sizeof(float) + indices[part]->size() * sizeof(uint32_t);
+        view += 2;
+    }
+    if (primitives.empty()) {
+        error = "the tree has no branches or leaves";
+        return false;
+    }
+    
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"tree_demo\"},\"scene\":0,"
+                       "\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0,\"name\":\"tree\"}],"
+                       "\"meshes\":[{\"name\":\"tree\",\"primitives\":[" + primitives + "]}],"
+                       "\"materials\":["
+                       "{\"name\":\"bark\",\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":0},"
+                       "\"metallicFactor\":0,\"roughnessFactor\":1}},"
+                       "{\"name\":\"leaf\",\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":1},"
+                       "\"metallicFactor\":0,\"roughnessFactor\":1},"
+                       "\"alphaMode\":\"MASK\",\"alphaCutoff\":0.5,\"doubleSided\":true}],"
+                       "\"textures\":[{\"source\":0,\"sampler\":0},{\"source\":1,\"sampler\":0}],"
+                       "\"images\":[{\"uri\":\"bark.png\"},{\"uri\":\"leaf.png\"}],"
+                       "\"samplers\":[{\"magFilter\":9729,\"minFilter\":9987,\"wrapS\":10497,\"wrapT\":10497}],";
+    appendFormat(json, "\"buffers\":[{\"byteLength\":%zu}],", buffer_bytes);
+    json += "\"bufferViews\":[" + views + "],\"accessors\":[" + accessors + "]}";
+    json.append((4 - json.size() % 4) % 4, ' ');
+    
+    // === FILE ===
+    // Header and chunk headers, then each array from where it was meshed
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        error = path + ": " + strerror(errno);
+        return false;
+    }
+    uint32_t header[5] = { GLB_MAGIC, 2, (uint32_t)(12 + 8 + json.size() + 8 + buffer_bytes),
+                           (uint32_t)json.size(), GLB_JSON_CHUNK };
+    uint32_t bin_header[2] = { (uint32_t)buffer_bytes, GLB_BIN_CHUNK };
+    bool written = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(json.data(), json.size(), 1, file) == 1 &&
+                   fwrite(bin_header, sizeof(bin_header), 1, file) == 1;
+    for (int part = 0; part < 2 && written; part++) {
+        if (indices[part]->empty()) continue;
+        written = fwrite(vertices[part]->data(), sizeof(float), vertices[part]->size(), file) == vertices[part]->size() &&
+                  fwrite(indices[part]->data(), sizeof(uint32_t), indices[part]->size(), file) == indices[part]->size();
+    }
+    if (fclose(file) != 0) written = false;
+    if (!written) {
+        error = path + ": write failed";
+        return false;
+    }
+    return true;
+}
+
+// === OBJ ===
+
+static void appendUnsigned(std::string& out, size_t value) {
+    char digits[24];
+    int length = 0;
+    do {
+        digits[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (length > 0) out += digits[--length];
+}
+
+// Decimal text without printf: five fractional digits, trailing zeros
+// dropped, which keeps millimetres on trees kilometres from the origin
+static void appendFloat(std::string& out, float value) {
+    if (!(std::abs(value) < 1e12f)) {
+        appendFormat(out, "%g", value);
+        return;
+    }
+    long long fixed = llroundf(value * 100000.0f);
+    if (fixed < 0) {
+        out += '-';
+        fixed = -fixed;
+    }
+    appendUnsigned(out, fixed / 100000);
+    int fraction = fixed % 100000;
+    if (fraction == 0) return;
+    char digits[6] = { '.' };
+    int length = 6;
+    for (int k = 5; k > 0; k--) {
+        digits[k] = '0' + fraction % 10;
+        fraction /= 10;
+    }
+    while (digits[length - 1] == '0') length--;
+    out.append(digits, length);
+}
+
+ObjWriter::ObjWriter() : file(nullptr), failed(false), trees(0), vertices(0), triangles(0), bytes(0) {}
+
+ObjWriter::~ObjWriter() {
+    std::string error;
+    if (file) close(error);
+}
+
+bool ObjWriter::open(const std::string& path, std::string& error) {
+    std::string error_ignored;
+    if (file) close(error_ignored);
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    std::string library = ((dot != std::string::npos && (slash == std::string::npos || dot > slash))
+                           ? path.substr(0, dot) : path) + ".mtl";
+    FILE* materials = fopen(library.c_str(), "w");
+    if (!materials) {
+        error = library + ": " + strerror(errno);
+        return false;
+    }
+    fputs("newmtl bark\nKd 1 1 1\nmap_Kd bark.png\n\n"
+          "newmtl leaf\nKd 1 1 1\nmap_Kd leaf.png\nmap_d leaf.png\n", materials);
+    if (fclose(materials) != 0) {
+        error = library + ": write failed";
+        return false;
+    }
+    
+    file = fopen(path.c_str(), "w");
+    if (!file) {
+        error = path + ": " + strerror(errno);
+        return false;
+    }
+    failed = false;
+    trees = vertices = triangles = bytes = 0;
+    buffer.clear();
+    buffer.reserve(OBJ_FLUSH_BYTES + OBJ_FLUSH_BYTES / 4);
+    buffer += "mtllib ";
+    buffer += library.substr(slash == std::string::npos ? 0 : slash + 1);
+    buffer += '\n';
+    return true;
+}
+
+void ObjWriter::flush() {
+    if (file && !buffer.empty() && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) failed = true;
+    bytes += buffer.size();
+    buffer.clear();
+}
+
+void ObjWriter::add(const TreeExportSource& tree) {
+    if (!file) return;
+    meshTreeForExport(tree, false, mesh);
+    buffer += "o tree_";
+    appendUnsigned(buffer, trees++);
+    buffer += '\n';
+    
+    const std::vector<float>* parts[2] = { &mesh.wood_vertices, &mesh.leaf_vertices };
+    const std::vector<uint32_t>* part_indices[2] = { &mesh.wood_indices, &mesh.leaf_indices };
+    const char* materials[2] = { "bark", "leaf" };
+    for (int part = 0; part < 2; part++) {
+        const std::vector<float>& part_vertices = *parts[part];
+        for (size_t f = 0; f < part_vertices.size(); f += EXPORT_VERTEX_FLOATS) {
+            const float* v = &part_vertices[f];
+            buffer += "v ";
+            appendFloat(buffer, v[0]); buffer += ' ';
+            appendFloat(buffer, v[1]); buffer += ' ';
+            appendFloat(buffer, v[2]);
+            buffer += "\nvn ";
+            appendFloat(buffer, v[3]); buffer += ' ';
+            appendFloat(buffer, v[4]); buffer += ' ';
+            appendFloat(buffer, v[5]);
+            buffer += "\nvt ";
+            appendFloat(buffer, v[6]); buffer += ' ';
+            appendFloat(buffer, v[7]);
+            buffer += '\n';
+            if (buffer.size() >= OBJ_FLUSH_BYTES) flush();
+        }
+        
+        // Position, texcoord and normal share one index, 1-based over the file
+        const std::vector<uint32_t>& indices = *part_indices[part];
+        if (!indices.empty()) {
+            buffer += "usemtl ";
+            buffer += materials[part];
+            buffer += '\n';
+        }
+        const size_t base = vertices + 1;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            buffer += 'f';
+            for (int c = 0; c < 3; c++) {
+                size_t index = base + indices[i + c];
+                buffer += ' ';
+                appendUnsigned(buffer, index);
+                buffer += '/';
+                appendUnsigned(buffer, index);
+                buffer += '/';
+                appendUnsigned(buffer, index);
+            }
+            buffer += '\n';
+            if (buffer.size() >= OBJ_FLUSH_BYTES) flush();
+        }
+        vertices += part_vertices.size() / EXPORT_VERTEX_FLOATS;
+        triangles += indices.size() / 3;
+    }
+}
+
+bool ObjWriter::close(std::string& error) {
+    if (!file) return true;
+    flush();
+    if (fclose(file) != 0) failed = true;
+    file = nullptr;
+    if (failed) {
+        error = "OBJ write failed";
+        return false;
+    }
+    return true;
+}
+
+bool exportForestObj(const Forest& forest, const std::string& path, std::string& error) {
+    ObjWriter writer;
+    if (!writer.open(path, error)) return false;
+    for (size_t t = 0; t < forest.trees.size(); t++) {
+        writer.add(forestExportSource(forest, t));
+    }
+    return writer.close(error);
+}
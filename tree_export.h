@@ -0,0 +1,109 @@
+#ifndef TREE_EXPORT_H
+#define TREE_EXPORT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "tree_simple.h"
+
+struct Forest;
+struct TreeSnapshot;
+
+// Fully grown tree meshes for offline tools: binary glTF (.glb) and
+// Wavefront OBJ. A tree is exported as two primitives, the wood with the
+// bark material (bark.png) and the leaves with the leaf material
+// (leaf.png, alpha-tested and two-sided), meshed from the structure
+// alone: 8-sided tubes tapering to 70% like the branch instances, quads
+// for the leaves and the twig prototypes' meshes placed at each twig. So
+// a tree from generateStructure() or a ForestBuilder batch exports the
+// same as a drawn one, whatever its growth or mesh settings. Wood faces
+// wind counter-clockwise seen from outside.
+//
+// Texture paths are written as they are, relative to the exported file.
+
+// One tree to export: its elements in tree space and where it stands
+struct TreeExportSource {
+    const TreeBranch* branches;
+    int branch_count;
+    const TreeLeaf* leaves;
+    int leaf_count;
+    const TwigLibrary* twig_library; // Null for no twigs
+    const TwigInstance* twigs;
+    int twig_count;
+    glm::mat4 transform;             // Tree space to the exported space
+};
+
+// One tree meshed for export: interleaved position, normal and texcoord,
+// EXPORT_VERTEX_FLOATS floats a vertex, in the exported space
+struct TreeExportMesh {
+    std::vector<float> wood_vertices;
+    std::vector<uint32_t> wood_indices;
+    std::vector<float> leaf_vertices;
+    std::vector<uint32_t> leaf_indices;
+};
+
+static const int EXPORT_VERTEX_FLOATS = 8;
+
+// Mesh tree into mesh, replacing its contents and reusing its storage.
+// glTF's texture V runs down the image, OpenGL's and OBJ's up; flip_v
+// writes glTF's
+void meshTreeForExport(const TreeExportSource& tree, bool flip_v, TreeExportMesh& mesh);
+
+TreeExportSource treeExportSource(const Tree& tree, const glm::mat4& transform = glm::mat4(1.0f));
+// Tree index of a forest batch, at its own transform
+TreeExportSource forestExportSource(const Forest& forest, int index);
+// A tree's snapshot (tree_snapshot.h), for exporting on another thread
+// while the tree goes on updating; the snapshot must be held meanwhile
+TreeExportSource snapshotExportSource(const TreeSnapshot& snapshot, const glm::mat4& transform = glm::mat4(1.0f));
+
+// The tree as one .glb: a single binary buffer holding both primitives'
+// interleaved vertices and indices, written straight from the meshes
+bool exportGlb(const TreeExportSource& tree, const std::string& path, std::string& error);
+// The same for a tree already meshed with flip_v, for callers exporting
+// many through one mesh's storage
+bool writeGlb(const TreeExportMesh& mesh, const std::string& path, std::string& error);
+
+// Streams any number of trees into one OBJ file and its material library
+// (the same path with .mtl), each tree an object with a wood and a leaf
+// group. A tree is meshed into reused scratch and formatted into a reused
+// buffer flushed as it fills, so memory stays at one tree's mesh however
+// large the forest
+class ObjWriter {
+public:
+    ObjWriter();
+    ~ObjWriter();
+    
+    // Create path and its .mtl; false with error set when they can't be
+    // written
+    bool open(const std::string& path, std::string& error);
+    void add(const TreeExportSource& tree);
+    // Flush and close; false with error set if any write failed
+    bool close(std::string& error);
+    
+    size_t getTreeCount() const { return trees; }
+    size_t getVertexCount() const { return vertices; }
+    size_t getTriangleCount() const { return triangles; }
+    size_t getBytesWritten() const { return bytes; }
+
+private:
+    FILE* file;
+    bool failed;
+    size_t trees;
+    size_t vertices;  // Written so far: the next tree's indices start after them
+    size_t triangles;
+    size_t bytes;
+    std::string buffer;
+    TreeExportMesh mesh;
+    
+    void flush();
+    
+    ObjWriter(const ObjWriter&);
+    ObjWriter& operator=(const ObjWriter&);
+};
+
+// Every tree of a batch into one OBJ file
+bool exportForestObj(const Forest& forest, const std::string& path, std::string& error);
+
+#endif // TREE_EXPORT_H
@@ -0,0 +1,155 @@
+#include "tree_forest.h"
+#include "job_system.h"
+#include <atomic>
+#include <algorithm>
+
+void Forest::clear() {
+    branches.clear();
+    leaves.clear();
+    child_indices.clear();
+    trees.clear();
+    twig_library.reset();
+    twig_instances.clear();
+}
+
+ForestBuilder::ForestBuilder() {
+    threads = 0;
+    twig_depth = 0;
+    twig_prototype_count = 8;
+}
+
+void ForestBuilder::setTwigInstancing(int depth, int prototype_count) {
+    twig_depth = depth;
+    twig_prototype_count = prototype_count;
+}
+
+void ForestBuilder::add(uint64_t seed, const TreeParameters& parameters, const glm::mat4& transform) {
+    ForestTreeSpec spec;
+    spec.seed = seed;
+    spec.parameters = parameters;
+    spec.transform = transform;
+    specs.push_back(spec);
+}
+
+void ForestBuilder::build(Forest& forest) {
+    forest.clear();
+    const size_t tree_count = specs.size();
+    if (tree_count == 0) return;
+    
+    // === WORKERS ===
+    // One job per worker slot on the job system; trees are handed out from a
+    // shared counter, so a worker that draws small trees simply takes more
+    size_t worker_count = threads > 0 ? threads : JobSystem::shared().getThreads();
+    worker_count = std::max<size_t>(1, std::min(worker_count, tree_count));
+    if (workers.size() < worker_count) {
+        workers.resize(worker_count);
+    }
+    placements.resize(tree_count);
+    std::atomic<size_t> next_tree(0);
+    
+    auto run = [&](int w) {
+        Worker& worker = workers[w];
+        worker.branches.clear();
+        worker.leaves.clear();
+        worker.child_indices.clear();
+        worker.twig_instances.clear();
+        worker.tree.setVerbosity(0);
+        worker.tree.setTwigInstancing(twig_depth, twig_prototype_count);
+        for (size_t k = next_tree++; k < tree_count; k = next_tree++) {
+            worker.tree.setParameters(specs[k].parameters);
+            worker.tree.generateStructure(specs[k].seed);
+            const std::vector<TreeBranch>& branches = worker.tree.getBranches();
+            const std::vector<TreeLeaf>& leaves = worker.tree.getLeaves();
+            const std::vector<int>& children = worker.tree.getChildIndices();
+            const std::vector<TwigInstance>& twigs = worker.tree.getTwigInstances();
+            
+            Placement& placement = placements[k];
+            placement.worker = w;
+            placement.first_branch = worker.branches.size();
+            placement.first_leaf = worker.leaves.size();
+            placement.first_child = worker.child_indices.size();
+            placement.first_twig = worker.twig_instances.size();
+            placement.branch_count = branches.size();
+            placement.leaf_count = leaves.size();
+            placement.child_count = children.size();
+            placement.twig_count = twigs.size();
+            worker.branches.insert(worker.branches.end(), branches.begin(), branches.end());
+            worker.leaves.insert(worker.leaves.end(), leaves.begin(), leaves.end());
+            worker.child_indices.insert(worker.child_indices.end(), children.begin(), children.end());
+            worker.twig_instances.insert(worker.twig_instances.end(), twigs.begin(), twigs.end());
+        }
+    };
+    
+    JobSystem::shared().parallelFor(worker_count, 1, [&](int w, int, int) { run(w); });
+    
+    // === POOLED STORAGE ===
+    // Ranges follow the order the trees were added; one allocation per array
+    size_t total_branches = 0;
+    size_t total_leaves = 0;
+    size_t total_children = 0;
+    size_t total_twigs = 0;
+    forest.trees.resize(tree_count);
+    for (size_t k = 0; k < tree_count; k++) {
+        ForestTreeRange& range = forest.trees[k];
+        range.first_branch = total_branches;
+        range.branch_count = placements[k].branch_count;
+        range.first_leaf = total_leaves;
+        range.leaf_count = placements[k].leaf_count;
+        range.first_child = total_children;
+        range.first_twig = total_twigs;
+        range.twig_count = placements[k].twig_count;
+        range.seed = specs[k].seed;
+        range.transform = specs[k].transform;
+        total_branches += range.branch_count;
+        total_leaves += range.leaf_count;
+        total_children += placements[k].child_count;
+        total_twigs += range.twig_count;
+    }
+    forest.branches.resize(total_branches);
+    forest.leaves.resize(total_leaves);
+    forest.child_indices.resize(total_children);
+    forest.twig_instances.resize(total_twigs);
+    
+    // Every worker built an identical library from the same settings; the
+    // forest keeps one of them
+    for (size_t w = 0; w < worker_count && total_twigs > 0 && !forest.twig_library; w++) {
+        forest.twig_library = workers[w].tree.getTwigLibrary();
+    }
+    
+    // === COPY WITH INDEX REBASING ===
+    // Local branch indices become pool indices by adding the tree's first
+    // branch, child offsets by adding its first child entry
+    for (size_t k = 0; k < tree_count; k++) {
+        const Placement& placement = placements[k];
+        const ForestTreeRange& range = forest.trees[k];
+        const Worker& worker = workers[placement.worker];
+        
+        const TreeBranch* branch_src = worker.branches.data() + placement.first_branch;
+        TreeBranch* branch_dst = forest.branches.data() + range.first_branch;
+        for (int i = 0; i < range.branch_count; i++) {
+            branch_dst[i] = branch_src[i];
+            if (branch_dst[i].parent_index >= 0) branch_dst[i].parent_index += range.first_branch;
+            branch_dst[i].first_child += range.first_child;
+        }
+        
+        const int* child_src = worker.child_indices.data() + placement.first_child;
+        int* child_dst = forest.child_indices.data() + range.first_child;
+        for (int i = 0; i < placement.child_count; i++) {
+            child_dst[i] = child_src[i] + range.first_branch;
+        }
+        
+        const TreeLeaf* leaf_src = worker.leaves.data() + placement.first_leaf;
+        TreeLeaf* leaf_dst = forest.leaves.data() + range.first_leaf;
+        for (int i = 0; i < range.leaf_count; i++) {
+            leaf_dst[i] = leaf_src[i];
+            leaf_dst[i].parent_branch_index += range.first_branch;
+        }
+        
+        const TwigInstance* twig_src = worker.twig_instances.data() + placement.first_twig;
+        TwigInstance* twig_dst = forest.twig_instances.data() + range.first_twig;
+        for (int i = 0; i < range.twig_count; i++) {
+            twig_dst[i] = twig_src[i];
+            twig_dst[i].parent_branch_index += range.first_branch;
+        }
+    }
+}
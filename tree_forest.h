@@ -0,0 +1,101 @@
+#ifndef TREE_FOREST_H
+#define TREE_FOREST_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "tree_simple.h"
+
+// One tree of a forest batch: its seed, shape and placement in the scene
+struct ForestTreeSpec {
+    uint64_t seed;
+    TreeParameters parameters;
+    glm::mat4 transform;
+};
+
+// Where one tree lives in the forest's pooled arrays. Parent, child and
+// first_child indices inside the pool are global; geometry stays in tree
+// space and transform places it
+struct ForestTreeRange {
+    int first_branch;
+    int branch_count;
+    int first_leaf;
+    int leaf_count;
+    int first_child;
+    int first_twig;
+    int twig_count;
+    uint64_t seed;
+    glm::mat4 transform;
+};
+
+// Every tree of a batch in one storage block, in the order the trees were added
+struct Forest {
+    std::vector<TreeBranch> branches;
+    std::vector<TreeLeaf> leaves;
+    std::vector<int> child_indices; // Children of every branch, grouped per parent
+    std::vector<ForestTreeRange> trees;
+    // Twig instancing: one prototype library for the whole batch and every
+    // tree's instances (each tree's grouped by prototype)
+    std::shared_ptr<const TwigLibrary> twig_library;
+    std::vector<TwigInstance> twig_instances;
+    
+    void clear();
+};
+
+// Generates a list of trees on a worker pool. Each worker reuses one Tree
+// (and so its generation buffers) for every tree it takes, appending the
+// results to its own pool; build() then copies the pools into the forest.
+// Tree k of a batch is identical to Tree::generateStructure(seed) with the
+// same parameters, whatever the thread count
+class ForestBuilder {
+private:
+    std::vector<ForestTreeSpec> specs;
+    int threads; // 0 = one per hardware thread
+    
+    // Per-worker scratch, kept across build() calls
+    struct Worker {
+        Tree tree;
+        std::vector<TreeBranch> branches;
+        std::vector<TreeLeaf> leaves;
+        std::vector<int> child_indices;
+        std::vector<TwigInstance> twig_instances;
+    };
+    std::vector<Worker> workers;
+    
+    // Which worker generated each tree and where its elements start in that
+    // worker's pool
+    struct Placement {
+        int worker;
+        int first_branch;
+        int first_leaf;
+        int first_child;
+        int first_twig;
+        int branch_count;
+        int leaf_count;
+        int child_count;
+        int twig_count;
+    };
+    std::vector<Placement> placements;
+    int twig_depth;
+    int twig_prototype_count;
+
+public:
+    ForestBuilder();
+    
+    void add(const ForestTreeSpec& spec) { specs.push_back(spec); }
+    void add(uint64_t seed, const TreeParameters& parameters, const glm::mat4& transform);
+    void clear() { specs.clear(); }
+    int getTreeCount() const { return specs.size(); }
+    
+    void setThreads(int count) { threads = count < 0 ? 0 : count; }
+    int getThreads() const { return threads; }
+    
+    // Twig instancing for every tree (Tree::setTwigInstancing); the trees
+    // share one library
+    void setTwigInstancing(int depth, int prototype_count);
+    
+    // Generate every added tree into forest, replacing its contents
+    void build(Forest& forest);
+};
+
+#endif // TREE_FOREST_H
@@ -0,0 +1,236 @@
+#include "tree_handoff.h"
+#include "tree_simple.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <ostream>
+#include <streambuf>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char HANDOFF_MAGIC[8] = {'T', 'R', 'E', 'E', 'R', 'I', 'N', 'G'};
+static const uint32_t HANDOFF_VERSION = 1;
+static const size_t HANDOFF_ALIGNMENT = 64;
+
+// The counters sit on their own cache lines: each process writes one
+struct HandoffControl {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t slot_bytes;
+    char pad0[HANDOFF_ALIGNMENT - 24];
+    std::atomic<uint64_t> published; // Assets published so far
+    char pad1[HANDOFF_ALIGNMENT - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> released;  // Assets the consumer has handed back
+    char pad2[HANDOFF_ALIGNMENT - sizeof(std::atomic<uint64_t>)];
+};
+
+// Ahead of each slot's data
+struct HandoffSlot {
+    uint64_t sequence;
+    uint64_t bytes;
+    char pad[HANDOFF_ALIGNMENT - 16];
+};
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "the hand-off ring needs lock-free 64-bit atomics to share them between processes"
+#endif
+static_assert(sizeof(HandoffControl) == 3 * HANDOFF_ALIGNMENT, "control block is three cache lines");
+static_assert(sizeof(HandoffSlot) == HANDOFF_ALIGNMENT, "slot header is one cache line");
+
+static HandoffControl& control(unsigned char* region) {
+    return *reinterpret_cast<HandoffControl*>(region);
+}
+
+static size_t slotStride(size_t slot_bytes) {
+    return sizeof(HandoffSlot) + slot_bytes;
+}
+
+// Writes into a fixed block, failing the stream when it fills
+class SlotStreamBuffer : public std::streambuf {
+public:
+    SlotStreamBuffer(char* begin, size_t bytes) { setp(begin, begin + bytes); }
+    size_t written() const { return pptr() - pbase(); }
+};
+
+TreeHandoffRing::TreeHandoffRing() : region(nullptr), region_bytes(0), owner(false) {}
+
+TreeHandoffRing::~TreeHandoffRing() {
+    close();
+}
+
+// === REGION ===
+
+bool TreeHandoffRing::create(const std::string& region_name, int slot_count, size_t slot_bytes, std::string& error) {
+    close();
+#if defined(_WIN32)
+    (void)region_name; (void)slot_count; (void)slot_bytes;
+    error = "the shared-memory hand-off needs POSIX shared memory";
+    return false;
+#else
+    if (slot_count < 1) {
+        error = "the ring needs a slot at least";
+        return false;
+    }
+    slot_bytes = (slot_bytes + HANDOFF_ALIGNMENT - 1) / HANDOFF_ALIGNMENT * HANDOFF_ALIGNMENT;
+    const size_t bytes = sizeof(HandoffControl) + slot_count * slotStride(slot_bytes);
+    shm_unlink(region_name.c_str());
+    int fd = shm_open(region_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        error = "cannot create " + region_name;
+        return false;
+    }
+    void* view = MAP_FAILED;
+    if (ftruncate(fd, bytes) == 0) view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd); // The mapping keeps the region alive
+    if (view == MAP_FAILED) {
+        shm_unlink(region_name.c_str());
+        error = "cannot map " + region_name;
+        return false;
+    }
+    region = static_cast<unsigned char*>(view);
+    region_bytes = bytes;
+    name = region_name;
+    owner = true;
+    
+    // The region is zero-filled: the counters start at 0. The magic last,
+    // so a consumer never opens a half-made control block
+    HandoffControl& ring = control(region);
+    new (&ring.published) std::atomic<uint64_t>(0);
+    new (&ring.released) std::atomic<uint64_t>(0);
+    ring.version = HANDOFF_VERSION;
+    ring.slot_count = slot_count;
+    ring.slot_bytes = slot_bytes;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(ring.magic, HANDOFF_MAGIC, sizeof(ring.magic));
+    return true;
+#endif
+}
+
+bool TreeHandoffRing::open(const std::string& region_name, std::string& error) {
+    close();
+#if defined(_WIN32)
+    (void)region_name;
+    error = "the shared-memory hand-off needs POSIX shared memory";
+    return false;
+#else
+    int fd = shm_open(region_name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        error = "no hand-off ring " + region_name;
+        return false;
+    }
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= static_cast<off_t>(sizeof(HandoffControl))) {
+        view = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        error = "cannot map " + region_name;
+        return false;
+    }
+    region = static_cast<unsigned char*>(view);
+    region_bytes = info.st_size;
+    name = region_name;
+    owner = false;
+    
+    // The rest of the control block is read only after the magic
+    const HandoffControl& ring = control(region);
+    bool valid = memcmp(ring.magic, HANDOFF_MAGIC, sizeof(ring.magic)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!valid || ring.version != HANDOFF_VERSION || ring.slot_count == 0 || ring.slot_bytes % HANDOFF_ALIGNMENT != 0 ||
+        sizeof(HandoffControl) + ring.slot_count * slotStride(ring.slot_bytes) > region_bytes) {
+        error = region_name + " is not a hand-off ring";
+        close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+void TreeHandoffRing::close() {
+#if !defined(_WIN32)
+    if (region) munmap(region, region_bytes);
+    if (owner) shm_unlink(name.c_str());
+#endif
+    region = nullptr;
+    region_bytes = 0;
+    name.clear();
+    owner = false;
+}
+
+int TreeHandoffRing::getSlotCount() const {
+    return region ? control(region).slot_count : 0;
+}
+
+size_t TreeHandoffRing::getSlotBytes() const {
+    return region ? control(region).slot_bytes : 0;
+}
+
+unsigned char* TreeHandoffRing::slot(uint64_t sequence) const {
+    const HandoffControl& ring = control(region);
+    return region + sizeof(HandoffControl) + (sequence % ring.slot_count) * slotStride(ring.slot_bytes);
+}
+
+// === PRODUCER ===
+
+void* TreeHandoffRing::beginWrite() {
+    if (!region) return nullptr;
+    HandoffControl& ring = control(region);
+    const uint64_t next = ring.published.load(std::memory_order_relaxed);
+    // Acquire: the consumer's reads of the slot are done before it reuses
+    if (next - ring.released.load(std::memory_order_acquire) >= ring.slot_count) return nullptr;
+    return slot(next) + sizeof(HandoffSlot);
+}
+
+void TreeHandoffRing::commitWrite(size_t bytes) {
+    HandoffControl& ring = control(region);
+    const uint64_t next = ring.published.load(std::memory_order_relaxed);
+    HandoffSlot& header = *reinterpret_cast<HandoffSlot*>(slot(next));
+    header.sequence = next;
+    header.bytes = bytes;
+    // Release: the slot's bytes are visible before the count says so
+    ring.published.store(next + 1, std::memory_order_release);
+}
+
+bool TreeHandoffRing::write(const Tree& tree, std::string& error, bool include_mesh, bool encode_mesh) {
+    void* data = beginWrite();
+    if (!data) {
+        error = isOpen() ? "the hand-off ring is full" : "the hand-off ring is not open";
+        return false;
+    }
+    SlotStreamBuffer buffer(static_cast<char*>(data), getSlotBytes());
+    std::ostream out(&buffer);
+    if (!tree.save(out, error, include_mesh, encode_mesh)) {
+        if (!out) error = "the asset needs more than a slot's " + std::to_string(getSlotBytes()) + " bytes";
+        return false;
+    }
+    commitWrite(buffer.written());
+    return true;
+}
+
+// === CONSUMER ===
+
+const void* TreeHandoffRing::peek(size_t& bytes, uint64_t& sequence) const {
+    if (!region) return nullptr;
+    const HandoffControl& ring = control(region);
+    const uint64_t next = ring.released.load(std::memory_order_relaxed);
+    if (ring.published.load(std::memory_order_acquire) == next) return nullptr;
+    const HandoffSlot& header = *reinterpret_cast<const HandoffSlot*>(slot(next));
+    bytes = std::min<uint64_t>(header.bytes, ring.slot_bytes);
+    sequence = header.sequence;
+    return slot(next) + sizeof(HandoffSlot);
+}
+
+void TreeHandoffRing::release() {
+    if (!region) return;
+    HandoffControl& ring = control(region);
+    const uint64_t next = ring.released.load(std::memory_order_relaxed);
+    if (ring.published.load(std::memory_order_acquire) == next) return;
+    ring.released.store(next + 1, std::memory_order_release);
+}
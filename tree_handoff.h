@@ -0,0 +1,66 @@
+#ifndef TREE_HANDOFF_H
+#define TREE_HANDOFF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Tree;
+
+// Tree assets (tree_asset.h) handed from a generator process to a renderer
+// through a POSIX shared-memory ring, without a socket or a copy between
+// them: the producer saves each tree straight into a slot and publishes it,
+// the consumer opens it in place (Tree::load from the slot's bytes, or a
+// TreeAssetFile for the raw sections) and releases the slot when done.
+//
+// One producer and one consumer. The region is a small control block with
+// two counters, assets published and assets released, then slot_count
+// slots of slot_bytes each, 64-byte aligned like the asset's sections.
+// Asset n goes in slot n % slot_count and carries n as its sequence
+// number; a full ring (every slot published and not yet released) makes
+// the producer wait rather than overwrite one the consumer may be reading
+class TreeHandoffRing {
+public:
+    TreeHandoffRing();
+    ~TreeHandoffRing();
+    
+    // Producer: create the region name ("/trees"), replacing any left over,
+    // and unlink it on close
+    bool create(const std::string& name, int slot_count, size_t slot_bytes, std::string& error);
+    // Consumer: map the region a producer created
+    bool open(const std::string& name, std::string& error);
+    void close();
+    bool isOpen() const { return region != nullptr; }
+    
+    int getSlotCount() const;
+    size_t getSlotBytes() const;
+    
+    // === PRODUCER ===
+    // The next slot to fill, or null while the ring is full
+    void* beginWrite();
+    // Publish the bytes written through beginWrite()'s slot
+    void commitWrite(size_t bytes);
+    // Save tree into the next slot and publish it (Tree::save's flags).
+    // False with error set when the ring is full or the asset doesn't fit
+    bool write(const Tree& tree, std::string& error, bool include_mesh = true, bool encode_mesh = false);
+    
+    // === CONSUMER ===
+    // The oldest unreleased asset in place, or null when none is waiting;
+    // it stays valid until release()
+    const void* peek(size_t& bytes, uint64_t& sequence) const;
+    // Hand the peeked slot back to the producer
+    void release();
+
+private:
+    unsigned char* region;
+    size_t region_bytes;
+    std::string name;
+    bool owner; // Created here: unlinked on close
+    
+    unsigned char* slot(uint64_t sequence) const;
+    
+    TreeHandoffRing(const TreeHandoffRing&);
+    TreeHandoffRing& operator=(const TreeHandoffRing&);
+};
+
+#endif // TREE_HANDOFF_H
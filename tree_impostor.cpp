@@ -0,0 +1,157 @@
+#include "tree_impostor.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cmath>
+
+TreeImpostor::TreeImpostor()
+    : framebuffer(0), albedo_texture(0), normal_texture(0), depth_texture(0),
+      frames(0), cell_size(0), center(0.0f), radius(1.0f), baked(false) {}
+
+// One atlas texture; the color ones are mipmapped down to cells of 8
+// texels so distant impostors don't shimmer, while neighbouring cells
+// don't yet bleed into each other
+static GLuint createAtlasTexture(GLenum internal_format, GLenum format, GLenum type, int size, int max_level) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, size, size, 0, format, type, nullptr);
+    MemoryStats::trackTexture(texture, MemoryStats::textureBytes(internal_format, size, size, 1, max_level + 1),
+                              "impostors");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, max_level > 0 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max_level);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+bool TreeImpostor::create(int frame_count, int cell_pixels) {
+    release();
+    frames = frame_count < 2 ? 2 : frame_count;
+    cell_size = cell_pixels < 8 ? 8 : cell_pixels;
+    const int size = frames * cell_size;
+    int max_level = 0;
+    while ((cell_size >> (max_level + 1)) >= 8) {
+        max_level++;
+    }
+    
+    albedo_texture = createAtlasTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, size, max_level);
+    normal_texture = createAtlasTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, size, max_level);
+    depth_texture = createAtlasTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, size, 0);
+    
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo_texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal_texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_texture, 0);
+    const GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, buffers);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+void TreeImpostor::release() {
+    const GLuint textures[3] = { albedo_texture, normal_texture, depth_texture };
+    MemoryStats::forgetTextures(3, textures);
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    if (albedo_texture) glDeleteTextures(1, &albedo_texture);
+    if (normal_texture) glDeleteTextures(1, &normal_texture);
+    if (depth_texture) glDeleteTextures(1, &depth_texture);
+    framebuffer = albedo_texture = normal_texture = depth_texture = 0;
+    baked = false;
+}
+
+// === OCTAHEDRAL MAPPING ===
+
+static float signNotZero(float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+glm::vec3 TreeImpostor::octahedronDirection(const glm::vec2& uv) {
+    glm::vec2 p = uv * 2.0f - 1.0f;
+    glm::vec3 d(p.x, 1.0f - fabsf(p.x) - fabsf(p.y), p.y);
+    if (d.y < 0.0f) {
+        // The lower half is folded over the corners
+        float x = (1.0f - fabsf(d.z)) * signNotZero(d.x);
+        float z = (1.0f - fabsf(d.x)) * signNotZero(d.z);
+        d.x = x;
+        d.z = z;
+    }
+    return glm::normalize(d);
+}
+
+glm::vec2 TreeImpostor::octahedronCoordinates(const glm::vec3& direction) {
+    glm::vec3 d = direction / (fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z));
+    glm::vec2 p(d.x, d.z);
+    if (d.y < 0.0f) {
+        p = glm::vec2((1.0f - fabsf(d.z)) * signNotZero(d.x), (1.0f - fabsf(d.x)) * signNotZero(d.z));
+    }
+    return p * 0.5f + 0.5f;
+}
+
+// Frames sit on the grid's vertices, so the first and last rows and
+// columns lie on the atlas edges and every direction has three around it
+glm::vec3 TreeImpostor::frameDirection(int x, int y, int frame_count) {
+    return octahedronDirection(glm::vec2((float)x, (float)y) / (float)(frame_count - 1));
+}
+
+// === BAKING ===
+
+void TreeImpostor::beginBake(const glm::vec3& bake_center, float bake_radius) {
+    center = bake_center;
+    radius = bake_radius > 0.0f ? bake_radius : 1.0f;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    const int size = frames * cell_size;
+    glViewport(0, 0, size, size);
+    // Uncovered texels are zero, coverage included, so filtering weights
+    // colors and normals by coverage and the program divides it back out
+    const GLfloat clear_color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const GLfloat clear_depth = 1.0f;
+    glClearBufferfv(GL_COLOR, 0, clear_color);
+    glClearBufferfv(GL_COLOR, 1, clear_color);
+    glClearBufferfv(GL_DEPTH, 0, &clear_depth);
+}
+
+glm::mat4 TreeImpostor::beginFrame(int x, int y) const {
+    glViewport(x * cell_size, y * cell_size, cell_size, cell_size);
+    // The same basis f_impostor.glsl reprojects with: looking at the
+    // center from the frame's direction, up the +y axis but at the poles
+    glm::vec3 direction = frameDirection(x, y, frames);
+    glm::vec3 up = fabsf(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 view = glm::lookAt(center + direction * radius, center, up);
+    glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+    return projection * view;
+}
+
+void TreeImpostor::endBake(int viewport_width, int viewport_height, GLuint scene_framebuffer) {
+    glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer);
+    glViewport(0, 0, viewport_width, viewport_height);
+    glBindTexture(GL_TEXTURE_2D, albedo_texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, normal_texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    baked = true;
+}
+
+// === DRAWING ===
+
+void TreeImpostor::apply(GlStateCache& state) const {
+    state.bindTexture(ALBEDO_UNIT, GL_TEXTURE_2D, albedo_texture);
+    state.bindTexture(NORMAL_UNIT, GL_TEXTURE_2D, normal_texture);
+    state.bindTexture(DEPTH_UNIT, GL_TEXTURE_2D, depth_texture);
+    state.uniform1i("impostorAlbedo", ALBEDO_UNIT);
+    state.uniform1i("impostorNormal", NORMAL_UNIT);
+    state.uniform1i("impostorDepth", DEPTH_UNIT);
+    state.uniform1i("impostorFrames", frames);
+    state.uniform3fv("impostorCenter", glm::value_ptr(center));
+    state.uniform1f("impostorRadius", radius);
+}
@@ -0,0 +1,87 @@
+#ifndef TREE_IMPOSTOR_H
+#define TREE_IMPOSTOR_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class GlStateCache;
+
+// One impostor instance: a copy of the baked tree placed in the draw's space
+struct ImpostorInstance {
+    glm::vec3 position; // Where the tree's origin goes
+    float scale;
+    float yaw;          // Rotation about +y, radians
+};
+
+// Octahedral impostor of a tree: the grown tree rendered from frames x
+// frames directions on an octahedron around its bounding sphere, +y at the
+// atlas center and -y at its corners, each into its own cell of one atlas
+// of albedo, normal and depth textures. Each cell is an orthographic view
+// of the sphere looking at its center; normals are stored in the tree's
+// space and depth is linear across the sphere. The impostor program
+// (v_impostor.glsl / f_impostor.glsl) draws a camera-facing quad per
+// instance and blends the three frames nearest the view direction,
+// reprojecting each along the view ray, so a distant tree costs two
+// triangles.
+//
+// Baking is driven by the caller: beginBake() binds the atlas, then for
+// every frame beginFrame() sets its viewport and returns the matrix to
+// draw the tree with, and endBake() restores the default framebuffer.
+// create() and endBake() bind textures directly, behind a GlStateCache's
+// back (GlStateCache::invalidateTextures)
+class TreeImpostor {
+public:
+    static const int ALBEDO_UNIT = 8; // The impostor program's samplers
+    static const int NORMAL_UNIT = 9;
+    static const int DEPTH_UNIT = 10;
+    
+    TreeImpostor();
+    
+    // Allocate the atlas for frames x frames cells of cell_size pixels; false
+    // when the framebuffer is incomplete. A created impostor is released first
+    bool create(int frames, int cell_size);
+    void release();
+    bool isCreated() const { return framebuffer != 0; }
+    
+    // === BAKING ===
+    // Bind and clear the atlas for the bounding sphere (center, radius) in
+    // the tree's space
+    void beginBake(const glm::vec3& center, float radius);
+    // Set the viewport to frame (x, y) and return its view-projection; the
+    // drawn normals must be in the tree's space (an identity view)
+    glm::mat4 beginFrame(int x, int y) const;
+    // Mipmap the atlas and restore scene_framebuffer (0 = the default one)
+    // and a viewport
+    void endBake(int viewport_width, int viewport_height, GLuint scene_framebuffer = 0);
+    
+    bool isBaked() const { return baked; }
+    int getFrames() const { return frames; }
+    int getCellSize() const { return cell_size; }
+    const glm::vec3& getCenter() const { return center; }
+    float getRadius() const { return radius; }
+    
+    // Bind the atlas on its units and set the impostor program's uniforms
+    void apply(GlStateCache& state) const;
+    
+    // Octahedral mapping between directions and atlas coordinates in [0, 1]^2
+    static glm::vec3 octahedronDirection(const glm::vec2& uv);
+    static glm::vec2 octahedronCoordinates(const glm::vec3& direction);
+    // Direction toward the camera of frame (x, y) of a frames x frames grid
+    static glm::vec3 frameDirection(int x, int y, int frames);
+
+private:
+    GLuint framebuffer;
+    GLuint albedo_texture; // RGBA8, alpha = coverage
+    GLuint normal_texture; // RGBA8, the normal at 0.5 + 0.5 n, alpha = coverage
+    GLuint depth_texture;  // DEPTH_COMPONENT24, 0 nearest the frame's view
+    int frames;
+    int cell_size;
+    glm::vec3 center;
+    float radius;
+    bool baked;
+    
+    TreeImpostor(const TreeImpostor&);
+    TreeImpostor& operator=(const TreeImpostor&);
+};
+
+#endif // TREE_IMPOSTOR_H
@@ -0,0 +1,6 @@
+#include "tree_jobs.h"
+#include "job_system.h"
+
+void TreeJobPool::parallelFor(int count, int chunk, const std::function<void(int, int, int)>& fn) {
+    JobSystem::shared().parallelFor(count, chunk, fn, threads);
+}
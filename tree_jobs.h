@@ -0,0 +1,27 @@
+#ifndef TREE_JOBS_H
+#define TREE_JOBS_H
+
+#include <functional>
+
+// A tree's share of the shared job system (job_system.h) for its per-frame
+// passes: parallelFor splits [0, count) into fixed chunks taken by at most
+// threads threads, the calling thread among them, and returns once every
+// chunk is done. Chunk c always covers [c * chunk, min(count, (c + 1) *
+// chunk)), so per-chunk results can be merged in a thread-count independent
+// order
+class TreeJobPool {
+private:
+    int threads;
+
+public:
+    explicit TreeJobPool(int thread_count) : threads(thread_count < 1 ? 1 : thread_count) {}
+    
+    int getThreads() const { return threads; }
+    
+    // fn(chunk_index, begin, end) for every chunk of [0, count). A loop of
+    // one chunk runs inline without waking anyone
+    void parallelFor(int count, int chunk, const std::function<void(int, int, int)>& fn);
+    static int chunkCount(int count, int chunk) { return count <= 0 ? 0 : (count + chunk - 1) / chunk; }
+};
+
+#endif // TREE_JOBS_H
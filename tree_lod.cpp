@@ -0,0 +1,118 @@
+#include "tree_lod.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// A coarser level is chosen only once the size falls this far below its
+// threshold, so a camera resting at one doesn't switch back and forth
+static const float LOD_HYSTERESIS = 0.85f;
+
+TreeLod::TreeLod()
+    : fade_duration(0.5f), card_level(LEVELS), level(0), fade_from(0), fade_progress(0.0f) {
+    const float sizes[LEVELS - 1] = { 0.5f, 0.3f, 0.15f };
+    setLevelSizes(sizes);
+}
+
+void TreeLod::setLevelSizes(const float sizes[LEVELS - 1]) {
+    for (int i = 0; i < LEVELS - 1; i++) {
+        level_sizes[i] = sizes[i];
+    }
+}
+
+// === LEVELS PER ELEMENT ===
+
+// Integer finalizer: consecutive leaves get unrelated bits
+static unsigned int mixBits(unsigned int x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+void TreeLod::build(const Tree& tree) {
+    const std::vector<TreeBranch>& branches = tree.getBranches();
+    const int branch_count = branches.size();
+    const int leaf_count = tree.getLeafCount();
+    element_levels.resize(branch_count + leaf_count);
+    
+    // Each level up drops the finest generation left; the trunk and the
+    // main limbs carry the silhouette, so they stay at every level
+    int deepest = 0;
+    for (const TreeBranch& branch : branches) {
+        deepest = std::max(deepest, branch.generation);
+    }
+    for (int i = 0; i < branch_count; i++) {
+        int generation = branches[i].generation;
+        int coarsest = generation <= 1 ? LEVELS - 1 : deepest - generation;
+        element_levels[i] = (unsigned char)std::min(std::max(coarsest, 0), LEVELS - 1);
+    }
+    
+    // A leaf survives as many levels as its hash has trailing zero bits:
+    // half of them level 1, a quarter level 2, an eighth every level. With
+    // leaf cards, none outlasts the level before the cards'
+    for (int j = 0; j < leaf_count; j++) {
+        unsigned int bits = mixBits((unsigned int)j) | (1U << (LEVELS - 1));
+        int coarsest = 0;
+        while (!(bits & 1U)) {
+            bits >>= 1;
+            coarsest++;
+        }
+        element_levels[branch_count + j] = (unsigned char)std::min(coarsest, card_level - 1);
+    }
+}
+
+// === SELECTION AND FADE ===
+
+int TreeLod::selectLevel(float projected_size) const {
+    for (int i = 0; i < LEVELS - 1; i++) {
+        if (projected_size >= level_sizes[i]) return i;
+    }
+    return LEVELS - 1;
+}
+
+bool TreeLod::update(float projected_size, float dt) {
+    // The finest level whose size is reached; staying at the current one
+    // (or anything coarser) takes less than reaching it did
+    int target = LEVELS - 1;
+    for (int i = 0; i < LEVELS - 1; i++) {
+        float threshold = level_sizes[i] * (i >= level ? LOD_HYSTERESIS : 1.0f);
+        if (projected_size >= threshold) {
+            target = i;
+            break;
+        }
+    }
+    
+    bool changed = false;
+    if (target != level) {
+        if (target == fade_from && isFading()) {
+            // Back where the fade started: reverse it from where it is
+            fade_progress = 1.0f - fade_progress;
+        } else {
+            // A new fade; one still running for another level ends at once
+            fade_from = level;
+            fade_progress = 0.0f;
+        }
+        level = target;
+        changed = true;
+    }
+    
+    if (isFading()) {
+        fade_progress = fade_duration > 0.0f ? fade_progress + dt / fade_duration : 1.0f;
+        if (fade_progress >= 1.0f) {
+            fade_from = level;
+            fade_progress = 0.0f;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+float TreeLod::projectedSize(const glm::vec3& center, float radius, const glm::vec3& eye, float fov_y) {
+    float distance = glm::length(eye - center);
+    if (distance <= radius) {
+        return std::numeric_limits<float>::max(); // Inside the bounds the tree fills the view
+    }
+    return radius / (distance * tanf(0.5f * fov_y));
+}
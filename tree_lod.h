@@ -0,0 +1,90 @@
+#ifndef TREE_LOD_H
+#define TREE_LOD_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <vector>
+#include "tree_simple.h"
+
+// Discrete levels of detail for one tree, drawn from its existing meshes:
+// level 0 is every element, and each coarser level drops the deepest
+// generation of branches still drawn (the trunk and main limbs stay) and
+// half of the remaining leaves, a fixed pseudo-random half so the kept set
+// doesn't shimmer. Every level is a subset of the finer ones, so an
+// element needs only the coarsest level that still draws it, and a level
+// change adds or removes one set of elements.
+//
+// update() picks the level from the tree's projected size, with some
+// hysteresis so it doesn't flicker at a threshold, and cross-fades over
+// the fade duration: the entering or leaving set is drawn screen-door
+// dithered (the LOD_FADE shader variant) at getFadeOpacity() while the
+// rest stays solid. TreeBvh::cull applies the selection with the frustum.
+//
+// From the card level on, the leaves are replaced by leaf cards
+// (leaf_cards.h): no leaf is kept past the level before it, and the
+// cards cross-fade against the leaves they replace
+class TreeLod {
+public:
+    static const int LEVELS = 4;
+    
+    TreeLod();
+    
+    // Assign every element of a tree its coarsest level; needed whenever
+    // the tree's layout changes. The current level and fade carry over
+    void build(const Tree& tree);
+    // Coarsest level drawing an element, numbered as in TreeBvh (branch i,
+    // then leaf j as branch count + j); elements past the built tree are
+    // always drawn
+    int getElementLevel(int element) const {
+        return element < (int)element_levels.size() ? element_levels[element] : LEVELS - 1;
+    }
+    
+    // Projected size (viewport heights) at or above which each level is
+    // chosen: level 0 from sizes[0] up, level LEVELS - 1 below the last
+    void setLevelSizes(const float sizes[LEVELS - 1]);
+    float getLevelSize(int i) const { return level_sizes[i]; }
+    // Seconds a level change cross-fades (0 = switch at once)
+    void setFadeDuration(float seconds) { fade_duration = seconds; }
+    // First level drawing leaf cards instead of leaves (LEVELS = never);
+    // takes effect on the next build()
+    void setCardLevel(int first_card_level) { card_level = std::min(std::max(first_card_level, 1), (int)LEVELS); }
+    int getCardLevel() const { return card_level; }
+    
+    // Choose the level for the tree's projected size and advance the fade
+    // by dt seconds; true when what is drawn changed
+    bool update(float projected_size, float dt);
+    int getLevel() const { return level; }
+    // The level a projected size chooses, without hysteresis or fade: for
+    // many copies of one tree that keep no state of their own
+    int selectLevel(float projected_size) const;
+    
+    // Elements of level >= getSolidLevel() are drawn solid; while fading,
+    // those in [getFadeLevel(), getSolidLevel()) at getFadeOpacity()
+    bool isFading() const { return fade_from != level; }
+    int getSolidLevel() const { return std::max(level, fade_from); }
+    int getFadeLevel() const { return std::min(level, fade_from); }
+    float getFadeOpacity() const { return level < fade_from ? fade_progress : 1.0f - fade_progress; }
+    // Opacity of the leaf cards: 0 hidden, 1 solid, between while a fade
+    // crosses the card level, the complement of the leaves'
+    float getCardOpacity() const {
+        if (isFading() && getFadeLevel() < card_level && card_level <= getSolidLevel()) {
+            return 1.0f - getFadeOpacity();
+        }
+        return level >= card_level ? 1.0f : 0.0f;
+    }
+    
+    // Fraction of the viewport height a bounding sphere spans from eye
+    // under a vertical field of view of fov_y radians, as Tree computes it
+    static float projectedSize(const glm::vec3& center, float radius, const glm::vec3& eye, float fov_y);
+
+private:
+    std::vector<unsigned char> element_levels;
+    float level_sizes[LEVELS - 1];
+    float fade_duration;
+    int card_level;
+    int level;           // The level chosen
+    int fade_from;       // The level faded from, == level when not fading
+    float fade_progress; // 0 to 1 through the fade
+};
+
+#endif // TREE_LOD_H
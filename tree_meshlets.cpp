@@ -0,0 +1,301 @@
+#include "tree_meshlets.h"
+#include "gl_state.h"
+#include "memory_stats.h"
+#include "render_stats.h"
+#include "shaderprogram.h"
+#include <algorithm>
+#include <cmath>
+
+static const int WOOD_BINS = 6;  // +x, -x, +y, -y, +z, -z
+static const int LEAF_BIN = WOOD_BINS;
+static const int COMMAND_WORDS = 5; // DrawElementsIndirectCommand
+// The faces of a tapered ring lean off its vertex normals along the
+// branch; the cones are widened by this much to hold them too
+static const float CONE_MARGIN = 0.1f; // Radians
+
+TreeMeshlets::TreeMeshlets()
+    : cull_program(nullptr), wood_meshlets(0), wood_base(0), leaf_base(0), meshlet_buffer(0), piece_buffer(0),
+      command_buffer(0) {}
+
+TreeMeshlets::~TreeMeshlets() {
+    release();
+}
+
+bool TreeMeshlets::isSupported() {
+    return GLEW_VERSION_4_3;
+}
+
+// Which of the six axis directions a unit normal leans along most
+static int axisBin(const glm::vec3& normal) {
+    glm::vec3 a = glm::abs(normal);
+    int axis = (a.x >= a.y && a.x >= a.z) ? 0 : (a.y >= a.z ? 1 : 2);
+    return 2 * axis + (normal[axis] < 0.0f ? 1 : 0);
+}
+
+// === BUILD ===
+
+// Pieces of both meshes from the grown elements: a wood piece faces where
+// the middle of its quads does on the ring frame addBranchSegment uses
+// (welded tubes turn theirs along the parent, so theirs bin loosely), a
+// leaf piece is its quad
+void TreeMeshlets::build(const Tree& tree, bool leaves) {
+    meshlets.clear();
+    pieces.clear();
+    wood_indices.clear();
+    leaf_indices.clear();
+    wood_meshlets = 0;
+    
+    const std::vector<TreeBranch>& branches = tree.getBranches();
+    const std::vector<GLuint>& branch_indices = tree.getBranchIndices();
+    const std::vector<int>& offsets = tree.getBranchIndexOffsets();
+    std::vector<Piece> wood;
+    glm::vec3 low(0.0f), high(0.0f); // The grown tree's box, for the Morton codes
+    bool first_box = true;
+    for (size_t b = 0; b < branches.size(); b++) {
+        const TreeBranch& branch = branches[b];
+        int slot = tree.getBranchSlot(b);
+        if (slot < 0 || slot + 1 >= (int)offsets.size()) continue;
+        int first = offsets[slot];
+        int count = offsets[slot + 1] - first;
+        int quads = count / 6;
+        if (quads == 0) continue;
+        glm::vec3 axis = branch.end - branch.start;
+        glm::vec3 direction = glm::length(axis) > 1e-6f ? glm::normalize(axis) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 up = (std::abs(direction.y) > 0.9f) ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+        glm::vec3 right = glm::normalize(glm::cross(direction, up));
+        up = glm::normalize(glm::cross(right, direction));
+        const int piece_quads = PIECE_TRIANGLES / 2;
+        for (int q = 0; q < quads; q += piece_quads) {
+            int taken = std::min(piece_quads, quads - q);
+            float angle = (q + 0.5f * taken) / quads * 2.0f * (float)M_PI;
+            glm::vec3 radial = right * cosf(angle) + up * sinf(angle);
+            Piece piece;
+            piece.slot = slot;
+            piece.first = first + 6 * q;
+            piece.count = 6 * taken;
+            piece.vertices = 2 * (taken + 1);
+            piece.bin = axisBin(radial);
+            piece.center = 0.5f * (branch.start + branch.end) + radial * branch.radius;
+            piece.morton = 0;
+            wood.push_back(piece);
+        }
+        glm::vec3 min = glm::min(branch.start, branch.end), max = glm::max(branch.start, branch.end);
+        low = first_box ? min : glm::min(low, min);
+        high = first_box ? max : glm::max(high, max);
+        first_box = false;
+    }
+    
+    std::vector<Piece> foliage;
+    if (leaves && !tree.getLeafIndices().empty()) {
+        const std::vector<TreeLeaf>& tree_leaves = tree.getLeaves();
+        for (size_t l = 0; l < tree_leaves.size(); l++) {
+            int slot = tree.getLeafSlot(l);
+            if (slot < 0) continue;
+            Piece piece;
+            piece.slot = slot;
+            piece.first = slot * Tree::LEAF_SINGLE_SLOT_INDICES;
+            piece.count = Tree::LEAF_SINGLE_SLOT_INDICES;
+            piece.vertices = Tree::LEAF_SINGLE_SLOT_VERTICES;
+            piece.bin = LEAF_BIN;
+            piece.center = tree_leaves[l].position;
+            piece.morton = 0;
+            foliage.push_back(piece);
+            low = first_box ? piece.center : glm::min(low, piece.center);
+            high = first_box ? piece.center : glm::max(high, piece.center);
+            first_box = false;
+        }
+    }
+    
+    glm::vec3 extent = glm::max(high - low, glm::vec3(1e-6f));
+    for (Piece& piece : wood) {
+        piece.morton = mortonCode((piece.center - low) / extent);
+    }
+    for (Piece& piece : foliage) {
+        piece.morton = mortonCode((piece.center - low) / extent);
+    }
+    wood_base = branch_indices.size();
+    pack(wood, branch_indices, wood_base, false, wood_indices);
+    wood_meshlets = meshlets.size();
+    leaf_base = tree.getLeafIndices().size();
+    pack(foliage, tree.getLeafIndices(), leaf_base, true, leaf_indices);
+    
+    if (meshlet_buffer == 0) {
+        glGenBuffers(1, &meshlet_buffer);
+        glGenBuffers(1, &piece_buffer);
+        glGenBuffers(1, &command_buffer);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshlet_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, meshlets.size() * sizeof(TreeMeshlet), meshlets.data(), GL_DYNAMIC_DRAW);
+    MemoryStats::trackBuffer(meshlet_buffer, meshlets.size() * sizeof(TreeMeshlet), "meshlets");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, piece_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, pieces.size() * sizeof(glm::uvec2), pieces.data(), GL_STATIC_DRAW);
+    MemoryStats::trackBuffer(piece_buffer, pieces.size() * sizeof(glm::uvec2), "meshlets");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, meshlets.size() * COMMAND_WORDS * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    MemoryStats::trackBuffer(command_buffer, meshlets.size() * COMMAND_WORDS * sizeof(GLuint), "meshlets");
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Bin by bin in Morton order, a meshlet closing when the next piece would
+// take it past either limit; within a meshlet the pieces go in slot order,
+// so the started ones are a prefix
+void TreeMeshlets::pack(std::vector<Piece>& mesh_pieces, const std::vector<GLuint>& indices, GLuint base,
+                        bool leaves, std::vector<GLuint>& out) {
+    std::sort(mesh_pieces.begin(), mesh_pieces.end(), [](const Piece& a, const Piece& b) {
+        return a.bin != b.bin ? a.bin < b.bin : a.morton < b.morton;
+    });
+    size_t begin = 0;
+    while (begin < mesh_pieces.size()) {
+        size_t end = begin;
+        int vertices = 0, triangles = 0;
+        while (end < mesh_pieces.size() && mesh_pieces[end].bin == mesh_pieces[begin].bin &&
+               vertices + mesh_pieces[end].vertices <= MAX_VERTICES &&
+               triangles + mesh_pieces[end].count / 3 <= MAX_TRIANGLES) {
+            vertices += mesh_pieces[end].vertices;
+            triangles += mesh_pieces[end].count / 3;
+            end++;
+        }
+        std::sort(mesh_pieces.begin() + begin, mesh_pieces.begin() + end,
+                  [](const Piece& a, const Piece& b) { return a.slot < b.slot; });
+        
+        TreeMeshlet meshlet = TreeMeshlet();
+        meshlet.first_index = base + out.size();
+        meshlet.first_piece = pieces.size();
+        meshlet.piece_count = end - begin;
+        meshlet.leaves = leaves ? 1 : 0;
+        meshlet.cone_cutoff = 1.0f;
+        GLuint local = 0;
+        for (size_t p = begin; p < end; p++) {
+            const Piece& piece = mesh_pieces[p];
+            out.insert(out.end(), indices.begin() + piece.first, indices.begin() + piece.first + piece.count);
+            local += piece.count;
+            pieces.push_back(glm::uvec2(piece.slot, local));
+        }
+        meshlets.push_back(meshlet);
+        begin = end;
+    }
+}
+
+void TreeMeshlets::release() {
+    if (meshlet_buffer) {
+        GLuint buffers[3] = { meshlet_buffer, piece_buffer, command_buffer };
+        MemoryStats::forgetBuffers(3, buffers);
+        glDeleteBuffers(3, buffers);
+    }
+    meshlet_buffer = piece_buffer = command_buffer = 0;
+    meshlets.clear();
+    pieces.clear();
+    wood_indices.clear();
+    leaf_indices.clear();
+    wood_meshlets = 0;
+}
+
+// === PER FRAME ===
+
+// Each meshlet's started pieces: the sphere around their box, the cone
+// around their vertex normals. Leaves are drawn from both sides, so their
+// cones stay open
+void TreeMeshlets::refit(const Tree& tree) {
+    if (meshlets.empty()) return;
+    const int started[2] = { tree.drawnBranchSlots(), tree.drawnLeafSlots() };
+    const std::vector<float>* vertices[2] = { &tree.getBranchVertices(), &tree.getLeafVertices() };
+    const std::vector<GLuint>* indices[2] = { &wood_indices, &leaf_indices };
+    const GLuint bases[2] = { wood_base, leaf_base };
+    for (TreeMeshlet& meshlet : meshlets) {
+        const int kind = meshlet.leaves;
+        const float* data = vertices[kind]->data();
+        const GLuint* local = indices[kind]->data() + (meshlet.first_index - bases[kind]);
+        GLuint end = 0;
+        for (GLuint p = 0; p < meshlet.piece_count; p++) {
+            const glm::uvec2& piece = pieces[meshlet.first_piece + p];
+            if ((int)piece.x >= started[kind]) break;
+            end = piece.y;
+        }
+        meshlet.radius = 0.0f;
+        meshlet.cone_cutoff = 1.0f;
+        if (end == 0) continue;
+        
+        const float* first = data + local[0] * Tree::VERTEX_FLOATS;
+        glm::vec3 low(first[0], first[1], first[2]), high = low;
+        glm::vec3 normals(0.0f);
+        for (GLuint i = 0; i < end; i++) {
+            const float* vertex = data + local[i] * Tree::VERTEX_FLOATS;
+            glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+            low = glm::min(low, position);
+            high = glm::max(high, position);
+            normals += glm::vec3(vertex[6], vertex[7], vertex[8]);
+        }
+        meshlet.center = 0.5f * (low + high);
+        float radius2 = 0.0f;
+        for (GLuint i = 0; i < end; i++) {
+            const float* vertex = data + local[i] * Tree::VERTEX_FLOATS;
+            glm::vec3 offset = glm::vec3(vertex[0], vertex[1], vertex[2]) - meshlet.center;
+            radius2 = std::max(radius2, glm::dot(offset, offset));
+        }
+        meshlet.radius = sqrtf(radius2);
+        
+        if (kind == 1 || glm::length(normals) < 1e-6f) continue;
+        meshlet.cone_axis = glm::normalize(normals);
+        float min_dot = 1.0f;
+        for (GLuint i = 0; i < end; i++) {
+            const float* vertex = data + local[i] * Tree::VERTEX_FLOATS;
+            glm::vec3 normal(vertex[6], vertex[7], vertex[8]);
+            float length = glm::length(normal);
+            if (length > 1e-6f) min_dot = std::min(min_dot, glm::dot(meshlet.cone_axis, normal) / length);
+        }
+        float half_angle = acosf(glm::clamp(min_dot, -1.0f, 1.0f)) + CONE_MARGIN;
+        if (half_angle < 0.5f * (float)M_PI) meshlet.cone_cutoff = sinf(half_angle);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshlet_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, meshlets.size() * sizeof(TreeMeshlet), meshlets.data());
+    RenderStats::countUpload(meshlets.size() * sizeof(TreeMeshlet));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void TreeMeshlets::cull(GlStateCache& state, const Tree& tree, const ViewFrustum& frustum, const glm::vec3& eye) {
+    if (meshlets.empty() || cull_program == nullptr) return;
+    state.useProgram(cull_program);
+    state.uniform1i("meshletCount", meshlets.size());
+    state.uniform1i("startedBranchSlots", tree.drawnBranchSlots());
+    state.uniform1i("startedLeafSlots", tree.drawnLeafSlots());
+    glUniform4fv(cull_program->u("frustumPlanes"), 6, &frustum.planes[0].x);
+    state.uniform3fv("eye", &eye.x);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meshlet_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, piece_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, command_buffer);
+    glDispatchCompute((meshlets.size() + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void TreeMeshlets::drawWood(const GpuMesh& mesh) const {
+    if (wood_meshlets == 0) return;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    mesh.bind();
+    mesh.drawIndirect(0, wood_meshlets);
+    GpuMesh::unbind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void TreeMeshlets::drawLeaves(const GpuMesh& mesh) const {
+    if (getLeafMeshletCount() == 0) return;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    mesh.bind();
+    mesh.drawIndirect(wood_meshlets * COMMAND_WORDS * sizeof(GLuint), getLeafMeshletCount());
+    GpuMesh::unbind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+int TreeMeshlets::getDrawnMeshlets() const {
+    if (meshlets.empty()) return 0;
+    std::vector<GLuint> commands(meshlets.size() * COMMAND_WORDS);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(GLuint), commands.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    int drawn = 0;
+    for (size_t m = 0; m < meshlets.size(); m++) {
+        if (commands[m * COMMAND_WORDS] > 0) drawn++;
+    }
+    return drawn;
+}
@@ -0,0 +1,120 @@
+#ifndef TREE_MESHLETS_H
+#define TREE_MESHLETS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "frustum.h"
+#include "gpu_mesh.h"
+#include "tree_simple.h"
+
+class GlStateCache;
+class ShaderProgram;
+
+// One meshlet, as c_meshlet_cull.glsl reads it: a bounding sphere, the
+// cone holding its vertex normals, and its pieces and indices
+struct TreeMeshlet {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 cone_axis;
+    float cone_cutoff;  // Sine of the cone's half angle; 1 = never facing away
+    GLuint first_index; // In the mesh's element buffer, after the tree's own indices
+    GLuint first_piece;
+    GLuint piece_count;
+    GLuint leaves;      // 1 = a leaf meshlet, drawn from the leaf mesh
+};
+
+static_assert(sizeof(TreeMeshlet) == 48, "TreeMeshlet must match the shader's std430 layout");
+
+// The CPU-animated tree meshes cut into meshlets of at most MAX_VERTICES
+// vertices and MAX_TRIANGLES triangles, each culled on its own by a compute
+// pass before the draw: against the frustum by its bounding sphere, and,
+// for the wood, against the eye by its normal cone, a meshlet all of whose
+// faces look away being hidden behind the near side of its tubes. The
+// frame then draws every meshlet of a mesh with one
+// glMultiDrawElementsIndirect call, the culled ones as empty commands, so a
+// hero tree that fills the screen up close draws only what faces and
+// reaches the view instead of whole BVH clusters.
+//
+// A meshlet is a list of pieces: up to PIECE_TRIANGLES consecutive
+// triangles of one mesh slot (a quarter of an 8-sided branch ring, or a
+// single-sided leaf quad). The pieces are binned by the way they face
+// when grown, the wood's by the axis their normals lean along, and packed
+// in Morton order of their grown positions, so a meshlet holds nearby
+// faces turned the same way. Its indices are copies of its pieces' in
+// slot order, appended after the tree's own indices in the same element
+// buffer; the cull pass draws the prefix of pieces whose slots have
+// started. refit() fits the spheres and cones to the current growth.
+//
+// Covers the indexed CPU-animated meshes: the wood, and single-sided
+// leaves. Needs OpenGL 4.3
+class TreeMeshlets {
+public:
+    static const int MAX_VERTICES = 64;
+    static const int MAX_TRIANGLES = 124;
+    static const int PIECE_TRIANGLES = 4;
+    
+    TreeMeshlets();
+    ~TreeMeshlets();
+    
+    static bool isSupported();
+    void setCullProgram(ShaderProgram* program) { cull_program = program; }
+    
+    // === BUILD ===
+    // Cut the tree's branch mesh, and its leaf mesh when leaves is set,
+    // into meshlets. Their indices are then getWoodIndices() and
+    // getLeafIndices(), for the caller to append to the meshes' own
+    void build(const Tree& tree, bool leaves);
+    const std::vector<GLuint>& getWoodIndices() const { return wood_indices; }
+    const std::vector<GLuint>& getLeafIndices() const { return leaf_indices; }
+    int getWoodMeshletCount() const { return wood_meshlets; }
+    int getLeafMeshletCount() const { return meshlets.size() - wood_meshlets; }
+    void release();
+    
+    // === PER FRAME ===
+    // Fit the bounds to the tree's current vertices and upload them
+    void refit(const Tree& tree);
+    // Cull every meshlet for the view from eye through frustum (the tree's
+    // space), with the tree's started slots
+    void cull(GlStateCache& state, const Tree& tree, const ViewFrustum& frustum, const glm::vec3& eye);
+    // The surviving meshlets of the branch or leaf mesh, from the commands
+    // cull() wrote; the mesh is the one whose element buffer holds them
+    void drawWood(const GpuMesh& mesh) const;
+    void drawLeaves(const GpuMesh& mesh) const;
+    // Meshlets the last cull() kept; reads the commands back
+    int getDrawnMeshlets() const;
+
+private:
+    struct Piece {
+        int slot;
+        GLuint first;    // Of the tree's indices
+        int count;
+        int vertices;    // Distinct ones
+        int bin;          // Facing: wood by its normals' axis, leaves apart
+        glm::vec3 center; // Grown
+        uint32_t morton;  // Of the center, within the grown tree's box
+    };
+    
+    ShaderProgram* cull_program;
+    std::vector<TreeMeshlet> meshlets; // The wood's, then the leaves'
+    int wood_meshlets;
+    std::vector<glm::uvec2> pieces;    // Per meshlet piece: (slot, its indices' end in the meshlet)
+    std::vector<GLuint> wood_indices;
+    std::vector<GLuint> leaf_indices;
+    GLuint wood_base;                  // Element buffer index of wood_indices[0]
+    GLuint leaf_base;
+    GLuint meshlet_buffer;
+    GLuint piece_buffer;
+    GLuint command_buffer;
+    
+    // Pack one mesh's pieces into meshlets whose indices go to out, the
+    // first at base in the element buffer
+    void pack(std::vector<Piece>& mesh_pieces, const std::vector<GLuint>& indices, GLuint base, bool leaves,
+              std::vector<GLuint>& out);
+    
+    TreeMeshlets(const TreeMeshlets&);
+    TreeMeshlets& operator=(const TreeMeshlets&);
+};
+
+#endif // TREE_MESHLETS_H
@@ -0,0 +1,97 @@
+#include "tree_occlusion.h"
+#include "job_system.h"
+#include "profiler.h"
+#include "tree_bvh.h"
+#include "tree_simple.h"
+#include <algorithm>
+#include <cmath>
+
+// Rays reach this share of the tree's bounding box diagonal: a few leaf
+// lengths, so a point is darkened by the clusters around it rather than
+// by the whole crown, which would leave every inner leaf near black
+static const float OCCLUSION_REACH = 0.03f;
+// Branch samples sit this far along from each end, clear of the parent's
+// capsule at the base and the children's at the tip
+static const float BRANCH_SAMPLE_SHARE = 0.15f;
+// Points per parallelFor chunk
+static const int OCCLUSION_CHUNK = 64;
+
+// Unit directions evenly over the sphere (a Fibonacci spiral)
+static std::vector<glm::vec3> sphereDirections(int count) {
+    std::vector<glm::vec3> directions(count);
+    const float golden_angle = 2.39996323f;
+    for (int k = 0; k < count; k++) {
+        float y = 1.0f - 2.0f * (k + 0.5f) / count;
+        float ring = std::sqrt(std::max(0.0f, 1.0f - y * y));
+        directions[k] = glm::vec3(std::cos(golden_angle * k) * ring, y, std::sin(golden_angle * k) * ring);
+    }
+    return directions;
+}
+
+// Openness from the rays' first hits: a ray blocked at distance t occludes
+// by (1 - t / reach)^2, one that escapes not at all
+static float openness(const TreeBvh& bvh, const Tree& tree, const std::vector<glm::vec3>& origins,
+                      const std::vector<glm::vec3>& directions, float reach) {
+    float occluded = 0.0f;
+    TreeRayHit hit;
+    for (size_t k = 0; k < directions.size(); k++) {
+        if (bvh.raycast(tree, origins[k], directions[k], reach, hit)) {
+            float closeness = 1.0f - hit.distance / reach;
+            occluded += closeness * closeness;
+        }
+    }
+    return 1.0f - occluded / directions.size();
+}
+
+void bakeTreeOcclusion(const Tree& tree, int rays, std::vector<float>& branch_occlusion,
+                       std::vector<float>& leaf_occlusion) {
+    PROFILE_SCOPE("bakeTreeOcclusion");
+    const std::vector<TreeBranch>& branches = tree.getBranches();
+    const std::vector<TreeLeaf>& leaves = tree.getLeaves();
+    branch_occlusion.assign(2 * branches.size(), 1.0f);
+    leaf_occlusion.assign(leaves.size(), 1.0f);
+    TreeBvh bvh;
+    bvh.buildGrown(tree);
+    glm::vec3 low, high;
+    if (rays <= 0 || !bvh.getBounds(low, high)) return;
+    const float reach = std::max(OCCLUSION_REACH * glm::length(high - low), 1e-3f);
+    const std::vector<glm::vec3> directions = sphereDirections(rays);
+    
+    // Branch points each sample the rays from the cylinder's surface on
+    // their side, so none starts inside the branch itself
+    const int branch_points = 2 * branches.size();
+    JobSystem::shared().parallelFor(branch_points, OCCLUSION_CHUNK, [&](int, int begin, int end) {
+        std::vector<glm::vec3> origins(directions.size());
+        for (int point = begin; point < end; point++) {
+            const TreeBranch& branch = branches[point / 2];
+            glm::vec3 axis = branch.end - branch.start;
+            float length = glm::length(axis);
+            if (length <= 0.0f) continue;
+            axis /= length;
+            float share = (point % 2 == 0) ? BRANCH_SAMPLE_SHARE : 1.0f - BRANCH_SAMPLE_SHARE;
+            glm::vec3 center = branch.start + (branch.end - branch.start) * share;
+            glm::vec3 side = std::fabs(axis.y) < 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            side = glm::normalize(glm::cross(axis, side));
+            for (size_t k = 0; k < directions.size(); k++) {
+                glm::vec3 radial = directions[k] - axis * glm::dot(directions[k], axis);
+                float radial_length = glm::length(radial);
+                radial = radial_length > 1e-3f ? radial / radial_length : side;
+                origins[k] = center + radial * (branch.radius * 1.05f);
+            }
+            branch_occlusion[point] = openness(bvh, tree, origins, directions, reach);
+        }
+    });
+    
+    // Leaves from just off the face each ray leaves by
+    JobSystem::shared().parallelFor(leaves.size(), OCCLUSION_CHUNK, [&](int, int begin, int end) {
+        std::vector<glm::vec3> origins(directions.size());
+        for (int j = begin; j < end; j++) {
+            const TreeLeaf& leaf = leaves[j];
+            for (size_t k = 0; k < directions.size(); k++) {
+                float face = glm::dot(directions[k], leaf.normal) >= 0.0f ? 1.0f : -1.0f;
+                origins[k] = leaf.position + leaf.normal * (face * 0.01f) + directions[k] * 0.01f;
+            }
+            leaf_occlusion[j] = openness(bvh, tree, origins, directions, reach);
+        }
+    });
+}
@@ -0,0 +1,23 @@
+#ifndef TREE_OCCLUSION_H
+#define TREE_OCCLUSION_H
+
+#include <vector>
+
+class Tree;
+
+// Ambient occlusion baked from a tree's own fully grown geometry, once
+// per layout: rays from points on each branch and leaf are cast into a
+// TreeBvh of the finished tree (TreeBvh::buildGrown), and a ray blocked
+// within the reach occludes the more the nearer it is blocked. Inner
+// limbs and leaves deep in the canopy come out dark, the outer shell
+// open. rays directions, spread evenly over the sphere, per point (16
+// is plenty); the reach is a share of the tree's size. Results are in
+// [0, 1], 1 open:
+//   branch_occlusion[2 * i], [2 * i + 1]  branch i near its base and tip
+//   leaf_occlusion[j]                      leaf j, both faces
+// The points are shared out on the job system. This is the
+// Tree::OcclusionBaker the render code gives its trees
+void bakeTreeOcclusion(const Tree& tree, int rays, std::vector<float>& branch_occlusion,
+                       std::vector<float>& leaf_occlusion);
+
+#endif // TREE_OCCLUSION_H
@@ -0,0 +1,173 @@
+#include "tree_placement.h"
+#include "profiler.h"
+#include "tree_simple.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+
+// Candidates tried around an active site before it retires (Bridson's k)
+static const int PLACEMENT_ATTEMPTS = 12;
+// How far past touching its parent a candidate lands, so rounding never
+// puts the two just inside each other's reach
+static const float PLACEMENT_MARGIN = 1.001f;
+
+TreePlacement::TreePlacement() : min_scale(1.0f), max_scale(1.0f), spacing(1.0f) {}
+
+void TreePlacement::setScaleRange(float low, float high) {
+    min_scale = std::max(0.0f, std::min(low, high));
+    max_scale = std::max(min_scale, high);
+}
+
+namespace {
+
+// A placed site and its exclusion radius
+struct PlacedSite {
+    glm::vec2 position;
+    float radius;
+    float scale;
+    int kind;
+};
+
+// A neighbouring cell and the least distance from any point of a cell to it
+struct CellOffset {
+    ptrdiff_t step; // In the padded grid
+    float gap;
+};
+
+}
+
+void TreePlacement::place(const glm::vec2& low, const glm::vec2& high, uint32_t seed,
+                          std::vector<TreeSite>& sites) const {
+    PROFILE_SCOPE("TreePlacement::place");
+    if (kind_radii.empty()) return;
+    const float min_kind = *std::min_element(kind_radii.begin(), kind_radii.end());
+    const float max_kind = *std::max_element(kind_radii.begin(), kind_radii.end());
+    const float min_radius = min_kind * min_scale * spacing;
+    const float max_radius = max_kind * max_scale * spacing;
+    const glm::vec2 size = high - low;
+    if (min_radius <= 0.0f || size.x < 2.0f * max_radius || size.y < 2.0f * max_radius) return;
+    
+    // === BACKGROUND GRID ===
+    // Two sites are at least 2 * min_radius apart, the diagonal of a cell,
+    // so no cell holds two
+    const float cell = min_radius * 1.41421356f;
+    const int columns = std::max(1, (int)std::ceil(size.x / cell));
+    const int rows = std::max(1, (int)std::ceil(size.y / cell));
+    const float widest = 2.0f * max_radius;
+    const int span = (int)std::ceil(widest / cell);
+    // Each cell holds its site's (x, z, radius), radius 0 when empty, so the
+    // test reads the grid alone. Empty cells pad it span deep on every side,
+    // so a neighbour is an index step with no bounds to check
+    const int stride = columns + 2 * span;
+    std::vector<glm::vec3> grid((size_t)stride * (rows + 2 * span), glm::vec3(0.0f));
+    std::vector<PlacedSite> placed;
+    std::vector<int> active;
+    // Cells within the widest reach, nearest first: a candidate that fails
+    // mostly fails on its own cell or the next, and stops there
+    std::vector<CellOffset> offsets;
+    for (int dz = -span; dz <= span; dz++) {
+        for (int dx = -span; dx <= span; dx++) {
+            const float gap_x = std::max(0, std::abs(dx) - 1) * cell;
+            const float gap_z = std::max(0, std::abs(dz) - 1) * cell;
+            CellOffset offset = { dz * stride + dx, std::sqrt(gap_x * gap_x + gap_z * gap_z) };
+            if (offset.gap < widest) offsets.push_back(offset);
+        }
+    }
+    std::sort(offsets.begin(), offsets.end(),
+              [](const CellOffset& a, const CellOffset& b) { return a.gap < b.gap; });
+    
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const int kind_count = kind_radii.size();
+    auto candidate = [&](const glm::vec2& position) {
+        PlacedSite site;
+        site.position = position;
+        site.kind = random() % kind_count;
+        site.scale = min_scale + (max_scale - min_scale) * unit(random);
+        site.radius = kind_radii[site.kind] * site.scale * spacing;
+        return site;
+    };
+    auto cellOf = [&](const glm::vec2& p) {
+        const int column = std::max(0, std::min(columns - 1, (int)((p.x - low.x) / cell)));
+        const int row = std::max(0, std::min(rows - 1, (int)((p.y - low.y) / cell)));
+        return (ptrdiff_t)(row + span) * stride + column + span;
+    };
+    // Inside with its crown, and clear of every crown within its reach
+    auto fits = [&](const PlacedSite& site) {
+        const glm::vec2& p = site.position;
+        if (p.x - site.radius < low.x || p.x + site.radius > high.x || p.y - site.radius < low.y ||
+            p.y + site.radius > high.y) {
+            return false;
+        }
+        const float reach = site.radius + max_radius;
+        const glm::vec3* center = &grid[cellOf(p)];
+        for (const CellOffset& offset : offsets) {
+            if (offset.gap >= reach) break;
+            const glm::vec3& other = center[offset.step];
+            const float dx = other.x - p.x, dz = other.y - p.y;
+            const float apart = other.z + site.radius;
+            if (other.z > 0.0f && dx * dx + dz * dz < apart * apart) return false;
+        }
+        return true;
+    };
+    auto add = [&](const PlacedSite& site) {
+        grid[cellOf(site.position)] = glm::vec3(site.position, site.radius);
+        active.push_back(placed.size());
+        placed.push_back(site);
+        // Thinned as they are placed, from the same stream, so the sites
+        // stay a function of the seed
+        const float keep = density ? density(site.position.x, site.position.y) : 1.0f;
+        if (unit(random) < keep) {
+            TreeSite out = { site.position, site.scale, site.kind };
+            sites.push_back(out);
+        }
+    };
+    
+    // === FIRST SITE ===
+    for (int attempt = 0; attempt < PLACEMENT_ATTEMPTS && placed.empty(); attempt++) {
+        PlacedSite first = candidate(low + glm::vec2(unit(random), unit(random)) * size);
+        if (fits(first)) add(first);
+    }
+    
+    // === SPREAD FROM THE ACTIVE SITES ===
+    // A candidate lands just past touching its parent (the sum of their
+    // radii), the attempts stepping around the parent from a random angle:
+    // rather than Bridson's ring out to twice the reach, which packs as
+    // tightly only with several times the attempts. A parent that finds no
+    // room retires
+    const float step = 6.2831853f / PLACEMENT_ATTEMPTS;
+    const glm::vec2 turn(std::cos(step), std::sin(step));
+    while (!active.empty()) {
+        const size_t slot = random() % active.size();
+        const PlacedSite parent = placed[active[slot]];
+        const float start = 6.2831853f * unit(random);
+        glm::vec2 direction(std::cos(start), std::sin(start));
+        bool found = false;
+        for (int attempt = 0; attempt < PLACEMENT_ATTEMPTS && !found; attempt++) {
+            PlacedSite site = candidate(parent.position);
+            site.position += direction * ((parent.radius + site.radius) * PLACEMENT_MARGIN);
+            direction = glm::vec2(direction.x * turn.x - direction.y * turn.y,
+                                  direction.x * turn.y + direction.y * turn.x);
+            if (fits(site)) {
+                add(site);
+                found = true;
+            }
+        }
+        if (!found) {
+            active[slot] = active.back();
+            active.pop_back();
+        }
+    }
+}
+
+float TreePlacement::crownRadius(const Tree& tree) {
+    float reach = 0.0f;
+    for (const TreeBranch& branch : tree.getBranches()) {
+        reach = std::max(reach, glm::length(glm::vec2(branch.end.x, branch.end.z)) + branch.radius);
+    }
+    for (const TreeLeaf& leaf : tree.getLeaves()) {
+        reach = std::max(reach, glm::length(glm::vec2(leaf.position.x, leaf.position.z)) + 0.5f * leaf.size);
+    }
+    return reach;
+}
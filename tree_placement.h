@@ -0,0 +1,66 @@
+#ifndef TREE_PLACEMENT_H
+#define TREE_PLACEMENT_H
+
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <vector>
+
+class Tree;
+
+// One planted tree: where its origin goes on the ground plane, how large
+// it is and which kind (a forest archetype) it is
+struct TreeSite {
+    glm::vec2 position; // (x, z)
+    float scale;
+    int kind;
+};
+
+// Poisson-disk placement of trees (Bridson's algorithm): sites spread from
+// a first one, each new one tried in the ring just past an active site's
+// reach and kept when no placed crown is too near, which a background grid
+// of cells one site wide answers from a few cells. Every kind has its own
+// crown radius, scaled with the tree, and two trees stay the sum of their
+// radii apart (times the spacing), so crowns don't overlap. O(n) in the
+// trees placed; a place() call holds its own grid, so any number may run
+// at once.
+//
+// Every crown lies inside the rectangle placed over, so neighbouring
+// rectangles (world chunks) placed independently never overlap either. A
+// density map thins the finished sites, keeping each with the map's value
+// where it stands: thinning keeps the spacing, where sampling more sparsely
+// would let the gaps refill
+class TreePlacement {
+public:
+    // Share of the sites kept at (x, z), 0 to 1
+    typedef std::function<float(float x, float z)> DensityMap;
+    
+    TreePlacement();
+    
+    // Crown radius of each kind at scale 1 (crownRadius() of its archetype)
+    void setKinds(const std::vector<float>& crown_radii) { kind_radii = crown_radii; }
+    int getKindCount() const { return kind_radii.size(); }
+    // Each tree's scale, uniform in [min_scale, max_scale]
+    void setScaleRange(float min_scale, float max_scale);
+    // Exclusion radii are the crowns' times spacing: 1 = crowns just touch,
+    // below 1 they overlap
+    void setSpacing(float factor) { spacing = factor; }
+    // null keeps every site
+    void setDensity(const DensityMap& map) { density = map; }
+    
+    // Append the sites placed over [low, high) from seed; the same
+    // settings and seed place the same sites
+    void place(const glm::vec2& low, const glm::vec2& high, uint32_t seed, std::vector<TreeSite>& sites) const;
+    
+    // Farthest a tree's branch ends and leaves reach from its vertical axis
+    static float crownRadius(const Tree& tree);
+
+private:
+    std::vector<float> kind_radii;
+    float min_scale;
+    float max_scale;
+    float spacing;
+    DensityMap density;
+};
+
+#endif // TREE_PLACEMENT_H
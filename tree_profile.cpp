@@ -0,0 +1,132 @@
+#include "tree_profile.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+static std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+static bool readText(const std::string& path, std::string& text) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) return false;
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    text = contents.str();
+    return true;
+}
+
+// === PARSING ===
+
+bool TreeProfiles::parse(const std::string& source, std::string& error) {
+    const TreeParameters defaults = Tree().getParameters();
+    std::map<std::string, TreeParameters> parsed;
+    TreeParameters* current = nullptr;
+    std::istringstream lines(source);
+    std::string raw;
+    int line_number = 0;
+    while (std::getline(lines, raw)) {
+        line_number++;
+        const std::string line = trim(raw.substr(0, raw.find('#')));
+        if (line.empty()) continue;
+        const std::string where = "line " + std::to_string(line_number) + ": ";
+        
+        // === [name] ===
+        if (line[0] == '[') {
+            const std::string name = trim(line.substr(1, line.size() - 2));
+            if (line[line.size() - 1] != ']' || name.empty()) {
+                error = where + "expected [name]";
+                return false;
+            }
+            if (parsed.count(name)) {
+                error = where + "profile " + name + " is defined twice";
+                return false;
+            }
+            current = &(parsed[name] = defaults);
+            continue;
+        }
+        
+        // === key = value ===
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            error = where + "expected key = value";
+            return false;
+        }
+        if (!current) {
+            error = where + "a value outside of any [profile]";
+            return false;
+        }
+        const std::string key = trim(line.substr(0, equals));
+        const std::string value = trim(line.substr(equals + 1));
+        char* end = nullptr;
+        const double number = strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0') {
+            error = where + "'" + value + "' is not a number";
+            return false;
+        }
+        if (key == "max_generations" && number >= 0.0 && number <= 16.0 && number == (int)number) {
+            current->max_generations = (int)number;
+        } else if (key == "branch_angle_variance" && number >= 0.0 && number <= 180.0) {
+            current->branch_angle_variance = (float)number;
+        } else if (key == "length_reduction_factor" && number > 0.0 && number <= 1.0) {
+            current->length_reduction_factor = (float)number;
+        } else if (key == "radius_reduction_factor" && number > 0.0 && number <= 1.0) {
+            current->radius_reduction_factor = (float)number;
+        } else if (key == "max_growth_time" && number > 0.0) {
+            current->max_growth_time = (float)number;
+        } else if (key == "max_generations" || key == "branch_angle_variance" || key == "length_reduction_factor" ||
+                   key == "radius_reduction_factor" || key == "max_growth_time") {
+            error = where + value + " is out of range for " + key;
+            return false;
+        } else {
+            error = where + "unknown key " + key;
+            return false;
+        }
+    }
+    profiles.swap(parsed);
+    return true;
+}
+
+// === FILES ===
+
+bool TreeProfiles::load(const std::string& file, std::string& error) {
+    path = file;
+    if (!readText(path, text)) {
+        text.clear();
+        error = "cannot open " + path;
+        return false;
+    }
+    if (!parse(text, error)) {
+        error = path + ", " + error;
+        return false;
+    }
+    return true;
+}
+
+bool TreeProfiles::reloadIfChanged(std::string& error) {
+    std::string current;
+    // A file missing for a moment (an editor replacing it) is no change
+    if (path.empty() || !readText(path, current) || current == text) return false;
+    text.swap(current);
+    if (!parse(text, error)) {
+        error = path + ", " + error;
+        return false;
+    }
+    return true;
+}
+
+TreeParameters TreeProfiles::get(const std::string& name, const TreeParameters& fallback) const {
+    auto profile = profiles.find(name);
+    return profile != profiles.end() ? profile->second : fallback;
+}
+
+std::vector<std::string> TreeProfiles::getNames() const {
+    std::vector<std::string> names;
+    for (const auto& profile : profiles) {
+        names.push_back(profile.first);
+    }
+    return names;
+}
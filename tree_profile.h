@@ -0,0 +1,54 @@
+#ifndef TREE_PROFILE_H
+#define TREE_PROFILE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "tree_simple.h"
+
+// Named sets of TreeParameters read from a small text file, so the shape
+// of a species can be tuned while the program runs:
+//
+//   # comments and blank lines are skipped
+//   [oak]
+//   max_generations = 7
+//   branch_angle_variance = 25
+//   length_reduction_factor = 0.72
+//   radius_reduction_factor = 0.6
+//   max_growth_time = 40
+//
+// A key a profile leaves out keeps the built-in value (Tree's
+// constructor). reloadIfChanged() reads the file again and compares it
+// with what was parsed last: profile files are a few lines, and unlike a
+// modification time that catches two saves within the same second
+class TreeProfiles {
+public:
+    // Replace the profiles with those of text; on failure they stay as they
+    // were and error names the line
+    bool parse(const std::string& text, std::string& error);
+    // Read path, and remember it for reloadIfChanged()
+    bool load(const std::string& path, std::string& error);
+    // True when the file changed since it was last read and parsed again.
+    // A change that doesn't parse returns false with error set, once, and
+    // keeps the profiles in use
+    bool reloadIfChanged(std::string& error);
+    
+    bool has(const std::string& name) const { return profiles.count(name) > 0; }
+    // The profile's parameters, or fallback when there is none
+    TreeParameters get(const std::string& name, const TreeParameters& fallback) const;
+    std::vector<std::string> getNames() const;
+    const std::string& getPath() const { return path; }
+
+private:
+    std::map<std::string, TreeParameters> profiles;
+    std::string path;
+    std::string text; // As last read, parsed or not
+};
+
+inline bool sameTreeParameters(const TreeParameters& a, const TreeParameters& b) {
+    return a.max_generations == b.max_generations && a.branch_angle_variance == b.branch_angle_variance &&
+           a.length_reduction_factor == b.length_reduction_factor &&
+           a.radius_reduction_factor == b.radius_reduction_factor && a.max_growth_time == b.max_growth_time;
+}
+
+#endif // TREE_PROFILE_H
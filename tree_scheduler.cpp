@@ -0,0 +1,117 @@
+#include "tree_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+GrowthScheduler::GrowthScheduler()
+    : growth_time(0.0f), budget_us(0), eye(0.0f), fov_y(glm::radians(50.0f)),
+      last_updated(0), last_stale(0), last_spent_us(0.0f) {}
+
+int GrowthScheduler::add(std::unique_ptr<Tree> tree, const glm::mat4& transform) {
+    Entry entry;
+    entry.tree = std::move(tree);
+    entry.transform = transform;
+    entry.center = glm::vec3(0.0f);
+    entry.radius = 0.0f;
+    entry.priority = 0.0f;
+    entry.frames_waiting = 0;
+    entry.cost_us = 0.0f;
+    entries.push_back(std::move(entry));
+    updateBounds(entries.size() - 1);
+    return entries.size() - 1;
+}
+
+void GrowthScheduler::clear() {
+    entries.clear();
+    stale.clear();
+    last_updated = 0;
+    last_stale = 0;
+    last_spent_us = 0.0f;
+}
+
+void GrowthScheduler::updateBounds(int k) {
+    // Box around the grown tree in its own space, then the sphere through
+    // its corners placed and scaled by the transform
+    Entry& entry = entries[k];
+    const std::vector<TreeBranch>& branches = entry.tree->getBranches();
+    const std::vector<TreeLeaf>& leaves = entry.tree->getLeaves();
+    glm::vec3 low(std::numeric_limits<float>::max());
+    glm::vec3 high(-std::numeric_limits<float>::max());
+    for (const TreeBranch& branch : branches) {
+        low = glm::min(low, glm::min(branch.start, branch.end));
+        high = glm::max(high, glm::max(branch.start, branch.end));
+    }
+    float leaf_reach = 0.0f;
+    for (const TreeLeaf& leaf : leaves) {
+        low = glm::min(low, leaf.position);
+        high = glm::max(high, leaf.position);
+        leaf_reach = std::max(leaf_reach, 0.5f * leaf.size);
+    }
+    if (branches.empty() && leaves.empty()) {
+        low = high = glm::vec3(0.0f);
+    }
+    
+    const glm::mat4& m = entry.transform;
+    float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+    entry.center = glm::vec3(m * glm::vec4(0.5f * (low + high), 1.0f));
+    entry.radius = (0.5f * glm::length(high - low) + leaf_reach) * scale;
+}
+
+float GrowthScheduler::projectedSize(const Entry& entry) const {
+    // Fraction of the viewport height the bounds span, as Tree::getProjectedSize
+    float distance = glm::length(eye - entry.center);
+    if (distance <= entry.radius) {
+        return std::numeric_limits<float>::max();
+    }
+    return entry.radius / (distance * tanf(0.5f * fov_y));
+}
+
+int GrowthScheduler::update() {
+    typedef std::chrono::steady_clock Clock;
+    
+    // === STALE TREES BY PRIORITY ===
+    // Waiting multiplies the claim, so a small tree overtakes a large one
+    // after enough skipped frames; ties go to the lower index
+    stale.clear();
+    for (int k = 0; k < static_cast<int>(entries.size()); k++) {
+        Entry& entry = entries[k];
+        if (entry.tree->getGrowthTime() == growth_time) {
+            entry.frames_waiting = 0;
+            continue;
+        }
+        float size = std::min(projectedSize(entry), 1e6f);
+        entry.priority = size * (1 + entry.frames_waiting);
+        stale.push_back(k);
+    }
+    std::stable_sort(stale.begin(), stale.end(),
+                     [this](int a, int b) { return entries[a].priority > entries[b].priority; });
+    
+    // === UPDATE WITHIN THE BUDGET ===
+    // A tree whose estimated cost no longer fits is passed over for cheaper
+    // ones further down; the first is updated whatever it costs
+    float spent_us = 0.0f;
+    int updated = 0;
+    for (int k : stale) {
+        Entry& entry = entries[k];
+        float remaining = budget_us - spent_us;
+        if (budget_us > 0 && updated > 0 && (remaining <= 0.0f || entry.cost_us > remaining)) {
+            entry.frames_waiting++;
+            continue;
+        }
+        
+        Clock::time_point start = Clock::now();
+        entry.tree->setGrowthTime(growth_time);
+        float cost = std::chrono::duration<float, std::micro>(Clock::now() - start).count();
+        
+        entry.cost_us = (entry.cost_us > 0.0f) ? 0.75f * entry.cost_us + 0.25f * cost : cost;
+        entry.frames_waiting = 0;
+        spent_us += cost;
+        updated++;
+    }
+    
+    last_updated = updated;
+    last_stale = stale.size() - updated;
+    last_spent_us = spent_us;
+    return updated;
+}
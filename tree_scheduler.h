@@ -0,0 +1,82 @@
+#ifndef TREE_SCHEDULER_H
+#define TREE_SCHEDULER_H
+
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+#include "tree_simple.h"
+
+// Grows many trees on one clock within a CPU time budget per frame. Every
+// tree follows the same growth time; update() brings the stale trees up to
+// it in priority order - projected size from the camera, multiplied by the
+// frames a tree has waited so distant trees still advance - and stops once
+// the budget is spent. A tree that was skipped lags behind and catches up in
+// one setGrowthTime jump later, so frame time stays flat as the tree count
+// grows while near trees animate every frame
+class GrowthScheduler {
+private:
+    struct Entry {
+        std::unique_ptr<Tree> tree;
+        glm::mat4 transform;
+        glm::vec3 center; // World-space bounding sphere of the grown tree
+        float radius;
+        float priority;
+        int frames_waiting; // Frames it has stayed stale since its last update
+        float cost_us;      // Running estimate of one update, 0 until measured
+    };
+    std::vector<Entry> entries;
+    std::vector<int> stale; // Scratch: trees behind the clock, in priority order
+    
+    float growth_time;
+    int budget_us; // 0 = unbounded
+    glm::vec3 eye;
+    float fov_y;
+    
+    // Report of the last update()
+    int last_updated;
+    int last_stale;
+    float last_spent_us;
+    
+    float projectedSize(const Entry& entry) const;
+
+public:
+    GrowthScheduler();
+    
+    // Take ownership of a generated tree placed by transform; returns its index.
+    // The tree's clock is pulled to the scheduler's by later updates
+    int add(std::unique_ptr<Tree> tree, const glm::mat4& transform = glm::mat4(1.0f));
+    void clear();
+    int getTreeCount() const { return entries.size(); }
+    Tree& getTree(int k) { return *entries[k].tree; }
+    const Tree& getTree(int k) const { return *entries[k].tree; }
+    const glm::mat4& getTransform(int k) const { return entries[k].transform; }
+    // Recompute tree k's bounds after its structure changed (regenerateSubtree,
+    // lazy detail)
+    void updateBounds(int k);
+    
+    // Microseconds of growth and mesh updates per update() call (0 = no limit).
+    // The tree with the highest priority is always updated, so a single
+    // update larger than the budget cannot stall the clock
+    void setBudget(int microseconds) { budget_us = microseconds < 0 ? 0 : microseconds; }
+    int getBudget() const { return budget_us; }
+    
+    // Eye position in world space and vertical field of view in radians
+    void setCamera(const glm::vec3& position, float fov) { eye = position; fov_y = fov; }
+    
+    // The shared growth clock; update() moves the trees to it
+    void advance(float dt) { growth_time += dt; }
+    void setGrowthTime(float time) { growth_time = std::max(0.0f, time); }
+    float getGrowthTime() const { return growth_time; }
+    
+    // Bring trees to the growth time, most important first, until the budget
+    // is spent. Returns the number of trees updated
+    int update();
+    
+    // Seconds tree k is behind the shared clock
+    float getLag(int k) const { return growth_time - entries[k].tree->getGrowthTime(); }
+    int getLastUpdatedCount() const { return last_updated; }
+    int getLastStaleCount() const { return last_stale; }
+    float getLastUpdateMicroseconds() const { return last_spent_us; }
+};
+
+#endif // TREE_SCHEDULER_H
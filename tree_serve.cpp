@@ -0,0 +1,313 @@
+// Tree generation server (tree_service.h): answers generation requests with
+// tree asset files over a pipe or TCP.
+//
+//   tree_serve --stdio [--cache MB] [--max-generations N] [--max-branches N]
+//
+// reads requests from stdin and writes the responses to stdout, for a
+// parent process that spawned it;
+//
+//   tree_serve --port P [--host ADDR] [--cache MB] ...
+//
+// listens on ADDR (default 127.0.0.1) and serves each connection on its own
+// thread, every one sharing the cache (default 256 MB). Requests for more
+// than --max-generations (default 9) are refused and every tree is kept
+// under --max-branches (default 200000).
+//
+//   tree_serve --fetch HOST:PORT [--seed S] [--lods 12,8,4] [--no-mesh] [--encoded] prefix
+//
+// is the client: one request, the levels written to prefix_SEED_lodK.tree
+// (--encoded asks for their meshes encoded, several times smaller);
+//
+//   tree_serve --shm NAME [--seed S] [--count N] [--slot-mb MB] [--encoded]
+//
+// is a generator for a renderer on the same machine: N trees (default 1)
+// from seed S on, GPU-animated, saved straight into the shared-memory ring
+// NAME (tree_handoff.h) for tree_demo --handoff NAME to take
+#include "tree_handoff.h"
+#include "tree_service.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// === FRAMES ===
+
+// False at end of input or on an error; a short read at the end is an error
+static bool readAll(int fd, void* data, size_t bytes) {
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t n = read(fd, p, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const void* data, size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = write(fd, p, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+// Requests from in answered on out until either end closes
+static void serveConnection(TreeService& service, int in, int out) {
+    TreeServiceRequest request;
+    TreeServiceResponse response;
+    std::vector<TreeService::Asset> assets;
+    std::string message;
+    while (readAll(in, &request, sizeof(request))) {
+        service.handle(request, response, assets, message);
+        bool written = writeAll(out, &response, sizeof(response));
+        for (const TreeService::Asset& asset : assets) {
+            written = written && writeAll(out, asset->data(), asset->size());
+        }
+        written = written && writeAll(out, message.data(), message.size());
+        if (!written || memcmp(request.magic, TREE_SERVICE_REQUEST_MAGIC, sizeof(request.magic)) != 0 ||
+            request.version != TREE_SERVICE_VERSION) {
+            break;
+        }
+    }
+}
+
+// === SOCKETS ===
+
+static int connectTo(const std::string& host, const std::string& port) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) return -1;
+    int fd = -1;
+    for (addrinfo* address = found; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+static int listenOn(const std::string& host, int port) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) return -1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// === CLIENT ===
+
+static int fetch(const std::string& server, uint64_t seed, const std::string& lods, bool mesh, bool encoded,
+                 const std::string& prefix) {
+    TreeServiceRequest request = makeTreeServiceRequest(seed);
+    if (!mesh) request.flags &= ~TREE_SERVICE_MESH;
+    if (mesh && encoded) request.flags |= TREE_SERVICE_ENCODED_MESH;
+    if (!lods.empty()) {
+        // One level per listed max; min stays the default's, capped at it
+        const int min_segments = request.lods[0].min_ring_segments;
+        std::stringstream list(lods);
+        std::string item;
+        request.lod_count = 0;
+        while (std::getline(list, item, ',') && request.lod_count < (uint32_t)TREE_SERVICE_MAX_LODS) {
+            TreeServiceLod& lod = request.lods[request.lod_count++];
+            lod.max_ring_segments = atoi(item.c_str());
+            lod.min_ring_segments = std::min(min_segments, lod.max_ring_segments);
+        }
+    }
+    const size_t colon = server.rfind(':');
+    const int fd = colon == std::string::npos ? -1 : connectTo(server.substr(0, colon), server.substr(colon + 1));
+    if (fd < 0) {
+        std::cerr << "Cannot connect to " << server << std::endl;
+        return 1;
+    }
+    TreeServiceResponse response;
+    if (!writeAll(fd, &request, sizeof(request)) || !readAll(fd, &response, sizeof(response)) ||
+        memcmp(response.magic, TREE_SERVICE_RESPONSE_MAGIC, sizeof(response.magic)) != 0 ||
+        response.asset_count > (uint32_t)TREE_SERVICE_MAX_LODS) {
+        std::cerr << "No response from " << server << std::endl;
+        close(fd);
+        return 1;
+    }
+    int result = 0;
+    std::string bytes;
+    for (uint32_t k = 0; k < response.asset_count && result == 0; k++) {
+        bytes.resize(response.asset_bytes[k]);
+        if (!readAll(fd, &bytes[0], bytes.size())) {
+            std::cerr << "Connection lost" << std::endl;
+            result = 1;
+            break;
+        }
+        const std::string path = prefix + "_" + std::to_string(seed) + "_lod" + std::to_string(k) + ".tree";
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out.write(bytes.data(), bytes.size())) {
+            std::cerr << "Cannot write " << path << std::endl;
+            result = 1;
+            break;
+        }
+        std::cout << path << ": " << bytes.size() << " bytes" << std::endl;
+    }
+    if (result == 0 && response.status != static_cast<uint32_t>(TreeServiceStatus::Ok)) {
+        bytes.resize(response.message_bytes);
+        if (!bytes.empty()) readAll(fd, &bytes[0], bytes.size());
+        std::cerr << "Request failed: " << bytes << std::endl;
+        result = 1;
+    } else if (result == 0) {
+        std::cout << response.asset_count << " levels, " << response.cached_count << " from the cache" << std::endl;
+    }
+    close(fd);
+    return result;
+}
+
+// === SHARED-MEMORY HAND-OFF ===
+
+static const int HANDOFF_SLOTS = 4;
+
+// Generate count trees into the ring name, waiting while the renderer holds
+// every slot, then until it has taken the last: closing unlinks the name
+static int handOff(const std::string& name, uint64_t seed, int count, size_t slot_mb, bool encoded,
+                   const TreeBudget& budget) {
+    TreeHandoffRing ring;
+    std::string error;
+    if (!ring.create(name, HANDOFF_SLOTS, slot_mb << 20, error)) {
+        std::cerr << "Cannot create the ring: " << error << std::endl;
+        return 1;
+    }
+    std::cerr << "Handing off " << count << " trees through " << name << std::endl;
+    for (int k = 0; k < count; k++) {
+        Tree tree;
+        tree.setVerbosity(0);
+        tree.setBudget(budget);
+        tree.setMeshAnimation(MeshAnimation::Gpu);
+        tree.generate(seed + k);
+        while (!ring.beginWrite()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (!ring.write(tree, error, true, encoded)) {
+            std::cerr << "Cannot hand off seed " << seed + k << ": " << error << std::endl;
+            return 1;
+        }
+        std::cout << "seed " << seed + k << " handed off" << std::endl;
+    }
+    size_t bytes;
+    uint64_t sequence;
+    while (ring.peek(bytes, sequence)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return 0;
+}
+
+// === SERVER ===
+
+int main(int argc, char** argv) {
+    bool stdio = false;
+    int port = 0;
+    std::string host = "127.0.0.1";
+    size_t cache_mb = 256;
+    int max_generations = 9;
+    TreeBudget budget;
+    budget.max_branches = 200000;
+    std::string server;
+    uint64_t seed = 1;
+    std::string lods;
+    bool mesh = true;
+    bool encoded = false;
+    std::string ring;
+    int count = 1;
+    size_t slot_mb = 64;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--stdio") stdio = true;
+        else if (arg == "--port" && i + 1 < argc) port = atoi(argv[++i]);
+        else if (arg == "--host" && i + 1 < argc) host = argv[++i];
+        else if (arg == "--cache" && i + 1 < argc) cache_mb = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--max-generations" && i + 1 < argc) max_generations = atoi(argv[++i]);
+        else if (arg == "--max-branches" && i + 1 < argc) budget.max_branches = atoi(argv[++i]);
+        else if (arg == "--fetch" && i + 1 < argc) server = argv[++i];
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--lods" && i + 1 < argc) lods = argv[++i];
+        else if (arg == "--no-mesh") mesh = false;
+        else if (arg == "--encoded") encoded = true;
+        else if (arg == "--shm" && i + 1 < argc) ring = argv[++i];
+        else if (arg == "--count" && i + 1 < argc) count = atoi(argv[++i]);
+        else if (arg == "--slot-mb" && i + 1 < argc) slot_mb = strtoull(argv[++i], nullptr, 10);
+        else files.push_back(arg);
+    }
+    if (!server.empty() && files.size() == 1) return fetch(server, seed, lods, mesh, encoded, files[0]);
+    if (!ring.empty() && files.empty()) return handOff(ring, seed, count, slot_mb, encoded, budget);
+    if (stdio == (port > 0) || !files.empty() || !server.empty()) {
+        std::cout << "Usage: " << argv[0] << " --stdio [--cache MB] [--max-generations N] [--max-branches N]"
+                  << std::endl
+                  << "       " << argv[0] << " --port P [--host ADDR] [--cache MB] [--max-generations N]"
+                  << " [--max-branches N]" << std::endl
+                  << "       " << argv[0] << " --fetch HOST:PORT [--seed S] [--lods 12,8,4] [--no-mesh] [--encoded] prefix"
+                  << std::endl
+                  << "       " << argv[0] << " --shm NAME [--seed S] [--count N] [--slot-mb MB] [--encoded]"
+                  << std::endl;
+        return 1;
+    }
+    // A client gone mid-response is a failed write, not the end of the server
+    signal(SIGPIPE, SIG_IGN);
+    TreeService service(cache_mb << 20, max_generations, budget);
+    
+    if (stdio) {
+        serveConnection(service, STDIN_FILENO, STDOUT_FILENO);
+        std::cerr << service.getRequests() << " requests, " << service.getGenerated() << " levels generated, "
+                  << service.getCacheHits() << " from the cache" << std::endl;
+        return 0;
+    }
+    
+    const int listener = listenOn(host, port);
+    if (listener < 0) {
+        std::cerr << "Cannot listen on " << host << ":" << port << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    std::cerr << "Serving trees on " << host << ":" << port << std::endl;
+    for (;;) {
+        const int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "accept: " << strerror(errno) << std::endl;
+            break;
+        }
+        std::thread([&service, client]() {
+            serveConnection(service, client, client);
+            close(client);
+        }).detach();
+    }
+    close(listener);
+    return 1;
+}
@@ -0,0 +1,292 @@
+#include "tree_service.h"
+#include "profiler.h"
+#include "tree_async.h"
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+TreeServiceRequest makeTreeServiceRequest(uint64_t seed) {
+    TreeServiceRequest request;
+    memset(&request, 0, sizeof(request));
+    memcpy(request.magic, TREE_SERVICE_REQUEST_MAGIC, sizeof(request.magic));
+    request.version = TREE_SERVICE_VERSION;
+    request.flags = TREE_SERVICE_MESH;
+    request.seed = seed;
+    Tree defaults;
+    request.parameters = defaults.getParameters();
+    request.twig_depth = defaults.getTwigDepth();
+    request.twig_prototype_count = defaults.getTwigPrototypeCount();
+    request.lod_count = 1;
+    defaults.getRingSegmentRange(request.lods[0].min_ring_segments, request.lods[0].max_ring_segments);
+    return request;
+}
+
+TreeService::TreeService(size_t budget, int generations, const TreeBudget& limits)
+    : cache_budget(budget), max_generations(generations), tree_budget(limits), cache_bytes(0), requests(0),
+      generated_levels(0), cache_hits(0) {}
+
+// === REQUESTS ===
+
+// Everything level lod of request is generated from, with no padding, so
+// equal requests hash equal
+struct TreeServiceLevel {
+    uint64_t seed;
+    int32_t max_generations;
+    float branch_angle_variance;
+    float length_reduction_factor;
+    float radius_reduction_factor;
+    float max_growth_time;
+    int32_t twig_depth;
+    int32_t twig_prototype_count;
+    int32_t min_ring_segments;
+    int32_t max_ring_segments;
+    uint32_t flags;
+};
+
+static uint64_t levelKey(const TreeServiceRequest& request, int lod) {
+    TreeServiceLevel level;
+    memset(&level, 0, sizeof(level));
+    level.seed = request.seed;
+    level.max_generations = request.parameters.max_generations;
+    level.branch_angle_variance = request.parameters.branch_angle_variance;
+    level.length_reduction_factor = request.parameters.length_reduction_factor;
+    level.radius_reduction_factor = request.parameters.radius_reduction_factor;
+    level.max_growth_time = request.parameters.max_growth_time;
+    level.twig_depth = request.twig_depth;
+    level.twig_prototype_count = request.twig_depth > 0 ? request.twig_prototype_count : 0;
+    level.min_ring_segments = request.lods[lod].min_ring_segments;
+    level.max_ring_segments = request.lods[lod].max_ring_segments;
+    level.flags = request.flags & (TREE_SERVICE_MESH | TREE_SERVICE_ENCODED_MESH);
+    
+    // FNV-1a
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(&level);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(level); i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string TreeService::validate(const TreeServiceRequest& request) const {
+    if (memcmp(request.magic, TREE_SERVICE_REQUEST_MAGIC, sizeof(request.magic)) != 0) return "not a request";
+    if (request.version != TREE_SERVICE_VERSION) return "unsupported protocol version";
+    const std::string parameters_error = checkTreeParameters(request.parameters, max_generations);
+    if (!parameters_error.empty()) return parameters_error;
+    if (request.twig_depth < 0 || (request.twig_depth > 0 && (request.twig_prototype_count < 1 ||
+                                                               request.twig_prototype_count > 64))) {
+        return "twig prototypes must be 1 to 64";
+    }
+    if (request.lod_count < 1 || request.lod_count > (uint32_t)TREE_SERVICE_MAX_LODS) {
+        return "lod_count must be 1 to " + std::to_string(TREE_SERVICE_MAX_LODS);
+    }
+    for (uint32_t k = 0; k < request.lod_count; k++) {
+        const TreeServiceLod& lod = request.lods[k];
+        if (lod.min_ring_segments < Tree::MIN_RING_SEGMENTS || lod.max_ring_segments > Tree::MAX_RING_SEGMENTS ||
+            lod.min_ring_segments > lod.max_ring_segments) {
+            return "ring segments must be " + std::to_string(Tree::MIN_RING_SEGMENTS) + " to " +
+                   std::to_string(Tree::MAX_RING_SEGMENTS) + ", min at most max";
+        }
+    }
+    return "";
+}
+
+// One level's job: generate, then write the asset to bytes
+struct GeneratedLevel {
+    std::string bytes;
+    std::string error;
+    bool saved;
+    
+    GeneratedLevel() : saved(false) {}
+};
+
+static void generateLevel(Tree& tree, uint64_t seed, bool include_mesh, bool encode_mesh, GeneratedLevel& level) {
+    if (include_mesh) tree.generate(seed);
+    else tree.generateStructure(seed);
+    std::ostringstream out;
+    level.saved = tree.save(out, level.error, include_mesh, encode_mesh);
+    if (level.saved) level.bytes = out.str();
+}
+
+std::unique_ptr<Tree> TreeService::makeTree(const TreeServiceRequest& request, int lod) const {
+    std::unique_ptr<Tree> tree(new Tree());
+    tree->setParameters(request.parameters);
+    tree->setTwigInstancing(request.twig_depth, request.twig_prototype_count);
+    tree->setRingSegmentRange(request.lods[lod].min_ring_segments, request.lods[lod].max_ring_segments);
+    tree->setBudget(tree_budget);
+    // stdout may be the wire
+    tree->setVerbosity(0);
+    // Assets with meshes carry the GPU-animated ones, which are what a
+    // loader can upload as they are
+    if (request.flags & TREE_SERVICE_MESH) tree->setMeshAnimation(MeshAnimation::Gpu);
+    return tree;
+}
+
+void TreeService::handle(const TreeServiceRequest& request, TreeServiceResponse& response, std::vector<Asset>& assets,
+                         std::string& message) {
+    PROFILE_SCOPE("TreeService::handle");
+    memset(&response, 0, sizeof(response));
+    memcpy(response.magic, TREE_SERVICE_RESPONSE_MAGIC, sizeof(response.magic));
+    response.version = TREE_SERVICE_VERSION;
+    response.request_id = request.request_id;
+    assets.clear();
+    message = validate(request);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests++;
+    }
+    if (!message.empty()) {
+        response.status = static_cast<uint32_t>(TreeServiceStatus::BadRequest);
+        response.message_bytes = message.size();
+        return;
+    }
+    
+    // === CLAIM: CACHED LEVELS NOW, MISSING ONES FOR THIS CALLER ===
+    // A level some other caller is generating is left for after ours
+    const int lod_count = request.lod_count;
+    std::vector<uint64_t> keys(lod_count);
+    std::vector<int> claimed;
+    assets.resize(lod_count);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int k = 0; k < lod_count; k++) {
+            keys[k] = levelKey(request, k);
+            assets[k] = find(keys[k]);
+            if (assets[k]) {
+                response.cached_count++;
+                cache_hits++;
+            } else if (pending.insert(keys[k]).second) {
+                claimed.push_back(k);
+            }
+        }
+    }
+    
+    // === GENERATE THE CLAIMED LEVELS, ALL AT ONCE ===
+    // Generation and serialization both run in the jobs
+    std::vector<GeneratedLevel> levels(claimed.size());
+    std::vector<TreeGenerationJob> jobs;
+    jobs.reserve(claimed.size());
+    const bool include_mesh = (request.flags & TREE_SERVICE_MESH) != 0;
+    const bool encode_mesh = (request.flags & TREE_SERVICE_ENCODED_MESH) != 0;
+    const uint64_t seed = request.seed;
+    for (size_t c = 0; c < claimed.size(); c++) {
+        GeneratedLevel* level = &levels[c];
+        jobs.emplace_back(makeTree(request, claimed[c]),
+                          [seed, include_mesh, encode_mesh, level](Tree& tree) {
+                              generateLevel(tree, seed, include_mesh, encode_mesh, *level);
+                          });
+    }
+    for (TreeGenerationJob& job : jobs) {
+        job.take();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t c = 0; c < claimed.size(); c++) {
+            const int k = claimed[c];
+            pending.erase(keys[k]);
+            if (!levels[c].saved) {
+                if (message.empty()) message = levels[c].error;
+                continue;
+            }
+            assets[k] = std::make_shared<const std::string>(std::move(levels[c].bytes));
+            generated_levels++;
+            insert(keys[k], assets[k]);
+        }
+    }
+    generated.notify_all();
+    
+    // === WAIT FOR THE LEVELS OTHERS CLAIMED ===
+    // One gone by the time the wait ends (failed, or already evicted) is
+    // generated here after all
+    for (int k = 0; k < lod_count && message.empty(); k++) {
+        if (assets[k]) continue;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            generated.wait(lock, [&]() { return pending.count(keys[k]) == 0; });
+            assets[k] = find(keys[k]);
+            if (assets[k]) {
+                response.cached_count++;
+                cache_hits++;
+                continue;
+            }
+            pending.insert(keys[k]);
+        }
+        GeneratedLevel level;
+        TreeGenerationJob job(makeTree(request, k),
+                              [seed, include_mesh, encode_mesh, &level](Tree& tree) {
+                                  generateLevel(tree, seed, include_mesh, encode_mesh, level);
+                              });
+        job.take();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.erase(keys[k]);
+            if (level.saved) {
+                assets[k] = std::make_shared<const std::string>(std::move(level.bytes));
+                generated_levels++;
+                insert(keys[k], assets[k]);
+            } else {
+                message = level.error;
+            }
+        }
+        generated.notify_all();
+    }
+    
+    if (!message.empty()) {
+        assets.clear();
+        response.status = static_cast<uint32_t>(TreeServiceStatus::Failed);
+        response.cached_count = 0;
+        response.message_bytes = message.size();
+        return;
+    }
+    response.status = static_cast<uint32_t>(TreeServiceStatus::Ok);
+    response.asset_count = lod_count;
+    for (int k = 0; k < lod_count; k++) {
+        response.asset_bytes[k] = assets[k]->size();
+    }
+}
+
+// === CACHE ===
+
+TreeService::Asset TreeService::find(uint64_t key) {
+    auto entry = cache.find(key);
+    if (entry == cache.end()) return nullptr;
+    uses.splice(uses.begin(), uses, entry->second.use);
+    return entry->second.asset;
+}
+
+void TreeService::insert(uint64_t key, const Asset& asset) {
+    // An asset larger than the whole budget is served but not kept
+    if (asset->size() > cache_budget || cache.count(key)) return;
+    while (cache_bytes + asset->size() > cache_budget && !uses.empty()) {
+        auto oldest = cache.find(uses.back());
+        cache_bytes -= oldest->second.asset->size();
+        cache.erase(oldest);
+        uses.pop_back();
+    }
+    uses.push_front(key);
+    Entry entry = { asset, uses.begin() };
+    cache[key] = entry;
+    cache_bytes += asset->size();
+}
+
+// === STATISTICS ===
+
+uint64_t TreeService::getRequests() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requests;
+}
+
+uint64_t TreeService::getGenerated() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return generated_levels;
+}
+
+uint64_t TreeService::getCacheHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache_hits;
+}
+
+size_t TreeService::getCacheBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache_bytes;
+}
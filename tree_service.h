@@ -0,0 +1,142 @@
+#ifndef TREE_SERVICE_H
+#define TREE_SERVICE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "tree_simple.h"
+
+// Tree generation as a service: requests for a seed, shape parameters and
+// a set of detail levels come in, tree asset files (tree_asset.h) go out,
+// one per level. The wire format is native-endian fixed-size frames, like
+// the asset files themselves:
+//
+//   request:  TreeServiceRequest
+//   response: TreeServiceResponse, then asset_count assets of asset_bytes[k]
+//             bytes each, then message_bytes of error text
+//
+// A connection carries any number of request/response pairs in order. A
+// request that doesn't start with the magic and version ends the
+// connection after its answer, as the frames can't be found again.
+//
+// A level is a ring segment range (Tree::setRingSegmentRange): the
+// structure is the same at every level, the prebuilt GPU meshes in the
+// asset get fewer sides (without TREE_SERVICE_MESH the levels differ only
+// in the range their headers record, for the loader to mesh at). Each level's asset is cached under a hash of
+// everything it is generated from, so a repeated request, or one sharing
+// levels with an earlier one, is answered without generating. The cache
+// holds whole assets up to its byte budget, least recently used out first.
+//
+// Requests come from outside, so the service bounds what one may cost:
+// max_generations above the service's ceiling is a bad request, and every
+// tree is generated under the service's TreeBudget
+
+static const char TREE_SERVICE_REQUEST_MAGIC[4] = {'T', 'R', 'Q', '1'};
+static const char TREE_SERVICE_RESPONSE_MAGIC[4] = {'T', 'R', 'S', '1'};
+static const uint32_t TREE_SERVICE_VERSION = 1;
+static const int TREE_SERVICE_MAX_LODS = 8;
+
+// Request flags
+static const uint32_t TREE_SERVICE_MESH = 1; // Prebuilt index and GPU mesh buffers in the assets
+static const uint32_t TREE_SERVICE_ENCODED_MESH = 2; // ... encoded (mesh_codec.h), with TREE_SERVICE_MESH
+
+enum class TreeServiceStatus : uint32_t {
+    Ok = 0,
+    BadRequest = 1, // Wrong magic or version, or values out of range
+    Failed = 2      // Generation or serialization failed
+};
+
+struct TreeServiceLod {
+    int32_t min_ring_segments;
+    int32_t max_ring_segments;
+};
+
+struct TreeServiceRequest {
+    char magic[4];        // TREE_SERVICE_REQUEST_MAGIC
+    uint32_t version;     // TREE_SERVICE_VERSION
+    uint32_t request_id;  // Echoed in the response
+    uint32_t flags;       // TREE_SERVICE_MESH, TREE_SERVICE_ENCODED_MESH
+    uint64_t seed;
+    TreeParameters parameters;
+    int32_t twig_depth;   // Tree::setTwigInstancing; 0 = off
+    int32_t twig_prototype_count;
+    uint32_t lod_count;   // 1 to TREE_SERVICE_MAX_LODS
+    TreeServiceLod lods[TREE_SERVICE_MAX_LODS];
+};
+
+struct TreeServiceResponse {
+    char magic[4];        // TREE_SERVICE_RESPONSE_MAGIC
+    uint32_t version;
+    uint32_t request_id;
+    uint32_t status;      // TreeServiceStatus
+    uint32_t asset_count; // The request's lod_count when Ok, else 0
+    uint32_t cached_count; // Of those, answered from the cache
+    uint32_t message_bytes;
+    uint32_t reserved;
+    uint64_t asset_bytes[TREE_SERVICE_MAX_LODS];
+};
+
+// A request with the magic, the version and the default tree's settings at
+// full detail
+TreeServiceRequest makeTreeServiceRequest(uint64_t seed);
+
+class TreeService {
+public:
+    typedef std::shared_ptr<const std::string> Asset;
+    
+    TreeService(size_t cache_budget, int max_generations, const TreeBudget& tree_budget);
+    
+    // Answer one request: response filled in, assets[k] level k's file and
+    // message the reason when the status isn't Ok. Thread-safe: levels
+    // missing from the cache are generated as background jobs on the shared
+    // JobSystem, and a level another caller is generating is waited for
+    // rather than generated twice
+    void handle(const TreeServiceRequest& request, TreeServiceResponse& response, std::vector<Asset>& assets,
+                std::string& message);
+    
+    // === STATISTICS ===
+    uint64_t getRequests() const;
+    uint64_t getGenerated() const;  // Levels generated
+    uint64_t getCacheHits() const;  // Levels answered from the cache
+    size_t getCacheBytes() const;
+    size_t getCacheBudget() const { return cache_budget; }
+
+private:
+    struct Entry {
+        Asset asset;
+        std::list<uint64_t>::iterator use; // In uses
+    };
+    
+    size_t cache_budget;
+    int max_generations;
+    TreeBudget tree_budget;
+    mutable std::mutex mutex;
+    std::condition_variable generated; // A pending level finished
+    std::unordered_map<uint64_t, Entry> cache;
+    std::list<uint64_t> uses; // Most recently used first
+    std::unordered_set<uint64_t> pending; // Being generated by some caller
+    size_t cache_bytes;
+    uint64_t requests;
+    uint64_t generated_levels;
+    uint64_t cache_hits;
+    
+    // Why request can't be answered, or "" when it can
+    std::string validate(const TreeServiceRequest& request) const;
+    // A tree set up for level lod of request, to generate
+    std::unique_ptr<Tree> makeTree(const TreeServiceRequest& request, int lod) const;
+    // Under the lock
+    Asset find(uint64_t key);
+    void insert(uint64_t key, const Asset& asset);
+    
+    TreeService(const TreeService&);
+    TreeService& operator=(const TreeService&);
+};
+
+#endif // TREE_SERVICE_H
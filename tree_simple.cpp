@@ -1,9 +1,48 @@
 #include "tree_simple.h"
 #include <random>
 #include <cmath>
-#include <iostream>
+#include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <climits>
+#include <iterator>
+#include <limits>
+#include <queue>
+#include <glm/gtc/packing.hpp>
+#include "tree_jobs.h"
+#include "job_system.h"
+#include "logging.h"
+#include "profiler.h"
 
+// Branching distributions shared by the generator and its capacity estimate
+static const int MIN_CHILDREN = 2;
+static const int MAX_CHILDREN = 4;
+static const int MIN_LEAVES = 6;
+static const int MAX_LEAVES = 14;
+
+// Trunk dimensions; every generation below scales them by the reduction factors
+static const float TRUNK_LENGTH = 3.0f;
+static const float TRUNK_RADIUS = 0.2f;
+
+// Twig prototypes head up at the mean child elevation and draw from fixed
+// streams, so the library depends only on the settings and never on a seed
+static const float TWIG_ELEVATION = 30.0f; // Degrees
+static const uint64_t TWIG_LIBRARY_SEED = 0x7477696773ULL;
+
+// Out-of-class definitions: the constants are also bound to const references
+// (std::min / std::max, conditional operands), which needs storage without -O
+const int Tree::VERTEX_FLOATS;
+const int Tree::MIN_RING_SEGMENTS;
+const int Tree::MAX_RING_SEGMENTS;
+const int Tree::MAX_CURVE_SECTIONS;
+const int Tree::BRANCH_RING_VERTICES;
+const int Tree::BRANCH_SLOT_VERTICES;
+const int Tree::BRANCH_SLOT_INDICES;
+const int Tree::LEAF_SLOT_VERTICES;
+const int Tree::LEAF_SINGLE_SLOT_VERTICES;
+const int Tree::LEAF_SINGLE_SLOT_INDICES;
+const int Tree::GPU_VERTEX_FLOATS;
+const int Tree::GPU_BRANCH_TEXELS;
 
 Tree::Tree() {
     // === TIMING PARAMETERS ===
@@ -11,12 +50,73 @@ Tree::Tree() {
     // This controls how long it takes for the entire tree to fully grow
     max_growth_time = 5.0f;  // 10 seconds total growth time
     current_growth_time = 0.0f;
+    schedule_end_time = max_growth_time;
     max_generations = 6;
     branch_angle_variance = 45.0f; // Degrees of variance for branch angles
     // How much shorter each generation of branches becomes
     length_reduction_factor = 0.8f;  
     // How much thinner each generation of branches becomes
     radius_reduction_factor = 0.7f;
+    // Order of the branches array (parents always precede children in both)
+    branch_layout = BranchLayout::DepthFirst;
+    leaf_layout = LeafLayout::Generation;
+    // Layout of the per-frame hot data
+    storage_mode = TreeStorageMode::StructureOfArrays;
+    seed = 0;
+    // No edits yet
+    first_edit_sequence = 0;
+    // Built-in branching rules unless a grammar or space colonization is chosen
+    generator = TreeGenerator::Branching;
+    // Serial generation; subtrees below generation 2 split off when threaded
+    generation_threads = 0;
+    update_threads = 0;
+    split_generation = 2;
+    // Children placed wherever their angles put them
+    branch_avoidance = false;
+    avoidance_redrawn = 0;
+    avoidance_dropped = 0;
+    // Every branch generated individually; 8 prototypes once enabled
+    twig_depth = 0;
+    twig_prototype_count = 8;
+    // Where growth is animated: per-frame CPU mesh rebuild or vertex shader
+    mesh_animation = MeshAnimation::Cpu;
+    // Independent cylinders per branch, or welded tubes along each limb
+    branch_meshing = BranchMeshing::Cylinders;
+    // Branch ring sides, from twigs up to the trunk
+    min_ring_segments = 3;
+    max_ring_segments = 12;
+    // Straight branches; once curved, no limit on the rings that adds
+    branch_curvature = 0.0f;
+    curve_vertex_budget = 0;
+    // No baked occlusion
+    occlusion_settings = 0;
+    // Front and back leaf quads, or one quad lit from both sides
+    leaf_faces = LeafFaces::DoubleSided;
+    leaf_slot_vertices = LEAF_SLOT_VERTICES;
+    // Leaves expanded on the CPU, or drawn as instances of one quad
+    leaf_rendering = LeafRendering::Mesh;
+    // Branches expanded on the CPU, or drawn as instances of one cylinder
+    branch_rendering = BranchRendering::Mesh;
+    // Slots follow start order until a subtree is regenerated
+    slots_in_start_order = true;
+    leaf_slot_count = 0;
+    layout_changed = false;
+    layout_version = nextVersion();
+    mesh_version = nextVersion();
+    // Every generation grown up front; once enabled, detail appears above a
+    // quarter of the view height and goes again below 15%
+    detail_generation = 0;
+    detail_expand_size = 0.25f;
+    detail_collapse_size = 0.15f;
+    detail_expanded = false;
+    detail_active = false;
+    detail_crown.rng = nullptr;
+    detail_center = glm::vec3(0.0f);
+    detail_radius = 0.0f;
+    // 0 = silent, 1 = summary after generate(), 2 = per-generation detail
+    verbosity = 1;
+    // An ungenerated tree reports zero elements
+    resetStats();
 }
 
 Tree::~Tree() {
@@ -25,492 +125,2035 @@ Tree::~Tree() {
 
 
 void Tree::generate() {
+    // Draw a single seed from the OS entropy source; everything else
+    // comes from the tree's own engine
+    std::random_device rd;
+    uint64_t random_seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    generate(random_seed);
+}
+
+void Tree::generate(uint64_t new_seed) {
+    PROFILE_SCOPE("Tree::generate");
+    /*
+     * STEPS 1-2: BRANCHES, LEAVES AND GROWTH SCHEDULE
+     * Clear the mesh data, reset the growth timer and regenerate the structure
+     */
+    branch_vertices.clear(); // OpenGL vertex data, resized to one slot per element below
+    leaf_vertices.clear();
+    
+    current_growth_time = 0.0f; // Reset animation timer
+    
+    generateStructure(new_seed);
+    prepareDrawable();
+    if (verbosity >= 1) {
+        std::ostringstream stats;
+        printStats(stats);
+        Log::write(LogLevel::Info, LogCategory::Tree, stats.str());
+    }
+}
+
+void Tree::prepareDrawable(bool build_static_mesh) {
+    // Every element starts pending; order them by start time
+    resetActiveSets();
+    update_level_branches.clear();
+    
+    // Give each element its fixed region of the vertex arrays
+    assignMeshSlots();
+    bakeOcclusion();
+    
+    // GPU animation: emit the fully grown mesh once, the shader does the rest
+    static_branch_vertices.clear();
+    static_leaf_vertices.clear();
+    branch_growth_data.clear();
+    if (mesh_animation == MeshAnimation::Gpu && build_static_mesh) {
+        buildStaticMesh();
+    }
+    
+    // Mirror the finished tree into field arrays for the SoA hot loops
+    if (storage_mode == TreeStorageMode::StructureOfArrays) {
+        soa.assign(branches, leaves);
+    } else {
+        soa.clear();
+    }
+    
+    /*
+     * STEP 3: GENERATION STATISTICS
+     * Totals are fixed from here on; visibility counters start at zero and
+     * are advanced by updateGrowth as elements start growing, and so are
+     * the milestones: events queued for a previous tree are dropped
+     */
+    resetStats();
+    growth_events.clear();
+    reserveUpdateScratch();
+}
+
+void Tree::generateStructure(uint64_t new_seed) {
+    PROFILE_SCOPE("Tree::generateStructure");
     /*
      * STEP 1: INITIALIZE TREE GENERATION
-     * Clear all existing data structures and reset growth timer
+     * Clear the structure and reseed the RNG
      */
+    seed = new_seed;
+    restartEdits(0);
+    rng.seed(seed);           // Same seed always produces the same tree
+    
     branches.clear();     // Remove all existing branch data
+    child_indices.clear();
     leaves.clear();       // Remove all existing leaf data
-    branch_vertices.clear(); // Clear OpenGL vertex data for branches
-    leaf_vertices.clear();   // Clear OpenGL vertex data for leaves
-    
-    current_growth_time = 0.0f; // Reset animation timer
+    twig_instances.clear();
+    twig_offsets.clear();
+    detail_active = false;
     
     /*
      * STEP 2: CREATE TREE TRUNK (GENERATION 0)
-     * The trunk is the root of the recursive tree structure
+     * The trunk is the root of the tree; generateBranches expands it iteratively
      * Parameters: parent_index=-1 (no parent), start=(0,0,0), direction=upward,
      *            length=3.0, radius=0.2, generation=0
      */
-    glm::vec3 trunk_start(0.0f, 0.0f, 0.0f);  // Tree base at origin
-    glm::vec3 trunk_direction(0.0f, 1.0f, 0.0f); // Straight up
-    generateBranch(-1, trunk_start, trunk_direction, 3.0f, 0.2f, 0);
+    BranchWorkItem trunk;
+    trunk.parent_index = -1;
+    trunk.start = glm::vec3(0.0f, 0.0f, 0.0f);      // Tree base at origin
+    trunk.direction = glm::vec3(0.0f, 1.0f, 0.0f);  // Straight up
+    trunk.length = TRUNK_LENGTH;
+    trunk.radius = TRUNK_RADIUS;
+    trunk.generation = 0;
+    trunk.path = seed;
+    trunk.capsule = -1;
+    avoidance_redrawn = 0;
+    avoidance_dropped = 0;
+    // Branches the generator stops at become twig instances
+    std::vector<BranchWorkItem> twig_roots;
+    int twig_stop = twigStopGeneration();
+    if (generator == TreeGenerator::SpaceColonization && generateFromColonization()) {
+        // Branches and leaves came from space colonization
+    } else if (grammar && generateFromGrammar()) {
+        // Branches and leaves came from the L-system
+    } else if (detail_generation > 0 && max_generations >= detail_generation && twig_stop > detail_generation) {
+        generateLazy(trunk, twig_roots);
+    } else if (generation_threads > 0 && max_generations > split_generation && twig_stop > split_generation) {
+        generateSplit(trunk, twig_roots);
+    } else {
+        GenerationOutput out;
+        out.branches.swap(branches);  // Reuse the arrays' capacity
+        out.leaves.swap(leaves);
+        out.rng = &rng;
+        out.grid = avoidanceGrid();
+        generateBranches(trunk, out, twig_stop);
+        branches.swap(out.branches);
+        leaves.swap(out.leaves);
+        generation_offsets.swap(out.generation_offsets);
+        twig_roots.swap(out.deferred);
+        avoidance_redrawn = out.avoidance_redrawn;
+        avoidance_dropped = out.avoidance_dropped;
+    }
+    placeTwigs(twig_roots);
+    buildChildAdjacency();
+    applyBudget();
+    if (leaf_layout == LeafLayout::Morton) layoutLeavesByMorton();
+    buildGrowthSchedule();
+}
+
+bool Tree::generateFromGrammar() {
+    // === DERIVE AND INTERPRET ===
+    // Rewriting and the turtle share the tree's engine, so the seed still
+    // decides the whole tree
+    int steps = grammar->getDerivations() > 0 ? grammar->getDerivations() : max_generations + 1;
+    grammar->derive(lsystem_workspace, steps, rng);
+    grammar->interpret(lsystem_workspace.current, branches, leaves);
+    return adoptGeneratedBranches("L-system");
+}
+
+bool Tree::generateFromColonization() {
+    colonizer.generate(colonization_parameters, generation_threads, rng, branches, leaves);
+    return adoptGeneratedBranches("Space colonization");
+}
+
+bool Tree::adoptGeneratedBranches(const char* source) {
+    if (branches.empty()) {
+        LOG_WARNING(Tree) << source << " produced no branches, using the built-in generator";
+        leaves.clear();
+        return false;
+    }
     
-    /*
-     * STEP 3: GENERATION STATISTICS (DEBUG OUTPUT)
-     * Analyze the generated tree structure for debugging
-     */
-    std::cout << "Tree generated with " << branches.size() << " branches and " << leaves.size() << " leaves." << std::endl;
+    // External generators emit depth-first; breadth-first trees are reordered
+    generation_offsets.clear();
+    if (branch_layout == BranchLayout::BreadthFirst) {
+        layoutByGeneration();
+    }
+    return true;
+}
+
+void Tree::layoutByGeneration() {
+    // === STABLE COUNTING SORT BY GENERATION ===
+    // A parent's generation never exceeds its child's and, within one
+    // generation, the turtle already emitted it first, so parents still
+    // precede children afterwards
+    int generation_count = 0;
+    for (const TreeBranch& branch : branches) {
+        generation_count = std::max(generation_count, branch.generation + 1);
+    }
+    generation_offsets.assign(generation_count + 1, 0);
+    for (const TreeBranch& branch : branches) {
+        generation_offsets[branch.generation + 1]++;
+    }
+    for (int g = 0; g < generation_count; g++) {
+        generation_offsets[g + 1] += generation_offsets[g];
+    }
+    
+    std::vector<int> new_index(branches.size());
+    std::vector<int> next(generation_offsets.begin(), generation_offsets.end() - 1);
+    for (size_t i = 0; i < branches.size(); i++) {
+        new_index[i] = next[branches[i].generation]++;
+    }
+    std::vector<TreeBranch> sorted(branches.size());
+    for (size_t i = 0; i < branches.size(); i++) {
+        TreeBranch branch = branches[i];
+        if (branch.parent_index >= 0) branch.parent_index = new_index[branch.parent_index];
+        sorted[new_index[i]] = branch;
+    }
+    branches.swap(sorted);
+    for (TreeLeaf& leaf : leaves) {
+        leaf.parent_branch_index = new_index[leaf.parent_branch_index];
+    }
+}
+
+// 10 bits of each coordinate, interleaved
+static uint32_t spreadBits(uint32_t v) {
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+uint32_t mortonCode(const glm::vec3& unit) {
+    glm::uvec3 q = glm::uvec3(glm::clamp(unit, 0.0f, 1.0f) * 1023.0f);
+    return spreadBits(q.x) | (spreadBits(q.y) << 1) | (spreadBits(q.z) << 2);
+}
+
+void Tree::layoutLeavesByMorton() {
+    // === SORT BY MORTON CODE IN THE LEAVES' BOX ===
+    // Ties keep generation order. Nothing refers to a leaf by index (a leaf
+    // names its parent branch, never the other way round), so the array is
+    // all that moves
+    if (leaves.size() < 2) return;
+    glm::vec3 low = leaves[0].position, high = low;
+    for (const TreeLeaf& leaf : leaves) {
+        low = glm::min(low, leaf.position);
+        high = glm::max(high, leaf.position);
+    }
+    const glm::vec3 extent = glm::max(high - low, glm::vec3(1e-6f));
+    std::vector<std::pair<uint32_t, int> > order(leaves.size());
+    for (size_t i = 0; i < leaves.size(); i++) {
+        order[i] = std::make_pair(mortonCode((leaves[i].position - low) / extent), (int)i);
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<TreeLeaf> sorted(leaves.size());
+    for (size_t k = 0; k < order.size(); k++) {
+        sorted[k] = leaves[order[k].second];
+    }
+    leaves.swap(sorted);
+}
+
+void Tree::buildLeafRanges() {
+    leaf_ranges.clear();
+    for (int i = 0; i < static_cast<int>(leaves.size()); i++) {
+        const int parent = leaves[i].parent_branch_index;
+        if (leaf_ranges.empty() || leaf_ranges.back().branch != parent) {
+            TreeLeafRange range = {parent, i, 0};
+            leaf_ranges.push_back(range);
+        }
+        leaf_ranges.back().leaf_count++;
+    }
+}
+
+void Tree::setParameters(const TreeParameters& parameters) {
+    max_generations = std::max(0, parameters.max_generations);
+    branch_angle_variance = parameters.branch_angle_variance;
+    length_reduction_factor = parameters.length_reduction_factor;
+    radius_reduction_factor = parameters.radius_reduction_factor;
+    max_growth_time = parameters.max_growth_time;
     
-    // Debug: Count branches by generation
-    std::vector<int> generation_counts(max_generations + 1, 0);
+    TreeEdit edit = TreeEdit();
+    edit.type = TreeEditType::Parameters;
+    edit.parameters = getParameters();
+    logEdit(edit);
+}
+
+std::string checkTreeParameters(const TreeParameters& parameters, int max_generations_limit) {
+    if (parameters.max_generations < 0 || parameters.max_generations > max_generations_limit) {
+        return "max_generations must be 0 to " + std::to_string(max_generations_limit);
+    }
+    if (!std::isfinite(parameters.branch_angle_variance) || parameters.branch_angle_variance < 0.0f ||
+        parameters.branch_angle_variance > 180.0f) {
+        return "branch_angle_variance must be 0 to 180 degrees";
+    }
+    if (!(parameters.length_reduction_factor > 0.0f && parameters.length_reduction_factor <= 1.0f) ||
+        !(parameters.radius_reduction_factor > 0.0f && parameters.radius_reduction_factor <= 1.0f)) {
+        return "reduction factors must be in (0, 1]";
+    }
+    if (!std::isfinite(parameters.max_growth_time) || parameters.max_growth_time <= 0.0f) {
+        return "max_growth_time must be positive";
+    }
+    return "";
+}
+
+TreeParameters Tree::getParameters() const {
+    TreeParameters parameters;
+    parameters.max_generations = max_generations;
+    parameters.branch_angle_variance = branch_angle_variance;
+    parameters.length_reduction_factor = length_reduction_factor;
+    parameters.radius_reduction_factor = radius_reduction_factor;
+    parameters.max_growth_time = max_growth_time;
+    return parameters;
+}
+
+void Tree::resetStats() {
+    stats.total_branches = branches.size();
+    stats.total_leaves = leaves.size();
+    // Grammar trees may nest deeper than max_generations
+    int generation_count = max_generations + 1;
     for (const auto& branch : branches) {
-        if (branch.generation <= max_generations) {
-            generation_counts[branch.generation]++;
+        generation_count = std::max(generation_count, branch.generation + 1);
+    }
+    stats.branches_by_generation.assign(generation_count, 0);
+    stats.visible_by_generation.assign(generation_count, 0);
+    stats.grown_by_generation.assign(generation_count, 0);
+    for (const auto& branch : branches) {
+        stats.branches_by_generation[branch.generation]++;
+    }
+    stats.visible_branches = 0;
+    stats.visible_leaves = 0;
+    stats.growing_branches = 0;
+    stats.growing_leaves = 0;
+    stats.vertices_emitted = 0;
+    stats.twig_instances = twig_instances.size();
+    growth_completed = false;
+}
+
+void Tree::recountGrowthStats() {
+    // The active sets were rebuilt rather than advanced: count the started
+    // prefix again. Milestones behind the current state count as passed
+    std::fill(stats.visible_by_generation.begin(), stats.visible_by_generation.end(), 0);
+    std::fill(stats.grown_by_generation.begin(), stats.grown_by_generation.end(), 0);
+    for (size_t k = 0; k < branch_activity.next_pending; k++) {
+        int i = branch_activity.order[k];
+        stats.visible_by_generation[branches[i].generation]++;
+        if (branchProgress(i) >= 1.0f) {
+            stats.grown_by_generation[branches[i].generation]++;
+        }
+    }
+    stats.visible_branches = branch_activity.next_pending;
+    stats.visible_leaves = leaf_activity.next_pending;
+    stats.growing_branches = branch_activity.growing.size();
+    stats.growing_leaves = leaf_activity.growing.size();
+    growth_completed = isStatic();
+}
+
+void Tree::queueGrowthMilestones(size_t prev_branch_pending) {
+    // === GENERATIONS STARTED ===
+    // Branches order[prev, next_pending) started growing during this update
+    size_t first = growth_events.size();
+    for (size_t k = prev_branch_pending; k < branch_activity.next_pending; k++) {
+        int generation = branches[branch_activity.order[k]].generation;
+        if (stats.visible_by_generation[generation]++ == 0) {
+            GrowthEvent event = {GrowthEventType::GenerationStarted, generation, current_growth_time};
+            growth_events.push_back(event);
         }
     }
     
-    for (int g = 0; g <= max_generations; g++) {
-        std::cout << "Generation " << g << ": " << generation_counts[g] << " branches" << std::endl;
+    // === GENERATIONS COMPLETED ===
+    // A branch is in the changed list of exactly the update that takes it
+    // to full growth and then leaves the growing set, so it counts once
+    size_t first_completed = growth_events.size();
+    for (int i : branch_activity.changed) {
+        if (branchProgress(i) < 1.0f) continue;
+        int generation = branches[i].generation;
+        if (++stats.grown_by_generation[generation] == stats.branches_by_generation[generation]) {
+            GrowthEvent event = {GrowthEventType::GenerationCompleted, generation, current_growth_time};
+            growth_events.push_back(event);
+        }
     }
     
-    // // Debug: Show some branch details
-    // std::cout << "Sample branch details:" << std::endl;
-    // for (int i = 0; i < std::min(10, (int)branches.size()); i++) {
-    //     const auto& branch = branches[i];
-    //     float length = glm::length(branch.end - branch.start);
-    //     std::cout << "Branch " << i << " - Gen: " << branch.generation 
-    //               << ", Length: " << length << ", Radius: " << branch.radius << std::endl;
-    // }
+    // Generation order within each kind, whatever order the sets ran in
+    auto by_generation = [](const GrowthEvent& a, const GrowthEvent& b) { return a.generation < b.generation; };
+    std::sort(growth_events.begin() + first, growth_events.begin() + first_completed, by_generation);
+    std::sort(growth_events.begin() + first_completed, growth_events.end(), by_generation);
+    
+    // === TREE COMPLETED ===
+    if (!growth_completed && isStatic()) {
+        growth_completed = true;
+        GrowthEvent event = {GrowthEventType::TreeCompleted, -1, current_growth_time};
+        growth_events.push_back(event);
+    }
 }
 
-void Tree::generateBranch(int parent_index, glm::vec3 start, glm::vec3 direction, 
-                         float length, float radius, int generation) {
-    // === STEP 1: CREATE CURRENT BRANCH ===
-    // Build the TreeBranch data structure for this generation
-    TreeBranch branch;
-    branch.start = start;               // Starting point in world space
-    branch.end = start + direction * length;  // Calculate end point from direction and length
-    branch.radius = radius;             // Branch thickness
-    branch.generation = generation;     // Which generation level this belongs to
-    branch.growth_progress = 0.0f;      // Animation progress (0=invisible, 1=fully grown)
-    branch.parent_index = parent_index; // Link to parent (-1 for trunk)
+void Tree::printStats(std::ostream& os) const {
+    os << "Tree (seed " << seed << "): " << stats.visible_branches << "/" << stats.total_branches
+       << " branches, " << stats.visible_leaves << "/" << stats.total_leaves << " leaves visible, "
+       << "growth " << (getGrowthProgress() * 100.0f) << "%" << std::endl;
+    if (budget_report.dropped_subtrees > 0) {
+        os << "  Budget pruned " << budget_report.dropped_subtrees << " subtrees: "
+           << budget_report.dropped_branches << " branches, " << budget_report.dropped_leaves << " leaves, "
+           << budget_report.dropped_twigs << " twigs" << std::endl;
+    }
+    if (avoidance_redrawn > 0) {
+        os << "  Avoidance: " << avoidance_redrawn << " overlapping child draws rejected, " << avoidance_dropped
+           << " children dropped" << std::endl;
+    }
+    if (detail_active) {
+        os << "  Detail from generation " << detail_generation << (detail_expanded ? " expanded" : " collapsed")
+           << " (" << detail_crown.branches.size() << " crown branches, " << detail_crown.deferred.size()
+           << " subtrees)" << std::endl;
+    }
+    if (stats.twig_instances > 0) {
+        os << "  " << stats.twig_instances << " twig instances of " << twig_library->prototypes.size()
+           << " prototypes from generation " << twig_depth << ", vertex cache ACMR "
+           << twig_library->generated_cache.getAcmr() << " -> " << twig_library->optimized_cache.getAcmr()
+           << ", ATVR " << twig_library->generated_cache.getAtvr() << " -> "
+           << twig_library->optimized_cache.getAtvr() << std::endl;
+    }
+    if (verbosity >= 2) {
+        for (int g = 0; g < static_cast<int>(stats.branches_by_generation.size()); g++) {
+            os << "  Gen " << g << ": " << stats.visible_by_generation[g] << "/"
+               << stats.branches_by_generation[g] << std::endl;
+        }
+    }
+}
+
+template <typename T>
+static void addVectorMemory(const std::vector<T>& vector, size_t& bytes, size_t& capacity) {
+    bytes += vector.size() * sizeof(T);
+    capacity += vector.capacity() * sizeof(T);
+}
+
+static void addActivityMemory(const GrowthActiveSet& set, size_t& bytes, size_t& capacity) {
+    addVectorMemory(set.order, bytes, capacity);
+    addVectorMemory(set.growing, bytes, capacity);
+    addVectorMemory(set.changed, bytes, capacity);
+    addVectorMemory(set.lane_start, bytes, capacity);
+    addVectorMemory(set.lane_duration, bytes, capacity);
+    addVectorMemory(set.lane_progress, bytes, capacity);
+}
+
+TreeMemory Tree::getMemoryUsage() const {
+    TreeMemory memory = TreeMemory();
+    size_t& bytes = memory.topology_bytes;
+    size_t& capacity = memory.topology_capacity;
+    addVectorMemory(branches, bytes, capacity);
+    addVectorMemory(leaves, bytes, capacity);
+    addVectorMemory(child_indices, bytes, capacity);
+    addVectorMemory(leaf_ranges, bytes, capacity);
+    addVectorMemory(generation_offsets, bytes, capacity);
+    addActivityMemory(branch_activity, bytes, capacity);
+    addActivityMemory(leaf_activity, bytes, capacity);
     
-    // === STEP 2: ADD TO DATA STRUCTURES ===
-    // Store this branch and get its index for parent-child linking
-    int branch_index = branches.size();
-    branches.push_back(branch);
+    addVectorMemory(soa.branch_start, bytes, capacity);
+    addVectorMemory(soa.branch_end, bytes, capacity);
+    addVectorMemory(soa.branch_radius, bytes, capacity);
+    addVectorMemory(soa.branch_generation, bytes, capacity);
+    addVectorMemory(soa.branch_parent, bytes, capacity);
+    addVectorMemory(soa.branch_progress, bytes, capacity);
+    addVectorMemory(soa.branch_start_time, bytes, capacity);
+    addVectorMemory(soa.branch_duration, bytes, capacity);
+    addVectorMemory(soa.leaf_position, bytes, capacity);
+    addVectorMemory(soa.leaf_normal, bytes, capacity);
+    addVectorMemory(soa.leaf_size, bytes, capacity);
+    addVectorMemory(soa.leaf_progress, bytes, capacity);
+    addVectorMemory(soa.leaf_parent, bytes, capacity);
+    addVectorMemory(soa.leaf_spawn_delay, bytes, capacity);
+    addVectorMemory(soa.leaf_start_time, bytes, capacity);
+    addVectorMemory(soa.leaf_duration, bytes, capacity);
+    
+    addVectorMemory(branch_vertex_offset, bytes, capacity);
+    addVectorMemory(branch_right, bytes, capacity);
+    addVectorMemory(branch_up, bytes, capacity);
+    addVectorMemory(branch_tex_v, bytes, capacity);
+    addVectorMemory(branch_welded, bytes, capacity);
+    addVectorMemory(branch_segments, bytes, capacity);
+    addVectorMemory(branch_sections, bytes, capacity);
+    addVectorMemory(branch_sag, bytes, capacity);
+    addVectorMemory(branch_index_offset, bytes, capacity);
+    addVectorMemory(branch_slot, bytes, capacity);
+    addVectorMemory(leaf_slot, bytes, capacity);
+    addVectorMemory(free_branch_slots, bytes, capacity);
+    addVectorMemory(free_leaf_slots, bytes, capacity);
+    addVectorMemory(branch_slot_dirty, bytes, capacity);
+    addVectorMemory(leaf_slot_dirty, bytes, capacity);
+    addVectorMemory(branch_dirty_slots, bytes, capacity);
+    addVectorMemory(leaf_dirty_slots, bytes, capacity);
+    addVectorMemory(branch_moved, bytes, capacity);
+    addVectorMemory(leaf_moved, bytes, capacity);
+    addVectorMemory(absolute_start, bytes, capacity);
+    addVectorMemory(absolute_end, bytes, capacity);
+    addVectorMemory(twig_instances, bytes, capacity);
+    addVectorMemory(twig_offsets, bytes, capacity);
     
-    // Add this branch as a child to its parent (if not trunk)
-    if (parent_index >= 0) {
-        branches[parent_index].children.push_back(branch_index);
+    addVectorMemory(branch_vertices, memory.vertex_bytes, memory.vertex_capacity);
+    addVectorMemory(leaf_vertices, memory.vertex_bytes, memory.vertex_capacity);
+    addVectorMemory(branch_indices, memory.vertex_bytes, memory.vertex_capacity);
+    addVectorMemory(leaf_indices, memory.vertex_bytes, memory.vertex_capacity);
+    addVectorMemory(branch_instances, memory.vertex_bytes, memory.vertex_capacity);
+    addVectorMemory(leaf_instances, memory.vertex_bytes, memory.vertex_capacity);
+    addVectorMemory(static_branch_vertices, memory.vertex_bytes, memory.vertex_capacity);
+    addVectorMemory(static_leaf_vertices, memory.vertex_bytes, memory.vertex_capacity);
+    addVectorMemory(branch_growth_data, memory.vertex_bytes, memory.vertex_capacity);
+    return memory;
+}
+
+size_t Tree::reserveForGenerations(GenerationOutput& out, int root_generation, int stop_generation) const {
+    // === EXPECTED COUNT FROM THE BRANCHING DISTRIBUTIONS ===
+    // A branch has (MIN_CHILDREN + MAX_CHILDREN) / 2 children on average, so
+    // g generations below the root hold about that power of branches, and
+    // a leaf-bearing branch (generation 2 on) the mean leaf count. The worst
+    // case, MAX_CHILDREN^g, is dozens of times that at depth; the arrays get
+    // the expected count and an eighth more, and grow past it for a busier tree
+    const double mean_children = 0.5 * (MIN_CHILDREN + MAX_CHILDREN);
+    const double mean_leaves = 0.5 * (MIN_LEAVES + MAX_LEAVES);
+    const int last_generation = std::min(max_generations, stop_generation - 1);
+    double expected_branches = 0.0;
+    double expected_leaf_branches = 0.0;
+    double generation_size = 1.0;
+    for (int g = root_generation; g <= last_generation; g++) {
+        expected_branches += generation_size;
+        if (g >= 2) expected_leaf_branches += generation_size;
+        generation_size *= mean_children;
     }
     
-    // === STEP 3: RECURSIVE CHILD GENERATION ===
-    // Continue generating child branches if we haven't reached maximum depth
-    if (generation < max_generations) {
-        // === RANDOM NUMBER GENERATION SETUP ===
-        std::random_device rd;
-        std::mt19937 gen(rd());  // Note: Using rd() gives different results each time
-        std::uniform_real_distribution<float> angle_dist(-1.0f, 1.0f);
-        std::uniform_int_distribution<int> child_count_dist(2, 4);  // 2-4 children per branch
-        
-        int num_children = child_count_dist(gen);
-        
-        // === GENERATE EACH CHILD BRANCH ===
-        for (int i = 0; i < num_children; i++) {
-            // === CHILD DIRECTION CALCULATION ===
-            // Create pseudo-random but evenly distributed child directions
-            // This creates a natural branching pattern that looks organic
-            
-            // Base angle: evenly distribute children around circle
-            float base_angle = (float)i / num_children * 2.0f * (float)M_PI;
-            
-            // Add random variation to base angle for natural look
-            float angle_variation = angle_dist(gen) * branch_angle_variance * (float)M_PI / 180.0f;
-            float angle = base_angle + angle_variation;
-            
-            // Elevation angle: how much branches grow upward vs outward
+    const size_t branch_count = (size_t)(expected_branches * 1.125) + 1;
+    out.branches.reserve(branch_count);
+    out.leaves.reserve((size_t)(expected_leaf_branches * mean_leaves * 1.125));
+    return branch_count;
+}
+
+void Tree::generateBranches(const BranchWorkItem& root, GenerationOutput& out, int stop_generation) const {
+    size_t expected_branches = reserveForGenerations(out, root.generation, stop_generation);
+    out.generation_offsets.clear();
+    out.deferred.clear();
+    out.deferred_position.clear();
     
-            float elevation = 30.0f + angle_dist(gen) * 20.0f; // Degrees
-            
-            // Convert spherical coordinates to Cartesian direction vector
-            glm::vec3 child_direction;
-            child_direction.x = sinf(angle) * cosf(elevation * (float)M_PI / 180.0f);
-            child_direction.y = sinf(elevation * (float)M_PI / 180.0f);  // Upward component
-            child_direction.z = cosf(angle) * cosf(elevation * (float)M_PI / 180.0f);
-            child_direction = glm::normalize(child_direction);
-            
-            // === APPLY REDUCTION FACTORS ===
-            // Each generation gets progressively smaller and thinner
-            float child_length = length * length_reduction_factor;  // 70% of parent length
-            float child_radius = radius * radius_reduction_factor;  // 70% of parent radius
-            
-            // === RECURSIVE CALL ===
-            // Generate the child branch, which will in turn generate its own children
-            generateBranch(branch_index, branch.end, child_direction, child_length, child_radius, generation + 1);
-        }
+    std::vector<BranchWorkItem> work;
+    // The trunk is the first branch children avoid; split subtree roots
+    // are in the grid already
+    BranchWorkItem first = root;
+    if (out.grid && first.capsule < 0) {
+        first.capsule = out.grid->add(first.start, first.start + first.direction * first.length, first.radius);
     }
     
-    // === STEP 4: LEAF GENERATION ===
-    // Add leaves to branches starting from generation 2 (secondary branches)
-    // Trunk (gen 0) and primary branches (gen 1) don't get leaves - only wood
-    if (generation >= 2) {
-        // === LEAF RANDOM GENERATION SETUP ===
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<float> angle_dist(-1.0f, 1.0f);
-        std::uniform_int_distribution<int> leaf_count_dist(6, 14);    // 6-14 leaves per branch
-        std::uniform_real_distribution<float> size_dist(0.28f, 0.45f); // Leaf size variation
-        std::uniform_real_distribution<float> delay_dist(0.0f, 4.0f);  // Staggered appearance timing
-        
-        int num_leaves = leaf_count_dist(gen);
+    if (branch_layout == BranchLayout::BreadthFirst) {
+        // === BREADTH-FIRST: WORK LIST AS A FIFO QUEUE ===
+        // Reading from a moving head emits every generation-g branch before any
+        // generation g+1 branch, so each generation is one contiguous range
+        work.reserve(expected_branches);
+        work.push_back(first);
         
-        // === GENERATE INDIVIDUAL LEAVES ===
-        for (int j = 0; j < num_leaves; j++) {
-            TreeLeaf leaf;
-            
-            // === LEAF POSITIONING ===
-            // Position leaves randomly around the branch end point
-            // Creates a natural cluster effect at branch tips
-            leaf.position = branch.end + glm::vec3(
-                angle_dist(gen) * 0.4f,  
-                angle_dist(gen) * 0.3f, 
-                angle_dist(gen) * 0.4f   
-            );
-            
-            // === LEAF ORIENTATION ===
-            // Generate a somewhat upward-facing normal for realistic leaf orientation
-            glm::vec3 random_dir = glm::vec3(
-                angle_dist(gen) * 0.5f,                    // Some X tilt
-                0.8f + std::abs(angle_dist(gen)) * 0.2f,   // Mostly upward (0.8-1.0)
-                angle_dist(gen) * 0.5f                     // Some Z tilt
-            );
-            leaf.normal = glm::normalize(random_dir);
-            
-            // === LEAF PROPERTIES ===
-            leaf.size = size_dist(gen);              // Random size within range
-            leaf.growth_progress = 0.0f;             // Starts invisible, grows over time
-            leaf.parent_branch_index = branch_index; // Link to this branch
-            leaf.spawn_delay = delay_dist(gen);      // Random delay for gradual appearance
+        for (size_t head = 0; head < work.size(); head++) {
+            BranchWorkItem item = work[head];
+            if (item.generation >= stop_generation) {
+                out.deferred.push_back(item);
+                continue;
+            }
             
-            // === ADD TO LEAF COLLECTION ===
-            leaves.push_back(leaf);
+            // Record where each generation starts in the branches array
+            while (static_cast<int>(out.generation_offsets.size()) <= item.generation - root.generation) {
+                out.generation_offsets.push_back(out.branches.size());
+            }
+            emitBranch(item, work, out);
+        }
+        out.generation_offsets.push_back(out.branches.size()); // End sentinel
+    } else {
+        // === DEPTH-FIRST: WORK LIST AS A STACK ===
+        // Replaces recursion: popping from the back gives the same depth-first
+        // (pre-order) layout the recursive generator produced, without any
+        // stack-depth limit on max_generations.
+        // Depth-first, the list holds at most one sibling group per generation
+        work.reserve((max_generations - root.generation) * MAX_CHILDREN + 1);
+        work.push_back(first);
+        
+        while (!work.empty()) {
+            BranchWorkItem item = work.back();
+            work.pop_back();
+            if (item.generation >= stop_generation) {
+                // Remember where the subtree belongs in the pre-order
+                out.deferred.push_back(item);
+                out.deferred_position.push_back(out.branches.size());
+                continue;
+            }
+            emitBranch(item, work, out);
         }
     }
 }
 
-void Tree::updateGrowth(float delta_time) {
-    // === ADVANCE GLOBAL TIMER ===
-    // Accumulate total time elapsed since growth started
-    current_growth_time += delta_time;
+// SplitMix64 finalizer: decorrelates branch path hashes and subtree seeds
+static uint64_t mixSeed(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void Tree::generateSplit(const BranchWorkItem& trunk, std::vector<BranchWorkItem>& twig_roots) {
+    // === CROWN: GENERATIONS ABOVE THE SPLIT, SERIAL ON THE TREE'S ENGINE ===
+    GenerationOutput crown;
+    crown.rng = &rng;
+    crown.grid = avoidanceGrid();
+    generateBranches(trunk, crown, split_generation);
     
-    // === DEBUG OUTPUT (PERIODIC) ===
-    // Print growth statistics every 2 seconds for monitoring
-    static float lastDebugTime = 0.0f;
-    if (current_growth_time - lastDebugTime > 2.0f) {
-        std::cout << "Growth time: " << current_growth_time << "s / " << max_growth_time << "s" << std::endl;
-        
-        // Count visible vs total branches by generation
-        std::vector<int> visible_by_gen(max_generations + 1, 0);
-        std::vector<int> total_by_gen(max_generations + 1, 0);
-        
-        for (const auto& branch : branches) {
-            if (branch.generation <= max_generations) {
-                total_by_gen[branch.generation]++;
-                if (branch.growth_progress > 0.0f) {
-                    visible_by_gen[branch.generation]++;
-                }
+    std::vector<GenerationOutput> subtrees;
+    generateSubtrees(crown, subtrees);
+    stitchSubtrees(crown, subtrees, split_generation, twig_roots);
+    avoidance_redrawn = crown.avoidance_redrawn;
+    avoidance_dropped = crown.avoidance_dropped;
+    for (const GenerationOutput& subtree : subtrees) {
+        avoidance_redrawn += subtree.avoidance_redrawn;
+        avoidance_dropped += subtree.avoidance_dropped;
+    }
+}
+
+BranchGrid* Tree::avoidanceGrid() {
+    if (!branch_avoidance) return nullptr;
+    // Cells about as wide as the deepest generation's branches are long
+    avoidance_grid.reset(TRUNK_LENGTH * powf(length_reduction_factor, max_generations));
+    return &avoidance_grid;
+}
+
+void Tree::generateSubtrees(const GenerationOutput& crown, std::vector<GenerationOutput>& subtrees) const {
+    // === SUBTREES: ONE INDEPENDENT STREAM EACH, ON THE JOB SYSTEM ===
+    // A subtree's stream depends only on the seed and its path, so which
+    // thread runs it (and how many threads there are) cannot change it.
+    // With one generation thread the calling thread runs them all
+    const int subtree_count = crown.deferred.size();
+    subtrees.assign(subtree_count, GenerationOutput());
+    std::vector<std::mt19937_64> streams(subtree_count);
+    // Each avoids the crown and itself: a copy of the crown's grid apiece
+    std::vector<BranchGrid> grids(crown.grid ? subtree_count : 0, crown.grid ? *crown.grid : BranchGrid());
+    
+    JobSystem::shared().parallelFor(subtree_count, 1, [&](int s, int, int) {
+        streams[s].seed(mixSeed(crown.deferred[s].path));
+        subtrees[s].rng = &streams[s];
+        if (crown.grid) subtrees[s].grid = &grids[s];
+        generateBranches(crown.deferred[s], subtrees[s], twigStopGeneration());
+    }, generation_threads);
+}
+
+void Tree::stitchSubtrees(const GenerationOutput& crown, const std::vector<GenerationOutput>& subtrees,
+                          int subtree_generation, std::vector<BranchWorkItem>& twig_roots) {
+    // === GLOBAL INDEX OF EVERY LOCAL BRANCH ===
+    // The final array must match the chosen layout: depth-first splices each
+    // subtree into the crown's pre-order where its root was popped,
+    // breadth-first interleaves the subtrees generation by generation
+    const size_t subtree_count = subtrees.size();
+    std::vector<int> crown_map(crown.branches.size());
+    std::vector<std::vector<int>> subtree_map(subtree_count);
+    size_t total = crown.branches.size();
+    for (size_t s = 0; s < subtree_count; s++) {
+        subtree_map[s].resize(subtrees[s].branches.size());
+        total += subtrees[s].branches.size();
+    }
+    generation_offsets.clear();
+    
+    if (branch_layout == BranchLayout::BreadthFirst) {
+        int next = 0;
+        for (size_t g = 0; g + 1 < crown.generation_offsets.size(); g++) {
+            generation_offsets.push_back(next);
+            for (int k = crown.generation_offsets[g]; k < crown.generation_offsets[g + 1]; k++) {
+                crown_map[k] = next++;
             }
         }
-        
-        // Display visibility statistics
-        std::cout << "Visibility by generation:" << std::endl;
-        for (int g = 0; g <= max_generations; g++) {
-            std::cout << "  Gen " << g << ": " << visible_by_gen[g] << "/" << total_by_gen[g];
-            if (total_by_gen[g] > 0 && visible_by_gen[g] > 0) {
-                // Show first branch progress for this generation
-                for (const auto& branch : branches) {
-                    if (branch.generation == g && branch.growth_progress > 0.0f) {
-                        std::cout << " (progress: " << (branch.growth_progress * 100.0f) << "%)";
-                        break;
-                    }
+        for (int h = 0; subtree_generation + h <= max_generations; h++) {
+            generation_offsets.push_back(next);
+            for (size_t s = 0; s < subtree_count; s++) {
+                const std::vector<int>& offsets = subtrees[s].generation_offsets;
+                if (h + 1 >= static_cast<int>(offsets.size())) continue;
+                for (int k = offsets[h]; k < offsets[h + 1]; k++) {
+                    subtree_map[s][k] = next++;
                 }
             }
-            std::cout << std::endl;
         }
-        std::cout.flush();  // Force output to appear immediately
-        lastDebugTime = current_growth_time;
-    }
-    
-    // === BRANCH GROWTH ANIMATION ===
-    // Update each branch's growth progress based on timing rules
-    for (auto& branch : branches) {
-        // === TIMING CALCULATIONS ===
-        // Calculate when this generation should start and how long growth takes
-        float generation_delay = max_growth_time * 0.15f;  // 15% of total time between generations
-        float growth_duration = max_growth_time * 0.4f;    // 40% of total time for each branch to grow
-        float start_time = branch.generation * generation_delay;
-        
-        // Only update if enough time has passed for this generation
-        if (current_growth_time > start_time) {
-            if (branch.generation == 0) {
-                // === TRUNK GROWTH (GENERATION 0) ===
-                // Trunk grows independently, starting immediately
-                // It serves as the foundation for all other branches
-                float elapsed = current_growth_time - start_time;
-                branch.growth_progress = std::min(1.0f, elapsed / growth_duration);
-            } else {
-                // === CHILD BRANCH GROWTH (GENERATION 1+) ===
-                // Child branches must wait for their parent to be partially grown
-                // This creates the realistic effect of branches sprouting from existing ones
-                if (branch.parent_index >= 0 && branch.parent_index < static_cast<int>(branches.size())) {
-                    float parent_progress = branches[branch.parent_index].growth_progress;
-                    
-                    // Wait until parent is 60% grown before starting to grow
-                    if (parent_progress > 0.6f) {
-                        // Calculate when parent reached 60% growth
-                        float parent_60_percent_time = 0.6f * growth_duration + 
-                                                     (branches[branch.parent_index].generation * generation_delay);
-                        
-                        // Start growing either at scheduled time or when parent is ready, whichever is later
-                        float actual_start_time = std::max(start_time, parent_60_percent_time);
-                        float elapsed = current_growth_time - actual_start_time;
-                        branch.growth_progress = std::min(1.0f, elapsed / growth_duration);
-                    }
-                }
+        generation_offsets.push_back(next); // End sentinel
+    } else {
+        int next = 0;
+        size_t crown_next = 0;
+        for (size_t s = 0; s <= subtree_count; s++) {
+            size_t crown_end = (s < subtree_count) ? crown.deferred_position[s] : crown.branches.size();
+            for (; crown_next < crown_end; crown_next++) {
+                crown_map[crown_next] = next++;
+            }
+            if (s == subtree_count) break;
+            for (size_t k = 0; k < subtrees[s].branches.size(); k++) {
+                subtree_map[s][k] = next++;
             }
         }
     }
     
-    // === LEAF GROWTH ANIMATION ===
-    // Update each leaf's growth progress, which depends on parent branch state
-    for (auto& leaf : leaves) {
-        // Verify parent branch exists and is valid
-        if (leaf.parent_branch_index >= 0 && leaf.parent_branch_index < static_cast<int>(branches.size())) {
-            float parent_progress = branches[leaf.parent_branch_index].growth_progress;
-            
-            // === LEAF TIMING STRATEGY ===
-            // Leaves start appearing when their parent branch is 40% grown
-            // This creates the natural effect of leaves budding on established branches
-            if (parent_progress > 0.4f) {
-                // === LEAF TIMING CALCULATIONS ===
-                float generation_delay = max_growth_time * 0.15f;     // Match branch timing
-                float leaf_start_offset = max_growth_time * 0.1f;     // 10% of total time after branch starts
-                float leaf_growth_duration = max_growth_time * 0.1f;  // 10% of total time for leaf to grow
-                
-                // Calculate base start time for this leaf's parent branch generation
-                float base_start_time = branches[leaf.parent_branch_index].generation * generation_delay + leaf_start_offset;
-                
-                // Add individual spawn delay for staggered leaf appearance
-                float start_time = base_start_time + leaf.spawn_delay;
-                
-                // === LEAF GROWTH PROGRESS ===
-                // Only start growing if enough time has passed
-                if (current_growth_time > start_time) {
-                    float elapsed = current_growth_time - start_time;
-                    leaf.growth_progress = std::min(1.0f, elapsed / leaf_growth_duration);
-                }
-            }
+    // === SCATTER WITH PARENT FIX-UPS ===
+    // A subtree root's parent is a crown index; everything else is local
+    branches.resize(total);
+    leaves.clear();
+    for (size_t k = 0; k < crown.branches.size(); k++) {
+        TreeBranch branch = crown.branches[k];
+        if (branch.parent_index >= 0) branch.parent_index = crown_map[branch.parent_index];
+        branches[crown_map[k]] = branch;
+    }
+    for (const TreeLeaf& crown_leaf : crown.leaves) {
+        TreeLeaf leaf = crown_leaf;
+        leaf.parent_branch_index = crown_map[leaf.parent_branch_index];
+        leaves.push_back(leaf);
+    }
+    for (size_t s = 0; s < subtree_count; s++) {
+        const std::vector<int>& map = subtree_map[s];
+        for (size_t k = 0; k < subtrees[s].branches.size(); k++) {
+            TreeBranch branch = subtrees[s].branches[k];
+            branch.parent_index = (k == 0) ? crown_map[branch.parent_index] : map[branch.parent_index];
+            branches[map[k]] = branch;
+        }
+        for (const TreeLeaf& subtree_leaf : subtrees[s].leaves) {
+            TreeLeaf leaf = subtree_leaf;
+            leaf.parent_branch_index = map[leaf.parent_branch_index];
+            leaves.push_back(leaf);
+        }
+        // Roots a subtree stopped at for twig instancing hang off its branches
+        for (const BranchWorkItem& subtree_root : subtrees[s].deferred) {
+            BranchWorkItem root = subtree_root;
+            root.parent_index = map[root.parent_index];
+            twig_roots.push_back(root);
         }
     }
-    
-    // === MESH UPDATE ===
-    // Regenerate the vertex data for rendering based on current growth state
-    // This must be called every frame to reflect animation changes
-    updateBranchMesh();  // Update branch geometry based on growth_progress
-    updateLeafMesh();    // Update leaf geometry based on growth_progress
 }
 
-glm::vec3 Tree::calculateAbsoluteBranchStart(int branch_index) {
-    // === BOUNDS CHECKING ===
-    // Ensure branch index is valid to prevent crashes
-    if (branch_index < 0 || branch_index >= static_cast<int>(branches.size())) {
-        return glm::vec3(0.0f);  // Return origin for invalid indices
+void Tree::buildChildAdjacency() {
+    // === COMPRESSED CHILD ADJACENCY (CSR) ===
+    // Pass 1: count children of every branch
+    for (auto& branch : branches) {
+        branch.child_count = 0;
+    }
+    for (const auto& branch : branches) {
+        if (branch.parent_index >= 0) {
+            branches[branch.parent_index].child_count++;
+        }
     }
     
-    const auto& branch = branches[branch_index];
-    
-    // === ROOT CASE: TRUNK ===
-    // Trunk has no parent, so use its stored start position
-    if (branch.parent_index == -1) {
-        return branch.start;  // Usually (0,0,0) - base of tree
+    // Pass 2: exclusive prefix sum gives each branch its slice of child_indices
+    int offset = 0;
+    for (auto& branch : branches) {
+        branch.first_child = offset;
+        offset += branch.child_count;
     }
     
-    // === CHILD CASE: DEPENDS ON PARENT ===
-    // Child branches start where their parent currently ends
-    // This creates the connected, hierarchical tree structure
-    glm::vec3 parent_end = calculateAbsoluteBranchEnd(branch.parent_index);
-    return parent_end;
+    // Pass 3: scatter child indices; branches are visited in index order, so
+    // every slice lists its children in ascending index order
+    child_indices.assign(offset, -1);
+    std::vector<int> fill(branches.size(), 0);
+    for (int i = 0; i < static_cast<int>(branches.size()); i++) {
+        int parent = branches[i].parent_index;
+        if (parent >= 0) {
+            child_indices[branches[parent].first_child + fill[parent]++] = i;
+        }
+    }
 }
 
-glm::vec3 Tree::calculateAbsoluteBranchEnd(int branch_index) {
-    // === BOUNDS CHECKING ===
-    if (branch_index < 0 || branch_index >= static_cast<int>(branches.size())) {
-        return glm::vec3(0.0f);
+void Tree::applyBudget() {
+    budget_report.dropped_subtrees = 0;
+    budget_report.dropped_branches = 0;
+    budget_report.dropped_leaves = 0;
+    budget_report.dropped_twigs = 0;
+    budget_report.dropped_by_generation.clear();
+    
+    // === COST OF EACH BRANCH ===
+    // A branch brings its leaves and the twigs attached to it; vertices are
+    // bounded by the largest ring (or the fixed instanced cylinder)
+    const int n = branches.size();
+    bool single_leaves = leaf_faces == LeafFaces::SingleSided || leaf_rendering == LeafRendering::Instanced;
+    const int leaf_vertices_each = single_leaves ? LEAF_SINGLE_SLOT_VERTICES : LEAF_SLOT_VERTICES;
+    const int branch_vertices_each = (branch_rendering == BranchRendering::Instanced)
+                                   ? BRANCH_SLOT_VERTICES : 2 * (max_ring_segments + 1);
+    std::vector<int> cost_branches(n, 1), cost_leaves(n, 0), cost_vertices(n, branch_vertices_each);
+    for (const TreeLeaf& leaf : leaves) {
+        cost_leaves[leaf.parent_branch_index]++;
+        cost_vertices[leaf.parent_branch_index] += leaf_vertices_each;
+    }
+    for (const TwigInstance& twig : twig_instances) {
+        const TwigPrototype& prototype = twig_library->prototypes[twig.prototype];
+        int b = twig.parent_branch_index;
+        cost_branches[b] += prototype.branches.size();
+        cost_leaves[b] += prototype.leaves.size();
+        cost_vertices[b] += prototype.branches.size() * BRANCH_SLOT_VERTICES
+                          + prototype.leaves.size() * LEAF_SINGLE_SLOT_VERTICES;
     }
     
-    const auto& branch = branches[branch_index];
+    // === KEEP THE MOST SIGNIFICANT BRANCHES ===
+    // Grow the kept set from the roots, always taking the largest frontier
+    // branch; one that no longer fits is dropped with its whole subtree.
+    // Without limits everything is kept
+    const int max_branches = budget.max_branches > 0 ? budget.max_branches : INT_MAX;
+    const int max_leaves = budget.max_leaves > 0 ? budget.max_leaves : INT_MAX;
+    const int max_vertices = budget.max_vertices > 0 ? budget.max_vertices : INT_MAX;
+    long long kept_branches = 0, kept_leaves = 0, kept_vertices = 0;
+    std::vector<unsigned char> keep(n, 0);
+    // Max-heap of (significance, -index): ties keep the earlier branch
+    std::vector<std::pair<float, int>> frontier;
+    auto significance = [&](int b) {
+        return std::make_pair(branches[b].radius * glm::length(branches[b].end - branches[b].start), -b);
+    };
+    for (int b = 0; b < n; b++) {
+        if (branches[b].parent_index < 0) frontier.push_back(significance(b));
+    }
+    std::make_heap(frontier.begin(), frontier.end());
+    while (!frontier.empty()) {
+        std::pop_heap(frontier.begin(), frontier.end());
+        int b = -frontier.back().second;
+        frontier.pop_back();
+        if (kept_branches + cost_branches[b] > max_branches || kept_leaves + cost_leaves[b] > max_leaves ||
+            kept_vertices + cost_vertices[b] > max_vertices) {
+            budget_report.dropped_subtrees++;
+            continue;
+        }
+        keep[b] = 1;
+        kept_branches += cost_branches[b];
+        kept_leaves += cost_leaves[b];
+        kept_vertices += cost_vertices[b];
+        for (int c = 0; c < branches[b].child_count; c++) {
+            frontier.push_back(significance(child_indices[branches[b].first_child + c]));
+            std::push_heap(frontier.begin(), frontier.end());
+        }
+    }
+    budget_report.vertex_bound = std::min<long long>(kept_vertices, INT_MAX);
+    if (budget_report.dropped_subtrees == 0) return;
     
-    // === GET ABSOLUTE START POSITION ===
-    // Find where this branch starts in world coordinates
-    glm::vec3 absolute_start = calculateAbsoluteBranchStart(branch_index);
+    // === COMPACTION ===
+    // Kept branches stay in their order, so parents still precede children
+    // and both layouts survive; generation ranges are recounted
+    std::vector<int> new_index(n, -1);
+    int next = 0;
+    for (int b = 0; b < n; b++) {
+        if (keep[b]) {
+            new_index[b] = next++;
+            continue;
+        }
+        int generation = branches[b].generation;
+        if (generation >= static_cast<int>(budget_report.dropped_by_generation.size())) {
+            budget_report.dropped_by_generation.resize(generation + 1, 0);
+        }
+        budget_report.dropped_by_generation[generation]++;
+    }
+    budget_report.dropped_branches = n - next;
+    for (int b = 0; b < n; b++) {
+        if (!keep[b]) continue;
+        TreeBranch branch = branches[b];
+        if (branch.parent_index >= 0) branch.parent_index = new_index[branch.parent_index];
+        branches[new_index[b]] = branch;
+    }
+    branches.resize(next);
+    recountGenerationOffsets();
     
-    // === CALCULATE GROWTH-ADJUSTED END POSITION ===
-    // The local direction vector represents the full branch when grown
-    glm::vec3 local_direction = branch.end - branch.start;
+    size_t kept_leaf_count = 0;
+    for (const TreeLeaf& leaf : leaves) {
+        if (new_index[leaf.parent_branch_index] < 0) continue;
+        TreeLeaf moved = leaf;
+        moved.parent_branch_index = new_index[leaf.parent_branch_index];
+        leaves[kept_leaf_count++] = moved;
+    }
+    budget_report.dropped_leaves = leaves.size() - kept_leaf_count;
+    leaves.resize(kept_leaf_count);
     
-    // Scale direction by growth progress for animation effect
-    // growth_progress = 0.0 -> no extension (branch hasn't started growing)
-    // growth_progress = 1.0 -> full extension (branch is fully grown)
-    glm::vec3 current_direction = local_direction * branch.growth_progress;
+    // Twigs stay grouped by prototype; the group offsets are recounted
+    size_t kept_twig_count = 0;
+    int group_begin = 0;
+    for (size_t k = 0; k + 1 < twig_offsets.size(); k++) {
+        int group_end = twig_offsets[k + 1];
+        for (int t = group_begin; t < group_end; t++) {
+            TwigInstance twig = twig_instances[t];
+            if (new_index[twig.parent_branch_index] < 0) continue;
+            twig.parent_branch_index = new_index[twig.parent_branch_index];
+            twig_instances[kept_twig_count++] = twig;
+        }
+        group_begin = group_end;
+        twig_offsets[k + 1] = kept_twig_count;
+    }
+    budget_report.dropped_twigs = twig_instances.size() - kept_twig_count;
+    twig_instances.resize(kept_twig_count);
     
-    // === RETURN CURRENT END POSITION ===
-    return absolute_start + current_direction;
+    buildChildAdjacency();
 }
 
-void Tree::updateBranchMesh() {
-    // === CLEAR PREVIOUS MESH DATA ===
-    branch_vertices.clear();
-    
-    // === GENERATE GEOMETRY FOR EACH VISIBLE BRANCH ===
-    for (int i = 0; i < static_cast<int>(branches.size()); i++) {
-        const auto& branch = branches[i];
-        
-        // Only render branches that have started growing
-        if (branch.growth_progress > 0.0f) {
-            // === CALCULATE CURRENT BRANCH ENDPOINTS ===
-            // Get animated positions that change as branch grows
-            glm::vec3 start = calculateAbsoluteBranchStart(i);
-            glm::vec3 end = calculateAbsoluteBranchEnd(i);
-            
-            // === CALCULATE BRANCH RADII ===
-            // Branches taper from thicker at base to thinner at tip
-            float start_radius = branch.radius;           // Full radius at base
-            float end_radius = branch.radius * 0.7f;      // 70% radius at tip
-            
-            // === GENERATE CYLINDRICAL GEOMETRY ===
-            // Create a cylinder segment representing this branch
-            addBranchSegment(start, end, start_radius, end_radius);
-        }
+void Tree::recountGenerationOffsets() {
+    // Breadth-first trees only: the ranges follow the generations in the array
+    if (generation_offsets.empty()) return;
+    size_t size = generation_offsets.size();
+    for (const TreeBranch& branch : branches) {
+        size = std::max(size, static_cast<size_t>(branch.generation + 2));
+    }
+    generation_offsets.assign(size, 0);
+    for (const TreeBranch& branch : branches) {
+        generation_offsets[branch.generation + 1]++;
+    }
+    for (size_t g = 0; g + 1 < generation_offsets.size(); g++) {
+        generation_offsets[g + 1] += generation_offsets[g];
     }
 }
 
-void Tree::updateLeafMesh() {
-    // === CLEAR PREVIOUS LEAF MESH DATA ===
-    leaf_vertices.clear();
-    
-    // === GENERATE GEOMETRY FOR EACH VISIBLE LEAF ===
-    for (const auto& leaf : leaves) {
-        // Only process leaves that have started growing and have valid parent
-        if (leaf.growth_progress > 0.0f && 
-            leaf.parent_branch_index >= 0 && 
-            leaf.parent_branch_index < static_cast<int>(branches.size())) {
-            
-            const auto& parent_branch = branches[leaf.parent_branch_index];
-            
-            // === CALCULATE LEAF POSITION ===
-            // Leaves maintain their relative offset from their parent branch end
-            // This way they move naturally as the parent branch grows
-            glm::vec3 original_leaf_offset = leaf.position - parent_branch.end;
-            glm::vec3 parent_absolute_end = calculateAbsoluteBranchEnd(leaf.parent_branch_index);
-            glm::vec3 pos = parent_absolute_end + original_leaf_offset;
-            
-            // === CALCULATE ANIMATED LEAF SIZE ===
-            // Scale leaf size by growth progress for budding animation
-            float dynamic_size = leaf.size * leaf.growth_progress;
-            
-            // === GENERATE LEAF QUAD GEOMETRY ===
-            // Create a billboard quad that faces a specific direction
-            addLeafQuad(pos, leaf.normal, dynamic_size, leaf.growth_progress);
-        }
+bool Tree::getGenerationRange(int generation, int& begin, int& end) const {
+    // Only meaningful when generations are laid out contiguously
+    if (generation < 0 || generation + 1 >= static_cast<int>(generation_offsets.size())) {
+        begin = end = 0;
+        return false;
     }
+    begin = generation_offsets[generation];
+    end = generation_offsets[generation + 1];
+    return true;
 }
 
-void Tree::addBranchSegment(glm::vec3 start, glm::vec3 end, float start_radius, float end_radius) {
-    // === GEOMETRIC SETUP ===
-    const int segments = 8;  // Number of sides around cylinder circumference
-    
-    // === COORDINATE SYSTEM CALCULATION ===
-    // Calculate local coordinate system for cylinder generation
-    glm::vec3 direction = glm::normalize(end - start);  // Branch growth direction
-    glm::vec3 up = glm::vec3(0, 1, 0);                  // Default up vector
+int Tree::emitBranch(const BranchWorkItem& item, std::vector<BranchWorkItem>& work, GenerationOutput& out) const {
+    // === STEP 1: CREATE CURRENT BRANCH ===
+    // Build the TreeBranch data structure for this generation
+    TreeBranch branch;
+    branch.start = item.start;                          // Starting point in world space
+    branch.end = item.start + item.direction * item.length; // Calculate end point from direction and length
+    branch.radius = item.radius;                        // Branch thickness
+    branch.generation = item.generation;                // Which generation level this belongs to
+    branch.growth_progress = 0.0f;                      // Animation progress (0=invisible, 1=fully grown)
+    branch.parent_index = item.parent_index;            // Link to parent (-1 for trunk)
+    branch.first_child = 0;                             // Filled in by buildChildAdjacency()
+    branch.child_count = 0;
+    branch.start_time = 0.0f;                           // Filled in by buildGrowthSchedule()
+    branch.growth_duration = 1.0f;
     
-    // Handle near-vertical branches to avoid parallel vectors
-    if (abs(glm::dot(direction, up)) > 0.9f) {
-        up = glm::vec3(1, 0, 0);  // Use X-axis if branch is nearly vertical
-    }
+    // === STEP 2: ADD TO DATA STRUCTURES ===
+    // Store this branch and get its index for parent-child linking
+    int branch_index = out.branches.size();
+    out.branches.push_back(branch);
     
-    // Complete orthogonal coordinate system
-    glm::vec3 right = glm::normalize(glm::cross(direction, up));
-    up = glm::normalize(glm::cross(right, direction));
+    // Parent-child links are collected into child_indices by
+    // buildChildAdjacency() once the whole tree exists
     
-    // === CYLINDER MESH GENERATION ===
-    // Generate triangular mesh by connecting rings at start and end
-    for (int i = 0; i < segments; i++) {
-        // === ANGULAR CALCULATIONS ===
-        // Calculate angles for current and next vertex around circumference
-        float angle1 = (float)i / segments * 2.0f * (float)M_PI;
-        float angle2 = (float)(i + 1) / segments * 2.0f * (float)M_PI;
-        
-        // === TEXTURE COORDINATES ===
-        // Map cylinder surface to rectangular texture
-        float u1 = (float)i / segments;        // Texture U wraps around circumference
-        float u2 = (float)(i + 1) / segments;  
-        // Texture V goes from base (0) to tip (1) along branch length
-        
-        // === VERTEX POSITION CALCULATION ===
-        // Calculate positions of 4 vertices forming a quad on cylinder surface
-        // p1 = start_center + (right_vector × cos(angle1) × radius) + (up_vector × sin(angle1) × radius)
-        // point = center + right*cos(θ)*radius + up*sin(θ)*radius
-        glm::vec3 p1 = start + right * cosf(angle1) * start_radius + up * sinf(angle1) * start_radius;
-        glm::vec3 p2 = start + right * cosf(angle2) * start_radius + up * sinf(angle2) * start_radius;
-        glm::vec3 p3 = end + right * cosf(angle1) * end_radius + up * sinf(angle1) * end_radius;
-        glm::vec3 p4 = end + right * cosf(angle2) * end_radius + up * sinf(angle2) * end_radius;
-        
-        // === NORMAL VECTOR CALCULATION ===
-        // Calculate surface normals for proper lighting
-        // Normals point outward from cylinder axis
-        glm::vec3 n1 = glm::normalize((p1 - start) * glm::vec3(1,0,1));  // Ignore Y for radial normal
-        glm::vec3 n2 = glm::normalize((p2 - start) * glm::vec3(1,0,1));
-        
-        // === TEXTURE COORDINATE ASSIGNMENT ===
-        glm::vec2 t1(u1, 0.0f);  // Base of cylinder
-        glm::vec2 t2(u2, 0.0f);  
-        glm::vec2 t3(u1, 1.0f);  // Tip of cylinder
-        glm::vec2 t4(u2, 1.0f);
+    // === STEP 3: QUEUE CHILD BRANCHES ===
+    // Continue generating child branches if we haven't reached maximum depth
+    if (item.generation < max_generations) {
+        // === RANDOM NUMBER GENERATION SETUP ===
+        // Draws come from the run's engine: the tree's own, seeded once in
+        // generate(), or a split subtree's stream
+        std::mt19937_64& gen = *out.rng;
+        std::uniform_real_distribution<float> angle_dist(-1.0f, 1.0f);
+        std::uniform_int_distribution<int> child_count_dist(MIN_CHILDREN, MAX_CHILDREN);  // 2-4 children per branch
         
-        // === TRIANGLE GENERATION ===
-        // Each quad becomes 2 triangles: (p1,p2,p3) and (p2,p4,p3)
+        int num_children = child_count_dist(gen);
         
-        // Triangle 1: p1, p2, p3
-        branch_vertices.insert(branch_vertices.end(), {p1.x, p1.y, p1.z, 1.0f, t1.x, t1.y, n1.x, n1.y, n1.z});
-        branch_vertices.insert(branch_vertices.end(), {p2.x, p2.y, p2.z, 1.0f, t2.x, t2.y, n2.x, n2.y, n2.z});
-        branch_vertices.insert(branch_vertices.end(), {p3.x, p3.y, p3.z, 1.0f, t3.x, t3.y, n1.x, n1.y, n1.z});
+        // For the depth-first stack, children are pushed in reverse so child 0
+        // is popped (and laid out) first; the breadth-first queue keeps order
+        bool reverse_children = (branch_layout == BranchLayout::DepthFirst);
+        size_t first_child = work.size();
         
-        // Triangle 2: p2, p4, p3  
-        branch_vertices.insert(branch_vertices.end(), {p2.x, p2.y, p2.z, 1.0f, t2.x, t2.y, n2.x, n2.y, n2.z});
-        branch_vertices.insert(branch_vertices.end(), {p4.x, p4.y, p4.z, 1.0f, t4.x, t4.y, n2.x, n2.y, n2.z});
-        branch_vertices.insert(branch_vertices.end(), {p3.x, p3.y, p3.z, 1.0f, t3.x, t3.y, n1.x, n1.y, n1.z});
+        // === GENERATE EACH CHILD BRANCH ===
+        for (int i = 0; i < num_children; i++) {
+            // Each generation gets progressively smaller and thinner
+            const float child_length = item.length * length_reduction_factor;  // 80% of parent length
+            const float child_radius = item.radius * radius_reduction_factor;  // 70% of parent radius
+            glm::vec3 child_direction;
+            bool placed = false;
+            for (int attempt = 0; attempt < (out.grid ? AVOIDANCE_ATTEMPTS : 1) && !placed; attempt++) {
+                // === CHILD DIRECTION CALCULATION ===
+                // Create pseudo-random but evenly distributed child directions
+                // This creates a natural branching pattern that looks organic
+                
+                // Base angle: evenly distribute children around circle
+                float base_angle = (float)i / num_children * 2.0f * (float)M_PI;
+                
+                // Add random variation to base angle for natural look
+                float angle_variation = angle_dist(gen) * branch_angle_variance * (float)M_PI / 180.0f;
+                float angle = base_angle + angle_variation;
+                
+                // Elevation angle: how much branches grow upward vs outward
+                
+                float elevation = 30.0f + angle_dist(gen) * 20.0f; // Degrees
+                
+                // Convert spherical coordinates to Cartesian direction vector
+                child_direction.x = sinf(angle) * cosf(elevation * (float)M_PI / 180.0f);
+                child_direction.y = sinf(elevation * (float)M_PI / 180.0f);  // Upward component
+                child_direction.z = cosf(angle) * cosf(elevation * (float)M_PI / 180.0f);
+                child_direction = glm::normalize(child_direction);
+                
+                // === AVOIDANCE: NOT THROUGH A PLACED BRANCH ===
+                // Past the fork, the parent it grows from aside
+                placed = !out.grid ||
+                         !out.grid->overlaps(branch.end + child_direction * (child_length * 0.25f),
+                                             branch.end + child_direction * child_length, child_radius, item.capsule);
+                if (!placed) out.avoidance_redrawn++;
+            }
+            if (!placed) {
+                out.avoidance_dropped++;
+                continue;
+            }
+            
+            BranchWorkItem child;
+            child.parent_index = branch_index;
+            child.start = branch.end;
+            child.direction = child_direction;
+            child.length = child_length;
+            child.radius = child_radius;
+            child.generation = item.generation + 1;
+            child.path = mixSeed(item.path ^ mixSeed(i + 1));
+            // Placed children are obstacles from here on, for their siblings too
+            child.capsule = out.grid ? out.grid->add(child.start, child.start + child_direction * child_length,
+                                                     child_radius) : -1;
+            work.push_back(child);
+        }
+        if (reverse_children) std::reverse(work.begin() + first_child, work.end());
+    }
+    
+    // === STEP 4: LEAF GENERATION ===
+    // Add leaves to branches starting from generation 2 (secondary branches)
+    // Trunk (gen 0) and primary branches (gen 1) don't get leaves - only wood
+    if (item.generation >= 2) {
+        emitLeaves(branch_index, out);
+    }
+    
+    return branch_index;
+}
+
+void Tree::emitLeaves(int branch_index, GenerationOutput& out) const {
+    const TreeBranch& branch = out.branches[branch_index];
+    
+    // === LEAF RANDOM GENERATION SETUP ===
+    std::mt19937_64& gen = *out.rng;
+    std::uniform_real_distribution<float> angle_dist(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> leaf_count_dist(MIN_LEAVES, MAX_LEAVES); // 6-14 leaves per branch
+    std::uniform_real_distribution<float> size_dist(0.28f, 0.45f); // Leaf size variation
+    std::uniform_real_distribution<float> delay_dist(0.0f, 4.0f);  // Staggered appearance timing
+    
+    int num_leaves = leaf_count_dist(gen);
+    
+    // === GENERATE INDIVIDUAL LEAVES ===
+    for (int j = 0; j < num_leaves; j++) {
+        TreeLeaf leaf;
+        
+        // === LEAF POSITIONING ===
+        // Position leaves randomly around the branch end point
+        // Creates a natural cluster effect at branch tips
+        leaf.position = branch.end + glm::vec3(
+            angle_dist(gen) * 0.4f,  
+            angle_dist(gen) * 0.3f, 
+            angle_dist(gen) * 0.4f   
+        );
+        
+        // === LEAF ORIENTATION ===
+        // Generate a somewhat upward-facing normal for realistic leaf orientation
+        glm::vec3 random_dir = glm::vec3(
+            angle_dist(gen) * 0.5f,                    // Some X tilt
+            0.8f + std::abs(angle_dist(gen)) * 0.2f,   // Mostly upward (0.8-1.0)
+            angle_dist(gen) * 0.5f                     // Some Z tilt
+        );
+        leaf.normal = glm::normalize(random_dir);
+        
+        // === LEAF PROPERTIES ===
+        leaf.size = size_dist(gen);              // Random size within range
+        leaf.growth_progress = 0.0f;             // Starts invisible, grows over time
+        leaf.parent_branch_index = branch_index; // Link to this branch
+        leaf.spawn_delay = delay_dist(gen);      // Random delay for gradual appearance
+        leaf.start_time = 0.0f;                  // Filled in by buildGrowthSchedule()
+        leaf.growth_duration = 1.0f;
+        
+        // === ADD TO LEAF COLLECTION ===
+        out.leaves.push_back(leaf);
+    }
+}
+
+uint64_t Tree::nextVersion() {
+    static std::atomic<uint64_t> next(1);
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+// === EDIT LOG ===
+
+void Tree::logEdit(TreeEdit edit) {
+    edit.branch_count = branches.size();
+    edit.leaf_count = leaves.size();
+    edits.push_back(edit);
+}
+
+void Tree::trimEdits(uint32_t sequence) {
+    if (sequence <= first_edit_sequence) return;
+    const size_t dropped = std::min((size_t)(sequence - first_edit_sequence), edits.size());
+    edits.erase(edits.begin(), edits.begin() + dropped);
+    first_edit_sequence += dropped;
+}
+
+void Tree::restartEdits(uint32_t sequence) {
+    edits.clear();
+    first_edit_sequence = sequence;
+}
+
+void Tree::updateGrowth(float delta_time) {
+    PROFILE_SCOPE("Tree::updateGrowth");
+    // === ADVANCE GLOBAL TIMER ===
+    // Accumulate total time elapsed since growth started
+    advanceGrowthTo(current_growth_time + delta_time);
+}
+
+void Tree::advanceGrowthTo(float time) {
+    current_growth_time = time;
+    
+    // Branches order[prev, next_pending) start growing during this update
+    size_t prev_branch_pending = branch_activity.next_pending;
+    
+    // === GROWTH KERNEL ===
+    // Progress is clamp((t - start) / duration) from the precomputed schedule,
+    // evaluated only for elements in the growing set; SoA touches only the
+    // arrays it reads
+    bool changed;
+    if (storage_mode == TreeStorageMode::StructureOfArrays) {
+        changed = updateGrowthSoA();
+    } else {
+        changed = updateGrowthAoS();
+    }
+    
+    // === STATISTICS ===
+    // Counters are advanced from the active sets instead of rescanning the
+    // tree; milestones they pass go to the event queue
+    queueGrowthMilestones(prev_branch_pending);
+    stats.visible_branches = branch_activity.next_pending;
+    stats.visible_leaves = leaf_activity.next_pending;
+    stats.growing_branches = branch_activity.growing.size();
+    stats.growing_leaves = leaf_activity.growing.size();
+    stats.vertices_emitted = 0;
+    
+    // Nothing started, grew or finished: the existing meshes are still valid.
+    // With GPU animation the static mesh is always valid
+    if (!changed || mesh_animation == MeshAnimation::Gpu) {
+        return;
+    }
+    
+    // === MESH UPDATE ===
+    // Rewrite the vertex slots of elements whose geometry changed; this runs
+    // only on frames in which some element's progress changed
+    resolveAbsolutePositions(); // Animated endpoints shared by both mesh builders
+    updateBranchMesh();  // Update moved branch slots and mark them dirty
+    updateLeafMesh();    // Update moved leaf slots and mark them dirty
+}
+
+// Growth schedule of a parents-first branch set and its leaves, with
+// generation first_generation starting at time 0. Returns the time the last
+// element finishes growing
+static float scheduleGrowth(std::vector<TreeBranch>& branches, std::vector<TreeLeaf>& leaves,
+                            float max_growth_time, int first_generation) {
+    // === TIMING PARAMETERS ===
+    // All timing is derived from max_growth_time and the topology, once per tree
+    const float generation_delay = max_growth_time * 0.15f;     // 15% of total time between generations
+    const float growth_duration = max_growth_time * 0.4f;       // 40% of total time for each branch to grow
+    const float leaf_start_offset = max_growth_time * 0.1f;     // 10% of total time after branch generation starts
+    const float leaf_growth_duration = max_growth_time * 0.1f;  // 10% of total time for leaf to grow
+    
+    float end_time = 0.0f;
+    
+    // === BRANCH START TIMES ===
+    // Parents precede children, so each parent's start time is already known.
+    // A child starts at its generation's scheduled time or when its parent
+    // reaches 60% growth, whichever is later
+    for (auto& branch : branches) {
+        float scheduled = (branch.generation - first_generation) * generation_delay;
+        if (branch.parent_index >= 0) {
+            float parent_60_percent_time = branches[branch.parent_index].start_time + 0.6f * growth_duration;
+            branch.start_time = std::max(scheduled, parent_60_percent_time);
+        } else {
+            branch.start_time = scheduled;  // Trunk starts immediately
+        }
+        branch.growth_duration = growth_duration;
+        end_time = std::max(end_time, branch.start_time + branch.growth_duration);
+    }
+    
+    // === LEAF START TIMES ===
+    // Leaves bud once their parent branch is 40% grown, but never before
+    // their generation's offset plus the individual spawn delay
+    for (auto& leaf : leaves) {
+        const TreeBranch& parent = branches[leaf.parent_branch_index];
+        float parent_40_percent_time = parent.start_time + 0.4f * growth_duration;
+        float scheduled = (parent.generation - first_generation) * generation_delay + leaf_start_offset + leaf.spawn_delay;
+        leaf.start_time = std::max(scheduled, parent_40_percent_time);
+        leaf.growth_duration = leaf_growth_duration;
+        end_time = std::max(end_time, leaf.start_time + leaf.growth_duration);
+    }
+    return end_time;
+}
+
+void Tree::buildGrowthSchedule() {
+    layout_version = nextVersion();
+    schedule_end_time = scheduleGrowth(branches, leaves, max_growth_time, 0);
+    
+    for (TwigInstance& twig : twig_instances) {
+        scheduleTwig(twig);
+        schedule_end_time = std::max(schedule_end_time, twig.start_time + twig.growth_duration);
+    }
+}
+
+// Advance one active set to time t. start/duration/set_progress hide which
+// storage mode holds the fields; for_range(count, fn) runs fn(chunk, begin,
+// end) over [0, count), possibly split across threads. fn goes in a
+// reference_wrapper, which std::function holds without allocating. Returns
+// true if any progress value changed.
+template <typename StartFn, typename DurationFn, typename SetProgressFn, typename ForRange>
+static bool advanceActiveSet(GrowthActiveSet& set, float t, StartFn start_time,
+                             DurationFn duration, SetProgressFn set_progress, ForRange for_range) {
+    // === PENDING -> GROWING ===
+    // order is sorted by start time, so newly started elements form a prefix
+    // of the pending range
+    set.dropLanes();
+    while (set.next_pending < set.order.size() && t > start_time(set.order[set.next_pending])) {
+        set.growing.push_back(set.order[set.next_pending]);
+        set.next_pending++;
+    }
+    
+    // === UPDATE GROWING ===
+    // Each element writes only its own progress, so the set can be split
+    auto update = [&](int, int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            int i = set.growing[k];
+            set_progress(i, std::min(1.0f, std::max(0.0f, (t - start_time(i)) / duration(i))));
+        }
+    };
+    for_range(set.growing.size(), std::cref(update));
+    
+    // === RETIRE FINISHED ===
+    // Everything touched here changed this frame (including those finishing)
+    set.changed.assign(set.growing.begin(), set.growing.end());
+    for (size_t k = 0; k < set.growing.size(); ) {
+        int i = set.growing[k];
+        if ((t - start_time(i)) / duration(i) >= 1.0f) {
+            // Swap-remove: order within the growing set doesn't matter
+            set.growing[k] = set.growing.back();
+            set.growing.pop_back();
+            set.done++;
+        } else {
+            k++;
+        }
+    }
+    return !set.changed.empty();
+}
+
+// advanceActiveSet for SoA schedules, in the set's packed lanes: the
+// growing elements' start times and durations sit side by side, so the
+// progress kernel runs 4 or 8 lanes per instruction and then scatters.
+// Same results and the same growing order as the scalar version
+template <typename ForRange>
+static bool advanceActiveSetLanes(GrowthActiveSet& set, float t, const float* start_time,
+                                  const float* duration, float* progress, ForRange for_range) {
+    // === LANES FOR ELEMENTS ALREADY GROWING ===
+    if (set.lane_start.size() != set.growing.size()) {
+        set.lane_start.resize(set.growing.size());
+        set.lane_duration.resize(set.growing.size());
+        for (size_t k = 0; k < set.growing.size(); k++) {
+            set.lane_start[k] = start_time[set.growing[k]];
+            set.lane_duration[k] = duration[set.growing[k]];
+        }
+    }
+    
+    // === PENDING -> GROWING ===
+    while (set.next_pending < set.order.size() && t > start_time[set.order[set.next_pending]]) {
+        int i = set.order[set.next_pending];
+        set.growing.push_back(i);
+        set.lane_start.push_back(start_time[i]);
+        set.lane_duration.push_back(duration[i]);
+        set.next_pending++;
+    }
+    
+    // === UPDATE GROWING ===
+    set.lane_progress.resize(set.growing.size());
+    auto update = [&](int, int begin, int end) {
+        evaluateGrowthLanes(set.lane_start.data(), set.lane_duration.data(), t, begin, end, set.lane_progress.data());
+        for (int k = begin; k < end; k++) {
+            progress[set.growing[k]] = set.lane_progress[k];
+        }
+    };
+    for_range(set.growing.size(), std::cref(update));
+    
+    // === RETIRE FINISHED ===
+    // Progress clamps to exactly 1 when (t - start) / duration >= 1, so the
+    // lane value gives the scalar version's test; lanes swap-remove in step
+    set.changed.assign(set.growing.begin(), set.growing.end());
+    for (size_t k = 0; k < set.growing.size(); ) {
+        if (set.lane_progress[k] >= 1.0f) {
+            set.growing[k] = set.growing.back();
+            set.lane_start[k] = set.lane_start.back();
+            set.lane_duration[k] = set.lane_duration.back();
+            set.lane_progress[k] = set.lane_progress.back();
+            set.growing.pop_back();
+            set.lane_start.pop_back();
+            set.lane_duration.pop_back();
+            set.lane_progress.pop_back();
+            set.done++;
+        } else {
+            k++;
+        }
+    }
+    return !set.changed.empty();
+}
+
+// Move one active set back to time t, earlier than the one it was advanced
+// to. Only the started prefix of order can have progress; it is re-evaluated
+// and split into started / pending, and elements whose progress changed (or
+// every started one, with all_changed) go to changed. Returns the number of
+// elements that had started before.
+template <typename StartFn, typename DurationFn, typename ProgressFn, typename SetProgressFn>
+static size_t rewindActiveSet(GrowthActiveSet& set, float t, bool all_changed, StartFn start_time,
+                              DurationFn duration, ProgressFn get_progress, SetProgressFn set_progress) {
+    const size_t started = set.next_pending;
+    set.next_pending = 0;
+    set.growing.clear();
+    set.dropLanes();
+    set.changed.clear();
+    set.done = 0;
+    for (size_t k = 0; k < started; k++) {
+        int i = set.order[k];
+        float progress = std::min(1.0f, std::max(0.0f, (t - start_time(i)) / duration(i)));
+        if (all_changed || progress != get_progress(i)) {
+            set_progress(i, progress);
+            set.changed.push_back(i);
+        }
+        // Same start test as advanceActiveSet; order is sorted, so the
+        // elements still started stay a prefix
+        if (t > start_time(i)) {
+            set.next_pending = k + 1;
+            if (progress < 1.0f) {
+                set.growing.push_back(i);
+            } else {
+                set.done++;
+            }
+        }
+    }
+    return started;
+}
+
+// Indices of count elements sorted by start time
+template <typename StartFn>
+static void resetActiveSet(GrowthActiveSet& set, int count, StartFn start_time) {
+    set.order.resize(count);
+    for (int i = 0; i < count; i++) set.order[i] = i;
+    std::stable_sort(set.order.begin(), set.order.end(),
+                     [&](int a, int b) { return start_time(a) < start_time(b); });
+    set.next_pending = 0;
+    set.growing.clear();
+    set.dropLanes();
+    set.changed.clear();
+    set.done = 0;
+}
+
+void Tree::resetActiveSets() {
+    resetActiveSet(branch_activity, branches.size(),
+                   [this](int i) { return branches[i].start_time; });
+    resetActiveSet(leaf_activity, leaves.size(),
+                   [this](int i) { return leaves[i].start_time; });
+}
+
+bool Tree::updateGrowthAoS() {
+    auto for_range = [this](int count, const std::function<void(int, int, int)>& fn) { runUpdateChunks(count, fn); };
+    
+    // === BRANCH GROWTH ANIMATION ===
+    // Progress is a pure function of time: no parent lookups, no ordering needs
+    bool branches_changed = advanceActiveSet(branch_activity, current_growth_time,
+        [this](int i) { return branches[i].start_time; },
+        [this](int i) { return branches[i].growth_duration; },
+        [this](int i, float p) { branches[i].growth_progress = p; }, for_range);
+    
+    // === LEAF GROWTH ANIMATION ===
+    bool leaves_changed = advanceActiveSet(leaf_activity, current_growth_time,
+        [this](int i) { return leaves[i].start_time; },
+        [this](int i) { return leaves[i].growth_duration; },
+        [this](int i, float p) { leaves[i].growth_progress = p; }, for_range);
+    
+    return branches_changed || leaves_changed;
+}
+
+bool Tree::updateGrowthSoA() {
+    // The SIMD lane kernel over the tightly packed schedule arrays
+    auto for_range = [this](int count, const std::function<void(int, int, int)>& fn) { runUpdateChunks(count, fn); };
+    const float* start = soa.branch_start_time.data();
+    const float* duration = soa.branch_duration.data();
+    float* progress = soa.branch_progress.data();
+    bool branches_changed = advanceActiveSetLanes(branch_activity, current_growth_time,
+                                                  start, duration, progress, for_range);
+    
+    const float* leaf_start = soa.leaf_start_time.data();
+    const float* leaf_duration = soa.leaf_duration.data();
+    float* leaf_progress = soa.leaf_progress.data();
+    bool leaves_changed = advanceActiveSetLanes(leaf_activity, current_growth_time,
+                                                leaf_start, leaf_duration, leaf_progress, for_range);
+    
+    return branches_changed || leaves_changed;
+}
+
+void Tree::setGrowthTime(float time) {
+    PROFILE_SCOPE("Tree::setGrowthTime");
+    time = std::max(0.0f, time);
+    
+    // Forward seeks are one large update: elements that start and finish
+    // within the jump go straight to full growth. The clock is set, not
+    // accumulated, so seeking along a fixed tick grid hits the same times
+    // however the ticks were batched
+    if (time >= current_growth_time) {
+        advanceGrowthTo(time);
+        return;
+    }
+    
+    // === SLOTS BACK IN START ORDER ===
+    // Un-started slots are only hidden by the start-ordered draw prefix; after
+    // regenerateSubtree or pruneBranch freed or recycled slots that no longer
+    // holds, so a rewind lays the mesh out again (the renderer sees
+    // layout_changed) and rewrites every started element into the fresh slots
+    rewindGrowth(time, !slots_in_start_order && mesh_animation == MeshAnimation::Cpu);
+}
+
+void Tree::rewindGrowth(float time, bool relayout) {
+    current_growth_time = time;
+    if (relayout) {
+        assignMeshSlots();
+        layout_changed = true;
+    }
+    
+    // === RE-EVALUATE THE STARTED ELEMENTS ===
+    if (storage_mode == TreeStorageMode::StructureOfArrays) {
+        rewindActiveSet(branch_activity, time, relayout,
+            [this](int i) { return soa.branch_start_time[i]; },
+            [this](int i) { return soa.branch_duration[i]; },
+            [this](int i) { return soa.branch_progress[i]; },
+            [this](int i, float p) { soa.branch_progress[i] = p; });
+        rewindActiveSet(leaf_activity, time, relayout,
+            [this](int i) { return soa.leaf_start_time[i]; },
+            [this](int i) { return soa.leaf_duration[i]; },
+            [this](int i) { return soa.leaf_progress[i]; },
+            [this](int i, float p) { soa.leaf_progress[i] = p; });
+    } else {
+        rewindActiveSet(branch_activity, time, relayout,
+            [this](int i) { return branches[i].start_time; },
+            [this](int i) { return branches[i].growth_duration; },
+            [this](int i) { return branches[i].growth_progress; },
+            [this](int i, float p) { branches[i].growth_progress = p; });
+        rewindActiveSet(leaf_activity, time, relayout,
+            [this](int i) { return leaves[i].start_time; },
+            [this](int i) { return leaves[i].growth_duration; },
+            [this](int i) { return leaves[i].growth_progress; },
+            [this](int i, float p) { leaves[i].growth_progress = p; });
+    }
+    
+    // === STATISTICS ===
+    // Counted again from the started prefix, which only ever grew before;
+    // milestones no longer reached are re-armed
+    recountGrowthStats();
+    stats.vertices_emitted = 0;
+    
+    // === MESH UPDATE ===
+    // Elements that went back to pending drop out of the drawn prefix;
+    // the rest are rewritten as after any update
+    if (mesh_animation == MeshAnimation::Gpu ||
+        (branch_activity.changed.empty() && leaf_activity.changed.empty())) {
+        return;
+    }
+    resolveAbsolutePositions();
+    updateBranchMesh();
+    updateLeafMesh();
+}
+
+void Tree::resolveAbsolutePositions() {
+    // === SINGLE TOP-DOWN PASS ===
+    // Both branch layouts place every parent before its children, so walking
+    // the array forward always finds the parent's endpoint already resolved.
+    // This replaces the recursive walk to the trunk that every branch and
+    // leaf used to do, making the whole resolve O(N) per frame.
+    const int branch_count = branches.size();
+    absolute_start.resize(branch_count);
+    absolute_end.resize(branch_count);
+    
+    auto resolve = [this](int i) {
+        const auto& branch = branches[i];
+        
+        // === ROOT CASE: TRUNK ===
+        // Trunk has no parent, so use its stored start position;
+        // children start where their parent currently ends
+        glm::vec3 start = (branch.parent_index < 0) ? branch.start : absolute_end[branch.parent_index];
+        
+        // === GROWTH-ADJUSTED END POSITION ===
+        // Scale the fully grown direction by growth progress for the extending effect
+        glm::vec3 local_direction = branch.end - branch.start;
+        absolute_start[i] = start;
+        absolute_end[i] = start + local_direction * branchProgress(i);
+    };
+    
+    // With an update pool the pass goes one depth level at a time instead:
+    // a level reads only the level above, so its branches run in parallel
+    if (update_pool) {
+        forEachLevel(resolve);
+        return;
+    }
+    for (int i = 0; i < branch_count; i++) {
+        resolve(i);
+    }
+}
+
+// === PARALLEL UPDATE ===
+
+void Tree::setUpdateThreads(int threads) {
+    update_threads = std::max(0, threads);
+    if (update_threads <= 1) {
+        update_pool.reset();
+    } else if (!update_pool || update_pool->getThreads() != update_threads) {
+        update_pool = std::make_shared<TreeJobPool>(update_threads);
+        reserveUpdateScratch();
+    }
+}
+
+void Tree::reserveUpdateScratch() {
+    // Every list an update fills is bounded by an element or slot count, so
+    // with this capacity in place the frame loop never reaches the allocator:
+    // the active sets hold at most their elements, the dirty lists one entry
+    // per slot, each update chunk at most UPDATE_CHUNK, and the milestones
+    // until the next take about two per generation
+    GrowthActiveSet* sets[] = {&branch_activity, &leaf_activity};
+    for (GrowthActiveSet* set : sets) {
+        size_t count = set->order.size();
+        set->growing.reserve(count);
+        set->changed.reserve(count);
+        if (storage_mode == TreeStorageMode::StructureOfArrays) {
+            set->lane_start.reserve(count);
+            set->lane_duration.reserve(count);
+            set->lane_progress.reserve(count);
+        }
+    }
+    branch_dirty_slots.reserve(branch_slot_dirty.size());
+    leaf_dirty_slots.reserve(leaf_slot_dirty.size());
+    growth_events.reserve(2 * stats.branches_by_generation.size() + 1);
+    
+    // Serially the one chunk spans every slot
+    if (!update_pool) {
+        update_chunk_dirty.resize(std::max<size_t>(update_chunk_dirty.size(), 1));
+        update_chunk_dirty[0].reserve(std::max(branch_slot_dirty.size(), leaf_slot_dirty.size()));
+        update_chunk_emitted.reserve(1);
+        return;
+    }
+    const int chunks = TreeJobPool::chunkCount(std::max(branches.size(), leaves.size()), UPDATE_CHUNK);
+    if (static_cast<int>(update_chunk_dirty.size()) < chunks) {
+        update_chunk_dirty.resize(chunks);
+    }
+    for (std::vector<int>& dirty : update_chunk_dirty) {
+        dirty.reserve(UPDATE_CHUNK);
+    }
+    update_chunk_emitted.reserve(chunks);
+    if (update_level_branches.size() != branches.size()) {
+        buildUpdateLevels();
+    }
+}
+
+void Tree::runUpdateChunks(int count, const std::function<void(int, int, int)>& fn) {
+    if (count <= 0) return;
+    if (update_pool) {
+        update_pool->parallelFor(count, UPDATE_CHUNK, fn);
+    } else {
+        fn(0, 0, count);
+    }
+}
+
+void Tree::prepareUpdateChunks(int count) {
+    // One chunk per UPDATE_CHUNK elements on the pool, the whole range without
+    const int chunks = update_pool ? TreeJobPool::chunkCount(count, UPDATE_CHUNK) : 1;
+    update_chunk_dirty.resize(std::max<size_t>(update_chunk_dirty.size(), chunks));
+    for (int c = 0; c < chunks; c++) {
+        update_chunk_dirty[c].clear();
+    }
+    update_chunk_emitted.assign(chunks, 0);
+}
+
+void Tree::mergeUpdateChunks(std::vector<int>& dirty_slots) {
+    // Chunk order is index order whatever the thread count; takeDirtyRanges
+    // sorts the slots anyway
+    for (size_t c = 0; c < update_chunk_emitted.size(); c++) {
+        dirty_slots.insert(dirty_slots.end(), update_chunk_dirty[c].begin(), update_chunk_dirty[c].end());
+        stats.vertices_emitted += update_chunk_emitted[c];
+    }
+}
+
+void Tree::buildUpdateLevels() {
+    // Depth from the parent links (parents precede children), then a counting
+    // sort into one index range per depth
+    const int branch_count = branches.size();
+    std::vector<int> depth(branch_count);
+    int level_count = 0;
+    for (int i = 0; i < branch_count; i++) {
+        int parent = branches[i].parent_index;
+        depth[i] = (parent < 0) ? 0 : depth[parent] + 1;
+        level_count = std::max(level_count, depth[i] + 1);
+    }
+    update_level_offsets.assign(level_count + 1, 0);
+    for (int i = 0; i < branch_count; i++) {
+        update_level_offsets[depth[i] + 1]++;
+    }
+    for (int l = 0; l < level_count; l++) {
+        update_level_offsets[l + 1] += update_level_offsets[l];
+    }
+    std::vector<int> next(update_level_offsets.begin(), update_level_offsets.end() - 1);
+    update_level_branches.resize(branch_count);
+    for (int i = 0; i < branch_count; i++) {
+        update_level_branches[next[depth[i]]++] = i;
+    }
+}
+
+void Tree::forEachLevel(const std::function<void(int)>& fn) {
+    if (update_level_branches.size() != branches.size()) {
+        buildUpdateLevels();
+    }
+    for (size_t l = 0; l + 1 < update_level_offsets.size(); l++) {
+        const int* level = update_level_branches.data() + update_level_offsets[l];
+        runUpdateChunks(update_level_offsets[l + 1] - update_level_offsets[l], [level, &fn](int, int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                fn(level[k]);
+            }
+        });
+    }
+}
+
+void Tree::assignMeshSlots() {
+    layout_version = nextVersion();
+    mesh_version = nextVersion();
+    // === FIXED SLOTS IN START-TIME ORDER ===
+    // Slot k belongs to the k-th element to start growing, so the started
+    // (visible) elements always occupy the prefix [0, started count) and the
+    // renderer can draw that prefix without gaps or degenerate triangles
+    branch_slot.resize(branches.size());
+    for (size_t k = 0; k < branch_activity.order.size(); k++) {
+        branch_slot[branch_activity.order[k]] = k;
+    }
+    leaf_slot.resize(leaves.size());
+    for (size_t k = 0; k < leaf_activity.order.size(); k++) {
+        leaf_slot[leaf_activity.order[k]] = k;
+    }
+    buildLeafRanges();
+    
+    // === VARIABLE BRANCH SLOT SIZES ===
+    // Welded branches reuse their parent's end ring and own only one ring
+    buildBranchFrames();
+    branch_vertex_offset.resize(branches.size() + 1);
+    branch_vertex_offset[0] = 0;
+    for (size_t k = 0; k < branch_activity.order.size(); k++) {
+        branch_vertex_offset[k + 1] = branch_vertex_offset[k] + branchSlotVertices(branch_activity.order[k]);
+    }
+    buildBranchIndices();
+    
+    // === LEAF SLOTS ===
+    // Single-sided quads: corners v1..v4, triangles (v1,v3,v2), (v1,v4,v3)
+    // wound counter-clockwise around the leaf normal
+    leaf_indices.clear();
+    if (leaf_faces == LeafFaces::SingleSided) {
+        leaf_slot_vertices = LEAF_SINGLE_SLOT_VERTICES;
+        leaf_indices.resize(leaves.size() * LEAF_SINGLE_SLOT_INDICES);
+        uint32_t* index = leaf_indices.data();
+        for (size_t s = 0; s < leaves.size(); s++) {
+            uint32_t base = s * LEAF_SINGLE_SLOT_VERTICES;
+            *index++ = base; *index++ = base + 2; *index++ = base + 1;
+            *index++ = base; *index++ = base + 3; *index++ = base + 2;
+        }
+    } else {
+        leaf_slot_vertices = LEAF_SLOT_VERTICES;
+    }
+    
+    // GPU-animated trees never touch the per-frame arrays
+    size_t branch_floats = 0;
+    size_t leaf_floats = 0;
+    size_t branch_instance_count = 0;
+    size_t instance_count = 0;
+    if (mesh_animation == MeshAnimation::Cpu) {
+        if (branch_rendering == BranchRendering::Instanced) {
+            branch_instance_count = branches.size();
+        } else {
+            branch_floats = branch_vertex_offset.back() * VERTEX_FLOATS;
+        }
+        if (leaf_rendering == LeafRendering::Instanced) {
+            instance_count = leaves.size();
+        } else {
+            leaf_floats = leaves.size() * leaf_slot_vertices * VERTEX_FLOATS;
+        }
+    }
+    branch_vertices.assign(branch_floats, 0.0f);
+    leaf_vertices.assign(leaf_floats, 0.0f);
+    BranchInstance unstarted_branch = {glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 0.0f};
+    branch_instances.assign(branch_instance_count, unstarted_branch);
+    LeafInstance unstarted = {glm::vec3(0.0f), 0u, 0.0f, 0.0f};
+    leaf_instances.assign(instance_count, unstarted);
+    
+    branch_slot_dirty.assign(branches.size(), 0);
+    leaf_slot_dirty.assign(leaves.size(), 0);
+    branch_dirty_slots.clear();
+    leaf_dirty_slots.clear();
+    branch_moved.assign(branches.size(), 0);
+    
+    slots_in_start_order = true;
+    leaf_slot_count = leaves.size();
+    free_branch_slots.clear();
+    free_leaf_slots.clear();
+    layout_changed = false;
+}
+
+void Tree::setRingSegmentRange(int min_segments, int max_segments) {
+    min_ring_segments = std::max(MIN_RING_SEGMENTS, std::min(min_segments, MAX_RING_SEGMENTS));
+    max_ring_segments = std::max(min_ring_segments, std::min(max_segments, MAX_RING_SEGMENTS));
+}
+
+void Tree::setBranchCurvature(float curvature, int vertex_budget) {
+    branch_curvature = std::max(0.0f, curvature);
+    curve_vertex_budget = std::max(0, vertex_budget);
+}
+
+void Tree::buildBranchFrames() {
+    const int branch_count = branches.size();
+    branch_right.resize(branch_count);
+    branch_up.resize(branch_count);
+    branch_tex_v.resize(branch_count);
+    branch_welded.assign(branch_count, 0);
+    branch_segments.resize(branch_count);
+    
+    // === RING SEGMENTS PER BRANCH ===
+    for (int i = 0; i < branch_count; i++) {
+        branch_segments[i] = ringSegmentsFor(i);
+    }
+    
+    // === PICK THE DOMINANT CHILD OF EVERY BRANCH (TUBES ONLY) ===
+    // The child that continues most straight on carries the limb; its base
+    // ring is the parent's end ring (radii already match: the parent tapers
+    // to 70% and children are radius_reduction_factor thinner). Parents
+    // precede children, so a parent's sides are final when it is visited
+    if (branch_meshing == BranchMeshing::Tubes && branch_rendering == BranchRendering::Mesh) {
+        for (int i = 0; i < branch_count; i++) {
+            const TreeBranch& branch = branches[i];
+            glm::vec3 direction = glm::normalize(branch.end - branch.start);
+            int best = -1;
+            float best_dot = -2.0f;
+            const int* children = getChildren(i);
+            for (int c = 0; c < branch.child_count; c++) {
+                const TreeBranch& child = branches[children[c]];
+                float d = glm::dot(direction, glm::normalize(child.end - child.start));
+                if (d > best_dot) {
+                    best_dot = d;
+                    best = children[c];
+                }
+            }
+            if (best >= 0) {
+                // A welded ring is shared, so the limb keeps its parent's sides
+                branch_welded[best] = 1;
+                branch_segments[best] = branch_segments[i];
+            }
+        }
+    }
+    
+    // Sections last: their ring sizes are final only after the welding
+    chooseCurveSections();
+    
+    // === RING FRAMES ===
+    // Parents precede children, so one forward pass can hand each welded
+    // child its parent's frame, transported onto the child's axis so the
+    // two rings of a joint line up vertex for vertex without twisting
+    for (int i = 0; i < branch_count; i++) {
+        buildBranchFrame(i);
     }
 }
 
+int Tree::ringSegmentsFor(int branch_index) const {
+    // Sides proportional to radius keep the facet width roughly constant, so
+    // the many thin high-generation twigs get a few sides and the trunk the
+    // most. Instanced branches all share the fixed 8-sided unit cylinder
+    if (branch_rendering == BranchRendering::Instanced) {
+        return BRANCH_RING_VERTICES - 1;
+    }
+    const float trunk_radius = branches[0].radius;
+    int segments = (int)roundf(max_ring_segments * branches[branch_index].radius / trunk_radius);
+    return std::max(min_ring_segments, std::min(segments, max_ring_segments));
+}
+
+// A curved branch's bowed axis misses its straight sections by at most this
+// share of its radius; branches thicker than CURVE_SLENDER_RATIO of their
+// length bow less, as the tessellated tubes do (tc_branch_tubes.glsl)
+static const float CURVE_TOLERANCE = 0.25f;
+static const float CURVE_SLENDER_RATIO = 30.0f;
+
+// A branch's own droop in [0.5, 1.5), hashed from its base point so the
+// branch keeps it whatever its index
+static float droopFor(const glm::vec3& base) {
+    uint32_t hash = glm::floatBitsToUint(base.x) * 2654435761u ^ glm::floatBitsToUint(base.y) * 40503u ^
+                    glm::floatBitsToUint(base.z) * 2246822519u;
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6du;
+    hash ^= hash >> 12;
+    return 0.5f + (hash >> 8) * (1.0f / 16777216.0f);
+}
+
+void Tree::chooseCurveSections() {
+    const int branch_count = branches.size();
+    branch_sections.assign(branch_count, 1);
+    branch_sag.assign(branch_count, glm::vec3(0.0f));
+    if (branch_curvature <= 0.0f || branch_rendering != BranchRendering::Mesh) return;
+    
+    // === SAG: DOWN, SQUARE TO THE CHORD ===
+    // n straight sections miss a bow of b by about b / n^2
+    std::vector<unsigned char> wanted(branch_count, 1);
+    long long extra_vertices = 0;
+    for (int i = 0; i < branch_count; i++) {
+        const TreeBranch& branch = branches[i];
+        glm::vec3 axis = branch.end - branch.start;
+        float len = glm::length(axis);
+        if (len < 1e-6f || branch.radius <= 0.0f) continue;
+        glm::vec3 direction = axis / len;
+        glm::vec3 down = glm::vec3(0.0f, -1.0f, 0.0f) + direction * direction.y;
+        if (glm::length(down) < 1e-3f) continue; // Vertical: the trunk stands straight
+        float horizontal = std::sqrt(std::max(1.0f - direction.y * direction.y, 0.0f));
+        float slender = std::min(len / (branch.radius * CURVE_SLENDER_RATIO), 1.0f);
+        float bow = branch_curvature * len * horizontal * slender * droopFor(branch.start);
+        int sections = (int)std::ceil(std::sqrt(bow / (CURVE_TOLERANCE * branch.radius)));
+        sections = std::max(1, std::min(sections, MAX_CURVE_SECTIONS));
+        if (sections == 1) continue;
+        wanted[i] = sections;
+        branch_sag[i] = glm::normalize(down) * bow;
+        extra_vertices += (long long)(sections - 1) * branchRingVertices(i);
+    }
+    if (curve_vertex_budget <= 0 || extra_vertices <= curve_vertex_budget) {
+        branch_sections.swap(wanted);
+        return;
+    }
+    
+    // === VERTEX BUDGET ===
+    // Over budget, sections go one at a time to the branch whose straight
+    // sections miss its bow by the most against its radius, while their
+    // rings fit; one left with a single section is straight after all
+    std::priority_queue<std::pair<float, int> > worst;
+    for (int i = 0; i < branch_count; i++) {
+        if (wanted[i] > 1) worst.push(std::make_pair(glm::length(branch_sag[i]) / branches[i].radius, i));
+    }
+    int remaining = curve_vertex_budget;
+    while (!worst.empty()) {
+        const int i = worst.top().second;
+        worst.pop();
+        if (branchRingVertices(i) > remaining) continue;
+        remaining -= branchRingVertices(i);
+        const int sections = ++branch_sections[i];
+        if (sections < wanted[i]) {
+            worst.push(std::make_pair(glm::length(branch_sag[i]) / (branches[i].radius * sections * sections), i));
+        }
+    }
+    for (int i = 0; i < branch_count; i++) {
+        if (branch_sections[i] == 1) branch_sag[i] = glm::vec3(0.0f);
+    }
+}
 
-void Tree::addLeafQuad(glm::vec3 position, glm::vec3 normal, float size, float growth) {
-    // === SIZE ANIMATION ===
-    // Apply minimum size to prevent leaves from completely disappearing
-    float min_size = 0.05f;
-    size = min_size + (size - min_size) * growth;
+void Tree::buildBranchFrame(int i) {
+    const TreeBranch& branch = branches[i];
+    glm::vec3 direction = glm::normalize(branch.end - branch.start);
+    glm::vec3 right(0.0f);
     
-    // === LOCAL COORDINATE SYSTEM GENERATION ===
-    // Create orthogonal coordinate system for quad orientation
+    if (branch_welded[i]) {
+        glm::vec3 parent_right = branch_right[branch.parent_index];
+        right = parent_right - glm::dot(parent_right, direction) * direction;
+    }
     
-    // Calculate right vector (horizontal across leaf)
-    glm::vec3 right = glm::normalize(glm::cross(normal, glm::vec3(0,1,0)));
     if (glm::length(right) < 0.01f) {
-        // Handle case where normal is parallel to Y-axis
-        right = glm::vec3(1,0,0);
+        // Independent frame: handle near-vertical branches to avoid parallel vectors
+        glm::vec3 up = glm::vec3(0, 1, 0);
+        if (abs(glm::dot(direction, up)) > 0.9f) {
+            up = glm::vec3(1, 0, 0);  // Use X-axis if branch is nearly vertical
+        }
+        right = glm::cross(direction, up);
     }
     
-    // Calculate up vector (vertical across leaf) 
-    glm::vec3 up = glm::normalize(glm::cross(right, normal));
+    // Complete orthogonal coordinate system
+    branch_right[i] = glm::normalize(right);
+    branch_up[i] = glm::normalize(glm::cross(branch_right[i], direction));
+    
+    // Texture V runs 0..1 along one branch and keeps counting along a tube
+    branch_tex_v[i] = branch_welded[i] ? branch_tex_v[branch.parent_index] + 1.0f : 0.0f;
+}
+
+int Tree::branchSlotVertices(int branch_index) const {
+    int ring = branchRingVertices(branch_index);
+    int sections = branch_sections[branch_index];
+    return branch_welded[branch_index] ? ring * sections : ring * (sections + 1);
+}
+
+int Tree::branchEndRingVertex(int branch_index) const {
+    return branch_vertex_offset[branch_slot[branch_index]] + branchSlotVertices(branch_index) - branchRingVertices(branch_index);
+}
+
+// === SPECIALIZED MESH BUILDERS ===
+
+// Write one vertex (vec4 position with w = 1, vec2 texcoord, vec3 normal)
+// at the cursor and return the cursor advanced past it
+static inline float* writeVertex(float* out, const glm::vec3& p, float u, float v, const glm::vec3& n) {
+    out[0] = p.x; out[1] = p.y; out[2] = p.z; out[3] = 1.0f;
+    out[4] = u; out[5] = v;
+    out[6] = n.x; out[7] = n.y; out[8] = n.z;
+    return out + Tree::VERTEX_FLOATS;
+}
+
+// Baked occlusion into the position w of the vertices in [begin, end)
+static void stampOcclusion(float* begin, float* end, float occlusion) {
+    for (float* vertex = begin; vertex < end; vertex += Tree::VERTEX_FLOATS) {
+        vertex[3] = occlusion;
+    }
+}
+
+// One branch's rings as addBranchSegment emits them
+struct BranchRingFrame {
+    glm::vec3 start;
+    glm::vec3 end;
+    glm::vec3 right;
+    glm::vec3 up;
+    float start_radius;
+    float end_radius;
+    float base_v;
+    int first_ring; // 1 when welded: the parent's end ring stands in for the start ring
+};
+
+// Emit the start ring, then the end ring; the index buffer built in
+// buildBranchIndices stitches them into triangles. The first vertex of each
+// ring is repeated at angle 2*pi so the texture can wrap
+template <typename Segments>
+static inline float* writeRings(float* out, const BranchRingFrame& frame, Segments segments) {
+    // === RING DIRECTIONS ===
+    // radial = right*cos(θ) + up*sin(θ) and the normal outward from the
+    // cylinder axis (Y ignored) depend only on the frame, so both rings
+    // share them; evaluated a vector of ring points at a time
+    RingLanes directions;
+    evaluateRingLanes(Tree::ringUnitCircleLanes(segments), segments + 1, frame.right, frame.up, directions);
     
-    // Scale vectors by half-size for quad corner calculation
-    right *= size * 0.5f;
-    up *= size * 0.5f;
+    for (int ring = frame.first_ring; ring < 2; ring++) {
+        glm::vec3 center = (ring == 0) ? frame.start : frame.end;
+        float radius = (ring == 0) ? frame.start_radius : frame.end_radius;
+        // Texture V goes from base to tip along branch length
+        float v = frame.base_v + (float)ring;
+        
+        for (int i = 0; i <= segments; i++) {
+            // Texture U wraps around circumference
+            float u = (float)i / segments;
+            
+            // === VERTEX POSITION CALCULATION ===
+            // point = center + right*cos(θ)*radius + up*sin(θ)*radius
+            glm::vec3 radial(directions.radial_x[i], directions.radial_y[i], directions.radial_z[i]);
+            glm::vec3 p = center + radial * radius;
+            glm::vec3 n(directions.normal_x[i], directions.normal_y[i], directions.normal_z[i]);
+            
+            out = writeVertex(out, p, u, v, n);
+        }
+    }
+    return out;
+}
+
+// A curved branch's rings, one per section end: the axis is the parabola
+// through the fixed ends sagging sag below the chord at mid-length, as
+// te_branch_tubes.glsl bends it, and each ring is the branch's frame turned
+// square to the axis there, tapered like the straight cylinder
+static float* writeCurvedRings(float* out, const BranchRingFrame& frame, int segments, int sections,
+                               const glm::vec3& sag) {
+    const RingCircleLanes& circle = Tree::ringUnitCircleLanes(segments);
+    const glm::vec3 axis = frame.end - frame.start;
+    // A branch that has barely started keeps its frame's own axis
+    const glm::vec3 straight = glm::cross(frame.up, frame.right);
+    RingLanes directions;
+    for (int ring = frame.first_ring; ring <= sections; ring++) {
+        float t = (float)ring / sections;
+        glm::vec3 center = frame.start + axis * t + sag * (4.0f * t * (1.0f - t));
+        glm::vec3 tangent = axis + sag * (4.0f - 8.0f * t);
+        float tangent_length = glm::length(tangent);
+        tangent = (tangent_length > 1e-6f) ? tangent / tangent_length : straight;
+        glm::vec3 right = glm::normalize(frame.right - tangent * glm::dot(frame.right, tangent));
+        glm::vec3 up = glm::cross(right, tangent);
+        evaluateRingLanes(circle, segments + 1, right, up, directions);
+        
+        float radius = frame.start_radius + (frame.end_radius - frame.start_radius) * t;
+        float v = frame.base_v + t;
+        for (int i = 0; i <= segments; i++) {
+            float u = (float)i / segments;
+            glm::vec3 radial(directions.radial_x[i], directions.radial_y[i], directions.radial_z[i]);
+            glm::vec3 n(directions.normal_x[i], directions.normal_y[i], directions.normal_z[i]);
+            out = writeVertex(out, center + radial * radius, u, v, n);
+        }
+    }
+    return out;
+}
+
+// Quad i of a slot joins ring vertices i, i+1 of the start ring (p1, p2)
+// with the same two of the end ring (p3, p4): triangles (p1,p2,p3), (p2,p4,p3)
+template <typename Segments>
+static inline uint32_t* writeSlotIndices(uint32_t* out, Segments segments, uint32_t start_ring, uint32_t end_ring) {
+    for (int i = 0; i < segments; i++) {
+        uint32_t p1 = start_ring + i;
+        uint32_t p2 = p1 + 1;
+        uint32_t p3 = end_ring + i;
+        uint32_t p4 = p3 + 1;
+        *out++ = p1; *out++ = p2; *out++ = p3;
+        *out++ = p2; *out++ = p4; *out++ = p3;
+    }
+    return out;
+}
+
+// Side count as a compile-time constant: the loops above get fixed trip
+// counts the compiler unrolls and vectorizes, and the slot sizes are
+// constants. Instantiated once per supported ring size
+template <int Segments>
+struct BranchMeshBuilder {
+    static const int RING_VERTICES = Segments + 1;
+    static const int SLOT_VERTICES = 2 * RING_VERTICES;
+    static const int SLOT_INDICES = 6 * Segments;
+    typedef std::integral_constant<int, Segments> Count;
     
+    static float* rings(float* out, const BranchRingFrame& frame) {
+        return writeRings(out, frame, Count());
+    }
+    static uint32_t* indices(uint32_t* out, uint32_t start_ring, uint32_t end_ring) {
+        return writeSlotIndices(out, Count(), start_ring, end_ring);
+    }
+};
+
+template <int Segments> const int BranchMeshBuilder<Segments>::RING_VERTICES;
+template <int Segments> const int BranchMeshBuilder<Segments>::SLOT_VERTICES;
+template <int Segments> const int BranchMeshBuilder<Segments>::SLOT_INDICES;
+
+static_assert(BranchMeshBuilder<Tree::BRANCH_RING_VERTICES - 1>::SLOT_VERTICES == Tree::BRANCH_SLOT_VERTICES &&
+              BranchMeshBuilder<Tree::BRANCH_RING_VERTICES - 1>::SLOT_INDICES == Tree::BRANCH_SLOT_INDICES,
+              "Instanced branch slots are 8-sided builder slots");
+
+// Dispatch table from ring size to its builder
+struct BranchBuilderEntry {
+    float* (*rings)(float* out, const BranchRingFrame& frame);
+    uint32_t* (*indices)(uint32_t* out, uint32_t start_ring, uint32_t end_ring);
+};
+
+#define BRANCH_BUILDER(S) { &BranchMeshBuilder<S>::rings, &BranchMeshBuilder<S>::indices }
+static const BranchBuilderEntry BRANCH_BUILDERS[] = {
+    BRANCH_BUILDER(3), BRANCH_BUILDER(4), BRANCH_BUILDER(5), BRANCH_BUILDER(6),
+    BRANCH_BUILDER(7), BRANCH_BUILDER(8), BRANCH_BUILDER(9), BRANCH_BUILDER(10),
+    BRANCH_BUILDER(11), BRANCH_BUILDER(12), BRANCH_BUILDER(13), BRANCH_BUILDER(14),
+    BRANCH_BUILDER(15), BRANCH_BUILDER(16)
+};
+#undef BRANCH_BUILDER
+
+static_assert(sizeof(BRANCH_BUILDERS) / sizeof(BRANCH_BUILDERS[0]) == Tree::MAX_RING_SEGMENTS - Tree::MIN_RING_SEGMENTS + 1,
+              "One specialized builder per supported ring size");
+
+// Specialized builder for a ring size, or null for the runtime loops
+static const BranchBuilderEntry* branchBuilder(int segments) {
+    if (segments < Tree::MIN_RING_SEGMENTS || segments > Tree::MAX_RING_SEGMENTS) return nullptr;
+    return &BRANCH_BUILDERS[segments - Tree::MIN_RING_SEGMENTS];
+}
+
+// Triangles of one branch slot, through the specialized builder for its ring size
+static uint32_t* writeBranchIndices(uint32_t* out, int segments, uint32_t start_ring, uint32_t end_ring) {
+    const BranchBuilderEntry* builder = branchBuilder(segments);
+    return builder ? builder->indices(out, start_ring, end_ring)
+                   : writeSlotIndices(out, segments, start_ring, end_ring);
+}
+
+// Leaf quad with the face count fixed at compile time, so the face branch
+// folds away inside the quad builder
+template <LeafFaces Faces>
+struct LeafMeshBuilder {
+    static float* quad(float* out, glm::vec3 position, glm::vec3 normal, glm::vec3 right, glm::vec3 up);
+};
+
+template <LeafFaces Faces>
+float* LeafMeshBuilder<Faces>::quad(float* out, glm::vec3 position, glm::vec3 normal, glm::vec3 right, glm::vec3 up) {
     // === QUAD CORNER CALCULATION ===
-    // Generate 4 corners of rectangular leaf quad
+    // Generate 4 corners of rectangular leaf quad; right and up arrive
+    // scaled to half the leaf's size
     glm::vec3 v1 = position - right - up;  // Bottom-left
     glm::vec3 v2 = position + right - up;  // Bottom-right  
     glm::vec3 v3 = position + right + up;  // Top-right
@@ -523,17 +2166,28 @@ void Tree::addLeafQuad(glm::vec3 position, glm::vec3 normal, float size, float g
     glm::vec2 t3(1.0f, 1.0f);  // Top-right of texture
     glm::vec2 t4(0.0f, 1.0f);  // Top-left of texture
     
+    // === SINGLE-SIDED: FOUR SHARED CORNERS ===
+    // The index buffer makes the triangles; the fragment shader flips the
+    // normal for the back face
+    if (Faces == LeafFaces::SingleSided) {
+        out = writeVertex(out, v1, t1.x, t1.y, normal);
+        out = writeVertex(out, v2, t2.x, t2.y, normal);
+        out = writeVertex(out, v3, t3.x, t3.y, normal);
+        out = writeVertex(out, v4, t4.x, t4.y, normal);
+        return out;
+    }
+    
     // === FRONT FACE TRIANGLES ===
     // Generate front-facing side of leaf (normal direction)
     // Triangle 1: v1, v2, v3
-    leaf_vertices.insert(leaf_vertices.end(), {v1.x, v1.y, v1.z, 1.0f, t1.x, t1.y, normal.x, normal.y, normal.z});
-    leaf_vertices.insert(leaf_vertices.end(), {v2.x, v2.y, v2.z, 1.0f, t2.x, t2.y, normal.x, normal.y, normal.z});
-    leaf_vertices.insert(leaf_vertices.end(), {v3.x, v3.y, v3.z, 1.0f, t3.x, t3.y, normal.x, normal.y, normal.z});
+    out = writeVertex(out, v1, t1.x, t1.y, normal);
+    out = writeVertex(out, v2, t2.x, t2.y, normal);
+    out = writeVertex(out, v3, t3.x, t3.y, normal);
     
     // Triangle 2: v1, v3, v4
-    leaf_vertices.insert(leaf_vertices.end(), {v1.x, v1.y, v1.z, 1.0f, t1.x, t1.y, normal.x, normal.y, normal.z});
-    leaf_vertices.insert(leaf_vertices.end(), {v3.x, v3.y, v3.z, 1.0f, t3.x, t3.y, normal.x, normal.y, normal.z});
-    leaf_vertices.insert(leaf_vertices.end(), {v4.x, v4.y, v4.z, 1.0f, t4.x, t4.y, normal.x, normal.y, normal.z});
+    out = writeVertex(out, v1, t1.x, t1.y, normal);
+    out = writeVertex(out, v3, t3.x, t3.y, normal);
+    out = writeVertex(out, v4, t4.x, t4.y, normal);
     
     // === BACK FACE TRIANGLES ===
     // Generate back-facing side of leaf (-normal direction)
@@ -541,12 +2195,1313 @@ void Tree::addLeafQuad(glm::vec3 position, glm::vec3 normal, float size, float g
     glm::vec3 back_normal = -normal;
     
     // Triangle 1: v1, v3, v2 (reversed winding)
-    leaf_vertices.insert(leaf_vertices.end(), {v1.x, v1.y, v1.z, 1.0f, t1.x, t1.y, back_normal.x, back_normal.y, back_normal.z});
-    leaf_vertices.insert(leaf_vertices.end(), {v3.x, v3.y, v3.z, 1.0f, t3.x, t3.y, back_normal.x, back_normal.y, back_normal.z});
-    leaf_vertices.insert(leaf_vertices.end(), {v2.x, v2.y, v2.z, 1.0f, t2.x, t2.y, back_normal.x, back_normal.y, back_normal.z});
+    out = writeVertex(out, v1, t1.x, t1.y, back_normal);
+    out = writeVertex(out, v3, t3.x, t3.y, back_normal);
+    out = writeVertex(out, v2, t2.x, t2.y, back_normal);
     
     // Triangle 2: v1, v4, v3 (reversed winding)
-    leaf_vertices.insert(leaf_vertices.end(), {v1.x, v1.y, v1.z, 1.0f, t1.x, t1.y, back_normal.x, back_normal.y, back_normal.z});
-    leaf_vertices.insert(leaf_vertices.end(), {v4.x, v4.y, v4.z, 1.0f, t4.x, t4.y, back_normal.x, back_normal.y, back_normal.z});
-    leaf_vertices.insert(leaf_vertices.end(), {v3.x, v3.y, v3.z, 1.0f, t3.x, t3.y, back_normal.x, back_normal.y, back_normal.z});
+    out = writeVertex(out, v1, t1.x, t1.y, back_normal);
+    out = writeVertex(out, v4, t4.x, t4.y, back_normal);
+    out = writeVertex(out, v3, t3.x, t3.y, back_normal);
+    return out;
+}
+
+// Up to LEAF_LANES leaf quads waiting for their frames: each leaf's
+// orthogonal coordinate system is evaluated for the whole batch at once
+// (evaluateLeafFrameLanes), then its corners are written to its slot
+struct LeafQuadBatch {
+    LeafFrameLanes frames;
+    glm::vec3 position[LEAF_LANES];
+    float* out[LEAF_LANES];
+    float occlusion[LEAF_LANES];
+    int count;
+    
+    LeafQuadBatch() : count(0) {}
+    
+    // Queue a quad; the caller flushes a full batch before the next add
+    void add(float* slot, glm::vec3 pos, glm::vec3 normal, float size, float growth, float leaf_occlusion) {
+        // === SIZE ANIMATION ===
+        // Apply minimum size to prevent leaves from completely disappearing
+        float min_size = 0.05f;
+        size = min_size + (size - min_size) * growth;
+        
+        frames.normal_x[count] = normal.x;
+        frames.normal_y[count] = normal.y;
+        frames.normal_z[count] = normal.z;
+        // Right and up are scaled by half-size for the corner calculation
+        frames.half_size[count] = size * 0.5f;
+        position[count] = pos;
+        out[count] = slot;
+        occlusion[count] = leaf_occlusion;
+        count++;
+    }
+    bool full() const { return count == LEAF_LANES; }
+    
+    // Write every queued quad; returns the cursor past the last one
+    template <LeafFaces Faces>
+    float* flush() {
+        evaluateLeafFrameLanes(frames, count);
+        float* end = nullptr;
+        for (int k = 0; k < count; k++) {
+            glm::vec3 normal(frames.normal_x[k], frames.normal_y[k], frames.normal_z[k]);
+            glm::vec3 right(frames.right_x[k], frames.right_y[k], frames.right_z[k]);
+            glm::vec3 up(frames.up_x[k], frames.up_y[k], frames.up_z[k]);
+            end = LeafMeshBuilder<Faces>::quad(out[k], position[k], normal, right, up);
+            if (occlusion[k] != 1.0f) stampOcclusion(out[k], end, occlusion[k]);
+        }
+        count = 0;
+        return end;
+    }
+    float* flush(LeafFaces faces) {
+        return faces == LeafFaces::SingleSided ? flush<LeafFaces::SingleSided>() : flush<LeafFaces::DoubleSided>();
+    }
+};
+
+void Tree::buildBranchIndices() {
+    // === BRANCH INDICES ===
+    // A welded branch's start ring is its parent's end ring
+    const size_t slot_count = branch_activity.order.size();
+    branch_index_offset.resize(slot_count + 1);
+    branch_index_offset[0] = 0;
+    for (size_t s = 0; s < slot_count; s++) {
+        branch_index_offset[s + 1] = branch_index_offset[s] + branchSlotIndices(branch_activity.order[s]);
+    }
+    
+    // Every slot starts at its offset from the prefix sum, so chunks of
+    // slots fill disjoint parts of the array
+    branch_indices.resize(branch_index_offset.back());
+    auto fill = [this](int, int begin, int end) {
+        for (int s = begin; s < end; s++) {
+            int b = branch_activity.order[s];
+            uint32_t end_ring = branchEndRingVertex(b);
+            uint32_t start_ring = branch_welded[b] ? branchEndRingVertex(branches[b].parent_index)
+                                                 : branch_vertex_offset[s];
+            uint32_t* out = &branch_indices[branch_index_offset[s]];
+            // A curved branch's sections, each joining a ring to the next of the slot's own
+            uint32_t ring = branch_welded[b] ? branch_vertex_offset[s] : start_ring + branchRingVertices(b);
+            for (int section = 1; section < branch_sections[b]; section++) {
+                out = writeBranchIndices(out, branch_segments[b], start_ring, ring);
+                start_ring = ring;
+                ring += branchRingVertices(b);
+            }
+            writeBranchIndices(out, branch_segments[b], start_ring, end_ring);
+        }
+    };
+    runUpdateChunks(slot_count, std::cref(fill));
+}
+
+static void markSlotDirty(int slot, std::vector<unsigned char>& flags, std::vector<int>& list) {
+    if (!flags[slot]) {
+        flags[slot] = 1;
+        list.push_back(slot);
+    }
+}
+
+void Tree::updateBranchMesh() {
+    PROFILE_SCOPE("Tree::updateBranchMesh");
+    mesh_version = nextVersion();
+    // === FIND BRANCHES WHOSE GEOMETRY CHANGED ===
+    // A branch moves if its own progress changed or any ancestor's did (its
+    // start point is the ancestor's animated end); parents precede children,
+    // so one forward pass propagates the flag down every subtree
+    const int branch_count = branches.size();
+    std::fill(branch_moved.begin(), branch_moved.end(), 0);
+    for (int i : branch_activity.changed) {
+        branch_moved[i] = 1;
+    }
+    auto propagate = [this](int i) {
+        int parent = branches[i].parent_index;
+        if (parent >= 0 && branch_moved[parent]) {
+            branch_moved[i] = 1;
+        }
+    };
+    if (update_pool) {
+        forEachLevel(propagate);
+    } else {
+        for (int i = 0; i < branch_count; i++) {
+            propagate(i);
+        }
+    }
+    
+    // === REWRITE ONLY THE SLOTS OF MOVED, VISIBLE BRANCHES ===
+    // Every branch owns its slot, so chunks write disjoint vertices and
+    // flags; each keeps its own dirty list and vertex count, merged after
+    const bool instanced = !branch_instances.empty();
+    prepareUpdateChunks(branch_count);
+    runUpdateChunks(branch_count, [this, instanced](int chunk, int begin, int end) {
+        std::vector<int>& dirty = update_chunk_dirty[chunk];
+        int emitted = 0;
+        for (int i = begin; i < end; i++) {
+            // Only render branches that have started growing
+            if (!branch_moved[i] || branchProgress(i) <= 0.0f) continue;
+            
+            // === CALCULATE CURRENT BRANCH ENDPOINTS ===
+            // Get animated positions that change as branch grows
+            glm::vec3 start = absolute_start[i];
+            glm::vec3 end = absolute_end[i];
+            
+            int slot = branch_slot[i];
+            
+            // Instanced: only the record changes, the vertex shader builds the cylinder
+            if (instanced) {
+                BranchInstance& instance = branch_instances[slot];
+                instance.start = start;
+                instance.radius = branches[i].radius;
+                instance.end = end;
+                instance.growth = branchProgress(i);
+                markSlotDirty(slot, branch_slot_dirty, dirty);
+                continue;
+            }
+            
+            // === GENERATE CYLINDRICAL GEOMETRY ===
+            // Write this branch's cylinder straight into its fixed slot - the
+            // slot size is known up front
+            addBranchSegment(&branch_vertices[branch_vertex_offset[slot] * VERTEX_FLOATS], i, start, end);
+            markSlotDirty(slot, branch_slot_dirty, dirty);
+            emitted += branchSlotVertices(i);
+        }
+        update_chunk_emitted[chunk] = emitted;
+    });
+    mergeUpdateChunks(branch_dirty_slots);
+}
+
+void Tree::updateLeafMesh() {
+    PROFILE_SCOPE("Tree::updateLeafMesh");
+    mesh_version = nextVersion();
+    // A leaf moves when it grew this frame or its parent branch moved
+    leaf_moved.assign(leaves.size(), 0);
+    for (int i : leaf_activity.changed) {
+        leaf_moved[i] = 1;
+    }
+    
+    const bool use_soa = (storage_mode == TreeStorageMode::StructureOfArrays);
+    const bool instanced = !leaf_instances.empty();
+    
+    // === GENERATE GEOMETRY FOR EACH CHANGED, VISIBLE LEAF ===
+    // Chunked by leaf range: the parent's offset is found once per range and
+    // applied to its block of leaves, per-chunk dirty lists as for branches
+    const int range_count = leaf_ranges.size();
+    prepareUpdateChunks(range_count);
+    runUpdateChunks(range_count, [this, use_soa, instanced](int chunk, int begin, int end) {
+        std::vector<int>& dirty = update_chunk_dirty[chunk];
+        int emitted = 0;
+        // Quads are framed LEAF_LANES at a time, written as each batch fills
+        LeafQuadBatch batch;
+        for (int r = begin; r < end; r++) {
+            const TreeLeafRange& range = leaf_ranges[r];
+            const int p = range.branch;
+            if (p < 0 || p >= static_cast<int>(branches.size())) continue;
+            
+            // === PARENT TRANSFORM, ONCE PER RANGE ===
+            // Leaves maintain their relative offset from their parent branch end
+            // This way they move naturally as the parent branch grows
+            const bool parent_moved = branch_moved[p] != 0;
+            glm::vec3 parent_end = use_soa ? soa.branch_end[p] : branches[p].end;
+            glm::vec3 shift = absolute_end[p] - parent_end;
+            
+            for (int i = range.first_leaf; i < range.first_leaf + range.leaf_count; i++) {
+                // SoA streams only the leaf field arrays; AoS reads the TreeLeaf records
+                float growth = use_soa ? soa.leaf_progress[i] : leaves[i].growth_progress;
+                
+                // Only process leaves that have started growing and moved
+                if (growth <= 0.0f || (!leaf_moved[i] && !parent_moved)) continue;
+                glm::vec3 position = use_soa ? soa.leaf_position[i] : leaves[i].position;
+                glm::vec3 pos = position + shift;
+                
+                // === CALCULATE ANIMATED LEAF SIZE ===
+                // Scale leaf size by growth progress for budding animation
+                float size = use_soa ? soa.leaf_size[i] : leaves[i].size;
+                float dynamic_size = size * growth;
+                
+                // === GENERATE LEAF QUAD GEOMETRY ===
+                // Create a billboard quad that faces a specific direction, in its slot
+                const glm::vec3& normal = use_soa ? soa.leaf_normal[i] : leaves[i].normal;
+                int slot = leaf_slot[i];
+                
+                // Instanced: only the record changes, the vertex shader builds the quad
+                if (instanced) {
+                    LeafInstance& instance = leaf_instances[slot];
+                    instance.position = pos;
+                    instance.normal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+                    instance.size = size;
+                    instance.growth = growth;
+                    markSlotDirty(slot, leaf_slot_dirty, dirty);
+                    continue;
+                }
+                batch.add(&leaf_vertices[slot * leaf_slot_vertices * VERTEX_FLOATS], pos, normal, dynamic_size, growth,
+                          getLeafOcclusion(i));
+                if (batch.full()) batch.flush(leaf_faces);
+                markSlotDirty(slot, leaf_slot_dirty, dirty);
+                emitted += leaf_slot_vertices;
+            }
+        }
+        batch.flush(leaf_faces);
+        update_chunk_emitted[chunk] = emitted;
+    });
+    mergeUpdateChunks(leaf_dirty_slots);
+}
+
+void Tree::buildStaticMesh() {
+    PROFILE_SCOPE("Tree::buildStaticMesh");
+    mesh_version = nextVersion();
+    // === PER-BRANCH GROWTH DATA (BUFFER TEXTURE) ===
+    // The vertex shader rebuilds every animated endpoint from this table by
+    // summing direction * progress up the parent chain
+    // Every element writes only its own texels and slot, whose offsets are
+    // fixed by assignMeshSlots, so each pass runs in chunks on the update pool
+    branch_growth_data.resize(branches.size() * GPU_BRANCH_TEXELS * 4);
+    auto growth_data = [this](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const TreeBranch& branch = branches[i];
+            glm::vec3 direction = branch.end - branch.start;
+            float* texel = &branch_growth_data[i * GPU_BRANCH_TEXELS * 4];
+            texel[0] = direction.x; texel[1] = direction.y; texel[2] = direction.z; texel[3] = branch.start_time;
+            texel[4] = branch.start.x; texel[5] = branch.start.y; texel[6] = branch.start.z; texel[7] = branch.growth_duration;
+            texel[8] = (float)branch.parent_index; texel[9] = (float)branch.generation; texel[10] = branch.radius; texel[11] = 0.0f;
+        }
+    };
+    runUpdateChunks(branches.size(), std::cref(growth_data));
+    
+    // Fully grown mesh in slot order, so the started elements are a prefix
+    // exactly as in the CPU path (freed slots stay zero, i.e. degenerate)
+    static_branch_vertices.assign(branch_vertex_offset.back() * GPU_VERTEX_FLOATS, 0.0f);
+    static_leaf_vertices.assign(leaf_slot_count * leaf_slot_vertices * GPU_VERTEX_FLOATS, 0.0f);
+    
+    // One slot's worth of CPU-layout vertices per chunk, converted below
+    static const int BRANCH_SCRATCH_VERTICES = (MAX_CURVE_SECTIONS + 1) * (MAX_RING_SEGMENTS + 1);
+    static const int SCRATCH_VERTICES = (BRANCH_SCRATCH_VERTICES > LEAF_SLOT_VERTICES)
+                                        ? BRANCH_SCRATCH_VERTICES : LEAF_SLOT_VERTICES;
+    
+    // === BRANCHES: RING OFFSETS RELATIVE TO THE ANIMATED AXIS ===
+    // Growth only scales a branch along its axis, so the ring offsets (and
+    // normals) of the fully grown cylinder are valid at every progress. A
+    // ring sits a share of the way along the chord; a curved branch's sag
+    // there goes in cornerDir, which the shader scales with the growth
+    auto branch_slots = [this](int, int begin, int end) {
+        float scratch[SCRATCH_VERTICES * VERTEX_FLOATS];
+        for (int i = begin; i < end; i++) {
+            const TreeBranch& branch = branches[i];
+            addBranchSegment(scratch, i, branch.start, branch.end);
+            
+            float* out = &static_branch_vertices[branch_vertex_offset[branch_slot[i]] * GPU_VERTEX_FLOATS];
+            const int vertex_count = branchSlotVertices(i);
+            const int ring_vertices = branchRingVertices(i);
+            const int first_ring = branch_welded[i] ? 1 : 0;
+            const int sections = branch_sections[i];
+            for (int v = 0; v < vertex_count; v++) {
+                const float* in = &scratch[v * VERTEX_FLOATS];
+                // addBranchSegment writes the rings from the start (unless welded) to the end
+                float anchor = (float)(first_ring + v / ring_vertices) / sections;
+                glm::vec3 center = glm::mix(branch.start, branch.end, anchor);
+                glm::vec3 sag = branch_sag[i] * (4.0f * anchor * (1.0f - anchor));
+                
+                out[0] = in[0] - center.x - sag.x; out[1] = in[1] - center.y - sag.y;
+                out[2] = in[2] - center.z - sag.z; out[3] = in[3]; // w: occlusion
+                out[4] = in[4]; out[5] = in[5];                    // texcoord
+                out[6] = in[6]; out[7] = in[7]; out[8] = in[8];    // normal
+                out[9] = (float)i; out[10] = anchor;               // growthRef: branch, share along it
+                out[11] = 0.0f; out[12] = 0.0f;
+                out[13] = sag.x; out[14] = sag.y; out[15] = sag.z; // cornerDir: sag at full growth
+                out += GPU_VERTEX_FLOATS;
+            }
+        }
+    };
+    runUpdateChunks(branches.size(), std::cref(branch_slots));
+    
+    // === LEAVES: OFFSET FROM PARENT END PLUS A UNIT CORNER DIRECTION ===
+    auto leaf_slots = [this](int, int begin, int end) {
+        float scratch[SCRATCH_VERTICES * VERTEX_FLOATS];
+        for (int i = begin; i < end; i++) {
+            const TreeLeaf& leaf = leaves[i];
+            const TreeBranch& parent = branches[leaf.parent_branch_index];
+            glm::vec3 offset = leaf.position - parent.end;
+            
+            // Full-growth quad; dividing by the final size gives unit corner directions
+            addLeafQuad(scratch, leaf.position, leaf.normal, leaf.size, 1.0f, getLeafOcclusion(i));
+            
+            float* out = &static_leaf_vertices[leaf_slot[i] * leaf_slot_vertices * GPU_VERTEX_FLOATS];
+            for (int v = 0; v < leaf_slot_vertices; v++) {
+                const float* in = &scratch[v * VERTEX_FLOATS];
+                glm::vec3 corner = (glm::vec3(in[0], in[1], in[2]) - leaf.position) / leaf.size;
+                
+                out[0] = offset.x; out[1] = offset.y; out[2] = offset.z; out[3] = in[3]; // w: occlusion
+                out[4] = in[4]; out[5] = in[5];
+                out[6] = in[6]; out[7] = in[7]; out[8] = in[8];
+                out[9] = (float)leaf.parent_branch_index;          // growthRef: parent, schedule, size
+                out[10] = leaf.start_time; out[11] = leaf.growth_duration; out[12] = leaf.size;
+                out[13] = corner.x; out[14] = corner.y; out[15] = corner.z;
+                out += GPU_VERTEX_FLOATS;
+            }
+        }
+    };
+    runUpdateChunks(leaves.size(), std::cref(leaf_slots));
+}
+
+// Sort the dirty slots, merge runs of adjacent slots into byte ranges and
+// reset the dirty marks; slot_offset(k) is the first byte of slot k
+template <typename SlotOffset>
+static void collectDirtyRanges(std::vector<int>& slots, std::vector<unsigned char>& flags,
+                               SlotOffset slot_offset, std::vector<MeshDirtyRange>& out) {
+    out.clear();
+    std::sort(slots.begin(), slots.end());
+    for (size_t k = 0; k < slots.size(); ) {
+        size_t run_end = k + 1;
+        while (run_end < slots.size() && slots[run_end] == slots[run_end - 1] + 1) {
+            run_end++;
+        }
+        MeshDirtyRange range;
+        range.offset = slot_offset(slots[k]);
+        range.size = slot_offset(slots[run_end - 1] + 1) - range.offset;
+        out.push_back(range);
+        k = run_end;
+    }
+    for (int slot : slots) {
+        flags[slot] = 0;
+    }
+    slots.clear();
+}
+
+void Tree::takeBranchDirtyRanges(std::vector<MeshDirtyRange>& out) {
+    if (!branch_instances.empty()) {
+        collectDirtyRanges(branch_dirty_slots, branch_slot_dirty, [](int slot) {
+            return slot * sizeof(BranchInstance);
+        }, out);
+        return;
+    }
+    const std::vector<int>& offsets = branch_vertex_offset;
+    collectDirtyRanges(branch_dirty_slots, branch_slot_dirty, [&offsets](int slot) {
+        return offsets[slot] * VERTEX_FLOATS * sizeof(float);
+    }, out);
+}
+
+void Tree::takeLeafDirtyRanges(std::vector<MeshDirtyRange>& out) {
+    const size_t slot_bytes = leaf_instances.empty() ? leaf_slot_vertices * VERTEX_FLOATS * sizeof(float)
+                                                     : sizeof(LeafInstance);
+    collectDirtyRanges(leaf_dirty_slots, leaf_slot_dirty, [slot_bytes](int slot) {
+        return slot * slot_bytes;
+    }, out);
+}
+
+// Every ring with the same side count has the same angles, so the
+// transcendental calls happen once per supported count
+struct RingTables {
+    glm::vec2 points[Tree::MAX_RING_SEGMENTS + 1][Tree::MAX_RING_SEGMENTS + 1];
+    RingCircleLanes lanes[Tree::MAX_RING_SEGMENTS + 1];
+    RingTables() {
+        for (int s = Tree::MIN_RING_SEGMENTS; s <= Tree::MAX_RING_SEGMENTS; s++) {
+            for (int i = 0; i <= s; i++) {
+                float angle = (float)i / s * 2.0f * (float)M_PI;
+                points[s][i] = glm::vec2(cosf(angle), sinf(angle));
+                lanes[s].cosine[i] = points[s][i].x;
+                lanes[s].sine[i] = points[s][i].y;
+            }
+        }
+    }
+};
+
+static_assert(Tree::MAX_RING_SEGMENTS + 1 == RING_LANE_CAPACITY, "Ring lanes hold the largest ring");
+
+static const RingTables& ringTables() {
+    static const RingTables tables;
+    return tables;
+}
+
+const glm::vec2* Tree::ringUnitCircle(int segments) {
+    return ringTables().points[segments];
+}
+
+const RingCircleLanes& Tree::ringUnitCircleLanes(int segments) {
+    return ringTables().lanes[segments];
+}
+
+float* Tree::addBranchSegment(float* out, int branch_index, glm::vec3 start, glm::vec3 end) {
+    // === GEOMETRIC SETUP ===
+    const int segments = branch_segments[branch_index];  // Number of sides around cylinder circumference
+    const TreeBranch& branch = branches[branch_index];
+    
+    BranchRingFrame frame;
+    frame.start = start;
+    frame.end = end;
+    // Branches taper from thicker at base to thinner at tip
+    frame.start_radius = branch.radius;           // Full radius at base
+    frame.end_radius = branch.radius * 0.7f;      // 70% radius at tip
+    
+    // === COORDINATE SYSTEM ===
+    // Precomputed by buildBranchFrames; perpendicular to the branch axis
+    frame.right = branch_right[branch_index];
+    frame.up = branch_up[branch_index];
+    frame.base_v = branch_tex_v[branch_index];
+    // A welded branch skips its start ring - the parent's end ring takes its place
+    frame.first_ring = branch_welded[branch_index] ? 1 : 0;
+    
+    // === CURVED TUBE ===
+    // The sag shrinks with the growing chord, so the bend keeps its shape
+    const int sections = branch_sections[branch_index];
+    float* written;
+    if (sections > 1) {
+        float grown = glm::length(branch.end - branch.start);
+        float scale = grown > 0.0f ? glm::length(end - start) / grown : 0.0f;
+        written = writeCurvedRings(out, frame, segments, sections, branch_sag[branch_index] * scale);
+    } else {
+        // === CYLINDER MESH GENERATION ===
+        // Unrolled builder for this ring size, else the runtime loop
+        const BranchBuilderEntry* builder = branchBuilder(segments);
+        written = builder ? builder->rings(out, frame) : writeRings(out, frame, segments);
+    }
+    
+    // === BAKED OCCLUSION ===
+    // Each ring's from its share of the way along
+    if (!branch_occlusion.empty()) {
+        const int ring_floats = (segments + 1) * VERTEX_FLOATS;
+        for (int ring = frame.first_ring; ring <= sections; ring++) {
+            float occlusion = getBranchOcclusion(branch_index, (float)ring / sections);
+            float* ring_start = out + (ring - frame.first_ring) * ring_floats;
+            stampOcclusion(ring_start, ring_start + ring_floats, occlusion);
+        }
+    }
+    return written;
+}
+
+float* Tree::addLeafQuad(float* out, glm::vec3 position, glm::vec3 normal, float size, float growth,
+                         float occlusion) {
+    LeafQuadBatch batch;
+    batch.add(out, position, normal, size, growth, occlusion);
+    return batch.flush(leaf_faces);
+}
+
+// === BAKED OCCLUSION ===
+
+void Tree::bakeOcclusion() {
+    branch_occlusion.clear();
+    leaf_occlusion.clear();
+    if (occlusion_baker) occlusion_baker(*this, branch_occlusion, leaf_occlusion);
+}
+
+// === TWIG INSTANCING ===
+
+void Tree::setTwigInstancing(int depth, int prototype_count) {
+    twig_depth = std::max(0, depth);
+    twig_prototype_count = std::max(1, prototype_count);
+}
+
+int Tree::twigStopGeneration() const {
+    // The trunk is never a twig, and a depth past the last generation leaves
+    // nothing to instance
+    return (twig_depth > 0 && twig_depth <= max_generations) ? twig_depth : INT_MAX;
+}
+
+// Fully grown mesh of one prototype, appended to the library's arrays: 8-sided
+// cylinders tapering to 70% like branch instances, then single-sided leaf
+// quads spanned like addLeafQuad's
+static void buildTwigMesh(TwigPrototype& prototype, std::vector<float>& vertices, std::vector<uint32_t>& indices) {
+    const int segments = Tree::BRANCH_RING_VERTICES - 1;
+    const glm::vec2* circle = Tree::ringUnitCircle(segments);
+    
+    prototype.first_wood_index = indices.size();
+    for (const TreeBranch& branch : prototype.branches) {
+        glm::vec3 direction = glm::normalize(branch.end - branch.start);
+        glm::vec3 up = (std::abs(direction.y) > 0.9f) ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+        glm::vec3 right = glm::normalize(glm::cross(direction, up));
+        up = glm::normalize(glm::cross(right, direction));
+        
+        uint32_t start_ring = vertices.size() / Tree::VERTEX_FLOATS;
+        uint32_t end_ring = start_ring + Tree::BRANCH_RING_VERTICES;
+        vertices.resize(vertices.size() + Tree::BRANCH_SLOT_VERTICES * Tree::VERTEX_FLOATS);
+        float* out = &vertices[start_ring * Tree::VERTEX_FLOATS];
+        for (int ring = 0; ring < 2; ring++) {
+            glm::vec3 center = (ring == 0) ? branch.start : branch.end;
+            float radius = (ring == 0) ? branch.radius : branch.radius * 0.7f;
+            for (int i = 0; i <= segments; i++) {
+                glm::vec3 radial = right * circle[i].x + up * circle[i].y;
+                out = writeVertex(out, center + radial * radius, (float)i / segments, (float)ring, radial);
+            }
+        }
+        // Same triangles as buildBranchIndices
+        size_t first_index = indices.size();
+        indices.resize(first_index + Tree::BRANCH_SLOT_INDICES);
+        BranchMeshBuilder<segments>::indices(&indices[first_index], start_ring, end_ring);
+    }
+    prototype.wood_index_count = indices.size() - prototype.first_wood_index;
+    
+    prototype.first_leaf_index = indices.size();
+    for (const TreeLeaf& leaf : prototype.leaves) {
+        glm::vec3 right = glm::normalize(glm::cross(leaf.normal, glm::vec3(0, 1, 0)));
+        if (glm::length(right) < 0.01f) right = glm::vec3(1, 0, 0);
+        glm::vec3 up = glm::normalize(glm::cross(right, leaf.normal));
+        right *= leaf.size * 0.5f;
+        up *= leaf.size * 0.5f;
+        
+        uint32_t base = vertices.size() / Tree::VERTEX_FLOATS;
+        vertices.resize(vertices.size() + Tree::LEAF_SINGLE_SLOT_VERTICES * Tree::VERTEX_FLOATS);
+        float* out = &vertices[base * Tree::VERTEX_FLOATS];
+        out = writeVertex(out, leaf.position - right - up, 0.0f, 0.0f, leaf.normal);
+        out = writeVertex(out, leaf.position + right - up, 1.0f, 0.0f, leaf.normal);
+        out = writeVertex(out, leaf.position + right + up, 1.0f, 1.0f, leaf.normal);
+        out = writeVertex(out, leaf.position - right + up, 0.0f, 1.0f, leaf.normal);
+        indices.insert(indices.end(), {base, base + 2, base + 1, base, base + 3, base + 2});
+    }
+    prototype.leaf_index_count = indices.size() - prototype.first_leaf_index;
+}
+
+void Tree::buildTwigLibrary() {
+    // === REUSE ===
+    // The library only depends on the settings, so regenerating a tree (or
+    // the next tree of a forest) keeps the prototypes it already has
+    if (twig_library) {
+        const TwigLibrary& library = *twig_library;
+        if (library.depth == twig_depth && static_cast<int>(library.prototypes.size()) == twig_prototype_count &&
+            library.layout == branch_layout && library.parameters.max_generations == max_generations &&
+            library.parameters.branch_angle_variance == branch_angle_variance &&
+            library.parameters.length_reduction_factor == length_reduction_factor &&
+            library.parameters.radius_reduction_factor == radius_reduction_factor &&
+            library.parameters.max_growth_time == max_growth_time) {
+            return;
+        }
+    }
+    
+    std::shared_ptr<TwigLibrary> library(new TwigLibrary);
+    library->parameters = getParameters();
+    library->layout = branch_layout;
+    library->depth = twig_depth;
+    library->prototypes.resize(twig_prototype_count);
+    
+    // === PROTOTYPE ROOT ===
+    // Every branch of one generation has the same length and radius, so the
+    // root only needs the trunk scaled down twig_depth times
+    BranchWorkItem root;
+    root.parent_index = -1;
+    root.start = glm::vec3(0.0f);
+    float elevation = TWIG_ELEVATION * (float)M_PI / 180.0f;
+    root.direction = glm::vec3(0.0f, sinf(elevation), cosf(elevation));
+    root.length = TRUNK_LENGTH;
+    root.radius = TRUNK_RADIUS;
+    for (int g = 0; g < twig_depth; g++) {
+        root.length *= length_reduction_factor;
+        root.radius *= radius_reduction_factor;
+    }
+    root.generation = twig_depth;
+    root.path = 0;
+    root.capsule = -1;
+    
+    // === PROTOTYPES: ONE FIXED STREAM EACH ===
+    for (int k = 0; k < twig_prototype_count; k++) {
+        TwigPrototype& prototype = library->prototypes[k];
+        std::mt19937_64 stream(mixSeed(TWIG_LIBRARY_SEED + k));
+        GenerationOutput out;
+        out.rng = &stream;
+        generateBranches(root, out, INT_MAX);
+        prototype.branches.swap(out.branches);
+        prototype.leaves.swap(out.leaves);
+        prototype.growth_span = scheduleGrowth(prototype.branches, prototype.leaves, max_growth_time, twig_depth);
+        buildTwigMesh(prototype, library->vertices, library->indices);
+    }
+    
+    // === VERTEX CACHE ===
+    // Prototypes are drawn whole, so each range's triangles can go in any
+    // order; the vertices then follow the reordered indices, each
+    // prototype's staying together
+    for (TwigPrototype& prototype : library->prototypes) {
+        uint32_t* wood = library->indices.data() + prototype.first_wood_index;
+        uint32_t* leaves = library->indices.data() + prototype.first_leaf_index;
+        library->generated_cache.add(analyzeVertexCache(wood, prototype.wood_index_count));
+        library->generated_cache.add(analyzeVertexCache(leaves, prototype.leaf_index_count));
+        optimizeVertexCache(wood, prototype.wood_index_count);
+        optimizeVertexCache(leaves, prototype.leaf_index_count);
+        library->optimized_cache.add(analyzeVertexCache(wood, prototype.wood_index_count));
+        library->optimized_cache.add(analyzeVertexCache(leaves, prototype.leaf_index_count));
+    }
+    optimizeVertexFetch(library->vertices, VERTEX_FLOATS, library->indices);
+    twig_library = library;
+}
+
+void Tree::placeTwigs(const std::vector<BranchWorkItem>& twig_roots) {
+    if (twig_roots.empty()) return;
+    buildTwigLibrary();
+    for (const BranchWorkItem& root : twig_roots) {
+        twig_instances.push_back(makeTwig(root));
+    }
+    groupTwigs();
+}
+
+TwigInstance Tree::makeTwig(const BranchWorkItem& root) const {
+    // === PROTOTYPE CHOICE ===
+    // Picked by the root's path hash, so it is fixed by the seed
+    const int prototype_count = twig_library->prototypes.size();
+    int k = mixSeed(root.path) % prototype_count;
+    
+    // === PLACEMENT ===
+    // Branch directions are drawn relative to world up, so the prototype is
+    // tilted about its own X axis to the root's elevation and then turned
+    // about Y to its azimuth; its children keep pointing upward
+    const float prototype_elevation = TWIG_ELEVATION * (float)M_PI / 180.0f;
+    float azimuth = atan2f(root.direction.x, root.direction.z);
+    float tilt = asinf(std::max(-1.0f, std::min(1.0f, root.direction.y))) - prototype_elevation;
+    float ct = cosf(tilt), st = sinf(tilt);
+    float ca = cosf(azimuth), sa = sinf(azimuth);
+    // Y rotation of the X-rotated basis (1,0,0), (0,ct,-st), (0,st,ct)
+    TwigInstance twig;
+    twig.axis_x = glm::vec3(ca, 0.0f, -sa);
+    twig.axis_y = glm::vec3(-st * sa, ct, -st * ca);
+    twig.axis_z = glm::vec3(ct * sa, st, ct * ca);
+    twig.origin = root.start;
+    twig.prototype = k;
+    twig.parent_branch_index = root.parent_index;
+    twig.start_time = 0.0f;      // Filled in by buildGrowthSchedule()
+    twig.growth_duration = 1.0f;
+    return twig;
+}
+
+void Tree::groupTwigs() {
+    // Stable counting sort by prototype, so each prototype is one instanced draw
+    const int prototype_count = twig_library ? twig_library->prototypes.size() : 0;
+    twig_offsets.assign(prototype_count + 1, 0);
+    for (const TwigInstance& twig : twig_instances) {
+        twig_offsets[twig.prototype + 1]++;
+    }
+    for (int k = 0; k < prototype_count; k++) {
+        twig_offsets[k + 1] += twig_offsets[k];
+    }
+    std::vector<int> next(twig_offsets.begin(), twig_offsets.end() - 1);
+    std::vector<TwigInstance> grouped(twig_instances.size());
+    for (const TwigInstance& twig : twig_instances) {
+        grouped[next[twig.prototype]++] = twig;
+    }
+    twig_instances.swap(grouped);
+}
+
+void Tree::scheduleTwig(TwigInstance& twig) const {
+    // A twig waits for its parent to finish, when every branch on its path
+    // has stopped moving and the attachment point is final, and then grows
+    // as a whole over its prototype's span
+    const float generation_delay = max_growth_time * 0.15f;
+    const TreeBranch& parent = branches[twig.parent_branch_index];
+    twig.start_time = std::max(twig_depth * generation_delay, parent.start_time + parent.growth_duration);
+    twig.growth_duration = twig_library->prototypes[twig.prototype].growth_span;
+}
+
+// === SUBTREE REGENERATION ===
+
+// Carry an active set across a regeneration: surviving elements are renamed
+// through old_to_new (-1 = removed) and keep their state, added elements are
+// merged into the pending range by start time. An added element that should
+// already have started then sits at the front of the pending range, where
+// the next update starts it
+template <typename StartFn>
+static void spliceActiveSet(GrowthActiveSet& set, const std::vector<int>& old_to_new,
+                            std::vector<int>& added, StartFn start_time) {
+    std::vector<int> order;
+    order.reserve(set.order.size() + added.size());
+    std::vector<int> pending;
+    for (size_t k = 0; k < set.order.size(); k++) {
+        int i = old_to_new[set.order[k]];
+        if (i < 0) continue;
+        if (k < set.next_pending) {
+            order.push_back(i);
+        } else {
+            pending.push_back(i);
+        }
+    }
+    size_t started = order.size();
+    
+    auto earlier = [&](int a, int b) { return start_time(a) < start_time(b); };
+    std::stable_sort(added.begin(), added.end(), earlier);
+    std::merge(pending.begin(), pending.end(), added.begin(), added.end(), std::back_inserter(order), earlier);
+    set.order.swap(order);
+    set.next_pending = started;
+    
+    size_t kept = 0;
+    for (int i : set.growing) {
+        if (old_to_new[i] >= 0) set.growing[kept++] = old_to_new[i];
+    }
+    set.growing.resize(kept);
+    set.dropLanes();
+    set.changed.clear();
+    set.done = started - kept;
+}
+
+int Tree::allocateBranchSlot(int segments) {
+    // === REUSE A FREED SLOT OF EXACTLY THIS SIZE ===
+    // No other slot's vertices or indices move, so only this slot is rewritten
+    const int vertex_count = 2 * (segments + 1);
+    const int index_count = 6 * segments;
+    for (size_t k = free_branch_slots.size(); k-- > 0; ) {
+        int slot = free_branch_slots[k];
+        if (branch_vertex_offset[slot + 1] - branch_vertex_offset[slot] == vertex_count &&
+            branch_index_offset[slot + 1] - branch_index_offset[slot] == index_count) {
+            free_branch_slots[k] = free_branch_slots.back();
+            free_branch_slots.pop_back();
+            return slot;
+        }
+    }
+    
+    // === OR APPEND ONE TO EVERY SLOT-INDEXED ARRAY ===
+    int slot = branch_index_offset.size() - 1;
+    branch_vertex_offset.push_back(branch_vertex_offset.back() + vertex_count);
+    branch_index_offset.push_back(branch_index_offset.back() + index_count);
+    branch_indices.resize(branch_index_offset.back());
+    if (mesh_animation == MeshAnimation::Cpu) {
+        if (branch_rendering == BranchRendering::Instanced) {
+            BranchInstance unstarted = {glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 0.0f};
+            branch_instances.push_back(unstarted);
+        } else {
+            branch_vertices.resize(branch_vertex_offset.back() * VERTEX_FLOATS, 0.0f);
+        }
+    }
+    branch_slot_dirty.push_back(0);
+    return slot;
+}
+
+int Tree::allocateLeafSlot() {
+    // Leaf slots all have one size
+    if (!free_leaf_slots.empty()) {
+        int slot = free_leaf_slots.back();
+        free_leaf_slots.pop_back();
+        return slot;
+    }
+    int slot = leaf_slot_count++;
+    if (mesh_animation == MeshAnimation::Cpu) {
+        if (leaf_rendering == LeafRendering::Instanced) {
+            LeafInstance unstarted = {glm::vec3(0.0f), 0u, 0.0f, 0.0f};
+            leaf_instances.push_back(unstarted);
+        } else {
+            leaf_vertices.resize(leaf_slot_count * leaf_slot_vertices * VERTEX_FLOATS, 0.0f);
+        }
+    }
+    if (leaf_faces == LeafFaces::SingleSided) {
+        uint32_t base = slot * LEAF_SINGLE_SLOT_VERTICES;
+        leaf_indices.insert(leaf_indices.end(), {base, base + 2, base + 1, base, base + 3, base + 2});
+    }
+    leaf_slot_dirty.push_back(0);
+    return slot;
+}
+
+void Tree::blankBranchSlot(int slot) {
+    // A freed slot draws nothing until it is reused: its triangles collapse
+    // onto its own first vertex (a welded slot's started on the parent's
+    // ring) and its vertices or instance are zeroed
+    std::fill(branch_indices.begin() + branch_index_offset[slot], branch_indices.begin() + branch_index_offset[slot + 1],
+              (uint32_t)branch_vertex_offset[slot]);
+    if (!branch_vertices.empty()) {
+        std::fill(branch_vertices.begin() + branch_vertex_offset[slot] * VERTEX_FLOATS,
+                  branch_vertices.begin() + branch_vertex_offset[slot + 1] * VERTEX_FLOATS, 0.0f);
+    }
+    if (!branch_instances.empty()) {
+        BranchInstance unstarted = {glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 0.0f};
+        branch_instances[slot] = unstarted;
+    }
+    markSlotDirty(slot, branch_slot_dirty, branch_dirty_slots);
+    free_branch_slots.push_back(slot);
+    layout_version = nextVersion();
+    mesh_version = nextVersion();
+}
+
+void Tree::blankLeafSlot(int slot) {
+    if (!leaf_vertices.empty()) {
+        size_t slot_floats = leaf_slot_vertices * VERTEX_FLOATS;
+        std::fill(leaf_vertices.begin() + slot * slot_floats, leaf_vertices.begin() + (slot + 1) * slot_floats, 0.0f);
+    }
+    if (!leaf_instances.empty()) {
+        LeafInstance unstarted = {glm::vec3(0.0f), 0u, 0.0f, 0.0f};
+        leaf_instances[slot] = unstarted;
+    }
+    markSlotDirty(slot, leaf_slot_dirty, leaf_dirty_slots);
+    free_leaf_slots.push_back(slot);
+    mesh_version = nextVersion();
+}
+
+bool Tree::regenerateSubtree(int branch_index, uint64_t subtree_seed, float from_time) {
+    const int old_branch_count = branches.size();
+    const int old_leaf_count = leaves.size();
+    if (branch_index < 0 || branch_index >= old_branch_count ||
+        branch_activity.order.size() != branches.size() || branch_slot.size() != branches.size()) {
+        return false;
+    }
+    
+    /*
+     * STEP 1: GROW THE REPLACEMENT
+     * The built-in rules expand a copy of the branch on their own stream, so
+     * the same seed always gives the same subtree. Local branch 0 is the copy
+     * and maps back onto the kept branch
+     */
+    const TreeBranch root = branches[branch_index];
+    BranchWorkItem item;
+    item.parent_index = -1;
+    item.start = root.start;
+    item.direction = glm::normalize(root.end - root.start);
+    item.length = glm::length(root.end - root.start);
+    item.radius = root.radius;
+    item.generation = root.generation;
+    item.path = subtree_seed;
+    item.capsule = -1;
+    std::mt19937_64 stream(mixSeed(subtree_seed));
+    GenerationOutput out;
+    out.rng = &stream;
+    generateBranches(item, out, twigStopGeneration());
+    if (out.branches.empty()) {
+        return false; // The branch is itself past the twig depth
+    }
+    
+    // Schedule as if the branch started at base, but never before now: its
+    // first children start once it is 60% grown or immediately
+    if (from_time < 0.0f) from_time = current_growth_time;
+    float subtree_end = scheduleGrowth(out.branches, out.leaves, max_growth_time, root.generation);
+    const float growth_duration = max_growth_time * 0.4f;
+    const float base = std::max(root.start_time, from_time - 0.6f * growth_duration);
+    for (TreeBranch& branch : out.branches) branch.start_time += base;
+    for (TreeLeaf& leaf : out.leaves) leaf.start_time += base;
+    schedule_end_time = std::max(schedule_end_time, base + subtree_end);
+    
+    // SoA keeps the live progress; the records are rebuilt from the structs
+    const bool use_soa = (storage_mode == TreeStorageMode::StructureOfArrays);
+    if (use_soa) {
+        for (int i = 0; i < old_branch_count; i++) branches[i].growth_progress = soa.branch_progress[i];
+        for (int i = 0; i < old_leaf_count; i++) leaves[i].growth_progress = soa.leaf_progress[i];
+    }
+    
+    /*
+     * STEP 2: REMOVE THE OLD DESCENDANTS AND THEIR SLOTS
+     * Parents precede children, so one forward pass finds every descendant;
+     * the branch's own leaves and twigs are replaced too
+     */
+    std::vector<unsigned char> removed(old_branch_count, 0);
+    std::vector<int> leaf_old_to_new;
+    std::vector<TreeLeaf> new_leaves;
+    std::vector<int> new_leaf_slot;
+    new_leaves.reserve(old_leaf_count + out.leaves.size());
+    blankSubtree(branch_index, removed, leaf_old_to_new, new_leaves, new_leaf_slot);
+    
+    /*
+     * STEP 3: SPLICE THE NEW BRANCHES INTO THE LAYOUT
+     * Depth-first, the subtree takes its old place right after the branch;
+     * breadth-first, it is merged generation by generation, old ones first.
+     * Both keep parents before children
+     */
+    std::vector<int> source; // Per new index: old index, or -1 - local index
+    source.reserve(old_branch_count + out.branches.size());
+    const int local_count = out.branches.size();
+    if (branch_layout == BranchLayout::BreadthFirst) {
+        int local = 1;
+        for (int i = 0; i < old_branch_count; i++) {
+            if (removed[i]) continue;
+            while (local < local_count && out.branches[local].generation < branches[i].generation) {
+                source.push_back(-1 - local++);
+            }
+            source.push_back(i);
+        }
+        while (local < local_count) source.push_back(-1 - local++);
+    } else {
+        for (int i = 0; i < old_branch_count; i++) {
+            if (removed[i]) continue;
+            source.push_back(i);
+            if (i == branch_index) {
+                for (int local = 1; local < local_count; local++) source.push_back(-1 - local);
+            }
+        }
+    }
+    
+    std::vector<int> old_to_new(old_branch_count, -1);
+    std::vector<int> local_to_new(local_count, -1);
+    for (size_t n = 0; n < source.size(); n++) {
+        if (source[n] >= 0) {
+            old_to_new[source[n]] = n;
+        } else {
+            local_to_new[-1 - source[n]] = n;
+        }
+    }
+    local_to_new[0] = old_to_new[branch_index];
+    for (TreeLeaf& leaf : new_leaves) {
+        leaf.parent_branch_index = old_to_new[leaf.parent_branch_index];
+    }
+    
+    // === RENAME EVERY PER-BRANCH ARRAY ===
+    std::vector<TreeBranch> new_branches(source.size());
+    std::vector<glm::vec3> new_right(source.size()), new_up(source.size());
+    std::vector<float> new_tex_v(source.size());
+    std::vector<unsigned char> new_welded(source.size(), 0), new_segments(source.size(), 0);
+    std::vector<unsigned char> new_sections(source.size(), 1);
+    std::vector<glm::vec3> new_sag(source.size(), glm::vec3(0.0f));
+    std::vector<int> new_slot(source.size(), -1);
+    std::vector<int> added_branches;
+    for (size_t n = 0; n < source.size(); n++) {
+        if (source[n] >= 0) {
+            int i = source[n];
+            new_branches[n] = branches[i];
+            if (branches[i].parent_index >= 0) new_branches[n].parent_index = old_to_new[branches[i].parent_index];
+            new_right[n] = branch_right[i];
+            new_up[n] = branch_up[i];
+            new_tex_v[n] = branch_tex_v[i];
+            new_welded[n] = branch_welded[i];
+            new_segments[n] = branch_segments[i];
+            new_sections[n] = branch_sections[i];
+            new_sag[n] = branch_sag[i];
+            new_slot[n] = branch_slot[i];
+        } else {
+            new_branches[n] = out.branches[-1 - source[n]];
+            new_branches[n].parent_index = local_to_new[new_branches[n].parent_index];
+            added_branches.push_back(n);
+        }
+    }
+    branches.swap(new_branches);
+    branch_right.swap(new_right);
+    branch_up.swap(new_up);
+    branch_tex_v.swap(new_tex_v);
+    branch_welded.swap(new_welded);
+    branch_segments.swap(new_segments);
+    branch_sections.swap(new_sections);
+    branch_sag.swap(new_sag);
+    branch_slot.swap(new_slot);
+    
+    // New branches are independent, straight cylinders in a recycled or appended slot
+    for (int n : added_branches) {
+        branch_segments[n] = ringSegmentsFor(n);
+        buildBranchFrame(n);
+        int slot = allocateBranchSlot(branch_segments[n]);
+        branch_slot[n] = slot;
+        uint32_t start_ring = branch_vertex_offset[slot];
+        writeBranchIndices(&branch_indices[branch_index_offset[slot]], branch_segments[n],
+                           start_ring, start_ring + branchRingVertices(n));
+    }
+    
+    std::vector<int> added_leaves;
+    for (const TreeLeaf& leaf : out.leaves) {
+        TreeLeaf moved = leaf;
+        moved.parent_branch_index = local_to_new[leaf.parent_branch_index];
+        added_leaves.push_back(new_leaves.size());
+        new_leaves.push_back(moved);
+        new_leaf_slot.push_back(allocateLeafSlot());
+    }
+    leaves.swap(new_leaves);
+    leaf_slot.swap(new_leaf_slot);
+    
+    /*
+     * STEP 4: TWIGS, ADJACENCY, GROWTH STATE AND MESHES
+     */
+    keepTwigs(branch_index, removed, old_to_new);
+    if (!out.deferred.empty()) {
+        // The tree's own library, so kept twigs' prototypes stay valid
+        if (!twig_library) buildTwigLibrary();
+        for (BranchWorkItem twig_root : out.deferred) {
+            twig_root.parent_index = local_to_new[twig_root.parent_index];
+            TwigInstance twig = makeTwig(twig_root);
+            scheduleTwig(twig);
+            schedule_end_time = std::max(schedule_end_time, twig.start_time + twig.growth_duration);
+            twig_instances.push_back(twig);
+        }
+    }
+    groupTwigs();
+    
+    finishSubtreeEdit(old_to_new, added_branches, leaf_old_to_new, added_leaves);
+    
+    TreeEdit edit = TreeEdit();
+    edit.type = TreeEditType::Regrow;
+    edit.branch_index = branch_index;
+    edit.seed = subtree_seed;
+    edit.time = from_time;
+    logEdit(edit);
+    return true;
+}
+
+// Mark the descendants of branch_index in removed, blank their slots and
+// those of their leaves and of the branch's own, and keep the other leaves
+// with their slots, mapping them in leaf_old_to_new. Parents precede
+// children, so one forward pass finds every descendant
+void Tree::blankSubtree(int branch_index, std::vector<unsigned char>& removed, std::vector<int>& leaf_old_to_new,
+                        std::vector<TreeLeaf>& kept_leaves, std::vector<int>& kept_leaf_slot) {
+    for (int i = branch_index + 1; i < (int)branches.size(); i++) {
+        int parent = branches[i].parent_index;
+        if (parent == branch_index || (parent >= 0 && removed[parent])) {
+            removed[i] = 1;
+            blankBranchSlot(branch_slot[i]);
+        }
+    }
+    leaf_old_to_new.assign(leaves.size(), -1);
+    for (int l = 0; l < (int)leaves.size(); l++) {
+        int parent = leaves[l].parent_branch_index;
+        if (parent == branch_index || removed[parent]) {
+            blankLeafSlot(leaf_slot[l]);
+            continue;
+        }
+        leaf_old_to_new[l] = kept_leaves.size();
+        kept_leaves.push_back(leaves[l]);
+        kept_leaf_slot.push_back(leaf_slot[l]);
+    }
+}
+
+// Drop the twigs on branch_index and on removed branches, renaming the
+// parents of the rest
+void Tree::keepTwigs(int branch_index, const std::vector<unsigned char>& removed, const std::vector<int>& old_to_new) {
+    size_t kept_twigs = 0;
+    for (const TwigInstance& twig : twig_instances) {
+        int parent = twig.parent_branch_index;
+        if (parent == branch_index || removed[parent]) continue;
+        TwigInstance moved = twig;
+        moved.parent_branch_index = old_to_new[parent];
+        twig_instances[kept_twigs++] = moved;
+    }
+    twig_instances.resize(kept_twigs);
+}
+
+// Bring the derived state up to date once the element arrays are renamed
+// through old_to_new (-1 = removed) and the added elements appended.
+// Started elements are no longer a slot prefix, so every slot is drawn;
+// the GPU-animated mesh is rebuilt, its vertices naming branch indices
+void Tree::finishSubtreeEdit(const std::vector<int>& old_to_new, std::vector<int>& added_branches,
+                             const std::vector<int>& leaf_old_to_new, std::vector<int>& added_leaves) {
+    buildChildAdjacency();
+    buildLeafRanges();
+    recountGenerationOffsets();
+    
+    spliceActiveSet(branch_activity, old_to_new, added_branches,
+                    [this](int i) { return branches[i].start_time; });
+    spliceActiveSet(leaf_activity, leaf_old_to_new, added_leaves,
+                    [this](int i) { return leaves[i].start_time; });
+    branch_moved.assign(branches.size(), 0);
+    if (storage_mode == TreeStorageMode::StructureOfArrays) {
+        soa.assign(branches, leaves);
+    }
+    
+    // Totals are recounted; the visibility counters follow the active sets
+    resetStats();
+    recountGrowthStats();
+    reserveUpdateScratch();
+    
+    slots_in_start_order = false;
+    layout_changed = true;
+    layout_version = nextVersion();
+    update_level_branches.clear();
+    bakeOcclusion();
+    if (mesh_animation == MeshAnimation::Gpu) {
+        buildStaticMesh();
+    }
+}
+
+// === PRUNING ===
+
+bool Tree::pruneBranch(int branch_index, TreeRemap* remap) {
+    const int old_branch_count = branches.size();
+    const int old_leaf_count = leaves.size();
+    if (branch_index < 0 || branch_index >= old_branch_count || branches[branch_index].parent_index < 0 ||
+        branch_activity.order.size() != branches.size() || branch_slot.size() != branches.size()) {
+        return false;
+    }
+    
+    // SoA keeps the live progress; the records are rebuilt from the structs
+    if (storage_mode == TreeStorageMode::StructureOfArrays) {
+        for (int i = 0; i < old_branch_count; i++) branches[i].growth_progress = soa.branch_progress[i];
+        for (int i = 0; i < old_leaf_count; i++) leaves[i].growth_progress = soa.leaf_progress[i];
+    }
+    
+    /*
+     * STEP 1: TOMBSTONE THE SUBTREE'S SLOTS
+     * The branch goes with its descendants; the freed slots collapse in
+     * place and are all the mesh rewrites
+     */
+    std::vector<unsigned char> removed(old_branch_count, 0);
+    removed[branch_index] = 1;
+    blankBranchSlot(branch_slot[branch_index]);
+    std::vector<int> leaf_old_to_new;
+    std::vector<TreeLeaf> new_leaves;
+    std::vector<int> new_leaf_slot;
+    new_leaves.reserve(old_leaf_count);
+    blankSubtree(branch_index, removed, leaf_old_to_new, new_leaves, new_leaf_slot);
+    
+    /*
+     * STEP 2: PACK THE KEPT BRANCHES
+     * In their order, so parents still precede children in either layout
+     */
+    std::vector<int> old_to_new(old_branch_count, -1);
+    int kept = 0;
+    for (int i = 0; i < old_branch_count; i++) {
+        if (!removed[i]) old_to_new[i] = kept++;
+    }
+    for (int i = 0; i < old_branch_count; i++) {
+        int n = old_to_new[i];
+        if (n < 0) continue;
+        TreeBranch branch = branches[i];
+        if (branch.parent_index >= 0) branch.parent_index = old_to_new[branch.parent_index];
+        branches[n] = branch;
+        branch_right[n] = branch_right[i];
+        branch_up[n] = branch_up[i];
+        branch_tex_v[n] = branch_tex_v[i];
+        branch_welded[n] = branch_welded[i];
+        branch_segments[n] = branch_segments[i];
+        branch_sections[n] = branch_sections[i];
+        branch_sag[n] = branch_sag[i];
+        branch_slot[n] = branch_slot[i];
+    }
+    branches.resize(kept);
+    branch_right.resize(kept);
+    branch_up.resize(kept);
+    branch_tex_v.resize(kept);
+    branch_welded.resize(kept);
+    branch_segments.resize(kept);
+    branch_sections.resize(kept);
+    branch_sag.resize(kept);
+    branch_slot.resize(kept);
+    for (TreeLeaf& leaf : new_leaves) {
+        leaf.parent_branch_index = old_to_new[leaf.parent_branch_index];
+    }
+    leaves.swap(new_leaves);
+    leaf_slot.swap(new_leaf_slot);
+    
+    /*
+     * STEP 3: TWIGS AND DERIVED STATE
+     */
+    keepTwigs(branch_index, removed, old_to_new);
+    groupTwigs();
+    std::vector<int> no_branches, no_leaves;
+    finishSubtreeEdit(old_to_new, no_branches, leaf_old_to_new, no_leaves);
+    
+    TreeEdit edit = TreeEdit();
+    edit.type = TreeEditType::Prune;
+    edit.branch_index = branch_index;
+    logEdit(edit);
+    
+    if (remap) {
+        remap->branch_old_to_new.swap(old_to_new);
+        remap->leaf_old_to_new.swap(leaf_old_to_new);
+    }
+    return true;
+}
+
+bool Tree::compactSlots() {
+    if (slots_in_start_order || mesh_animation != MeshAnimation::Cpu) return false;
+    rewindGrowth(current_growth_time, true);
+    return true;
+}
+
+// === LAZY DETAIL ===
+
+void Tree::setLazyDetail(int coarse_generation, float expand_size, float collapse_size) {
+    detail_generation = std::max(0, coarse_generation);
+    detail_expand_size = expand_size;
+    detail_collapse_size = std::min(collapse_size, expand_size);
+}
+
+void Tree::generateLazy(const BranchWorkItem& trunk, std::vector<BranchWorkItem>& twig_roots) {
+    // === COARSE CROWN ON THE TREE'S ENGINE, KEPT FOR LATER EXPANSIONS ===
+    // The same crown the split generator grows with the split at this
+    // generation, so an expanded tree equals that one
+    detail_crown.rng = &rng;
+    generateBranches(trunk, detail_crown, detail_generation);
+    detail_crown.rng = nullptr;
+    detail_active = true;
+    
+    // === BOUNDS ===
+    // The crown's box, padded by the longest path a subtree can add (its
+    // root's length shrinking every generation) and by a leaf's reach from
+    // its branch end (offset up to 0.4, half of the largest leaf)
+    glm::vec3 low = trunk.start;
+    glm::vec3 high = trunk.start;
+    for (const TreeBranch& branch : detail_crown.branches) {
+        low = glm::min(low, branch.end);
+        high = glm::max(high, branch.end);
+    }
+    for (const TreeLeaf& leaf : detail_crown.leaves) {
+        low = glm::min(low, leaf.position);
+        high = glm::max(high, leaf.position);
+    }
+    float length = 0.0f;
+    for (const BranchWorkItem& root : detail_crown.deferred) {
+        length = std::max(length, root.length);
+    }
+    float reach = 0.0f;
+    for (int g = detail_generation; g <= max_generations; g++) {
+        reach += length;
+        length *= length_reduction_factor;
+    }
+    detail_center = 0.5f * (low + high);
+    detail_radius = 0.5f * glm::length(high - low) + reach + 0.4f + 0.45f * 0.5f;
+    
+    buildDetail(twig_roots);
+}
+
+void Tree::buildDetail(std::vector<BranchWorkItem>& twig_roots) {
+    if (detail_expanded) {
+        std::vector<GenerationOutput> subtrees;
+        generateSubtrees(detail_crown, subtrees);
+        stitchSubtrees(detail_crown, subtrees, detail_generation, twig_roots);
+    } else {
+        branches = detail_crown.branches;
+        leaves = detail_crown.leaves;
+        generation_offsets = detail_crown.generation_offsets;
+    }
+}
+
+float Tree::getProjectedSize(const glm::vec3& eye, float fov_y) const {
+    float distance = glm::length(eye - detail_center);
+    if (distance <= detail_radius) {
+        return std::numeric_limits<float>::max(); // Inside the bounds the tree fills the view
+    }
+    return detail_radius / (distance * tanf(0.5f * fov_y));
+}
+
+bool Tree::updateDetail(const glm::vec3& eye, float fov_y) {
+    if (!detail_active) return false;
+    float size = getProjectedSize(eye, fov_y);
+    if (!detail_expanded && size >= detail_expand_size) return setDetailExpanded(true);
+    if (detail_expanded && size < detail_collapse_size) return setDetailExpanded(false);
+    return false;
+}
+
+// Drop an array's storage, not just its elements
+template <typename T>
+static void releaseStorage(std::vector<T>& v) {
+    std::vector<T>().swap(v);
+}
+
+bool Tree::setDetailExpanded(bool expanded) {
+    if (expanded == detail_expanded) return false;
+    detail_expanded = expanded;
+    if (!detail_active) return false; // Applies to the next generate()
+    
+    // === COLLAPSING RETURNS THE DEEP GENERATIONS' MEMORY ===
+    // Everything below is rebuilt at the crown's size
+    if (!expanded) {
+        releaseStorage(branches);
+        releaseStorage(leaves);
+        releaseStorage(child_indices);
+        releaseStorage(leaf_ranges);
+        releaseStorage(branch_vertices);
+        releaseStorage(leaf_vertices);
+        releaseStorage(branch_indices);
+        releaseStorage(leaf_indices);
+        releaseStorage(branch_instances);
+        releaseStorage(leaf_instances);
+        releaseStorage(static_branch_vertices);
+        releaseStorage(static_leaf_vertices);
+        releaseStorage(branch_growth_data);
+        releaseStorage(absolute_start);
+        releaseStorage(absolute_end);
+        releaseStorage(branch_moved);
+        releaseStorage(leaf_moved);
+        soa = TreeStorageSoA();
+    }
+    
+    // === STRUCTURE FROM THE KEPT CROWN ===
+    branches.clear();
+    child_indices.clear();
+    leaves.clear();
+    twig_instances.clear();
+    twig_offsets.clear();
+    std::vector<BranchWorkItem> twig_roots;
+    buildDetail(twig_roots);
+    placeTwigs(twig_roots);
+    buildChildAdjacency();
+    applyBudget();
+    buildGrowthSchedule();
+    
+    // === DRAWABLE STATE AT THE CURRENT TIME ===
+    // Schedules depend only on the topology above each element, so the
+    // crown keeps its timing; progress is a function of time, so one
+    // zero-length update after the reset restores it and writes the meshes
+    // The restore passes no new milestone, so its events are dropped
+    std::vector<GrowthEvent> queued;
+    queued.swap(growth_events);
+    prepareDrawable();
+    updateGrowth(0.0f);
+    growth_events.swap(queued);
+    layout_changed = true;
+    layout_version = nextVersion();
+    return true;
 }
@@ -2,8 +2,20 @@
 #define TREE_H
 
 #include <vector>
+#include <random>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+#include <ostream>
+#include <memory>
+#include <string>
+#include <functional>
 #include <glm/glm.hpp>
-#include <GL/glew.h>
+#include "tree_storage.h"
+#include "branch_grid.h"
+#include "lsystem.h"
+#include "space_colonization.h"
+#include "vertex_cache.h"
 
 struct TreeBranch {
     glm::vec3 start;
@@ -11,10 +23,16 @@ struct TreeBranch {
     float radius;
     int generation;
     float growth_progress; // 0.0 to 1.0
-    std::vector<int> children; // indices to child branches
     int parent_index; // index to parent branch (-1 for trunk)
+    int first_child;  // offset of this branch's children in Tree::child_indices
+    int child_count;  // number of child branches
+    float start_time;      // growth start, precomputed from the topology
+    float growth_duration; // seconds from start_time to fully grown
 };
 
+// Branches are plain data so they can be memcpy'd and processed in bulk
+static_assert(std::is_trivially_copyable<TreeBranch>::value, "TreeBranch must be trivially copyable");
+
 struct TreeLeaf {
     glm::vec3 position;
     glm::vec3 normal;
@@ -22,55 +40,972 @@ struct TreeLeaf {
     float growth_progress;
     int parent_branch_index; // Index of the branch this leaf belongs to
     float spawn_delay; // Individual delay for gradual appearance
+    float start_time;      // growth start, precomputed from parent timing and spawn_delay
+    float growth_duration; // seconds from start_time to fully grown
+};
+
+// A run of consecutive leaves on one branch. Generation emits each
+// branch's leaves together, so a branch normally owns one range; the Morton
+// layout and subtree edits split them
+struct TreeLeafRange {
+    int branch;     // parent_branch_index of every leaf in the range
+    int first_leaf;
+    int leaf_count;
+};
+
+// Growth state partition for one element kind (branches or leaves):
+// order[0, next_pending) have started, order[next_pending, end) are pending,
+// growing holds the started ones still below full growth
+struct GrowthActiveSet {
+    std::vector<int> order;   // Element indices sorted by start_time
+    size_t next_pending;      // First element of order that hasn't started
+    std::vector<int> growing; // Started and still changing every frame
+    std::vector<int> changed; // Elements whose progress changed in the last update
+    int done;                 // Fully grown elements
+    
+    // Packed schedule of the growing elements for the SIMD update, lane k
+    // holding growing[k]; only the SoA kernel keeps them, everything else
+    // that edits growing drops them and they are rebuilt on the next update
+    std::vector<float> lane_start;
+    std::vector<float> lane_duration;
+    std::vector<float> lane_progress;
+    
+    GrowthActiveSet() : next_pending(0), done(0) {}
+    bool isStatic() const { return next_pending == order.size() && growing.empty(); }
+    void dropLanes() { lane_start.clear(); lane_duration.clear(); }
+};
+
+// Counters maintained as a side effect of generate() / updateGrowth()
+struct TreeStats {
+    int total_branches;
+    int total_leaves;
+    std::vector<int> branches_by_generation;
+    std::vector<int> visible_by_generation; // Branches that have started growing
+    std::vector<int> grown_by_generation;   // Branches fully grown
+    int visible_branches;
+    int visible_leaves;
+    int growing_branches;   // Started but not yet fully grown
+    int growing_leaves;
+    int vertices_emitted;   // Vertices rewritten by the last updateGrowth()
+    int twig_instances;     // Twig prototype references standing in for deep subtrees
+};
+
+// Heap held by a tree's vectors, in bytes: in use (size) and reserved
+// (capacity). Topology is the element records, the SoA mirror and the
+// per-element meshing and growth state; vertices are the arrays uploaded
+struct TreeMemory {
+    size_t topology_bytes;
+    size_t topology_capacity;
+    size_t vertex_bytes;
+    size_t vertex_capacity;
+};
+
+// Growth milestones, queued by the update that passed them
+enum class GrowthEventType {
+    GenerationStarted,   // The generation's first branch started growing
+    GenerationCompleted, // Every branch of the generation is fully grown
+    TreeCompleted        // Nothing left to grow; the tree is static
+};
+
+struct GrowthEvent {
+    GrowthEventType type;
+    int generation; // -1 for TreeCompleted
+    float time;     // Growth time of the update that passed the milestone
+};
+
+// Byte range of a vertex array rewritten since it was last uploaded
+struct MeshDirtyRange {
+    size_t offset;
+    size_t size;
+};
+
+// Element renames of a structural edit: the new index of every old branch
+// and leaf, -1 for one removed
+struct TreeRemap {
+    std::vector<int> branch_old_to_new;
+    std::vector<int> leaf_old_to_new;
+};
+
+// Where the growth animation is evaluated
+enum class MeshAnimation {
+    Cpu,  // Per-frame rebuild of the slots of moving elements
+    Gpu   // Static fully grown mesh animated in v_simplest.glsl from growthTime
+};
+
+// How branch cylinders are joined
+enum class BranchMeshing {
+    Cylinders,  // Every branch is an independent cylinder with its own base ring
+    Tubes       // Each branch's dominant child welds its base to the parent's end ring
+};
+
+// How many faces each leaf quad gets
+enum class LeafFaces {
+    DoubleSided,  // Front and back quads, 12 unindexed vertices
+    SingleSided   // One indexed 4-vertex quad; f_simplest.glsl lights the back face
+};
+
+// How leaves reach the GPU on the CPU-animated path
+enum class LeafRendering {
+    Mesh,      // Expanded into leaf_vertices by addLeafQuad
+    Instanced  // One LeafInstance each, expanded from a unit quad in v_simplest.glsl
+};
+
+// Per-leaf record for instanced drawing (24 bytes): animated position,
+// normal as GL_INT_2_10_10_10_REV, full size and growth progress
+struct LeafInstance {
+    glm::vec3 position;
+    uint32_t normal;
+    float size;
+    float growth;
+};
+
+static_assert(sizeof(LeafInstance) == 24, "LeafInstance must stay tightly packed");
+
+// How branches reach the GPU on the CPU-animated path
+enum class BranchRendering {
+    Mesh,      // Expanded into branch_vertices by addBranchSegment
+    Instanced  // One BranchInstance each, expanded from a unit cylinder in v_simplest.glsl
 };
 
+// Per-branch record for instanced drawing (32 bytes): animated endpoints,
+// base radius (the tip tapers to 70%) and growth progress
+struct BranchInstance {
+    glm::vec3 start;
+    float radius;
+    glm::vec3 end;
+    float growth;
+};
+
+static_assert(sizeof(BranchInstance) == 32, "BranchInstance must stay tightly packed");
+
+// Memory order of the branches array produced by generate()
+enum class BranchLayout {
+    DepthFirst,   // Pre-order: each subtree is contiguous
+    BreadthFirst  // Generation order: each generation is contiguous
+};
+
+// Memory order of the leaves array produced by generate(), and with it of
+// their mesh slots
+enum class LeafLayout {
+    Generation, // As the generator emitted them, branch by branch
+    Morton      // Along a Z-order curve through the crown: leaves near in space are near in memory
+};
+
+// The 10 bits of each coordinate of a point of the unit cube (clamped to
+// it) interleaved, for sorting along a Z-order curve
+uint32_t mortonCode(const glm::vec3& unit);
+
+// Algorithm that grows the branch structure
+enum class TreeGenerator {
+    Branching,         // Built-in recursive branching rules, or the L-system grammar when one is set
+    SpaceColonization  // Crown-filling growth toward attractor points (space_colonization.h)
+};
+
+// Bumped whenever generate() makes a different tree from the same settings
+// and seed, so trees cached by an older build (tree_cache.h) are generated
+// again rather than reused
+static const uint32_t TREE_GENERATOR_VERSION = 1;
+
+// Shape parameters of one tree; everything else comes from the seed
+struct TreeParameters {
+    int max_generations;
+    float branch_angle_variance;   // Degrees
+    float length_reduction_factor; // Child length / parent length
+    float radius_reduction_factor; // Child radius / parent radius
+    float max_growth_time;         // Seconds for the whole tree to grow
+};
+
+// Most generations parameters from outside may ask for (asset files,
+// deltas): tree profiles stop there too
+static const int TREE_MAX_GENERATIONS = 16;
+
+// Why parameters from outside are out of range (Tree::setParameters
+// takes them as they come), or empty when they are in it:
+// max_generations 0 to max_generations_limit, the variance finite and 0
+// to 180 degrees, the reduction factors in (0, 1] and the growth time
+// finite and positive
+std::string checkTreeParameters(const TreeParameters& parameters, int max_generations_limit);
+
+// One entry of a tree's edit log (Tree::getEdits): the edits that change
+// its elements, made again on a copy to keep it in step (tree_delta.h)
+enum class TreeEditType : uint8_t {
+    Prune = 1,     // pruneBranch(branch_index)
+    Regrow = 2,    // regenerateSubtree(branch_index, seed, time)
+    Parameters = 3 // setParameters(parameters), which shapes later regrowth
+};
+
+struct TreeEdit {
+    TreeEditType type;
+    int branch_index;
+    uint64_t seed;
+    float time; // Growth time the regrown elements grew in from
+    TreeParameters parameters;
+    int branch_count; // The tree's elements after the edit
+    int leaf_count;
+};
+
+// Generation ceilings for one tree (0 = unlimited). max_vertices bounds the
+// mesh vertices the kept elements can emit at the largest ring size, so it
+// holds whatever the tree grows into
+struct TreeBudget {
+    int max_branches;
+    int max_leaves;
+    int max_vertices;
+    
+    TreeBudget() : max_branches(0), max_leaves(0), max_vertices(0) {}
+};
+
+// What the budget removed from the last generated tree. Whole subtrees are
+// dropped, least significant (smallest radius * length) first
+struct TreeBudgetReport {
+    int dropped_subtrees;
+    int dropped_branches;
+    int dropped_leaves;
+    int dropped_twigs;
+    std::vector<int> dropped_by_generation;
+    int vertex_bound; // Vertex bound of what was kept
+    
+    TreeBudgetReport() : dropped_subtrees(0), dropped_branches(0), dropped_leaves(0), dropped_twigs(0), vertex_bound(0) {}
+};
+
+// One pre-generated twig subtree in its own frame: the root starts at the
+// origin heading along +Z, tilted up by the generator's mean elevation.
+// Its fully grown mesh lives in the library's shared arrays: wood triangles
+// first, then single-sided leaf quads
+struct TwigPrototype {
+    std::vector<TreeBranch> branches;
+    std::vector<TreeLeaf> leaves;
+    int first_wood_index;
+    int wood_index_count;
+    int first_leaf_index;
+    int leaf_index_count;
+    float growth_span; // Seconds from the root's start until the whole twig is grown
+};
+
+// Twig prototypes shared by every tree generated with the same settings;
+// trees keep a reference, so a forest holds one copy
+struct TwigLibrary {
+    TreeParameters parameters;
+    BranchLayout layout;
+    int depth;
+    std::vector<TwigPrototype> prototypes;
+    std::vector<float> vertices;  // VERTEX_FLOATS layout
+    std::vector<uint32_t> indices;  // Each range reordered for the vertex cache
+    VertexCacheStats generated_cache; // The indices as built, and as reordered
+    VertexCacheStats optimized_cache;
+};
+
+// Reference to a twig prototype placed on the tree (64 bytes, the layout the
+// twig instance attributes read): columns of the prototype-to-tree
+// rotation, the attachment point and the growth window
+struct TwigInstance {
+    glm::vec3 axis_x;
+    float start_time;
+    glm::vec3 axis_y;
+    float growth_duration;
+    glm::vec3 axis_z;
+    int prototype;
+    glm::vec3 origin;
+    int parent_branch_index;
+};
+
+static_assert(sizeof(TwigInstance) == 64, "TwigInstance must stay tightly packed");
+
+class TreeJobPool;
+class TreeAssetFile;
+
 class Tree {
 private:
     std::vector<TreeBranch> branches;
     std::vector<TreeLeaf> leaves;
+    std::vector<int> child_indices; // Children of every branch, grouped per parent
     
-    // Vertex data for rendering - simplified to just vertices
+    // Vertex data for rendering - one fixed slot per branch / leaf
     std::vector<float> branch_vertices;
     std::vector<float> leaf_vertices;
     
+    // Triangles of every branch slot; fixed once the slots are assigned
+    std::vector<uint32_t> branch_indices;
+    // Triangles of every leaf slot - single-sided leaves only
+    std::vector<uint32_t> leaf_indices;
+    LeafFaces leaf_faces;
+    int leaf_slot_vertices; // LEAF_SLOT_VERTICES or LEAF_SINGLE_SLOT_VERTICES
+    
+    // Instanced branches: one record per branch slot instead of branch_vertices
+    BranchRendering branch_rendering;
+    std::vector<BranchInstance> branch_instances;
+    
+    // Instanced leaves: one record per leaf slot instead of leaf_vertices
+    LeafRendering leaf_rendering;
+    std::vector<LeafInstance> leaf_instances;
+    
+    // Branch slots vary in size when tubes are welded: first vertex of each
+    // slot, with a trailing end sentinel
+    std::vector<int> branch_vertex_offset;
+    
+    // Ring frame of each branch (constant - growth only scales along the
+    // axis), texture V at its base and whether its base ring is the parent's
+    std::vector<glm::vec3> branch_right;
+    std::vector<glm::vec3> branch_up;
+    std::vector<float> branch_tex_v;
+    std::vector<unsigned char> branch_welded;
+    BranchMeshing branch_meshing;
+    
+    // Sides of each branch's rings, scaled with radius between the two
+    // limits, and the first index of each slot (trailing end sentinel)
+    std::vector<unsigned char> branch_segments;
+    std::vector<int> branch_index_offset;
+    int min_ring_segments;
+    int max_ring_segments;
+    
+    // Curved branches: sections along each branch (1 = one straight
+    // cylinder) and how far its fully grown axis sags below the chord at
+    // mid-length (zero unless it has more than one section)
+    std::vector<unsigned char> branch_sections;
+    std::vector<glm::vec3> branch_sag;
+    float branch_curvature;  // Sag of a level, slender branch as a share of its length; 0 = straight
+    int curve_vertex_budget; // Extra ring vertices the sections may add per tree; 0 = no limit
+    
+    // Slot of each element in its vertex array (rank in start-time order)
+    std::vector<int> branch_slot;
+    std::vector<int> leaf_slot;
+    // The leaves as runs sharing a parent, in leaf order; rebuilt with the slots
+    std::vector<TreeLeafRange> leaf_ranges;
+    
+    // Once regenerateSubtree reuses freed slots or appends new ones, or
+    // pruneBranch frees some, the started elements no longer form a prefix
+    // of slot order and every slot is drawn (unstarted and freed slots are
+    // degenerate) until a rewind or compactSlots() lays them out again.
+    // Freed slots wait on the free lists for an element of the same size
+    bool slots_in_start_order;
+    int leaf_slot_count;
+    std::vector<int> free_branch_slots;
+    std::vector<int> free_leaf_slots;
+    bool layout_changed; // Index buffers, GPU meshes or twigs changed after generate()
+    // Behind getLayoutVersion() / getMeshVersion(); from nextVersion()
+    uint64_t layout_version;
+    uint64_t mesh_version;
+    
+    // Slots rewritten since the renderer last took the dirty ranges
+    std::vector<unsigned char> branch_slot_dirty;
+    std::vector<unsigned char> leaf_slot_dirty;
+    std::vector<int> branch_dirty_slots;
+    std::vector<int> leaf_dirty_slots;
+    
+    // Per-frame scratch: elements whose geometry moved
+    std::vector<unsigned char> branch_moved;
+    std::vector<unsigned char> leaf_moved;
+    
+    // GPU animation: fully grown mesh with per-vertex growth references, and
+    // the per-branch table the vertex shader walks to animate it
+    MeshAnimation mesh_animation;
+    std::vector<float> static_branch_vertices;
+    std::vector<float> static_leaf_vertices;
+    std::vector<float> branch_growth_data;
+    
     // Generation parameters
     float max_growth_time;
     float current_growth_time;
+    float schedule_end_time; // Time at which the last element finishes growing
     int max_generations;
     float branch_angle_variance;
     float length_reduction_factor;
     float radius_reduction_factor;
+    BranchLayout branch_layout;
+    LeafLayout leaf_layout;
+    TreeStorageMode storage_mode;
+    
+    // Pending / growing / done tracking so a frame only touches changing elements
+    GrowthActiveSet branch_activity;
+    GrowthActiveSet leaf_activity;
+    
+    // Field-per-array copy of branches/leaves, used in StructureOfArrays mode
+    TreeStorageSoA soa;
+    
+    // Start index of each generation in branches (breadth-first layout only),
+    // with a trailing end sentinel
+    std::vector<int> generation_offsets;
+    
+    TreeStats stats;
+    int verbosity;
+    
+    // Milestones not yet taken; growth_completed once TreeCompleted is queued
+    std::vector<GrowthEvent> growth_events;
+    bool growth_completed;
+    
+    // Random number generation - one engine per tree, reseeded by generate()
+    std::mt19937_64 rng;
+    uint64_t seed;
+    
+    // Edits from first_edit_sequence on (getEdits)
+    std::vector<TreeEdit> edits;
+    uint32_t first_edit_sequence;
+    
+    // Per-frame cache of animated world-space branch endpoints
+    std::vector<glm::vec3> absolute_start;
+    std::vector<glm::vec3> absolute_end;
+    
+    // Helper for branch positioning - fills the endpoint cache in one pass
+    void resolveAbsolutePositions();
+    void runUpdateChunks(int count, const std::function<void(int, int, int)>& fn);
+    void prepareUpdateChunks(int count);
+    void mergeUpdateChunks(std::vector<int>& dirty_slots);
+    void buildUpdateLevels();
+    void reserveUpdateScratch();
+    void forEachLevel(const std::function<void(int)>& fn);
+    
+    // Pending branch on the generator's explicit work list
+    struct BranchWorkItem {
+        int parent_index;
+        glm::vec3 start;
+        glm::vec3 direction;
+        float length;
+        float radius;
+        int generation;
+        uint64_t path; // Hash of the child ordinals from the trunk; seeds subtree streams
+        int capsule;   // Its id in the run's BranchGrid; -1 when not in one yet
+    };
+    
+    // Where one generator run writes: the whole tree, the crown above the
+    // split generation, or one split subtree. Indices are local to the run
+    struct GenerationOutput {
+        std::vector<TreeBranch> branches;
+        std::vector<TreeLeaf> leaves;
+        std::vector<int> generation_offsets;  // Breadth-first: start of each generation below the root
+        std::vector<BranchWorkItem> deferred; // Roots at the stop generation, left for subtree runs
+        std::vector<int> deferred_position;   // Depth-first: branches emitted before each deferred root
+        std::mt19937_64* rng;
+        BranchGrid* grid;                     // Branch avoidance: what children must not pass through
+        int avoidance_redrawn;                // Branch avoidance: draws rejected, children dropped
+        int avoidance_dropped;
+        
+        GenerationOutput() : rng(nullptr), grid(nullptr), avoidance_redrawn(0), avoidance_dropped(0) {}
+    };
+    
+    // Grammar-driven generation: when set, the compiled L-system replaces the
+    // built-in branching rules; the workspace keeps its strings across trees
+    std::shared_ptr<const LSystemGrammar> grammar;
+    LSystemWorkspace lsystem_workspace;
+    
+    // Space colonization: its parameters and reusable node / attractor state
+    TreeGenerator generator;
+    SpaceColonizationParameters colonization_parameters;
+    SpaceColonization colonizer;
+    
+    // Parallel generation: 0 = serial single-stream generator, otherwise the
+    // subtrees rooted at split_generation run on this many threads
+    int generation_threads;
+    int split_generation;
+    
+    // Branch avoidance: the grid of the serial run or the crown, and what
+    // the last generate() redrew and dropped
+    bool branch_avoidance;
+    BranchGrid avoidance_grid;
+    int avoidance_redrawn;
+    int avoidance_dropped;
+    
+    // Parallel growth update: with more than one update thread the per-frame
+    // passes run in UPDATE_CHUNK element chunks on the shared job system
+    // (job_system.h), the parent-dependent ones one depth level at a
+    // time from update_level_branches. Per-chunk dirty lists and vertex
+    // counts keep the chunks from writing shared state
+    static const int UPDATE_CHUNK = 2048;
+    int update_threads;
+    std::shared_ptr<TreeJobPool> update_pool;
+    std::vector<int> update_level_offsets;
+    std::vector<int> update_level_branches;
+    std::vector<std::vector<int>> update_chunk_dirty;
+    std::vector<int> update_chunk_emitted;
+    
+    // Twig instancing: subtrees from twig_depth on become references to the
+    // library's prototypes (0 = off). Instances are grouped by prototype,
+    // twig_offsets[k] being prototype k's first, with an end sentinel
+    int twig_depth;
+    int twig_prototype_count;
+    std::shared_ptr<const TwigLibrary> twig_library;
+    std::vector<TwigInstance> twig_instances;
+    std::vector<int> twig_offsets;
     
-    // Helper functions for branch positioning
-    glm::vec3 calculateAbsoluteBranchStart(int branch_index);
-    glm::vec3 calculateAbsoluteBranchEnd(int branch_index);
+    // Baked ambient occlusion, rebaked with every layout by
+    // occlusion_baker when set: two per branch, one per leaf.
+    // occlusion_settings names what it bakes, 0 without one
+    std::function<void(const Tree&, std::vector<float>&, std::vector<float>&)> occlusion_baker;
+    uint32_t occlusion_settings;
+    std::vector<float> branch_occlusion;
+    std::vector<float> leaf_occlusion;
+    
+    // Lazy detail: generations from detail_generation on are grown only
+    // while the tree looks large (0 = off). The coarse crown above them is
+    // kept with the roots it stopped at; expanding grows each root's subtree
+    // on its path stream, exactly as the split generator would. Bounds are a
+    // sphere around the crown padded by the deepest reach of the subtrees
+    int detail_generation;
+    float detail_expand_size;
+    float detail_collapse_size;
+    bool detail_expanded;
+    bool detail_active; // The last generate() kept a crown
+    GenerationOutput detail_crown;
+    glm::vec3 detail_center;
+    float detail_radius;
+    
+    // Ceilings applied after generation, and what they cost the last tree
+    TreeBudget budget;
+    TreeBudgetReport budget_report;
     
     // Generation methods
-    void generateBranch(int parent_index, glm::vec3 start, glm::vec3 direction, 
-                       float length, float radius, int generation);
+    size_t reserveForGenerations(GenerationOutput& out, int root_generation, int stop_generation) const;
+    void generateBranches(const BranchWorkItem& root, GenerationOutput& out, int stop_generation) const;
+    int emitBranch(const BranchWorkItem& item, std::vector<BranchWorkItem>& work, GenerationOutput& out) const;
+    void emitLeaves(int branch_index, GenerationOutput& out) const;
+    void generateSplit(const BranchWorkItem& trunk, std::vector<BranchWorkItem>& twig_roots);
+    void generateSubtrees(const GenerationOutput& crown, std::vector<GenerationOutput>& subtrees) const;
+    void generateLazy(const BranchWorkItem& trunk, std::vector<BranchWorkItem>& twig_roots);
+    void buildDetail(std::vector<BranchWorkItem>& twig_roots);
+    void prepareDrawable(bool build_static_mesh = true);
+    // load()'s work on an opened asset; path names it in errors
+    bool adopt(const TreeAssetFile& file, const std::string& path, std::string& error);
+    bool generateFromGrammar();
+    bool generateFromColonization();
+    bool adoptGeneratedBranches(const char* source);
+    void layoutByGeneration();
+    void layoutLeavesByMorton();
+    void stitchSubtrees(const GenerationOutput& crown, const std::vector<GenerationOutput>& subtrees,
+                        int subtree_generation, std::vector<BranchWorkItem>& twig_roots);
+    int twigStopGeneration() const;
+    void buildTwigLibrary();
+    void placeTwigs(const std::vector<BranchWorkItem>& twig_roots);
+    TwigInstance makeTwig(const BranchWorkItem& root) const;
+    void groupTwigs();
+    void scheduleTwig(TwigInstance& twig) const;
+    void applyBudget();
+    void recountGenerationOffsets();
+    int allocateBranchSlot(int segments);
+    int allocateLeafSlot();
+    void blankBranchSlot(int slot);
+    void blankLeafSlot(int slot);
+    void blankSubtree(int branch_index, std::vector<unsigned char>& removed, std::vector<int>& leaf_old_to_new,
+                      std::vector<TreeLeaf>& kept_leaves, std::vector<int>& kept_leaf_slot);
+    void keepTwigs(int branch_index, const std::vector<unsigned char>& removed, const std::vector<int>& old_to_new);
+    void finishSubtreeEdit(const std::vector<int>& old_to_new, std::vector<int>& added_branches,
+                           const std::vector<int>& leaf_old_to_new, std::vector<int>& added_leaves);
+    void rewindGrowth(float time, bool relayout);
+    void buildChildAdjacency();
+    void buildLeafRanges();
+    void buildGrowthSchedule();
+    void resetStats();
+    void recountGrowthStats();
+    void queueGrowthMilestones(size_t prev_branch_pending);
+    void resetActiveSets();
+    void advanceGrowthTo(float time);
+    // The emptied avoidance grid when branch avoidance is on, else null
+    BranchGrid* avoidanceGrid();
+    // A version number no tree has had before
+    static uint64_t nextVersion();
+    // Append edit to the log with the element counts it left
+    void logEdit(TreeEdit edit);
+    bool updateGrowthAoS();
+    bool updateGrowthSoA();
+    void assignMeshSlots();
+    void buildBranchFrames();
+    int ringSegmentsFor(int branch_index) const;
+    void chooseCurveSections();
+    void buildBranchFrame(int branch_index);
+    void buildBranchIndices();
     void updateBranchMesh();
     void updateLeafMesh();
-    void addBranchSegment(glm::vec3 start, glm::vec3 end, float start_radius, float end_radius);
-    void addLeafQuad(glm::vec3 position, glm::vec3 normal, float size, float growth);
+    void buildStaticMesh();
+    int branchRingVertices(int branch_index) const { return branch_segments[branch_index] + 1; }
+    int branchSlotVertices(int branch_index) const;
+    int branchSlotIndices(int branch_index) const {
+        return 6 * branch_segments[branch_index] * branch_sections[branch_index];
+    }
+    int branchEndRingVertex(int branch_index) const;
+    // Mesh builders write a whole slot (branchSlotVertices / leaf_slot_vertices
+    // vertices) through out and return the cursor past it
+    float* addBranchSegment(float* out, int branch_index, glm::vec3 start, glm::vec3 end);
+    float* addLeafQuad(float* out, glm::vec3 position, glm::vec3 normal, float size, float growth,
+                       float occlusion = 1.0f);
+    // Rebake branch_occlusion and leaf_occlusion for the current layout
+    void bakeOcclusion();
 
 public:
+    // Vertex layout: vec4 position, vec2 texcoord, vec3 normal
+    static const int VERTEX_FLOATS = 9;
+    // Branch rings have segments + 1 vertices (a seam copy for the texture
+    // wrap); a slot holds a start and an end ring (one if welded) and
+    // 6 * segments indices. The fixed 8-sided sizes below are used by
+    // instanced branches, where every branch shares one unit cylinder
+    static const int MIN_RING_SEGMENTS = 3;
+    static const int MAX_RING_SEGMENTS = 16;
+    // A curved branch's slot holds a ring per section end instead, and 6 *
+    // segments indices per section
+    static const int MAX_CURVE_SECTIONS = 8;
+    static const int BRANCH_RING_VERTICES = 9;
+    static const int BRANCH_SLOT_VERTICES = 2 * BRANCH_RING_VERTICES;
+    static const int BRANCH_SLOT_INDICES = 48;
+    static const int LEAF_SLOT_VERTICES = 12;   // Front and back quad
+    static const int LEAF_SINGLE_SLOT_VERTICES = 4; // One indexed quad
+    static const int LEAF_SINGLE_SLOT_INDICES = 6;
+    // GPU-animated layout: the 9 floats above plus vec4 growthRef, vec3 cornerDir
+    static const int GPU_VERTEX_FLOATS = 16;
+    // Branch growth table: (direction, start_time), (start, duration), (parent, generation, radius, 0)
+    static const int GPU_BRANCH_TEXELS = 3;
+    
+    // Unit circle of a branch ring: segments + 1 (cos, sin) pairs, the last
+    // repeating the first at 2*pi; one table per supported segment count,
+    // computed once per process
+    static const glm::vec2* ringUnitCircle(int segments);
+    // The same table as separate cosine and sine lanes (evaluateRingLanes)
+    static const RingCircleLanes& ringUnitCircleLanes(int segments);
+    
     Tree();
     ~Tree();
     
-    void generate();
+    void generate();                // Generate with a fresh random seed
+    void generate(uint64_t seed);   // Deterministic generation from a given seed
+    // Branches, leaves, adjacency and growth schedule only - no meshes, slots
+    // or growth state. For batch consumers such as ForestBuilder that only
+    // read getBranches() / getLeaves(); call generate() for a drawable tree
+    void generateStructure(uint64_t seed);
     void updateGrowth(float delta_time);
+    // Jump to growth time t directly, forward or back: the state is the one
+    // updateGrowth would reach at t, computed from the schedule in one O(N)
+    // pass instead of replaying frames
+    void setGrowthTime(float time);
+    
+    // Replace the descendants and leaves of one branch of a generated tree
+    // with a subtree grown from seed by the built-in rules; the branch itself
+    // stays. The new elements grow in from from_time, the current time when
+    // negative (a regrowth made on a copy passes the original's). Work and mesh
+    // rewrites scale with the subtree: its slots are recycled through free
+    // lists and only they are marked dirty. Element indices after the
+    // branch shift; the layout order is kept. Returns false for an invalid
+    // index or a tree generate() hasn't built
+    bool regenerateSubtree(int branch_index, uint64_t seed, float from_time = -1.0f);
+    // Cut one branch off a generated tree with its descendants, their leaves
+    // and twigs. The elements leave the arrays at once, the rest keeping
+    // their order (remap, when given, gets the renames), but their slots
+    // stay in the buffers as blanked tombstones on the free lists: only
+    // they are marked dirty, until a regrown limb reuses them or
+    // compactSlots() packs the mesh. Returns false for an invalid index, a
+    // trunk or a tree generate() hasn't built
+    bool pruneBranch(int branch_index, TreeRemap* remap = nullptr);
+    // Lay the slots out again in start order without the freed ones and
+    // rewrite the started elements into them, for an idle moment after
+    // pruning or regrowing. The dynamic buffers need a full upload
+    // (takeLayoutChanged). False when the slots were already in order or
+    // the tree is GPU-animated
+    bool compactSlots();
+    
+    // Edit log: every pruneBranch, regenerateSubtree and setParameters since
+    // generate() or load(), numbered on from 0, for copies of the tree kept
+    // in step by deltas (tree_delta.h). The log holds the edits from
+    // getFirstEditSequence() up to getEditSequence(), the next edit's number
+    uint32_t getEditSequence() const { return first_edit_sequence + (uint32_t)edits.size(); }
+    uint32_t getFirstEditSequence() const { return first_edit_sequence; }
+    const std::vector<TreeEdit>& getEdits() const { return edits; }
+    // Drop the edits before sequence, once every copy has them
+    void trimEdits(uint32_t sequence);
+    // Empty the log and number the next edit sequence: for a copy load()ed
+    // from a snapshot saved once the original was there
+    void restartEdits(uint32_t sequence);
+    
+    // Milestones passed since the previous call, in update order and within
+    // one update as started generations, completed generations, then the
+    // tree; calling clears them. Each fires once per pass: a rewind or a
+    // regrown limb re-arms those no longer reached, which fire again when
+    // growth gets there
+    void takeGrowthEvents(std::vector<GrowthEvent>& out) {
+        out.assign(growth_events.begin(), growth_events.end());
+        growth_events.clear();
+    }
+    
+    // True once after regenerateSubtree, pruneBranch or compactSlots changed
+    // what is uploaded with a new tree (index buffers, GPU meshes, twig
+    // instances)
+    bool takeLayoutChanged() {
+        bool changed = layout_changed;
+        layout_changed = false;
+        return changed;
+    }
+    
+    // Change counters for readers that keep copies (tree_snapshot.h): the
+    // layout version moves whenever the elements, their slots, the index
+    // buffers or the twigs change, the mesh version whenever a vertex or
+    // instance array is written. Versions are unique across trees, so an
+    // equal version means equal contents
+    uint64_t getLayoutVersion() const { return layout_version; }
+    uint64_t getMeshVersion() const { return mesh_version; }
     
-    // Getters for rendering
+    // Binary asset files (tree_asset.h). save() writes the structure and,
+    // unless include_mesh is false, the prebuilt index and GPU mesh buffers.
+    // load() replaces the tree with a saved one, ready to grow from time 0
+    // as after generate(); this tree's mesh settings apply, and the saved
+    // buffers are reused when they were built for the same ones. Both return
+    // false with the reason in error; a failed load leaves the tree as it was.
+    // encode_mesh stores the index buffers and GPU meshes encoded
+    // (mesh_codec.h), the vertices quantized to well under a millimetre
+    bool save(const std::string& path, std::string& error, bool include_mesh = true, bool encode_mesh = false) const;
+    // The file's bytes to out instead (a socket, a string)
+    bool save(std::ostream& out, std::string& error, bool include_mesh = true, bool encode_mesh = false) const;
+    bool load(const std::string& path, std::string& error);
+    // From a file's bytes in memory
+    bool load(const void* bytes, size_t byte_count, std::string& error);
+    
+    // Getters for rendering. The arrays hold a slot for every element; only
+    // the first get*VertexCount() vertices (the started elements) are drawn
     const std::vector<float>& getBranchVertices() const { return branch_vertices; }
     const std::vector<float>& getLeafVertices() const { return leaf_vertices; }
     
-    int getBranchVertexCount() const { return branch_vertices.size() / 9; }
-    int getLeafVertexCount() const { return leaf_vertices.size() / 9; }
+    int getBranchVertexCount() const {
+        return branch_vertex_offset.empty() ? 0 : branch_vertex_offset[drawnBranchSlots()];
+    }
+    
+    // Branches are indexed: draw getBranchIndexCount() indices with glDrawElements.
+    // The index array never changes after generate() and is shared by both
+    // animation modes
+    const std::vector<uint32_t>& getBranchIndices() const { return branch_indices; }
+    int getBranchIndexCount() const {
+        return branch_index_offset.empty() ? 0 : branch_index_offset[drawnBranchSlots()];
+    }
+    int getLeafVertexCount() const { return drawnLeafSlots() * leaf_slot_vertices; }
+    
+    // Instanced branches - the first getBranchInstanceCount() records are drawn
+    // as copies of the single-branch triangles in getBranchIndices()
+    const std::vector<BranchInstance>& getBranchInstances() const { return branch_instances; }
+    int getBranchInstanceCount() const { return branch_instances.empty() ? 0 : drawnBranchSlots(); }
+    
+    // Instanced leaves - the first getLeafInstanceCount() records are drawn
+    const std::vector<LeafInstance>& getLeafInstances() const { return leaf_instances; }
+    int getLeafInstanceCount() const { return leaf_instances.empty() ? 0 : drawnLeafSlots(); }
+    
+    // Single-sided leaves are indexed the same way; the array is empty for
+    // double-sided leaves, which are drawn with glDrawArrays
+    const std::vector<uint32_t>& getLeafIndices() const { return leaf_indices; }
+    int getLeafIndexCount() const {
+        return leaf_indices.empty() ? 0 : drawnLeafSlots() * LEAF_SINGLE_SLOT_INDICES;
+    }
+    
+    // Mesh slot of an element. Branch slot s holds indices
+    // [getBranchIndexOffsets()[s], getBranchIndexOffsets()[s + 1]); leaf
+    // slot s holds getLeafSlotVertices() vertices, or
+    // LEAF_SINGLE_SLOT_INDICES indices for single-sided leaves, from s times that
+    int getBranchSlot(int branch_index) const { return branch_slot[branch_index]; }
+    int getLeafSlot(int leaf_index) const { return leaf_slot[leaf_index]; }
+    const std::vector<int>& getBranchIndexOffsets() const { return branch_index_offset; }
+    int getLeafSlotVertices() const { return leaf_slot_vertices; }
+    
+    // Slots to draw: the started prefix, or all of them after regenerateSubtree
+    // or pruneBranch
+    int drawnBranchSlots() const {
+        return slots_in_start_order ? branch_activity.next_pending : branch_index_offset.size() - 1;
+    }
+    int drawnLeafSlots() const { return slots_in_start_order ? leaf_activity.next_pending : leaf_slot_count; }
+    
+    // Byte ranges rewritten since the previous call, merged and sorted, for
+    // glBufferSubData; calling clears them
+    void takeBranchDirtyRanges(std::vector<MeshDirtyRange>& out);
+    void takeLeafDirtyRanges(std::vector<MeshDirtyRange>& out);
+    
+    // GPU animation - meshes and table are built by generate() in Gpu mode
+    void setMeshAnimation(MeshAnimation mode) { mesh_animation = mode; }
+    MeshAnimation getMeshAnimation() const { return mesh_animation; }
+    const std::vector<float>& getStaticBranchVertices() const { return static_branch_vertices; }
+    const std::vector<float>& getStaticLeafVertices() const { return static_leaf_vertices; }
+    const std::vector<float>& getBranchGrowthData() const { return branch_growth_data; }
+    float getGrowthTime() const { return current_growth_time; }
     
     // Tree information
     int getBranchCount() const { return branches.size(); }
     int getLeafCount() const { return leaves.size(); }
-    float getGrowthProgress() const { return current_growth_time / max_growth_time; }
+    const std::vector<TreeBranch>& getBranches() const { return branches; }
+    const std::vector<TreeLeaf>& getLeaves() const { return leaves; }
+    // Children of a branch: child_count entries starting at the returned pointer
+    const int* getChildren(int branch_index) const { return child_indices.data() + branches[branch_index].first_child; }
+    const std::vector<int>& getChildIndices() const { return child_indices; }
+    const std::vector<TreeLeafRange>& getLeafRanges() const { return leaf_ranges; }
+    float getGrowthProgress() const { return std::min(1.0f, current_growth_time / schedule_end_time); }
+    float getScheduleEnd() const { return schedule_end_time; } // Growth time when the last element is grown
+    uint64_t getSeed() const { return seed; }
+    // Statistics - cheap to query at any time, no tree scan involved
+    const TreeStats& getStats() const { return stats; }
+    void printStats(std::ostream& os) const;
+    // Walks the vectors, not the elements: cheap enough for every frame
+    TreeMemory getMemoryUsage() const;
+    void setVerbosity(int level) { verbosity = level; }
+    
+    // True once every branch and leaf is fully grown; updateGrowth is then a no-op
+    bool isStatic() const {
+        return branch_activity.isStatic() && leaf_activity.isStatic() &&
+               (twig_instances.empty() || current_growth_time >= schedule_end_time);
+    }
+    int getGrowingBranchCount() const { return branch_activity.growing.size(); }
+    int getGrowingLeafCount() const { return leaf_activity.growing.size(); }
+    
+    // Shape control - takes effect on the next generate()
+    void setParameters(const TreeParameters& parameters);
+    TreeParameters getParameters() const;
+    
+    // Layout control - takes effect on the next generate()
+    void setBranchLayout(BranchLayout layout) { branch_layout = layout; }
+    BranchLayout getBranchLayout() const { return branch_layout; }
+    // Branch index range [begin, end) of a generation; false unless breadth-first
+    bool getGenerationRange(int generation, int& begin, int& end) const;
+    // Leaves added later (lazy detail, subtree edits) are appended in
+    // generation order
+    void setLeafLayout(LeafLayout layout) { leaf_layout = layout; }
+    LeafLayout getLeafLayout() const { return leaf_layout; }
+    
+    // Meshing control - takes effect on the next generate()
+    void setBranchMeshing(BranchMeshing meshing) { branch_meshing = meshing; }
+    BranchMeshing getBranchMeshing() const { return branch_meshing; }
+    // Ring sides: the trunk gets max_segments, thinner branches proportionally
+    // fewer down to min_segments (both clamped to the supported range)
+    void setRingSegmentRange(int min_segments, int max_segments);
+    void getRingSegmentRange(int& min_segments, int& max_segments) const {
+        min_segments = min_ring_segments;
+        max_segments = max_ring_segments;
+    }
+    // Curved mesh branches: slender, leaning branches sag below their chord,
+    // a level one thinner than a thirtieth of its length by curvature times
+    // its length at mid-length and each by its own random share of that,
+    // and are meshed as one tube of up to MAX_CURVE_SECTIONS sections, more
+    // where the bow is large against the radius. The ends stay put, so
+    // children and leaves stay attached. The extra rings stay within
+    // vertex_budget per tree (0 = no limit). Curvature 0 = straight cylinders
+    void setBranchCurvature(float curvature, int vertex_budget);
+    float getBranchCurvature() const { return branch_curvature; }
+    int getCurveVertexBudget() const { return curve_vertex_budget; }
+    void setLeafFaces(LeafFaces faces) { leaf_faces = faces; }
+    LeafFaces getLeafFaces() const { return leaf_faces; }
+    // Instancing applies to the CPU-animated path; Gpu mode keeps its static
+    // mesh. Instanced branches are always independent cylinders
+    void setBranchRendering(BranchRendering rendering) { branch_rendering = rendering; }
+    BranchRendering getBranchRendering() const { return branch_rendering; }
+    void setLeafRendering(LeafRendering rendering) { leaf_rendering = rendering; }
+    LeafRendering getLeafRendering() const { return leaf_rendering; }
+    
+    // Species control - takes effect on the next generate(). A grammar
+    // (shared, never modified) replaces the built-in branching rules; null
+    // restores them. Grammar trees derive one step per generation unless the
+    // grammar sets its own count, and ignore the generation thread setting
+    void setGrammar(std::shared_ptr<const LSystemGrammar> species) { grammar = species; }
+    std::shared_ptr<const LSystemGrammar> getGrammar() const { return grammar; }
+    
+    // Algorithm control - takes effect on the next generate(). Space
+    // colonization uses the generation threads for its attractor queries
+    void setGenerator(TreeGenerator algorithm) { generator = algorithm; }
+    TreeGenerator getGenerator() const { return generator; }
+    void setSpaceColonizationParameters(const SpaceColonizationParameters& parameters) {
+        colonization_parameters = parameters;
+    }
+    const SpaceColonizationParameters& getSpaceColonizationParameters() const { return colonization_parameters; }
+    
+    // Threaded generation - takes effect on the next generate(). With threads
+    // >= 1 every subtree rooted at generation 2 draws from its own stream
+    // derived from (seed, branch path), so a seed gives the same tree for any
+    // thread count (but a different one than the serial generator, threads = 0)
+    void setGenerationThreads(int threads) { generation_threads = std::max(0, threads); }
+    int getGenerationThreads() const { return generation_threads; }
+    
+    // Overlap avoidance for the built-in branching rules: each child's
+    // capsule (its segment and radius) is tested against the branches
+    // already placed through a BranchGrid and drawn again while it passes
+    // through one, up to AVOIDANCE_ATTEMPTS draws in all, then dropped.
+    // The first quarter of a child is not tested, where it leaves the
+    // fork with its siblings. Split subtrees avoid the crown and themselves
+    // but not each other, so a seed still grows the same tree for any
+    // thread count; lazy detail and edited subtrees grow without it. Takes
+    // effect on the next generate(); off by default
+    static const int AVOIDANCE_ATTEMPTS = 4;
+    void setBranchAvoidance(bool enabled) { branch_avoidance = enabled; }
+    bool getBranchAvoidance() const { return branch_avoidance; }
+    // Child draws the last generate() rejected for overlapping, and the
+    // children it dropped after the last attempt
+    int getAvoidanceRedrawn() const { return avoidance_redrawn; }
+    int getAvoidanceDropped() const { return avoidance_dropped; }
+    
+    // Threads for updateGrowth / setGrowthTime (0 or 1 = the calling thread).
+    // The result is identical for any count; only CPU mesh animation has
+    // enough per-frame work to gain from it
+    void setUpdateThreads(int threads);
+    int getUpdateThreads() const { return update_threads; }
+    
+    // Twig instancing for the built-in branching rules: every branch of
+    // generation depth and below comes from one of prototype_count shared
+    // twigs, placed by a rotation about the attachment point. depth 0 turns
+    // it off; depths above max_generations have no effect
+    void setTwigInstancing(int depth, int prototype_count);
+    int getTwigDepth() const { return twig_depth; }
+    int getTwigPrototypeCount() const { return twig_prototype_count; }
+    std::shared_ptr<const TwigLibrary> getTwigLibrary() const { return twig_library; }
+    const std::vector<TwigInstance>& getTwigInstances() const { return twig_instances; }
+    const std::vector<int>& getTwigOffsets() const { return twig_offsets; }
+    
+    // Ambient occlusion of the finished tree, baked whenever its layout is
+    // built or edited by baker(tree, branch, leaf): two values in [0, 1]
+    // per branch (near its base and tip) and one per leaf, 1 open. They go
+    // into the position w of the branch and leaf vertices (1 without a
+    // bake) for the shaders' ambient term; leaf and branch instances and
+    // packed vertices carry none. Render code passes bakeTreeOcclusion
+    // (tree_occlusion.h), which casts rays through a TreeBvh this library
+    // doesn't link. Null = no bake. Takes effect on the next generate().
+    // settings tells bakes apart (bakeTreeOcclusion's ray count): equal
+    // settings must bake the same, as they share saved meshes and TreeCache
+    // entries. 0 with a null baker
+    typedef std::function<void(const Tree&, std::vector<float>&, std::vector<float>&)> OcclusionBaker;
+    void setOcclusionBaker(const OcclusionBaker& baker, uint32_t settings) {
+        occlusion_baker = baker;
+        occlusion_settings = baker ? settings : 0;
+    }
+    uint32_t getOcclusionSettings() const { return occlusion_settings; }
+    // Branch i's at share t of the way from base to tip, leaf j's
+    float getBranchOcclusion(int branch_index, float t) const {
+        if (2 * branch_index + 1 >= (int)branch_occlusion.size()) return 1.0f;
+        return branch_occlusion[2 * branch_index] +
+               (branch_occlusion[2 * branch_index + 1] - branch_occlusion[2 * branch_index]) * t;
+    }
+    float getLeafOcclusion(int leaf_index) const {
+        return leaf_index < (int)leaf_occlusion.size() ? leaf_occlusion[leaf_index] : 1.0f;
+    }
+    
+    // Lazy, view-dependent detail for the built-in branching rules:
+    // generations from coarse_generation on exist only while the tree's
+    // bounding sphere spans at least expand_size of the viewport height, and
+    // are dropped again below collapse_size (the gap keeps the tree from
+    // flickering at the threshold). Takes effect on the next generate();
+    // coarse_generation 0 turns it off
+    void setLazyDetail(int coarse_generation, float expand_size = 0.25f, float collapse_size = 0.15f);
+    int getDetailGeneration() const { return detail_generation; }
+    bool isDetailExpanded() const { return detail_expanded; }
+    // Fraction of the viewport height the tree's bounds span from eye (in
+    // the tree's frame) under a vertical field of view of fov_y radians
+    float getProjectedSize(const glm::vec3& eye, float fov_y) const;
+    // Expand or collapse for the current view. Returns true when the tree
+    // was rebuilt: every element keeps its schedule, the growth state is
+    // caught up to the current time, and all buffers must be re-uploaded
+    bool updateDetail(const glm::vec3& eye, float fov_y);
+    bool setDetailExpanded(bool expanded);
+    
+    // Generation budget: whatever the parameters, generate() keeps at most
+    // this many branches, leaves and mesh vertices (twigs count what they stand for)
+    void setBudget(const TreeBudget& limits) { budget = limits; }
+    const TreeBudget& getBudget() const { return budget; }
+    const TreeBudgetReport& getBudgetReport() const { return budget_report; }
+    
+    // Storage control - takes effect on the next generate()
+    void setStorageMode(TreeStorageMode mode) { storage_mode = mode; }
+    TreeStorageMode getStorageMode() const { return storage_mode; }
+    
+    // Current growth of an element, wherever the active storage mode keeps it
+    float branchProgress(int branch_index) const {
+        return storage_mode == TreeStorageMode::StructureOfArrays ? soa.branch_progress[branch_index]
+                                                                  : branches[branch_index].growth_progress;
+    }
+    float leafProgress(int leaf_index) const {
+        return storage_mode == TreeStorageMode::StructureOfArrays ? soa.leaf_progress[leaf_index]
+                                                                  : leaves[leaf_index].growth_progress;
+    }
 };
 
 #endif // TREE_H
@@ -0,0 +1,147 @@
+#include "tree_snapshot.h"
+#include <algorithm>
+#include <atomic>
+#include "profiler.h"
+
+// Unheld versions kept for reuse beyond the ones a publish needs
+static const size_t SPARE_VERSIONS = 1;
+
+// An entry of pool only the pool holds, to overwrite, or a new one. No
+// reader can take a new reference to it: readers reach versions only
+// through the latest snapshot and the ones they already hold
+template <typename T>
+static std::shared_ptr<T> reuseVersion(std::vector<std::shared_ptr<T>>& pool) {
+    for (const std::shared_ptr<T>& entry : pool) {
+        if (entry.use_count() == 1) {
+            // Pairs with the release of the last reader's reference: its
+            // reads are done before the entry is written
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return entry;
+        }
+    }
+    pool.push_back(std::make_shared<T>());
+    return pool.back();
+}
+
+// Drop the unheld entries of pool beyond the spares
+template <typename T>
+static void trimVersions(std::vector<std::shared_ptr<T>>& pool) {
+    size_t spare = 0;
+    for (size_t i = 0; i < pool.size(); ) {
+        if (pool[i].use_count() == 1 && ++spare > SPARE_VERSIONS) {
+            pool.erase(pool.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+// The pool's entry for version, if it has one
+template <typename T>
+static std::shared_ptr<T> findVersion(const std::vector<std::shared_ptr<T>>& pool, uint64_t version) {
+    for (const std::shared_ptr<T>& entry : pool) {
+        if (entry->version == version) return entry;
+    }
+    return nullptr;
+}
+
+// The first count elements of from, assigned into to's storage
+template <typename T>
+static void copyPrefix(const std::vector<T>& from, size_t count, std::vector<T>& to) {
+    to.assign(from.begin(), from.begin() + std::min(count, from.size()));
+}
+
+TreeSnapshots::TreeSnapshots() : published(0) {}
+
+void TreeSnapshots::publish(const Tree& tree, bool include_mesh) {
+    PROFILE_SCOPE("TreeSnapshots::publish");
+    // Versions no reader holds let go of their parts, so those can be
+    // reused too
+    for (const std::shared_ptr<TreeSnapshot>& entry : snapshots) {
+        if (entry.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            entry->layout.reset();
+            entry->mesh.reset();
+        }
+    }
+    
+    // === LAYOUT: SHARED WITH THE PREVIOUS VERSION UNLESS IT MOVED ===
+    std::shared_ptr<TreeSnapshotLayout> layout = findVersion(layouts, tree.getLayoutVersion());
+    if (!layout) {
+        layout = reuseVersion(layouts);
+        layout->version = tree.getLayoutVersion();
+        layout->branches = tree.getBranches();
+        layout->leaves = tree.getLeaves();
+        layout->child_indices = tree.getChildIndices();
+        layout->twig_instances = tree.getTwigInstances();
+        layout->twig_library = tree.getTwigLibrary();
+        layout->branch_indices = tree.getBranchIndices();
+        layout->leaf_indices = tree.getLeafIndices();
+    }
+    
+    // === MESH: THE SAME, AND THE DRAWN PREFIX ONLY ===
+    std::shared_ptr<TreeSnapshotMesh> mesh;
+    if (include_mesh) {
+        mesh = findVersion(meshes, tree.getMeshVersion());
+        if (!mesh) {
+            mesh = reuseVersion(meshes);
+            mesh->version = tree.getMeshVersion();
+            copyPrefix(tree.getBranchVertices(), (size_t)tree.getBranchVertexCount() * Tree::VERTEX_FLOATS,
+                       mesh->branch_vertices);
+            copyPrefix(tree.getLeafVertices(), (size_t)tree.getLeafVertexCount() * Tree::VERTEX_FLOATS,
+                       mesh->leaf_vertices);
+            copyPrefix(tree.getBranchInstances(), tree.getBranchInstanceCount(), mesh->branch_instances);
+            copyPrefix(tree.getLeafInstances(), tree.getLeafInstanceCount(), mesh->leaf_instances);
+            mesh->static_branch_vertices = tree.getStaticBranchVertices();
+            mesh->static_leaf_vertices = tree.getStaticLeafVertices();
+            mesh->branch_growth_data = tree.getBranchGrowthData();
+        }
+    }
+    
+    // === PER-UPDATE STATE ===
+    std::shared_ptr<TreeSnapshot> snapshot = reuseVersion(snapshots);
+    snapshot->version = ++published;
+    snapshot->seed = tree.getSeed();
+    snapshot->growth_time = tree.getGrowthTime();
+    snapshot->growth_progress = tree.getGrowthProgress();
+    snapshot->grown = tree.isStatic();
+    snapshot->stats = tree.getStats();
+    snapshot->branch_vertex_count = tree.getBranchVertexCount();
+    snapshot->branch_index_count = tree.getBranchIndexCount();
+    snapshot->leaf_vertex_count = tree.getLeafVertexCount();
+    snapshot->leaf_index_count = tree.getLeafIndexCount();
+    snapshot->branch_instance_count = tree.getBranchInstanceCount();
+    snapshot->leaf_instance_count = tree.getLeafInstanceCount();
+    snapshot->branch_progress.resize(tree.getBranchCount());
+    for (int i = 0; i < tree.getBranchCount(); i++) {
+        snapshot->branch_progress[i] = tree.branchProgress(i);
+    }
+    snapshot->leaf_progress.resize(tree.getLeafCount());
+    for (int i = 0; i < tree.getLeafCount(); i++) {
+        snapshot->leaf_progress[i] = tree.leafProgress(i);
+    }
+    snapshot->layout = layout;
+    snapshot->mesh = mesh;
+    
+    // === PUBLISH ===
+    // Readers see the new version whole: it is written before the store
+    std::atomic_store(&latest, std::shared_ptr<const TreeSnapshot>(snapshot));
+    snapshot.reset();
+    layout.reset();
+    mesh.reset();
+    trimVersions(snapshots);
+    trimVersions(layouts);
+    trimVersions(meshes);
+}
+
+std::shared_ptr<const TreeSnapshot> TreeSnapshots::acquire() const {
+    return std::atomic_load(&latest);
+}
+
+void TreeSnapshots::clear() {
+    std::atomic_store(&latest, std::shared_ptr<const TreeSnapshot>());
+    // Held versions stay alive through their readers' references
+    snapshots.clear();
+    layouts.clear();
+    meshes.clear();
+}
@@ -0,0 +1,100 @@
+#ifndef TREE_SNAPSHOT_H
+#define TREE_SNAPSHOT_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "tree_simple.h"
+
+// Immutable versions of a tree's state for readers on other threads
+// (culling, picking, export) while the owner keeps updating the tree.
+// The thread that updates the tree publishes a snapshot between updates;
+// readers acquire the latest one without waiting for the update and keep
+// it, unchanged, for as long as they hold the reference. A version is
+// reclaimed when its last reader lets go, or kept for reuse by a later
+// publish so a steady stream of updates allocates nothing.
+//
+// The parts that change rarely are shared between versions: a snapshot's
+// layout (elements, index buffers, twigs) is copied only when the tree's
+// layout version moves, its mesh only when the mesh version does. What
+// changes every update, the time and each element's growth, is copied
+// every time, a float per element.
+
+// The elements and index buffers as of one layout version. The growth
+// progress inside the elements is not kept up to date: the snapshot's own
+// arrays hold it
+struct TreeSnapshotLayout {
+    uint64_t version; // Tree::getLayoutVersion()
+    std::vector<TreeBranch> branches;
+    std::vector<TreeLeaf> leaves;
+    std::vector<int> child_indices;
+    std::vector<TwigInstance> twig_instances;
+    std::shared_ptr<const TwigLibrary> twig_library;
+    std::vector<uint32_t> branch_indices;
+    std::vector<uint32_t> leaf_indices;
+};
+
+// The vertex and instance arrays as of one mesh version, each the drawn
+// prefix only (the GPU-animated arrays whole, like the tree's)
+struct TreeSnapshotMesh {
+    uint64_t version; // Tree::getMeshVersion()
+    std::vector<float> branch_vertices;
+    std::vector<float> leaf_vertices;
+    std::vector<BranchInstance> branch_instances;
+    std::vector<LeafInstance> leaf_instances;
+    std::vector<float> static_branch_vertices;
+    std::vector<float> static_leaf_vertices;
+    std::vector<float> branch_growth_data;
+};
+
+struct TreeSnapshot {
+    uint64_t version; // Publish count of the TreeSnapshots it came from
+    uint64_t seed;
+    float growth_time;
+    float growth_progress;
+    bool grown; // Tree::isStatic()
+    TreeStats stats;
+    // Tree::get*Count() at the time: what to draw of the mesh
+    int branch_vertex_count;
+    int branch_index_count;
+    int leaf_vertex_count;
+    int leaf_index_count;
+    int branch_instance_count;
+    int leaf_instance_count;
+    // Tree::branchProgress() / leafProgress() of every element
+    std::vector<float> branch_progress;
+    std::vector<float> leaf_progress;
+    std::shared_ptr<const TreeSnapshotLayout> layout;
+    std::shared_ptr<const TreeSnapshotMesh> mesh; // Null when published without
+};
+
+class TreeSnapshots {
+private:
+    std::shared_ptr<const TreeSnapshot> latest; // Shared with readers through atomic_load / atomic_store
+    uint64_t published;
+    // Every version published and still held, by readers or only here; one
+    // held only here is free to be overwritten
+    std::vector<std::shared_ptr<TreeSnapshot>> snapshots;
+    std::vector<std::shared_ptr<TreeSnapshotLayout>> layouts;
+    std::vector<std::shared_ptr<TreeSnapshotMesh>> meshes;
+    
+    TreeSnapshots(const TreeSnapshots&);
+    TreeSnapshots& operator=(const TreeSnapshots&);
+
+public:
+    TreeSnapshots();
+    
+    // The updating thread, between updates: copy what changed of tree into
+    // a new version and make it the latest. include_mesh false leaves the
+    // vertex and instance arrays out, for readers of the structure alone
+    void publish(const Tree& tree, bool include_mesh = true);
+    // Any thread: the latest version, or null before the first publish. It
+    // never changes while held
+    std::shared_ptr<const TreeSnapshot> acquire() const;
+    // Drop the latest version and the spare ones; readers keep theirs
+    void clear();
+    
+    uint64_t getPublishedCount() const { return published; }
+};
+
+#endif // TREE_SNAPSHOT_H
@@ -0,0 +1,238 @@
+#include "tree_storage.h"
+#include "tree_simple.h"
+#include <algorithm>
+#include <cfloat>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TREE_STORAGE_SSE
+#endif
+
+void TreeStorageSoA::assign(const std::vector<TreeBranch>& branches, const std::vector<TreeLeaf>& leaves) {
+    // === SCATTER BRANCH FIELDS ===
+    size_t branch_count = branches.size();
+    branch_start.resize(branch_count);
+    branch_end.resize(branch_count);
+    branch_radius.resize(branch_count);
+    branch_generation.resize(branch_count);
+    branch_parent.resize(branch_count);
+    branch_progress.resize(branch_count);
+    branch_start_time.resize(branch_count);
+    branch_duration.resize(branch_count);
+    
+    for (size_t i = 0; i < branch_count; i++) {
+        const TreeBranch& branch = branches[i];
+        branch_start[i] = branch.start;
+        branch_end[i] = branch.end;
+        branch_radius[i] = branch.radius;
+        branch_generation[i] = branch.generation;
+        branch_parent[i] = branch.parent_index;
+        branch_progress[i] = branch.growth_progress;
+        branch_start_time[i] = branch.start_time;
+        branch_duration[i] = branch.growth_duration;
+    }
+    
+    // === SCATTER LEAF FIELDS ===
+    size_t leaf_count = leaves.size();
+    leaf_position.resize(leaf_count);
+    leaf_normal.resize(leaf_count);
+    leaf_size.resize(leaf_count);
+    leaf_progress.resize(leaf_count);
+    leaf_parent.resize(leaf_count);
+    leaf_spawn_delay.resize(leaf_count);
+    leaf_start_time.resize(leaf_count);
+    leaf_duration.resize(leaf_count);
+    
+    for (size_t i = 0; i < leaf_count; i++) {
+        const TreeLeaf& leaf = leaves[i];
+        leaf_position[i] = leaf.position;
+        leaf_normal[i] = leaf.normal;
+        leaf_size[i] = leaf.size;
+        leaf_progress[i] = leaf.growth_progress;
+        leaf_parent[i] = leaf.parent_branch_index;
+        leaf_spawn_delay[i] = leaf.spawn_delay;
+        leaf_start_time[i] = leaf.start_time;
+        leaf_duration[i] = leaf.growth_duration;
+    }
+}
+
+void TreeStorageSoA::clear() {
+    branch_start.clear();
+    branch_end.clear();
+    branch_radius.clear();
+    branch_generation.clear();
+    branch_parent.clear();
+    branch_progress.clear();
+    branch_start_time.clear();
+    branch_duration.clear();
+    
+    leaf_position.clear();
+    leaf_normal.clear();
+    leaf_size.clear();
+    leaf_progress.clear();
+    leaf_parent.clear();
+    leaf_spawn_delay.clear();
+    leaf_start_time.clear();
+    leaf_duration.clear();
+}
+
+void evaluateGrowthLanes(const float* start, const float* duration, float t, int begin, int end, float* progress) {
+    int k = begin;
+    // max(q, 0) and min(q, 1) take the second operand on NaN, as std::max(0, q)
+    // and std::min(1, q) do, so the vector lanes match the scalar tail
+#if defined(__AVX__)
+    const __m256 time8 = _mm256_set1_ps(t);
+    const __m256 zero8 = _mm256_setzero_ps();
+    const __m256 one8 = _mm256_set1_ps(1.0f);
+    for (; k + 8 <= end; k += 8) {
+        __m256 q = _mm256_div_ps(_mm256_sub_ps(time8, _mm256_loadu_ps(start + k)), _mm256_loadu_ps(duration + k));
+        _mm256_storeu_ps(progress + k, _mm256_min_ps(_mm256_max_ps(q, zero8), one8));
+    }
+#elif defined(TREE_STORAGE_SSE)
+    const __m128 time4 = _mm_set1_ps(t);
+    const __m128 zero4 = _mm_setzero_ps();
+    const __m128 one4 = _mm_set1_ps(1.0f);
+    for (; k + 4 <= end; k += 4) {
+        __m128 q = _mm_div_ps(_mm_sub_ps(time4, _mm_loadu_ps(start + k)), _mm_loadu_ps(duration + k));
+        _mm_storeu_ps(progress + k, _mm_min_ps(_mm_max_ps(q, zero4), one4));
+    }
+#endif
+    for (; k < end; k++) {
+        progress[k] = std::min(1.0f, std::max(0.0f, (t - start[k]) / duration[k]));
+    }
+}
+
+// === MESH LANES ===
+// The widest vector the build targets, with the few operations the frame
+// kernels need; each kernel runs whole vectors, then the glm expression it
+// mirrors over the remaining lanes
+#if defined(__AVX__)
+#define TREE_STORAGE_LANES
+typedef __m256 LaneVector;
+static const int LANE_WIDTH = 8;
+static inline LaneVector laneLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void laneStore(float* p, LaneVector a) { _mm256_storeu_ps(p, a); }
+static inline LaneVector laneSet(float a) { return _mm256_set1_ps(a); }
+static inline LaneVector laneAdd(LaneVector a, LaneVector b) { return _mm256_add_ps(a, b); }
+static inline LaneVector laneSub(LaneVector a, LaneVector b) { return _mm256_sub_ps(a, b); }
+static inline LaneVector laneMul(LaneVector a, LaneVector b) { return _mm256_mul_ps(a, b); }
+static inline LaneVector laneDiv(LaneVector a, LaneVector b) { return _mm256_div_ps(a, b); }
+static inline LaneVector laneSqrt(LaneVector a) { return _mm256_sqrt_ps(a); }
+static inline LaneVector laneLess(LaneVector a, LaneVector b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline LaneVector laneSelect(LaneVector mask, LaneVector a, LaneVector b) { return _mm256_blendv_ps(b, a, mask); }
+#elif defined(TREE_STORAGE_SSE)
+#define TREE_STORAGE_LANES
+typedef __m128 LaneVector;
+static const int LANE_WIDTH = 4;
+static inline LaneVector laneLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void laneStore(float* p, LaneVector a) { _mm_storeu_ps(p, a); }
+static inline LaneVector laneSet(float a) { return _mm_set1_ps(a); }
+static inline LaneVector laneAdd(LaneVector a, LaneVector b) { return _mm_add_ps(a, b); }
+static inline LaneVector laneSub(LaneVector a, LaneVector b) { return _mm_sub_ps(a, b); }
+static inline LaneVector laneMul(LaneVector a, LaneVector b) { return _mm_mul_ps(a, b); }
+static inline LaneVector laneDiv(LaneVector a, LaneVector b) { return _mm_div_ps(a, b); }
+static inline LaneVector laneSqrt(LaneVector a) { return _mm_sqrt_ps(a); }
+static inline LaneVector laneLess(LaneVector a, LaneVector b) { return _mm_cmplt_ps(a, b); }
+static inline LaneVector laneSelect(LaneVector mask, LaneVector a, LaneVector b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+#if defined(TREE_STORAGE_LANES)
+// glm::dot of two vectors held a component per vector: (x + y) + z
+static inline LaneVector laneDot(LaneVector ax, LaneVector ay, LaneVector az,
+                                 LaneVector bx, LaneVector by, LaneVector bz) {
+    return laneAdd(laneAdd(laneMul(ax, bx), laneMul(ay, by)), laneMul(az, bz));
+}
+#endif
+
+void evaluateRingLanes(const RingCircleLanes& circle, int count, const glm::vec3& right, const glm::vec3& up,
+                       RingLanes& lanes) {
+    int k = 0;
+#if defined(TREE_STORAGE_LANES)
+    const LaneVector right_x = laneSet(right.x), right_y = laneSet(right.y), right_z = laneSet(right.z);
+    const LaneVector up_x = laneSet(up.x), up_y = laneSet(up.y), up_z = laneSet(up.z);
+    const LaneVector zero = laneSet(0.0f);
+    const LaneVector one = laneSet(1.0f);
+    for (; k + LANE_WIDTH <= count; k += LANE_WIDTH) {
+        LaneVector c = laneLoad(circle.cosine + k);
+        LaneVector s = laneLoad(circle.sine + k);
+        LaneVector x = laneAdd(laneMul(right_x, c), laneMul(up_x, s));
+        LaneVector y = laneAdd(laneMul(right_y, c), laneMul(up_y, s));
+        LaneVector z = laneAdd(laneMul(right_z, c), laneMul(up_z, s));
+        laneStore(lanes.radial_x + k, x);
+        laneStore(lanes.radial_y + k, y);
+        laneStore(lanes.radial_z + k, z);
+        
+        // normalize(radial * (1, 0, 1)): x and z times 1 are themselves
+        LaneVector flat_y = laneMul(y, zero);
+        LaneVector inverse = laneDiv(one, laneSqrt(laneDot(x, flat_y, z, x, flat_y, z)));
+        laneStore(lanes.normal_x + k, laneMul(x, inverse));
+        laneStore(lanes.normal_y + k, laneMul(flat_y, inverse));
+        laneStore(lanes.normal_z + k, laneMul(z, inverse));
+    }
+#endif
+    for (; k < count; k++) {
+        glm::vec3 radial = right * circle.cosine[k] + up * circle.sine[k];
+        glm::vec3 normal = glm::normalize(radial * glm::vec3(1, 0, 1));
+        lanes.radial_x[k] = radial.x;
+        lanes.radial_y[k] = radial.y;
+        lanes.radial_z[k] = radial.z;
+        lanes.normal_x[k] = normal.x;
+        lanes.normal_y[k] = normal.y;
+        lanes.normal_z[k] = normal.z;
+    }
+}
+
+void evaluateLeafFrameLanes(LeafFrameLanes& lanes, int count) {
+    int k = 0;
+#if defined(TREE_STORAGE_LANES)
+    const LaneVector zero = laneSet(0.0f);
+    const LaneVector one = laneSet(1.0f);
+    for (; k + LANE_WIDTH <= count; k += LANE_WIDTH) {
+        LaneVector nx = laneLoad(lanes.normal_x + k);
+        LaneVector ny = laneLoad(lanes.normal_y + k);
+        LaneVector nz = laneLoad(lanes.normal_z + k);
+        
+        // cross(normal, (0, 1, 0)) term for term, as glm::cross forms it
+        LaneVector rx = laneSub(laneMul(ny, zero), laneMul(one, nz));
+        LaneVector ry = laneSub(laneMul(nz, zero), laneMul(zero, nx));
+        LaneVector rz = laneSub(laneMul(nx, one), laneMul(zero, ny));
+        LaneVector length = laneSqrt(laneDot(rx, ry, rz, rx, ry, rz));
+        LaneVector inverse = laneDiv(one, length);
+        LaneVector upright = laneLess(length, laneSet(FLT_MIN));
+        rx = laneSelect(upright, one, laneMul(rx, inverse));
+        ry = laneSelect(upright, zero, laneMul(ry, inverse));
+        rz = laneSelect(upright, zero, laneMul(rz, inverse));
+        
+        // cross(right, normal), normalized
+        LaneVector ux = laneSub(laneMul(ry, nz), laneMul(ny, rz));
+        LaneVector uy = laneSub(laneMul(rz, nx), laneMul(nz, rx));
+        LaneVector uz = laneSub(laneMul(rx, ny), laneMul(nx, ry));
+        inverse = laneDiv(one, laneSqrt(laneDot(ux, uy, uz, ux, uy, uz)));
+        
+        LaneVector half = laneLoad(lanes.half_size + k);
+        laneStore(lanes.right_x + k, laneMul(rx, half));
+        laneStore(lanes.right_y + k, laneMul(ry, half));
+        laneStore(lanes.right_z + k, laneMul(rz, half));
+        laneStore(lanes.up_x + k, laneMul(laneMul(ux, inverse), half));
+        laneStore(lanes.up_y + k, laneMul(laneMul(uy, inverse), half));
+        laneStore(lanes.up_z + k, laneMul(laneMul(uz, inverse), half));
+    }
+#endif
+    for (; k < count; k++) {
+        glm::vec3 normal(lanes.normal_x[k], lanes.normal_y[k], lanes.normal_z[k]);
+        glm::vec3 right = glm::cross(normal, glm::vec3(0, 1, 0));
+        right = (glm::length(right) < FLT_MIN) ? glm::vec3(1, 0, 0) : glm::normalize(right);
+        glm::vec3 up = glm::normalize(glm::cross(right, normal));
+        right *= lanes.half_size[k];
+        up *= lanes.half_size[k];
+        lanes.right_x[k] = right.x;
+        lanes.right_y[k] = right.y;
+        lanes.right_z[k] = right.z;
+        lanes.up_x[k] = up.x;
+        lanes.up_y[k] = up.y;
+        lanes.up_z[k] = up.z;
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef TREE_STORAGE_H
+#define TREE_STORAGE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+struct TreeBranch;
+struct TreeLeaf;
+
+// Storage layout used by Tree for its per-frame growth and mesh passes
+enum class TreeStorageMode {
+    ArrayOfStructs,    // Hot loops walk the TreeBranch / TreeLeaf arrays directly
+    StructureOfArrays  // Hot loops walk the separate field arrays in TreeStorageSoA
+};
+
+// Structure-of-arrays mirror of the tree: one array per field, so a pass that
+// needs only generation, parent and progress streams just those through cache.
+// Geometry and schedule fields are copied once after generation; progress is
+// the only field the growth update writes.
+struct TreeStorageSoA {
+    // === BRANCH FIELDS ===
+    std::vector<glm::vec3> branch_start;
+    std::vector<glm::vec3> branch_end;
+    std::vector<float> branch_radius;
+    std::vector<int> branch_generation;
+    std::vector<int> branch_parent;
+    std::vector<float> branch_progress;
+    std::vector<float> branch_start_time;
+    std::vector<float> branch_duration;
+    
+    // === LEAF FIELDS ===
+    std::vector<glm::vec3> leaf_position;
+    std::vector<glm::vec3> leaf_normal;
+    std::vector<float> leaf_size;
+    std::vector<float> leaf_progress;
+    std::vector<int> leaf_parent;
+    std::vector<float> leaf_spawn_delay;
+    std::vector<float> leaf_start_time;
+    std::vector<float> leaf_duration;
+    
+    void assign(const std::vector<TreeBranch>& branches, const std::vector<TreeLeaf>& leaves);
+    void clear();
+    
+    int branchCount() const { return branch_generation.size(); }
+    int leafCount() const { return leaf_parent.size(); }
+};
+
+// progress[k] = clamp((t - start[k]) / duration[k], 0, 1) for k in [begin, end)
+// over packed schedule lanes, 8 lanes per instruction with AVX and 4 with SSE
+// (whichever the build targets), scalar otherwise. Bit-identical to the
+// scalar expression, NaN included
+void evaluateGrowthLanes(const float* start, const float* duration, float t, int begin, int end, float* progress);
+
+// === MESH LANES ===
+// The frame math of the mesh passes in the same lanes: normalizations and
+// cross products for a run of ring points or a batch of leaves at a time,
+// their results left in field arrays for the vertex writers to read
+
+// Points of the largest ring, its first point repeated at angle 2*pi
+static const int RING_LANE_CAPACITY = 17;
+
+// Unit circle of one ring size: the cosines and sines of its point angles
+struct RingCircleLanes {
+    float cosine[RING_LANE_CAPACITY];
+    float sine[RING_LANE_CAPACITY];
+};
+
+// One branch frame's ring directions, a lane per ring point
+struct RingLanes {
+    float radial_x[RING_LANE_CAPACITY];
+    float radial_y[RING_LANE_CAPACITY];
+    float radial_z[RING_LANE_CAPACITY];
+    float normal_x[RING_LANE_CAPACITY];
+    float normal_y[RING_LANE_CAPACITY];
+    float normal_z[RING_LANE_CAPACITY];
+};
+
+// For the first count points of circle: radial = right * cos + up * sin and
+// the normal normalize(radial * (1, 0, 1)). Matches the glm expressions bit
+// for bit
+void evaluateRingLanes(const RingCircleLanes& circle, int count, const glm::vec3& right, const glm::vec3& up,
+                       RingLanes& lanes);
+
+// Leaves a mesh pass frames per batch
+static const int LEAF_LANES = 8;
+
+// A batch of leaf quads: each leaf's unit normal and half its quad's size
+// in, the right and up vectors across the quad, scaled to that half size, out
+struct LeafFrameLanes {
+    float normal_x[LEAF_LANES];
+    float normal_y[LEAF_LANES];
+    float normal_z[LEAF_LANES];
+    float half_size[LEAF_LANES];
+    float right_x[LEAF_LANES];
+    float right_y[LEAF_LANES];
+    float right_z[LEAF_LANES];
+    float up_x[LEAF_LANES];
+    float up_y[LEAF_LANES];
+    float up_z[LEAF_LANES];
+};
+
+// Frames of the first count leaves: right = normalize(cross(normal, +Y)),
+// or +X for a vertical normal, whose cross product is zero, and
+// up = normalize(cross(right, normal)), both times half_size. Matches the
+// glm expressions bit for bit
+void evaluateLeafFrameLanes(LeafFrameLanes& lanes, int count);
+
+#endif // TREE_STORAGE_H
@@ -0,0 +1,16 @@
+#include "tree_vertex_pack.h"
+#include "tree_simple.h"
+#include <glm/gtc/packing.hpp>
+
+void packTreeVertices(const float* in, size_t count, PackedTreeVertex* out) {
+    for (size_t v = 0; v < count; v++) {
+        // Tree layout: vec4 position, vec2 texcoord, vec3 normal
+        out->position[0] = in[0];
+        out->position[1] = in[1];
+        out->position[2] = in[2];
+        out->normal = glm::packSnorm3x10_1x2(glm::vec4(in[6], in[7], in[8], 0.0f));
+        out->texcoord = glm::packHalf2x16(glm::vec2(in[4], in[5]));
+        in += Tree::VERTEX_FLOATS;
+        out++;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef TREE_VERTEX_PACK_H
+#define TREE_VERTEX_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Compact GPU layout for tree vertices (20 bytes instead of Tree's 36):
+// vec3 position (w comes back as 1 from the attribute default), normal as
+// GL_INT_2_10_10_10_REV and texcoord as two GL_HALF_FLOATs. Half floats keep
+// the tube texture V values above 1 that normalized shorts could not hold.
+struct PackedTreeVertex {
+    float position[3];
+    uint32_t normal;    // Signed normalized 10:10:10:2, x in the low bits
+    uint32_t texcoord;  // Half-float u in the low 16 bits, v in the high 16
+};
+
+static_assert(sizeof(PackedTreeVertex) == 20, "PackedTreeVertex must stay tightly packed");
+
+// Byte offsets of the attributes inside PackedTreeVertex
+static const size_t PACKED_NORMAL_OFFSET = 12;
+static const size_t PACKED_TEXCOORD_OFFSET = 16;
+
+// Convert count vertices of Tree::VERTEX_FLOATS floats each
+void packTreeVertices(const float* in, size_t count, PackedTreeVertex* out);
+
+#endif // TREE_VERTEX_PACK_H
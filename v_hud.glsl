@@ -0,0 +1,19 @@
+#version 330
+
+/*
+ * PERFORMANCE HUD VERTEX SHADER
+ *
+ * The overlay's quads (PerfHud), already in clip space
+ */
+
+layout(location = 0) in vec4 vertex; // (x, y in clip space, u, v in the font atlas)
+layout(location = 1) in vec4 color;
+
+out vec2 atlasCoord;
+out vec4 vertexColor;
+
+void main(void) {
+    atlasCoord = vertex.zw;
+    vertexColor = color;
+    gl_Position = vec4(vertex.xy, 0.0, 1.0);
+}
@@ -0,0 +1,134 @@
+#version 330
+
+/*
+ * OCTAHEDRAL IMPOSTOR VERTEX SHADER
+ *
+ * One camera-facing quad per instance of a baked tree (TreeImpostor). The
+ * three atlas frames around the direction from the tree to the camera, and
+ * their blend weights, are picked here, the same for the quad's four
+ * vertices; the fragment shader reprojects each frame along the view ray
+ */
+
+//Per-frame values shared by every program (frame_uniforms.h)
+// FrameUniforms (frame_uniforms.h) whole, as f_impostor.glsl declares it
+layout(std140) uniform FrameData {
+    mat4 P; // Projection matrix
+    mat4 V; // View matrix
+    float time; // Scene clock in seconds
+    float season;
+    vec4 wind;
+    vec4 windGusts;
+    mat4 eyeProjection[2];
+    vec4 eyeOffset[2];
+    vec4 camera;
+    vec4 leafThinning;
+    vec4 fog;
+    vec4 fogColor;
+};
+
+uniform mat4 MV; // The instances' space to eye space (rigid)
+
+// The baked impostor (TreeImpostor::apply)
+uniform int impostorFrames;  // Frames per atlas side
+uniform vec3 impostorCenter; // Bounding sphere of the baked tree, in its space
+uniform float impostorRadius;
+
+layout(location = 0) in vec4 vertex;            // Quad corner, xy in [-1, 1]
+layout(location = 1) in vec4 instancePlacement; // ImpostorInstance: (position, scale)
+layout(location = 2) in float instanceYaw;      // ImpostorInstance: rotation about +y
+
+out vec3 rayDirection;       // View ray through the vertex, in the tree's space
+flat out vec3 rayOrigin;     // The camera in the tree's space
+flat out vec3 viewAxis;      // From the tree's center toward the camera
+flat out vec3 frameAxis[3];  // Per blended frame: its direction toward the camera,
+flat out vec3 frameRight[3]; // its image axes
+flat out vec3 frameUp[3];
+flat out vec2 frameCell[3];  // and its cell in the atlas
+flat out vec3 frameWeights;
+flat out mat4 treeToEye;     // The tree's space to eye space
+
+// TreeImpostor::octahedronCoordinates and octahedronDirection
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 octahedronCoordinates(vec3 d) {
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    vec2 p = d.xz;
+    if (d.y < 0.0) {
+        p = (1.0 - abs(p.yx)) * signNotZero(p);
+    }
+    return p * 0.5 + 0.5;
+}
+
+vec3 octahedronDirection(vec2 uv) {
+    vec2 p = uv * 2.0 - 1.0;
+    vec3 d = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    if (d.y < 0.0) {
+        d.xz = (1.0 - abs(d.zx)) * signNotZero(d.xz);
+    }
+    return normalize(d);
+}
+
+void main(void) {
+    /*
+     * STEP 1: THE INSTANCE'S FRAME
+     * Rotated about +y, scaled and placed in the draw's space
+     */
+    float scale = instancePlacement.w;
+    float c = cos(instanceYaw);
+    float s = sin(instanceYaw);
+    mat4 treeToModel = mat4(vec4(c * scale, 0.0, -s * scale, 0.0),
+                            vec4(0.0, scale, 0.0, 0.0),
+                            vec4(s * scale, 0.0, c * scale, 0.0),
+                            vec4(instancePlacement.xyz, 1.0));
+    treeToEye = MV * treeToModel;
+    mat4 eyeToTree = inverse(treeToEye);
+    rayOrigin = (eyeToTree * vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+    viewAxis = normalize(rayOrigin - impostorCenter);
+    
+    /*
+     * STEP 2: THE THREE NEAREST FRAMES
+     * Frames sit on the vertices of the atlas grid; the view direction
+     * falls in one triangle of a grid square, and its barycentric
+     * coordinates weight the triangle's frames
+     */
+    float last = float(impostorFrames - 1);
+    vec2 grid = octahedronCoordinates(viewAxis) * last;
+    vec2 base = clamp(floor(grid), vec2(0.0), vec2(last - 1.0));
+    vec2 f = grid - base;
+    vec2 cells[3];
+    if (f.x + f.y < 1.0) {
+        cells[0] = base;
+        cells[1] = base + vec2(1.0, 0.0);
+        cells[2] = base + vec2(0.0, 1.0);
+        frameWeights = vec3(1.0 - f.x - f.y, f.x, f.y);
+    } else {
+        cells[0] = base + vec2(1.0, 1.0);
+        cells[1] = base + vec2(0.0, 1.0);
+        cells[2] = base + vec2(1.0, 0.0);
+        frameWeights = vec3(f.x + f.y - 1.0, 1.0 - f.x, 1.0 - f.y);
+    }
+    for (int k = 0; k < 3; k++) {
+        // The basis TreeImpostor::beginFrame baked with (glm::lookAt)
+        vec3 axis = octahedronDirection(cells[k] / last);
+        vec3 up = abs(axis.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+        vec3 right = normalize(cross(-axis, up));
+        frameAxis[k] = axis;
+        frameRight[k] = right;
+        frameUp[k] = cross(right, -axis);
+        frameCell[k] = cells[k];
+    }
+    
+    /*
+     * STEP 3: THE QUAD
+     * Facing the camera on the near side of the bounding sphere, where a
+     * square of its radius covers the whole sphere from any distance
+     */
+    vec3 centerEye = (treeToEye * vec4(impostorCenter, 1.0)).xyz;
+    float radius = impostorRadius * scale;
+    vec3 frontEye = centerEye - normalize(centerEye) * radius;
+    vec3 cornerEye = frontEye + vec3(vertex.xy * radius, 0.0);
+    rayDirection = (eyeToTree * vec4(cornerEye, 0.0)).xyz;
+    gl_Position = P * vec4(cornerEye, 1.0);
+}
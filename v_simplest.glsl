@@ -11,71 +11,492 @@
  * 3. It's efficient for multiple lights and complex scenes
  */
 
-//Uniform variables (constant for all vertices in a draw call)
-uniform mat4 P; // Projection matrix (3D -> 2D screen projection)
-uniform mat4 V; // View matrix (world space -> eye/camera space)
-uniform mat4 M; // Model matrix (object space -> world space)
-uniform vec3 lightPos; // Primary light position in world space (sun position)
-uniform vec3 torchPos; // Secondary light position in world space (torch position)
-
-//Attributes (input data per vertex)
-in vec4 vertex; // Vertex coordinates in model/object space
-in vec3 normal; // Vertex normal in model/object space  
-in vec2 texcoord; // Texture coordinates (UV mapping)
-
-//Varying variables (output to fragment shader, interpolated across triangle)
-out vec4 l; // Light vector in eye space (vertex -> sun direction)
-out vec4 l2; // Light vector in eye space (vertex -> torch direction)
-out vec4 n; // Normal vector in eye space (surface orientation)
-out vec4 v; // View vector in eye space (vertex -> camera direction)
+//Per-frame values shared by every program: one uniform buffer on binding
+//point FrameUniformBuffer::BINDING, laid out as FrameUniforms (frame_uniforms.h)
+layout(std140) uniform FrameData {
+    mat4 P; // Projection matrix (3D -> 2D screen projection)
+    mat4 V; // View matrix (world space -> eye/camera space)
+    float time; // Scene clock in seconds
+    float season; // Time of year in [0, 1): 0 = early spring, leaves turn from 0.55 and are off by 0.9
+    vec4 wind; // (direction x, direction z, strength, gust share of it)
+    vec4 windGusts; // (gust angular frequency, gust phase per unit downwind, leaf flutter angular frequency, -)
+    mat4 eyeProjection[2]; // Stereo, per eye: V's eye space (between the eyes) -> the eye's clip space
+    vec4 eyeOffset[2]; // Stereo, per eye: its position in V's eye space
+    vec4 camera; // The camera's world position (xyz, -)
+    vec4 leafThinning; // (every leaf out to, thinned fully from, share kept from there, -); share 1 = off
+    vec4 fog; // (view distance, clear out to, density, height falloff); view distance 0 = off
+    vec4 fogColor; // (colour, base height)
+};
+
+#ifdef STEREO
+// GpuMesh::getViewCount() of the draw: 2 draws every instance twice, the
+// left eye's then the right's, each into its half of a side-by-side target;
+// 1 is one view through MVP (the shadow maps)
+uniform int viewCount;
+#endif
+
+//Uniform variables (constant for all vertices in a draw call), multiplied
+//out on the CPU so each output costs one matrix-vector product
+uniform mat4 MV; // Model-view matrix (object space -> eye space)
+uniform mat4 MVP; // Model-view-projection matrix (object space -> clip space)
+uniform mat3 normalMatrix; // Inverse transpose of MV's upper 3x3 (object normals -> eye space)
+
+// GPU growth animation (Tree in MeshAnimation::Gpu mode)
+uniform int growthMode; // 0 = positions are final, 1 = animated branch, 2 = animated leaf, 3 = leaf instance, 4 = branch instance, 5 = twig instance, 6 = falling leaf
+uniform float growthTime; // Tree growth clock in seconds
+uniform samplerBuffer branchData; // Tree::getBranchGrowthData(): 3 texels per branch
+uniform int fallingLeaves; // 1 = leaf instances leave the tree whole at their drop time, for LeafParticles to carry down
+
+//Attributes (input data per vertex), at fixed locations so one VAO fits every
+//shader variant
+layout(location = 0) in vec4 vertex; // Vertex coordinates in model/object space (packed trees send xyz, w defaults to 1)
+layout(location = 1) in vec3 normal; // Vertex normal in model/object space  
+layout(location = 2) in vec2 texcoord; // Texture coordinates (UV mapping)
+layout(location = 3) in vec4 growthRef; // Branch: (branch index, ring's share along it, 0=start/1=end); leaf: (parent branch, start time, duration, size)
+layout(location = 4) in vec3 cornerDir; // Leaf: quad corner offset per unit of leaf size; branch: a curved one's sag at full growth
+layout(location = 5) in vec3 instancePosition; // Leaf instance: animated leaf center
+layout(location = 6) in vec3 instanceNormal;   // Leaf instance: facing direction
+layout(location = 7) in vec2 instanceScale;    // Leaf instance: (full size, growth progress); falling leaf: (size, autumn turn in 64ths + shade)
+layout(location = 8) in vec4 branchStart;      // Branch instance: (animated start, base radius)
+layout(location = 9) in vec4 branchEnd;        // Branch instance: (animated end, growth progress)
+layout(location = 10) in vec4 twigAxisX;       // Twig instance: (rotation column x, start time)
+layout(location = 11) in vec4 twigAxisY;       // Twig instance: (rotation column y, growth duration)
+layout(location = 12) in vec3 twigAxisZ;       // Twig instance: rotation column z
+layout(location = 13) in vec3 twigOrigin;      // Twig instance: attachment point on the parent branch
+#ifdef FOREST
+// Forest instance (ForestInstance in forest_scene.h): placed, scaled and
+// turned about +y after the growth animation, which runs on the scene
+// clock delayed by the instance's offset
+layout(location = 14) in vec4 forestPlacement; // (position, scale)
+layout(location = 15) in vec3 forestParams;    // (yaw, hue shift, growth offset)
+#endif
+#ifdef PROPS
+// Static prop (StaticBatch in static_batch.h): its material, passed on
+layout(location = 14) in vec4 propMaterial; // (layer, mix, ambient, emissive)
+#endif
+#if defined(TERRAIN) || defined(GRASS)
+// The terrain's height map (Terrain::bindHeights)
+uniform sampler2D heightMap; // Samples x samples heights, linearly filtered
+uniform vec4 terrainBounds;  // (smallest x, smallest z, side, samples - 1)
+
+// Height at world (x, z): texel centers sit on the samples
+float terrainHeight(vec2 p) {
+    vec2 uv = (p - terrainBounds.xy) / terrainBounds.z;
+    return texture(heightMap, (uv * terrainBounds.w + 0.5) / (terrainBounds.w + 1.0)).r;
+}
+#endif
+#ifdef TERRAIN
+// Terrain chunk (Terrain in terrain.h): vertex.xy is the grid position in
+// [0, 1], placed on the chunk's square and lifted onto the height map
+layout(location = 14) in vec4 terrainNode; // (corner x, corner z, size, level)
+uniform vec3 terrainEye;       // The eye the chunks were chosen for
+uniform vec2 terrainMorph[12]; // Per level: (distance the morph starts at, distance it completes at)
+uniform float terrainGrid;     // Quads along a chunk's side
+
+// Central differences over one sample spacing, as Terrain::normalAt
+vec3 terrainNormal(vec2 p) {
+    float e = terrainBounds.z / terrainBounds.w;
+    return normalize(vec3(terrainHeight(p - vec2(e, 0.0)) - terrainHeight(p + vec2(e, 0.0)), 2.0 * e,
+                          terrainHeight(p - vec2(0.0, e)) - terrainHeight(p + vec2(0.0, e))));
+}
+#endif
+#ifdef GRASS
+// Grass blade (GrassField in grass_field.h): vertex.xy is the blade's
+// (across, up) in [-0.5, 0.5] x [0, 1]; instance i is blade
+// i % grassBandBlades of chunk grassFirstChunk + i / grassBandBlades
+uniform samplerBuffer grassChunks; // Per chunk: (corner x, corner z, density, chunk number)
+uniform int grassFirstChunk;       // This band's first chunk
+uniform int grassBandBlades;       // Blades drawn per chunk in this band
+uniform int grassBlades;           // Blades per chunk at full density
+uniform float grassChunkSize;
+uniform vec3 grassEye;             // The eye the chunks were chosen for
+uniform vec2 grassDensity;         // (full density out to, none from)
+uniform vec2 grassBladeSize;       // (base width, mean height)
+#endif
+
+#if defined(BRANCH_LINES) || defined(BRANCH_TUBES)
+// A branch line's end or tube patch's control point, half a BranchInstance
+// record: (animated start, base radius) or (animated end, growth), for
+// g_branch_lines.glsl or the tube tessellation shaders to expand
+out vec4 branchPoint;
+#endif
+
+//The depth prepass and the shading pass after it compare depths for
+//equality, so both must compute bit-identical positions
+invariant gl_Position;
+
+//Varying variables (output to fragment shader, interpolated across triangle):
+//four, nine components. The fragment shader derives the normal-based
+//texture coordinates and the light and view vectors from these. The normal
+//is mediump, half precision on drivers that honor it (desktop GL ignores
+//the qualifier); the position and UVs need full precision
+out mediump vec3 n; // Normal vector in eye space (surface orientation)
+out vec3 eyePosition; // Vertex position in eye space; the light and view vectors start here
 out vec2 iTexCoord0; // Primary texture coordinates (standard UV mapping)
-out vec2 iTexCoord1; // Secondary texture coordinates (generated from normals for mixing)
+out float occlusion; // Baked ambient occlusion (Tree::setOcclusionBaker), 1 = open
+#ifdef FOREST
+flat out float hueShift; // The instance's turn of the leaf hue
+#endif
+#ifdef PROPS
+flat out vec4 materialParams; // The prop's material
+#endif
+#ifdef LEAF
+flat out vec2 leafSeason; // (autumn turn in [0, 1], the leaf's own shade of it)
+#endif
+#ifdef STEREO
+flat out vec3 viewOrigin; // The eye's position in eye space, where the view vector points
+#endif
 
+// Growth clock of this vertex: growthTime, or a forest instance's own
+float treeTime;
+
+// Four values in [0, 1) from a seed (PCG hash steps)
+vec4 hashRandom(uint seed) {
+    vec4 result;
+    for (int i = 0; i < 4; i++) {
+        seed = seed * 747796405u + 2891336453u;
+        uint word = ((seed >> ((seed >> 28u) + 4u)) ^ seed) * 277803737u;
+        result[i] = float(((word >> 22u) ^ word) & 0xffffffu) / 16777216.0;
+    }
+    return result;
+}
+
+#ifdef LEAF
+// A leaf through the year, from random values of its own: it buds in
+// spring, turns in autumn and drops a while after, falling from height to
+// the tree's base over a short spell, and stays off through the winter.
+// A carried leaf goes at once, for a falling leaf to take its place.
+// Returns its size factor, 0 off the tree; fall is how far it has dropped
+float seasonalLeaf(vec4 random, float height, bool carried, out float fall) {
+    float budded = 0.04 + 0.08 * random.x;
+    float turnStart = 0.55 + 0.12 * random.y;
+    float dropStart = turnStart + 0.08 + 0.1 * random.z;
+    leafSeason = vec2(smoothstep(turnStart, turnStart + 0.08, season), random.w);
+    float falling = carried ? step(dropStart, season) : clamp((season - dropStart) / 0.03, 0.0, 1.0);
+    fall = falling * falling * max(height, 0.0);
+    return smoothstep(0.0, budded, season) * (falling < 1.0 ? 1.0 : 0.0);
+}
+
+// Distance thinning: between leafThinning.x and .y from the camera the
+// share of leaves kept falls to leafThinning.z, each leaf going when the
+// share drops below its own stable rank (shrinking away over a short
+// spell rather than popping), and the leaves kept grow by the inverse
+// square root of the share, so the canopy covers about the same area.
+// center is the leaf's in the tree's space. Returns its size factor, 0
+// dropped: a zero-size leaf rasterizes nothing
+float thinnedLeaf(uint key, vec3 center) {
+#ifdef IMPOSTOR_BAKE
+    return 1.0; // The atlas has every leaf, whatever the camera
+#else
+    if (leafThinning.z >= 1.0) return 1.0;
+    vec3 world = center;
+#ifdef FOREST
+    float c = cos(forestParams.x);
+    float s = sin(forestParams.x);
+    world = forestPlacement.xyz + mat3(vec3(c, 0.0, -s), vec3(0.0, 1.0, 0.0), vec3(s, 0.0, c)) * (center * forestPlacement.w);
+#endif
+    float far = clamp((length(world - camera.xyz) - leafThinning.x) / max(leafThinning.y - leafThinning.x, 0.001),
+                      0.0, 1.0);
+    float share = mix(1.0, leafThinning.z, far);
+    // Short of 1, so every leaf is whole wherever the share is
+    float rank = hashRandom(key ^ 0x9e3779b9u).x * 0.97;
+    return smoothstep(0.0, 0.03, share - rank) * inversesqrt(share);
+#endif
+}
+#endif
+
+// Growth progress of branch b at treeTime: clamp((t - start) / duration)
+float branchProgress(int b) {
+    vec4 t0 = texelFetch(branchData, b * 3);     // (direction, start time)
+    vec4 t1 = texelFetch(branchData, b * 3 + 1); // (start, duration)
+    return clamp((treeTime - t0.w) / t1.w, 0.0, 1.0);
+}
+
+// Animated end of branch b: the trunk base plus direction * progress of every
+// branch on the path to the trunk (the GPU version of resolveAbsolutePositions)
+vec3 animatedEnd(int b) {
+    vec3 end = vec3(0.0);
+    vec3 base = vec3(0.0);
+    for (int depth = 0; depth < 32 && b >= 0; depth++) {
+        vec4 t0 = texelFetch(branchData, b * 3);
+        vec4 t1 = texelFetch(branchData, b * 3 + 1);
+        vec4 t2 = texelFetch(branchData, b * 3 + 2); // (parent, generation, radius, -)
+        end += t0.xyz * clamp((treeTime - t0.w) / t1.w, 0.0, 1.0);
+        base = t1.xyz;
+        b = int(t2.x);
+    }
+    return base + end;
+}
+
+// Wind strength factor at world (x, z): gusts travel downwind across the
+// scene, so neighbouring trees and blades move together
+float windGust(vec2 p) {
+    float phase = time * windGusts.x - dot(p, wind.xy) * windGusts.y;
+    return 1.0 + wind.w * (0.6 * sin(phase) + 0.4 * sin(phase * 2.3 + 1.7));
+}
+
+// Wind deflection of a point on branch b: each branch on the path to the
+// trunk bends about its start, the more the farther along it the path
+// leaves it and the thinner it is, so a child moves with the point it
+// grows from. The trunk leans downwind with the gusts; the branches also
+// sway across the wind, each at its own phase, faster by generation
+vec3 windSway(vec3 point, int b, vec3 direction, float gust) {
+    vec3 across = vec3(-direction.z, 0.0, direction.x);
+    vec3 offset = vec3(0.0);
+    for (int depth = 0; depth < 32 && b >= 0; depth++) {
+        vec4 t0 = texelFetch(branchData, b * 3);     // (direction, -)
+        vec4 t1 = texelFetch(branchData, b * 3 + 1); // (start, -)
+        vec4 t2 = texelFetch(branchData, b * 3 + 2); // (parent, generation, radius, -)
+        float lengthSquared = max(dot(t0.xyz, t0.xyz), 1e-6);
+        float along = clamp(dot(point - t1.xyz, t0.xyz) / lengthSquared, 0.0, 1.0);
+        float bend = sqrt(lengthSquared) * along * along;
+        vec3 sway = direction * (0.03 * gust);
+        if (t2.y > 0.5) {
+            float phase = float(b) * 2.39996; // Golden angle: neighbours out of step
+            float frequency = 1.2 + 0.5 * t2.y;
+            float flexibility = clamp(0.03 / max(t2.z, 0.001), 0.5, 3.0); // Stiffness from the radius
+            sway = (direction * (0.04 * gust * (0.6 + 0.4 * sin(time * frequency + phase)))
+                    + across * (0.03 * sin(time * frequency * 1.3 + phase))) * flexibility;
+        }
+        offset += sway * bend;
+        point = t1.xyz;
+        b = int(t2.x);
+    }
+    return offset * wind.z;
+}
 
 void main(void) {
+#if defined(BRANCH_LINES) || defined(BRANCH_TUBES)
+    // The later stages build the tube and everything the fragment
+    // shader reads
+    branchPoint = vertex;
+    return;
+#endif
+    /*
+     * STEP 0: GROWTH ANIMATION (GPU MODE)
+     * Rebuild the animated model-space position from the fully grown mesh
+     */
+#ifdef FOREST
+    treeTime = time - forestParams.z;
+#else
+    treeTime = growthTime;
+#endif
+    // A tree vertex carries its baked occlusion in w; every position is a point
+    vec4 modelVertex = vec4(vertex.xyz, 1.0);
+    occlusion = vertex.w;
+    vec3 surfaceNormal = normal;
+    float growth = 1.0;
+    vec3 windAnchor = vec3(0.0); // Where the wind takes a branch or leaf vertex
+#ifdef LEAF
+    leafSeason = vec2(0.0);
+#endif
+    if (growthMode == 1) {
+        // Branch: ring offset added to its point on the animated chord, plus
+        // a curved branch's sag there, which shrinks with the chord
+        int b = int(growthRef.x);
+        growth = branchProgress(b);
+        vec3 end = animatedEnd(b);
+        vec3 center = end - texelFetch(branchData, b * 3).xyz * (growth * (1.0 - growthRef.y)) + cornerDir * growth;
+        modelVertex = vec4(center + vertex.xyz, 1.0);
+        windAnchor = center; // Rings move whole
+    } else if (growthMode == 2) {
+        // Leaf: keeps its offset from the parent end and buds from a minimum size
+        growth = clamp((treeTime - growthRef.y) / growthRef.z, 0.0, 1.0);
+        windAnchor = animatedEnd(int(growthRef.x));
+        float fall = 0.0;
+#ifdef LEAF
+        // Every corner carries the same growth record, so it keys the leaf
+        uint key = floatBitsToUint(growthRef.x) * 2654435761u ^ floatBitsToUint(growthRef.y) * 40503u
+                   ^ floatBitsToUint(growthRef.w);
+        growth *= seasonalLeaf(hashRandom(key), windAnchor.y, false, fall);
+#endif
+        float size = growthRef.w * growth;
+        size = 0.05 + (size - 0.05) * growth;
+#ifdef LEAF
+        size *= thinnedLeaf(key, windAnchor + vertex.xyz);
+#endif
+        modelVertex = vec4(windAnchor + vertex.xyz + cornerDir * size - vec3(0.0, fall, 0.0), 1.0);
+    } else if (growthMode == 3) {
+        // Leaf instance: vertex.xy is a unit quad corner in [-0.5, 0.5], spanned
+        // along the same right/up frame addLeafQuad builds on the CPU
+        growth = instanceScale.y;
+        float fall = 0.0;
+#ifdef LEAF
+        uint key = floatBitsToUint(instancePosition.x) * 2654435761u ^ floatBitsToUint(instancePosition.y) * 40503u
+                   ^ floatBitsToUint(instancePosition.z);
+        growth *= seasonalLeaf(hashRandom(key), instancePosition.y, fallingLeaves != 0, fall);
+#endif
+        float size = instanceScale.x * growth;
+        size = 0.05 + (size - 0.05) * growth;
+#ifdef LEAF
+        size *= thinnedLeaf(key, instancePosition);
+#endif
+        vec3 right = cross(instanceNormal, vec3(0.0, 1.0, 0.0));
+        right = (length(right) < 0.01) ? vec3(1.0, 0.0, 0.0) : normalize(right);
+        vec3 up = normalize(cross(right, instanceNormal));
+        modelVertex = vec4(instancePosition + (right * vertex.x + up * vertex.y) * size - vec3(0.0, fall, 0.0), 1.0);
+        surfaceNormal = instanceNormal;
+    } else if (growthMode == 6) {
+        // Falling leaf (LeafParticles): placed in world space as it is,
+        // turned to its shade, on the same frame as a leaf instance
+#ifdef LEAF
+        leafSeason = vec2(floor(instanceScale.y) / 64.0, fract(instanceScale.y));
+#endif
+        vec3 right = cross(instanceNormal, vec3(0.0, 1.0, 0.0));
+        right = (length(right) < 0.01) ? vec3(1.0, 0.0, 0.0) : normalize(right);
+        vec3 up = normalize(cross(right, instanceNormal));
+        modelVertex = vec4(instancePosition + (right * vertex.x + up * vertex.y) * instanceScale.x, 1.0);
+        surfaceNormal = instanceNormal;
+    } else if (growthMode == 4) {
+        // Branch instance: vertex = (cos, sin, ring, 1) of a unit 8-sided
+        // cylinder, placed on the same frame addBranchSegment uses
+        growth = branchEnd.w;
+        vec3 direction = normalize(branchEnd.xyz - branchStart.xyz);
+        vec3 up = (abs(direction.y) > 0.9) ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);
+        vec3 right = normalize(cross(direction, up));
+        up = normalize(cross(right, direction));
+        vec3 radial = right * vertex.x + up * vertex.y;
+        vec3 center = mix(branchStart.xyz, branchEnd.xyz, vertex.z);
+        float radius = branchStart.w * mix(1.0, 0.7, vertex.z); // 70% radius at tip
+        modelVertex = vec4(center + radial * radius, 1.0);
+        surfaceNormal = normalize(radial * vec3(1.0, 0.0, 1.0)); // Ignore Y like the CPU normals
+    } else if (growthMode == 5) {
+        // Twig instance: the prototype's fully grown mesh, rotated onto the
+        // attachment point and scaled up from it as the twig grows
+        growth = clamp((treeTime - twigAxisX.w) / twigAxisY.w, 0.0, 1.0);
+        mat3 rotation = mat3(twigAxisX.xyz, twigAxisY.xyz, twigAxisZ);
+        modelVertex = vec4(twigOrigin + rotation * (vertex.xyz * growth), 1.0);
+        surfaceNormal = rotation * normal;
+    }
+#ifdef FOREST
+    // The instance's placement, turned as ForestScene::select turns its
+    // bounds; MV is the view alone
+    float c = cos(forestParams.x);
+    float s = sin(forestParams.x);
+    mat3 yaw = mat3(vec3(c, 0.0, -s), vec3(0.0, 1.0, 0.0), vec3(s, 0.0, c));
+#endif
+#ifndef IMPOSTOR_BAKE
+    // Wind on the GPU-grown meshes, from their branch table: the branches
+    // bend and the leaves flutter about their normal, in the tree's own
+    // space (the impostor atlas is baked still)
+    if (wind.z > 0.0 && (growthMode == 1 || growthMode == 2)) {
+        vec3 windDirection = vec3(wind.x, 0.0, wind.y);
+        vec2 root = vec2(0.0);
+#ifdef FOREST
+        windDirection = transpose(yaw) * windDirection;
+        root = forestPlacement.xz;
+#endif
+        int b = int(growthRef.x);
+        modelVertex.xyz += windSway(windAnchor, b, windDirection, windGust(root));
+        if (growthMode == 2) {
+            float flutter = sin(time * windGusts.z + float(b) * 2.39996 + dot(cornerDir, vec3(1.3, 2.1, 0.7)));
+            modelVertex.xyz += surfaceNormal * (flutter * length(cornerDir) * growthRef.w * 0.15 * wind.z);
+        }
+    }
+#endif
+#ifdef FOREST
+    modelVertex = vec4(forestPlacement.xyz + yaw * (modelVertex.xyz * forestPlacement.w), 1.0);
+    surfaceNormal = yaw * surfaceNormal;
+    hueShift = forestParams.y;
+#endif
+#ifdef PROPS
+    materialParams = propMaterial;
+#endif
+    vec2 surfaceTexcoord = texcoord;
+#ifdef TERRAIN
+    // Toward the end of its level's range an odd grid vertex slides onto
+    // its even neighbour, so the chunk has become the coarser level's grid
+    // where that level takes over
+    vec2 grid = vertex.xy;
+    vec2 position = terrainNode.xy + grid * terrainNode.z;
+    vec2 morphRange = terrainMorph[int(terrainNode.w)];
+    float eyeDistance = length(vec3(position.x, terrainHeight(position), position.y) - terrainEye);
+    float morph = clamp((eyeDistance - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    vec2 odd = mod(floor(grid * terrainGrid + 0.5), 2.0) / terrainGrid;
+    position = terrainNode.xy + (grid - odd * morph) * terrainNode.z;
+    modelVertex = vec4(position.x, terrainHeight(position), position.y, 1.0);
+    surfaceNormal = terrainNormal(position);
+    surfaceTexcoord = position * 0.25; // The grass repeats every 4 units
+#endif
+#ifdef GRASS
+    // Place the blade in its chunk and thin it out with distance: a blade
+    // shrinks away as the density there drops to its rank
+    int instance = gl_InstanceID;
+#ifdef STEREO
+    instance /= viewCount;
+#endif
+    int slot = instance / grassBandBlades;
+    int blade = instance - slot * grassBandBlades;
+    vec4 chunk = texelFetch(grassChunks, grassFirstChunk + slot);
+    vec4 random = hashRandom(uint(chunk.w) * uint(grassBlades) + uint(blade));
+    vec2 root = chunk.xy + random.xy * grassChunkSize;
+    float ground = terrainHeight(root);
+    float rank = (float(blade) + 0.5) / float(grassBlades);
+    float bladeDistance = length(vec3(root.x, ground, root.y) - grassEye);
+    float density = clamp((grassDensity.y - bladeDistance) / max(grassDensity.y - grassDensity.x, 0.001), 0.0, 1.0);
+    growth = smoothstep(0.0, 0.05, density - rank);
+    
+    // Turned about +y, tapering to the tip and bent downwind, the more so
+    // toward the tip, by gusts travelling across the field
+    float height = grassBladeSize.y * (0.6 + 0.8 * random.z) * growth;
+    float yaw = random.w * 6.2831853;
+    vec3 across = vec3(cos(yaw), 0.0, sin(yaw));
+    vec3 facing = vec3(-across.z, 0.0, across.x);
+    float gust = wind.z * windGust(root) * (0.35 + 0.1 * sin(time * 3.1 + random.x * 6.2831853));
+    vec3 bend = vec3(wind.x, 0.0, wind.y) * gust * vertex.y * vertex.y * height;
+    modelVertex = vec4(root.x, ground, root.y, 1.0)
+        + vec4(across * vertex.x * grassBladeSize.x * (1.0 - vertex.y) + vec3(0.0, vertex.y * height, 0.0) + bend, 0.0);
+    // Mostly up, so both faces light alike
+    surfaceNormal = normalize(facing * 0.4 + vec3(0.0, 1.0, 0.0));
+    // A spot of the grass texture per blade
+    surfaceTexcoord = random.yz + vertex.xy * vec2(0.02, 0.1);
+#endif
+    
     /*
      * STEP 1: COORDINATE SPACE TRANSFORMATIONS
      * Transform positions from model space to eye space for lighting calculations
      */
-    vec4 lp = vec4(lightPos, 1.0); // Convert sun position to homogeneous coordinates
-    vec4 tp = vec4(torchPos, 1.0); // Convert torch position to homogeneous coordinates
-    vec4 vertexEyeSpace = V * M * vertex; // Transform vertex: model -> world -> eye space
-    vec4 lightEyeSpace = V * lp; // Transform sun position: world -> eye space
-    vec4 torchEyeSpace = V * tp; // Transform torch position: world -> eye space
+    vec4 vertexEyeSpace = MV * modelVertex; // Transform vertex: model -> eye space
     
     /*
-     * STEP 2: LIGHTING VECTOR CALCULATIONS (in eye space)
-     * All vectors point FROM the surface vertex TOWARDS their target
+     * STEP 2: LIGHTING INPUTS (in eye space)
+     * The fragment shader walks the light list from the interpolated
+     * position, so only the position and normal are passed on
      */
+    eyePosition = vertexEyeSpace.xyz;
     
-    // Light vector: direction from vertex towards sun light source
-    l = normalize(lightEyeSpace - vertexEyeSpace);
-    
-    // Light vector: direction from vertex towards torch light source
-    l2 = normalize(torchEyeSpace - vertexEyeSpace);
-    
-    // View vector: direction from vertex towards camera (camera is at origin in eye space)
-    v = normalize(vec4(0, 0, 0, 1) - vertexEyeSpace);
+    // Normal vector: surface orientation in eye space
+    n = normalize(normalMatrix * surfaceNormal);
     
-    // Normal vector: surface orientation in eye space (w=0 because it's a direction, not position)
-    n = normalize(V * M * vec4(normal, 0.0));
-
     /*
-     * STEP 3: TEXTURE COORDINATE GENERATION
-     * Generate two sets of texture coordinates for advanced mixing effects
+     * STEP 3: TEXTURE COORDINATES
+     * Standard UV mapping from the model; the second, normal-based set is
+     * an affine function of n, so the fragment shader makes it from the
+     * interpolated normal, exactly as if it had been interpolated itself
      */
-    
-    // Primary texture coordinates: standard UV mapping from model
-    iTexCoord0 = texcoord;
-    
-    // Secondary coordinates: generated from surface normal for procedural detail
-    // Maps normal.xy from [-1,1] to [0,1] range for texture sampling
-    // This creates texture coordinates that vary with surface orientation
-    iTexCoord1 = (n.xy + 1.0) / 2.0;
+    iTexCoord0 = surfaceTexcoord;
     
     /*
      * STEP 4: VERTEX POSITION OUTPUT
      * Final transformation chain: model -> world -> eye -> screen/clip space
      */
-    gl_Position = P * V * M * vertex;
+    gl_Position = MVP * modelVertex;
+#ifdef STEREO
+    // Both eyes in one draw: an eye's projection squeezed into its half of
+    // the target, and clipped to it. Lighting stays in the shared eye space
+    viewOrigin = vec3(0.0);
+    gl_ClipDistance[0] = 1.0;
+    if (viewCount == 2) {
+        int eye = gl_InstanceID & 1;
+        viewOrigin = eyeOffset[eye].xyz;
+        gl_Position = eyeProjection[eye] * vertexEyeSpace;
+        gl_Position.x = 0.5 * gl_Position.x + (eye == 0 ? -0.5 : 0.5) * gl_Position.w;
+        gl_ClipDistance[0] = eye == 0 ? -gl_Position.x : gl_Position.x;
+    }
+#endif
+    
+    // Not started yet: push outside the clip volume (matches the CPU path skipping it)
+    if (growth <= 0.0) {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+    }
 }
@@ -0,0 +1,23 @@
+#version 330
+
+/*
+ * SKY VERTEX SHADER
+ *
+ * One triangle over the whole target from gl_VertexID, no vertex buffer
+ * (Sky). The LUT passes read the texel coordinate; the sky pass the world
+ * direction of the view ray, unnormalized, at the far plane
+ */
+
+uniform mat4 skyRays; // The sky pass: clip space -> world directions (inverse of P times V's rotation)
+
+out vec2 lutCoord;
+out vec3 ray;
+
+void main(void) {
+	vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+	lutCoord = corner;
+	vec4 clip = vec4(corner * 2.0 - 1.0, 1.0, 1.0);
+	vec4 world = skyRays * clip;
+	ray = world.xyz / world.w;
+	gl_Position = clip;
+}
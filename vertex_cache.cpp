@@ -0,0 +1,186 @@
+#include "vertex_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Forsyth's scoring: the cache the optimizer models, a triangle's worth of
+// vertices just used scoring a flat LAST_TRIANGLE_SCORE, older ones
+// decaying with their position, plus a boost for vertices with few
+// triangles left so they are finished off rather than stranded
+static const int SCORE_CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static const size_t NO_TRIANGLE = SIZE_MAX;
+static const uint32_t NO_VERTEX = 0xFFFFFFFFu;
+
+void VertexCacheStats::add(const VertexCacheStats& other) {
+    triangles += other.triangles;
+    vertices += other.vertices;
+    transforms += other.transforms;
+}
+
+static size_t vertexCount(const uint32_t* indices, size_t count) {
+    uint32_t max_index = 0;
+    for (size_t i = 0; i < count; i++) {
+        max_index = std::max(max_index, indices[i]);
+    }
+    return count > 0 ? (size_t)max_index + 1 : 0;
+}
+
+// === ANALYSIS ===
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t count, int cache_size) {
+    VertexCacheStats stats;
+    stats.triangles = count / 3;
+    // A vertex is still cached while fewer than cache_size misses followed
+    // the one that brought it in
+    std::vector<size_t> entered(vertexCount(indices, count), SIZE_MAX);
+    for (size_t i = 0; i < count; i++) {
+        size_t& miss = entered[indices[i]];
+        if (miss == SIZE_MAX) stats.vertices++;
+        if (miss == SIZE_MAX || stats.transforms - miss >= (size_t)cache_size) {
+            miss = stats.transforms++;
+        }
+    }
+    return stats;
+}
+
+// === TRIANGLE ORDER ===
+
+static float vertexScore(int cache_position, int live_triangles) {
+    if (live_triangles == 0) return -1.0f;
+    float score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            score = LAST_TRIANGLE_SCORE;
+        } else {
+            float scale = 1.0f / (SCORE_CACHE_SIZE - 3);
+            score = powf(1.0f - (cache_position - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+    return score + VALENCE_BOOST_SCALE * powf((float)live_triangles, -VALENCE_BOOST_POWER);
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t count) {
+    const size_t triangle_count = count / 3;
+    if (triangle_count < 2) return;
+    const size_t vertex_count = vertexCount(indices, count);
+    
+    // === ADJACENCY ===
+    // Each vertex's triangles; the first live[v] of them are not emitted yet
+    std::vector<int> live(vertex_count, 0);
+    for (size_t i = 0; i < triangle_count * 3; i++) {
+        live[indices[i]]++;
+    }
+    std::vector<size_t> first(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        first[v + 1] = first[v] + live[v];
+    }
+    std::vector<size_t> adjacency(first[vertex_count]);
+    std::vector<size_t> fill(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < triangle_count * 3; i++) {
+        adjacency[fill[indices[i]]++] = i / 3;
+    }
+    
+    // === SCORES ===
+    std::vector<int> position(vertex_count, -1);
+    std::vector<float> score(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        score[v] = vertexScore(-1, live[v]);
+    }
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<char> emitted(triangle_count, 0);
+    size_t best = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        const uint32_t* corner = indices + 3 * t;
+        triangle_score[t] = score[corner[0]] + score[corner[1]] + score[corner[2]];
+        if (triangle_score[t] > triangle_score[best]) best = t;
+    }
+    
+    // === GREEDY EMISSION ===
+    std::vector<uint32_t> out;
+    out.reserve(triangle_count * 3);
+    uint32_t cache[SCORE_CACHE_SIZE + 3];
+    int cached = 0;
+    size_t scan = 0; // Every triangle before it is emitted
+    while (best != NO_TRIANGLE) {
+        const uint32_t* corner = indices + 3 * best;
+        emitted[best] = 1;
+        out.insert(out.end(), corner, corner + 3);
+        
+        // Drop the triangle from its vertices' live lists
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = corner[c];
+            size_t* list = &adjacency[first[v]];
+            size_t* found = std::find(list, list + live[v], best);
+            std::swap(*found, list[--live[v]]);
+        }
+        
+        // Its vertices move to the front of the cache, the rest shift back
+        // and those pushed past its end leave it
+        uint32_t next[SCORE_CACHE_SIZE + 3] = { corner[0], corner[1], corner[2] };
+        int next_count = 3;
+        for (int k = 0; k < cached; k++) {
+            if (cache[k] != corner[0] && cache[k] != corner[1] && cache[k] != corner[2]) next[next_count++] = cache[k];
+        }
+        for (int k = 0; k < next_count; k++) {
+            uint32_t v = next[k];
+            position[v] = k < SCORE_CACHE_SIZE ? k : -1;
+            float updated = vertexScore(position[v], live[v]);
+            float change = updated - score[v];
+            score[v] = updated;
+            for (int j = 0; j < live[v]; j++) {
+                triangle_score[adjacency[first[v] + j]] += change;
+            }
+        }
+        cached = std::min(next_count, SCORE_CACHE_SIZE);
+        for (int k = 0; k < cached; k++) {
+            cache[k] = next[k];
+        }
+        
+        // The best triangle touching the cache, or the first left when
+        // none does
+        best = NO_TRIANGLE;
+        float best_score = -1.0f;
+        for (int k = 0; k < cached; k++) {
+            uint32_t v = cache[k];
+            for (int j = 0; j < live[v]; j++) {
+                size_t t = adjacency[first[v] + j];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+        if (best == NO_TRIANGLE) {
+            while (scan < triangle_count && emitted[scan]) scan++;
+            if (scan < triangle_count) best = scan;
+        }
+    }
+    std::copy(out.begin(), out.end(), indices);
+}
+
+// === VERTEX ORDER ===
+
+void optimizeVertexFetch(std::vector<float>& vertices, int vertex_floats, std::vector<uint32_t>& indices) {
+    const size_t vertex_count = vertices.size() / vertex_floats;
+    std::vector<uint32_t> remap(vertex_count, NO_VERTEX);
+    uint32_t next = 0;
+    for (uint32_t& index : indices) {
+        if (remap[index] == NO_VERTEX) remap[index] = next++;
+        index = remap[index];
+    }
+    for (size_t v = 0; v < vertex_count; v++) {
+        if (remap[v] == NO_VERTEX) remap[v] = next++;
+    }
+    
+    std::vector<float> moved(vertices.size());
+    for (size_t v = 0; v < vertex_count; v++) {
+        std::copy(vertices.begin() + v * vertex_floats, vertices.begin() + (v + 1) * vertex_floats,
+                  moved.begin() + (size_t)remap[v] * vertex_floats);
+    }
+    vertices.swap(moved);
+}
@@ -0,0 +1,43 @@
+#ifndef VERTEX_CACHE_H
+#define VERTEX_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Size of the FIFO post-transform cache analyzeVertexCache models; small
+// enough that a mesh doing well here does well on any GPU
+static const int VERTEX_CACHE_SIZE = 16;
+
+// How an indexed triangle list uses the post-transform vertex cache
+struct VertexCacheStats {
+    size_t triangles;
+    size_t vertices;   // Distinct ones referenced
+    size_t transforms; // Cache misses: vertex shader invocations
+    
+    VertexCacheStats() : triangles(0), vertices(0), transforms(0) {}
+    void add(const VertexCacheStats& other);
+    // Average cache miss ratio: transforms per triangle, 3 at worst, about
+    // 0.5 for a large regular grid at best
+    float getAcmr() const { return triangles > 0 ? (float)transforms / triangles : 0.0f; }
+    // Average transform to vertex ratio: 1 when every vertex is shaded once
+    float getAtvr() const { return vertices > 0 ? (float)transforms / vertices : 0.0f; }
+};
+
+// Run count indices through a FIFO cache of cache_size vertices
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t count, int cache_size = VERTEX_CACHE_SIZE);
+
+// Reorder the triangles of an indexed triangle list for the post-transform
+// cache, keeping each triangle's winding: Forsyth's linear-speed optimizer,
+// which emits the triangle whose vertices score highest next, a vertex
+// scoring for being recently used and for having few triangles left. For
+// meshes drawn whole; a range drawn as a prefix keeps its order
+void optimizeVertexCache(uint32_t* indices, size_t count);
+
+// Renumber the vertices in the order indices first use them, so the vertex
+// fetches walk the buffer forward, and rewrite indices to match. vertices
+// holds vertex_floats floats per vertex; those no index uses go last, in
+// their order
+void optimizeVertexFetch(std::vector<float>& vertices, int vertex_floats, std::vector<uint32_t>& indices);
+
+#endif // VERTEX_CACHE_H
@@ -0,0 +1,45 @@
+#include "view_set.h"
+#include <cstdio>
+
+bool ViewSet::add(const std::string& spec, std::string& error) {
+    float theta, phi, radius;
+    char rest;
+    if (sscanf(spec.c_str(), "%f,%f,%f%c", &theta, &phi, &radius, &rest) != 3 || radius <= 0.0f) {
+        error = "a view is theta,phi,radius (degrees, degrees, distance), not " + spec;
+        return false;
+    }
+    if (getCount() >= MAX_VIEWS) {
+        error = "at most " + std::to_string(MAX_VIEWS) + " views";
+        return false;
+    }
+    Camera camera;
+    camera.setOrbit(glm::radians(theta), glm::radians(phi), radius);
+    cameras.push_back(camera);
+    return true;
+}
+
+void ViewSet::getViewport(int view, int width, int height, int& x, int& y, int& view_width,
+                          int& view_height) const {
+    const int count = getCount();
+    x = view * width / count;
+    y = 0;
+    view_width = (view + 1) * width / count - x;
+    view_height = height;
+}
+
+void ViewSet::update(const Camera& main, float aspect) {
+    for (Camera& camera : cameras) {
+        camera.setTarget(main.getTarget());
+        camera.setProjection(main.getFieldOfView(), main.getNearPlane(), main.getFarPlane());
+        camera.setAspectRatio(aspect);
+        camera.update(nullptr);
+    }
+}
+
+ViewFrustum ViewSet::getCullFrustum(const Camera& main) const {
+    ViewFrustum frustum = main.getFrustum();
+    for (const Camera& camera : cameras) {
+        frustum.addView(camera.getFrustum());
+    }
+    return frustum;
+}
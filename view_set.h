@@ -0,0 +1,47 @@
+#ifndef VIEW_SET_H
+#define VIEW_SET_H
+
+#include <string>
+#include <vector>
+#include "camera.h"
+#include "frustum.h"
+
+// Several views of one scene in one window (--view), side by side in
+// columns, so a window spanning monitors shows each its own viewpoint: the
+// interactive camera first, then fixed orbits around its target, which
+// follow its projection. The frame is prepared once for all of them, the
+// tree grown, the buffers uploaded and the draw list culled against the
+// union of their frusta (getCullFrustum) and sorted, then issued once per
+// view with that view's matrices, lights and shadows, so the memory and
+// the simulation are paid once however many views there are. Levels of
+// detail, fading and streaming follow the first view
+class ViewSet {
+public:
+    static const int MAX_VIEWS = ViewFrustum::MAX_VIEWS; // The interactive camera's included
+    
+    // A fixed view from "theta,phi,radius": orbit angles in degrees and the
+    // distance from the target, clamped as Camera::setOrbit clamps them;
+    // false with error set when the spec is not that or MAX_VIEWS are taken
+    bool add(const std::string& spec, std::string& error);
+    // Views, the interactive camera's included
+    int getCount() const { return 1 + (int)cameras.size(); }
+    bool isMultiple() const { return !cameras.empty(); }
+    // Back to the interactive camera alone
+    void clear() { cameras.clear(); }
+    
+    // Column view of a width x height framebuffer
+    void getViewport(int view, int width, int height, int& x, int& y, int& view_width, int& view_height) const;
+    
+    // Take main's target and projection, at aspect, and recompute the
+    // fixed views; once per frame, after main's update
+    void update(const Camera& main, float aspect);
+    // View 1 on: the fixed views
+    const Camera& getCamera(int view) const { return cameras[view - 1]; }
+    // The union of main's frustum and every fixed view's
+    ViewFrustum getCullFrustum(const Camera& main) const;
+
+private:
+    std::vector<Camera> cameras;
+};
+
+#endif // VIEW_SET_H
@@ -0,0 +1,267 @@
+#include "world_stream.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+
+// Points sampled along the predicted path, besides the eye
+static const int PREFETCH_SAMPLES = 8;
+
+WorldStream::WorldStream()
+    : chunk_size(16.0f), load_radius(0.0f), unload_radius(0.0f), memory_budget(0), max_builds(2), building(0),
+      memory_bytes(0), built(0), dropped(0), prefetch_seconds(0.0f), max_prefetch(0), prefetched(0),
+      proxy_baker(nullptr), proxy_distance(0.0f), proxy_chunks(0), cached_proxies(0) {}
+
+WorldStream::~WorldStream() {
+    clear();
+}
+
+void WorldStream::configure(float size, float load, float unload, size_t budget, int builds) {
+    chunk_size = std::max(size, 1.0f);
+    load_radius = std::max(load, 0.0f);
+    unload_radius = std::max(unload, load_radius);
+    memory_budget = budget;
+    max_builds = std::max(builds, 1);
+}
+
+void WorldStream::setProxies(const ForestScene* baker, float distance, const std::string& cache_directory) {
+    proxy_baker = baker;
+    proxy_distance = distance;
+    proxy_directory = cache_directory;
+}
+
+void WorldStream::setPrefetch(float seconds, int max_chunks, const Predictor& predict) {
+    prefetch_seconds = std::max(seconds, 0.0f);
+    max_prefetch = std::max(max_chunks, 0);
+    predictor = predict;
+}
+
+void WorldStream::clear() {
+    for (auto& entry : chunks) {
+        JobSystem::shared().wait(entry.second->job);
+        if (entry.second->proxy_handle >= 0) released_proxies.push_back(entry.second->proxy_handle);
+    }
+    chunks.clear();
+    building = 0;
+    memory_bytes = 0;
+    proxy_chunks = 0;
+}
+
+float WorldStream::distanceTo(const Chunk& chunk, const glm::vec3& eye) const {
+    const float center_x = (chunk.x + 0.5f) * chunk_size;
+    const float center_z = (chunk.z + 0.5f) * chunk_size;
+    return std::sqrt((center_x - eye.x) * (center_x - eye.x) + (center_z - eye.z) * (center_z - eye.z));
+}
+
+float WorldStream::pathDistance(const Chunk& chunk) const {
+    float nearest = distanceTo(chunk, path[0]);
+    for (size_t i = 1; i < path.size(); i++) {
+        nearest = std::min(nearest, distanceTo(chunk, path[i]));
+    }
+    return nearest;
+}
+
+// The eye, then with prefetch on the points it is predicted at evenly
+// over the look-ahead
+void WorldStream::samplePath(const glm::vec3& eye) {
+    path.clear();
+    path.push_back(eye);
+    if (prefetch_seconds <= 0.0f || max_prefetch <= 0 || !predictor || !isEnabled()) return;
+    for (int i = 1; i <= PREFETCH_SAMPLES; i++) {
+        path.push_back(predictor(prefetch_seconds * i / PREFETCH_SAMPLES));
+    }
+}
+
+void WorldStream::drop(std::unordered_map<uint64_t, std::unique_ptr<Chunk>>::iterator chunk) {
+    memory_bytes -= chunk->second->bytes;
+    if (chunk->second->far) proxy_chunks--;
+    if (chunk->second->proxy_handle >= 0) released_proxies.push_back(chunk->second->proxy_handle);
+    chunks.erase(chunk);
+    dropped++;
+}
+
+// === PER FRAME ===
+
+bool WorldStream::update(const glm::vec3& eye, float time) {
+    if (!isEnabled() && chunks.empty()) return false;
+    PROFILE_SCOPE("WorldStream::update");
+    bool changed = false;
+    samplePath(eye);
+    
+    // Finished builds join the resident set; a chunk building is never
+    // dropped, as its job still writes to it
+    for (auto& entry : chunks) {
+        Chunk& chunk = *entry.second;
+        if (chunk.ready || !chunk.job.isDone()) continue;
+        chunk.ready = true;
+        chunk.bytes = sizeof(Chunk) + chunk.instances.capacity() * sizeof(ForestInstance) + chunk.proxy->getBytes();
+        memory_bytes += chunk.bytes;
+        building--;
+        built++;
+        if (chunk.proxy_cached) cached_proxies++;
+        changed = true;
+    }
+    
+    // Out of range of the eye and the path ahead
+    for (auto entry = chunks.begin(); entry != chunks.end();) {
+        auto next = std::next(entry);
+        if (entry->second->ready && (!isEnabled() || pathDistance(*entry->second) > unload_radius)) {
+            drop(entry);
+            changed = true;
+        }
+        entry = next;
+    }
+    
+    // Over budget, the farthest from the path first
+    while (memory_budget > 0 && memory_bytes > memory_budget) {
+        auto farthest = chunks.end();
+        float farthest_distance = -1.0f;
+        for (auto entry = chunks.begin(); entry != chunks.end(); ++entry) {
+            if (!entry->second->ready) continue;
+            float distance = pathDistance(*entry->second);
+            if (distance > farthest_distance) {
+                farthest = entry;
+                farthest_distance = distance;
+            }
+        }
+        if (farthest == chunks.end()) break;
+        drop(farthest);
+        changed = true;
+    }
+    
+    // Far grown chunks as their proxies, back to trees half a chunk nearer
+    if (proxy_baker) {
+        for (auto& entry : chunks) {
+            Chunk& chunk = *entry.second;
+            if (!chunk.ready || chunk.proxy->isEmpty()) continue;
+            const float distance = distanceTo(chunk, eye);
+            const bool far = time >= chunk.proxy->grown_at &&
+                             distance > (chunk.far ? proxy_distance - 0.5f * chunk_size : proxy_distance);
+            if (far == chunk.far) continue;
+            chunk.far = far;
+            proxy_chunks += far ? 1 : -1;
+            changed = true;
+        }
+    }
+    
+    if (isEnabled()) startBuilds(eye);
+    return changed;
+}
+
+void WorldStream::build(Chunk& chunk) const {
+    PROFILE_SCOPE("WorldStream::build");
+    builder(chunk.x, chunk.z, chunk.instances);
+    if (!proxy_baker) return;
+    // The key covers everything the proxy is baked from, so a cached one
+    // is used only while the archetypes and the chunk's trees are the same
+    const uint64_t key = hashProxyBytes(chunk.instances.data(), chunk.instances.size() * sizeof(ForestInstance),
+                                        proxy_baker->getArchetypeHash());
+    std::string path;
+    if (!proxy_directory.empty()) {
+        char name[64];
+        snprintf(name, sizeof(name), "proxy_%016llx_%d_%d.bin",
+                 (unsigned long long)proxy_baker->getArchetypeHash(), chunk.x, chunk.z);
+        path = proxy_directory + "/" + name;
+        chunk.proxy_cached = loadForestProxy(path, key, *chunk.proxy);
+        if (chunk.proxy_cached) return;
+    }
+    proxy_baker->bakeProxy(chunk.instances, *chunk.proxy);
+    if (!path.empty()) saveForestProxy(path, key, *chunk.proxy);
+}
+
+void WorldStream::apply(ForestScene& forest) {
+    for (int handle : released_proxies) {
+        forest.removeProxy(handle);
+    }
+    released_proxies.clear();
+    forest.clearInstances();
+    for (const auto& entry : chunks) {
+        Chunk& chunk = *entry.second;
+        if (!chunk.ready) continue;
+        if (chunk.far) {
+            if (chunk.proxy_handle < 0) chunk.proxy_handle = forest.addProxy(chunk.proxy);
+            continue;
+        }
+        if (chunk.proxy_handle >= 0) {
+            forest.removeProxy(chunk.proxy_handle);
+            chunk.proxy_handle = -1;
+        }
+        for (const ForestInstance& instance : chunk.instances) {
+            forest.addInstance(instance);
+        }
+    }
+    forest.uploadInstances();
+}
+
+// The missing chunks within the load radius, nearest first, then those it
+// reaches along the path, soonest first, while builds are free, the
+// prefetch allowance lasts and the budget has room for them at the
+// resident chunks' mean size. Nine tenths of the budget, so a chunk a
+// little larger than the mean doesn't evict another the moment it lands
+void WorldStream::startBuilds(const glm::vec3& eye) {
+    if (building >= max_builds) return;
+    int ahead = 0; // Chunks held beyond the load radius
+    if (path.size() > 1) {
+        for (const auto& entry : chunks) {
+            if (distanceTo(*entry.second, eye) > load_radius) ahead++;
+        }
+    }
+    
+    candidates.clear();
+    glm::vec2 low(eye.x, eye.z), high(eye.x, eye.z);
+    for (const glm::vec3& point : path) {
+        low = glm::min(low, glm::vec2(point.x, point.z));
+        high = glm::max(high, glm::vec2(point.x, point.z));
+    }
+    const float step = path.size() > 1 ? prefetch_seconds / (path.size() - 1) : 0.0f;
+    const int first_x = (int)std::floor((low.x - load_radius) / chunk_size);
+    const int last_x = (int)std::floor((high.x + load_radius) / chunk_size);
+    const int first_z = (int)std::floor((low.y - load_radius) / chunk_size);
+    const int last_z = (int)std::floor((high.y + load_radius) / chunk_size);
+    for (int z = first_z; z <= last_z; z++) {
+        for (int x = first_x; x <= last_x; x++) {
+            if (chunks.count(key(x, z))) continue;
+            // The first point of the path whose load radius takes it in
+            for (size_t i = 0; i < path.size(); i++) {
+                const float dx = (x + 0.5f) * chunk_size - path[i].x;
+                const float dz = (z + 0.5f) * chunk_size - path[i].z;
+                const float distance = std::sqrt(dx * dx + dz * dz);
+                if (distance > load_radius) continue;
+                Candidate candidate = { i * step, distance, x, z };
+                candidates.push_back(candidate);
+                break;
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.time != b.time ? a.time < b.time : a.distance < b.distance;
+    });
+    
+    const int resident = getResidentChunks();
+    const size_t mean_bytes = resident > 0 ? memory_bytes / resident : 0;
+    for (const Candidate& candidate : candidates) {
+        if (building >= max_builds) break;
+        if (candidate.time > 0.0f && ahead >= max_prefetch) break;
+        if (memory_budget > 0 && memory_bytes + (building + 1) * mean_bytes > memory_budget / 10 * 9) break;
+        if (candidate.time > 0.0f) {
+            ahead++;
+            prefetched++;
+        }
+        std::unique_ptr<Chunk> chunk(new Chunk);
+        chunk->x = candidate.x;
+        chunk->z = candidate.z;
+        chunk->ready = false;
+        chunk->bytes = 0;
+        chunk->proxy_cached = false;
+        chunk->far = false;
+        chunk->proxy_handle = -1;
+        chunk->proxy = std::make_shared<ForestProxy>();
+        Chunk* target = chunk.get();
+        chunk->job.setTask([this, target]() { build(*target); });
+        chunk->job.setBackground(true);
+        chunks[key(candidate.x, candidate.z)] = std::move(chunk);
+        JobSystem::shared().submit(target->job);
+        building++;
+    }
+}
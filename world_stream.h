@@ -0,0 +1,147 @@
+#ifndef WORLD_STREAM_H
+#define WORLD_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "forest_scene.h"
+#include "job_system.h"
+
+// A world too large to hold at once, as square chunks of forest instances
+// kept resident around the camera. update() starts building the missing
+// chunks nearest the eye within the load radius as background jobs on the
+// shared JobSystem, a few at a time, and drops the chunks beyond the
+// unload radius; the gap between the two radii is hysteresis, so a camera
+// pacing along a chunk border doesn't build and drop the same chunks over
+// and over. Over the memory budget the farthest chunks go first, and no
+// build starts that the budget couldn't hold.
+//
+// A chunk's content comes from the builder, which runs on the workers and
+// must depend on nothing but the chunk's coordinates (and what stays put
+// while chunks stream): a chunk dropped and built again comes back the
+// same. Chunk (x, z) covers [x, x + 1) * chunk_size along both axes.
+//
+// With proxies on, each build also bakes the chunk's trees into one merged
+// proxy mesh (ForestScene::bakeProxy), or reads it back from the proxy
+// cache directory, and a chunk past the proxy distance whose trees are
+// all grown is drawn as its proxy instead: two draws per chunk at the
+// horizon rather than a few per tree. It turns back into trees half a
+// chunk nearer than it turned into a proxy.
+//
+// With prefetch on, update() also samples where the eye is headed over the
+// next seconds and builds, ahead of need, the chunks the load radius will
+// reach along that path, soonest first after every chunk within reach now;
+// no more than a set number of chunks beyond the load radius at once. A
+// chunk near the path is kept as if it were near the eye, and one past the
+// proxy distance is uploaded as its proxy before it comes into view.
+class WorldStream {
+public:
+    typedef std::function<void(int chunk_x, int chunk_z, std::vector<ForestInstance>& instances)> ChunkBuilder;
+    // The eye's predicted position seconds from now (Camera::predictPosition)
+    typedef std::function<glm::vec3(float seconds)> Predictor;
+    
+    WorldStream();
+    // Waits for the builds still running
+    ~WorldStream();
+    
+    // Chunks whose centers are within load_radius of the eye are built and
+    // those past unload_radius (at least load_radius) dropped; at most
+    // max_builds build at once. Takes effect on the next update()
+    void configure(float chunk_size, float load_radius, float unload_radius, size_t memory_budget, int max_builds);
+    // Not while chunks build: clear() first
+    void setBuilder(const ChunkBuilder& chunk_builder) { builder = chunk_builder; }
+    // Proxies baked by baker's archetypes (nullptr = off), drawn from
+    // distance on and cached in cache_directory ("" = not cached). Not
+    // while chunks build either
+    void setProxies(const ForestScene* baker, float distance, const std::string& cache_directory);
+    // Build along predict's path up to seconds ahead (0 = off), at most
+    // max_chunks chunks beyond the load radius resident or building
+    void setPrefetch(float seconds, int max_chunks, const Predictor& predict);
+    bool isEnabled() const { return load_radius > 0.0f && builder; }
+    
+    // === PER FRAME ===
+    // Take in the finished builds, drop and start chunks around eye and
+    // choose the proxies at scene time; true if what forest draws changed.
+    // Allocates only when chunks come or go
+    bool update(const glm::vec3& eye, float time);
+    // Bring forest up to date after update() returns true: every near
+    // resident chunk's instances, and the far ones' proxies uploaded
+    void apply(ForestScene& forest);
+    // Drop every chunk, waiting for the builds; their proxies leave forest
+    // at the next apply()
+    void clear();
+    
+    // === STATISTICS ===
+    int getResidentChunks() const { return (int)chunks.size() - building; }
+    int getBuildingChunks() const { return building; }
+    size_t getMemoryBytes() const { return memory_bytes; }
+    size_t getMemoryBudget() const { return memory_budget; }
+    uint64_t getBuiltChunks() const { return built; }
+    uint64_t getDroppedChunks() const { return dropped; }
+    int getProxyChunks() const { return proxy_chunks; }
+    uint64_t getCachedProxies() const { return cached_proxies; } // Read back rather than baked
+    uint64_t getPrefetchedChunks() const { return prefetched; } // Started beyond the load radius
+
+private:
+    struct Chunk {
+        int x, z;
+        std::vector<ForestInstance> instances;
+        Job job;
+        bool ready;   // Built and counted
+        size_t bytes; // Once ready
+        std::shared_ptr<ForestProxy> proxy; // Shared with the forest while uploaded
+        bool proxy_cached; // Read back from the cache
+        bool far;          // Drawn as its proxy
+        int proxy_handle;  // In the forest, -1 = not uploaded
+    };
+    
+    struct Candidate {
+        float time;     // Seconds until the load radius reaches it, 0 = now
+        float distance; // From the path's point there
+        int x, z;
+    };
+    
+    ChunkBuilder builder;
+    float chunk_size;
+    float load_radius;
+    float unload_radius;
+    size_t memory_budget;
+    int max_builds;
+    std::unordered_map<uint64_t, std::unique_ptr<Chunk>> chunks;
+    int building;
+    size_t memory_bytes;
+    uint64_t built;
+    uint64_t dropped;
+    std::vector<Candidate> candidates; // Kept for its capacity
+    float prefetch_seconds;
+    int max_prefetch;
+    Predictor predictor;
+    std::vector<glm::vec3> path; // The eye, then the points ahead; kept for its capacity
+    uint64_t prefetched;
+    const ForestScene* proxy_baker;
+    float proxy_distance;
+    std::string proxy_directory;
+    int proxy_chunks;
+    uint64_t cached_proxies;
+    std::vector<int> released_proxies; // Handles of dropped chunks, for apply()
+    
+    static uint64_t key(int x, int z) { return (uint64_t)(uint32_t)x << 32 | (uint32_t)z; }
+    float distanceTo(const Chunk& chunk, const glm::vec3& eye) const;
+    // To the nearest point of the path
+    float pathDistance(const Chunk& chunk) const;
+    void samplePath(const glm::vec3& eye);
+    void drop(std::unordered_map<uint64_t, std::unique_ptr<Chunk>>::iterator chunk);
+    void startBuilds(const glm::vec3& eye);
+    // A build's job: the instances, then the proxy
+    void build(Chunk& chunk) const;
+    
+    WorldStream(const WorldStream&);
+    WorldStream& operator=(const WorldStream&);
+};
+
+#endif // WORLD_STREAM_H